@@ -937,6 +937,15 @@ static EmuRunState qemu_get_runstate() {
     return (EmuRunState) get_runstate();
 };
 
+static void set_ram_dirty_log_kept(bool keep) {
+    android::RecursiveScopedVmLock vmlock;
+    qemu_ram_set_dirty_log_kept(keep);
+}
+
+static bool ram_save_dirty_pages_only(bool dirtyOnly) {
+    return qemu_ram_save_dirty_only(dirtyOnly);
+}
+
 static const QAndroidVmOperations sQAndroidVmOperations = {
         .vmStop = qemu_vm_stop,
         .vmStart = qemu_vm_start,
@@ -966,6 +975,8 @@ static const QAndroidVmOperations sQAndroidVmOperations = {
         .hostmemUnregister = android_emulation_hostmem_unregister,
         .hostmemGetInfo = android_emulation_hostmem_get_info,
         .getRunState = qemu_get_runstate,
+        .setRamDirtyLogKept = set_ram_dirty_log_kept,
+        .ramSaveDirtyPagesOnly = ram_save_dirty_pages_only,
 };
 
 extern "C" const QAndroidVmOperations* const gQAndroidVmOperations =
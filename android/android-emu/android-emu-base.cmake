@@ -37,6 +37,7 @@ android_add_library(
       android/base/Uri.cpp
       android/base/Uuid.cpp
       android/base/Version.cpp
+      android/base/files/BufferedStream.cpp
       android/base/files/CompressingStream.cpp
       android/base/files/DecompressingStream.cpp
       android/base/files/Fd.cpp
@@ -44,6 +45,7 @@ android_add_library(
       android/base/files/GzipStreambuf.cpp
       android/base/files/IniFile.cpp
       android/base/files/InplaceStream.cpp
+      android/base/files/MappedFileStream.cpp
       android/base/files/MemStream.cpp
       android/base/files/PathUtils.cpp
       android/base/files/QueueStreambuf.cpp
@@ -191,6 +193,8 @@ android_target_compile_options(android-emu-base windows_msvc-x86_64
 android_add_executable(
   TARGET android-emu_benchmark NODISTRIBUTE
   SRC # cmake-format: sortable
+      android/base/address_space_benchmark.cpp
+      android/base/files/Stream_benchmark.cpp
       android/base/synchronization/Lock_benchmark.cpp
       android/base/Log_benchmark.cpp)
 target_link_libraries(android-emu_benchmark PRIVATE android-emu-base
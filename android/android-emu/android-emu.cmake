@@ -281,6 +281,7 @@ set(android_emu_dependent_src
     android/camera/camera-videoplayback-video-renderer.cpp
     android/camera/camera-virtualscene.cpp
     android/camera/camera-virtualscene-utils.cpp
+    android/camera/camera-worker-pool.cpp
     android/emulation/control/ScreenCapturer.cpp
     android/emulation/FakeRotatingCameraSensor.cpp
     android/emulation/HostMemoryService.cpp
@@ -755,6 +756,7 @@ if(NOT LINUX_AARCH64)
       android/avd/util_wrapper_unittest.cpp
       android/base/ArraySize_unittest.cpp
       android/base/AlignedBuf_unittest.cpp
+      android/base/address_space_unittest.cpp
       android/base/ContiguousRangeMapper_unittest.cpp
       android/base/async/Looper_unittest.cpp
       android/base/async/AsyncSocketServer_unittest.cpp
@@ -771,10 +773,12 @@ if(NOT LINUX_AARCH64)
       android/base/containers/SmallVector_unittest.cpp
       android/base/containers/StaticMap_unittest.cpp
       android/base/EintrWrapper_unittest.cpp
+      android/base/files/BufferedStream_unittest.cpp
       android/base/files/FileShareOpen_unittest.cpp
       android/base/files/GzipStreambuf_unittest.cpp
       android/base/files/IniFile_unittest.cpp
       android/base/files/InplaceStream_unittest.cpp
+      android/base/files/MappedFileStream_unittest.cpp
       android/base/files/MemStream_unittest.cpp
       android/base/files/PathUtils_unittest.cpp
       android/base/files/ScopedFd_unittest.cpp
@@ -989,6 +993,41 @@ if(NOT LINUX_AARCH64)
   target_link_libraries(android-emu_unittests PRIVATE android-emu
                                                       android-emu-test-launcher)
 
+  android_add_executable(
+    TARGET android-emu_looper_benchmark NODISTRIBUTE
+    SRC # cmake-format: sortable
+        android/base/async/Looper_benchmark.cpp)
+  target_link_libraries(android-emu_looper_benchmark PRIVATE android-emu
+                                                             emulator-gbench)
+
+  android_add_executable(
+    TARGET android-emu_adb_benchmark NODISTRIBUTE
+    SRC # cmake-format: sortable
+        android/emulation/AdbGuestPipe_benchmark.cpp)
+  target_link_libraries(android-emu_adb_benchmark PRIVATE android-emu
+                                                          emulator-gbench)
+
+  android_add_executable(
+    TARGET android-emu_pipe_benchmark NODISTRIBUTE
+    SRC # cmake-format: sortable
+        android/emulation/AndroidPipe_benchmark.cpp)
+  target_link_libraries(android-emu_pipe_benchmark PRIVATE android-emu
+                                                           emulator-gbench)
+
+  android_add_executable(
+    TARGET android-emu_camera_benchmark NODISTRIBUTE
+    SRC # cmake-format: sortable
+        android/camera/CameraFormatConverters_benchmark.cpp)
+  target_link_libraries(android-emu_camera_benchmark PRIVATE android-emu
+                                                             emulator-gbench)
+
+  android_add_executable(
+    TARGET android-emu_snapshot_benchmark NODISTRIBUTE
+    SRC # cmake-format: sortable
+        android/snapshot/TextureLoader_benchmark.cpp)
+  target_link_libraries(android-emu_snapshot_benchmark
+                        PRIVATE android-emu emulator-gbench)
+
   android_add_executable(
     NODISTRIBUTE TARGET studio_discovery_tester
     SRC # cmake-format: sortable
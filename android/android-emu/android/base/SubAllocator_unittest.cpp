@@ -19,6 +19,7 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <random>
 #include <string>
 
@@ -288,5 +289,90 @@ TEST(SubAllocator, Snapshot) {
     }
 }
 
+// Test: a snapshot with more blocks than the initial capacity of the
+// allocator loads, and the loaded allocator keeps track of every block.
+TEST(SubAllocator, SnapshotManyBlocks) {
+    MemStream snapshotStream;
+    const size_t pageSize = 16;
+    const size_t numPages = 1024;
+    std::vector<uint8_t> storage(pageSize * numPages);
+
+    SubAllocator subAlloc(
+        storage.data(), (uint64_t)storage.size(), pageSize);
+
+    std::vector<void*> ptrs;
+    for (size_t i = 0; i < numPages; ++i) {
+        ptrs.push_back(subAlloc.alloc(pageSize));
+        EXPECT_NE(nullptr, ptrs.back());
+    }
+
+    // Free every other page so no blocks merge.
+    std::vector<void*> live;
+    for (size_t i = 0; i < numPages; ++i) {
+        if (i % 2) {
+            EXPECT_TRUE(subAlloc.free(ptrs[i]));
+        } else {
+            live.push_back(ptrs[i]);
+        }
+    }
+
+    subAlloc.save(&snapshotStream);
+    subAlloc.load(&snapshotStream);
+    EXPECT_TRUE(subAlloc.postLoad(storage.data()));
+
+    // Only single pages fit in the holes.
+    EXPECT_EQ(nullptr, subAlloc.alloc(2 * pageSize));
+
+    for (void* ptr : live) {
+        EXPECT_TRUE(subAlloc.free(ptr));
+        EXPECT_FALSE(subAlloc.free(ptr));
+    }
+    EXPECT_TRUE(subAlloc.empty());
+
+    // Everything merged back into one block.
+    void* all = subAlloc.alloc(storage.size());
+    EXPECT_EQ(storage.data(), all);
+}
+
+// Test: allocations succeed exactly when some free range is large enough,
+// regardless of how the free space is fragmented.
+TEST(SubAllocator, FragmentedFit) {
+    const size_t pageSize = 1;
+    const size_t bufferSize = 65536;
+    std::vector<uint8_t> buffer(bufferSize);
+
+    SubAllocator subAlloc(buffer.data(), (uint64_t)bufferSize, pageSize);
+
+    // Split the buffer into blocks of growing sizes, then free every other
+    // one, leaving holes of sizes 1, 3, 5, ...
+    std::vector<std::pair<void*, size_t>> blocks;
+    size_t used = 0;
+    for (size_t size = 1; used + size <= bufferSize; ++size) {
+        void* ptr = subAlloc.alloc(size);
+        ASSERT_NE(nullptr, ptr);
+        blocks.push_back({ptr, size});
+        used += size;
+    }
+    // Keep the rest allocated so the last hole does not grow.
+    if (used < bufferSize) {
+        EXPECT_NE(nullptr, subAlloc.alloc(bufferSize - used));
+    }
+
+    size_t largestHole = 0;
+    for (size_t i = 0; i < blocks.size(); i += 2) {
+        EXPECT_TRUE(subAlloc.free(blocks[i].first));
+        largestHole = std::max(largestHole, blocks[i].second);
+    }
+
+    EXPECT_EQ(nullptr, subAlloc.alloc(largestHole + 1));
+
+    // Each hole size fits exactly once.
+    for (size_t i = blocks.size() - 1 - (blocks.size() - 1) % 2;; i -= 2) {
+        void* ptr = subAlloc.alloc(blocks[i].second);
+        EXPECT_EQ(blocks[i].first, ptr) << "size " << blocks[i].second;
+        if (i < 2) break;
+    }
+}
+
 } // namespace base
 } // namespace android
@@ -47,15 +47,63 @@ struct address_block {
     };
 };
 
-/* A dynamic array of address blocks, with the following invariant:
+/* Links kept for each slot of address_space_allocator::blocks:
+ * prev/next chain the blocks by offset and free_prev/free_next chain the
+ * available blocks of the same size class. Unused slots are chained through
+ * next.
+ */
+struct address_block_links {
+    int prev;
+    int next;
+    int free_prev;
+    int free_next;
+};
+
+#define ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK (-1)
+
+/* Available blocks are kept in segregated free lists: the first level is
+ * log2 of the block size, the second level splits each power of two range in
+ * ANDROID_EMU_ADDRESS_SPACE_SL_COUNT linear classes. Sizes below
+ * ANDROID_EMU_ADDRESS_SPACE_SL_COUNT get a class each in the first row.
+ */
+#define ANDROID_EMU_ADDRESS_SPACE_SL_LOG2 4
+#define ANDROID_EMU_ADDRESS_SPACE_SL_COUNT (1 << ANDROID_EMU_ADDRESS_SPACE_SL_LOG2)
+#define ANDROID_EMU_ADDRESS_SPACE_FL_COUNT 64
+
+/* How many blocks of the requested size class are looked at for the smallest
+ * one that fits before going to a larger size class.
+ */
+#define ANDROID_EMU_ADDRESS_SPACE_BEST_FIT_SCAN 8
+
+/* A pool of address blocks, with the following invariant for the blocks
+ * visited by following links[].next from head:
  * blocks[i].size > 0
- * blocks[i+1].offset = blocks[i].offset + blocks[i].size
+ * blocks[next].offset = blocks[i].offset + blocks[i].size
+ * adjacent blocks are not both available
+ *
+ * The slots of blocks are not ordered by offset, use
+ * address_space_allocator_run to visit them in order. Allocated blocks are
+ * indexed by offset in index, an open addressing hash table of slots, and
+ * available ones are in the free list of their size class, so that
+ * allocate/deallocate don't need to scan all blocks.
  */
 struct address_space_allocator {
     struct address_block *blocks;
     int size;
     int capacity;
     uint64_t total_bytes;
+
+    struct address_block_links *links;
+    int head;
+    int unused_head;
+
+    int *index;
+    uint32_t index_mask;
+
+    uint64_t fl_bitmap;
+    uint32_t sl_bitmap[ANDROID_EMU_ADDRESS_SPACE_FL_COUNT];
+    int free_heads[ANDROID_EMU_ADDRESS_SPACE_FL_COUNT]
+                  [ANDROID_EMU_ADDRESS_SPACE_SL_COUNT];
 };
 
 #define ANDROID_EMU_ADDRESS_SPACE_BAD_OFFSET (~(uint64_t)0)
@@ -97,34 +145,264 @@ static void address_space_free(void* ptr) {
 #endif
 }
 
-/* Looks for the smallest (to reduce fragmentation) available block with size to
- * fit the requested amount and returns its index or -1 if none is available.
+/* Returns the index of the most significant bit set in v, which must not be 0.
  */
-static int address_space_allocator_find_available_block(
-    struct address_block *block,
-    int n_blocks,
-    uint64_t size_at_least)
+static int address_space_fls64(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(v);
+#else
+    int res = 0;
+    while (v >>= 1) {
+        ++res;
+    }
+    return res;
+#endif
+}
+
+/* Returns the index of the least significant bit set in v, which must not be
+ * 0.
+ */
+static int address_space_ffs64(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(v);
+#else
+    int res = 0;
+    while (!(v & 1)) {
+        v >>= 1;
+        ++res;
+    }
+    return res;
+#endif
+}
+
+/* Computes the size class of the free list blocks of this size belong to. */
+static void address_space_allocator_size_class(uint64_t size, int *fl, int *sl)
 {
-    int index = -1;
-    uint64_t size_at_index = 0;
+    address_space_assert(size > 0);
+
+    if (size < ANDROID_EMU_ADDRESS_SPACE_SL_COUNT) {
+        *fl = 0;
+        *sl = (int)size;
+    } else {
+        int bit = address_space_fls64(size);
+        *fl = bit - ANDROID_EMU_ADDRESS_SPACE_SL_LOG2 + 1;
+        *sl = (int)(size >> (bit - ANDROID_EMU_ADDRESS_SPACE_SL_LOG2)) -
+              ANDROID_EMU_ADDRESS_SPACE_SL_COUNT;
+    }
+}
+
+static uint32_t address_space_allocator_hash(
+    const struct address_space_allocator *allocator,
+    uint64_t offset)
+{
+    uint64_t h = offset * 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(h ^ (h >> 32)) & allocator->index_mask;
+}
+
+static void address_space_allocator_index_insert(
+    struct address_space_allocator *allocator,
+    int i)
+{
+    uint32_t pos = address_space_allocator_hash(allocator,
+                                                allocator->blocks[i].offset);
+
+    while (allocator->index[pos] != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK) {
+        pos = (pos + 1) & allocator->index_mask;
+    }
+
+    allocator->index[pos] = i;
+}
+
+/* Returns the position in the index of the allocated block at offset, or -1.
+ */
+static int address_space_allocator_index_find(
+    const struct address_space_allocator *allocator,
+    uint64_t offset)
+{
+    uint32_t pos = address_space_allocator_hash(allocator, offset);
     int i;
 
-    address_space_assert(n_blocks >= 1);
+    while ((i = allocator->index[pos]) != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK) {
+        if (allocator->blocks[i].offset == offset) {
+            return (int)pos;
+        }
+        pos = (pos + 1) & allocator->index_mask;
+    }
+
+    return -1;
+}
+
+/* Removes the entry at pos by shifting back the entries of the same probe
+ * sequence, so lookups never need tombstones.
+ */
+static void address_space_allocator_index_remove(
+    struct address_space_allocator *allocator,
+    uint32_t pos)
+{
+    const uint32_t mask = allocator->index_mask;
+    uint32_t next = pos;
+
+    for (;;) {
+        int i;
+        uint32_t home;
+
+        next = (next + 1) & mask;
+        i = allocator->index[next];
+        if (i == ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK) {
+            break;
+        }
+
+        /* Entries whose home position lies cyclically in (pos, next] are
+         * still reachable and must stay.
+         */
+        home = address_space_allocator_hash(allocator,
+                                            allocator->blocks[i].offset);
+        if (pos <= next ? (pos < home && home <= next)
+                        : (pos < home || home <= next)) {
+            continue;
+        }
+
+        allocator->index[pos] = i;
+        pos = next;
+    }
+
+    allocator->index[pos] = ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK;
+}
+
+static void address_space_allocator_insert_free(
+    struct address_space_allocator *allocator,
+    int i)
+{
+    struct address_block_links *links = allocator->links;
+    int fl, sl, head;
+
+    address_space_allocator_size_class(allocator->blocks[i].size, &fl, &sl);
+
+    head = allocator->free_heads[fl][sl];
+    links[i].free_prev = ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK;
+    links[i].free_next = head;
+    if (head != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK) {
+        links[head].free_prev = i;
+    }
+    allocator->free_heads[fl][sl] = i;
+
+    allocator->fl_bitmap |= (uint64_t)1 << fl;
+    allocator->sl_bitmap[fl] |= (uint32_t)1 << sl;
+}
+
+/* Must be called before the size of the block changes. */
+static void address_space_allocator_remove_free(
+    struct address_space_allocator *allocator,
+    int i)
+{
+    struct address_block_links *links = allocator->links;
+    int prev = links[i].free_prev;
+    int next = links[i].free_next;
+    int fl, sl;
+
+    address_space_allocator_size_class(allocator->blocks[i].size, &fl, &sl);
+
+    if (next != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK) {
+        links[next].free_prev = prev;
+    }
+    if (prev != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK) {
+        links[prev].free_next = next;
+    } else {
+        address_space_assert(allocator->free_heads[fl][sl] == i);
+        allocator->free_heads[fl][sl] = next;
+        if (next == ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK) {
+            allocator->sl_bitmap[fl] &= ~((uint32_t)1 << sl);
+            if (!allocator->sl_bitmap[fl]) {
+                allocator->fl_bitmap &= ~((uint64_t)1 << fl);
+            }
+        }
+    }
+}
+
+/* Looks at up to max_scan blocks of the free list starting at i and returns
+ * the smallest one that fits, or -1. *more is set if the list was not
+ * exhausted.
+ */
+static int address_space_allocator_scan_free_list(
+    const struct address_space_allocator *allocator,
+    int i,
+    uint64_t size_at_least,
+    int max_scan,
+    int *more)
+{
+    int index = ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK;
+    uint64_t size_at_index = 0;
 
-    for (i = 0; i < n_blocks; ++i, ++block) {
-        uint64_t this_size = block->size;
-        address_space_assert(this_size > 0);
+    for (; i != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK && max_scan > 0;
+         i = allocator->links[i].free_next, --max_scan) {
+        uint64_t this_size = allocator->blocks[i].size;
 
-        if (this_size >= size_at_least && block->available &&
+        if (this_size >= size_at_least &&
             (index < 0 || this_size < size_at_index)) {
             index = i;
             size_at_index = this_size;
+            if (this_size == size_at_least) {
+                break;
+            }
         }
     }
 
+    *more = (i != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK && max_scan == 0);
     return index;
 }
 
+/* Looks for a small (to reduce fragmentation) available block with size to fit
+ * the requested amount and returns its slot or -1 if none is available.
+ * The blocks of the requested size class are checked first, then the first
+ * non-empty class whose blocks all fit, which is found in constant time with
+ * the bitmaps.
+ */
+static int address_space_allocator_find_available_block(
+    const struct address_space_allocator *allocator,
+    uint64_t size_at_least)
+{
+    int fl, sl, more, i;
+    uint32_t sl_map;
+
+    address_space_assert(allocator->size >= 1);
+
+    if (size_at_least == 0 || size_at_least > allocator->total_bytes) {
+        return ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK;
+    }
+
+    address_space_allocator_size_class(size_at_least, &fl, &sl);
+
+    i = address_space_allocator_scan_free_list(
+        allocator, allocator->free_heads[fl][sl], size_at_least,
+        ANDROID_EMU_ADDRESS_SPACE_BEST_FIT_SCAN, &more);
+    if (i != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK) {
+        return i;
+    }
+
+    sl_map = allocator->sl_bitmap[fl] & (~(uint32_t)0 << sl << 1);
+    if (!sl_map) {
+        uint64_t fl_map = fl + 1 < ANDROID_EMU_ADDRESS_SPACE_FL_COUNT
+            ? allocator->fl_bitmap & (~(uint64_t)0 << (fl + 1)) : 0;
+        if (fl_map) {
+            int next_fl = address_space_ffs64(fl_map);
+            sl_map = allocator->sl_bitmap[next_fl];
+            return allocator->free_heads[next_fl]
+                                        [address_space_ffs64(sl_map)];
+        }
+    } else {
+        return allocator->free_heads[fl][address_space_ffs64(sl_map)];
+    }
+
+    /* Only blocks in the requested size class can still fit. */
+    if (more) {
+        return address_space_allocator_scan_free_list(
+            allocator, allocator->free_heads[fl][sl], size_at_least,
+            allocator->size, &more);
+    }
+
+    return ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK;
+}
+
 static int
 address_space_allocator_grow_capacity(int old_capacity) {
     address_space_assert(old_capacity >= 1);
@@ -132,53 +410,182 @@ address_space_allocator_grow_capacity(int old_capacity) {
     return old_capacity + old_capacity;
 }
 
-/* Inserts one more address block right after i'th (by borrowing i'th size) and
- * adjusts sizes:
+/* Reallocates the slot arrays for new_capacity slots, keeping the contents
+ * of the first min(capacity, new_capacity) slots. The index is resized to
+ * stay at most half full and left empty.
+ */
+static void address_space_allocator_resize(
+    struct address_space_allocator *allocator,
+    int new_capacity)
+{
+    uint32_t index_size = 1;
+
+    address_space_assert(new_capacity >= 1);
+
+    allocator->blocks =
+        (struct address_block*)
+        address_space_realloc(
+            allocator->blocks,
+            sizeof(struct address_block) * new_capacity);
+    address_space_assert(allocator->blocks);
+
+    allocator->links =
+        (struct address_block_links*)
+        address_space_realloc(
+            allocator->links,
+            sizeof(struct address_block_links) * new_capacity);
+    address_space_assert(allocator->links);
+
+    while (index_size < 2 * (uint32_t)new_capacity) {
+        index_size <<= 1;
+    }
+    if (index_size != allocator->index_mask + 1 || !allocator->index) {
+        address_space_free(allocator->index);
+        allocator->index = (int*)address_space_malloc0(sizeof(int) * index_size);
+        address_space_assert(allocator->index);
+        allocator->index_mask = index_size - 1;
+    }
+    memset(allocator->index, 0xff, sizeof(int) * index_size);
+
+    allocator->capacity = new_capacity;
+}
+
+/* Rebuilds the links, free lists and index from the first size slots, which
+ * must hold the blocks ordered by offset.
+ */
+static void address_space_allocator_rebuild(
+    struct address_space_allocator *allocator)
+{
+    struct address_block_links *links = allocator->links;
+    int size = allocator->size;
+    int i;
+
+    address_space_assert(size >= 1);
+    address_space_assert(size <= allocator->capacity);
+
+    allocator->fl_bitmap = 0;
+    memset(allocator->sl_bitmap, 0, sizeof(allocator->sl_bitmap));
+    memset(allocator->free_heads, 0xff, sizeof(allocator->free_heads));
+    memset(allocator->index, 0xff,
+           sizeof(int) * (allocator->index_mask + 1));
+
+    for (i = 0; i < size; ++i) {
+        links[i].prev = i - 1;
+        links[i].next = i + 1 < size ? i + 1 : ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK;
+        if (allocator->blocks[i].available) {
+            address_space_allocator_insert_free(allocator, i);
+        } else {
+            address_space_allocator_index_insert(allocator, i);
+        }
+    }
+    allocator->head = 0;
+
+    for (i = size; i < allocator->capacity; ++i) {
+        links[i].next = i + 1 < allocator->capacity
+            ? i + 1 : ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK;
+    }
+    allocator->unused_head = size < allocator->capacity
+        ? size : ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK;
+}
+
+/* Returns an unused slot, growing the pool if there is none. */
+static int address_space_allocator_new_slot(
+    struct address_space_allocator *allocator)
+{
+    int i = allocator->unused_head;
+
+    if (i == ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK) {
+        int old_capacity = allocator->capacity;
+        int j;
+
+        address_space_allocator_resize(
+            allocator,
+            address_space_allocator_grow_capacity(old_capacity));
+
+        for (j = old_capacity; j < allocator->capacity; ++j) {
+            allocator->links[j].next = j + 1 < allocator->capacity
+                ? j + 1 : ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK;
+        }
+
+        /* The index was resized, put the allocated blocks back. */
+        for (j = allocator->head; j != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK;
+             j = allocator->links[j].next) {
+            if (!allocator->blocks[j].available) {
+                address_space_allocator_index_insert(allocator, j);
+            }
+        }
+
+        i = old_capacity;
+    }
+
+    allocator->unused_head = allocator->links[i].next;
+    return i;
+}
+
+static void address_space_allocator_release_slot(
+    struct address_space_allocator *allocator,
+    int i)
+{
+    allocator->links[i].next = allocator->unused_head;
+    allocator->unused_head = i;
+}
+
+/* Removes block i from the offset order and releases its slot. */
+static void address_space_allocator_unlink_block(
+    struct address_space_allocator *allocator,
+    int i)
+{
+    struct address_block_links *links = allocator->links;
+    int prev = links[i].prev;
+    int next = links[i].next;
+
+    if (prev != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK) {
+        links[prev].next = next;
+    } else {
+        allocator->head = next;
+    }
+    if (next != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK) {
+        links[next].prev = prev;
+    }
+
+    address_space_allocator_release_slot(allocator, i);
+    --allocator->size;
+}
+
+/* Inserts one more address block right after i'th (by borrowing i'th size)
+ * and adjusts sizes:
  * pre:
- *   size > blocks[i].size
+ *   size < blocks[i].size, blocks[i] is available
  *
  * post:
  *   * might reallocate allocator->blocks if there is no capacity to insert one
- *   * blocks[i].size -= size;
- *   * blocks[i+1].size = size;
+ *   * blocks[i].size -= size, and it is moved to the matching free list;
+ *   * the new block has the given size and is not in any free list.
+ *
+ * Returns the slot of the new block.
  */
-static struct address_block*
-address_space_allocator_split_block(
+static int address_space_allocator_split_block(
     struct address_space_allocator *allocator,
     int i,
     uint64_t size)
 {
-    address_space_assert(allocator->capacity >= 1);
-    address_space_assert(allocator->size >= 1);
-    address_space_assert(allocator->size <= allocator->capacity);
-    address_space_assert(i >= 0);
-    address_space_assert(i < allocator->size);
-    address_space_assert(size < allocator->blocks[i].size);
+    struct address_block *to_borrow_from;
+    struct address_block *new_block;
+    uint64_t new_size;
+    int next;
+    int n;
 
-    if (allocator->size == allocator->capacity) {
-        int new_capacity = address_space_allocator_grow_capacity(allocator->capacity);
-        allocator->blocks =
-            (struct address_block*)
-            address_space_realloc(
-                allocator->blocks,
-                sizeof(struct address_block) * new_capacity);
-        address_space_assert(allocator->blocks);
-        allocator->capacity = new_capacity;
-    }
+    address_space_assert(size < allocator->blocks[i].size);
 
-    struct address_block *blocks = allocator->blocks;
+    /* May reallocate blocks and links. */
+    n = address_space_allocator_new_slot(allocator);
 
-    /*   size = 5, i = 1
-     *   [ 0 | 1 |  2  |  3  | 4 ]  =>  [ 0 | 1 | new |  2  | 3 | 4 ]
-     *         i  (i+1) (i+2)                 i  (i+1) (i+2)
-     */
-    memmove(&blocks[i + 2], &blocks[i + 1],
-            sizeof(struct address_block) * (allocator->size - i - 1));
+    address_space_allocator_remove_free(allocator, i);
 
-    struct address_block *to_borrow_from = &blocks[i];
-    struct address_block *new_block = to_borrow_from + 1;
+    to_borrow_from = &allocator->blocks[i];
+    new_block = &allocator->blocks[n];
 
-    uint64_t new_size = to_borrow_from->size - size;
+    new_size = to_borrow_from->size - size;
 
     to_borrow_from->size = new_size;
 
@@ -186,62 +593,54 @@ address_space_allocator_split_block(
     new_block->size = size;
     new_block->available = 1;
 
+    address_space_allocator_insert_free(allocator, i);
+
+    next = allocator->links[i].next;
+    allocator->links[n].prev = i;
+    allocator->links[n].next = next;
+    allocator->links[i].next = n;
+    if (next != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK) {
+        allocator->links[next].prev = n;
+    }
+
     ++allocator->size;
 
-    return new_block;
+    return n;
 }
 
-/* Marks i'th block as available. If adjacent ((i-1) and (i+1)) blocks are also
- * available, it merges i'th block with them.
- * pre:
- *   i < allocator->size
+/* Marks i'th block as available. If adjacent (previous and next by offset)
+ * blocks are also available, it merges i'th block with them.
  * post:
  *   i'th block is merged with adjacent ones if they are available, blocks that
  *   were merged from are removed. allocator->size is updated if blocks were
- *   removed.
+ *   removed. The resulting block is put in its free list.
  */
 static void address_space_allocator_release_block(
     struct address_space_allocator *allocator,
     int i)
 {
     struct address_block *blocks = allocator->blocks;
-    int before = i - 1;
-    int after = i + 1;
-    int size = allocator->size;
-
-    address_space_assert(i >= 0);
-    address_space_assert(i < size);
+    int before = allocator->links[i].prev;
+    int after = allocator->links[i].next;
 
     blocks[i].available = 1;
 
-    if (before >= 0 && blocks[before].available) {
-        if (after < size && blocks[after].available) {
-            // merge (before, i, after) into before
-            blocks[before].size += (blocks[i].size + blocks[after].size);
-
-            size -= 2;
-            memmove(&blocks[i], &blocks[i + 2],
-                sizeof(struct address_block) * (size - i));
-            allocator->size = size;
-        } else {
-            // merge (before, i) into before
-            blocks[before].size += blocks[i].size;
-
-            --size;
-            memmove(&blocks[i], &blocks[i + 1],
-                sizeof(struct address_block) * (size - i));
-            allocator->size = size;
-        }
-    } else if (after < size && blocks[after].available) {
+    if (after != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK && blocks[after].available) {
         // merge (i, after) into i
+        address_space_allocator_remove_free(allocator, after);
         blocks[i].size += blocks[after].size;
+        address_space_allocator_unlink_block(allocator, after);
+    }
 
-        --size;
-        memmove(&blocks[after], &blocks[after + 1],
-            sizeof(struct address_block) * (size - after));
-        allocator->size = size;
+    if (before != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK && blocks[before].available) {
+        // merge (before, i) into before
+        address_space_allocator_remove_free(allocator, before);
+        blocks[before].size += blocks[i].size;
+        address_space_allocator_unlink_block(allocator, i);
+        i = before;
     }
 
+    address_space_allocator_insert_free(allocator, i);
 }
 
 /* Takes a size to allocate an address block and returns an offset where this
@@ -252,23 +651,23 @@ static uint64_t address_space_allocator_allocate(
     struct address_space_allocator *allocator,
     uint64_t size)
 {
-    int i = address_space_allocator_find_available_block(allocator->blocks,
-                                                         allocator->size,
-                                                         size);
+    int i = address_space_allocator_find_available_block(allocator, size);
     if (i < 0) {
         return ANDROID_EMU_ADDRESS_SPACE_BAD_OFFSET;
     } else {
-        address_space_assert(i < allocator->size);
-
-        struct address_block *block = &allocator->blocks[i];
-        address_space_assert(block->size >= size);
+        address_space_assert(i < allocator->capacity);
+        address_space_assert(allocator->blocks[i].size >= size);
 
-        if (block->size > size) {
-            block = address_space_allocator_split_block(allocator, i, size);
+        if (allocator->blocks[i].size > size) {
+            i = address_space_allocator_split_block(allocator, i, size);
+        } else {
+            address_space_allocator_remove_free(allocator, i);
         }
 
+        struct address_block *block = &allocator->blocks[i];
         address_space_assert(block->size == size);
         block->available = 0;
+        address_space_allocator_index_insert(allocator, i);
 
         return block->offset;
     }
@@ -281,24 +680,22 @@ static uint32_t address_space_allocator_deallocate(
     struct address_space_allocator *allocator,
     uint64_t offset)
 {
-    struct address_block *block = allocator->blocks;
-    int size = allocator->size;
+    int pos;
     int i;
 
-    address_space_assert(size >= 1);
+    address_space_assert(allocator->size >= 1);
 
-    for (i = 0; i < size; ++i, ++block) {
-        if (block->offset == offset) {
-            if (block->available) {
-                return EINVAL;
-            } else {
-                address_space_allocator_release_block(allocator, i);
-                return 0;
-            }
-        }
+    pos = address_space_allocator_index_find(allocator, offset);
+    if (pos < 0) {
+        return EINVAL;
     }
 
-    return EINVAL;
+    i = allocator->index[pos];
+    address_space_assert(!allocator->blocks[i].available);
+
+    address_space_allocator_index_remove(allocator, (uint32_t)pos);
+    address_space_allocator_release_block(allocator, i);
+    return 0;
 }
 
 /* Creates a seed block. */
@@ -309,11 +706,12 @@ static void address_space_allocator_init(
 {
     address_space_assert(initial_capacity >= 1);
 
-    allocator->blocks =
-        (struct address_block*)
-        malloc(sizeof(struct address_block) * initial_capacity);
+    allocator->blocks = 0;
+    allocator->links = 0;
+    allocator->index = 0;
+    allocator->index_mask = 0;
+    address_space_allocator_resize(allocator, initial_capacity);
     memset(allocator->blocks, 0, sizeof(struct address_block) * initial_capacity);
-    address_space_assert(allocator->blocks);
 
     struct address_block *block = allocator->blocks;
 
@@ -322,8 +720,9 @@ static void address_space_allocator_init(
     block->available = 1;
 
     allocator->size = 1;
-    allocator->capacity = initial_capacity;
     allocator->total_bytes = size;
+
+    address_space_allocator_rebuild(allocator);
 }
 
 /* At this point there should be no used blocks and all available blocks must
@@ -334,8 +733,10 @@ static void address_space_allocator_destroy(
 {
     address_space_assert(allocator->size == 1);
     address_space_assert(allocator->capacity >= allocator->size);
-    address_space_assert(allocator->blocks[0].available);
+    address_space_assert(allocator->blocks[allocator->head].available);
     address_space_free(allocator->blocks);
+    address_space_free(allocator->links);
+    address_space_free(allocator->index);
 }
 
 /* Destroy function if we don't care what was previoulsy allocated.
@@ -345,6 +746,8 @@ static void address_space_allocator_destroy_nocleanup(
     struct address_space_allocator *allocator)
 {
     address_space_free(allocator->blocks);
+    address_space_free(allocator->links);
+    address_space_free(allocator->index);
 }
 
 /* Resets the state of the allocator to the initial state without
@@ -360,11 +763,54 @@ static void address_space_allocator_reset(
     block->offset = 0;
     block->size = allocator->total_bytes;
     block->available = 1;
+
+    address_space_allocator_rebuild(allocator);
+}
+
+/* Moves the blocks to the first size slots, ordered by offset. */
+static void address_space_allocator_compact(
+    struct address_space_allocator *allocator)
+{
+    struct address_block *sorted;
+    int i, n;
+
+    sorted = (struct address_block*)
+        address_space_malloc0(sizeof(struct address_block) * allocator->size);
+    address_space_assert(sorted);
+
+    for (i = allocator->head, n = 0; i != ANDROID_EMU_ADDRESS_SPACE_NO_BLOCK;
+         i = allocator->links[i].next, ++n) {
+        sorted[n] = allocator->blocks[i];
+    }
+    address_space_assert(n == allocator->size);
+
+    memcpy(allocator->blocks, sorted, sizeof(struct address_block) * n);
+    address_space_free(sorted);
+
+    address_space_allocator_rebuild(allocator);
+}
+
+/* Rebuilds the links, free lists and index after blocks, size and capacity
+ * were replaced as a whole, e.g. by a snapshot load of the blocks that
+ * address_space_allocator_compact left in the first size slots.
+ */
+static void address_space_allocator_restore(
+    struct address_space_allocator *allocator)
+{
+    address_space_assert(allocator->blocks);
+
+    address_space_allocator_resize(allocator, allocator->capacity);
+    address_space_allocator_rebuild(allocator);
 }
 
 typedef void (*address_block_iter_func_t)(void* context, struct address_block*);
 typedef void (*address_space_allocator_iter_func_t)(void* context, struct address_space_allocator*);
 
+/* Calls allocator_func, then block_func on each block in offset order. Both
+ * can modify what they are given (e.g. to load a snapshot), as long as the
+ * blocks satisfy the invariant afterwards; if allocator_func changes size,
+ * block_func is called for the new number of blocks.
+ */
 static void address_space_allocator_run(
     struct address_space_allocator *allocator,
     void* context,
@@ -372,19 +818,34 @@ static void address_space_allocator_run(
     address_block_iter_func_t block_func)
 {
     struct address_block *block = 0;
+    int capacity;
     int size;
     int i;
 
+    address_space_allocator_compact(allocator);
+    capacity = allocator->capacity;
+
     allocator_func(context, allocator);
 
-    block = allocator->blocks;
     size = allocator->size;
-
     address_space_assert(size >= 1);
 
+    if (allocator->capacity < size) {
+        allocator->capacity = size;
+    }
+    if (allocator->capacity != capacity) {
+        int new_capacity = allocator->capacity;
+        allocator->capacity = capacity;
+        address_space_allocator_resize(allocator, new_capacity);
+    }
+
+    block = allocator->blocks;
+
     for (i = 0; i < size; ++i, ++block) {
         block_func(context, block);
     }
+
+    address_space_allocator_rebuild(allocator);
 }
 
 #ifdef ADDRESS_SPACE_NAMESPACE
@@ -0,0 +1,216 @@
+// Copyright 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares the address_space allocator with the linear scan best fit
+// allocator it replaced, both for allocate/deallocate throughput with many
+// live blocks and for fragmentation under a random workload.
+
+#include "android/base/address_space.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark_api.h"
+
+namespace {
+
+constexpr uint64_t kPageSize = 4096;
+
+// The previous implementation: a flat array of blocks ordered by offset,
+// scanned for the smallest available block that fits and for the block to
+// free.
+class LinearAllocator {
+public:
+    explicit LinearAllocator(uint64_t totalBytes) {
+        mBlocks.push_back({0, totalBytes, true});
+    }
+
+    uint64_t allocate(uint64_t size) {
+        int index = -1;
+        for (int i = 0; i < (int)mBlocks.size(); ++i) {
+            const Block& block = mBlocks[i];
+            if (block.available && block.size >= size &&
+                (index < 0 || block.size < mBlocks[index].size)) {
+                index = i;
+            }
+        }
+        if (index < 0) {
+            return ANDROID_EMU_ADDRESS_SPACE_BAD_OFFSET;
+        }
+        if (mBlocks[index].size > size) {
+            Block& from = mBlocks[index];
+            from.size -= size;
+            Block block = {from.offset + from.size, size, true};
+            mBlocks.insert(mBlocks.begin() + index + 1, block);
+            ++index;
+        }
+        mBlocks[index].available = false;
+        return mBlocks[index].offset;
+    }
+
+    void deallocate(uint64_t offset) {
+        for (int i = 0; i < (int)mBlocks.size(); ++i) {
+            if (mBlocks[i].offset != offset) {
+                continue;
+            }
+            mBlocks[i].available = true;
+            if (i + 1 < (int)mBlocks.size() && mBlocks[i + 1].available) {
+                mBlocks[i].size += mBlocks[i + 1].size;
+                mBlocks.erase(mBlocks.begin() + i + 1);
+            }
+            if (i > 0 && mBlocks[i - 1].available) {
+                mBlocks[i - 1].size += mBlocks[i].size;
+                mBlocks.erase(mBlocks.begin() + i);
+            }
+            return;
+        }
+    }
+
+private:
+    struct Block {
+        uint64_t offset;
+        uint64_t size;
+        bool available;
+    };
+    std::vector<Block> mBlocks;
+};
+
+class AddressSpaceAllocator {
+public:
+    explicit AddressSpaceAllocator(uint64_t totalBytes) {
+        address_space_allocator_init(&mAllocator, totalBytes, 32);
+    }
+
+    ~AddressSpaceAllocator() {
+        address_space_allocator_destroy_nocleanup(&mAllocator);
+    }
+
+    uint64_t allocate(uint64_t size) {
+        return address_space_allocator_allocate(&mAllocator, size);
+    }
+
+    void deallocate(uint64_t offset) {
+        address_space_allocator_deallocate(&mAllocator, offset);
+    }
+
+private:
+    struct address_space_allocator mAllocator;
+};
+
+// Keeps range_x() blocks of 1 to 16 pages alive, replacing a random one on
+// each iteration.
+template <class Allocator>
+void allocFree(benchmark::State& state) {
+    const int liveCount = state.range_x();
+    std::default_random_engine generator(0);
+    std::uniform_int_distribution<uint64_t> pages(1, 16);
+
+    Allocator allocator(uint64_t(liveCount) * 16 * kPageSize * 2);
+    std::vector<uint64_t> live;
+    for (int i = 0; i < liveCount; ++i) {
+        live.push_back(allocator.allocate(pages(generator) * kPageSize));
+    }
+
+    std::uniform_int_distribution<int> victim(0, liveCount - 1);
+    while (state.KeepRunning()) {
+        uint64_t& offset = live[victim(generator)];
+        allocator.deallocate(offset);
+        offset = allocator.allocate(pages(generator) * kPageSize);
+    }
+
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+// Fills a 64 MiB space with blocks of 1 to 64 pages, then keeps replacing
+// random blocks until range_x() allocations failed. Reports how many
+// allocations it took and how much of the free space was usable as the
+// largest free range at the end.
+template <class Allocator>
+void fragmentation(benchmark::State& state) {
+    const uint64_t totalBytes = 64ULL << 20;
+    const int maxFailures = state.range_x();
+    uint64_t allocations = 0;
+    double largestFreeRatio = 0;
+
+    while (state.KeepRunning()) {
+        std::default_random_engine generator(0);
+        std::uniform_int_distribution<uint64_t> pages(1, 64);
+        Allocator allocator(totalBytes);
+        std::vector<std::pair<uint64_t, uint64_t>> live;
+        uint64_t used = 0;
+        int failures = 0;
+
+        allocations = 0;
+        while (failures < maxFailures) {
+            const uint64_t size = pages(generator) * kPageSize;
+            const uint64_t offset = allocator.allocate(size);
+            ++allocations;
+            if (offset != ANDROID_EMU_ADDRESS_SPACE_BAD_OFFSET) {
+                live.push_back({offset, size});
+                used += size;
+                continue;
+            }
+            ++failures;
+            // Free a few random blocks to make room.
+            for (int i = 0; i < 4 && !live.empty(); ++i) {
+                size_t index = generator() % live.size();
+                allocator.deallocate(live[index].first);
+                used -= live[index].second;
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+
+        std::sort(live.begin(), live.end());
+        uint64_t largestFree = 0;
+        uint64_t end = 0;
+        for (const auto& block : live) {
+            largestFree = std::max(largestFree, block.first - end);
+            end = block.first + block.second;
+        }
+        largestFree = std::max(largestFree, totalBytes - end);
+        largestFreeRatio =
+                used < totalBytes ? double(largestFree) / (totalBytes - used)
+                                  : 1.0;
+    }
+
+    state.SetItemsProcessed(state.iterations() * allocations);
+    state.SetLabel(std::to_string(allocations) + " allocs, largest free " +
+                   std::to_string(int(largestFreeRatio * 100)) + "%");
+}
+
+}  // namespace
+
+void BM_AddressSpace_AllocFree(benchmark::State& state) {
+    allocFree<AddressSpaceAllocator>(state);
+}
+
+void BM_AddressSpace_AllocFree_Linear(benchmark::State& state) {
+    allocFree<LinearAllocator>(state);
+}
+
+void BM_AddressSpace_Fragmentation(benchmark::State& state) {
+    fragmentation<AddressSpaceAllocator>(state);
+}
+
+void BM_AddressSpace_Fragmentation_Linear(benchmark::State& state) {
+    fragmentation<LinearAllocator>(state);
+}
+
+BENCHMARK(BM_AddressSpace_AllocFree)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_AddressSpace_AllocFree_Linear)->Arg(64)->Arg(1024)->Arg(16384);
+BENCHMARK(BM_AddressSpace_Fragmentation)->Arg(1000);
+BENCHMARK(BM_AddressSpace_Fragmentation_Linear)->Arg(1000);
@@ -0,0 +1,141 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "android/base/address_space.h"
+
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+namespace {
+
+// The allocator fields the goldfish_address_space vmstate saves.
+struct SavedAllocator {
+    int size;
+    int capacity;
+    uint64_t total_bytes;
+    std::vector<address_block> blocks;
+};
+
+SavedAllocator saveAllocator(address_space_allocator* allocator) {
+    // pre_save
+    address_space_allocator_compact(allocator);
+
+    SavedAllocator saved;
+    saved.size = allocator->size;
+    saved.capacity = allocator->capacity;
+    saved.total_bytes = allocator->total_bytes;
+    saved.blocks.assign(allocator->blocks,
+                        allocator->blocks + allocator->capacity);
+    return saved;
+}
+
+void loadAllocator(const SavedAllocator& saved,
+                   address_space_allocator* allocator) {
+    // pre_load, then VMSTATE_STRUCT_VARRAY_ALLOC
+    free(allocator->blocks);
+    allocator->size = saved.size;
+    allocator->capacity = saved.capacity;
+    allocator->total_bytes = saved.total_bytes;
+    allocator->blocks = static_cast<address_block*>(
+            malloc(sizeof(address_block) * saved.capacity));
+    memcpy(allocator->blocks, saved.blocks.data(),
+           sizeof(address_block) * saved.capacity);
+    // post_load
+    address_space_allocator_restore(allocator);
+}
+
+}  // namespace
+
+// Test: an allocator saved after allocations and frees that left its slots
+// out of offset order loads into an allocator with a smaller capacity, and the
+// loaded one tracks the same allocated and available blocks.
+TEST(address_space, SnapshotRoundTrip) {
+    const uint64_t pageSize = 16;
+    const int numPages = 512;
+    const uint64_t totalBytes = pageSize * numPages;
+
+    address_space_allocator allocator;
+    address_space_allocator_init(&allocator, totalBytes, 4);
+
+    std::vector<uint64_t> offsets;
+    for (int i = 0; i < numPages; ++i) {
+        offsets.push_back(
+                address_space_allocator_allocate(&allocator, pageSize));
+        ASSERT_NE(ANDROID_EMU_ADDRESS_SPACE_BAD_OFFSET, offsets.back());
+    }
+
+    // Free a run in the middle and allocate it again in two halves, so the
+    // slots get reused out of order, then free every third page.
+    for (int i = 100; i < 200; ++i) {
+        EXPECT_EQ(0u, address_space_allocator_deallocate(&allocator,
+                                                         offsets[i]));
+    }
+    const uint64_t firstHalf =
+            address_space_allocator_allocate(&allocator, 50 * pageSize);
+    const uint64_t secondHalf =
+            address_space_allocator_allocate(&allocator, 50 * pageSize);
+    ASSERT_NE(ANDROID_EMU_ADDRESS_SPACE_BAD_OFFSET, firstHalf);
+    ASSERT_NE(ANDROID_EMU_ADDRESS_SPACE_BAD_OFFSET, secondHalf);
+
+    std::vector<uint64_t> live = {firstHalf, secondHalf};
+    std::vector<uint64_t> freed;
+    for (int i = 0; i < numPages; ++i) {
+        if (i >= 100 && i < 200) {
+            continue;
+        }
+        if (i % 3 == 0) {
+            EXPECT_EQ(0u, address_space_allocator_deallocate(&allocator,
+                                                             offsets[i]));
+            freed.push_back(offsets[i]);
+        } else {
+            live.push_back(offsets[i]);
+        }
+    }
+
+    const SavedAllocator saved = saveAllocator(&allocator);
+    for (uint64_t offset : live) {
+        EXPECT_EQ(0u, address_space_allocator_deallocate(&allocator, offset));
+    }
+    address_space_allocator_destroy(&allocator);
+
+    address_space_allocator loaded;
+    address_space_allocator_init(&loaded, totalBytes, 4);
+    loadAllocator(saved, &loaded);
+
+    EXPECT_EQ(saved.size, loaded.size);
+
+    // Only single pages are available.
+    EXPECT_EQ(ANDROID_EMU_ADDRESS_SPACE_BAD_OFFSET,
+              address_space_allocator_allocate(&loaded, 2 * pageSize));
+
+    for (uint64_t offset : freed) {
+        EXPECT_EQ((uint32_t)EINVAL,
+                  address_space_allocator_deallocate(&loaded, offset));
+    }
+    for (uint64_t offset : live) {
+        EXPECT_EQ(0u, address_space_allocator_deallocate(&loaded, offset));
+        EXPECT_EQ((uint32_t)EINVAL,
+                  address_space_allocator_deallocate(&loaded, offset));
+    }
+
+    // Everything merged back into one block.
+    EXPECT_EQ(1, loaded.size);
+    EXPECT_EQ(0u, address_space_allocator_allocate(&loaded, totalBytes));
+    EXPECT_EQ(0u, address_space_allocator_deallocate(&loaded, 0));
+    address_space_allocator_destroy(&loaded);
+}
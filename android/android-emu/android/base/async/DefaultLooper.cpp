@@ -15,7 +15,7 @@
 #include "android/base/system/System.h"
 #include "android/base/sockets/SocketErrors.h"
 
-#include <algorithm>
+#include <iterator>
 #include <utility>
 
 namespace android {
@@ -56,10 +56,18 @@ void DefaultLooper::forceQuit() {
 
 void DefaultLooper::addFdWatch(DefaultLooper::FdWatch* watch) {
     mFdWatches.emplace(watch, mPendingFdWatches.end());
+    mFdWatchesByFd.emplace(watch->fd(), watch);
 }
 
 void DefaultLooper::delFdWatch(DefaultLooper::FdWatch* watch) {
     mFdWatches.erase(watch);
+    const auto range = mFdWatchesByFd.equal_range(watch->fd());
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == watch) {
+            mFdWatchesByFd.erase(it);
+            break;
+        }
+    }
 }
 
 void DefaultLooper::addPendingFdWatch(DefaultLooper::FdWatch* watch) {
@@ -71,7 +79,12 @@ void DefaultLooper::delPendingFdWatch(DefaultLooper::FdWatch* watch) {
     mPendingFdWatches.erase(mFdWatches[watch]);
 }
 
-void DefaultLooper::updateFdWatch(int fd, unsigned wantedEvents) {
+void DefaultLooper::updateFdWatch(int fd) {
+    unsigned wantedEvents = 0;
+    const auto range = mFdWatchesByFd.equal_range(fd);
+    for (auto it = range.first; it != range.second; ++it) {
+        wantedEvents |= it->second->wantedEvents();
+    }
     mWaiter->update(fd, wantedEvents);
 }
 
@@ -82,7 +95,8 @@ Looper::FdWatch* DefaultLooper::createFdWatch(int fd,
 }
 
 void DefaultLooper::addTimer(DefaultLooper::Timer* timer) {
-    mTimers.emplace(timer, mPendingTimers.end());
+    mTimers.emplace(timer,
+                    TimerPosition{mPendingTimers.end(), mActiveTimers.end()});
 }
 
 void DefaultLooper::delTimer(DefaultLooper::Timer* timer) {
@@ -90,26 +104,25 @@ void DefaultLooper::delTimer(DefaultLooper::Timer* timer) {
 }
 
 void DefaultLooper::enableTimer(DefaultLooper::Timer* timer) {
-    // Find the first timer that expires after this one.
-    const auto deadline = timer->deadline();
-    const auto it = std::find_if(
-            mActiveTimers.begin(), mActiveTimers.end(),
-            [deadline](const Timer* t) { return t->deadline() > deadline; });
-    mTimers[timer] = mActiveTimers.insert(it, timer);
+    // Goes after the timers with the same deadline.
+    mTimers[timer].active = mActiveTimers.emplace(timer->deadline(), timer);
 }
 
 void DefaultLooper::disableTimer(DefaultLooper::Timer* timer) {
-    // Simply remove from the list.
-    mActiveTimers.erase(mTimers[timer]);
+    auto& position = mTimers[timer];
+    mActiveTimers.erase(position.active);
+    position.active = mActiveTimers.end();
 }
 
 void DefaultLooper::addPendingTimer(DefaultLooper::Timer* timer) {
     mPendingTimers.push_back(timer);
-    mTimers[timer] = std::prev(mPendingTimers.end());
+    mTimers[timer].pending = std::prev(mPendingTimers.end());
 }
 
 void DefaultLooper::delPendingTimer(DefaultLooper::Timer* timer) {
-    mPendingTimers.erase(mTimers[timer]);
+    auto& position = mTimers[timer];
+    mPendingTimers.erase(position.pending);
+    position.pending = mPendingTimers.end();
 }
 
 Looper::Timer* DefaultLooper::createTimer(Looper::Timer::Callback callback,
@@ -168,7 +181,7 @@ bool DefaultLooper::runOneIterationWithDeadlineMs(Looper::Duration deadlineMs) {
 
     auto firstTimerIt = mActiveTimers.begin();
     if (firstTimerIt != mActiveTimers.end()) {
-        nextDeadline = (*firstTimerIt)->deadline();
+        nextDeadline = firstTimerIt->first;
     }
 
     if (nextDeadline > deadlineMs) {
@@ -219,15 +232,13 @@ bool DefaultLooper::runOneIterationWithDeadlineMs(Looper::Duration deadlineMs) {
                     break;
                 }
 
-                // Find the FdWatch for this file descriptor.
-                // TODO(digit): Improve efficiency with a map?
-                const auto fdIt =
-                        std::find_if(mFdWatches.begin(), mFdWatches.end(),
-                                     [fd](const FdWatchSet::value_type& pair) {
-                                         return pair.first->fd() == fd;
-                                     });
-                if (fdIt != mFdWatches.end()) {
-                    fdIt->first->setPending(events);
+                // Find the FdWatches for this file descriptor.
+                const auto range = mFdWatchesByFd.equal_range(fd);
+                for (auto it = range.first; it != range.second; ++it) {
+                    FdWatch* watch = it->second;
+                    if (events & watch->wantedEvents()) {
+                        watch->setPending(events);
+                    }
                 }
             }
         }
@@ -238,10 +249,12 @@ bool DefaultLooper::runOneIterationWithDeadlineMs(Looper::Duration deadlineMs) {
 
     const Duration kNow = nowMs();
     auto timerIt = mActiveTimers.begin();
-    while (timerIt != mActiveTimers.end() && (*timerIt)->deadline() <= kNow) {
+    while (timerIt != mActiveTimers.end() && timerIt->first <= kNow) {
         // Remove from active list, add to pending list.
-        (*timerIt)->setPending();
+        Timer* timer = timerIt->second;
         timerIt = mActiveTimers.erase(timerIt);
+        mTimers[timer].active = mActiveTimers.end();
+        timer->setPending();
     }
 
     // Fire the pending timers, this is done in a separate step
@@ -290,7 +303,7 @@ void DefaultLooper::FdWatch::addEvents(unsigned events) {
     unsigned newEvents = mWantedEvents | events;
     if (newEvents != mWantedEvents) {
         mWantedEvents = newEvents;
-        defaultLooper()->updateFdWatch(mFd, newEvents);
+        defaultLooper()->updateFdWatch(mFd);
     }
 }
 
@@ -299,7 +312,7 @@ void DefaultLooper::FdWatch::removeEvents(unsigned events) {
     unsigned newEvents = mWantedEvents & ~events;
     if (newEvents != mWantedEvents) {
         mWantedEvents = newEvents;
-        defaultLooper()->updateFdWatch(mFd, newEvents);
+        defaultLooper()->updateFdWatch(mFd);
         if (!newEvents) {
             clearPending();
         }
@@ -312,6 +325,10 @@ unsigned DefaultLooper::FdWatch::poll() const {
     return mLastEvents;
 }
 
+unsigned DefaultLooper::FdWatch::wantedEvents() const {
+    return mWantedEvents;
+}
+
 bool DefaultLooper::FdWatch::isPending() const {
     return mPending;
 }
@@ -319,7 +336,7 @@ bool DefaultLooper::FdWatch::isPending() const {
 void DefaultLooper::FdWatch::setPending(unsigned events) {
     DCHECK(!mPending);
     mPending = true;
-    mLastEvents = events & kEventMask;
+    mLastEvents = events & mWantedEvents;
     defaultLooper()->addPendingFdWatch(this);
 }
 
@@ -354,7 +371,7 @@ DefaultLooper* DefaultLooper::Timer::defaultLooper() const {
 }
 
 DefaultLooper::Timer::~Timer() {
-    clearPending();
+    stop();
     defaultLooper()->delTimer(this);
 }
 
@@ -370,7 +387,10 @@ void DefaultLooper::Timer::startRelative(Looper::Duration deadlineMs) {
 }
 
 void DefaultLooper::Timer::startAbsolute(Looper::Duration deadlineMs) {
-    if (mDeadline != kDurationInfinite) {
+    if (mPending) {
+        // Expired but not fired yet; it is no longer active.
+        clearPending();
+    } else if (mDeadline != kDurationInfinite) {
         defaultLooper()->disableTimer(this);
     }
     mDeadline = deadlineMs;
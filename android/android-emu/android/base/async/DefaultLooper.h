@@ -15,6 +15,7 @@
 #include "android/base/sockets/SocketWaiter.h"
 
 #include <list>
+#include <map>
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
@@ -23,8 +24,9 @@
 namespace android {
 namespace base {
 
-// Default looper implementation based on select(). To make sure all timers and
-// FD watches execute, run its runWithDeadlineMs() explicitly.
+// Default looper implementation based on SocketWaiter, i.e. epoll() on Linux
+// and select() elsewhere. To make sure all timers and FD watches execute, run
+// its runWithDeadlineMs() explicitly.
 class DefaultLooper : public Looper {
 public:
     DefaultLooper();
@@ -56,6 +58,9 @@ public:
 
         unsigned poll() const override;
 
+        // Return the events this FdWatch waits for.
+        unsigned wantedEvents() const;
+
         // Return true iff this FdWatch is pending execution.
         bool isPending() const;
 
@@ -83,7 +88,8 @@ public:
 
     void delPendingFdWatch(FdWatch* watch);
 
-    void updateFdWatch(int fd, unsigned wantedEvents);
+    // Wait for the events any FdWatch of |fd| wants.
+    void updateFdWatch(int fd);
 
     Looper::FdWatch* createFdWatch(int fd,
                                    Looper::FdWatch::Callback callback,
@@ -175,21 +181,33 @@ public:
     int runWithDeadlineMs(Duration deadlineMs) override;
 
     typedef std::list<Timer*> TimerList;
-    typedef std::unordered_map<Timer*, TimerList::iterator> TimerSet;
+    // Active timers by deadline; timers with the same deadline stay in the
+    // order they were started.
+    typedef std::multimap<Duration, Timer*> TimerQueue;
+    // Where a timer is in mPendingTimers or mActiveTimers, whichever it is
+    // in.
+    struct TimerPosition {
+        TimerList::iterator pending;
+        TimerQueue::iterator active;
+    };
+    typedef std::unordered_map<Timer*, TimerPosition> TimerSet;
 
     typedef std::list<FdWatch*> FdWatchList;
     typedef std::unordered_map<FdWatch*, FdWatchList::iterator> FdWatchSet;
+    // Several FdWatches may share a file descriptor.
+    typedef std::unordered_multimap<int, FdWatch*> FdWatchMap;
 
 protected:
     bool runOneIterationWithDeadlineMs(Duration deadlineMs);
 
     std::unique_ptr<SocketWaiter> mWaiter;
     FdWatchSet mFdWatches;          // Set of all fd watches.
+    FdWatchMap mFdWatchesByFd;      // Fd watches by their file descriptor.
     FdWatchList mPendingFdWatches;  // Queue of pending fd watches.
 
-    TimerSet mTimers;          // Set of all timers.
-    TimerList mActiveTimers;   // Sorted list of active timers.
-    TimerList mPendingTimers;  // Sorted list of pending timers.
+    TimerSet mTimers;           // Set of all timers.
+    TimerQueue mActiveTimers;   // Active timers, sorted by deadline.
+    TimerList mPendingTimers;   // Sorted list of pending timers.
 
     using TaskSet = std::unordered_set<Task*>;
     TaskSet mScheduledTasks;
@@ -0,0 +1,115 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// Measures how the default looper scales with the number of watched
+// descriptors and active timers, when only one of them is ready.
+
+#include "android/base/async/Looper.h"
+#include "android/base/sockets/ScopedSocket.h"
+#include "android/base/sockets/SocketUtils.h"
+
+#include "benchmark/benchmark_api.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using android::base::Looper;
+using android::base::ScopedSocket;
+using android::base::socketCreatePair;
+using android::base::socketRecv;
+using android::base::socketSend;
+
+#define LOOPER_BENCHMARK(x) \
+    BENCHMARK(x)->Arg(8)->Arg(64)->Arg(512)->Arg(4096)
+
+static void raiseFdLimit(int count) {
+#ifndef _WIN32
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+        limit.rlim_cur < (rlim_t)count) {
+        limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, count);
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+}
+
+static void readByteAndQuit(void* opaque, int fd, unsigned events) {
+    char c;
+    socketRecv(fd, &c, 1);
+    static_cast<Looper*>(opaque)->forceQuit();
+}
+
+// Watches range_x() sockets for reading and makes one of them readable per
+// iteration.
+void BM_Looper_FdWatchOneReady(benchmark::State& state) {
+    const int count = state.range_x();
+    raiseFdLimit(2 * count + 64);
+
+    std::unique_ptr<Looper> looper(Looper::create());
+    std::vector<ScopedSocket> readers;
+    std::vector<ScopedSocket> writers;
+    std::vector<std::unique_ptr<Looper::FdWatch>> watches;
+
+    for (int i = 0; i < count; ++i) {
+        int s1, s2;
+        if (socketCreatePair(&s1, &s2) < 0) {
+            break;
+        }
+        readers.emplace_back(s1);
+        writers.emplace_back(s2);
+        watches.emplace_back(
+                looper->createFdWatch(s1, readByteAndQuit, looper.get()));
+        watches.back()->wantRead();
+    }
+    if ((int)readers.size() < count) {
+        state.SetLabel("not enough file descriptors");
+    }
+
+    size_t next = 0;
+    while (state.KeepRunning()) {
+        socketSend(writers[next].get(), "x", 1);
+        looper->runWithDeadlineMs(Looper::kDurationInfinite);
+        next = (next + 1) % writers.size();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+LOOPER_BENCHMARK(BM_Looper_FdWatchOneReady);
+
+static void noop(void* opaque, Looper::Timer* timer) {}
+
+// Restarts one timer among range_x() active ones.
+void BM_Looper_TimerRestart(benchmark::State& state) {
+    const int count = state.range_x();
+
+    std::unique_ptr<Looper> looper(Looper::create());
+    std::vector<std::unique_ptr<Looper::Timer>> timers;
+    for (int i = 0; i < count; ++i) {
+        timers.emplace_back(looper->createTimer(noop, nullptr));
+        timers.back()->startRelative(1000000 + i);
+    }
+
+    size_t next = 0;
+    while (state.KeepRunning()) {
+        timers[next]->startRelative(1000000 + count);
+        next = (next + 1) % timers.size();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+LOOPER_BENCHMARK(BM_Looper_TimerRestart);
@@ -17,6 +17,7 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <vector>
 
 #include <errno.h>
 
@@ -397,5 +398,146 @@ TEST(GenericLooper, ScheduleCallback) {
     EXPECT_FALSE(taskRan);
 }
 
+namespace {
+
+struct TimerOrder {
+    std::vector<Looper::Timer*> fired;
+    Looper::Timer* timerToRestart = nullptr;
+};
+
+}  // namespace
+
+static void myTimerCallbackRecordOrder(void* opaque, Looper::Timer* timer) {
+    auto order = static_cast<TimerOrder*>(opaque);
+    order->fired.push_back(timer);
+    if (order->timerToRestart) {
+        order->timerToRestart->startRelative(100000);
+        order->timerToRestart = nullptr;
+    }
+}
+
+TEST(GenericLooper, TimersFireInDeadlineOrder) {
+    std::unique_ptr<Looper> looper(Looper::create());
+
+    TimerOrder order;
+    std::unique_ptr<Looper::Timer> timer1(
+            looper->createTimer(myTimerCallbackRecordOrder, &order));
+    std::unique_ptr<Looper::Timer> timer2(
+            looper->createTimer(myTimerCallbackRecordOrder, &order));
+    std::unique_ptr<Looper::Timer> timer3(
+            looper->createTimer(myTimerCallbackRecordOrder, &order));
+
+    // Timers with the same deadline fire in the order they were started.
+    const Duration now = looper->nowMs();
+    timer1->startAbsolute(now - 5);
+    timer2->startAbsolute(now - 5);
+    timer3->startAbsolute(now - 10);
+
+    EXPECT_EQ(EWOULDBLOCK,
+              looper->runWithDeadlineMs(Looper::kDurationInfinite));
+    ASSERT_EQ(3U, order.fired.size());
+    EXPECT_EQ(timer3.get(), order.fired[0]);
+    EXPECT_EQ(timer1.get(), order.fired[1]);
+    EXPECT_EQ(timer2.get(), order.fired[2]);
+}
+
+TEST(GenericLooper, TimerRestartedBeforeFiring) {
+    std::unique_ptr<Looper> looper(Looper::create());
+
+    TimerOrder order;
+    std::unique_ptr<Looper::Timer> timer1(
+            looper->createTimer(myTimerCallbackRecordOrder, &order));
+    std::unique_ptr<Looper::Timer> timer2(
+            looper->createTimer(myTimerCallbackRecordOrder, &order));
+
+    // Both expire in the same iteration, and the first restarts the second
+    // before it fires.
+    const Duration now = looper->nowMs();
+    timer1->startAbsolute(now - 10);
+    timer2->startAbsolute(now - 5);
+    order.timerToRestart = timer2.get();
+
+    EXPECT_EQ(ETIMEDOUT, looper->runWithDeadlineMs(now + 50));
+    ASSERT_EQ(1U, order.fired.size());
+    EXPECT_EQ(timer1.get(), order.fired[0]);
+    EXPECT_FALSE(timer1->isActive());
+    EXPECT_TRUE(timer2->isActive());
+
+    timer2->stop();
+    EXPECT_EQ(EWOULDBLOCK,
+              looper->runWithDeadlineMs(Looper::kDurationInfinite));
+    EXPECT_EQ(1U, order.fired.size());
+}
+
+static void myFdWatchCallbackRecordFd(void* opaque, int fd, unsigned events) {
+    EXPECT_EQ(Looper::FdWatch::kEventRead, events);
+    static_cast<std::vector<int>*>(opaque)->push_back(fd);
+}
+
+TEST(GenericLooper, RunWithManyFdWatches) {
+    std::unique_ptr<Looper> looper(Looper::create());
+
+    const int kCount = 100;
+    std::vector<ScopedSocket> readers(kCount);
+    std::vector<ScopedSocket> writers(kCount);
+    std::vector<std::unique_ptr<Looper::FdWatch>> watches;
+    std::vector<int> firedFds;
+
+    for (int i = 0; i < kCount; ++i) {
+        ASSERT_TRUE(createScopedSocketPair(&readers[i], &writers[i]));
+        watches.emplace_back(looper->createFdWatch(
+                readers[i].get(), myFdWatchCallbackRecordFd, &firedFds));
+        watches.back()->wantRead();
+    }
+
+    ASSERT_EQ(1, socketSend(writers[kCount / 2].get(), "x", 1));
+
+    EXPECT_EQ(ETIMEDOUT, looper->runWithDeadlineMs(looper->nowMs() + 50));
+    ASSERT_LE(1U, firedFds.size());
+    for (int fd : firedFds) {
+        EXPECT_EQ(readers[kCount / 2].get(), fd);
+    }
+
+    watches.clear();
+}
+
+static void myFdWatchCallbackRecordEvents(void* opaque,
+                                          int fd,
+                                          unsigned events) {
+    *static_cast<unsigned*>(opaque) |= events;
+}
+
+TEST(GenericLooper, FdWatchesSharingFd) {
+    std::unique_ptr<Looper> looper(Looper::create());
+
+    ScopedSocket reader, writer;
+    ASSERT_TRUE(createScopedSocketPair(&reader, &writer));
+
+    unsigned readEvents = 0;
+    unsigned writeEvents = 0;
+    std::unique_ptr<Looper::FdWatch> readWatch(looper->createFdWatch(
+            reader.get(), myFdWatchCallbackRecordEvents, &readEvents));
+    std::unique_ptr<Looper::FdWatch> writeWatch(looper->createFdWatch(
+            reader.get(), myFdWatchCallbackRecordEvents, &writeEvents));
+    readWatch->wantRead();
+    writeWatch->wantWrite();
+
+    // Each watch hears about the events it wants, and only those.
+    ASSERT_EQ(1, socketSend(writer.get(), "x", 1));
+    EXPECT_EQ(ETIMEDOUT, looper->runWithDeadlineMs(looper->nowMs() + 50));
+    EXPECT_EQ(Looper::FdWatch::kEventRead, readEvents);
+    EXPECT_EQ(Looper::FdWatch::kEventWrite, writeEvents);
+
+    // Removing one watch keeps the other one working.
+    writeWatch.reset();
+    readEvents = 0;
+    EXPECT_EQ(ETIMEDOUT, looper->runWithDeadlineMs(looper->nowMs() + 50));
+    EXPECT_EQ(Looper::FdWatch::kEventRead, readEvents);
+
+    readWatch.reset();
+    EXPECT_EQ(EWOULDBLOCK,
+              looper->runWithDeadlineMs(Looper::kDurationInfinite));
+}
+
 }  // namespace base
 }  // namespace android
@@ -0,0 +1,95 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "android/base/files/BufferedStream.h"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+namespace android {
+namespace base {
+
+BufferedStream::BufferedStream(Stream* stream, size_t bufferSize)
+    : mStream(stream),
+      mBufferSize(std::max<size_t>(bufferSize, 16)),
+      mBuffer(new uint8_t[mBufferSize]) {}
+
+BufferedStream::~BufferedStream() {
+    flush();
+}
+
+ssize_t BufferedStream::read(void* buffer, size_t size) {
+    assert(!mPutEnd && "BufferedStream can't both read and write");
+
+    auto out = static_cast<uint8_t*>(buffer);
+    size_t done = 0;
+    while (done < size) {
+        const size_t available = mGetEnd - mGetPos;
+        if (available) {
+            const size_t chunk = std::min(available, size - done);
+            memcpy(out + done, mGetPos, chunk);
+            mGetPos += chunk;
+            done += chunk;
+            continue;
+        }
+
+        // Read large requests directly, refill the buffer for small ones.
+        const bool direct = size - done >= mBufferSize;
+        const ssize_t ret = direct ? mStream->read(out + done, size - done)
+                                   : mStream->read(mBuffer.get(),
+                                                   mBufferSize);
+        if (ret <= 0) {
+            return done ? static_cast<ssize_t>(done) : ret;
+        }
+        if (direct) {
+            done += ret;
+        } else {
+            mGetPos = mBuffer.get();
+            mGetEnd = mGetPos + ret;
+        }
+    }
+    return static_cast<ssize_t>(done);
+}
+
+ssize_t BufferedStream::write(const void* buffer, size_t size) {
+    assert(!mGetEnd && "BufferedStream can't both read and write");
+
+    if (!mPutEnd) {
+        mPutPos = mBuffer.get();
+        mPutEnd = mPutPos + mBufferSize;
+    }
+    if (size > size_t(mPutEnd - mPutPos)) {
+        if (!flush()) {
+            return -EIO;
+        }
+        if (size >= mBufferSize) {
+            return mStream->write(buffer, size);
+        }
+    }
+    memcpy(mPutPos, buffer, size);
+    mPutPos += size;
+    return static_cast<ssize_t>(size);
+}
+
+bool BufferedStream::flush() {
+    if (!mPutEnd || mPutPos == mBuffer.get()) {
+        return true;
+    }
+    const size_t size = mPutPos - mBuffer.get();
+    mPutPos = mBuffer.get();
+    return mStream->write(mBuffer.get(), size) == static_cast<ssize_t>(size);
+}
+
+}  // namespace base
+}  // namespace android
@@ -0,0 +1,57 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#pragma once
+
+#include "android/base/Compiler.h"
+#include "android/base/files/Stream.h"
+
+#include <memory>
+
+namespace android {
+namespace base {
+
+// A Stream that buffers the writes to, or the reads from, another stream,
+// so that the small put/get calls of serialization code are plain copies
+// instead of one virtual call each on the wrapped stream.
+//
+// An instance is meant for either writing or reading. Writes reach the
+// wrapped stream on flush() or destruction. Reads are done ahead in
+// chunks, so the wrapped stream must accept reads of any size; this
+// excludes DecompressingStream, unless it reads CompressingStream::kBlocks.
+class BufferedStream : public Stream {
+public:
+    static constexpr size_t kDefaultBufferSize = 64 * 1024;
+
+    explicit BufferedStream(Stream* stream,
+                            size_t bufferSize = kDefaultBufferSize);
+    // Flushes the buffered writes.
+    ~BufferedStream();
+
+    // Stream interface implementation.
+    ssize_t read(void* buffer, size_t size) override;
+    ssize_t write(const void* buffer, size_t size) override;
+
+    // Writes what is buffered to the wrapped stream. Returns false if that
+    // stream took less.
+    bool flush();
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(BufferedStream);
+
+    Stream* const mStream;
+    const size_t mBufferSize;
+    // Left uninitialized, unlike a vector.
+    std::unique_ptr<uint8_t[]> mBuffer;
+};
+
+}  // namespace base
+}  // namespace android
@@ -0,0 +1,130 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "android/base/files/BufferedStream.h"
+
+#include "android/base/files/MemStream.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace base {
+
+// Writes a bit of everything to |stream|.
+static void writeFields(Stream* stream) {
+    for (int i = 0; i < 100; ++i) {
+        stream->putByte(uint8_t(i));
+        stream->putBe16(uint16_t(i * 3));
+        stream->putBe32(uint32_t(i * 100003));
+        stream->putBe64(uint64_t(i) << 40);
+        stream->putPackedNum(uint64_t(i) << (i % 60));
+        stream->putPackedSignedNum(-i);
+        stream->putString(std::string(i, 'x'));
+    }
+}
+
+static void checkFields(Stream* stream) {
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(uint8_t(i), stream->getByte());
+        EXPECT_EQ(uint16_t(i * 3), stream->getBe16());
+        EXPECT_EQ(uint32_t(i * 100003), stream->getBe32());
+        EXPECT_EQ(uint64_t(i) << 40, stream->getBe64());
+        EXPECT_EQ(uint64_t(i) << (i % 60), stream->getPackedNum());
+        EXPECT_EQ(-i, stream->getPackedSignedNum());
+        EXPECT_EQ(std::string(i, 'x'), stream->getString());
+    }
+}
+
+TEST(BufferedStream, sameFormatAsUnbuffered) {
+    MemStream direct;
+    writeFields(&direct);
+
+    // A buffer smaller than some of the strings.
+    MemStream buffered;
+    {
+        BufferedStream stream(&buffered, 32);
+        writeFields(&stream);
+    }
+    EXPECT_EQ(direct.buffer(), buffered.buffer());
+}
+
+TEST(BufferedStream, flush) {
+    MemStream mem;
+    BufferedStream stream(&mem);
+    stream.putBe32(1);
+    EXPECT_EQ(0, mem.writtenSize());
+    EXPECT_TRUE(stream.flush());
+    EXPECT_EQ(4, mem.writtenSize());
+    EXPECT_TRUE(stream.flush());
+    EXPECT_EQ(4, mem.writtenSize());
+}
+
+TEST(BufferedStream, read) {
+    for (size_t bufferSize : {16, 100, 4096}) {
+        MemStream mem;
+        writeFields(&mem);
+        BufferedStream stream(&mem, bufferSize);
+        checkFields(&stream);
+        char c;
+        EXPECT_EQ(0, stream.read(&c, 1));
+    }
+}
+
+TEST(BufferedStream, largeWrite) {
+    const std::vector<char> data(1000, 'a');
+    MemStream mem;
+    BufferedStream stream(&mem, 64);
+    stream.putByte(1);
+    EXPECT_EQ(1000, stream.write(data.data(), data.size()));
+    // What was buffered went first, the large write directly after it.
+    EXPECT_EQ(1001, mem.writtenSize());
+    EXPECT_EQ(1, mem.getByte());
+}
+
+TEST(BufferedStream, shortRead) {
+    MemStream mem;
+    mem.putBe16(0x102);
+    BufferedStream stream(&mem);
+    char buffer[4] = {};
+    EXPECT_EQ(2, stream.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(0, stream.getBe32());
+}
+
+TEST(BufferedStream, arrays) {
+    std::vector<uint32_t> values32(1000);
+    std::vector<uint64_t> values64(1000);
+    for (size_t i = 0; i < values32.size(); ++i) {
+        values32[i] = uint32_t(i * 0x01010101);
+        values64[i] = uint64_t(i) * 0x0101010101010101ull;
+    }
+
+    MemStream mem;
+    {
+        BufferedStream stream(&mem, 100);
+        stream.putBe32Array(values32.data(), values32.size());
+        stream.putBe64Array(values64.data(), values64.size());
+    }
+    EXPECT_EQ(12000, mem.writtenSize());
+
+    std::vector<uint32_t> read32(values32.size());
+    std::vector<uint64_t> read64(values64.size());
+    BufferedStream stream(&mem, 100);
+    stream.getBe32Array(read32.data(), read32.size());
+    stream.getBe64Array(read64.data(), read64.size());
+    EXPECT_EQ(values32, read32);
+    EXPECT_EQ(values64, read64);
+}
+
+}  // namespace base
+}  // namespace android
@@ -19,8 +19,15 @@
 namespace android {
 namespace base {
 
-CompressingStream::CompressingStream(Stream& output)
-    : mOutput(output), mLzStream(LZ4_createStream()) {}
+static void putBe32At(char* out, uint32_t value) {
+    out[0] = static_cast<char>(value >> 24);
+    out[1] = static_cast<char>(value >> 16);
+    out[2] = static_cast<char>(value >> 8);
+    out[3] = static_cast<char>(value);
+}
+
+CompressingStream::CompressingStream(Stream& output, Format format)
+    : mOutput(output), mFormat(format), mLzStream(LZ4_createStream()) {}
 
 CompressingStream::~CompressingStream() {
     saveBuffer(&mOutput, mBuffer);
@@ -37,6 +44,21 @@ ssize_t CompressingStream::write(const void* buffer, size_t size) {
     }
     const auto outSize = LZ4_compressBound(size);
     auto oldSize = mBuffer.size();
+    if (mFormat == kBlocks) {
+        // The block's uncompressed and compressed sizes go first.
+        mBuffer.resize_noinit(mBuffer.size() + 8 + outSize);
+        const auto outBuffer = mBuffer.data() + oldSize;
+        const int written = LZ4_compress_fast((const char*)buffer,
+                                              outBuffer + 8, size, outSize, 1);
+        if (!written) {
+            mBuffer.resize(oldSize);
+            return -EIO;
+        }
+        putBe32At(outBuffer, size);
+        putBe32At(outBuffer + 4, written);
+        mBuffer.resize(oldSize + 8 + written);
+        return size;
+    }
     mBuffer.resize_noinit(mBuffer.size() + outSize);
     const auto outBuffer = mBuffer.data() + oldSize;
     const int written = LZ4_compress_fast_continue((LZ4_stream_t*)mLzStream,
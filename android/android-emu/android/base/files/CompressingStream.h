@@ -22,7 +22,17 @@ class CompressingStream : public Stream {
     DISALLOW_COPY_AND_ASSIGN(CompressingStream);
 
 public:
-    CompressingStream(Stream& output);
+    enum Format {
+        // A single LZ4 stream. The reads on the other end must have the
+        // sizes the writes had.
+        kStream,
+        // Each write() is an LZ4 block of its own, stored with its sizes,
+        // so reads can have any size. Meant to be written through a
+        // BufferedStream.
+        kBlocks,
+    };
+
+    CompressingStream(Stream& output, Format format = kStream);
     ~CompressingStream();
 
     ssize_t read(void* buffer, size_t size) override;
@@ -30,6 +40,7 @@ public:
 
 private:
     Stream& mOutput;
+    const Format mFormat;
     void* mLzStream;
     SmallFixedVector<char, 512> mBuffer;
 };
@@ -19,13 +19,22 @@
 #endif
 
 #include <errno.h>
+#include <string.h>
+
+#include <algorithm>
 #include <cassert>
 
 namespace android {
 namespace base {
 
-DecompressingStream::DecompressingStream(Stream& input)
-    : mLzStream(LZ4_createStreamDecode()) {
+static uint32_t getBe32At(const char* in) {
+    const auto bytes = reinterpret_cast<const uint8_t*>(in);
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) |
+           (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+}
+
+DecompressingStream::DecompressingStream(Stream& input, Format format)
+    : mFormat(format), mLzStream(LZ4_createStreamDecode()) {
     loadBuffer(&input, &mBuffer);
 }
 
@@ -34,11 +43,17 @@ DecompressingStream::~DecompressingStream() {
 }
 
 ssize_t DecompressingStream::read(void* buffer, size_t size) {
+    if (mFormat == CompressingStream::kBlocks) {
+        return readBlocks(static_cast<char*>(buffer), size);
+    }
     assert(mBufferPos < mBuffer.size() ||
            (mBufferPos == mBuffer.size() && size == 0));
     if (!size) {
         return 0;
     }
+    if (mBufferPos >= mBuffer.size()) {
+        return -EIO;
+    }
     const int read = LZ4_decompress_fast_continue(
             (LZ4_streamDecode_t*)mLzStream, mBuffer.data() + mBufferPos,
             (char*)buffer, size);
@@ -50,6 +65,50 @@ ssize_t DecompressingStream::read(void* buffer, size_t size) {
     return size;
 }
 
+ssize_t DecompressingStream::readBlocks(char* buffer, size_t size) {
+    const int dataSize = mBuffer.size();
+    size_t done = 0;
+    while (done < size) {
+        const size_t available = mGetEnd - mGetPos;
+        if (available) {
+            const size_t chunk = std::min(available, size - done);
+            memcpy(buffer + done, mGetPos, chunk);
+            mGetPos += chunk;
+            done += chunk;
+            continue;
+        }
+
+        if (dataSize - mBufferPos < 8) {
+            break;
+        }
+        const char* header = mBuffer.data() + mBufferPos;
+        const uint32_t blockSize = getBe32At(header);
+        const uint32_t compressedSize = getBe32At(header + 4);
+        if (compressedSize > uint32_t(dataSize - mBufferPos - 8)) {
+            break;
+        }
+
+        const bool direct = size - done >= blockSize;
+        if (!direct && blockSize > mBlockCapacity) {
+            mBlock.reset(new char[blockSize]);
+            mBlockCapacity = blockSize;
+        }
+        char* const out = direct ? buffer + done : mBlock.get();
+        if (LZ4_decompress_safe(header + 8, out, compressedSize, blockSize) !=
+            int(blockSize)) {
+            break;
+        }
+        mBufferPos += 8 + compressedSize;
+        if (direct) {
+            done += blockSize;
+        } else {
+            mGetPos = reinterpret_cast<const uint8_t*>(mBlock.get());
+            mGetEnd = mGetPos + blockSize;
+        }
+    }
+    return done ? static_cast<ssize_t>(done) : (size ? -EIO : 0);
+}
+
 ssize_t DecompressingStream::write(const void*, size_t) {
     return -EPERM;
 }
@@ -13,8 +13,11 @@
 
 #include "android/base/Compiler.h"
 #include "android/base/containers/SmallVector.h"
+#include "android/base/files/CompressingStream.h"
 #include "android/base/files/Stream.h"
 
+#include <memory>
+
 #ifdef _MSC_VER
 #include "msvc-posix.h"
 #endif
@@ -26,16 +29,27 @@ class DecompressingStream : public Stream {
     DISALLOW_COPY_AND_ASSIGN(DecompressingStream);
 
 public:
-    DecompressingStream(Stream& input);
+    using Format = CompressingStream::Format;
+
+    // |format| is the one the data was compressed with.
+    DecompressingStream(Stream& input,
+                        Format format = CompressingStream::kStream);
     ~DecompressingStream();
 
     ssize_t read(void* buffer, size_t size) override;
     ssize_t write(const void* buffer, size_t size) override;
 
 private:
+    // Reads of kBlocks data. Blocks that fit in the read are decompressed
+    // in place, others go to mBlock, which is also the get area.
+    ssize_t readBlocks(char* buffer, size_t size);
+
+    const Format mFormat;
     void* mLzStream;
     SmallFixedVector<char, 512> mBuffer;
     int mBufferPos = 0;
+    std::unique_ptr<char[]> mBlock;
+    size_t mBlockCapacity = 0;
 };
 
 }  // namespace base
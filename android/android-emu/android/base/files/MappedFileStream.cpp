@@ -0,0 +1,132 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "android/base/files/MappedFileStream.h"
+
+#include "android/base/system/System.h"
+#include "android/utils/mapfile.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace android {
+namespace base {
+
+MappedFileStream::MappedFileStream(int fd,
+                                   uint64_t offset,
+                                   uint64_t size,
+                                   MemoryHint access) {
+    System::FileSize fileSize;
+    if (!System::get()->fileSize(fd, &fileSize) || offset > fileSize) {
+        return;
+    }
+    size = std::min<uint64_t>(size, fileSize - offset);
+    if (!size || size > SIZE_MAX) {
+        return;
+    }
+
+#ifdef _WIN32
+    auto handle = (MapFile*)_get_osfhandle(fd);
+#else
+    auto handle = (MapFile*)(ptrdiff_t)fd;
+#endif
+    void* data = nullptr;
+    size_t mappedSize = 0;
+    mMapping = mapfile_map(handle, offset, size, PROT_READ, &data,
+                           &mappedSize);
+    if (!mMapping) {
+        return;
+    }
+    mData = static_cast<const uint8_t*>(data);
+    mSize = size;
+    mMappingSize = mData - static_cast<uint8_t*>(mMapping) + size;
+    mGetPos = mData;
+    mGetEnd = mData + mSize;
+
+    if (access != MemoryHint::Normal) {
+        memoryHint(mMapping, mMappingSize, access);
+    }
+}
+
+MappedFileStream::MappedFileStream(MappedFileStream&& other) {
+    *this = std::move(other);
+}
+
+MappedFileStream& MappedFileStream::operator=(MappedFileStream&& other) {
+    if (this != &other) {
+        close();
+        std::swap(mMapping, other.mMapping);
+        std::swap(mMappingSize, other.mMappingSize);
+        std::swap(mData, other.mData);
+        std::swap(mSize, other.mSize);
+        std::swap(mGetPos, other.mGetPos);
+        std::swap(mGetEnd, other.mGetEnd);
+    }
+    return *this;
+}
+
+MappedFileStream::~MappedFileStream() {
+    close();
+}
+
+ssize_t MappedFileStream::read(void* buffer, size_t size) {
+    size = std::min<size_t>(size, mGetEnd - mGetPos);
+    if (size) {
+        memcpy(buffer, mGetPos, size);
+        mGetPos += size;
+    }
+    return static_cast<ssize_t>(size);
+}
+
+ssize_t MappedFileStream::write(const void*, size_t) {
+    return -EPERM;
+}
+
+bool MappedFileStream::seek(uint64_t pos) {
+    if (pos > mSize) {
+        return false;
+    }
+    mGetPos = mData + pos;
+    return true;
+}
+
+const void* MappedFileStream::readInPlace(size_t size) {
+    if (size > size_t(mGetEnd - mGetPos)) {
+        return nullptr;
+    }
+    const void* res = mGetPos;
+    mGetPos += size;
+    return res;
+}
+
+void MappedFileStream::close() {
+    if (mMapping) {
+        mapfile_unmap(mMapping, mMappingSize);
+    }
+    mMapping = nullptr;
+    mMappingSize = 0;
+    mData = nullptr;
+    mSize = 0;
+    mGetPos = nullptr;
+    mGetEnd = nullptr;
+}
+
+}  // namespace base
+}  // namespace android
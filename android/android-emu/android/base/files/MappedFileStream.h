@@ -0,0 +1,80 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#pragma once
+
+#include "android/base/Compiler.h"
+#include "android/base/files/Stream.h"
+#include "android/base/memory/MemoryHints.h"
+
+#include <stdint.h>
+
+namespace android {
+namespace base {
+
+// A read-only Stream over a memory-mapped section of a file.
+//
+// The whole section is the stream's get area, so the get* functions read
+// straight from the mapping, and readInPlace() hands out pointers into it
+// for large blobs that would otherwise be copied out.
+//
+// The file descriptor isn't needed once the stream is constructed, and
+// may be closed right away.
+class MappedFileStream : public Stream {
+public:
+    static constexpr uint64_t kToEnd = UINT64_MAX;
+
+    // Creates an invalid stream.
+    MappedFileStream() = default;
+
+    // Maps |size| bytes of the file |fd| from |offset|, or the rest of the
+    // file for kToEnd, and advises the mapping with |access|. Check valid()
+    // for the result.
+    explicit MappedFileStream(int fd, uint64_t offset = 0,
+                              uint64_t size = kToEnd,
+                              MemoryHint access = MemoryHint::Normal);
+
+    MappedFileStream(MappedFileStream&& other);
+    MappedFileStream& operator=(MappedFileStream&& other);
+
+    ~MappedFileStream();
+
+    // Stream interface implementation. Writes fail with -EPERM.
+    ssize_t read(void* buffer, size_t size) override;
+    ssize_t write(const void* buffer, size_t size) override;
+
+    bool valid() const { return mData != nullptr; }
+    uint64_t size() const { return mSize; }
+    uint64_t readPos() const { return mGetPos - mData; }
+
+    // Moves the read position to |pos|. Returns false if it is past the end.
+    bool seek(uint64_t pos);
+
+    // Returns a pointer to the next |size| bytes of the stream and moves
+    // past them, or nullptr if fewer bytes are left. The data stays valid
+    // until the stream is closed or destroyed.
+    const void* readInPlace(size_t size);
+
+    // Unmaps the file; the stream is invalid afterwards.
+    void close();
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(MappedFileStream);
+
+    // The mapping itself, which starts at an aligned offset before mData.
+    void* mMapping = nullptr;
+    size_t mMappingSize = 0;
+    const uint8_t* mData = nullptr;
+    uint64_t mSize = 0;
+};
+
+}  // namespace base
+}  // namespace android
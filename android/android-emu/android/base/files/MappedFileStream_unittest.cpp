@@ -0,0 +1,196 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "android/base/files/MappedFileStream.h"
+
+#include "android/base/files/BufferedStream.h"
+#include "android/base/files/CompressingStream.h"
+#include "android/base/files/DecompressingStream.h"
+#include "android/base/files/ScopedStdioFile.h"
+#include "android/base/files/StdioStream.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace android {
+namespace base {
+
+// A temporary file with |write| run on it.
+template <class Func>
+static ScopedStdioFile makeFile(Func write) {
+    ScopedStdioFile file(tmpfile());
+    StdioStream stream(file.get());
+    write(&stream);
+    fflush(file.get());
+    return file;
+}
+
+TEST(MappedFileStream, read) {
+    const auto file = makeFile([](Stream* stream) {
+        stream->putByte(1);
+        stream->putBe16(0x203);
+        stream->putBe32(0x4050607);
+        stream->putBe64(0x8090a0b0c0d0e0full);
+        stream->putPackedNum(1234567);
+        stream->putString("mapped");
+    });
+
+    MappedFileStream stream(fileno(file.get()));
+    ASSERT_TRUE(stream.valid());
+    EXPECT_EQ(28, stream.size());
+    EXPECT_EQ(1, stream.getByte());
+    EXPECT_EQ(0x203, stream.getBe16());
+    EXPECT_EQ(0x4050607, stream.getBe32());
+    EXPECT_EQ(0x8090a0b0c0d0e0full, stream.getBe64());
+    EXPECT_EQ(1234567, stream.getPackedNum());
+    EXPECT_EQ("mapped", stream.getString());
+    EXPECT_EQ(stream.size(), stream.readPos());
+
+    char c;
+    EXPECT_EQ(0, stream.read(&c, 1));
+    EXPECT_EQ(0, stream.getBe32());
+    EXPECT_EQ(-EPERM, stream.write(&c, 1));
+}
+
+TEST(MappedFileStream, section) {
+    const auto file = makeFile([](Stream* stream) {
+        for (int i = 0; i < 10000; ++i) {
+            stream->putBe32(i);
+        }
+    });
+
+    // Not aligned to a page.
+    MappedFileStream stream(fileno(file.get()), 4 * 5000, 8);
+    ASSERT_TRUE(stream.valid());
+    EXPECT_EQ(8, stream.size());
+    EXPECT_EQ(5000, stream.getBe32());
+    EXPECT_EQ(5001, stream.getBe32());
+    EXPECT_EQ(0, stream.getBe32());
+
+    MappedFileStream toEnd(fileno(file.get()), 4 * 9999);
+    EXPECT_EQ(4, toEnd.size());
+    EXPECT_EQ(9999, toEnd.getBe32());
+
+    EXPECT_FALSE(MappedFileStream(fileno(file.get()), 40001).valid());
+}
+
+TEST(MappedFileStream, emptyFile) {
+    const auto file = makeFile([](Stream*) {});
+    MappedFileStream stream(fileno(file.get()));
+    EXPECT_FALSE(stream.valid());
+    EXPECT_EQ(0, stream.getBe32());
+}
+
+TEST(MappedFileStream, seekAndReadInPlace) {
+    const std::string blob(100000, 'b');
+    const auto file = makeFile([&blob](Stream* stream) {
+        stream->putBe32(blob.size());
+        stream->write(blob.data(), blob.size());
+    });
+
+    MappedFileStream stream(fileno(file.get()));
+    const auto size = stream.getBe32();
+    const void* data = stream.readInPlace(size);
+    ASSERT_TRUE(data);
+    EXPECT_EQ(0, memcmp(blob.data(), data, size));
+    EXPECT_FALSE(stream.readInPlace(1));
+
+    EXPECT_TRUE(stream.seek(6));
+    EXPECT_EQ(6, stream.readPos());
+    EXPECT_EQ(std::string(4, 'b'),
+              std::string(static_cast<const char*>(stream.readInPlace(4)), 4));
+    EXPECT_TRUE(stream.seek(stream.size()));
+    EXPECT_FALSE(stream.seek(stream.size() + 1));
+    EXPECT_EQ(stream.size(), stream.readPos());
+}
+
+TEST(MappedFileStream, move) {
+    const auto file = makeFile([](Stream* stream) { stream->putBe32(1); });
+
+    MappedFileStream first(fileno(file.get()));
+    MappedFileStream second(std::move(first));
+    EXPECT_FALSE(first.valid());
+    EXPECT_EQ(1, second.getBe32());
+
+    first = std::move(second);
+    EXPECT_TRUE(first.valid());
+    EXPECT_EQ(4, first.readPos());
+    first.close();
+    EXPECT_FALSE(first.valid());
+}
+
+TEST(MappedFileStream, decompress) {
+    std::vector<uint32_t> values(5000);
+    for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = uint32_t(i / 7);
+    }
+    const auto file = makeFile([&values](Stream* stream) {
+        stream->putBe32(0x1234);
+        CompressingStream compressed(*stream);
+        compressed.putBe32Array(values.data(), values.size());
+    });
+
+    MappedFileStream stream(fileno(file.get()));
+    EXPECT_EQ(0x1234, stream.getBe32());
+    DecompressingStream decompressed(stream);
+    std::vector<uint32_t> read(values.size());
+    decompressed.getBe32Array(read.data(), read.size());
+    EXPECT_EQ(values, read);
+    EXPECT_EQ(stream.size(), stream.readPos());
+}
+
+// Blocks written through a BufferedStream can be read in other sizes.
+TEST(MappedFileStream, decompressBlocks) {
+    std::vector<uint8_t> pixels(300 * 1000);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        pixels[i] = uint8_t(i / 100);
+    }
+    const auto file = makeFile([&pixels](Stream* stream) {
+        stream->putBe32(0x1234);
+        CompressingStream compressed(*stream, CompressingStream::kBlocks);
+        BufferedStream buffered(&compressed);
+        for (uint32_t i = 0; i < 1000; ++i) {
+            buffered.putBe32(i);
+        }
+        buffered.putString("pixels");
+        buffered.write(pixels.data(), pixels.size());
+        buffered.putBe64(0x8090a0b0c0d0e0full);
+    });
+
+    MappedFileStream stream(fileno(file.get()));
+    EXPECT_EQ(0x1234, stream.getBe32());
+    DecompressingStream decompressed(stream, CompressingStream::kBlocks);
+    std::vector<uint32_t> values(1000);
+    decompressed.getBe32Array(values.data(), values.size());
+    for (uint32_t i = 0; i < values.size(); ++i) {
+        EXPECT_EQ(i, values[i]);
+    }
+    EXPECT_EQ("pixels", decompressed.getString());
+    std::vector<uint8_t> read(pixels.size());
+    EXPECT_EQ(ssize_t(read.size() / 2),
+              decompressed.read(read.data(), read.size() / 2));
+    EXPECT_EQ(ssize_t(read.size() - read.size() / 2),
+              decompressed.read(read.data() + read.size() / 2,
+                                read.size() - read.size() / 2));
+    EXPECT_EQ(pixels, read);
+    EXPECT_EQ(0x8090a0b0c0d0e0full, decompressed.getBe64());
+    EXPECT_GT(0, decompressed.read(read.data(), 1));
+    EXPECT_EQ(stream.size(), stream.readPos());
+}
+
+}  // namespace base
+}  // namespace android
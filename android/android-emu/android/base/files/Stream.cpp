@@ -11,75 +11,82 @@
 
 #include "android/base/files/Stream.h"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 
 namespace android {
 namespace base {
 
-void Stream::putByte(uint8_t value) {
-    write(&value, 1U);
-}
-
-uint8_t Stream::getByte() {
-    uint8_t value[1] = { 0 };
-    read(value, 1U);
-    return value[0];
-}
-
-void Stream::putBe16(uint16_t value) {
-    uint8_t b[2] = { (uint8_t)(value >> 8), (uint8_t)value };
-    write(b, 2U);
-}
-
-uint16_t Stream::getBe16() {
-    uint8_t b[2] = { 0, 0 };
-    read(b, 2U);
-    return ((uint16_t)b[0] << 8) | (uint16_t)b[1];
-}
-
-void Stream::putBe32(uint32_t value) {
-    uint8_t b[4] = {
-            (uint8_t)(value >> 24),
-            (uint8_t)(value >> 16),
-            (uint8_t)(value >> 8),
-            (uint8_t)value };
-    write(b, 4U);
+// Values converted per putBytes()/getBytes() call by the array functions.
+static constexpr size_t kArrayChunkBytes = 256;
+
+void Stream::putBe32Array(const uint32_t* values, size_t count) {
+    uint8_t b[kArrayChunkBytes];
+    while (count) {
+        const size_t n = std::min(count, sizeof(b) / 4);
+        for (size_t i = 0; i < n; ++i) {
+            const uint32_t value = values[i];
+            b[4 * i] = (uint8_t)(value >> 24);
+            b[4 * i + 1] = (uint8_t)(value >> 16);
+            b[4 * i + 2] = (uint8_t)(value >> 8);
+            b[4 * i + 3] = (uint8_t)value;
+        }
+        putBytes(b, 4 * n);
+        values += n;
+        count -= n;
+    }
 }
 
-uint32_t Stream::getBe32() {
-    uint8_t b[4] = { 0, 0, 0, 0 };
-    read(b, 4U);
-    return ((uint32_t)b[0] << 24) |
-           ((uint32_t)b[1] << 16) |
-           ((uint32_t)b[2] << 8) |
-           (uint32_t)b[3];
+void Stream::putBe64Array(const uint64_t* values, size_t count) {
+    uint8_t b[kArrayChunkBytes];
+    while (count) {
+        const size_t n = std::min(count, sizeof(b) / 8);
+        for (size_t i = 0; i < n; ++i) {
+            const uint64_t value = values[i];
+            for (int j = 0; j < 8; ++j) {
+                b[8 * i + j] = (uint8_t)(value >> (56 - 8 * j));
+            }
+        }
+        putBytes(b, 8 * n);
+        values += n;
+        count -= n;
+    }
 }
 
-void Stream::putBe64(uint64_t value) {
-    uint8_t b[8] = {
-            (uint8_t)(value >> 56),
-            (uint8_t)(value >> 48),
-            (uint8_t)(value >> 40),
-            (uint8_t)(value >> 32),
-            (uint8_t)(value >> 24),
-            (uint8_t)(value >> 16),
-            (uint8_t)(value >> 8),
-            (uint8_t)value };
-    write(b, 8U);
+void Stream::getBe32Array(uint32_t* values, size_t count) {
+    uint8_t b[kArrayChunkBytes];
+    while (count) {
+        const size_t n = std::min(count, sizeof(b) / 4);
+        memset(b, 0, 4 * n);
+        getBytes(b, 4 * n);
+        for (size_t i = 0; i < n; ++i) {
+            values[i] = ((uint32_t)b[4 * i] << 24) |
+                        ((uint32_t)b[4 * i + 1] << 16) |
+                        ((uint32_t)b[4 * i + 2] << 8) | (uint32_t)b[4 * i + 3];
+        }
+        values += n;
+        count -= n;
+    }
 }
 
-uint64_t Stream::getBe64() {
-    uint8_t b[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
-    read(b, 8U);
-    return ((uint64_t)b[0] << 56) |
-           ((uint64_t)b[1] << 48) |
-           ((uint64_t)b[2] << 40) |
-           ((uint64_t)b[3] << 32) |
-           ((uint64_t)b[4] << 24) |
-           ((uint64_t)b[5] << 16) |
-           ((uint64_t)b[6] << 8) |
-           (uint64_t)b[7];
+void Stream::getBe64Array(uint64_t* values, size_t count) {
+    uint8_t b[kArrayChunkBytes];
+    while (count) {
+        const size_t n = std::min(count, sizeof(b) / 8);
+        memset(b, 0, 8 * n);
+        getBytes(b, 8 * n);
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t value = 0;
+            for (int j = 0; j < 8; ++j) {
+                value = (value << 8) | b[8 * i + j];
+            }
+            values[i] = value;
+        }
+        values += n;
+        count -= n;
+    }
 }
 
 void Stream::putFloat(float v) {
@@ -143,20 +150,39 @@ std::string Stream::getString() {
 }
 
 void Stream::putPackedNum(uint64_t num) {
+    // Encode in place if there is room for the longest encoding.
+    uint8_t buffer[10];
+    uint8_t* const out = mPutEnd - mPutPos >= 10 ? mPutPos : buffer;
+    size_t size = 0;
     do {
         auto byte = uint8_t(num & 0x7f);
         num >>= 7;
         if (num) {
             byte |= 0x80;
         }
-        putByte(byte);
+        out[size++] = byte;
     } while (num != 0);
+    if (out == mPutPos) {
+        mPutPos += size;
+    } else {
+        write(buffer, size);
+    }
 }
 
 uint64_t Stream::getPackedNum() {
     uint64_t res = 0;
     uint8_t byte;
     int i = 0;
+    if (mGetEnd - mGetPos >= 10) {
+        // Decode in place if the longest encoding is buffered.
+        const uint8_t* in = mGetPos;
+        do {
+            byte = *in++;
+            res |= uint64_t(byte & 0x7f) << (i++ * 7);
+        } while (byte & 0x80 && i < 10);
+        mGetPos = in;
+        return res;
+    }
     do {
         byte = getByte();
         res |= uint64_t(byte & 0x7f) << (i++ * 7);
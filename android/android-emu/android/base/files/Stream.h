@@ -16,6 +16,7 @@
 #include <string>
 
 #include <inttypes.h>
+#include <string.h>
 #include <sys/types.h>
 
 #ifdef _MSC_VER
@@ -45,31 +46,45 @@ public:
     virtual ssize_t write(const void* buffer, size_t size) = 0;
 
     // Write a single byte |value| into the stream. Ignore errors.
-    void putByte(uint8_t value);
+    void putByte(uint8_t value) { putBe<1>(value); }
 
     // Write a 16-bit |value| as big-endian into the stream. Ignore errors.
-    void putBe16(uint16_t value);
+    void putBe16(uint16_t value) { putBe<2>(value); }
 
     // Write a 32-bit |value| as big-endian into the stream. Ignore errors.
-    void putBe32(uint32_t value);
+    void putBe32(uint32_t value) { putBe<4>(value); }
 
     // Write a 64-bit |value| as big-endian into the stream. Ignore errors.
-    void putBe64(uint64_t value);
+    void putBe64(uint64_t value) { putBe<8>(value); }
 
     // Read a single byte from the stream. Return 0 on error.
-    uint8_t getByte();
+    uint8_t getByte() { return getBe<1, uint8_t>(); }
 
     // Read a single big-endian 16-bit value from the stream.
     // Return 0 on error.
-    uint16_t getBe16();
+    uint16_t getBe16() { return getBe<2, uint16_t>(); }
 
     // Read a single big-endian 32-bit value from the stream.
     // Return 0 on error.
-    uint32_t getBe32();
+    uint32_t getBe32() { return getBe<4, uint32_t>(); }
 
     // Read a single big-endian 64-bit value from the stream.
     // Return 0 on error.
-    uint64_t getBe64();
+    uint64_t getBe64() { return getBe<8, uint64_t>(); }
+
+    // Write |count| 32-bit |values| as big-endian into the stream, in the
+    // same format as that many putBe32() calls. Ignore errors.
+    void putBe32Array(const uint32_t* values, size_t count);
+
+    // Same for 64-bit values.
+    void putBe64Array(const uint64_t* values, size_t count);
+
+    // Read |count| big-endian 32-bit values from the stream into |values|.
+    // The values that could not be read are 0.
+    void getBe32Array(uint32_t* values, size_t count);
+
+    // Same for 64-bit values.
+    void getBe64Array(uint64_t* values, size_t count);
 
     // Write a 32-bit float |value| to the stream.
     void putFloat(float value);
@@ -107,6 +122,67 @@ public:
     // bit + packed unsigned representation)
     void putPackedSignedNum(int64_t num);
     int64_t getPackedSignedNum();
+
+protected:
+    // Buffering streams point these at the free and the unread parts of
+    // their buffer. The put/get functions above then copy to and from there
+    // directly, and only call write() or read() when it is full or empty.
+    // They stay empty in other streams.
+    uint8_t* mPutPos = nullptr;
+    uint8_t* mPutEnd = nullptr;
+    const uint8_t* mGetPos = nullptr;
+    const uint8_t* mGetEnd = nullptr;
+
+private:
+    template <size_t size, class T>
+    void putBe(T value) {
+        uint8_t buffer[size];
+        uint8_t* out =
+                size_t(mPutEnd - mPutPos) >= size ? mPutPos : buffer;
+        for (size_t i = 0; i < size; ++i) {
+            out[i] = uint8_t(value >> (8 * (size - 1 - i)));
+        }
+        if (out == mPutPos) {
+            mPutPos += size;
+        } else {
+            write(buffer, size);
+        }
+    }
+
+    template <size_t size, class T>
+    T getBe() {
+        uint8_t buffer[size] = {};
+        const uint8_t* in = buffer;
+        if (size_t(mGetEnd - mGetPos) >= size) {
+            in = mGetPos;
+            mGetPos += size;
+        } else {
+            read(buffer, size);
+        }
+        T value = 0;
+        for (size_t i = 0; i < size; ++i) {
+            value = T(value << 8) | in[i];
+        }
+        return value;
+    }
+
+    void putBytes(const void* data, size_t size) {
+        if (size_t(mPutEnd - mPutPos) >= size) {
+            ::memcpy(mPutPos, data, size);
+            mPutPos += size;
+        } else {
+            write(data, size);
+        }
+    }
+
+    void getBytes(void* data, size_t size) {
+        if (size_t(mGetEnd - mGetPos) >= size) {
+            ::memcpy(data, mGetPos, size);
+            mGetPos += size;
+        } else {
+            read(data, size);
+        }
+    }
 };
 
 }  // namespace base
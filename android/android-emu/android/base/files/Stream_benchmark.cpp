@@ -0,0 +1,152 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// Measures the per-field cost of Stream serialization, directly on a
+// stream and through a BufferedStream.
+
+#include "android/base/files/BufferedStream.h"
+#include "android/base/files/MemStream.h"
+#include "android/base/files/StdioStream.h"
+
+#include "benchmark/benchmark_api.h"
+
+#include <stdio.h>
+
+#include <memory>
+#include <vector>
+
+using android::base::BufferedStream;
+using android::base::MemStream;
+using android::base::StdioStream;
+using android::base::Stream;
+
+namespace {
+
+// Fields written or read per iteration.
+constexpr int kFields = 4096;
+
+enum class Target { Mem, Stdio };
+
+// The stream written to, directly or through a BufferedStream.
+class WriteTarget {
+public:
+    WriteTarget(Target target, bool buffered) {
+        if (target == Target::Mem) {
+            mStream.reset(new MemStream(kFields * 8));
+        } else {
+            mStream.reset(new StdioStream(tmpfile(), StdioStream::kOwner));
+        }
+        if (buffered) {
+            mBuffered.reset(new BufferedStream(mStream.get()));
+        }
+    }
+
+    Stream* get() { return mBuffered ? mBuffered.get() : mStream.get(); }
+
+    // Starts over once the iteration is done, so memory use stays flat.
+    void reset() {
+        if (mBuffered) {
+            mBuffered->flush();
+        }
+        if (auto mem = dynamic_cast<MemStream*>(mStream.get())) {
+            *mem = MemStream(kFields * 8);
+        } else {
+            rewind(static_cast<StdioStream*>(mStream.get())->get());
+        }
+    }
+
+private:
+    std::unique_ptr<Stream> mStream;
+    std::unique_ptr<BufferedStream> mBuffered;
+};
+
+template <class Func>
+void writeFields(benchmark::State& state,
+                 Target target,
+                 bool buffered,
+                 Func func) {
+    WriteTarget stream(target, buffered);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < kFields; ++i) {
+            func(stream.get(), i);
+        }
+        stream.reset();
+    }
+    state.SetItemsProcessed(state.iterations() * kFields);
+}
+
+template <class Func>
+void readFields(benchmark::State& state, bool buffered, Func func) {
+    MemStream mem(kFields * 16);
+    for (int i = 0; i < 2 * kFields; ++i) {
+        mem.putBe64(i);
+    }
+    while (state.KeepRunning()) {
+        mem.rewind();
+        BufferedStream bufferedStream(&mem);
+        Stream* stream = buffered ? static_cast<Stream*>(&bufferedStream)
+                                  : &mem;
+        for (int i = 0; i < kFields; ++i) {
+            benchmark::DoNotOptimize(func(stream));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kFields);
+}
+
+}  // namespace
+
+// range_x() is 1 for a BufferedStream, 0 otherwise.
+
+void BM_Stream_MemPutBe32(benchmark::State& state) {
+    writeFields(state, Target::Mem, state.range_x(),
+                [](Stream* s, int i) { s->putBe32(i); });
+}
+
+void BM_Stream_StdioPutBe32(benchmark::State& state) {
+    writeFields(state, Target::Stdio, state.range_x(),
+                [](Stream* s, int i) { s->putBe32(i); });
+}
+
+void BM_Stream_MemPutPackedNum(benchmark::State& state) {
+    writeFields(state, Target::Mem, state.range_x(),
+                [](Stream* s, int i) { s->putPackedNum(i); });
+}
+
+void BM_Stream_MemGetBe32(benchmark::State& state) {
+    readFields(state, state.range_x(),
+               [](Stream* s) { return s->getBe32(); });
+}
+
+void BM_Stream_MemGetPackedNum(benchmark::State& state) {
+    readFields(state, state.range_x(),
+               [](Stream* s) { return s->getPackedNum(); });
+}
+
+// All kFields values in one call.
+void BM_Stream_MemPutBe32Array(benchmark::State& state) {
+    std::vector<uint32_t> values(kFields);
+    for (int i = 0; i < kFields; ++i) {
+        values[i] = i;
+    }
+    WriteTarget stream(Target::Mem, state.range_x());
+    while (state.KeepRunning()) {
+        stream.get()->putBe32Array(values.data(), values.size());
+        stream.reset();
+    }
+    state.SetItemsProcessed(state.iterations() * kFields);
+}
+
+BENCHMARK(BM_Stream_MemPutBe32)->Arg(0)->Arg(1);
+BENCHMARK(BM_Stream_StdioPutBe32)->Arg(0)->Arg(1);
+BENCHMARK(BM_Stream_MemPutPackedNum)->Arg(0)->Arg(1);
+BENCHMARK(BM_Stream_MemGetBe32)->Arg(0)->Arg(1);
+BENCHMARK(BM_Stream_MemGetPackedNum)->Arg(0)->Arg(1);
+BENCHMARK(BM_Stream_MemPutBe32Array)->Arg(0)->Arg(1);
@@ -16,6 +16,8 @@
 
 #include <string.h>
 
+#include <vector>
+
 namespace android {
 namespace base {
 
@@ -306,5 +308,61 @@ TEST(Stream, getPackedNum) {
     }
 }
 
+TEST(Stream, putBe32Array) {
+    // More values than fit in one conversion chunk.
+    std::vector<uint32_t> values(100);
+    for (size_t n = 0; n < values.size(); ++n) {
+        values[n] = 0x01020304u * uint32_t(n + 1);
+    }
+    std::vector<uint8_t> expected(4 * values.size());
+    MemoryStream expectedStream(expected.data(), expected.size());
+    for (uint32_t value : values) {
+        expectedStream.putBe32(value);
+    }
+
+    std::vector<uint8_t> buffer(expected.size());
+    MemoryStream stream(buffer.data(), buffer.size());
+    stream.putBe32Array(values.data(), values.size());
+    EXPECT_EQ(expected, buffer);
+
+    std::vector<uint32_t> read(values.size());
+    MemoryStream readStream(buffer.data(), buffer.size());
+    readStream.getBe32Array(read.data(), read.size());
+    EXPECT_EQ(values, read);
+}
+
+TEST(Stream, putBe64Array) {
+    std::vector<uint64_t> values(100);
+    for (size_t n = 0; n < values.size(); ++n) {
+        values[n] = 0x0102030405060708ull * uint64_t(n + 1);
+    }
+    std::vector<uint8_t> expected(8 * values.size());
+    MemoryStream expectedStream(expected.data(), expected.size());
+    for (uint64_t value : values) {
+        expectedStream.putBe64(value);
+    }
+
+    std::vector<uint8_t> buffer(expected.size());
+    MemoryStream stream(buffer.data(), buffer.size());
+    stream.putBe64Array(values.data(), values.size());
+    EXPECT_EQ(expected, buffer);
+
+    std::vector<uint64_t> read(values.size());
+    MemoryStream readStream(buffer.data(), buffer.size());
+    readStream.getBe64Array(read.data(), read.size());
+    EXPECT_EQ(values, read);
+}
+
+TEST(Stream, getBe32ArrayShort) {
+    static const uint8_t kData[] = {0, 0, 0, 1, 0, 0, 0, 2, 3};
+    MemoryStream stream(kData, sizeof(kData));
+    uint32_t values[4] = {5, 5, 5, 5};
+    stream.getBe32Array(values, ARRAY_SIZE(values));
+    EXPECT_EQ(1U, values[0]);
+    EXPECT_EQ(2U, values[1]);
+    EXPECT_EQ(0x03000000U, values[2]);
+    EXPECT_EQ(0U, values[3]);
+}
+
 }  // namespace base
 }  // namespace android
@@ -100,6 +100,7 @@ bool memoryHint(void* start, uint64_t length, MemoryHint hint) {
     // TODO: Find some way to implement those on Windows
     case MemoryHint::Random:
     case MemoryHint::Sequential:
+    case MemoryHint::WillNeed:
         return true;
     default:
         return true;
@@ -139,6 +140,9 @@ bool memoryHint(void* start, uint64_t length, MemoryHint hint) {
         case MemoryHint::Sequential:
             asAdviseFlag = MADV_SEQUENTIAL;
             break;
+        case MemoryHint::WillNeed:
+            asAdviseFlag = MADV_WILLNEED;
+            break;
         case MemoryHint::Touch:
             rewriteMemory(start, length);
             break;
@@ -28,6 +28,8 @@ enum class MemoryHint {
     Normal,
     Random,
     Sequential,
+    // Start reading the pages in ahead of the accesses.
+    WillNeed,
     Touch,
 };
 
@@ -42,6 +42,7 @@ TEST(MemoryHints, Basic) {
         memoryHint(unalignedPtr, pageSize, MemoryHint::Normal);
         memoryHint(unalignedPtr, pageSize, MemoryHint::Random);
         memoryHint(unalignedPtr, pageSize, MemoryHint::Sequential);
+        memoryHint(unalignedPtr, pageSize, MemoryHint::WillNeed);
 
         char* forAlignedPtr = new char[pageSize * 2];
         toDealloc.push_back(forAlignedPtr);
@@ -54,6 +55,7 @@ TEST(MemoryHints, Basic) {
         EXPECT_TRUE(memoryHint(pagePtr, pageSize, MemoryHint::Normal));
         EXPECT_TRUE(memoryHint(pagePtr, pageSize, MemoryHint::Random));
         EXPECT_TRUE(memoryHint(pagePtr, pageSize, MemoryHint::Sequential));
+        EXPECT_TRUE(memoryHint(pagePtr, pageSize, MemoryHint::WillNeed));
 
         // Check that zeroOutMemory works.
         EXPECT_TRUE(zeroOutMemory(pagePtr, pageSize));
@@ -72,6 +74,7 @@ TEST(MemoryHints, Negative) {
     memoryHint(0, 4096, MemoryHint::Normal);
     memoryHint(0, 4096, MemoryHint::Random);
     memoryHint(0, 4096, MemoryHint::Sequential);
+    memoryHint(0, 4096, MemoryHint::WillNeed);
 }
 
 }  // namespace base
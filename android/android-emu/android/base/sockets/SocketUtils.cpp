@@ -24,6 +24,7 @@
 #include "android/base/sockets/Winsock.h"
 #else
 #  include <sys/socket.h>
+#  include <sys/uio.h>
 #  include <unistd.h>
 #  include <fcntl.h>
 #  include <netdb.h>
@@ -39,6 +40,7 @@
 #include <poll.h>
 #endif
 
+#include <algorithm>
 #include <vector>
 
 #include <stdlib.h>
@@ -467,24 +469,94 @@ ssize_t socketRecv(int socket, void* buffer, size_t bufferLen) {
     return ret;
 }
 
-ssize_t socketSend(int socket, const void* buffer, size_t bufferLen) {
-    errno = 0;
 #ifdef MSG_NOSIGNAL
-    // Prevent SIGPIPE generation on Linux when writing to a broken pipe.
-    // ::send() will return -1/EPIPE instead.
-    const int sendFlags = MSG_NOSIGNAL;
+// Prevent SIGPIPE generation on Linux when writing to a broken pipe.
+// ::send() will return -1/EPIPE instead.
+static const int kSendFlags = MSG_NOSIGNAL;
 #else
-    // For Darwin, this is handled by setting SO_NOSIGPIPE when creating
-    // the socket. On Windows, there is no SIGPIPE signal to consider.
-    const int sendFlags = 0;
+// For Darwin, this is handled by setting SO_NOSIGPIPE when creating
+// the socket. On Windows, there is no SIGPIPE signal to consider.
+static const int kSendFlags = 0;
 #endif
+
+ssize_t socketSend(int socket, const void* buffer, size_t bufferLen) {
+    errno = 0;
     ssize_t ret = ::send(socket,
                          reinterpret_cast<const char*>(buffer),
-                         bufferLen, sendFlags);
+                         bufferLen, kSendFlags);
     ON_SOCKET_ERROR_RETURN_M1(ret);
     return ret;
 }
 
+#ifdef _WIN32
+
+static int toWsaBuffers(const SocketBuffer* buffers, int count,
+                        WSABUF* wsaBuffers) {
+    count = std::min(count, kSocketMaxBuffers);
+    for (int i = 0; i < count; ++i) {
+        wsaBuffers[i].buf = static_cast<char*>(buffers[i].data);
+        wsaBuffers[i].len = static_cast<ULONG>(buffers[i].size);
+    }
+    return count;
+}
+
+ssize_t socketRecvv(int socket, const SocketBuffer* buffers, int count) {
+    errno = 0;
+    WSABUF wsaBuffers[kSocketMaxBuffers];
+    count = toWsaBuffers(buffers, count, wsaBuffers);
+    DWORD received = 0;
+    DWORD flags = 0;
+    int ret = ::WSARecv(socket, wsaBuffers, count, &received, &flags, nullptr,
+                        nullptr);
+    ON_SOCKET_ERROR_RETURN_M1(ret);
+    return received;
+}
+
+ssize_t socketSendv(int socket, const SocketBuffer* buffers, int count) {
+    errno = 0;
+    WSABUF wsaBuffers[kSocketMaxBuffers];
+    count = toWsaBuffers(buffers, count, wsaBuffers);
+    DWORD sent = 0;
+    int ret = ::WSASend(socket, wsaBuffers, count, &sent, 0, nullptr, nullptr);
+    ON_SOCKET_ERROR_RETURN_M1(ret);
+    return sent;
+}
+
+#else  // !_WIN32
+
+static int toIovecs(const SocketBuffer* buffers, int count, iovec* iovecs) {
+    count = std::min(count, kSocketMaxBuffers);
+    for (int i = 0; i < count; ++i) {
+        iovecs[i].iov_base = buffers[i].data;
+        iovecs[i].iov_len = buffers[i].size;
+    }
+    return count;
+}
+
+ssize_t socketRecvv(int socket, const SocketBuffer* buffers, int count) {
+    errno = 0;
+    iovec iovecs[kSocketMaxBuffers];
+    msghdr msg = {};
+    msg.msg_iov = iovecs;
+    msg.msg_iovlen = toIovecs(buffers, count, iovecs);
+    ssize_t ret = ::recvmsg(socket, &msg, 0);
+    ON_SOCKET_ERROR_RETURN_M1(ret);
+    return ret;
+}
+
+ssize_t socketSendv(int socket, const SocketBuffer* buffers, int count) {
+    errno = 0;
+    iovec iovecs[kSocketMaxBuffers];
+    msghdr msg = {};
+    msg.msg_iov = iovecs;
+    msg.msg_iovlen = toIovecs(buffers, count, iovecs);
+    ssize_t ret = ::sendmsg(socket, &msg, kSendFlags);
+    ON_SOCKET_ERROR_RETURN_M1(ret);
+    return ret;
+}
+
+#endif  // !_WIN32
+
 bool socketSendAll(int socket, const void* buffer, size_t bufferLen) {
     auto buf = static_cast<const char*>(buffer);
     while (bufferLen > 0) {
@@ -45,6 +45,23 @@ bool socketSendAll(int socket, const void* buffer, size_t bufferLen);
 // Returns ture if all bytes were received, false otherwise.
 bool socketRecvAll(int socket, void* buffer, size_t bufferLen);
 
+// A buffer for socketRecvv() and socketSendv().
+struct SocketBuffer {
+    void* data;
+    size_t size;
+};
+
+// Most buffers socketRecvv() and socketSendv() use in one call.
+constexpr int kSocketMaxBuffers = 64;
+
+// Same as socketRecv() but fills the |count| |buffers| in order, with a
+// single system call. Only the first kSocketMaxBuffers buffers are used.
+ssize_t socketRecvv(int socket, const SocketBuffer* buffers, int count);
+
+// Same as socketSend() but sends the |count| |buffers| in order, with a
+// single system call. Only the first kSocketMaxBuffers buffers are used.
+ssize_t socketSendv(int socket, const SocketBuffer* buffers, int count);
+
 // Shutdown all writes to a socket.
 void socketShutdownWrites(int socket);
 
@@ -62,6 +62,29 @@ TEST(SocketUtils, socketRecvAll) {
     socketClose(sock[0]);
 }
 
+TEST(SocketUtils, socketSendvRecvv) {
+    char kData[] = "Hello World!";
+    const size_t kDataLen = sizeof(kData) - 1U;
+
+    int sock[2];
+    ASSERT_EQ(0, socketCreatePair(&sock[0], &sock[1]));
+
+    const SocketBuffer sendBuffers[] = {
+        {kData, 5}, {kData + 5, 0}, {kData + 5, kDataLen - 5},
+    };
+    EXPECT_EQ((ssize_t)kDataLen, socketSendv(sock[0], sendBuffers, 3));
+
+    char data[kDataLen] = {};
+    const SocketBuffer recvBuffers[] = {
+        {data, 1}, {data + 1, 7}, {data + 8, kDataLen - 8},
+    };
+    EXPECT_EQ((ssize_t)kDataLen, socketRecvv(sock[1], recvBuffers, 3));
+    EXPECT_EQ(0, memcmp(kData, data, kDataLen));
+
+    socketClose(sock[1]);
+    socketClose(sock[0]);
+}
+
 TEST(SocketUtils, socketGetPort) {
     ScopedSocket s0;
     // Find a free TCP IPv4 port and bind to it.
@@ -21,10 +21,21 @@
 #  include <sys/select.h>
 #endif
 
+#ifdef __linux__
+#  include <sys/epoll.h>
+#  include <unistd.h>
+#endif
 
 #include <errno.h>
+#include <limits.h>
 #include <string.h>
 
+#ifdef __linux__
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#endif
+
 namespace android {
 namespace base {
 
@@ -247,10 +258,218 @@ private:
     int mPendingFd;
 };
 
+#ifdef __linux__
+
+// A SocketWaiter based on epoll, which has no FD_SETSIZE limit and only
+// costs in proportion to the descriptors that have events. It is level-
+// triggered, like select(): users don't have to drain a socket to hear
+// about it again.
+class EpollSocketWaiter : public SocketWaiter {
+public:
+    explicit EpollSocketWaiter(int epollFd) : SocketWaiter(), mEpollFd(epollFd) {}
+
+    virtual ~EpollSocketWaiter() {
+        ::close(mEpollFd);
+    }
+
+    virtual void reset() {
+        for (const auto& pair : mWanted) {
+            if (!mUnpollable.count(pair.first)) {
+                ::epoll_ctl(mEpollFd, EPOLL_CTL_DEL, pair.first, nullptr);
+            }
+        }
+        mWanted.clear();
+        mUnpollable.clear();
+        clearPending();
+    }
+
+    virtual unsigned wantedEventsFor(int fd) const {
+        auto it = mWanted.find(fd);
+        return it == mWanted.end() ? 0U : it->second;
+    }
+
+    virtual unsigned pendingEventsFor(int fd) const {
+        auto it = mPending.find(fd);
+        return it == mPending.end() ? 0U : it->second;
+    }
+
+    virtual bool hasFds() const {
+        return !mWanted.empty();
+    }
+
+    virtual void update(int fd, unsigned events) {
+        DCHECK(fd >= 0) << "fd " << fd;
+
+        events &= (kEventRead | kEventWrite);
+        const unsigned oldEvents = wantedEventsFor(fd);
+        if (!events) {
+            if (!oldEvents) {
+                return;
+            }
+            mWanted.erase(fd);
+            if (!mUnpollable.erase(fd)) {
+                // Fails harmlessly if |fd| was closed already.
+                ::epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+            }
+            return;
+        }
+
+        // Re-registered even if |events| didn't change: |fd| may have been
+        // closed and its number reused without update(fd, 0), and epoll
+        // only knows about the file it was added with.
+        struct epoll_event ev = {};
+        ev.events = toEpollEvents(events);
+        ev.data.fd = fd;
+
+        const bool registered = oldEvents && !mUnpollable.count(fd);
+        int ret = ::epoll_ctl(mEpollFd,
+                              registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd,
+                              &ev);
+        if (ret < 0 && errno == ENOENT) {
+            ret = ::epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev);
+        } else if (ret < 0 && errno == EEXIST) {
+            ret = ::epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, &ev);
+        }
+        if (ret < 0 && errno == EPERM) {
+            // Regular files and directories can't be polled, e.g. a stdin
+            // redirected from a file. select() always reports them ready,
+            // and so does wait().
+            mUnpollable.insert(fd);
+            mWanted[fd] = events;
+            return;
+        }
+        if (ret < 0) {
+            LOG(ERROR) << LogString("Can't watch fd %d: %s\n", fd,
+                                    strerror(errno));
+            mWanted.erase(fd);
+            mUnpollable.erase(fd);
+            return;
+        }
+
+        mUnpollable.erase(fd);
+        mWanted[fd] = events;
+    }
+
+    virtual int wait(int64_t timeout_ms) {
+        clearPending();
+
+        // Nothing to wait on.
+        if (mWanted.empty()) {
+            return 0;
+        }
+
+        int timeout;
+        if (!mUnpollable.empty()) {
+            // Those are always ready.
+            timeout = 0;
+        } else if (timeout_ms < 0 || timeout_ms == INT64_MAX) {
+            timeout = -1;
+        } else if (timeout_ms > INT_MAX) {
+            timeout = INT_MAX;
+        } else {
+            timeout = static_cast<int>(timeout_ms);
+        }
+
+        mEvents.resize(mWanted.size());
+
+        int ret;
+        do {
+            ret = ::epoll_wait(mEpollFd, mEvents.data(),
+                               static_cast<int>(mEvents.size()), timeout);
+            if (ret == 0) {
+                errno = ETIMEDOUT;
+            }
+        } while (ret < 0 && errno == EINTR);
+
+        if (ret < 0) {
+            LOG(ERROR) << LogString("Error: %s\n", strerror(errno));
+            return ret;
+        }
+
+        for (int i = 0; i < ret; ++i) {
+            const int fd = mEvents[i].data.fd;
+            // select() reports errors and hang-ups as the fd being ready.
+            const unsigned events = fromEpollEvents(mEvents[i].events) &
+                                    wantedEventsFor(fd);
+            if (events) {
+                mPending[fd] = events;
+                mPendingFds.push_back(fd);
+            }
+        }
+        for (int fd : mUnpollable) {
+            mPending[fd] = wantedEventsFor(fd);
+            mPendingFds.push_back(fd);
+        }
+        return static_cast<int>(mPendingFds.size());
+    }
+
+    virtual int nextPendingFd(unsigned* fdEvents) {
+        if (mNextPending < mPendingFds.size()) {
+            const int fd = mPendingFds[mNextPending++];
+            *fdEvents = pendingEventsFor(fd);
+            return fd;
+        }
+
+        *fdEvents = 0;
+        return -1;
+    }
+
+private:
+    static uint32_t toEpollEvents(unsigned events) {
+        uint32_t result = 0;
+        if (events & kEventRead) {
+            result |= EPOLLIN;
+        }
+        if (events & kEventWrite) {
+            result |= EPOLLOUT;
+        }
+        return result;
+    }
+
+    static unsigned fromEpollEvents(uint32_t events) {
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            return kEventRead | kEventWrite;
+        }
+        unsigned result = 0;
+        if (events & (EPOLLIN | EPOLLRDHUP)) {
+            result |= kEventRead;
+        }
+        if (events & EPOLLOUT) {
+            result |= kEventWrite;
+        }
+        return result;
+    }
+
+    void clearPending() {
+        mPending.clear();
+        mPendingFds.clear();
+        mNextPending = 0;
+    }
+
+    const int mEpollFd;
+    std::unordered_map<int, unsigned> mWanted;
+    // Watched fds that epoll refused with EPERM.
+    std::unordered_set<int> mUnpollable;
+    std::unordered_map<int, unsigned> mPending;
+    std::vector<int> mPendingFds;
+    size_t mNextPending = 0;
+    std::vector<struct epoll_event> mEvents;
+};
+
+#endif  // __linux__
+
 }  // namespace
 
 // static
 SocketWaiter* SocketWaiter::create() {
+#ifdef __linux__
+    const int epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd >= 0) {
+        return new EpollSocketWaiter(epollFd);
+    }
+    LOG(WARNING) << LogString("epoll_create1() failed, using select(): %s\n",
+                              strerror(errno));
+#endif
     return new SelectSocketWaiter();
 }
 
@@ -15,6 +15,16 @@
 
 #include <gtest/gtest.h>
 
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/select.h>
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+#endif
+
 namespace android {
 namespace base {
 
@@ -121,6 +131,126 @@ TEST(SocketWaiter, waitOnWriteEvent) {
     socketClose(s1);
 }
 
+#ifdef __linux__
+// The epoll-based waiter isn't limited to FD_SETSIZE descriptors.
+TEST(SocketWaiter, waitOnManyFds) {
+    const int kPairCount = FD_SETSIZE / 2 + 64;
+
+    struct rlimit limit;
+    ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &limit));
+    if (limit.rlim_cur < (rlim_t)(2 * kPairCount + 64)) {
+        limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, 2 * kPairCount + 64);
+        setrlimit(RLIMIT_NOFILE, &limit);
+        ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &limit));
+        if (limit.rlim_cur < (rlim_t)(2 * kPairCount + 64)) {
+            GTEST_SKIP() << "Not enough file descriptors";
+        }
+    }
+
+    ScopedPtr<SocketWaiter> waiter(SocketWaiter::create());
+
+    std::vector<int> readers, writers;
+    for (int i = 0; i < kPairCount; ++i) {
+        int s1, s2;
+        ASSERT_EQ(0, socketCreatePair(&s1, &s2));
+        readers.push_back(s1);
+        writers.push_back(s2);
+        waiter->update(s1, SocketWaiter::kEventRead);
+    }
+    ASSERT_GE(readers.back(), FD_SETSIZE);
+
+    EXPECT_EQ(0, waiter->wait(0));
+
+    // Only the last one is ready.
+    EXPECT_EQ(1, socketSend(writers.back(), "!", 1));
+    EXPECT_EQ(1, waiter->wait(1000));
+    unsigned events = 0;
+    EXPECT_EQ(readers.back(), waiter->nextPendingFd(&events));
+    EXPECT_EQ(SocketWaiter::kEventRead, events);
+    EXPECT_EQ(SocketWaiter::kEventRead,
+              waiter->pendingEventsFor(readers.back()));
+    EXPECT_EQ(0U, waiter->pendingEventsFor(readers.front()));
+    EXPECT_EQ(-1, waiter->nextPendingFd(&events));
+
+    // Level-triggered: still ready until read.
+    EXPECT_EQ(1, waiter->wait(0));
+
+    waiter->reset();
+    for (int i = 0; i < kPairCount; ++i) {
+        socketClose(readers[i]);
+        socketClose(writers[i]);
+    }
+}
+
+// A descriptor closed while watched can be watched again once its number
+// is reused, with the same events.
+TEST(SocketWaiter, watchReusedFd) {
+    ScopedPtr<SocketWaiter> waiter(SocketWaiter::create());
+
+    int s1, s2;
+    ASSERT_EQ(0, socketCreatePair(&s1, &s2));
+    waiter->update(s1, SocketWaiter::kEventRead);
+    socketClose(s1);
+    socketClose(s2);
+
+    int s3, s4;
+    ASSERT_EQ(0, socketCreatePair(&s3, &s4));
+    ASSERT_EQ(s1, s3);
+
+    waiter->update(s3, SocketWaiter::kEventRead);
+    EXPECT_EQ(0, waiter->wait(0));
+
+    EXPECT_EQ(1, socketSend(s4, "!", 1));
+    EXPECT_EQ(1, waiter->wait(1000));
+    unsigned events = 0;
+    EXPECT_EQ(s3, waiter->nextPendingFd(&events));
+    EXPECT_EQ(SocketWaiter::kEventRead, events);
+
+    waiter->update(s3, 0);
+    EXPECT_FALSE(waiter->hasFds());
+
+    socketClose(s3);
+    socketClose(s4);
+}
+
+// epoll refuses regular files; they are always ready, as with select().
+TEST(SocketWaiter, watchRegularFile) {
+    ScopedPtr<SocketWaiter> waiter(SocketWaiter::create());
+
+    FILE* file = ::tmpfile();
+    ASSERT_TRUE(file);
+    const int fd = ::fileno(file);
+
+    int s1, s2;
+    ASSERT_EQ(0, socketCreatePair(&s1, &s2));
+    waiter->update(s1, SocketWaiter::kEventRead);
+    waiter->update(fd, SocketWaiter::kEventRead | SocketWaiter::kEventWrite);
+    EXPECT_TRUE(waiter->hasFds());
+    EXPECT_EQ(SocketWaiter::kEventRead | SocketWaiter::kEventWrite,
+              waiter->wantedEventsFor(fd));
+
+    EXPECT_EQ(1, waiter->wait(-1));
+    unsigned events = 0;
+    EXPECT_EQ(fd, waiter->nextPendingFd(&events));
+    EXPECT_EQ(SocketWaiter::kEventRead | SocketWaiter::kEventWrite, events);
+    EXPECT_EQ(-1, waiter->nextPendingFd(&events));
+
+    EXPECT_EQ(1, socketSend(s2, "!", 1));
+    EXPECT_EQ(2, waiter->wait(-1));
+    EXPECT_EQ(SocketWaiter::kEventRead, waiter->pendingEventsFor(s1));
+
+    waiter->update(fd, 0);
+    EXPECT_EQ(1, waiter->wait(-1));
+    EXPECT_EQ(s1, waiter->nextPendingFd(&events));
+
+    waiter->reset();
+    EXPECT_FALSE(waiter->hasFds());
+
+    socketClose(s1);
+    socketClose(s2);
+    ::fclose(file);
+}
+#endif  // __linux__
 
 }  // namespace base
 }  // namespace android
@@ -31,7 +31,7 @@ public:
 
     // Add some functions to uncover the internal state
     const TimerSet& timers() const;
-    const TimerList& activeTimers() const;
+    const TimerQueue& activeTimers() const;
     const TimerList& pendingTimers() const;
 
     const FdWatchSet& fdWatches() const;
@@ -69,7 +69,7 @@ inline const DefaultLooper::TimerSet& TestLooper::timers() const {
     return mTimers;
 }
 
-inline const DefaultLooper::TimerList& TestLooper::activeTimers() const {
+inline const DefaultLooper::TimerQueue& TestLooper::activeTimers() const {
     return mActiveTimers;
 }
 
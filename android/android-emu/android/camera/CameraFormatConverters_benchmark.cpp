@@ -0,0 +1,111 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// Measures convert_frame_slow() on a 1080p frame, for every pair of source
+// and destination formats, and how it scales with the number of threads the
+// frame is split across.
+
+#include "android/camera/camera-format-converters.h"
+#include "android/camera/camera-worker-pool.h"
+
+#include "android/base/StringFormat.h"
+
+#include "benchmark/benchmark_api.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kWidth = 1920;
+constexpr int kHeight = 1080;
+
+constexpr uint32_t kSourceFormats[] = {
+        V4L2_PIX_FMT_ARGB32,  V4L2_PIX_FMT_RGB32,   V4L2_PIX_FMT_BGR32,
+        V4L2_PIX_FMT_RGB565,  V4L2_PIX_FMT_RGB24,   V4L2_PIX_FMT_BGR24,
+        V4L2_PIX_FMT_YVU420,  V4L2_PIX_FMT_YUV420,  V4L2_PIX_FMT_NV12,
+        V4L2_PIX_FMT_NV21,    V4L2_PIX_FMT_YUYV,    V4L2_PIX_FMT_YYUV,
+        V4L2_PIX_FMT_YVYU,    V4L2_PIX_FMT_UYVY,    V4L2_PIX_FMT_VYUY,
+        V4L2_PIX_FMT_YYVU,    V4L2_PIX_FMT_SBGGR8,  V4L2_PIX_FMT_SGBRG8,
+        V4L2_PIX_FMT_SGRBG8,  V4L2_PIX_FMT_SRGGB8,  V4L2_PIX_FMT_SBGGR10,
+        V4L2_PIX_FMT_SGBRG10, V4L2_PIX_FMT_SGRBG10, V4L2_PIX_FMT_SRGGB10,
+        V4L2_PIX_FMT_SBGGR12, V4L2_PIX_FMT_SGBRG12, V4L2_PIX_FMT_SGRBG12,
+        V4L2_PIX_FMT_SRGGB12,
+};
+
+// The formats the camera service hands to the guest.
+constexpr uint32_t kDestinationFormats[] = {
+        V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_YVU420, V4L2_PIX_FMT_NV12,
+        V4L2_PIX_FMT_NV21,   V4L2_PIX_FMT_RGB32,  V4L2_PIX_FMT_RGB24,
+};
+
+constexpr int kSourceCount = sizeof(kSourceFormats) / sizeof(uint32_t);
+constexpr int kDestinationCount = sizeof(kDestinationFormats) / sizeof(uint32_t);
+
+std::string fourccToString(uint32_t fourcc) {
+    return std::string(reinterpret_cast<const char*>(&fourcc),
+                       sizeof(uint32_t));
+}
+
+void convertFrames(benchmark::State& state,
+                   uint32_t srcFormat,
+                   uint32_t dstFormat) {
+    size_t srcSize = 0;
+    size_t dstSize = 0;
+    calculate_framebuffer_size(srcFormat, kWidth, kHeight, &srcSize);
+    calculate_framebuffer_size(dstFormat, kWidth, kHeight, &dstSize);
+    std::vector<uint8_t> src(srcSize);
+    std::vector<uint8_t> dst(dstSize);
+    for (size_t i = 0; i < srcSize; ++i) {
+        src[i] = static_cast<uint8_t>(i * 7 + i / kWidth);
+    }
+
+    ClientFrameBuffer framebuffer = {};
+    framebuffer.pixel_format = dstFormat;
+    framebuffer.framebuffer = dst.data();
+
+    // Exposure and white balance, as set by the camera HAL.
+    while (state.KeepRunning()) {
+        convert_frame_slow(src.data(), srcFormat, srcSize, kWidth, kHeight,
+                           &framebuffer, 1, 1.1f, 1.0f, 0.9f, 1.2f);
+    }
+    state.SetItemsProcessed(state.iterations() * kWidth * kHeight);
+    state.SetBytesProcessed(state.iterations() * (srcSize + dstSize));
+}
+
+}  // namespace
+
+// range_x() and range_y() index kSourceFormats and kDestinationFormats.
+void BM_ConvertFrame(benchmark::State& state) {
+    const uint32_t srcFormat = kSourceFormats[state.range_x()];
+    const uint32_t dstFormat = kDestinationFormats[state.range_y()];
+    convertFrames(state, srcFormat, dstFormat);
+    state.SetLabel(fourccToString(srcFormat) + " -> " +
+                   fourccToString(dstFormat));
+}
+
+BENCHMARK(BM_ConvertFrame)->Apply([](benchmark::internal::Benchmark* b) {
+    for (int src = 0; src < kSourceCount; ++src) {
+        for (int dst = 0; dst < kDestinationCount; ++dst) {
+            b->ArgPair(src, dst);
+        }
+    }
+});
+
+// range_x() is the number of threads the frame is split across.
+void BM_ConvertFrame_Threads(benchmark::State& state) {
+    camera_set_stripe_threads(state.range_x());
+    convertFrames(state, V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_NV21);
+    camera_set_stripe_threads(0);
+    state.SetLabel(android::base::StringFormat("%d threads", state.range_x()));
+}
+
+BENCHMARK(BM_ConvertFrame_Threads)->Arg(1)->Arg(2)->Arg(4);
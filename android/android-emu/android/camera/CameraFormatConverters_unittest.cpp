@@ -11,8 +11,11 @@
 
 #include "android/camera/camera-format-converters.h"
 
+#include "android/camera/camera-worker-pool.h"
+
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <vector>
 
 // An arbitrary color that's easily recognizable in hex and different for each
@@ -493,3 +496,93 @@ TEST_P(FrameModifiers, ExpComp) {
 INSTANTIATE_TEST_CASE_P(CameraFormatConverters,
                         FrameModifiers,
                         testing::Values(1.0f, 0.0f, 0.5f, -1.0f, 2.0f));
+
+// Frames large enough to be split across the camera worker pool must convert
+// to the same bytes as when converted on a single thread.
+TEST(CameraFormatConverters, StripesMatchSingleThread) {
+    constexpr int kWidth = 640;
+    constexpr int kHeight = 480;
+
+    for (uint32_t src_format : kSupportedSourceFormats) {
+        std::vector<uint8_t> src(bufferSize(src_format, kWidth, kHeight));
+        uint32_t seed = 1;
+        for (uint8_t& value : src) {
+            seed = seed * 1103515245 + 12345;
+            value = seed >> 16;
+        }
+
+        for (uint32_t dest_format : kSupportedDestinationFormats) {
+            SCOPED_TRACE(testing::Message()
+                         << "source=" << fourccToString(src_format)
+                         << " dest=" << fourccToString(dest_format));
+
+            const size_t destSize = bufferSize(dest_format, kWidth, kHeight);
+            std::vector<uint8_t> dest(destSize);
+            std::vector<uint8_t> destBaseline(destSize);
+
+            ClientFrameBuffer framebuffer = {};
+            framebuffer.pixel_format = dest_format;
+
+            camera_set_stripe_threads(1);
+            framebuffer.framebuffer = destBaseline.data();
+            EXPECT_EQ(0, convert_frame_slow(src.data(), src_format, src.size(),
+                                            kWidth, kHeight, &framebuffer, 1,
+                                            0.9f, 1.1f, 1.2f, 1.5f));
+
+            camera_set_stripe_threads(0);
+            framebuffer.framebuffer = dest.data();
+            EXPECT_EQ(0, convert_frame_slow(src.data(), src_format, src.size(),
+                                            kWidth, kHeight, &framebuffer, 1,
+                                            0.9f, 1.1f, 1.2f, 1.5f));
+
+            ASSERT_EQ(destBaseline, dest);
+        }
+    }
+}
+
+// A uniformly gray bayer frame stays gray, whatever its bit depth.
+TEST(CameraFormatConverters, BayerGray) {
+    constexpr int kWidth = 16;
+    constexpr int kHeight = 8;
+    constexpr uint8_t kGray = 0x80;
+
+    const struct {
+        uint32_t format;
+        uint16_t value;
+    } kBayerFrames[] = {
+            {V4L2_PIX_FMT_SBGGR8, kGray},
+            {V4L2_PIX_FMT_SGRBG8, kGray},
+            {V4L2_PIX_FMT_SRGGB10, kGray << 2},
+            {V4L2_PIX_FMT_SGBRG12, kGray << 4},
+    };
+
+    for (const auto& bayer : kBayerFrames) {
+        SCOPED_TRACE(testing::Message()
+                     << "source=" << fourccToString(bayer.format));
+
+        std::vector<uint8_t> src(bufferSize(bayer.format, kWidth, kHeight));
+        if (bayer.value > 0xFF) {
+            uint16_t* src16 = reinterpret_cast<uint16_t*>(src.data());
+            std::fill(src16, src16 + kWidth * kHeight, bayer.value);
+        } else {
+            std::fill(src.begin(), src.end(), bayer.value);
+        }
+
+        std::vector<uint8_t> dest(
+                bufferSize(V4L2_PIX_FMT_RGB32, kWidth, kHeight));
+        ClientFrameBuffer framebuffer = {};
+        framebuffer.pixel_format = V4L2_PIX_FMT_RGB32;
+        framebuffer.framebuffer = dest.data();
+
+        EXPECT_EQ(0, convert_frame_slow(src.data(), bayer.format, src.size(),
+                                        kWidth, kHeight, &framebuffer, 1,
+                                        kDefaultColorScale, kDefaultColorScale,
+                                        kDefaultColorScale, kDefaultExpComp));
+
+        for (size_t i = 0; i < dest.size(); i += 4) {
+            ASSERT_EQ(kGray, dest[i]) << "pixel " << i / 4;
+            ASSERT_EQ(kGray, dest[i + 1]) << "pixel " << i / 4;
+            ASSERT_EQ(kGray, dest[i + 2]) << "pixel " << i / 4;
+        }
+    }
+}
@@ -15,6 +15,7 @@
  */
 
 #include "android/camera/camera-format-converters.h"
+#include "android/camera/camera-worker-pool.h"
 #include "android/utils/misc.h"
 
 #ifdef __linux__
@@ -26,6 +27,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef __x86_64__
+#include <emmintrin.h>
+#endif
 
 #define  E(...)    derror(__VA_ARGS__)
 #define  W(...)    dwarning(__VA_ARGS__)
@@ -272,27 +278,6 @@ _change_exposure(uint8_t inputY, float exp_comp)
     return (uint8_t)clamp((float)inputY * exp_comp);
 }
 
-/* Adjusts an RGB pixel for the given exposure compensation. */
-static __inline__ void
-_change_exposure_RGB(uint8_t* r, uint8_t* g, uint8_t* b, float exp_comp)
-{
-    uint8_t y, u, v;
-    R8G8B8ToYUV(*r, *g, *b, &y, &u, &v);
-    YUVToRGBPix(_change_exposure(y, exp_comp), u, v, r, g, b);
-}
-
-/* Adjusts an RGB pixel for the given exposure compensation. */
-static __inline__ void
-_change_exposure_RGB_i(int* r, int* g, int* b, float exp_comp)
-{
-    uint8_t y, u, v;
-    R8G8B8ToYUV(*r, *g, *b, &y, &u, &v);
-    y = _change_exposure(y, exp_comp);
-    *r = YUV2RO(y,u,v);
-    *g = YUV2GO(y,u,v);
-    *b = YUV2BO(y,u,v);
-}
-
 /* Computes the pixel value after adjusting the white balance to the current
  * one. The input the y, u, v channel of the pixel and the adjusted value will
  * be stored in place. The adjustment is done in RGB space.
@@ -314,23 +299,6 @@ _change_white_balance_YUV(uint8_t* y,
     *v = RGB2V(r, g, b);
 }
 
-/* Computes the pixel value after adjusting the white balance to the current
- * one. The input the r, and b channels of the pixel and the adjusted value will
- * be stored in place.
- */
-static __inline__ void
-_change_white_balance_RGB(int* r,
-                          int* g,
-                          int* b,
-                          float r_scale,
-                          float g_scale,
-                          float b_scale)
-{
-    *r = (float)*r / r_scale;
-    *g = (float)*g / g_scale;
-    *b = (float)*b / b_scale;
-}
-
 /* Computes the pixel value after adjusting the white balance to the current
  * one. The input the r, and b channels of the pixel and the adjusted value will
  * be stored in place.
@@ -359,7 +327,7 @@ _change_white_balance_RGB_b(uint8_t* r,
  * format from another are:
  * - Is it an RGB, or BRG (i.e. color ordering)
  * - Is it 16, 24, or 32 bits format.
- * All these differences are addressed by load_rgb / save_rgb routines, provided
+ * All these differences are addressed by load_row / save_row routines, provided
  * for each format in the RGB descriptor to load / save RGB color bytes from / to
  * the buffer. As far as moving from one RGB pixel to the next, there
  * are two question to consider:
@@ -432,38 +400,45 @@ _change_white_balance_RGB_b(uint8_t* r,
  * calculated.
  *
  * Performance considerations:
- * Since converters implemented here are intended to work as part of the camera
- * emulation, making the code super performant is not a priority at all. There
- * will be enough loses in other parts of the emultion to overlook any slight
- * inefficiences in the conversion algorithm as neglectable.
+ * Virtual scene and video playback cameras produce large frames, and formats
+ * that libyuv doesn't handle, or white balance, take these converters for every
+ * frame. So a line is loaded into planar R, G, B (or Y, U, V) arrays, white
+ * balance and exposure compensation go through lookup tables built once per
+ * frame, and the color space math runs over the whole line, with SSE2 where
+ * available. Frames are split into stripes of lines, which are converted in
+ * parallel on the camera worker pool.
  */
 
 typedef struct RGBDesc RGBDesc;
 typedef struct YUVDesc YUVDesc;
 typedef struct BayerDesc BayerDesc;
 
-/* Prototype for a routine that loads RGB colors from an RGB/BRG stream.
+/* Prototype for a routine that loads a line of RGB colors from an RGB/BRG
+ * stream.
  * Param:
- *  rgb - Pointer to a pixel inside the stream where to load colors from.
- *  r, g, b - Upon return will contain red, green, and blue colors for the pixel
- *      addressed by 'rgb' pointer.
- * Return:
- *  Pointer to the next pixel in the stream.
+ *  rgb - Pointer to the first pixel of the line inside the stream.
+ *  r, g, b - Upon return will contain red, green, and blue colors for each
+ *      pixel of the line.
+ *  n - Number of pixels to load.
  */
-typedef const void* (*load_rgb_func)(const void* rgb,
-                                     uint8_t* r,
-                                     uint8_t* g,
-                                     uint8_t* b);
-
-/* Prototype for a routine that saves RGB colors to an RGB/BRG stream.
+typedef void (*load_rgb_row_func)(const void* rgb,
+                                  uint8_t* r,
+                                  uint8_t* g,
+                                  uint8_t* b,
+                                  int n);
+
+/* Prototype for a routine that saves a line of RGB colors to an RGB/BRG
+ * stream.
  * Param:
- *  rgb - Pointer to a pixel inside the stream where to save colors.
- *  r, g, b - Red, green, and blue colors to save to the pixel addressed by
- *      'rgb' pointer.
- * Return:
- *  Pointer to the next pixel in the stream.
+ *  rgb - Pointer to the first pixel of the line inside the stream.
+ *  r, g, b - Red, green, and blue colors to save for each pixel of the line.
+ *  n - Number of pixels to save.
  */
-typedef void* (*save_rgb_func)(void* rgb, uint8_t r, uint8_t g, uint8_t b);
+typedef void (*save_rgb_row_func)(void* rgb,
+                                  const uint8_t* r,
+                                  const uint8_t* g,
+                                  const uint8_t* b,
+                                  int n);
 
 /* Prototype for a routine that calculates an offset of the first Y, U or V
  * value for the given line in a YUV framebuffer.
@@ -479,12 +454,12 @@ typedef int (*yuv_offset_func)(const YUVDesc* desc, int line, int width, int hei
 
 /* RGB/BRG format descriptor. */
 struct RGBDesc {
-    /* Routine that loads RGB colors from a buffer. */
-    load_rgb_func   load_rgb;
-    /* Routine that saves RGB colors into a buffer. */
-    save_rgb_func   save_rgb;
+    /* Routine that loads a line of RGB colors from a buffer. */
+    load_rgb_row_func   load_row;
+    /* Routine that saves a line of RGB colors into a buffer. */
+    save_rgb_row_func   save_row;
     /* Byte size of an encoded RGB pixel. */
-    int             rgb_inc;
+    int                 rgb_inc;
 };
 
 /* YUV format descriptor. */
@@ -685,6 +660,35 @@ _save_BRG16(void* rgb, uint8_t r, uint8_t g, uint8_t b)
 }
 #endif
 
+/* Defines the routines that load / save a line of an RGB/BRG framebuffer,
+ * _load_row_<fmt> and _save_row_<fmt>, from the ones for a single pixel. With
+ * the pixel routines inlined, these loops can be vectorized by the compiler. */
+#define RGB_ROW_ROUTINES(fmt)                                                 \
+    static void _load_row_##fmt(const void* rgb, uint8_t* r, uint8_t* g,      \
+                                uint8_t* b, int n) {                          \
+        int x;                                                                \
+        for (x = 0; x < n; x++) {                                             \
+            rgb = _load_##fmt(rgb, &r[x], &g[x], &b[x]);                      \
+        }                                                                     \
+    }                                                                         \
+    static void _save_row_##fmt(void* rgb, const uint8_t* r,                  \
+                                const uint8_t* g, const uint8_t* b, int n) {  \
+        int x;                                                                \
+        for (x = 0; x < n; x++) {                                             \
+            rgb = _save_##fmt(rgb, r[x], g[x], b[x]);                         \
+        }                                                                     \
+    }
+
+RGB_ROW_ROUTINES(ARGB32)
+RGB_ROW_ROUTINES(RGB32)
+RGB_ROW_ROUTINES(BRG32)
+RGB_ROW_ROUTINES(RGB24)
+RGB_ROW_ROUTINES(BRG24)
+RGB_ROW_ROUTINES(RGB16)
+#if 0
+RGB_ROW_ROUTINES(BRG16)
+#endif
+
 /********************************************************************************
  * YUV's Y/U/V offset calculation routines.
  *******************************************************************************/
@@ -1046,237 +1050,435 @@ _get_bayerRGB(const BayerDesc* desc,
 }
 
 /********************************************************************************
- * Generic YUV/RGB/BAYER converters
+ * Line converters
  *******************************************************************************/
 
-/* Generic converter from an RGB/BRG format to a YUV format. */
+/* Lookup tables for the white balance and exposure compensation of a frame. */
+typedef struct ColorTables {
+    /* White balance scales. */
+    float   r_scale;
+    float   g_scale;
+    float   b_scale;
+    /* Whether any of the white balance scales differs from 1. */
+    bool    white_balance;
+    /* Red, green, and blue colors after _change_white_balance_RGB_b. */
+    uint8_t r[256];
+    uint8_t g[256];
+    uint8_t b[256];
+    /* Luminance values after _change_exposure. */
+    uint8_t exposure[256];
+} ColorTables;
+
+/* Builds the lookup tables for the given white balance and exposure
+ * compensation. */
 static void
-RGBToYUV(const RGBDesc* rgb_fmt,
-         const YUVDesc* yuv_fmt,
-         const void* rgb,
-         void* yuv,
-         int width,
-         int height,
-         float r_scale,
-         float g_scale,
-         float b_scale,
-         float exp_comp)
-{
-    int y, x;
-    const int Y_Inc = yuv_fmt->Y_inc;
-    const int UV_inc = yuv_fmt->UV_inc;
-    const int Y_next_pair = yuv_fmt->Y_next_pair;
-    for (y = 0; y < height; y++) {
-        uint8_t* pY =
-            (uint8_t*)yuv + yuv_fmt->y_offset(yuv_fmt, y, width, height);
-        uint8_t* pU =
-            (uint8_t*)yuv + yuv_fmt->u_offset(yuv_fmt, y, width, height);
-        uint8_t* pV =
-            (uint8_t*)yuv + yuv_fmt->v_offset(yuv_fmt, y, width, height);
-        for (x = 0; x < width; x += 2,
-                               pY += Y_next_pair, pU += UV_inc, pV += UV_inc) {
-            uint8_t r, g, b;
-            rgb = rgb_fmt->load_rgb(rgb, &r, &g, &b);
-            _change_white_balance_RGB_b(&r, &g, &b, r_scale, g_scale, b_scale);
-            R8G8B8ToYUV(r, g, b, pY, pU, pV);
-            *pY = _change_exposure(*pY, exp_comp);
-            rgb = rgb_fmt->load_rgb(rgb, &r, &g, &b);
-            _change_white_balance_RGB_b(&r, &g, &b, r_scale, g_scale, b_scale);
-            pY[Y_Inc] =
-                    _change_exposure(RGB2Y((int)r, (int)g, (int)b), exp_comp);
-        }
-        /* Aling rgb_ptr to 16 bit */
-        if (((uintptr_t)rgb & 1) != 0) rgb = (const uint8_t*)rgb + 1;
+_init_color_tables(ColorTables* tables,
+                   float r_scale,
+                   float g_scale,
+                   float b_scale,
+                   float exp_comp)
+{
+    int i;
+    tables->r_scale = r_scale;
+    tables->g_scale = g_scale;
+    tables->b_scale = b_scale;
+    tables->white_balance =
+            r_scale != 1.0f || g_scale != 1.0f || b_scale != 1.0f;
+    for (i = 0; i < 256; i++) {
+        uint8_t r = i, g = i, b = i;
+        _change_white_balance_RGB_b(&r, &g, &b, r_scale, g_scale, b_scale);
+        tables->r[i] = r;
+        tables->g[i] = g;
+        tables->b[i] = b;
+        tables->exposure[i] = _change_exposure(i, exp_comp);
     }
 }
 
-/* Generic converter from one RGB/BRG format to another RGB/BRG format. */
+/* Replaces each of the |n| values in |line| with its entry in |table|. */
 static void
-RGBToRGB(const RGBDesc* src_rgb_fmt,
-         const RGBDesc* dst_rgb_fmt,
-         const void* src_rgb,
-         void* dst_rgb,
-         int width,
-         int height,
-         float r_scale,
-         float g_scale,
-         float b_scale,
-         float exp_comp)
-{
-    int x, y;
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-            uint8_t r, g, b;
-            src_rgb = src_rgb_fmt->load_rgb(src_rgb, &r, &g, &b);
-            _change_white_balance_RGB_b(&r, &g, &b, r_scale, g_scale, b_scale);
-            _change_exposure_RGB(&r, &g, &b, exp_comp);
-            dst_rgb = dst_rgb_fmt->save_rgb(dst_rgb, r, g, b);
-        }
-        /* Aling rgb pinters to 16 bit */
-        if (((uintptr_t)src_rgb & 1) != 0) src_rgb = (uint8_t*)src_rgb + 1;
-        if (((uintptr_t)dst_rgb & 1) != 0) dst_rgb = (uint8_t*)dst_rgb + 1;
+_lookup_line(const uint8_t* table, uint8_t* line, int n)
+{
+    int x;
+    for (x = 0; x < n; x++) {
+        line[x] = table[line[x]];
     }
 }
 
-/* Generic converter from a YUV format to an RGB/BRG format. */
+/* Adjusts a line of RGB pixels for the white balance. */
 static void
-YUVToRGB(const YUVDesc* yuv_fmt,
-         const RGBDesc* rgb_fmt,
-         const void* yuv,
-         void* rgb,
-         int width,
-         int height,
-         float r_scale,
-         float g_scale,
-         float b_scale,
-         float exp_comp)
-{
-    int y, x;
-    const int Y_Inc = yuv_fmt->Y_inc;
-    const int UV_inc = yuv_fmt->UV_inc;
-    const int Y_next_pair = yuv_fmt->Y_next_pair;
-    for (y = 0; y < height; y++) {
-        const uint8_t* pY =
-            (const uint8_t*)yuv + yuv_fmt->y_offset(yuv_fmt, y, width, height);
-        const uint8_t* pU =
-            (const uint8_t*)yuv + yuv_fmt->u_offset(yuv_fmt, y, width, height);
-        const uint8_t* pV =
-            (const uint8_t*)yuv + yuv_fmt->v_offset(yuv_fmt, y, width, height);
-        for (x = 0; x < width; x += 2,
-                               pY += Y_next_pair, pU += UV_inc, pV += UV_inc) {
-            uint8_t r, g, b;
-            const uint8_t U = *pU;
-            const uint8_t V = *pV;
-            YUVToRGBPix(*pY, U, V, &r, &g, &b);
-            _change_white_balance_RGB_b(&r, &g, &b, r_scale, g_scale, b_scale);
-            _change_exposure_RGB(&r, &g, &b, exp_comp);
-            rgb = rgb_fmt->save_rgb(rgb, r, g, b);
-            YUVToRGBPix(pY[Y_Inc], U, V, &r, &g, &b);
-            _change_white_balance_RGB_b(&r, &g, &b, r_scale, g_scale, b_scale);
-            _change_exposure_RGB(&r, &g, &b, exp_comp);
-            rgb = rgb_fmt->save_rgb(rgb, r, g, b);
-        }
-        /* Aling rgb_ptr to 16 bit */
-        if (((uintptr_t)rgb & 1) != 0) rgb = (uint8_t*)rgb + 1;
+_white_balance_line(const ColorTables* tables,
+                    uint8_t* r,
+                    uint8_t* g,
+                    uint8_t* b,
+                    int n)
+{
+    if (tables->white_balance) {
+        _lookup_line(tables->r, r, n);
+        _lookup_line(tables->g, g, n);
+        _lookup_line(tables->b, b, n);
     }
 }
 
-/* Generic converter from one YUV format to another YUV format. */
+#ifdef __x86_64__
+/* A pair of 16-bit values in each 32-bit lane, for _mm_madd_epi16. */
+#define PAIR16(lo, hi) \
+    _mm_set1_epi32((int)(((uint32_t)(uint16_t)(hi) << 16) | (uint16_t)(lo)))
+
+/* RGB2Y on eight 16-bit lanes. The sum fits in an unsigned 16-bit lane. */
+static __inline__ __m128i
+_rgb2y_epi16(__m128i r, __m128i g, __m128i b)
+{
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)),
+                                _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(25)));
+    sum = _mm_add_epi16(sum, _mm_set1_epi16(128));
+    return _mm_add_epi16(_mm_srli_epi16(sum, 8), _mm_set1_epi16(16));
+}
+
+/* RGB2U or RGB2V on eight 16-bit lanes. The sum fits in a signed 16-bit
+ * lane. */
+static __inline__ __m128i
+_rgb2uv_epi16(__m128i r, __m128i g, __m128i b, short cr, short cg, short cb)
+{
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(cr)),
+                                _mm_mullo_epi16(g, _mm_set1_epi16(cg)));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(cb)));
+    sum = _mm_add_epi16(sum, _mm_set1_epi16(128));
+    return _mm_add_epi16(_mm_srai_epi16(sum, 8), _mm_set1_epi16(128));
+}
+
+/* (sum + 128) >> 8 for the 32-bit sums of eight pixels, in 16-bit lanes. */
+static __inline__ __m128i
+_descale_epi32(__m128i lo, __m128i hi)
+{
+    const __m128i round = _mm_set1_epi32(128);
+    return _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(lo, round), 8),
+                           _mm_srai_epi32(_mm_add_epi32(hi, round), 8));
+}
+
+/* YUVToRGBPix on eight 16-bit lanes; the results aren't clamped yet. The
+ * products don't fit in 16 bits, so they are summed in 32-bit lanes. */
+static __inline__ void
+_yuv2rgb_epi16(__m128i y, __m128i u, __m128i v,
+               __m128i* r, __m128i* g, __m128i* b)
+{
+    const __m128i c = _mm_sub_epi16(y, _mm_set1_epi16(16));
+    const __m128i d = _mm_sub_epi16(u, _mm_set1_epi16(128));
+    const __m128i e = _mm_sub_epi16(v, _mm_set1_epi16(128));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i cd_lo = _mm_unpacklo_epi16(c, d);
+    const __m128i cd_hi = _mm_unpackhi_epi16(c, d);
+    const __m128i ce_lo = _mm_unpacklo_epi16(c, e);
+    const __m128i ce_hi = _mm_unpackhi_epi16(c, e);
+    const __m128i e_lo = _mm_unpacklo_epi16(e, zero);
+    const __m128i e_hi = _mm_unpackhi_epi16(e, zero);
+    const __m128i kR = PAIR16(298, 409);
+    const __m128i kG = PAIR16(298, -100);
+    const __m128i kGe = PAIR16(-208, 0);
+    const __m128i kB = PAIR16(298, 516);
+    *r = _descale_epi32(_mm_madd_epi16(ce_lo, kR), _mm_madd_epi16(ce_hi, kR));
+    *g = _descale_epi32(_mm_add_epi32(_mm_madd_epi16(cd_lo, kG),
+                                      _mm_madd_epi16(e_lo, kGe)),
+                        _mm_add_epi32(_mm_madd_epi16(cd_hi, kG),
+                                      _mm_madd_epi16(e_hi, kGe)));
+    *b = _descale_epi32(_mm_madd_epi16(cd_lo, kB), _mm_madd_epi16(cd_hi, kB));
+}
+#endif  // __x86_64__
+
+/* Converts a line of planar RGB pixels to planar YUV, with R8G8B8ToYUV. */
 static void
-YUVToYUV(const YUVDesc* src_fmt,
-         const YUVDesc* dst_fmt,
-         const void* src,
-         void* dst,
-         int width,
-         int height,
-         float r_scale,
-         float g_scale,
-         float b_scale,
-         float exp_comp)
-{
-    int y, x;
-    const int Y_Inc_src = src_fmt->Y_inc;
-    const int UV_inc_src = src_fmt->UV_inc;
-    const int Y_next_pair_src = src_fmt->Y_next_pair;
-    const int Y_Inc_dst = dst_fmt->Y_inc;
-    const int UV_inc_dst = dst_fmt->UV_inc;
-    const int Y_next_pair_dst = dst_fmt->Y_next_pair;
-    for (y = 0; y < height; y++) {
-        const uint8_t* pYsrc =
-            (const uint8_t*)src + src_fmt->y_offset(src_fmt, y, width, height);
-        const uint8_t* pUsrc =
-            (const uint8_t*)src + src_fmt->u_offset(src_fmt, y, width, height);
-        const uint8_t* pVsrc =
-            (const uint8_t*)src + src_fmt->v_offset(src_fmt, y, width, height);
-        uint8_t* pYdst =
-            (uint8_t*)dst + dst_fmt->y_offset(dst_fmt, y, width, height);
-        uint8_t* pUdst =
-            (uint8_t*)dst + dst_fmt->u_offset(dst_fmt, y, width, height);
-        uint8_t* pVdst =
-            (uint8_t*)dst + dst_fmt->v_offset(dst_fmt, y, width, height);
-        for (x = 0; x < width; x += 2, pYsrc += Y_next_pair_src,
-                                       pUsrc += UV_inc_src,
-                                       pVsrc += UV_inc_src,
-                                       pYdst += Y_next_pair_dst,
-                                       pUdst += UV_inc_dst,
-                                       pVdst += UV_inc_dst) {
-            *pYdst = *pYsrc; *pUdst = *pUsrc; *pVdst = *pVsrc;
-            _change_white_balance_YUV(pYdst, pUdst, pVdst, r_scale, g_scale, b_scale);
-            *pYdst = _change_exposure(*pYdst, exp_comp);
-            pYdst[Y_Inc_dst] = _change_exposure(pYsrc[Y_Inc_src], exp_comp);
-        }
+_rgb_to_yuv_line(const uint8_t* r,
+                 const uint8_t* g,
+                 const uint8_t* b,
+                 uint8_t* y,
+                 uint8_t* u,
+                 uint8_t* v,
+                 int n)
+{
+    int x = 0;
+#ifdef __x86_64__
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= n; x += 16) {
+        const __m128i r8 = _mm_loadu_si128((const __m128i*)(r + x));
+        const __m128i g8 = _mm_loadu_si128((const __m128i*)(g + x));
+        const __m128i b8 = _mm_loadu_si128((const __m128i*)(b + x));
+        const __m128i r_lo = _mm_unpacklo_epi8(r8, zero);
+        const __m128i r_hi = _mm_unpackhi_epi8(r8, zero);
+        const __m128i g_lo = _mm_unpacklo_epi8(g8, zero);
+        const __m128i g_hi = _mm_unpackhi_epi8(g8, zero);
+        const __m128i b_lo = _mm_unpacklo_epi8(b8, zero);
+        const __m128i b_hi = _mm_unpackhi_epi8(b8, zero);
+        _mm_storeu_si128((__m128i*)(y + x),
+                         _mm_packus_epi16(_rgb2y_epi16(r_lo, g_lo, b_lo),
+                                          _rgb2y_epi16(r_hi, g_hi, b_hi)));
+        _mm_storeu_si128(
+                (__m128i*)(u + x),
+                _mm_packus_epi16(_rgb2uv_epi16(r_lo, g_lo, b_lo, -38, -74, 112),
+                                 _rgb2uv_epi16(r_hi, g_hi, b_hi, -38, -74, 112)));
+        _mm_storeu_si128(
+                (__m128i*)(v + x),
+                _mm_packus_epi16(_rgb2uv_epi16(r_lo, g_lo, b_lo, 112, -94, -18),
+                                 _rgb2uv_epi16(r_hi, g_hi, b_hi, 112, -94, -18)));
+    }
+#endif  // __x86_64__
+    for (; x < n; x++) {
+        R8G8B8ToYUV(r[x], g[x], b[x], &y[x], &u[x], &v[x]);
     }
 }
 
-/* Generic converter from a BAYER format to an RGB/BRG format. */
+/* Converts a line of planar YUV pixels to planar RGB, with YUVToRGBPix. */
 static void
-BAYERToRGB(const BayerDesc* bayer_fmt,
-           const RGBDesc* rgb_fmt,
-           const void* bayer,
-           void* rgb,
-           int width,
-           int height,
-           float r_scale,
-           float g_scale,
-           float b_scale,
-           float exp_comp)
-{
-    int y, x;
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-            int r, g, b;
-            _get_bayerRGB(bayer_fmt, bayer, x, y, width, height, &r, &g, &b);
-            if (bayer_fmt->mask == kBayer10) {
-                r >>= 2; g >>= 2; b >>= 2;
-            } else if (bayer_fmt->mask == kBayer12) {
-                r >>= 4; g >>= 4; b >>= 4;
-            }
-            _change_white_balance_RGB(&r, &g, &b, r_scale, g_scale, b_scale);
-            _change_exposure_RGB_i(&r, &g, &b, exp_comp);
-            rgb = rgb_fmt->save_rgb(rgb, r, g, b);
-        }
-        /* Aling rgb_ptr to 16 bit */
-        if (((uintptr_t)rgb & 1) != 0) rgb = (uint8_t*)rgb + 1;
+_yuv_to_rgb_line(const uint8_t* y,
+                 const uint8_t* u,
+                 const uint8_t* v,
+                 uint8_t* r,
+                 uint8_t* g,
+                 uint8_t* b,
+                 int n)
+{
+    int x = 0;
+#ifdef __x86_64__
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= n; x += 16) {
+        const __m128i y8 = _mm_loadu_si128((const __m128i*)(y + x));
+        const __m128i u8 = _mm_loadu_si128((const __m128i*)(u + x));
+        const __m128i v8 = _mm_loadu_si128((const __m128i*)(v + x));
+        __m128i r_lo, g_lo, b_lo, r_hi, g_hi, b_hi;
+        _yuv2rgb_epi16(_mm_unpacklo_epi8(y8, zero),
+                       _mm_unpacklo_epi8(u8, zero),
+                       _mm_unpacklo_epi8(v8, zero), &r_lo, &g_lo, &b_lo);
+        _yuv2rgb_epi16(_mm_unpackhi_epi8(y8, zero),
+                       _mm_unpackhi_epi8(u8, zero),
+                       _mm_unpackhi_epi8(v8, zero), &r_hi, &g_hi, &b_hi);
+        /* Saturating to 8 bits does what clamp() does. */
+        _mm_storeu_si128((__m128i*)(r + x), _mm_packus_epi16(r_lo, r_hi));
+        _mm_storeu_si128((__m128i*)(g + x), _mm_packus_epi16(g_lo, g_hi));
+        _mm_storeu_si128((__m128i*)(b + x), _mm_packus_epi16(b_lo, b_hi));
+    }
+#endif  // __x86_64__
+    for (; x < n; x++) {
+        YUVToRGBPix(y[x], u[x], v[x], &r[x], &g[x], &b[x]);
     }
 }
 
-/* Generic converter from a BAYER format to a YUV format. */
+/* Loads |n| pixels of a line of a YUV framebuffer into planar Y, U, and V
+ * lines. Both pixels of a pair get the U and V of the pair. |n| is even. */
+static void
+_load_yuv_line(const YUVDesc* desc,
+               const void* yuv,
+               int line,
+               int width,
+               int height,
+               uint8_t* y,
+               uint8_t* u,
+               uint8_t* v,
+               int n)
+{
+    const uint8_t* pY =
+        (const uint8_t*)yuv + desc->y_offset(desc, line, width, height);
+    const uint8_t* pU =
+        (const uint8_t*)yuv + desc->u_offset(desc, line, width, height);
+    const uint8_t* pV =
+        (const uint8_t*)yuv + desc->v_offset(desc, line, width, height);
+    const int Y_Inc = desc->Y_inc;
+    const int UV_inc = desc->UV_inc;
+    const int Y_next_pair = desc->Y_next_pair;
+    int x;
+    for (x = 0; x < n; x += 2, pY += Y_next_pair, pU += UV_inc, pV += UV_inc) {
+        y[x] = pY[0];
+        y[x + 1] = pY[Y_Inc];
+        u[x] = u[x + 1] = *pU;
+        v[x] = v[x + 1] = *pV;
+    }
+}
+
+/* Saves |n| pixels of planar Y, U, and V lines to a line of a YUV framebuffer.
+ * Each pair of pixels takes the U and V of its first pixel. |n| is even. */
+static void
+_save_yuv_line(const YUVDesc* desc,
+               void* yuv,
+               int line,
+               int width,
+               int height,
+               const uint8_t* y,
+               const uint8_t* u,
+               const uint8_t* v,
+               int n)
+{
+    uint8_t* pY = (uint8_t*)yuv + desc->y_offset(desc, line, width, height);
+    uint8_t* pU = (uint8_t*)yuv + desc->u_offset(desc, line, width, height);
+    uint8_t* pV = (uint8_t*)yuv + desc->v_offset(desc, line, width, height);
+    const int Y_Inc = desc->Y_inc;
+    const int UV_inc = desc->UV_inc;
+    const int Y_next_pair = desc->Y_next_pair;
+    int x;
+    for (x = 0; x < n; x += 2, pY += Y_next_pair, pU += UV_inc, pV += UV_inc) {
+        pY[0] = y[x];
+        pY[Y_Inc] = y[x + 1];
+        *pU = u[x];
+        *pV = v[x];
+    }
+}
+
+/* Number of bits a BAYER color is shifted right by to fit in 8 bits. */
+static __inline__ int
+_get_bayer_shift(const BayerDesc* desc)
+{
+    if (desc->mask == kBayer10) {
+        return 2;
+    } else if (desc->mask == kBayer12) {
+        return 4;
+    }
+    return 0;
+}
+
+#ifdef __x86_64__
+/* Neighbourhoods of a pixel in a bayer framebuffer that a color is taken from,
+ * as in _get_bayerRGB. */
+enum {
+    BAYER_PIXEL,
+    BAYER_AVE_HOR,
+    BAYER_AVE_VERT,
+    BAYER_AVE_CROSS,
+    BAYER_AVE_DIAG,
+    BAYER_NEIGHBOURHOODS
+};
+
+/* Gets the neighbourhood that red, green, and blue come from, for the pixels
+ * at an even and at an odd x in a line of a bayer framebuffer. */
 static void
-BAYERToYUV(const BayerDesc* bayer_fmt,
-           const YUVDesc* yuv_fmt,
-           const void* bayer,
-           void* yuv,
-           int width,
-           int height,
-           float r_scale,
-           float g_scale,
-           float b_scale,
-           float exp_comp)
-{
-    int y, x;
-    const int Y_Inc = yuv_fmt->Y_inc;
-    const int UV_inc = yuv_fmt->UV_inc;
-    const int Y_next_pair = yuv_fmt->Y_next_pair;
-    for (y = 0; y < height; y++) {
-        uint8_t* pY =
-            (uint8_t*)yuv + yuv_fmt->y_offset(yuv_fmt, y, width, height);
-        uint8_t* pU =
-            (uint8_t*)yuv + yuv_fmt->u_offset(yuv_fmt, y, width, height);
-        uint8_t* pV =
-            (uint8_t*)yuv + yuv_fmt->v_offset(yuv_fmt, y, width, height);
-        for (x = 0; x < width; x += 2,
-                               pY += Y_next_pair, pU += UV_inc, pV += UV_inc) {
-            int r, g, b;
-            _get_bayerRGB(bayer_fmt, bayer, x, y, width, height, &r, &g, &b);
-            _change_white_balance_RGB(&r, &g, &b, r_scale, g_scale, b_scale);
-            _change_exposure_RGB_i(&r, &g, &b, exp_comp);
-            R8G8B8ToYUV(r, g, b, pY, pU, pV);
-            _get_bayerRGB(bayer_fmt, bayer, x + 1, y, width, height, &r, &g, &b);
-            _change_white_balance_RGB(&r, &g, &b, r_scale, g_scale, b_scale);
-            _change_exposure_RGB_i(&r, &g, &b, exp_comp);
-            pY[Y_Inc] = RGB2Y(r, g, b);
+_get_bayer_sources(const BayerDesc* desc, int line, int sources[3][2])
+{
+    int parity;
+    for (parity = 0; parity < 2; parity++) {
+        const char pixel_color = _get_bayer_color_sel(desc, parity, line);
+        if (pixel_color == 'G') {
+            const bool red_next =
+                    _get_bayer_color_sel(desc, parity + 1, line) == 'R';
+            sources[0][parity] = red_next ? BAYER_AVE_HOR : BAYER_AVE_VERT;
+            sources[1][parity] = BAYER_PIXEL;
+            sources[2][parity] = red_next ? BAYER_AVE_VERT : BAYER_AVE_HOR;
+        } else if (pixel_color == 'R') {
+            sources[0][parity] = BAYER_PIXEL;
+            sources[1][parity] = BAYER_AVE_CROSS;
+            sources[2][parity] = BAYER_AVE_DIAG;
+        } else {
+            sources[0][parity] = BAYER_AVE_DIAG;
+            sources[1][parity] = BAYER_AVE_CROSS;
+            sources[2][parity] = BAYER_PIXEL;
+        }
+    }
+}
+
+/* Loads the eight bayer pixels at |pixel| into 16-bit lanes. */
+static __inline__ __m128i
+_load_bayer_epi16(const BayerDesc* desc, const uint8_t* pixel)
+{
+    if (desc->mask == kBayer8) {
+        return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)pixel),
+                                 _mm_setzero_si128());
+    }
+    return _mm_and_si128(_mm_loadu_si128((const __m128i*)pixel),
+                         _mm_set1_epi16(desc->mask));
+}
+
+/* Calculates 8-bit RGB colors for the pixels of a line of a bayer framebuffer
+ * that are away from its edges, from x = 1 on, eight pixels at a time. The
+ * line must be neither the first nor the last one.
+ * Return:
+ *  The x of the first pixel that is left to calculate.
+ */
+static int
+_get_bayer_line_inner(const BayerDesc* desc,
+                      const void* buf,
+                      int line,
+                      int width,
+                      uint8_t* r,
+                      uint8_t* g,
+                      uint8_t* b)
+{
+    const int bpp = desc->mask == kBayer8 ? 1 : 2;
+    const uint8_t* cur = (const uint8_t*)buf + (size_t)line * width * bpp;
+    const uint8_t* up = cur - width * bpp;
+    const uint8_t* down = cur + width * bpp;
+    const __m128i shift = _mm_cvtsi32_si128(_get_bayer_shift(desc));
+    /* x starts odd, so the pixels at an even x are in the odd lanes. */
+    const __m128i even = _mm_set_epi16(-1, 0, -1, 0, -1, 0, -1, 0);
+    uint8_t* const colors[3] = {r, g, b};
+    int sources[3][2];
+    int x, c;
+
+    _get_bayer_sources(desc, line, sources);
+    for (x = 1; x + 8 < width; x += 8) {
+        const int at = x * bpp;
+        const __m128i left = _load_bayer_epi16(desc, cur + at - bpp);
+        const __m128i right = _load_bayer_epi16(desc, cur + at + bpp);
+        const __m128i above = _load_bayer_epi16(desc, up + at);
+        const __m128i below = _load_bayer_epi16(desc, down + at);
+        const __m128i hor = _mm_add_epi16(left, right);
+        const __m128i vert = _mm_add_epi16(above, below);
+        const __m128i diag = _mm_add_epi16(
+                _mm_add_epi16(_load_bayer_epi16(desc, up + at - bpp),
+                              _load_bayer_epi16(desc, up + at + bpp)),
+                _mm_add_epi16(_load_bayer_epi16(desc, down + at - bpp),
+                              _load_bayer_epi16(desc, down + at + bpp)));
+        __m128i values[BAYER_NEIGHBOURHOODS];
+        values[BAYER_PIXEL] = _load_bayer_epi16(desc, cur + at);
+        values[BAYER_AVE_HOR] = _mm_srli_epi16(hor, 1);
+        values[BAYER_AVE_VERT] = _mm_srli_epi16(vert, 1);
+        values[BAYER_AVE_CROSS] = _mm_srli_epi16(_mm_add_epi16(hor, vert), 2);
+        values[BAYER_AVE_DIAG] = _mm_srli_epi16(diag, 2);
+        for (c = 0; c < 3; c++) {
+            const __m128i color = _mm_or_si128(
+                    _mm_and_si128(even, values[sources[c][0]]),
+                    _mm_andnot_si128(even, values[sources[c][1]]));
+            _mm_storel_epi64(
+                    (__m128i*)(colors[c] + x),
+                    _mm_packus_epi16(_mm_srl_epi16(color, shift),
+                                     _mm_setzero_si128()));
         }
     }
+    return x;
+}
+#endif  // __x86_64__
+
+/* Loads |n| pixels of a line of a bayer framebuffer as 8-bit RGB colors.
+ * Pixels past the width of the frame repeat the last pixel of the line. */
+static void
+_load_bayer_line(const BayerDesc* desc,
+                 const void* buf,
+                 int line,
+                 int width,
+                 int height,
+                 uint8_t* r,
+                 uint8_t* g,
+                 uint8_t* b,
+                 int n)
+{
+    const int shift = _get_bayer_shift(desc);
+    int x, red, green, blue;
+
+    _get_bayerRGB(desc, buf, 0, line, width, height, &red, &green, &blue);
+    r[0] = red >> shift;
+    g[0] = green >> shift;
+    b[0] = blue >> shift;
+    x = 1;
+#ifdef __x86_64__
+    if (line > 0 && line < height - 1) {
+        x = _get_bayer_line_inner(desc, buf, line, width, r, g, b);
+    }
+#endif  // __x86_64__
+    for (; x < width; x++) {
+        _get_bayerRGB(desc, buf, x, line, width, height, &red, &green, &blue);
+        r[x] = red >> shift;
+        g[x] = green >> shift;
+        b[x] = blue >> shift;
+    }
+    for (; x < n; x++) {
+        r[x] = r[width - 1];
+        g[x] = g[width - 1];
+        b[x] = b[width - 1];
+    }
 }
 
 /********************************************************************************
@@ -1286,48 +1488,48 @@ BAYERToYUV(const BayerDesc* bayer_fmt,
 /* Describes RGB32 format. */
 static const RGBDesc _ARGB32 =
 {
-    .load_rgb   = _load_ARGB32,
-    .save_rgb   = _save_ARGB32,
+    .load_row   = _load_row_ARGB32,
+    .save_row   = _save_row_ARGB32,
     .rgb_inc    = 4
 };
 
 /* Describes RGB32 format. */
 static const RGBDesc _RGB32 =
 {
-    .load_rgb   = _load_RGB32,
-    .save_rgb   = _save_RGB32,
+    .load_row   = _load_row_RGB32,
+    .save_row   = _save_row_RGB32,
     .rgb_inc    = 4
 };
 
 /* Describes BRG32 format. */
 static const RGBDesc _BRG32 =
 {
-    .load_rgb   = _load_BRG32,
-    .save_rgb   = _save_BRG32,
+    .load_row   = _load_row_BRG32,
+    .save_row   = _save_row_BRG32,
     .rgb_inc    = 4
 };
 
 /* Describes RGB24 format. */
 static const RGBDesc _RGB24 =
 {
-    .load_rgb   = _load_RGB24,
-    .save_rgb   = _save_RGB24,
+    .load_row   = _load_row_RGB24,
+    .save_row   = _save_row_RGB24,
     .rgb_inc    = 3
 };
 
 /* Describes BRG24 format. */
 static const RGBDesc _BRG24 =
 {
-    .load_rgb   = _load_BRG24,
-    .save_rgb   = _save_BRG24,
+    .load_row   = _load_row_BRG24,
+    .save_row   = _save_row_BRG24,
     .rgb_inc    = 3
 };
 
 /* Describes RGB16 format. */
 static const RGBDesc _RGB16 =
 {
-    .load_rgb   = _load_RGB16,
-    .save_rgb   = _save_RGB16,
+    .load_row   = _load_row_RGB16,
+    .save_row   = _save_row_RGB16,
     .rgb_inc    = 2
 };
 
@@ -1335,8 +1537,8 @@ static const RGBDesc _RGB16 =
 /* Describes BRG16 format. */
 static const RGBDesc _BRG16 =
 {
-    .load_rgb   = _load_BRG16,
-    .save_rgb   = _save_BRG16,
+    .load_row   = _load_row_BRG16,
+    .save_row   = _save_row_BRG16,
     .rgb_inc    = 2
 };
 #endif
@@ -1750,6 +1952,125 @@ static uint32_t pixel_format_to_libyuv(uint32_t pixel_format) {
     return pixel_format;
 }
 
+/********************************************************************************
+ * Frame converters
+ *******************************************************************************/
+
+/* A frame being converted from one pixel format to another. */
+typedef struct FrameConversion {
+    const PIXFormat*    src_desc;
+    const PIXFormat*    dst_desc;
+    const void*         src;
+    void*               dst;
+    int                 width;
+    int                 height;
+    /* Number of pixels converted in each line: conversions to or from a YUV
+     * format go by pairs of pixels, so for them the width is rounded up. */
+    int                 line_pixels;
+    ColorTables         tables;
+} FrameConversion;
+
+/* Gets the address of a line in an RGB/BRG framebuffer, where lines of
+ * |pixels| pixels are aligned to 16 bits. */
+static __inline__ const uint8_t*
+_get_rgb_line(const RGBDesc* desc, const void* rgb, int line, int pixels)
+{
+    return (const uint8_t*)rgb +
+           (size_t)line * align(pixels * desc->rgb_inc, 2);
+}
+
+/* Converts the lines [begin, end) of a frame. This is a CameraStripeFunc, run
+ * on the camera worker pool. */
+static void
+_convert_lines(void* opaque, int begin, int end)
+{
+    const FrameConversion* conv = (const FrameConversion*)opaque;
+    const PIXFormat* src_desc = conv->src_desc;
+    const PIXFormat* dst_desc = conv->dst_desc;
+    const ColorTables* tables = &conv->tables;
+    const int width = conv->width;
+    const int height = conv->height;
+    const int n = conv->line_pixels;
+    uint8_t* const lines = (uint8_t*)malloc(7 * (size_t)n);
+    uint8_t *r, *g, *b, *y, *u, *v, *y_balanced;
+    int line, x;
+
+    if (lines == NULL) {
+        E("%s: Unable to allocate %d pixel lines", __FUNCTION__, n);
+        return;
+    }
+    r = lines;
+    g = r + n;
+    b = g + n;
+    y = b + n;
+    u = y + n;
+    v = u + n;
+    y_balanced = v + n;
+
+    for (line = begin; line < end; line++) {
+        /* Load the line as planar RGB, or planar YUV for a YUV source. */
+        switch (src_desc->format_sel) {
+            case PIX_FMT_RGB:
+                src_desc->desc.rgb_desc->load_row(
+                        _get_rgb_line(src_desc->desc.rgb_desc, conv->src,
+                                      line, n),
+                        r, g, b, n);
+                break;
+            case PIX_FMT_YUV:
+                _load_yuv_line(src_desc->desc.yuv_desc, conv->src, line,
+                               width, height, y, u, v, n);
+                break;
+            case PIX_FMT_BAYER:
+                _load_bayer_line(src_desc->desc.bayer_desc, conv->src, line,
+                                 width, height, r, g, b, n);
+                break;
+        }
+
+        if (src_desc->format_sel == PIX_FMT_YUV) {
+            if (dst_desc->format_sel == PIX_FMT_YUV) {
+                /* White balance is applied to the first pixel of each pair,
+                 * whose U and V the pair keeps. */
+                if (tables->white_balance) {
+                    for (x = 0; x < n; x += 2) {
+                        _change_white_balance_YUV(&y[x], &u[x], &v[x],
+                                                  tables->r_scale,
+                                                  tables->g_scale,
+                                                  tables->b_scale);
+                    }
+                } else {
+                    _yuv_to_rgb_line(y, u, v, r, g, b, n);
+                    _rgb_to_yuv_line(r, g, b, y_balanced, u, v, n);
+                    for (x = 0; x < n; x += 2) {
+                        y[x] = y_balanced[x];
+                    }
+                }
+                _lookup_line(tables->exposure, y, n);
+                _save_yuv_line(dst_desc->desc.yuv_desc, conv->dst, line,
+                               width, height, y, u, v, n);
+                continue;
+            }
+            _yuv_to_rgb_line(y, u, v, r, g, b, n);
+        }
+
+        _white_balance_line(tables, r, g, b, n);
+        /* Exposure compensation is applied to the luminance. */
+        _rgb_to_yuv_line(r, g, b, y, u, v, n);
+        _lookup_line(tables->exposure, y, n);
+        if (dst_desc->format_sel == PIX_FMT_RGB) {
+            _yuv_to_rgb_line(y, u, v, r, g, b, n);
+            dst_desc->desc.rgb_desc->save_row(
+                    (uint8_t*)_get_rgb_line(dst_desc->desc.rgb_desc,
+                                            conv->dst, line, n),
+                    r, g, b, n);
+        } else {
+            _save_yuv_line(dst_desc->desc.yuv_desc, conv->dst, line, width,
+                           height, y, u, v, n);
+        }
+    }
+
+    free(lines);
+}
+
 /********************************************************************************
  * Public API
  *******************************************************************************/
@@ -1808,6 +2129,7 @@ int convert_frame_slow(const void* src_frame,
                        float exp_comp)
 {
     int n;
+    FrameConversion conv;
     const PIXFormat* src_desc = get_pixel_format_descriptor(pixel_format);
     if (src_desc == NULL) {
         E("%s: Source pixel format %.4s is unknown",
@@ -1815,6 +2137,12 @@ int convert_frame_slow(const void* src_frame,
         return -1;
     }
 
+    conv.src_desc = src_desc;
+    conv.src = src_frame;
+    conv.width = width;
+    conv.height = height;
+    _init_color_tables(&conv.tables, r_scale, g_scale, b_scale, exp_comp);
+
     for (n = 0; n < fbs_num; n++) {
         /* Note that we need to apply white balance, exposure compensation, etc.
          * when we transfer the captured frame to the user framebuffer. So, even
@@ -1827,58 +2155,24 @@ int convert_frame_slow(const void* src_frame,
               __FUNCTION__, (const char*)&framebuffers[n].pixel_format);
             return -1;
         }
-        switch (src_desc->format_sel) {
-            case PIX_FMT_RGB:
-                if (dst_desc->format_sel == PIX_FMT_RGB) {
-                    RGBToRGB(src_desc->desc.rgb_desc, dst_desc->desc.rgb_desc,
-                             src_frame, framebuffers[n].framebuffer, width,
-                             height, r_scale, g_scale, b_scale, exp_comp);
-                } else if (dst_desc->format_sel == PIX_FMT_YUV) {
-                    RGBToYUV(src_desc->desc.rgb_desc, dst_desc->desc.yuv_desc,
-                             src_frame, framebuffers[n].framebuffer, width,
-                             height, r_scale, g_scale, b_scale, exp_comp);
-                } else {
-                    E("%s: Unexpected destination pixel format %d",
-                      __FUNCTION__, dst_desc->format_sel);
-                    return -1;
-                }
-                break;
-            case PIX_FMT_YUV:
-                if (dst_desc->format_sel == PIX_FMT_RGB) {
-                    YUVToRGB(src_desc->desc.yuv_desc, dst_desc->desc.rgb_desc,
-                             src_frame, framebuffers[n].framebuffer, width,
-                             height, r_scale, g_scale, b_scale, exp_comp);
-                } else if (dst_desc->format_sel == PIX_FMT_YUV) {
-                    YUVToYUV(src_desc->desc.yuv_desc, dst_desc->desc.yuv_desc,
-                             src_frame, framebuffers[n].framebuffer, width,
-                             height, r_scale, g_scale, b_scale, exp_comp);
-                } else {
-                    E("%s: Unexpected destination pixel format %d",
-                      __FUNCTION__, dst_desc->format_sel);
-                    return -1;
-                }
-                break;
-            case PIX_FMT_BAYER:
-                if (dst_desc->format_sel == PIX_FMT_RGB) {
-                    BAYERToRGB(src_desc->desc.bayer_desc,
-                               dst_desc->desc.rgb_desc, src_frame,
-                               framebuffers[n].framebuffer, width, height,
-                               r_scale, g_scale, b_scale, exp_comp);
-                } else if (dst_desc->format_sel == PIX_FMT_YUV) {
-                    BAYERToYUV(src_desc->desc.bayer_desc,
-                               dst_desc->desc.yuv_desc, src_frame,
-                               framebuffers[n].framebuffer, width, height,
-                               r_scale, g_scale, b_scale, exp_comp);
-                } else {
-                    E("%s: Unexpected destination pixel format %d",
-                      __FUNCTION__, dst_desc->format_sel);
-                    return -1;
-                }
-                break;
-            default:
-                E("%s: Unexpected source pixel format %d",
-                  __FUNCTION__, dst_desc->format_sel);
-                return -1;
+        if (dst_desc->format_sel == PIX_FMT_BAYER) {
+            E("%s: Unexpected destination pixel format %d",
+              __FUNCTION__, dst_desc->format_sel);
+            return -1;
+        }
+
+        conv.dst_desc = dst_desc;
+        conv.dst = framebuffers[n].framebuffer;
+        conv.line_pixels = src_desc->format_sel != PIX_FMT_YUV &&
+                                           dst_desc->format_sel == PIX_FMT_RGB
+                                   ? width
+                                   : align(width, 2);
+        if (width & 1) {
+            /* With an odd width, the last pair of pixels of a YUV line spills
+             * over to the next line; convert the lines in order. */
+            _convert_lines(&conv, 0, height);
+        } else {
+            camera_run_stripes(height, width, _convert_lines, &conv);
         }
     }
 
@@ -2070,13 +2364,15 @@ int convert_frame_fast(const void* src_frame,
 
         // Apply exposure compensation.
         if (exp_comp != 1.0f) {
+            uint8_t exposure[256];
             int row;
-            int x;
+            int i;
+            for (i = 0; i < 256; ++i) {
+                exposure[i] = _change_exposure(i, exp_comp);
+            }
             for (row = 0; row < result_height; ++row) {
-                uint8_t* y_row = src_y + row * src_info.y_stride;
-                for (x = 0; x < result_width; ++x) {
-                    y_row[x] = _change_exposure(y_row[x], exp_comp);
-                }
+                _lookup_line(exposure, src_y + row * src_info.y_stride,
+                             result_width);
             }
         }
 
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "android/camera/camera-worker-pool.h"
+
+#include "android/base/Optional.h"
+#include "android/base/memory/LazyInstance.h"
+#include "android/base/synchronization/ConditionVariable.h"
+#include "android/base/synchronization/Lock.h"
+#include "android/base/system/System.h"
+#include "android/base/threads/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+using android::base::AutoLock;
+using android::base::ConditionVariable;
+using android::base::LazyInstance;
+using android::base::Lock;
+using android::base::Optional;
+using android::base::System;
+using android::base::ThreadPool;
+
+namespace {
+
+// Most threads a frame is split across, the calling one included. The camera
+// shares the host with the vCPUs and the GPU emulation.
+constexpr int kMaxThreads = 4;
+
+// Smallest number of pixels in a stripe, for handing the stripe over to a
+// worker to stay cheap compared to processing it.
+constexpr int kMinStripePixels = 64 * 1024;
+
+// Set by camera_set_stripe_threads().
+std::atomic<int> sStripeThreads{0};
+
+// The stripes of a frame that are still being processed.
+class StripeBatch {
+public:
+    explicit StripeBatch(int stripes) : mPending(stripes) {}
+
+    void stripeDone() {
+        AutoLock lock(mLock);
+        if (--mPending == 0) {
+            // Signal with the lock held: the waiting thread destroys the
+            // batch as soon as it can take the lock.
+            mDone.signal();
+        }
+    }
+
+    void wait() {
+        AutoLock lock(mLock);
+        mDone.wait(&lock, [this]() { return mPending == 0; });
+    }
+
+private:
+    Lock mLock;
+    ConditionVariable mDone;
+    int mPending;
+};
+
+struct Stripe {
+    CameraStripeFunc func;
+    void* opaque;
+    int begin;
+    int end;
+    StripeBatch* batch;
+};
+
+class CameraWorkerPool {
+public:
+    CameraWorkerPool()
+        : mThreads(std::min(System::get()->getCpuCoreCount(), kMaxThreads)) {
+        if (mThreads > 1) {
+            mWorkers.emplace(mThreads - 1, [](Stripe&& stripe) {
+                stripe.func(stripe.opaque, stripe.begin, stripe.end);
+                stripe.batch->stripeDone();
+            });
+            if (!mWorkers->start()) {
+                mWorkers.clear();
+                mThreads = 1;
+            }
+        } else {
+            mThreads = 1;
+        }
+    }
+
+    void run(int lines, int linePixels, CameraStripeFunc func, void* opaque) {
+        int threads = mThreads;
+        const int maxThreads = sStripeThreads.load(std::memory_order_relaxed);
+        if (maxThreads > 0) {
+            threads = std::min(threads, maxThreads);
+        }
+        const int stripes = static_cast<int>(std::min<int64_t>(
+                threads, int64_t(lines) * linePixels / kMinStripePixels));
+        if (stripes <= 1) {
+            func(opaque, 0, lines);
+            return;
+        }
+
+        // Round up to even lines, which may leave fewer stripes.
+        const int stripeLines = ((lines + stripes - 1) / stripes + 1) & ~1;
+        const int count = (lines + stripeLines - 1) / stripeLines;
+        StripeBatch batch(count - 1);
+        for (int i = 1; i < count; ++i) {
+            mWorkers->enqueue({func, opaque, i * stripeLines,
+                               std::min(lines, (i + 1) * stripeLines),
+                               &batch});
+        }
+        func(opaque, 0, std::min(lines, stripeLines));
+        batch.wait();
+    }
+
+private:
+    int mThreads;
+    Optional<ThreadPool<Stripe>> mWorkers;
+};
+
+LazyInstance<CameraWorkerPool> sCameraWorkerPool = LAZY_INSTANCE_INIT;
+
+}  // namespace
+
+void camera_run_stripes(int lines,
+                        int line_pixels,
+                        CameraStripeFunc func,
+                        void* opaque) {
+    sCameraWorkerPool->run(lines, line_pixels, func, opaque);
+}
+
+void camera_set_stripe_threads(int threads) {
+    sStripeThreads.store(threads, std::memory_order_relaxed);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+/*
+ * Contains declaration of the API that splits the processing of a camera frame
+ * into stripes of lines, processed in parallel by a pool of worker threads.
+ */
+
+#include "android/utils/compiler.h"
+
+ANDROID_BEGIN_HEADER
+
+/* Processes the lines [begin, end) of a frame. */
+typedef void (*CameraStripeFunc)(void* opaque, int begin, int end);
+
+/* Runs |func| over all the lines of a frame, split into stripes that are
+ * processed in parallel by the camera worker pool and the calling thread.
+ * Returns once all of them are done. Frames too small to be worth it are
+ * processed on the calling thread only.
+ *
+ * Stripes begin on an even line, so that the lines of a 4:2:0 frame that share
+ * chroma values go to the same stripe.
+ * Param:
+ *  |lines| - Number of lines in the frame.
+ *  |line_pixels| - Number of pixels in each line.
+ *  |func|, |opaque| - Routine that processes the stripes, and its argument.
+ */
+extern void camera_run_stripes(int lines,
+                               int line_pixels,
+                               CameraStripeFunc func,
+                               void* opaque);
+
+/* Sets the maximum number of threads, the calling one included, that
+ * camera_run_stripes() splits a frame across; 0 restores the default, which is
+ * the size of the pool. For tests and benchmarks. */
+extern void camera_set_stripe_threads(int threads);
+
+ANDROID_END_HEADER
@@ -33,6 +33,7 @@
 #include "android/cmdline-option.h"
 #include "android/console_auth.h"
 #include "android/crashreport/crash-handler.h"
+#include "android/emulation/AndroidPipe.h"
 #include "android/emulation/ConfigDirs.h"
 #include "android/emulation/QemuMiscPipe.h"
 #include "android/emulator-window.h"
@@ -2473,6 +2474,21 @@ static int do_snapshot_remap(ControlClient client, char* args) {
     return true;
 }
 
+static int do_snapshot_checkpoints(ControlClient client, char* args) {
+    if (args && strcmp(args, "1") == 0) {
+        androidSnapshot_setCheckpointSeries(true);
+    } else if (args && strcmp(args, "0") == 0) {
+        androidSnapshot_setCheckpointSeries(false);
+    } else {
+        control_write(
+            client,
+            "KO: Argument missing, "
+            "try 'avd snapshot checkpoints <series>'\r\n");
+        return -1;
+    }
+    return 0;
+}
+
 static const CommandDefRec  snapshot_commands[] =
 {
     { "list", "list available state snapshots",
@@ -2513,6 +2529,16 @@ static const CommandDefRec  snapshot_commands[] =
     "  Issuing 'avd snapshot remap 1' after that will rewind again but activate auto-saving.\r\n",
     NULL, do_snapshot_remap, NULL },
 
+    { "checkpoints", "save snapshots as a checkpoint series",
+    "'avd snapshot checkpoints <series>' will start or stop a checkpoint series\r\n"
+    "<series> value of 1: each snapshot saved from now on stores only the RAM\r\n"
+    "  pages written since the previous one, and needs it to load\r\n"
+    "<series> value of 0: snapshots are saved in full again\r\n"
+    "- Loading a snapshot starts a new series.\r\n"
+    "- The Quickboot snapshot (default_boot) is always saved in full, and breaks\r\n"
+    "  the series.\r\n",
+    NULL, do_snapshot_checkpoints, NULL },
+
     { NULL, NULL, NULL, NULL, NULL, NULL }
 };
 
@@ -2728,6 +2754,70 @@ do_avd_bugreport( ControlClient client, char* args )
     return 0;
 }
 
+static void
+write_pipe_io_stats( ControlClient  client, const char*  name, uint64_t  pipeId,
+                     const android::AndroidPipe::IoStats&  stats )
+{
+    char  pipe[24] = "";
+    if (pipeId) {
+        snprintf(pipe, sizeof(pipe), "%llu", (unsigned long long)pipeId);
+    }
+    control_write(client,
+                  "%-24s %6s %10llu %8llu %12llu %9.3f %8.3f "
+                  "%10llu %8llu %12llu %9.3f %8.3f %8llu\r\n",
+                  name, pipe,
+                  (unsigned long long)stats.send.calls,
+                  (unsigned long long)stats.send.again,
+                  (unsigned long long)stats.send.bytes,
+                  stats.send.timeNs / 1e6, stats.send.maxTimeNs / 1e6,
+                  (unsigned long long)stats.recv.calls,
+                  (unsigned long long)stats.recv.again,
+                  (unsigned long long)stats.recv.bytes,
+                  stats.recv.timeNs / 1e6, stats.recv.maxTimeNs / 1e6,
+                  (unsigned long long)stats.wakes);
+}
+
+static int
+do_avd_pipestats( ControlClient  client, char*  args )
+{
+    using android::AndroidPipe;
+
+    if (args) {
+        if (!strcmp(args, "timing on")) {
+            AndroidPipe::setIoTiming(true);
+        } else if (!strcmp(args, "timing off")) {
+            AndroidPipe::setIoTiming(false);
+        } else {
+            control_write(client, "KO: bad argument, try 'avd pipestats "
+                                  "[timing on|off]'\r\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    control_write(client, "%-24s %6s %10s %8s %12s %9s %8s "
+                          "%10s %8s %12s %9s %8s %8s\r\n",
+                  "service", "pipe", "sends", "again", "bytes", "ms", "max ms",
+                  "recvs", "again", "bytes", "ms", "max ms", "wakes");
+    for (const auto& service : AndroidPipe::serviceIoStats()) {
+        const auto& stats = service.stats;
+        if (stats.send.calls || stats.recv.calls || stats.wakes) {
+            write_pipe_io_stats(client, service.service.c_str(), 0, stats);
+        }
+    }
+    for (const auto& pipe : AndroidPipe::pipeIoStats()) {
+        write_pipe_io_stats(client, pipe.service.c_str(), pipe.pipeId,
+                            pipe.stats);
+    }
+    const auto wakes = AndroidPipe::wakeStats();
+    control_write(client, "wakes requested: %llu, delivered: %llu\r\n",
+                  (unsigned long long)wakes.requested,
+                  (unsigned long long)wakes.delivered);
+    control_write(client, "timing: %s\r\n",
+                  AndroidPipe::ioTiming() ? "on" : "off");
+    return 0;
+}
+
 static const CommandDefRec  vm_commands[] =
 {
     { "stop", "stop the virtual device",
@@ -2799,6 +2889,13 @@ static const CommandDefRec  vm_commands[] =
     "'avd snapshotspath' will return the path where snapshots are stored for the current AVD. If no AVD can be found, 'NO_AVD_INFO' is returned. If the path cannot be queried, an empty string will be returned.\r\n",
     NULL, do_avd_snapshotspath, NULL },
 
+    { "pipestats", "query the guest I/O counters of the pipe services",
+    "'avd pipestats' will list the guest I/O counters of the pipe services, followed by the ones of every open pipe:\r\n"
+    "calls to send and receive, how many of them had to wait (again), the bytes transferred, the time spent in them\r\n"
+    "with the VM lock held and the longest call, and how many times the host woke the pipe.\r\n"
+    "'avd pipestats timing <on|off>' will start or stop timing the calls, which is off by default.\r\n",
+    NULL, do_avd_pipestats, NULL },
+
     { "snapshotpath", "query path to a particular AVD snapshot",
     "'avd snapshotpath <snapshotname>' will return the directory where a particular snapshot is stored. Requires one argument: the name of the snapshot on disk (The user-specified name is currently not supported). If no AVD can be found, 'NO_AVD_INFO' is returned. If the snapshot does not exist at that directory, 'NO_SNAPSHOT' is returned. If the path cannot be formed for some other reason, an empty string is returned.\r\n",
     NULL, do_avd_snapshotpath, NULL },
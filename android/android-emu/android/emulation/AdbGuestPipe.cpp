@@ -704,146 +704,103 @@ void AdbGuestPipe::onHostSocketEvent(unsigned events) {
     }
 }
 
+// Points |socketBuffers| at the non-empty |buffers|, up to
+// kSocketMaxBuffers of them, and returns how many it used.
+static int toSocketBuffers(const AndroidPipeBuffer* buffers,
+                           int numBuffers,
+                           android::base::SocketBuffer* socketBuffers) {
+    int count = 0;
+    for (int i = 0; i < numBuffers && count < android::base::kSocketMaxBuffers;
+         ++i) {
+        if (buffers[i].size) {
+            socketBuffers[count++] = {buffers[i].data, buffers[i].size};
+        }
+    }
+    return count;
+}
+
 int AdbGuestPipe::onGuestRecvData(AndroidPipeBuffer* buffers, int numBuffers) {
     DD("%s: [%p] numBuffers=%d", __func__, this, numBuffers);
     CHECK(mState == State::ProxyingData);
-    int result = 0;
-    while (numBuffers > 0) {
-        uint8_t* data = buffers[0].data;
-        size_t dataSize = buffers[0].size;
-        DD("%s: [%p] dataSize=%d", __func__, this, (int)dataSize);
-        while (dataSize > 0) {
-            ssize_t len;
-            {
-                // Possible that the host socket has been reset.
-                if (mHostSocket.hasStaleData()) {
-                    len = mHostSocket.readStaleData(data, dataSize);
-                    DD("%s: [%p] loaded %d data from buffer", __func__, this,
-                       (int)len);
-                } else if (mHostSocket.valid()) {
-                    len = android::base::socketRecv(
-                            mHostSocket.fd(), data, dataSize);
-                } else {
-                    fprintf(stderr, "WARNING: AdbGuestPipe socket closed in the middle of recv\n");
-                    mState = State::ClosedByHost;
-                    len = -1;
-                }
-            }
-            if (len > 0) {
-                data += len;
-                dataSize -= len;
-                result += static_cast<int>(len);
-                if (dataSize != 0) {
-                    return result; // got less than requested -> no more data.
-                } else {
-                    break;
-                }
-            }
-            if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-                if (result == 0) {
-                    mFdWatcher->dontWantRead();
-                    DD("%s: [%p] done try again", __func__, this);
-                    return PIPE_ERROR_AGAIN;
-                }
-            } else {
-                // End of stream or i/o error means the guest has closed
-                // the connection.
-                if (result == 0) {
-                    mHostSocket.reset();
-                    mState = State::ClosedByHost;
-                    DINIT("%s: [%p] Adb closed by host",__func__, this);
-                    return PIPE_ERROR_IO;
-                }
-            }
-            // Some data was received so report it, the guest will have
-            // to try again to get an error.
-            DD("%s: [%p] done %d", __func__, this, result);
-            return result;
+
+    // Possible that the host socket has been reset, with data from the
+    // previous session left to deliver.
+    if (mHostSocket.hasStaleData()) {
+        int result = 0;
+        for (int i = 0; i < numBuffers && mHostSocket.hasStaleData(); ++i) {
+            result += static_cast<int>(mHostSocket.readStaleData(
+                    buffers[i].data, buffers[i].size));
         }
-        buffers++;
-        numBuffers--;
+        DD("%s: [%p] loaded %d data from buffer", __func__, this, result);
+        return result;
+    }
+
+    if (!mHostSocket.valid()) {
+        fprintf(stderr, "WARNING: AdbGuestPipe socket closed in the middle of recv\n");
+        mState = State::ClosedByHost;
+        return PIPE_ERROR_IO;
     }
-    DD("%s: [%p] done %d", __func__, this, result);
-    return result;
-}
 
-#ifdef _DEBUG
+    android::base::SocketBuffer socketBuffers[android::base::kSocketMaxBuffers];
+    const int count = toSocketBuffers(buffers, numBuffers, socketBuffers);
+    if (!count) {
+        return 0;
+    }
 
-static int parseMsgSize(const char* msg) {
-    return *reinterpret_cast<const int32_t*>(msg + 12);
-}
+    // Receive straight into the guest buffers.
+    const ssize_t len = android::base::socketRecvv(mHostSocket.fd(),
+                                                   socketBuffers, count);
+    if (len > 0) {
+        DD("%s: [%p] done %d", __func__, this, (int)len);
+        return static_cast<int>(len);
+    }
+    if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        mFdWatcher->dontWantRead();
+        DD("%s: [%p] done try again", __func__, this);
+        return PIPE_ERROR_AGAIN;
+    }
 
-#endif
+    // End of stream or i/o error means the host has closed the connection.
+    mHostSocket.reset();
+    mState = State::ClosedByHost;
+    DINIT("%s: [%p] Adb closed by host",__func__, this);
+    return PIPE_ERROR_IO;
+}
 
 int AdbGuestPipe::onGuestSendData(const AndroidPipeBuffer* buffers,
                                   int numBuffers) {
     DD("%s: [%p] numBuffers=%d", __func__, this, numBuffers);
     CHECK(mState == State::ProxyingData);
-    int result = 0;
-#ifdef _DEBUG
-    int msgSize = 0;
-#endif
-    while (numBuffers > 0) {
-        const uint8_t* data = buffers[0].data;
-        size_t dataSize = buffers[0].size;
-        while (dataSize > 0) {
-            ssize_t len;
-            {
-                // Possible that the host socket has been reset.
-                if (mHostSocket.valid()) {
-                    len = android::base::socketSend(
-                            mHostSocket.fd(), data, dataSize);
-#ifdef _DEBUG
-                    if (msgSize) {
-                        msgSize -= dataSize;
-                        assert(msgSize >= 0);
-                    } else {
-                        msgSize = parseMsgSize(data);
-                        assert(msgSize >= 0);
-                    }
-#endif
-                } else {
-                    fprintf(stderr, "WARNING: AdbGuestPipe socket closed in the middle of send\n");
-                    mState = State::ClosedByHost;
-                    len = -1;
-                }
-            }
-            if (len > 0) {
-                data += len;
-                dataSize -= len;
-                result += static_cast<int>(len);
-                if (dataSize != 0) {
-                    return result; // sent less than requested -> no more room.
-                } else {
-                    break;
-                }
-            }
-            if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-                if (result == 0) {
-                    mFdWatcher->dontWantWrite();
-                    return PIPE_ERROR_AGAIN;
-                }
-            } else {
-                // End of stream or i/o error means the guest has closed
-                // the connection.
-                if (result == 0) {
-                    mHostSocket.reset();
-                    mState = State::ClosedByHost;
-                    DINIT("%s: [%p] Adb closed by host",__func__, this);
-                    return PIPE_ERROR_IO;
-                }
-            }
-            // Some data was received so report it, the guest will have
-            // to try again to get an error.
-            return result;
-        }
-        buffers++;
-        numBuffers--;
+
+    // Possible that the host socket has been reset.
+    if (!mHostSocket.valid()) {
+        fprintf(stderr, "WARNING: AdbGuestPipe socket closed in the middle of send\n");
+        mState = State::ClosedByHost;
+        return PIPE_ERROR_IO;
     }
-#ifdef _DEBUG
-    assert(!msgSize);
-#endif
-    return result;
+
+    android::base::SocketBuffer socketBuffers[android::base::kSocketMaxBuffers];
+    const int count = toSocketBuffers(buffers, numBuffers, socketBuffers);
+    if (!count) {
+        return 0;
+    }
+
+    // Send straight from the guest buffers.
+    const ssize_t len = android::base::socketSendv(mHostSocket.fd(),
+                                                   socketBuffers, count);
+    if (len > 0) {
+        return static_cast<int>(len);
+    }
+    if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        mFdWatcher->dontWantWrite();
+        return PIPE_ERROR_AGAIN;
+    }
+
+    // End of stream or i/o error means the host has closed the connection.
+    mHostSocket.reset();
+    mState = State::ClosedByHost;
+    DINIT("%s: [%p] Adb closed by host",__func__, this);
+    return PIPE_ERROR_IO;
 }
 
 int AdbGuestPipe::onGuestRecvReply(AndroidPipeBuffer* buffers, int numBuffers) {
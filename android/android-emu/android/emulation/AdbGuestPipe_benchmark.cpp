@@ -0,0 +1,224 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// Measures the throughput of an adb guest pipe, with a host goldfish pipe
+// device in place of the guest and a socket pair in place of the adb server.
+
+#include "android/emulation/AdbGuestPipe.h"
+
+#include "android/base/sockets/ScopedSocket.h"
+#include "android/base/sockets/SocketUtils.h"
+#include "android/base/threads/FunctorThread.h"
+#include "android/emulation/hostdevices/HostGoldfishPipe.h"
+
+#include "benchmark/benchmark_api.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+using android::AndroidPipe;
+using android::HostGoldfishPipeDevice;
+using android::base::FunctorThread;
+using android::base::ScopedSocket;
+using android::emulation::AdbGuestPipe;
+using android::emulation::AdbHostAgent;
+using android::emulation::AdbPortType;
+
+namespace {
+
+// Bytes moved per iteration, split across range_x() pipe buffers.
+constexpr size_t kTransferSize = 256 * 1024;
+
+class FakeAdbHostAgent : public AdbHostAgent {
+public:
+    void startListening() override {}
+    void stopListening() override {}
+    void notifyServer() override {}
+};
+
+// An adb guest pipe connected to a host socket, past the accept/start
+// handshake.
+class AdbPipeConnection {
+public:
+    AdbPipeConnection() {
+        mDevice = HostGoldfishPipeDevice::get();
+        mService = new AdbGuestPipe::Service(&mHostAgent);
+        AndroidPipe::Service::add(mService);
+
+        mPipe = mDevice->connect("qemud:adb");
+        mDevice->write(mPipe, "accept", 6);
+
+        int hostSocket, pipeSocket;
+        android::base::socketCreatePair(&hostSocket, &pipeSocket);
+        android::base::socketSetBlocking(hostSocket);
+        mHostSocket.reset(hostSocket);
+        mService->onHostConnection(ScopedSocket(pipeSocket),
+                                   AdbPortType::RegularAdb);
+
+        char reply[2];
+        mDevice->read(mPipe, reply, sizeof(reply));
+        mDevice->write(mPipe, "start", 5);
+    }
+
+    ~AdbPipeConnection() {
+        mDevice->close(mPipe);
+        mHostSocket.close();
+        AndroidPipe::Service::resetAll();
+    }
+
+    int hostSocket() const { return mHostSocket.get(); }
+
+    // Sends or receives all of |buffers|, retrying while the socket is
+    // not ready.
+    void write(std::vector<AndroidPipeBuffer> buffers) {
+        transfer(&buffers, [this](AndroidPipeBuffer* b, int count) {
+            return mDevice->write(mPipe, b, count);
+        });
+    }
+    void read(std::vector<AndroidPipeBuffer> buffers) {
+        transfer(&buffers, [this](AndroidPipeBuffer* b, int count) {
+            return mDevice->read(mPipe, b, count);
+        });
+    }
+
+    // Receives what is available, without retrying.
+    ssize_t tryRead(AndroidPipeBuffer* buffers, int count) {
+        return mDevice->read(mPipe, buffers, count);
+    }
+
+private:
+    template <class Func>
+    static void transfer(std::vector<AndroidPipeBuffer>* buffers, Func func) {
+        size_t first = 0;
+        while (first < buffers->size()) {
+            ssize_t ret = func(buffers->data() + first,
+                               (int)(buffers->size() - first));
+            if (ret == PIPE_ERROR_AGAIN) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (ret <= 0) {
+                return;
+            }
+            while (ret > 0) {
+                AndroidPipeBuffer& buffer = (*buffers)[first];
+                const size_t chunk = std::min<size_t>(ret, buffer.size);
+                buffer.data += chunk;
+                buffer.size -= chunk;
+                ret -= chunk;
+                if (!buffer.size) {
+                    ++first;
+                }
+            }
+        }
+    }
+
+    FakeAdbHostAgent mHostAgent;
+    AdbGuestPipe::Service* mService = nullptr;
+    HostGoldfishPipeDevice* mDevice = nullptr;
+    void* mPipe = nullptr;
+    ScopedSocket mHostSocket;
+};
+
+std::vector<AndroidPipeBuffer> splitBuffer(std::vector<uint8_t>* data,
+                                           int count) {
+    std::vector<AndroidPipeBuffer> buffers;
+    const size_t size = data->size() / count;
+    for (int i = 0; i < count; ++i) {
+        buffers.push_back({data->data() + i * size, size});
+    }
+    return buffers;
+}
+
+}  // namespace
+
+// Guest to host, as in adb push.
+void BM_AdbGuestPipe_GuestSend(benchmark::State& state) {
+    AdbPipeConnection connection;
+    std::vector<uint8_t> data(kTransferSize, 0x5a);
+
+    // Received bytes to wait for; set once the iteration count is known.
+    std::atomic<size_t> expected(SIZE_MAX);
+    FunctorThread drain([&connection, &expected] {
+        std::vector<char> buffer(kTransferSize);
+        size_t received = 0;
+        while (received < expected) {
+            ssize_t ret = android::base::socketRecv(
+                    connection.hostSocket(), buffer.data(), buffer.size());
+            if (ret <= 0) {
+                break;
+            }
+            received += ret;
+        }
+        return 0;
+    });
+    drain.start();
+
+    while (state.KeepRunning()) {
+        connection.write(splitBuffer(&data, state.range_x()));
+    }
+
+    // The drain thread may be waiting for more already; one more byte
+    // wakes it up.
+    expected = state.iterations() * kTransferSize + 1;
+    uint8_t last = 0;
+    connection.write({{&last, 1}});
+    drain.wait();
+
+    state.SetBytesProcessed(state.iterations() * kTransferSize);
+}
+
+// Host to guest, as in adb pull.
+void BM_AdbGuestPipe_GuestRecv(benchmark::State& state) {
+    AdbPipeConnection connection;
+    std::vector<uint8_t> data(kTransferSize);
+
+    std::atomic<bool> stop(false);
+    std::atomic<bool> done(false);
+    FunctorThread fill([&connection, &stop, &done] {
+        std::vector<char> buffer(kTransferSize, 0x5a);
+        while (!stop &&
+               android::base::socketSendAll(connection.hostSocket(),
+                                            buffer.data(), buffer.size())) {
+        }
+        done = true;
+        return 0;
+    });
+    fill.start();
+
+    while (state.KeepRunning()) {
+        connection.read(splitBuffer(&data, state.range_x()));
+    }
+
+    // Take what the fill thread sent after the last iteration.
+    stop = true;
+    for (;;) {
+        const bool filled = done;
+        AndroidPipeBuffer buffer = {data.data(), data.size()};
+        if (connection.tryRead(&buffer, 1) <= 0 && filled) {
+            break;
+        }
+    }
+    fill.wait();
+
+    state.SetBytesProcessed(state.iterations() * kTransferSize);
+}
+
+// The other end of the socket is served by a thread, so measure wall time.
+#define ADB_BENCHMARK(x) \
+    BENCHMARK(x)->Arg(1)->Arg(4)->Arg(16)->Arg(64)->UseRealTime()
+
+ADB_BENCHMARK(BM_AdbGuestPipe_GuestSend);
+ADB_BENCHMARK(BM_AdbGuestPipe_GuestRecv);
@@ -36,6 +36,27 @@ static const size_t kHeaderSize = sizeof(android::emulation::amessage);
 
 namespace android {
 namespace emulation {
+
+// Adds the part of |packet| from |pos| on to |buffers|, which has |count|
+// used entries, and returns the new count. |*bytes| grows by the size added.
+static int addPacketBuffers(apacket& packet,
+                            size_t pos,
+                            base::SocketBuffer* buffers,
+                            int count,
+                            size_t* bytes) {
+    if (pos < kHeaderSize) {
+        buffers[count++] = {(uint8_t*)&packet.mesg + pos, kHeaderSize - pos};
+        *bytes += kHeaderSize - pos;
+        pos = kHeaderSize;
+    }
+    const size_t dataPos = pos - kHeaderSize;
+    if (dataPos < packet.data.size()) {
+        buffers[count++] = {packet.data.data() + dataPos,
+                            packet.data.size() - dataPos};
+        *bytes += packet.data.size() - dataPos;
+    }
+    return count;
+}
 void AdbHub::onSave(android::base::Stream* stream) {
     stream->putBe32(mJdwpProxies.size());
     for (const auto& proxy : mJdwpProxies) {
@@ -99,8 +120,8 @@ int AdbHub::onGuestSendData(const AndroidPipeBuffer* buffers, int numBuffers) {
         mCurrentGuestSendPacketPst += currentReadSize;
         actualSendBytes += currentReadSize;
         if (mCurrentGuestSendPacketPst == kHeaderSize) {
-            mCurrentGuestSendPacket.data.resize(
-                    mCurrentGuestSendPacket.mesg.data_length);
+            resizePacketData(&mCurrentGuestSendPacket,
+                             mCurrentGuestSendPacket.mesg.data_length);
         }
         if (mCurrentGuestSendPacketPst >= kHeaderSize &&
             mCurrentGuestSendPacketPst ==
@@ -167,6 +188,7 @@ int AdbHub::onGuestRecvData(AndroidPipeBuffer* buffers, int numBuffers) {
             if (mRecvFromHostQueue.empty()) {
                 break;
             }
+            recyclePacketData(&mCurrentGuestRecvPacket);
             mCurrentGuestRecvPacket = std::move(mRecvFromHostQueue.front());
             mRecvFromHostQueue.pop();
             mCurrentGuestRecvPacketPst = 0;
@@ -229,34 +251,49 @@ void AdbHub::onHostSocketEvent(int fd,
 
 int AdbHub::writeSocket(int fd) {
     D("AdbHub writeSocket started");
-    while ((mCurrentHostSendPacketPst >= 0 &&
-            mCurrentHostSendPacketPst < packetSize(mCurrentHostSendPacket)) ||
-           !mSendToHostQueue.empty()) {
+    while (socketWantWrite()) {
         if (mCurrentHostSendPacketPst < 0 ||
             mCurrentHostSendPacketPst == packetSize(mCurrentHostSendPacket)) {
             mCurrentHostSendPacketPst = 0;
+            recyclePacketData(&mCurrentHostSendPacket);
             mCurrentHostSendPacket = std::move(mSendToHostQueue.front());
-            mSendToHostQueue.pop();
+            mSendToHostQueue.pop_front();
             DD("AdbHub writeSocket new packet size %d",
                (int)packetSize(mCurrentHostSendPacket));
         }
-        uint8_t* data = nullptr;
+        // Send the rest of the current packet and the queued ones in one
+        // call.
+        base::SocketBuffer buffers[base::kSocketMaxBuffers];
         size_t bytesToSend = 0;
-        if (mCurrentHostSendPacketPst < kHeaderSize) {
-            bytesToSend = kHeaderSize - mCurrentHostSendPacketPst;
-            data = ((uint8_t*)&mCurrentHostSendPacket.mesg) +
-                   mCurrentHostSendPacketPst;
-        } else {
-            bytesToSend = packetSize(mCurrentHostSendPacket) -
-                          mCurrentHostSendPacketPst;
-            data = mCurrentHostSendPacket.data.data() +
-                   mCurrentHostSendPacketPst - kHeaderSize;
+        int count = addPacketBuffers(mCurrentHostSendPacket,
+                                     mCurrentHostSendPacketPst, buffers, 0,
+                                     &bytesToSend);
+        for (auto it = mSendToHostQueue.begin();
+             it != mSendToHostQueue.end() &&
+             count + 2 <= base::kSocketMaxBuffers;
+             ++it) {
+            count = addPacketBuffers(*it, 0, buffers, count, &bytesToSend);
         }
-        ssize_t len = base::socketSend(fd, data, bytesToSend);
+        ssize_t len = base::socketSendv(fd, buffers, count);
         DD("AdbHub writeSocket sent %d", (int)len);
         if (len > 0) {
-            mCurrentHostSendPacketPst += len;
-            if (len < bytesToSend) {
+            // Move past what was sent, which can end in any of the packets.
+            size_t sent = len;
+            for (;;) {
+                const size_t left = packetSize(mCurrentHostSendPacket) -
+                                    mCurrentHostSendPacketPst;
+                const size_t consumed = std::min(left, sent);
+                mCurrentHostSendPacketPst += consumed;
+                sent -= consumed;
+                if (!sent) {
+                    break;
+                }
+                recyclePacketData(&mCurrentHostSendPacket);
+                mCurrentHostSendPacket = std::move(mSendToHostQueue.front());
+                mSendToHostQueue.pop_front();
+                mCurrentHostSendPacketPst = 0;
+            }
+            if ((size_t)len < bytesToSend) {
                 return 0;
             }
         } else if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
@@ -288,8 +325,8 @@ int AdbHub::readSocket(int fd) {
         if (len > 0) {
             mCurrentHostRecvPacketPst += len;
             if (mCurrentHostRecvPacketPst == kHeaderSize) {
-                mCurrentHostRecvPacket.data.resize(
-                        mCurrentHostRecvPacket.mesg.data_length);
+                resizePacketData(&mCurrentHostRecvPacket,
+                                 mCurrentHostRecvPacket.mesg.data_length);
             }
             if (len < bytesToRecv) {
                 return 0;
@@ -349,7 +386,7 @@ int AdbHub::readSocket(int fd) {
 }
 
 void AdbHub::pushToSendQueue(apacket&& packet) {
-    mSendToHostQueue.push(std::move(packet));
+    mSendToHostQueue.push_back(std::move(packet));
 }
 
 void AdbHub::pushToRecvQueue(apacket&& packet) {
@@ -358,6 +395,23 @@ void AdbHub::pushToRecvQueue(apacket&& packet) {
     mWantRecv = true;
 }
 
+void AdbHub::recyclePacketData(apacket* packet) {
+    if (packet->data.capacity() &&
+        mPacketDataPool.size() < kMaxPooledPacketData) {
+        packet->data.clear();
+        mPacketDataPool.push_back(std::move(packet->data));
+    }
+    packet->data.clear();
+}
+
+void AdbHub::resizePacketData(apacket* packet, size_t size) {
+    if (packet->data.capacity() < size && !mPacketDataPool.empty()) {
+        packet->data.swap(mPacketDataPool.back());
+        mPacketDataPool.pop_back();
+    }
+    packet->data.resize(size);
+}
+
 AdbProxy* AdbHub::onNewConnection(const apacket& requestPacket,
                                   const apacket& replyPacket) {
     if (requestPacket.mesg.command != ADB_OPEN ||
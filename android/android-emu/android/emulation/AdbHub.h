@@ -12,6 +12,7 @@
 #pragma once
 
 #include <atomic>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <queue>
@@ -64,6 +65,11 @@ private:
     AdbProxy* tryReuseConnection(const apacket& packet);
     void pushToSendQueue(apacket&& packet);
     void pushToRecvQueue(apacket&& packet);
+    // Keeps the payload buffer of a packet that is done with, to reuse it.
+    void recyclePacketData(apacket* packet);
+    // Resizes the payload of |packet|, reusing a kept buffer if it needs
+    // more room.
+    void resizePacketData(apacket* packet, size_t size);
     int readSocket(int fd);
     int writeSocket(int fd);
 
@@ -74,7 +80,7 @@ private:
     // Jdwp proxies, indexed by guest PID
     std::unordered_map<int, std::unique_ptr<jdwp::JdwpProxy>> mJdwpProxies;
 
-    std::queue<apacket> mSendToHostQueue;
+    std::deque<apacket> mSendToHostQueue;
     apacket mCurrentGuestSendPacket;
     size_t mCurrentGuestSendPacketPst = 0;
     apacket mCurrentHostSendPacket;
@@ -89,6 +95,11 @@ private:
 
     emulation::apacket mCnxnPacket;
     bool mShouldReconnect = false;
+
+    // Payload buffers of finished packets, so large transfers don't
+    // allocate one per packet.
+    static constexpr size_t kMaxPooledPacketData = 8;
+    std::vector<std::vector<uint8_t>> mPacketDataPool;
 };
 }  // namespace emulation
 }  // namespace android
\ No newline at end of file
@@ -21,6 +21,7 @@
 
 #include <gtest/gtest.h>
 #include <memory>
+#include <vector>
 
 namespace android {
 namespace emulation {
@@ -271,6 +272,61 @@ TEST_F(AdbHubTest, SendMultipleBuffers) {
     releaseBuffer(buffers[0]);
 }
 
+// The host socket takes less than what was queued, so writes stop and
+// resume in the middle of packets.
+TEST_F(AdbHubTest, SendPacketsShortWrites) {
+    const int kPacketCount = 8;
+    std::vector<apacket> packets;
+    for (int i = 0; i < kPacketCount; ++i) {
+        apacket packet = buildPacketGuestToHost(ADB_WRTE);
+        packet.data.resize(100000 + 7919 * i);
+        for (size_t j = 0; j < packet.data.size(); ++j) {
+            packet.data[j] = (uint8_t)(i * 31 + j);
+        }
+        packet.mesg.data_length = packet.data.size();
+        AndroidPipeBuffer buffer = packetToBuffer(packet);
+        mHub->onGuestSendData(&buffer, 1);
+        releaseBuffer(buffer);
+        packets.push_back(std::move(packet));
+    }
+    EXPECT_TRUE(mHub->socketWantWrite());
+
+    android::base::socketSetNonBlocking(mTesterSocket.get());
+    std::vector<uint8_t> received;
+    auto drain = [this, &received] {
+        uint8_t chunk[16384];
+        ssize_t len;
+        while ((len = android::base::socketRecv(mTesterSocket.get(), chunk,
+                                                sizeof(chunk))) > 0) {
+            received.insert(received.end(), chunk, chunk + len);
+        }
+    };
+
+    int writes = 0;
+    while (mHub->socketWantWrite()) {
+        mHub->onHostSocketEvent(mHubSocket.get(),
+                                base::Looper::FdWatch::kEventWrite,
+                                [] { FAIL(); });
+        ++writes;
+        drain();
+    }
+    drain();
+    EXPECT_LT(1, writes);
+
+    size_t pos = 0;
+    for (const apacket& expected : packets) {
+        ASSERT_LE(pos + packetSize(expected), received.size());
+        apacket packet;
+        memcpy(&packet.mesg, received.data() + pos, kHeaderSize);
+        ASSERT_EQ(expected.mesg.data_length, packet.mesg.data_length);
+        packet.data.assign(received.begin() + pos + kHeaderSize,
+                           received.begin() + pos + packetSize(expected));
+        EXPECT_TRUE(comparePacket(expected, packet));
+        pos += packetSize(expected);
+    }
+    EXPECT_EQ(received.size(), pos);
+}
+
 TEST_F(AdbHubTest, RecvPacket) {
     apacket packet = buildPacketHostToGuest(ADB_WRTE);
     packet.data.resize(1);
@@ -17,8 +17,11 @@
 #include "android/base/memory/LazyInstance.h"
 #include "android/base/Optional.h"
 #include "android/base/StringFormat.h"
+#include "android/base/Tracing.h"
+#include "android/base/files/BufferedStream.h"
 #include "android/base/files/MemStream.h"
 #include "android/base/synchronization/Lock.h"
+#include "android/base/threads/Thread.h"
 #include "android/base/threads/ThreadStore.h"
 #include "android/crashreport/CrashReporter.h"
 #include "android/emulation/android_pipe_device.h"
@@ -27,12 +30,16 @@
 #include "android/emulation/VmLock.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 
 #include <assert.h>
+#include <stdio.h>
 
 #define DEBUG 0
 
@@ -63,6 +70,7 @@ using OptionalString = android::base::Optional<std::string>;
 using Service = android::AndroidPipe::Service;
 using ServiceList = std::vector<std::unique_ptr<Service>>;
 using VmLock = android::VmLock;
+using android::base::BufferedStream;
 using android::base::MemStream;
 using android::base::StringFormat;
 using android::crashreport::CrashReporter;
@@ -339,7 +347,18 @@ struct PipeWakeCommand {
 class PipeWaker final : public DeviceContextRunner<PipeWakeCommand> {
 public:
     void signalWake(void* hwPipe, int wakeFlags) {
-        queueDeviceOperation({ hwPipe, wakeFlags });
+        mRequested.fetch_add(1, std::memory_order_relaxed);
+        // A pipe that is already waiting for a wake gets the new flags
+        // along with the pending ones.
+        queueDeviceOperation(
+                {hwPipe, wakeFlags},
+                [](PipeWakeCommand* pending, const PipeWakeCommand& cmd) {
+                    if (pending->hwPipe != cmd.hwPipe) {
+                        return false;
+                    }
+                    pending->wakeFlags |= cmd.wakeFlags;
+                    return true;
+                });
     }
     void closeFromHost(void* hwPipe) {
         signalWake(hwPipe, PIPE_WAKE_CLOSED);
@@ -365,8 +384,16 @@ public:
         return flags;
     }
 
+    AndroidPipe::WakeStats stats() const {
+        AndroidPipe::WakeStats res;
+        res.requested = mRequested.load(std::memory_order_relaxed);
+        res.delivered = mDelivered.load(std::memory_order_relaxed);
+        return res;
+    }
+
 private:
     virtual void performDeviceOperation(const PipeWakeCommand& wake_cmd) {
+        mDelivered.fetch_add(1, std::memory_order_relaxed);
         void* hwPipe = wake_cmd.hwPipe;
         int flags = wake_cmd.wakeFlags;
 
@@ -377,13 +404,25 @@ private:
             sPipeHwFuncs->signalWake(hwPipe, flags);
         }
     }
+
+    std::atomic<uint64_t> mRequested{0};
+    std::atomic<uint64_t> mDelivered{0};
 };
 
 struct Globals {
+    // Guards the |services| list against the stats readers.
+    Lock servicesLock;
     ServiceList services;
     ConnectorService connectorService;
     PipeWaker pipeWaker;
 
+    // All the open pipes, for their I/O counters.
+    Lock pipesLock;
+    std::unordered_set<const AndroidPipe*> pipes;
+    uint64_t lastPipeId = 0;
+    // The counters of the closed pipes, by service.
+    std::unordered_map<const Service*, AndroidPipe::IoStats> closedPipesIo;
+
     // Searches for a service position in the |services| list and returns the
     // index. |startPosHint| is a _hint_ and suggests where to start from.
     // Returns the index of the service or -1 if there's no |name| service.
@@ -423,6 +462,7 @@ struct Globals {
 android::base::LazyInstance<Globals> sGlobals = LAZY_INSTANCE_INIT;
 
 Service* findServiceByName(const char* name) {
+    AutoLock lock(sGlobals->servicesLock);
     const int pos = sGlobals->findServicePositionByName(name);
     return pos < 0 ? nullptr : sGlobals->services[pos].get();
 }
@@ -465,11 +505,201 @@ AndroidPipe* loadPipeFromStreamCommon(BaseStream* stream,
     return pipe;
 }
 
+// The pipe of the guest I/O call the thread is in, if any. Reset if the pipe
+// gets deleted in the meantime.
+static thread_local AndroidPipe* sGuestIoPipe = nullptr;
+
+// Reading the clock twice costs more than all the counters of a call, so
+// calls are only timed on demand.
+std::atomic<bool> sIoTiming{false};
+
+// Timed calls to onGuestSend() / onGuestRecv() that hold the VM lock for
+// longer are printed out when tracing is enabled.
+constexpr uint64_t kSlowIoNs = 1000 * 1000;
+
+void addTransfer(AndroidPipe::IoStats::Transfers* transfers,
+                 int result,
+                 uint64_t timeNs) {
+    ++transfers->calls;
+    if (result > 0) {
+        transfers->bytes += result;
+    } else if (result == PIPE_ERROR_AGAIN) {
+        ++transfers->again;
+    }
+    transfers->timeNs += timeNs;
+    transfers->maxTimeNs = std::max(transfers->maxTimeNs, timeNs);
+}
+
+// Counts a guest I/O call to a pipe that got deleted during the call.
+void countClosedPipeIo(const Service* service,
+                       bool send,
+                       int result,
+                       uint64_t timeNs) {
+    AutoLock lock(sGlobals->pipesLock);
+    auto& stats = sGlobals->closedPipesIo[service];
+    addTransfer(send ? &stats.send : &stats.recv, result, timeNs);
+}
+
+// Counts a guest I/O call to a pipe. The pipe may be deleted during the
+// call, the service stays.
+class ScopedGuestIo {
+public:
+    ScopedGuestIo(AndroidPipe* pipe, bool send)
+        : mPipe(pipe),
+          mService(pipe->service()),
+          mSend(send),
+          mPrevPipe(sGuestIoPipe) {
+        sGuestIoPipe = pipe;
+        if (sIoTiming.load(std::memory_order_relaxed)) {
+            mStart = std::chrono::steady_clock::now();
+        }
+    }
+
+    int done(int result) {
+        if (mStart == std::chrono::steady_clock::time_point()) {
+            countIo(result, 0);
+            return result;
+        }
+        const uint64_t timeNs =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - mStart)
+                        .count();
+        countIo(result, timeNs);
+        if (timeNs > kSlowIoNs && mService && shouldEnableTracing()) {
+            printf("tid:0x%016llx: pipe [%s] %s over threshold %f ms: %f ms\n",
+                   (unsigned long long)getCurrentThreadId(),
+                   mService->name().c_str(),
+                   mSend ? "onGuestSend" : "onGuestRecv", kSlowIoNs / 1e6,
+                   timeNs / 1e6);
+        }
+        return result;
+    }
+
+private:
+    void countIo(int result, uint64_t timeNs) {
+        if (sGuestIoPipe == mPipe) {
+            mPipe->ioCounters().addTransfer(mSend, result, timeNs);
+        } else {
+            countClosedPipeIo(mService, mSend, result, timeNs);
+        }
+        sGuestIoPipe = mPrevPipe;
+    }
+
+    AndroidPipe* const mPipe;
+    const Service* const mService;
+    const bool mSend;
+    AndroidPipe* const mPrevPipe;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+// Adds |value| to a counter only updated by one thread at a time, which
+// doesn't need an atomic read-modify-write.
+void addToCounter(std::atomic<uint64_t>* counter, uint64_t value) {
+    counter->store(counter->load(std::memory_order_relaxed) + value,
+                   std::memory_order_relaxed);
+}
+
 }  // namespace
 
+void AndroidPipe::IoCounters::addTransfer(bool send, int result,
+                                          uint64_t timeNs) {
+    Transfers& transfers = send ? mSend : mRecv;
+    addToCounter(&transfers.calls, 1);
+    if (result > 0) {
+        addToCounter(&transfers.bytes, result);
+    } else if (result == PIPE_ERROR_AGAIN) {
+        addToCounter(&transfers.again, 1);
+    }
+    if (!timeNs) {
+        return;
+    }
+    addToCounter(&transfers.timeNs, timeNs);
+    if (timeNs > transfers.maxTimeNs.load(std::memory_order_relaxed)) {
+        transfers.maxTimeNs.store(timeNs, std::memory_order_relaxed);
+    }
+}
+
+void AndroidPipe::IoCounters::addTo(IoStats* stats) const {
+    const auto add = [](const Transfers& from, IoStats::Transfers* to) {
+        to->calls += from.calls.load(std::memory_order_relaxed);
+        to->again += from.again.load(std::memory_order_relaxed);
+        to->bytes += from.bytes.load(std::memory_order_relaxed);
+        to->timeNs += from.timeNs.load(std::memory_order_relaxed);
+        to->maxTimeNs = std::max<uint64_t>(
+                to->maxTimeNs, from.maxTimeNs.load(std::memory_order_relaxed));
+    };
+    add(mSend, &stats->send);
+    add(mRecv, &stats->recv);
+}
+
+AndroidPipe::IoStats AndroidPipe::Service::ioStats() const {
+    IoStats stats;
+    AutoLock lock(sGlobals->pipesLock);
+    const auto it = sGlobals->closedPipesIo.find(this);
+    if (it != sGlobals->closedPipesIo.end()) {
+        stats = it->second;
+    }
+    for (const AndroidPipe* pipe : sGlobals->pipes) {
+        if (pipe->mService == this) {
+            pipe->addIoStatsTo(&stats);
+        }
+    }
+    return stats;
+}
+
+// static
+void AndroidPipe::setIoTiming(bool enable) {
+    sIoTiming.store(enable, std::memory_order_relaxed);
+}
+
+// static
+bool AndroidPipe::ioTiming() {
+    return sIoTiming.load(std::memory_order_relaxed);
+}
+
+// static
+std::vector<AndroidPipe::NamedIoStats> AndroidPipe::serviceIoStats() {
+    std::vector<NamedIoStats> res;
+    AutoLock lock(sGlobals->servicesLock);
+    for (const auto& service : sGlobals->services) {
+        res.emplace_back();
+        res.back().service = service->name();
+        res.back().stats = service->ioStats();
+    }
+    return res;
+}
+
+// static
+std::vector<AndroidPipe::NamedIoStats> AndroidPipe::pipeIoStats() {
+    std::vector<NamedIoStats> res;
+    AutoLock lock(sGlobals->pipesLock);
+    for (const AndroidPipe* pipe : sGlobals->pipes) {
+        res.emplace_back();
+        res.back().service = pipe->name();
+        res.back().pipeId = pipe->mId;
+        pipe->addIoStatsTo(&res.back().stats);
+    }
+    lock.unlock();
+    std::sort(res.begin(), res.end(),
+              [](const NamedIoStats& a, const NamedIoStats& b) {
+                  return a.pipeId < b.pipeId;
+              });
+    return res;
+}
+
+AndroidPipe::AndroidPipe(void* hwPipe, Service* service)
+    : mHwPipe(hwPipe), mService(service) {
+    AutoLock lock(sGlobals->pipesLock);
+    mId = ++sGlobals->lastPipeId;
+    sGlobals->pipes.insert(this);
+}
+
 // static
 void AndroidPipe::initThreading(VmLock* vmLock) {
     sGlobals->pipeWaker.init(vmLock);
+    if (shouldEnableTracing()) {
+        setIoTiming(true);
+    }
 }
 
 // static
@@ -477,9 +707,25 @@ void AndroidPipe::initThreadingForTest(VmLock* vmLock, base::Looper* looper) {
     sGlobals->pipeWaker.init(vmLock, looper);
 }
 
+// static
+AndroidPipe::WakeStats AndroidPipe::wakeStats() {
+    return sGlobals->pipeWaker.stats();
+}
+
 AndroidPipe::~AndroidPipe() {
     DD("%s: for hwpipe=%p (host %p '%s')", __FUNCTION__, mHwPipe, this,
        mService->name().c_str());
+    if (sGuestIoPipe == this) {
+        sGuestIoPipe = nullptr;
+    }
+    AutoLock lock(sGlobals->pipesLock);
+    sGlobals->pipes.erase(this);
+    addIoStatsTo(&sGlobals->closedPipesIo[mService]);
+}
+
+void AndroidPipe::addIoStatsTo(IoStats* stats) const {
+    mIoCounters.addTo(stats);
+    stats->wakes += mWakes.load(std::memory_order_relaxed);
 }
 
 // static
@@ -487,13 +733,17 @@ void AndroidPipe::Service::add(Service* service) {
     DD("Adding new pipe service '%s' this=%p", service->name().c_str(),
        service);
     std::unique_ptr<Service> svc(service);
+    AutoLock lock(sGlobals->servicesLock);
     sGlobals->services.push_back(std::move(svc));
 }
 
 // static
 void AndroidPipe::Service::resetAll() {
     DD("Resetting all pipe services");
+    AutoLock lock(sGlobals->servicesLock);
     sGlobals->services.clear();
+    AutoLock pipesLock(sGlobals->pipesLock);
+    sGlobals->closedPipesIo.clear();
 }
 
 void AndroidPipe::signalWake(int wakeFlags) {
@@ -507,6 +757,7 @@ void AndroidPipe::signalWake(int wakeFlags) {
                         .c_str());
         abort();
     }
+    countWake();
     sGlobals->pipeWaker.signalWake(mHwPipe, wakeFlags);
 }
 
@@ -520,9 +771,14 @@ void AndroidPipe::closeFromHost() {
                         .c_str());
         abort();
     }
+    countWake();
     sGlobals->pipeWaker.closeFromHost(mHwPipe);
 }
 
+void AndroidPipe::countWake() {
+    mWakes.fetch_add(1, std::memory_order_relaxed);
+}
+
 void AndroidPipe::abortPendingOperation() {
     // i.e., pipe not using normal pipe device
     if (mFlags) return;
@@ -549,17 +805,21 @@ void AndroidPipe::saveToStream(BaseStream* stream) {
     }
 
     MemStream pipeStream;
-    writeOptionalString(&pipeStream, mArgs.c_str());
+    {
+        // Pipes save their state field by field.
+        BufferedStream bufferedStream(&pipeStream);
+        writeOptionalString(&bufferedStream, mArgs.c_str());
+
+        // Save pipe-specific state now.
+        if (mService->canLoad()) {
+            mService->savePipe(this, &bufferedStream);
+        }
 
-    // Save pipe-specific state now.
-    if (mService->canLoad()) {
-        mService->savePipe(this, &pipeStream);
+        // Save the pending wake or close operations as well.
+        const int pendingFlags = sGlobals->pipeWaker.getPendingFlags(mHwPipe);
+        bufferedStream.putBe32(pendingFlags);
     }
 
-    // Save the pending wake or close operations as well.
-    const int pendingFlags = sGlobals->pipeWaker.getPendingFlags(mHwPipe);
-    pipeStream.putBe32(pendingFlags);
-
     pipeStream.save(stream);
 }
 
@@ -575,7 +835,9 @@ AndroidPipe* AndroidPipe::loadFromStream(BaseStream* stream,
     if (!service) {
         return nullptr;
     }
-    return loadPipeFromStreamCommon(&pipeStream, hwPipe, service, pForceClose);
+    BufferedStream bufferedStream(&pipeStream);
+    return loadPipeFromStreamCommon(&bufferedStream, hwPipe, service,
+                                    pForceClose);
 }
 
 // static
@@ -593,11 +855,13 @@ AndroidPipe* AndroidPipe::loadFromStreamLegacy(BaseStream* stream,
     if (!service) {
         return nullptr;
     }
-    *pChannel = pipeStream.getBe64();
-    *pWakes = pipeStream.getByte();
-    *pClosed = pipeStream.getByte();
+    BufferedStream bufferedStream(&pipeStream);
+    *pChannel = bufferedStream.getBe64();
+    *pWakes = bufferedStream.getByte();
+    *pClosed = bufferedStream.getByte();
 
-    return loadPipeFromStreamCommon(&pipeStream, hwPipe, service, pForceClose);
+    return loadPipeFromStreamCommon(&bufferedStream, hwPipe, service,
+                                    pForceClose);
 }
 
 }  // namespace android
@@ -788,9 +1052,10 @@ int android_pipe_guest_recv(void* internalPipe,
                             int numBuffers) {
     CHECK_VM_STATE_LOCK();
     auto pipe = static_cast<AndroidPipe*>(internalPipe);
+    android::ScopedGuestIo io(pipe, false);
     // Note that pipe may be deleted during this call, so it's not safe to
     // access pipe after this point.
-    return pipe->onGuestRecv(buffers, numBuffers);
+    return io.done(pipe->onGuestRecv(buffers, numBuffers));
 }
 
 int android_pipe_guest_send(void* internalPipe,
@@ -798,9 +1063,10 @@ int android_pipe_guest_send(void* internalPipe,
                             int numBuffers) {
     CHECK_VM_STATE_LOCK();
     auto pipe = static_cast<AndroidPipe*>(internalPipe);
+    android::ScopedGuestIo io(pipe, true);
     // Note that pipe may be deleted during this call, so it's not safe to
     // access pipe after this point.
-    return pipe->onGuestSend(buffers, numBuffers);
+    return io.done(pipe->onGuestSend(buffers, numBuffers));
 }
 
 void android_pipe_guest_wake_on(void* internalPipe, unsigned wakes) {
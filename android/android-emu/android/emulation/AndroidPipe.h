@@ -15,6 +15,12 @@
 #include "android/emulation/android_pipe_common.h"
 #include "android/emulation/VmLock.h"
 
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
 namespace android {
 
 namespace base {
@@ -75,6 +81,73 @@ public:
 
     static void initThreadingForTest(VmLock* lock, base::Looper* looper);
 
+    // Counters of the signalWake() and closeFromHost() calls, and of the
+    // ones that reached the pipe device. Wakes deferred to the device
+    // thread are coalesced per pipe, so there can be fewer of the latter.
+    struct WakeStats {
+        uint64_t requested = 0;
+        uint64_t delivered = 0;
+    };
+    static WakeStats wakeStats();
+
+    // Counters of the guest I/O on a pipe, or on all the pipes of a service.
+    // Times are spent in onGuestSend() / onGuestRecv(), i.e. with the VM lock
+    // held, and only counted while timing is on (see setIoTiming()).
+    struct IoStats {
+        struct Transfers {
+            uint64_t calls = 0;
+            uint64_t again = 0;  // Calls that returned PIPE_ERROR_AGAIN.
+            uint64_t bytes = 0;
+            uint64_t timeNs = 0;
+            uint64_t maxTimeNs = 0;
+        };
+        Transfers send;
+        Transfers recv;
+        // signalWake() and closeFromHost() calls.
+        uint64_t wakes = 0;
+    };
+
+    // IoStats of a service, or of an open pipe of it.
+    struct NamedIoStats {
+        std::string service;
+        // A number identifying the pipe among all the pipes opened since
+        // the start, or 0 for the totals of a service.
+        uint64_t pipeId = 0;
+        IoStats stats;
+    };
+
+    // Returns the counters of every registered service, summed over all
+    // the pipes it ever had.
+    static std::vector<NamedIoStats> serviceIoStats();
+
+    // Returns the counters of every open pipe.
+    static std::vector<NamedIoStats> pipeIoStats();
+
+    // Turns the timing of guest I/O calls on or off. It is off by default,
+    // as it costs more than the counters, unless tracing is enabled.
+    static void setIoTiming(bool enable);
+    static bool ioTiming();
+
+    // IoStats counters, updated by one thread at a time and readable from
+    // any thread. Implementation detail of the above.
+    class IoCounters {
+    public:
+        void addTransfer(bool send, int result, uint64_t timeNs);
+        // Adds the counters to |stats|.
+        void addTo(IoStats* stats) const;
+
+    private:
+        struct Transfers {
+            std::atomic<uint64_t> calls{0};
+            std::atomic<uint64_t> again{0};
+            std::atomic<uint64_t> bytes{0};
+            std::atomic<uint64_t> timeNs{0};
+            std::atomic<uint64_t> maxTimeNs{0};
+        };
+        Transfers mSend;
+        Transfers mRecv;
+    };
+
     // A base class for all AndroidPipe services, which is in charge
     // of creating new instances when a guest client connects to the
     // service.
@@ -134,6 +207,10 @@ public:
         // end of a unit-test.
         static void resetAll();
 
+        // Returns the counters of all the pipes of the service, open or
+        // closed.
+        IoStats ioStats() const;
+
     protected:
         // No default constructor.
         Service() = delete;
@@ -231,18 +308,31 @@ public:
     void setFlags(AndroidPipeFlags flags) { mFlags = flags; }
     AndroidPipeFlags getFlags() const { return mFlags; }
 
+    // Counters of the guest I/O on this pipe alone. Updated with the VM lock
+    // held, by android_pipe_guest_send() and android_pipe_guest_recv().
+    IoCounters& ioCounters() { return mIoCounters; }
+    Service* service() const { return mService; }
+
 protected:
     // No default constructor.
     AndroidPipe() = delete;
 
     // Constructor used by derived classes only.
-    AndroidPipe(void* hwPipe, Service* service)
-        : mHwPipe(hwPipe), mService(service) {}
+    AndroidPipe(void* hwPipe, Service* service);
 
     void* const mHwPipe = nullptr;
     Service* mService = nullptr;
     std::string mArgs;
     AndroidPipeFlags mFlags = ANDROID_PIPE_DEFAULT;
+
+private:
+    void countWake();
+    void addIoStatsTo(IoStats* stats) const;
+
+    uint64_t mId = 0;
+    IoCounters mIoCounters;
+    // Any thread can wake the pipe.
+    std::atomic<uint64_t> mWakes{0};
 };
 
 }  // namespace android
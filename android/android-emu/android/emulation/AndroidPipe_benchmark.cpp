@@ -0,0 +1,130 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// Measures the cost of pipe wakes signaled from a thread that doesn't hold
+// the VM lock, from signalWake() to the wake callbacks of a host goldfish
+// pipe device, which run on the next loop iteration, and of guest writes
+// through the pipe device.
+
+#include "android/emulation/AndroidPipe.h"
+
+#include "android/base/StringFormat.h"
+#include "android/base/testing/TestLooper.h"
+#include "android/emulation/hostdevices/HostGoldfishPipe.h"
+#include "android/emulation/testing/TestVmLock.h"
+
+#include "benchmark/benchmark_api.h"
+
+#include <vector>
+
+using android::AndroidPipe;
+using android::HostGoldfishPipeDevice;
+using android::TestVmLock;
+using android::base::TestLooper;
+
+namespace {
+
+// About the number of pipes a booted guest keeps open.
+constexpr int kPipes = 16;
+
+class WakePipe : public AndroidPipe {
+public:
+    WakePipe(void* hwPipe, Service* service) : AndroidPipe(hwPipe, service) {}
+
+    void onGuestClose(PipeCloseReason reason) override { delete this; }
+    unsigned onGuestPoll() const override { return 0; }
+    int onGuestRecv(AndroidPipeBuffer* buffers, int numBuffers) override {
+        return PIPE_ERROR_AGAIN;
+    }
+    int onGuestSend(const AndroidPipeBuffer* buffers,
+                    int numBuffers) override {
+        int res = 0;
+        for (int i = 0; i < numBuffers; ++i) {
+            res += buffers[i].size;
+        }
+        return res;
+    }
+    void onGuestWantWakeOn(int flags) override {}
+};
+
+class WakePipeService : public AndroidPipe::Service {
+public:
+    WakePipeService() : Service("wakebench") {}
+
+    AndroidPipe* create(void* hwPipe, const char* args) override {
+        return new WakePipe(hwPipe, this);
+    }
+};
+
+}  // namespace
+
+// range_x() is the number of wakes signaled for each pipe in a loop
+// iteration.
+void BM_AndroidPipe_SignalWake(benchmark::State& state) {
+    HostGoldfishPipeDevice* device = HostGoldfishPipeDevice::get();
+    TestLooper looper;
+    AndroidPipe::initThreadingForTest(TestVmLock::getInstance(), &looper);
+    AndroidPipe::Service::add(new WakePipeService());
+
+    std::vector<void*> hwPipes;
+    std::vector<AndroidPipe*> pipes;
+    int delivered = 0;
+    for (int i = 0; i < kPipes; ++i) {
+        hwPipes.push_back(device->connect("wakebench"));
+        pipes.push_back(
+                static_cast<AndroidPipe*>(device->getHostPipe(hwPipes.back())));
+        device->setWakeCallback(hwPipes.back(),
+                                [&delivered](int) { ++delivered; });
+    }
+
+    const int wakes = state.range_x();
+    while (state.KeepRunning()) {
+        for (int i = 0; i < wakes; ++i) {
+            for (AndroidPipe* pipe : pipes) {
+                pipe->signalWake(i % 2 ? PIPE_WAKE_READ : PIPE_WAKE_WRITE);
+            }
+        }
+        looper.runOneIterationWithDeadlineMs(0);
+    }
+
+    const int64_t requested = state.iterations() * wakes * kPipes;
+    state.SetItemsProcessed(requested);
+    state.SetLabel(android::base::StringFormat(
+            "%.3f callbacks per wake", double(delivered) / requested));
+
+    for (void* hwPipe : hwPipes) {
+        device->close(hwPipe);
+    }
+    AndroidPipe::Service::resetAll();
+    AndroidPipe::initThreading(TestVmLock::getInstance());
+}
+
+BENCHMARK(BM_AndroidPipe_SignalWake)->Arg(1)->Arg(8)->Arg(64);
+
+// range_x() is 1 to time the calls, 0 otherwise.
+void BM_AndroidPipe_GuestSend(benchmark::State& state) {
+    HostGoldfishPipeDevice* device = HostGoldfishPipeDevice::get();
+    AndroidPipe::Service::add(new WakePipeService());
+    void* hwPipe = device->connect("wakebench");
+    AndroidPipe::setIoTiming(state.range_x());
+
+    char buffer[64] = {};
+    while (state.KeepRunning()) {
+        device->write(hwPipe, buffer, sizeof(buffer));
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    AndroidPipe::setIoTiming(false);
+    device->close(hwPipe);
+    AndroidPipe::Service::resetAll();
+}
+
+BENCHMARK(BM_AndroidPipe_GuestSend)->Arg(0)->Arg(1);
@@ -33,7 +33,9 @@ namespace android {
 // - If the current thread already owns the lock,
 //   the operation is performed as-is.
 // - Otherwise, it is queued and will be run in the
-//   main-loop thread as soon as possible.
+//   main-loop thread as soon as possible. All the
+//   operations queued by then are run together, in
+//   one timer event.
 //
 // Usage is the following:
 //
@@ -97,6 +99,10 @@ public:
         if (!mTimer.get()) {
             LOG(FATAL) << "Failed to create a loop timer in DeviceContextRunner";
         }
+        // Operations queued for the previous timer would never run.
+        if (numPending()) {
+            mTimer->startAbsolute(0);
+        }
     }
 
     void setContextRunMode(ContextRunMode mode) {
@@ -117,20 +123,38 @@ protected:
     // Otherwise, we need to add the request to a pending
     // set of requests, to be finished later when we do have the VM lock.
     void queueDeviceOperation(const T& op) {
+        queueDeviceOperation(op, [](T*, const T&) { return false; });
+    }
+
+    // Same as above, but a deferred |op| is first offered to each pending
+    // operation through |merge(T* pending, const T& op)|, which returns
+    // true if it folded |op| into |pending|. In that case |op| isn't queued
+    // on its own.
+    template <class Merge>
+    void queueDeviceOperation(const T& op, const Merge& merge) {
         if (mContextRunMode == ContextRunMode::DeferIfNotLocked &&
             mVmLock->isLockedBySelf()) {
             // Perform the operation correctly since the current thread
             // already holds the lock that protects the global VM state.
             performDeviceOperation(op);
-        } else {
-            // Queue the operation in the mPendingMap structure, then
-            // restart the timer.
-            AutoLock lock(mLock);
-            mPending.push_back(op);
-            lock.unlock();
-
-            // NOTE: See TODO above why this is thread-safe when used with
-            // QEMU1 and QEMU2.
+            return;
+        }
+
+        AutoLock lock(mLock);
+        for (auto it = mPending.rbegin(); it != mPending.rend(); ++it) {
+            if (merge(&*it, op)) {
+                return;
+            }
+        }
+        mPending.push_back(op);
+        const bool wasEmpty = mPending.size() == 1;
+        lock.unlock();
+
+        // The timer is already started if other operations are pending:
+        // they are all performed on the next loop iteration.
+        // NOTE: See TODO above why this is thread-safe when used with
+        // QEMU1 and QEMU2.
+        if (wasEmpty) {
             mTimer->startAbsolute(0);
         }
     }
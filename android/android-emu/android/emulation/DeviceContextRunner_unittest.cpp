@@ -60,6 +60,13 @@ public:
     void signal(const DeviceContextRunnerTestOp& op) {
         queueDeviceOperation(op);
     }
+    // Folds |op| into a pending operation with the same request code.
+    void signalMerged(const DeviceContextRunnerTestOp& op) {
+        queueDeviceOperation(op, [](DeviceContextRunnerTestOp* pending,
+                                    const DeviceContextRunnerTestOp& op) {
+            return pending->request_code == op.request_code;
+        });
+    }
 private:
     void performDeviceOperation(const DeviceContextRunnerTestOp& op) {
         getTestDevice()->requests.push_back(op.request_code);
@@ -184,6 +191,59 @@ TEST(DeviceContextRunner, multiRequestsNeedWait) {
     resetTestDevice();
 }
 
+TEST(DeviceContextRunner, mergedRequestsNeedWait) {
+    resetTestDevice();
+
+    std::unique_ptr<Looper> testLooper(Looper::create());
+
+    TestVmLock testLock;
+
+    TestDeviceContextRunner testRunner;
+    testRunner.init(&testLock, testLooper.get());
+
+    for (size_t i = 0; i < kNumRequests; i++) {
+        testRunner.signalMerged({ .request_code = (int)(i % 3) });
+    }
+
+    testLock.lock();
+    testLooper->run();
+    testLock.unlock();
+
+    // One request per code, in the order they were first queued.
+    EXPECT_EQ(std::vector<int>({0, 1, 2}), getTestDevice()->requests);
+
+    // A new batch starts once the previous one ran.
+    testRunner.signalMerged({ .request_code = 0 });
+    testLock.lock();
+    testLooper->run();
+    testLock.unlock();
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 0}), getTestDevice()->requests);
+
+    resetTestDevice();
+}
+
+TEST(DeviceContextRunner, mergedRequestsWithLock) {
+    resetTestDevice();
+
+    std::unique_ptr<Looper> testLooper(Looper::create());
+
+    TestVmLock testLock;
+
+    testLock.lock();
+
+    TestDeviceContextRunner testRunner;
+    testRunner.init(&testLock, testLooper.get());
+
+    // Nothing is pending, so nothing is merged.
+    testRunner.signalMerged({ .request_code = 1 });
+    testRunner.signalMerged({ .request_code = 1 });
+    EXPECT_EQ(std::vector<int>({1, 1}), getTestDevice()->requests);
+
+    testLock.unlock();
+
+    resetTestDevice();
+}
+
 } // namespace
 
 } // namespace android
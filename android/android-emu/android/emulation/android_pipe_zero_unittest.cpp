@@ -11,6 +11,8 @@
 
 #include "android/emulation/testing/TestAndroidPipeDevice.h"
 
+#include "android/emulation/AndroidPipe.h"
+
 #include <gtest/gtest.h>
 
 #include <memory>
@@ -18,6 +20,7 @@
 
 #define ARRAY_SIZE(x)  (sizeof(x)/sizeof(x[0]))
 
+using android::AndroidPipe;
 using Guest = android::TestAndroidPipeDevice::Guest;
 
 // A TestAndroidPipeDevice that provides the 'zero' service.
@@ -66,3 +69,48 @@ TEST(AndroidPipe,ZeroPipeReads) {
         }
     }
 }
+
+TEST(AndroidPipe,ZeroPipeIoStats) {
+    ZeroPipeDevice dev;
+    std::unique_ptr<Guest> guest(Guest::create());
+    EXPECT_EQ(0, guest->connect("zero"));
+
+    char buffer[100] = {};
+    AndroidPipe::setIoTiming(true);
+    EXPECT_EQ(100, guest->write(buffer, 100));
+    EXPECT_EQ(0, guest->write(buffer, 0));
+    EXPECT_EQ(50, guest->read(buffer, 50));
+    AndroidPipe::setIoTiming(false);
+    EXPECT_EQ(10, guest->write(buffer, 10));
+
+    static_cast<AndroidPipe*>(guest->getPipe())->signalWake(PIPE_WAKE_READ);
+
+    // The connection handshake went to another pipe.
+    const auto pipes = AndroidPipe::pipeIoStats();
+    ASSERT_EQ(1U, pipes.size());
+    EXPECT_EQ("zero", pipes[0].service);
+    EXPECT_NE(0U, pipes[0].pipeId);
+    const auto& pipeStats = pipes[0].stats;
+    EXPECT_EQ(3U, pipeStats.send.calls);
+    EXPECT_EQ(110U, pipeStats.send.bytes);
+    EXPECT_EQ(0U, pipeStats.send.again);
+    EXPECT_LE(pipeStats.send.maxTimeNs, pipeStats.send.timeNs);
+    EXPECT_EQ(1U, pipeStats.recv.calls);
+    EXPECT_EQ(50U, pipeStats.recv.bytes);
+    EXPECT_EQ(1U, pipeStats.wakes);
+
+    // The counters of a closed pipe stay with its service.
+    guest->close();
+    EXPECT_TRUE(AndroidPipe::pipeIoStats().empty());
+
+    const auto services = AndroidPipe::serviceIoStats();
+    ASSERT_EQ(1U, services.size());
+    EXPECT_EQ("zero", services[0].service);
+    EXPECT_EQ(0U, services[0].pipeId);
+    const auto& serviceStats = services[0].stats;
+    EXPECT_EQ(3U, serviceStats.send.calls);
+    EXPECT_EQ(110U, serviceStats.send.bytes);
+    EXPECT_EQ(1U, serviceStats.recv.calls);
+    EXPECT_EQ(50U, serviceStats.recv.bytes);
+    EXPECT_EQ(1U, serviceStats.wakes);
+}
@@ -203,6 +203,7 @@ public:
         return false;
     }
     void fillGLESUsages(android_studio::EmulatorGLESUsages*) { }
+    emugl::FrameStats getFrameStats() { return {}; }
     void getScreenshot(unsigned int nChannels, unsigned int* width,
         unsigned int* height, std::vector<unsigned char>& pixels,
         int displayId, int desiredWidth, int desiredHeight,
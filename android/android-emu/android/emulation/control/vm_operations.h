@@ -206,5 +206,15 @@ typedef struct QAndroidVmOperations {
     struct HostmemEntry (*hostmemGetInfo)(uint64_t id);
     EmuRunState (*getRunState)();
 
+    // Keep tracking the RAM pages the guest writes once a snapshot save
+    // completes, for the next save to be able to visit only those. Does
+    // nothing if the accelerator can't track guest writes.
+    void (*setRamDirtyLogKept)(bool keep);
+
+    // Makes the next snapshot save visit only the RAM pages written since the
+    // last one. Returns false if those aren't known, in which case the next
+    // save visits all pages.
+    bool (*ramSaveDirtyPagesOnly)(bool dirtyOnly);
+
 } QAndroidVmOperations;
 ANDROID_END_HEADER
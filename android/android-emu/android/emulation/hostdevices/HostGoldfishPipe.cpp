@@ -308,6 +308,23 @@ ssize_t HostGoldfishPipeDevice::read(void* pipe, void* buffer, size_t len) {
     return res;
 }
 
+ssize_t HostGoldfishPipeDevice::read(void* pipe,
+                                     AndroidPipeBuffer* buffers,
+                                     int numBuffers) {
+    ScopedVmLock lock;
+
+    auto it = mHwPipeToPipe.find(pipe);
+    if (it == mHwPipeToPipe.end()) {
+        LOG(ERROR) << "Pipe not found.";
+        mErrno = EINVAL;
+        return PIPE_ERROR_INVAL;
+    }
+
+    ssize_t res = android_pipe_guest_recv(it->second, buffers, numBuffers);
+    setErrno(res);
+    return res;
+}
+
 HostGoldfishPipeDevice::ReadResult HostGoldfishPipeDevice::read(void* pipe, size_t maxLength) {
     std::vector<uint8_t> resultBuffer(maxLength);
     void* buffer = (void*)resultBuffer.data();
@@ -336,6 +353,23 @@ ssize_t HostGoldfishPipeDevice::write(void* pipe, const void* buffer, size_t len
     return writeInternal(it->second, buffer, len);
 }
 
+ssize_t HostGoldfishPipeDevice::write(void* pipe,
+                                      const AndroidPipeBuffer* buffers,
+                                      int numBuffers) {
+    ScopedVmLock lock;
+
+    auto it = mHwPipeToPipe.find(pipe);
+    if (it == mHwPipeToPipe.end()) {
+        LOG(ERROR) << "Pipe not found.";
+        mErrno = EINVAL;
+        return PIPE_ERROR_INVAL;
+    }
+
+    ssize_t res = android_pipe_guest_send(it->second, buffers, numBuffers);
+    setErrno(res);
+    return res;
+}
+
 HostGoldfishPipeDevice::WriteResult HostGoldfishPipeDevice::write(void* pipe, const std::vector<uint8_t>& data) {
     ssize_t res = write(pipe, data.data(), data.size());
 
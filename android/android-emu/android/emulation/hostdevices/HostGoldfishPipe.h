@@ -15,6 +15,7 @@
 
 #include "android/base/Result.h"
 #include "android/base/files/Stream.h"
+#include "android/emulation/android_pipe_common.h"
 
 #include <cstdint>
 #include <functional>
@@ -64,6 +65,10 @@ public:
     ssize_t read(void* pipe, void* buffer, size_t len);
     ssize_t write(void* pipe, const void* buffer, size_t len);
 
+    // Same, with the data scattered across |numBuffers| buffers.
+    ssize_t read(void* pipe, AndroidPipeBuffer* buffers, int numBuffers);
+    ssize_t write(void* pipe, const AndroidPipeBuffer* buffers, int numBuffers);
+
     ReadResult read(void* pipe, size_t maxLength);
     WriteResult write(void* pipe, const std::vector<uint8_t>& data);
 
@@ -47,7 +47,7 @@ using android::base::AutoLock;
 #endif
 
 // Standard values from Khronos.
-#define GL_RGBA 0x1908
+#define GL_BGRA_EXT 0x80E1
 #define GL_UNSIGNED_BYTE 0x1401
 
 using android::base::CallbackRegistry;
@@ -91,7 +91,7 @@ static void onNewGpuFrame_record(void* opaque,
                                  int type,
                                  unsigned char* pixels) {
     DCHECK(ydir == -1);
-    DCHECK(format == GL_RGBA);
+    DCHECK(format == GL_BGRA_EXT);
     DCHECK(type == GL_UNSIGNED_BYTE);
 
     GpuFrameBridge* bridge = reinterpret_cast<GpuFrameBridge*>(opaque);
@@ -108,7 +108,7 @@ static void onNewGpuFrame_recordAsync(void* opaque,
                                       int type,
                                       unsigned char* pixels) {
     DCHECK(ydir == -1);
-    DCHECK(format == GL_RGBA);
+    DCHECK(format == GL_BGRA_EXT);
     DCHECK(type == GL_UNSIGNED_BYTE);
 
     GpuFrameBridge* bridge = reinterpret_cast<GpuFrameBridge*>(opaque);
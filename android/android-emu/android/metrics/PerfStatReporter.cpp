@@ -22,6 +22,7 @@
 #include "android/metrics/MetricsWriter.h"
 #include "android/metrics/PeriodicReporter.h"
 #include "android/metrics/TextMetricsWriter.h"
+#include "android/opengles.h"
 
 #include "google_logs_publishing.pb.h"
 #include "studio_stats.pb.h"
@@ -121,6 +122,7 @@ void PerfStatReporter::fillProto(android_studio::EmulatorPerformanceStats* perfS
 
 static void fillProtoMemUsage(android_studio::EmulatorPerformanceStats* stats_out);
 static void fillProtoCpuUsage(android_studio::EmulatorPerformanceStats* stats_out);
+static void fillProtoFrameStats(android_studio::EmulatorPerformanceStats* stats_out);
 
 void PerfStatReporter::dump() {
     if (mWriter != nullptr) {
@@ -147,6 +149,7 @@ void PerfStatReporter::refreshPerfStats() {
 
     fillProtoMemUsage(mCurrPerfStats.get());
     fillProtoCpuUsage(mCurrPerfStats.get());
+    fillProtoFrameStats(mCurrPerfStats.get());
 }
 
 static void fillProtoMemUsage(android_studio::EmulatorPerformanceStats* stats_out) {
@@ -194,6 +197,42 @@ static void fillProtoCpuUsage(android_studio::EmulatorPerformanceStats* stats_ou
         });
 }
 
+static void fillProtoHistogram(const emugl::FrameTimeHistogram& histogram,
+                               android_studio::Histogram* proto) {
+    using emugl::FrameTimeHistogram;
+    proto->set_total_count(histogram.totalCount());
+    // Samples in this bin and all the bins above it.
+    int64_t total = histogram.totalCount();
+    for (int i = 0; i < FrameTimeHistogram::kNumBins; ++i) {
+        auto bin = proto->add_bin();
+        bin->set_start(FrameTimeHistogram::kBinStartUs[i]);
+        if (i + 1 < FrameTimeHistogram::kNumBins) {
+            bin->set_end(FrameTimeHistogram::kBinStartUs[i + 1]);
+        }
+        bin->set_samples(histogram.count(i));
+        bin->set_total_samples(total);
+        total -= histogram.count(i);
+    }
+}
+
+static void fillProtoFrameStats(android_studio::EmulatorPerformanceStats* stats_out) {
+    const emugl::RendererPtr& renderer = android_getOpenglesRenderer();
+    if (!renderer) {
+        return;
+    }
+    for (const auto& display : renderer->getFrameStats()) {
+        const emugl::DisplayFrameStats& stats = display.second;
+        auto proto = stats_out->add_display_frame_stats();
+        proto->set_display_id(display.first);
+        proto->set_posted_frames(stats.postedFrames);
+        proto->set_presented_frames(stats.presentedFrames);
+        proto->set_coalesced_frames(stats.coalescedFrames);
+        proto->set_late_frames(stats.lateFrames);
+        fillProtoHistogram(stats.frameTimeUs, proto->mutable_frame_time_us());
+        fillProtoHistogram(stats.latencyUs, proto->mutable_latency_us());
+    }
+}
+
 }  // namespace metrics
 }  // namespace android
 
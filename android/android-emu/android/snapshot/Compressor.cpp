@@ -11,11 +11,16 @@
 
 #include "android/snapshot/Compressor.h"
 
+#include "android/base/memory/LazyInstance.h"
+#include "android/base/synchronization/ConditionVariable.h"
+#include "android/base/synchronization/Lock.h"
 #include "android/base/system/System.h"
+#include "android/base/threads/ThreadPool.h"
 
 #include "lz4.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <utility>
 
@@ -28,6 +33,61 @@ int workerCount() {
     return std::max(2, std::min(4, base::System::get()->getCpuCoreCount() - 1));
 }
 
+namespace {
+
+using Task = std::function<void()>;
+
+// Threads shared by all runOnWorkers() calls, so that a snapshot doesn't
+// start new ones every time. The calling thread works too, hence one less
+// than workerCount().
+class WorkerPool {
+public:
+    WorkerPool()
+        : mPool(std::max(1, workerCount() - 1), [](Task&& task) { task(); }) {
+        mWorkers = mPool.start() ? mPool.numWorkers() : 0;
+    }
+
+    void run(size_t count, const std::function<void(size_t)>& func) {
+        std::atomic<size_t> next{0};
+        auto work = [&next, count, &func] {
+            for (size_t i = next++; i < count; i = next++) {
+                func(i);
+            }
+        };
+
+        base::Lock lock;
+        base::ConditionVariable cv;
+        size_t pending = std::min<size_t>(mWorkers, count ? count - 1 : 0);
+        const size_t enqueued = pending;
+        for (size_t i = 0; i < enqueued; ++i) {
+            mPool.enqueue([&work, &lock, &cv, &pending] {
+                work();
+                // Signal under the lock: the waiter owns |lock| and |cv|
+                // and may return as soon as it can take the lock.
+                base::AutoLock autoLock(lock);
+                if (--pending == 0) {
+                    cv.signal();
+                }
+            });
+        }
+        work();
+        base::AutoLock autoLock(lock);
+        cv.wait(&autoLock, [&pending] { return pending == 0; });
+    }
+
+private:
+    base::ThreadPool<Task> mPool;
+    int mWorkers = 0;
+};
+
+base::LazyInstance<WorkerPool> sWorkerPool = LAZY_INSTANCE_INIT;
+
+}  // namespace
+
+void runOnWorkers(size_t count, const std::function<void(size_t)>& func) {
+    sWorkerPool->run(count, func);
+}
+
 int32_t compress(const uint8_t* data,
                  int32_t size,
                  uint8_t* out,
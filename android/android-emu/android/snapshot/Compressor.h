@@ -11,7 +11,9 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include "lz4.h"
 
 namespace android {
@@ -28,6 +30,11 @@ constexpr int32_t maxCompressedSize(int32_t dataSize) {
     return LZ4_COMPRESSBOUND(dataSize);
 }
 
+// Calls |func| for every index below |count| on the calling thread and up
+// to workerCount() - 1 shared worker threads, and returns once all calls
+// are done. |func| must not call runOnWorkers() itself.
+void runOnWorkers(size_t count, const std::function<void(size_t)>& func);
+
 }  // namespace compress
 }  // namespace snapshot
 }  // namespace android
@@ -16,6 +16,7 @@
 #include "android/base/files/PathUtils.h"
 #include "android/base/files/StdioStream.h"
 #include "android/snapshot/TextureLoader.h"
+#include "android/utils/debug.h"
 #include "android/utils/path.h"
 #include "android/utils/file_io.h"
 
@@ -45,9 +46,9 @@ Loader::Loader(const Snapshot& snapshot, int error)
     mDiskKind = System::get()->pathDiskKind(mSnapshot.dataDir());
 
     {
+        const auto ramPath = PathUtils::join(mSnapshot.dataDir(), kRamFileName);
         const auto ram = android::base::fsopen(
-                PathUtils::join(mSnapshot.dataDir(), kRamFileName).c_str(),
-                "rb", android::base::FileShare::Read);
+                ramPath.c_str(), "rb", android::base::FileShare::Read);
         if (!ram) {
             mSnapshot.saveFailure(FailureReason::NoRamFile);
             return;
@@ -58,10 +59,21 @@ Loader::Loader(const Snapshot& snapshot, int error)
         // doesn't like {} being put as an argument for the ram block structure
         // directly.
 
+        auto flags = RamLoader::Flags::OnDemandAllowed;
+        const auto trimEnvVar =
+                System::get()->envGet("ANDROID_SNAPSHOT_TRIM_RAM");
+        if (trimEnvVar == "1" || trimEnvVar == "yes" ||
+            trimEnvVar == "true") {
+            VERBOSE_PRINT(snapshot,
+                          "autoconfig: keeping unused snapshot RAM out of "
+                          "memory from environment [ANDROID_SNAPSHOT_TRIM_RAM=%s]",
+                          trimEnvVar.c_str());
+            flags |= RamLoader::Flags::TrimWorkingSet;
+        }
+
         RamLoader::RamBlockStructure emptyRamBlockStructure = {};
-        mRamLoader.emplace(StdioStream(ram, StdioStream::kOwner),
-                           RamLoader::Flags::OnDemandAllowed,
-                           emptyRamBlockStructure);
+        mRamLoader.emplace(StdioStream(ram, StdioStream::kOwner), flags,
+                           emptyRamBlockStructure, ramPath);
     }
     {
         const auto textures = android::base::fsopen(
@@ -165,6 +177,19 @@ void Loader::join() {
     }
 }
 
+void Loader::setFirstFrameCallback(
+        std::function<void(base::System::Duration)>&& callback) {
+    // Both the Snapshotter and Quickboot report a successful load; only
+    // one time to first frame should come out of it.
+    if (mFirstFrameCallbackSet) {
+        return;
+    }
+    mFirstFrameCallbackSet = true;
+    if (mTextureLoader) {
+        mTextureLoader->setFirstFrameCallback(std::move(callback));
+    }
+}
+
 void Loader::synchronize(bool isOnExit) {
     if (mTextureLoader) {
         mTextureLoader->join();
@@ -186,9 +211,12 @@ void Loader::synchronize(bool isOnExit) {
     // because it's unknown whether the particular version of this loader's
     // gaps corresponds properly to the gaps in the |kRamFileName| file on disk
     // (e.g., we might have saved more than once after a load).
+    //
+    // A layered |kRamFileName| has no gaps and is never saved over
+    // incrementally, so it always needs (b).
 
     if (mRamLoader && !mRamLoader->hasError()) {
-        if (isOnExit) {
+        if (isOnExit && !mRamLoader->layered()) {
             mRamLoader->interrupt();
         } else {
             mRamLoader->join();
@@ -204,15 +232,16 @@ void Loader::synchronize(bool isOnExit) {
         }
 
         if (!mRamLoader->hasGaps()) {
-            const auto ram = ::android_fopen(
-                    PathUtils::join(mSnapshot.dataDir(), kRamFileName).c_str(), "rb");
+            const auto ramPath =
+                    PathUtils::join(mSnapshot.dataDir(), kRamFileName);
+            const auto ram = ::android_fopen(ramPath.c_str(), "rb");
 
             if (!ram) return;
 
             mRamLoader.emplace(
                     StdioStream(ram, StdioStream::kOwner),
                     RamLoader::Flags::LoadIndexOnly,
-                    mRamLoader->getRamBlockStructure());
+                    mRamLoader->getRamBlockStructure(), ramPath);
         }
 
     }
@@ -18,6 +18,8 @@
 #include "android/snapshot/RamLoader.h"
 #include "android/snapshot/Snapshot.h"
 
+#include <functional>
+
 namespace android {
 namespace snapshot {
 
@@ -46,6 +48,12 @@ public:
 
     void join();
 
+    // Runs |callback| with the time between the start of the load and the
+    // first frame the renderer presents afterwards, in milliseconds. Only the
+    // first callback set for a load is kept; later calls do nothing.
+    void setFirstFrameCallback(
+            std::function<void(base::System::Duration)>&& callback);
+
     // synchronize() will finish all background loading operations and update
     // the gap tracker with gap info from the ram file on disk, making the
     // Loader good for doing all other operations that can happen on it.
@@ -63,6 +71,7 @@ private:
 
     base::System::MemUsage mMemUsage;
     base::Optional<base::System::DiskKind> mDiskKind = {};
+    bool mFirstFrameCallbackSet = false;
 };
 
 }  // namespace snapshot
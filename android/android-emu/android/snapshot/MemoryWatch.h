@@ -48,8 +48,10 @@ class MemoryAccessWatch {
 public:
     static bool isSupported();
 
+    // Sleep is for when nothing is left to do until a page is accessed; the
+    // callback runs again much later than with Wait.
     enum class IdleCallbackResult {
-        RunAgain, Wait, AllDone
+        RunAgain, Wait, Sleep, AllDone
     };
 
     using AccessCallback = std::function<void(void*)>;
@@ -77,5 +79,32 @@ private:
     std::unique_ptr<Impl> mImpl;
 };
 
+// Holds the writes to write-protected memory until it's unprotected, so that
+// the pages can be saved as they were while the guest keeps running.
+class MemoryWriteWatch {
+public:
+    static bool isSupported();
+
+    // Called on the watch's thread with the page about to be written to; the
+    // writer waits until unprotect() is called for it.
+    using WriteCallback = std::function<void(void*)>;
+
+    explicit MemoryWriteWatch(WriteCallback&& writeCallback);
+
+    ~MemoryWriteWatch();
+
+    bool valid() const;
+    bool protectMemoryRange(void* start, size_t length);
+    void doneRegistering();
+    bool unprotect(void* start, size_t length);
+
+    // Unprotects all ranges and waits for the thread to stop.
+    void join();
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> mImpl;
+};
+
 }  // namespace snapshot
 }  // namespace android
@@ -156,6 +156,9 @@ public:
                 case IdleCallbackResult::Wait:
                     timeoutUs = 500;
                     break;
+                case IdleCallbackResult::Sleep:
+                    timeoutUs = 20 * 1000;
+                    break;
                 case IdleCallbackResult::AllDone:
                     return;
             }
@@ -230,5 +233,33 @@ void MemoryAccessWatch::join() {
     if (mImpl) { mImpl->join(); }
 }
 
+// Write-protecting guest RAM would need the hypervisor's help here, which
+// isn't implemented.
+class MemoryWriteWatch::Impl {};
+
+bool MemoryWriteWatch::isSupported() {
+    return false;
+}
+
+MemoryWriteWatch::MemoryWriteWatch(WriteCallback&& writeCallback) {}
+
+MemoryWriteWatch::~MemoryWriteWatch() {}
+
+bool MemoryWriteWatch::valid() const {
+    return false;
+}
+
+bool MemoryWriteWatch::protectMemoryRange(void* start, size_t length) {
+    return false;
+}
+
+void MemoryWriteWatch::doneRegistering() {}
+
+bool MemoryWriteWatch::unprotect(void* start, size_t length) {
+    return false;
+}
+
+void MemoryWriteWatch::join() {}
+
 }  // namespace snapshot
 }  // namespace android
@@ -43,6 +43,25 @@
 #endif
 #endif
 
+// Write-protect mode is missing from older kernel headers as well.
+#ifndef UFFDIO_REGISTER_MODE_WP
+#define UFFD_FEATURE_PAGEFAULT_FLAG_WP (1 << 0)
+#define UFFD_PAGEFAULT_FLAG_WP (1 << 1)
+#define UFFDIO_REGISTER_MODE_WP ((__u64)1 << 1)
+#define _UFFDIO_WRITEPROTECT (0x06)
+#define UFFDIO_WRITEPROTECT_MODE_WP ((__u64)1 << 0)
+struct uffdio_writeprotect {
+    struct uffdio_range range;
+    __u64 mode;
+};
+#define UFFDIO_WRITEPROTECT \
+    _IOWR(UFFDIO, _UFFDIO_WRITEPROTECT, struct uffdio_writeprotect)
+#endif
+
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22
+#endif
+
 namespace fc = android::featurecontrol;
 using fc::Feature;
 
@@ -82,6 +101,34 @@ static bool checkUserfaultFdCaps(int ufd) {
     return true;
 }
 
+static void* readNextPagefaultAddr(int ufd) {
+    uffd_msg msg;
+    const auto ret = HANDLE_EINTR(read(ufd, &msg, sizeof(msg)));
+    if (ret != sizeof(msg)) {
+        if (errno == EAGAIN) {
+            /* if a wake up happens on the other thread just after
+             * the poll, there is nothing to read. */
+            return nullptr;
+        }
+        if (ret < 0) {
+            derror("%s: Failed to read full userfault message: %s",
+                   __func__, strerror(errno));
+            return nullptr;
+        } else {
+            derror("%s: Read %d bytes from userfaultfd expected %zd",
+                   __func__, ret, sizeof(msg));
+            return nullptr; /* Lost alignment, don't know what we'd read
+                               next */
+        }
+    }
+    if (msg.event != UFFD_EVENT_PAGEFAULT) {
+        derror("%s: Read unexpected event %ud from userfaultfd", __func__,
+               msg.event);
+        return nullptr; /* It's not a page fault, shouldn't happen */
+    }
+    return reinterpret_cast<void*>(uintptr_t(msg.arg.pagefault.address));
+}
+
 class MemoryAccessWatch::Impl {
 public:
     Impl(MemoryAccessWatch::AccessCallback&& accessCallback,
@@ -102,35 +149,6 @@ public:
 
     ~Impl() { join(); }
 
-    void* readNextPagefaultAddr() const {
-        uffd_msg msg;
-        const auto ret =
-                HANDLE_EINTR(read(mUserfaultFd.get(), &msg, sizeof(msg)));
-        if (ret != sizeof(msg)) {
-            if (errno == EAGAIN) {
-                /* if a wake up happens on the other thread just after
-                 * the poll, there is nothing to read. */
-                return nullptr;
-            }
-            if (ret < 0) {
-                derror("%s: Failed to read full userfault message: %s",
-                       __func__, strerror(errno));
-                return nullptr;
-            } else {
-                derror("%s: Read %d bytes from userfaultfd expected %zd",
-                       __func__, ret, sizeof(msg));
-                return nullptr; /* Lost alignment, don't know what we'd read
-                                   next */
-            }
-        }
-        if (msg.event != UFFD_EVENT_PAGEFAULT) {
-            derror("%s: Read unexpected event %ud from userfaultfd", __func__,
-                   msg.event);
-            return nullptr; /* It's not a page fault, shouldn't happen */
-        }
-        return reinterpret_cast<void*>(uintptr_t(msg.arg.pagefault.address));
-    }
-
     void pagefaultWorker() {
         assert(mUserfaultFd.valid());
         int timeoutNs = 0;
@@ -147,7 +165,7 @@ public:
                 break;
             }
             if (pfd[1].revents) {
-                while (auto ptr = readNextPagefaultAddr()) {
+                while (auto ptr = readNextPagefaultAddr(mUserfaultFd.get())) {
                     mAccessCallback(ptr);
                 }
                 timeoutNs = 0;
@@ -171,6 +189,9 @@ public:
                     case IdleCallbackResult::Wait:
                         timeoutNs = 500 * 1000;
                         break;
+                    case IdleCallbackResult::Sleep:
+                        timeoutNs = 20 * 1000 * 1000;
+                        break;
                     case IdleCallbackResult::AllDone:
                         unregisterAll();
                         done = true;
@@ -299,5 +320,160 @@ void MemoryAccessWatch::join() {
     }
 }
 
+static bool checkUserfaultFdWriteProtect(int ufd) {
+    if (ufd < 0) {
+        return false;
+    }
+
+    uffdio_api apiStruct = {UFFD_API, UFFD_FEATURE_PAGEFAULT_FLAG_WP};
+    if (ioctl(ufd, UFFDIO_API, &apiStruct)) {
+        // Kernels before 5.7 don't know about write-protect faults.
+        VERBOSE_PRINT(snapshot, "userfaultfd write-protect: %s",
+                      strerror(errno));
+        return false;
+    }
+
+    const uint64_t ioctlMask =
+            1ull << _UFFDIO_REGISTER | 1ull << _UFFDIO_UNREGISTER;
+    return (apiStruct.ioctls & ioctlMask) == ioctlMask;
+}
+
+class MemoryWriteWatch::Impl {
+public:
+    Impl(MemoryWriteWatch::WriteCallback&& writeCallback)
+        : mWriteCallback(std::move(writeCallback)),
+          mPagefaultThread([this]() { pagefaultWorker(); }) {
+        mUserfaultFd = base::ScopedFd(
+                int(syscall(__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK)));
+        if (!checkUserfaultFdWriteProtect(mUserfaultFd.get())) {
+            mUserfaultFd.close();
+        }
+        mExitFd = base::ScopedFd(eventfd(0, EFD_CLOEXEC));
+        assert(mExitFd.get() >= 0);
+    }
+
+    ~Impl() { join(); }
+
+    void pagefaultWorker() {
+        for (;;) {
+            pollfd pfd[] = {{mExitFd.get(), POLLIN},
+                            {mUserfaultFd.get(), POLLIN}};
+            if (HANDLE_EINTR(poll(pfd, ARRAY_SIZE(pfd), -1)) == -1) {
+                derror("%s: userfault poll: %s", __func__, strerror(errno));
+                break;
+            }
+            if (pfd[1].revents) {
+                while (auto ptr = readNextPagefaultAddr(mUserfaultFd.get())) {
+                    mWriteCallback(ptr);
+                }
+            }
+            if (pfd[0].revents) {
+                break;
+            }
+        }
+    }
+
+    bool writeProtect(void* start, size_t length, bool protect) {
+        uffdio_writeprotect wpStruct = {
+                {(uintptr_t)start, length},
+                protect ? UFFDIO_WRITEPROTECT_MODE_WP : 0};
+        if (ioctl(mUserfaultFd.get(), UFFDIO_WRITEPROTECT, &wpStruct)) {
+            derror("%s: userfault %sprotect %p - %s", __func__,
+                   protect ? "" : "un", start, strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    void unregister(void* start, size_t length) {
+        uffdio_range rangeStruct{(uintptr_t)start, length};
+        if (ioctl(mUserfaultFd.get(), UFFDIO_UNREGISTER, &rangeStruct)) {
+            derror("%s: userfault unregister %p - %s", __func__, start,
+                   strerror(errno));
+        }
+    }
+
+    void join() {
+        // Unprotecting wakes up any writers still waiting.
+        for (auto&& range : mRanges) {
+            writeProtect(range.first, range.second, false);
+            unregister(range.first, range.second);
+        }
+        mRanges.clear();
+        if (mStarted) {
+            HANDLE_EINTR(eventfd_write(mExitFd.get(), 1));
+            mPagefaultThread.wait();
+            mStarted = false;
+        }
+    }
+
+    MemoryWriteWatch::WriteCallback mWriteCallback;
+
+    base::ScopedFd mUserfaultFd;
+    base::ScopedFd mExitFd;
+
+    std::vector<std::pair<void*, uint64_t>> mRanges;
+
+    base::FunctorThread mPagefaultThread;
+    bool mStarted = false;
+};
+
+bool MemoryWriteWatch::isSupported() {
+    base::ScopedFd ufd(int(syscall(__NR_userfaultfd, O_CLOEXEC)));
+    return checkUserfaultFdWriteProtect(ufd.get());
+}
+
+MemoryWriteWatch::MemoryWriteWatch(WriteCallback&& writeCallback)
+    : mImpl(new Impl(std::move(writeCallback))) {}
+
+MemoryWriteWatch::~MemoryWriteWatch() {}
+
+bool MemoryWriteWatch::valid() const {
+    return mImpl->mUserfaultFd.valid();
+}
+
+bool MemoryWriteWatch::protectMemoryRange(void* start, size_t length) {
+    // Only the pages that are mapped get protected, so map the ones that
+    // aren't yet to the zero page.
+    if (madvise(start, length, MADV_POPULATE_READ)) {
+        const auto end = static_cast<volatile char*>(start) + length;
+        for (auto ptr = static_cast<volatile char*>(start); ptr < end;
+             ptr += getpagesize()) {
+            (void)*ptr;
+        }
+    }
+
+    uffdio_register regStruct = {{(uintptr_t)start, length},
+                                 UFFDIO_REGISTER_MODE_WP};
+    if (ioctl(mImpl->mUserfaultFd.get(), UFFDIO_REGISTER, &regStruct)) {
+        // Write-protecting shared memory needs Linux 5.19.
+        VERBOSE_PRINT(snapshot, "%s userfault register(%p, %zu): %s",
+                      __func__, start, length, strerror(errno));
+        return false;
+    }
+    if (!(regStruct.ioctls & (1ull << _UFFDIO_WRITEPROTECT)) ||
+        !mImpl->writeProtect(start, length, true)) {
+        mImpl->unregister(start, length);
+        return false;
+    }
+
+    mImpl->mRanges.emplace_back(start, length);
+    return true;
+}
+
+void MemoryWriteWatch::doneRegistering() {
+    if (valid() && !mImpl->mStarted) {
+        mImpl->mStarted = mImpl->mPagefaultThread.start();
+    }
+}
+
+bool MemoryWriteWatch::unprotect(void* start, size_t length) {
+    return mImpl->writeProtect(start, length, false);
+}
+
+void MemoryWriteWatch::join() {
+    mImpl->join();
+}
+
 }  // namespace snapshot
 }  // namespace android
@@ -132,6 +132,7 @@ void Quickboot::reportSuccessfulLoad(StringView name,
         load->set_on_demand_ram_enabled(stats.onDemandRamEnabled);
         Snapshotter::fillSnapshotMetrics(event, stats);
     });
+    Snapshotter::get().reportTimeToFirstFrame(c_str(name));
 #endif
 }
 
@@ -15,9 +15,10 @@
 #include "android/base/ArraySize.h"
 #include "android/base/ContiguousRangeMapper.h"
 #include "android/base/EintrWrapper.h"
+#include "android/base/files/FileShareOpen.h"
 #include "android/base/Profiler.h"
 #include "android/base/Stopwatch.h"
-#include "android/base/files/MemStream.h"
+#include "android/base/files/MappedFileStream.h"
 #include "android/base/files/PathUtils.h"
 #include "android/base/files/preadwrite.h"
 #include "android/base/memory/MemoryHints.h"
@@ -30,6 +31,8 @@
 #include "android/utils/path.h"
 #include "android/utils/file_io.h"
 
+#include "MurmurHash3.h"
+
 #include <algorithm>
 #include <atomic>
 #include <cassert>
@@ -37,7 +40,6 @@
 
 using android::base::ContiguousRangeMapper;
 using android::base::MemoryHint;
-using android::base::MemStream;
 using android::base::PathUtils;
 using android::base::ScopedMemoryProfiler;
 using android::base::Stopwatch;
@@ -54,13 +56,17 @@ RamLoader::RamBlockStructure::~RamBlockStructure() {}
 
 RamLoader::RamLoader(base::StdioStream&& stream,
                      Flags flags,
-                     const RamLoader::RamBlockStructure& blockStructure)
-    : mStream(std::move(stream)), mReaderThread([this]() { readerWorker(); }) {
+                     const RamLoader::RamBlockStructure& blockStructure,
+                     const std::string& filePath)
+    : mStream(std::move(stream)),
+      mFilePath(filePath),
+      mReaderThread([this]() { readerWorker(); }),
+      mTrimWorkingSet(nonzero(flags & Flags::TrimWorkingSet)) {
     if (nonzero(flags & Flags::LoadIndexOnly)) {
         mIndexOnly = true;
         applyRamBlockStructure(blockStructure);
         readIndex();
-        mStream.close();
+        closeStreams();
         return;
     }
 
@@ -147,6 +153,7 @@ bool RamLoader::start(bool isQuickboot) {
     if (!mAccessWatch) {
         bool res = readAllPages();
         mEndTime = base::System::get()->getHighResTimeUs();
+        reportUntouchedBytes();
 #if SNAPSHOT_PROFILE > 1
         printf("Eager RAM load complete in %.03f ms\n",
                (mEndTime - mStartTime) / 1000.0);
@@ -170,6 +177,8 @@ void RamLoader::join() {
     Stopwatch sw;
 #endif
 
+    reportUntouchedBytes();
+
     if (mAccessWatch) {
         // Unprotect all. Warning: this assumes the VM is stopped.
 
@@ -195,7 +204,7 @@ void RamLoader::join() {
         mAccessWatch->join();
         mAccessWatch.clear();
     }
-    mStream.close();
+    closeStreams();
 
 #if SNAPSHOT_PROFILE > 1
     printf("Finished remaining RAM load in %f ms\n", sw.elapsedUs() / 1000.0f);
@@ -203,6 +212,7 @@ void RamLoader::join() {
 }
 
 void RamLoader::interrupt() {
+    reportUntouchedBytes();
     mReadDataQueue.stop();
     mReadingQueue.stop();
     mReaderThread.wait();
@@ -210,7 +220,7 @@ void RamLoader::interrupt() {
         mAccessWatch->join();
         mAccessWatch.clear();
     }
-    mStream.close();
+    closeStreams();
 }
 
 // Touches all pages that are currently file-backed, making sure
@@ -257,6 +267,45 @@ void RamLoader::zeroOutPage(const Page& page) {
     }
 }
 
+bool RamLoader::canReleaseZeroPage(const Page& page) const {
+#ifdef __linux__
+    // Private anonymous memory reads back as zeroes once it's released, while
+    // a file mapping would read back the file.
+    const RamBlock& block = mIndex.blocks[page.blockIndex].ramBlock;
+    return mTrimWorkingSet && !(block.flags & SNAPSHOT_RAM_MAPPED);
+#else
+    return false;
+#endif
+}
+
+uint64_t RamLoader::untouchedBytes() const {
+    uint64_t bytes = mReleasedZeroBytes;
+    if (mTrimWorkingSet && mOnDemandEnabled && mAccessWatch) {
+        for (const Page& page : mIndex.pages) {
+            if (page.state.load(std::memory_order_relaxed) <
+                uint8_t(State::Filled)) {
+                bytes += pageSize(page);
+            }
+        }
+    }
+    return bytes;
+}
+
+void RamLoader::reportUntouchedBytes() {
+    if (!mTrimWorkingSet || !mWasStarted || mHasError ||
+        mUntouchedBytesReported) {
+        return;
+    }
+    mUntouchedBytesReported = true;
+    uint64_t totalBytes = 0;
+    for (const auto& block : mIndex.blocks) {
+        totalBytes += uint64_t(block.ramBlock.totalSize);
+    }
+    dprint("Snapshot RAM kept out of memory: %llu of %llu MB",
+           (unsigned long long)(untouchedBytes() / (1024 * 1024)),
+           (unsigned long long)(totalBytes / (1024 * 1024)));
+}
+
 bool RamLoader::readIndex() {
 #if SNAPSHOT_PROFILE > 1
     auto start = base::System::get()->getHighResTimeUs();
@@ -269,25 +318,30 @@ bool RamLoader::readIndex() {
     mDiskSize = size;
     mIndexPos = mStream.getBe64();
 
-    MemStream::Buffer buffer(size - mIndexPos);
-    if (base::pread(mStreamFd, buffer.data(), buffer.size(), mIndexPos) !=
-        buffer.size()) {
+    // The index is parsed right out of the mapping, instead of a copy.
+    base::MappedFileStream stream(mStreamFd, mIndexPos,
+                                  base::MappedFileStream::kToEnd,
+                                  base::MemoryHint::Sequential);
+    if (!stream.valid() || stream.size() != size - mIndexPos) {
         return false;
     }
 
-    MemStream stream(std::move(buffer));
-
     mVersion = stream.getBe32();
-    if (mVersion < 1 || mVersion > 2) {
+    if (mVersion < 1 || mVersion > 3) {
         return false;
     }
     mIndex.flags = IndexFlags(stream.getBe32());
     const bool compressed = nonzero(mIndex.flags & IndexFlags::CompressedPages);
     auto pageCount = stream.getBe32();
 
+    mLayerFds.assign(1, mStreamFd);
+    if (layered() && !readLayers(&stream)) {
+        return false;
+    }
+
     mIndex.pages.reserve(pageCount);
-    int64_t runningFilePos = 8;
-    int32_t prevPageSizeOnDisk = 0;
+    std::vector<int64_t> runningFilePos(mLayerFds.size(), 8);
+    std::vector<int32_t> prevPageSizeOnDisk(mLayerFds.size(), 0);
     for (size_t loadedBlockCount = 0; loadedBlockCount < mIndex.blocks.size();
          ++loadedBlockCount) {
         const auto nameLength = stream.getByte();
@@ -304,8 +358,12 @@ bool RamLoader::readIndex() {
         readBlockPages(&stream, blockIt, compressed, &runningFilePos,
                        &prevPageSizeOnDisk);
     }
+    if (mHasError) {
+        return false;
+    }
 
-    if (mVersion > 1) {
+    // Layered files are always written anew, and have no gaps.
+    if (mVersion > 1 && !layered()) {
         mGaps = compressed ? GapTracker::Ptr(new GenericGapTracker())
                            : GapTracker::Ptr(new OneSizeGapTracker());
         mGaps->load(stream);
@@ -318,13 +376,100 @@ bool RamLoader::readIndex() {
     return true;
 }
 
+bool RamLoader::readLayers(base::Stream* stream) {
+    const auto count = stream->getBe32();
+    if (count + 1 > uint32_t(kMaxRamLayers)) {
+        return false;
+    }
+
+    const auto baseDir = getRamLayersBaseDir(mFilePath);
+    mLayerStreams.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const auto path = PathUtils::join(baseDir, stream->getString());
+        std::array<char, 16> indexHash;
+        stream->read(indexHash.data(), indexHash.size());
+        if (mIndexOnly) {
+            // Nothing is read from the layers then.
+            mLayerFds.push_back(-1);
+            continue;
+        }
+
+        base::StdioStream layer(
+                android::base::fsopen(path.c_str(), "rb",
+                                      android::base::FileShare::Read),
+                base::StdioStream::kOwner);
+        if (!layer.get()) {
+            VERBOSE_PRINT(snapshot, "Missing RAM layer '%s'", path.c_str());
+            return false;
+        }
+
+        // The layer must not have been saved over since.
+        const int fd = fileno(layer.get());
+        base::MappedFileStream layerIndex(fd, layer.getBe64());
+        std::array<char, 16> actualHash;
+        const void* data = layerIndex.valid()
+                                   ? layerIndex.readInPlace(layerIndex.size())
+                                   : nullptr;
+        if (!data) {
+            return false;
+        }
+        MurmurHash3_x64_128(data, int(layerIndex.size()), 0,
+                            actualHash.data());
+        if (actualHash != indexHash) {
+            VERBOSE_PRINT(snapshot, "RAM layer '%s' has changed",
+                          path.c_str());
+            return false;
+        }
+
+        mLayerFds.push_back(fd);
+        mLayerStreams.push_back(std::move(layer));
+    }
+    return true;
+}
+
+// static
+std::vector<std::string> RamLoader::readLayerNames(base::StringView ramFile) {
+    std::vector<std::string> res;
+    base::StdioStream stream(
+            android::base::fsopen(c_str(ramFile), "rb",
+                                  android::base::FileShare::Read),
+            base::StdioStream::kOwner);
+    if (!stream.get()) {
+        return res;
+    }
+    const auto indexPos = stream.getBe64();
+    if (HANDLE_EINTR(fseeko64(stream.get(), int64_t(indexPos), SEEK_SET))) {
+        return res;
+    }
+    const auto version = stream.getBe32();
+    const auto flags = IndexFlags(stream.getBe32());
+    stream.getBe32();  // page count
+    if (version < 3 || !nonzero(flags & IndexFlags::Layered)) {
+        return res;
+    }
+    const auto count = stream.getBe32();
+    if (count + 1 > uint32_t(kMaxRamLayers)) {
+        return res;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        res.push_back(stream.getString());
+        std::array<char, 16> indexHash;
+        stream.read(indexHash.data(), indexHash.size());
+    }
+    if (ferror(stream.get())) {
+        res.clear();
+    }
+    return res;
+}
+
 void RamLoader::readBlockPages(base::Stream* stream,
                                FileIndex::Blocks::iterator blockIt,
                                bool compressed,
-                               int64_t* runningFilePosPtr,
-                               int32_t* prevPageSizeOnDiskPtr) {
-    auto runningFilePos = *runningFilePosPtr;
-    auto prevPageSizeOnDisk = *prevPageSizeOnDiskPtr;
+                               std::vector<int64_t>* runningFilePosPtr,
+                               std::vector<int32_t>* prevPageSizeOnDiskPtr) {
+    auto& runningFilePos = *runningFilePosPtr;
+    auto& prevPageSizeOnDisk = *prevPageSizeOnDiskPtr;
+    const bool layered = this->layered();
 
     const auto blockIndex = std::distance(mIndex.blocks.begin(), blockIt);
 
@@ -441,24 +586,29 @@ void RamLoader::readBlockPages(base::Stream* stream,
             }
             page.blockIndex = uint16_t(blockIndex);
             page.sizeOnDisk = uint32_t(sizeOnDisk);
+            if (layered) {
+                const auto layer = stream->getPackedNum();
+                if (layer >= runningFilePos.size()) {
+                    mHasError = true;
+                    return;
+                }
+                page.layer = uint8_t(layer);
+            }
             auto posDelta = stream->getPackedSignedNum();
             if (compressed) {
-                posDelta += prevPageSizeOnDisk;
-                prevPageSizeOnDisk = int32_t(page.sizeOnDisk);
+                posDelta += prevPageSizeOnDisk[page.layer];
+                prevPageSizeOnDisk[page.layer] = int32_t(page.sizeOnDisk);
             } else {
                 page.sizeOnDisk *= uint32_t(block.ramBlock.pageSize);
                 posDelta *= block.ramBlock.pageSize;
             }
-            if (mVersion == 2) {
+            if (mVersion >= 2) {
                 stream->read(page.hash.data(), page.hash.size());
             }
-            runningFilePos += posDelta;
-            page.filePos = uint64_t(runningFilePos);
+            runningFilePos[page.layer] += posDelta;
+            page.filePos = uint64_t(runningFilePos[page.layer]);
         }
     }
-
-    *runningFilePosPtr = runningFilePos;
-    *prevPageSizeOnDiskPtr = prevPageSizeOnDisk;
 }
 
 bool RamLoader::registerPageWatches() {
@@ -552,6 +702,11 @@ MemoryAccessWatch::IdleCallbackResult RamLoader::backgroundPageLoad() {
         return MemoryAccessWatch::IdleCallbackResult::AllDone;
     }
 
+    if (mTrimWorkingSet && !mJoining) {
+        // The pages the guest never touches stay in the snapshot file.
+        return MemoryAccessWatch::IdleCallbackResult::Sleep;
+    }
+
     {
         Page* page = nullptr;
         if (mReadDataQueue.tryReceive(&page)) {
@@ -680,8 +835,8 @@ bool RamLoader::readDataFromDisk(Page* pagePtr, uint8_t* preallocatedBuffer) {
                           !preallocatedBuffer;
     auto buf = allocateBuffer ? new uint8_t[size]
                               : compressed ? compressedBuf : preallocatedBuffer;
-    auto read = HANDLE_EINTR(
-            base::pread(mStreamFd, buf, size, int64_t(page.filePos)));
+    auto read = HANDLE_EINTR(base::pread(mLayerFds[page.layer], buf, size,
+                                         int64_t(page.filePos)));
     if (read != int64_t(size)) {
         VERBOSE_PRINT(snapshot,
                       "Error: (%d) Reading page %p from disk returned less "
@@ -795,11 +950,29 @@ bool RamLoader::readAllPages() {
     auto startTime1 = base::System::get()->getHighResTimeUs();
 #endif
 
-    for (Page& page : mIndex.pages) {
-        if (page.sizeOnDisk) {
-            sortedPages.emplace_back(&page);
-        } else if (!mIsQuickboot) {
-            zeroOutPage(page);
+    {
+        // Zero pages that can be released don't need to be read or written.
+        ContiguousRangeMapper zeroPageReleaser(
+                [this](uintptr_t start, uintptr_t size) {
+                    if (android::base::memoryHint((void*)start, size,
+                                                  MemoryHint::DontNeed)) {
+                        mReleasedZeroBytes += size;
+                    } else {
+                        memset((void*)start, 0, size);
+                    }
+                });
+
+        for (Page& page : mIndex.pages) {
+            if (page.sizeOnDisk) {
+                sortedPages.emplace_back(&page);
+            } else if (!mIsQuickboot) {
+                if (canReleaseZeroPage(page)) {
+                    zeroPageReleaser.add((uintptr_t)pagePtr(page),
+                                         pageSize(page));
+                } else {
+                    zeroOutPage(page);
+                }
+            }
         }
     }
 
@@ -810,7 +983,8 @@ bool RamLoader::readAllPages() {
 
     std::sort(sortedPages.begin(), sortedPages.end(),
               [](const Page* l, const Page* r) {
-                  return l->filePos < r->filePos;
+                  return l->layer != r->layer ? l->layer < r->layer
+                                              : l->filePos < r->filePos;
               });
 
 #if SNAPSHOT_PROFILE > 1
@@ -832,6 +1006,13 @@ bool RamLoader::readAllPages() {
     return true;
 }
 
+void RamLoader::closeStreams() {
+    mStream.close();
+    for (auto& layer : mLayerStreams) {
+        layer.close();
+    }
+}
+
 void RamLoader::startDecompressor() {
     mDecompressor.emplace([this](Page* page) {
         const bool res = Decompressor::decompress(
@@ -43,6 +43,10 @@ public:
         None = 0x0,
         LoadIndexOnly = 0x1,
         OnDemandAllowed = 0x2,
+        // Keeps the RAM the guest doesn't use out of memory: zero pages are
+        // left to the OS instead of being written, and an on-demand load only
+        // loads the pages the guest touches until join().
+        TrimWorkingSet = 0x4,
     };
 
     enum class State : uint8_t { Empty, Reading, Read, Filling, Filled, Error };
@@ -72,9 +76,12 @@ public:
         std::vector<RamBlock> blocks;
     };
 
+    // |filePath| is where |stream| was opened from, for finding the files a
+    // layered RAM file refers to.
     RamLoader(base::StdioStream&& stream,
               Flags flags,
-              const RamBlockStructure& blockStructure = {});
+              const RamBlockStructure& blockStructure = {},
+              const std::string& filePath = std::string());
 
     ~RamLoader();
 
@@ -104,6 +111,9 @@ public:
     uint64_t diskSize() const { return mDiskSize; }
     int version() const { return mVersion; }
     uint64_t indexOffset() const { return mIndexPos; }
+    bool layered() const {
+        return (mIndex.flags & IndexFlags::Layered) != 0;
+    }
 
     const Page* findPage(int blockIndex, const char* id, int pageIndex) const;
 
@@ -121,21 +131,35 @@ public:
         return true;
     }
 
+    // Returns how much of the RAM the load has kept out of memory so far: the
+    // zero pages left to the OS, and the pages an on-demand TrimWorkingSet
+    // load hasn't loaded.
+    uint64_t untouchedBytes() const;
+
     bool didSwitchFileBacking() const {
         return mLoadedFromFileBacking || mLoadedToFileBacking;
     }
 
+    // Returns the other RAM files the layered RAM file |ramFile| takes pages
+    // from, as RamSaver recorded them: relative to
+    // getRamLayersBaseDir(|ramFile|). Empty if it isn't layered or can't be
+    // read.
+    static std::vector<std::string> readLayerNames(base::StringView ramFile);
+
 private:
 
     bool readIndex();
+    bool readLayers(base::Stream* stream);
     void readBlockPages(base::Stream* stream,
                         FileIndex::Blocks::iterator blockIt,
                         bool compressed,
-                        int64_t* runningFilePos,
-                        int32_t* prevPageSizeOnDisk);
+                        std::vector<int64_t>* runningFilePos,
+                        std::vector<int32_t>* prevPageSizeOnDisk);
     bool registerPageWatches();
 
     void zeroOutPage(const Page& page);
+    bool canReleaseZeroPage(const Page& page) const;
+    void reportUntouchedBytes();
     uint8_t* pagePtr(const Page& page) const;
     uint32_t pageSize(const Page& page) const;
     Page& page(void* ptr);
@@ -151,9 +175,15 @@ private:
 
     bool readAllPages();
     void startDecompressor();
+    void closeStreams();
 
     base::StdioStream mStream;
     int mStreamFd;  // An FD for the |mStream|'s underlying open file.
+    std::string mFilePath;
+    // The files of the other layers of a layered RAM file, and the FDs of all
+    // of them, indexed by Page::layer.
+    std::vector<base::StdioStream> mLayerStreams;
+    std::vector<int> mLayerFds;
     bool mWasStarted = false;
     std::atomic<bool> mHasError{false};
 
@@ -191,6 +221,10 @@ private:
     // Whether or not we just want to reload the index.
     bool mIndexOnly = false;
 
+    bool mTrimWorkingSet = false;
+    bool mUntouchedBytesReported = false;
+    uint64_t mReleasedZeroBytes = 0;
+
     // Whether we loaded eagerly from a ram.img
     bool mLoadedFromFileBacking = false;
 
@@ -203,6 +237,7 @@ private:
 
 struct RamLoader::Page {
     std::atomic<uint8_t> state{uint8_t(State::Empty)};
+    uint8_t layer = 0;
     uint16_t blockIndex;
     uint32_t sizeOnDisk;
     uint64_t filePos;
@@ -213,6 +248,7 @@ struct RamLoader::Page {
     Page(RamLoader::State state) : state(uint8_t(state)) {}
     Page(Page&& other)
         : state(other.state.load(std::memory_order_relaxed)),
+          layer(other.layer),
           blockIndex(other.blockIndex),
           sizeOnDisk(other.sizeOnDisk),
           filePos(other.filePos),
@@ -221,6 +257,7 @@ struct RamLoader::Page {
     Page& operator=(Page&& other) {
         state.store(other.state.load(std::memory_order_relaxed),
                     std::memory_order_relaxed);
+        layer = other.layer;
         blockIndex = other.blockIndex;
         sizeOnDisk = other.sizeOnDisk;
         filePos = other.filePos;
@@ -16,7 +16,9 @@
 #include "android/base/Stopwatch.h"
 #include "android/base/EintrWrapper.h"
 #include "android/base/files/FileShareOpen.h"
+#include "android/base/files/BufferedStream.h"
 #include "android/base/files/MemStream.h"
+#include "android/base/files/PathUtils.h"
 #include "android/base/files/preadwrite.h"
 #include "android/base/memory/MemoryHints.h"
 #include "android/base/memory/OnDemand.h"
@@ -30,6 +32,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iterator>
 #include <utility>
 
@@ -44,9 +47,11 @@
 namespace android {
 namespace snapshot {
 
+using android::base::AutoLock;
 using android::base::ContiguousRangeMapper;
 using android::base::MemStream;
 using android::base::MemoryHint;
+using android::base::PathUtils;
 using android::base::ScopedMemoryProfiler;
 using android::base::System;
 
@@ -60,8 +65,15 @@ void RamSaver::FileIndex::clear() {
 RamSaver::RamSaver(const std::string& fileName,
                    Flags preferredFlags,
                    RamLoader* loader,
-                   bool isOnExit)
-    : mStream(nullptr) {
+                   bool isOnExit,
+                   RamCheckpointPtr parent)
+    : mParent(std::move(parent)), mFileName(fileName), mStream(nullptr) {
+    assert(!loader || !mParent);
+    if (layered() && int(mParent->files.size()) >= kMaxRamLayers) {
+        mHasError = true;
+        return;
+    }
+
     bool incremental = false;
     if (loader) {
         // check if we're ok to proceed with incremental saving
@@ -106,6 +118,12 @@ RamSaver::RamSaver(const std::string& fileName,
         }
     } else {
         mFlags = preferredFlags;
+        if (layered()) {
+            // All layers have to agree on the page compression, and the
+            // separate backing store isn't layered.
+            mFlags = mParent->compressed ? RamSaver::Flags::Compress
+                                         : RamSaver::Flags::None;
+        }
         mStream = base::StdioStream(
                 android::base::fsopen(fileName.c_str(), "wb",
                                       android::base::FileShare::Write),
@@ -123,10 +141,23 @@ RamSaver::RamSaver(const std::string& fileName,
 
     mStreamFd = fileno(mStream.get());
 
+    if (copyOnWrite()) {
+        mWriteWatch.emplace([this](void* ptr) { onGuestWrite(ptr); });
+        if (!mWriteWatch->valid()) {
+            mWriteWatch.clear();
+            mFlags &= ~Flags::CopyOnWrite;
+        }
+    }
+
     if (nonzero(mFlags & Flags::Async)) {
         mIndex.flags |= int32_t(FileIndex::Flags::SeparateBackingStore);
     }
 
+    if (layered()) {
+        mIndex.version = 3;
+        mIndex.flags |= int32_t(FileIndex::Flags::Layered);
+    }
+
     if (nonzero(mFlags & Flags::Compress)) {
         mIndex.flags |= int32_t(FileIndex::Flags::CompressedPages);
 
@@ -169,11 +200,47 @@ RamSaver::~RamSaver() {
 
 void RamSaver::registerBlock(const RamBlock& block) {
     mIndex.blocks.push_back({block, {}});
+    if (!layered()) {
+        return;
+    }
+
+    // Start from the parent's pages, as only the ones written since are going
+    // to be saved.
+    const auto blockIndex = mIndex.blocks.size() - 1;
+    if (blockIndex >= mParent->blocks.size() ||
+        mParent->blocks[blockIndex].id != block.id ||
+        mParent->blocks[blockIndex].totalSize != block.totalSize) {
+        VERBOSE_PRINT(snapshot, "RAM block '%s' doesn't match the parent's",
+                      block.id);
+        mHasError = true;
+        return;
+    }
+
+    const auto& parentPages = mParent->blocks[blockIndex].pages;
+    auto& indexBlock = mIndex.blocks.back();
+    indexBlock.ramBlock.pageSize = kDefaultPageSize;
+    indexBlock.pages.resize(parentPages.size());
+    for (size_t i = 0; i < parentPages.size(); ++i) {
+        const auto& parentPage = parentPages[i];
+        auto& page = indexBlock.pages[i];
+        page.sizeOnDisk = parentPage.sizeOnDisk;
+        page.same = true;
+        page.hashFilled = parentPage.sizeOnDisk != 0;
+        page.layer = uint8_t(parentPage.layer + 1);
+        page.filePos = parentPage.filePos;
+        page.hash = parentPage.hash;
+    }
+    // Workers read the list while it grows, so it must never be reallocated.
+    indexBlock.nonzeroChangedPages.reserve(parentPages.size());
+    mIndex.totalPages += int32_t(parentPages.size());
 }
 
 void RamSaver::savePage(int64_t blockOffset,
-                        int64_t /*pageOffset*/,
+                        int64_t pageOffset,
                         int32_t /*pageSize*/) {
+    if (mHasError) {
+        return;
+    }
 
     if (mLastBlockIndex < 0) {
         mLastBlockIndex = 0;
@@ -217,7 +284,18 @@ void RamSaver::savePage(int64_t blockOffset,
         return;
     }
 
+    if (layered() && !block.pages.empty()) {
+        saveLayeredPage(mLastBlockIndex,
+                        int32_t(pageOffset / block.ramBlock.pageSize));
+        return;
+    }
+
     if (block.pages.empty()) {
+        if (copyOnWrite() && protectBlock(mLastBlockIndex)) {
+            // Saved once the guest resumes, see saveProtectedPages().
+            return;
+        }
+
         // First time we see a page for this block - save all its pages now.
         auto& ramBlock = block.ramBlock;
 
@@ -405,6 +483,7 @@ void RamSaver::savePage(int64_t blockOffset,
                 start = end;
             }
         }
+        block.queuedPages = int32_t(block.nonzeroChangedPages.size());
 
         // Record most stats right here.
         mIncStats.countMultiple(StatAction::SamePage, samePage);
@@ -417,6 +496,215 @@ void RamSaver::savePage(int64_t blockOffset,
     }
 }
 
+void RamSaver::saveLayeredPage(int blockIndex, int32_t pageIndex) {
+    auto& block = mIndex.blocks[size_t(blockIndex)];
+    assert(pageIndex >= 0 && pageIndex < int32_t(block.pages.size()));
+    auto& page = block.pages[size_t(pageIndex)];
+    if (!page.same) {
+        // Already queued by this save.
+        return;
+    }
+    mIncStats.count(StatAction::TotalPages);
+
+    const auto ptr = block.ramBlock.hostPtr +
+                     int64_t(pageIndex) * block.ramBlock.pageSize;
+    if (isBufferZeroed(ptr, block.ramBlock.pageSize)) {
+        mIncStats.count(page.zeroed() ? StatAction::StillZeroPage
+                                      : StatAction::NewZeroPage);
+        page.sizeOnDisk = 0;
+        page.hashFilled = false;
+        page.layer = 0;
+        page.filePos = 0;
+        return;
+    }
+
+    const bool wasZeroed = page.zeroed();
+    const Hash prevHash = page.hash;
+    calcHash(page, block, ptr);
+    if (!wasZeroed && page.hash == prevHash) {
+        // Written to, but back to the same contents.
+        mIncStats.count(StatAction::SameHashPage);
+        return;
+    }
+
+    mIncStats.count(StatAction::ChangedPage);
+    page.same = false;
+    page.layer = 0;
+    page.filePos = 0;
+    page.sizeOnDisk = block.ramBlock.pageSize;
+    block.nonzeroChangedPages.push_back(pageIndex);
+
+    const auto end = int32_t(block.nonzeroChangedPages.size());
+    if (end - block.queuedPages == kCompressBufferBatchSize) {
+        passToSaveHandler({blockIndex, block.queuedPages, end});
+        block.queuedPages = end;
+    }
+}
+
+bool RamSaver::protectBlock(int blockIndex) {
+    auto& block = mIndex.blocks[size_t(blockIndex)];
+    auto& ramBlock = block.ramBlock;
+    ramBlock.pageSize = kDefaultPageSize;
+
+    {
+        // Writes may come in as soon as the range is protected.
+        AutoLock lock(mProtectedBlocksLock);
+        if (!mWriteWatch->protectMemoryRange(ramBlock.hostPtr,
+                                             size_t(ramBlock.totalSize))) {
+            return false;
+        }
+        mProtectedBlocks.push_back({blockIndex});
+    }
+    mWriteWatch->doneRegistering();
+
+    if (!mPageCopies) {
+        auto pageCopies = new PageCopyBuffer[kCompressBufferCount];
+        mPageCopyMemory.reset(pageCopies);
+        mPageCopies.emplace(pageCopies, pageCopies + kCompressBufferCount);
+    }
+
+    const auto numPages = int32_t(ramBlock.totalSize / ramBlock.pageSize);
+    block.pages.resize(size_t(numPages));
+    // Workers read the list while it grows, so it must never be reallocated.
+    block.nonzeroChangedPages.reserve(size_t(numPages));
+    mIndex.totalPages += numPages;
+    mIncStats.countMultiple(StatAction::TotalPages, numPages);
+    return true;
+}
+
+void RamSaver::onGuestWrite(void* ptr) {
+    const auto addr = static_cast<uint8_t*>(ptr);
+    AutoLock lock(mProtectedBlocksLock);
+    for (auto& protectedBlock : mProtectedBlocks) {
+        const auto& ramBlock =
+                mIndex.blocks[size_t(protectedBlock.blockIndex)].ramBlock;
+        if (addr < ramBlock.hostPtr ||
+            addr >= ramBlock.hostPtr + ramBlock.totalSize) {
+            continue;
+        }
+
+        const auto pageIndex =
+                int32_t((addr - ramBlock.hostPtr) / ramBlock.pageSize);
+        const auto pagePtr =
+                ramBlock.hostPtr + int64_t(pageIndex) * ramBlock.pageSize;
+        if (pageIndex >= protectedBlock.savedPages) {
+            // Keep the page as it was for the save. Writers racing for the
+            // same page may fault more than once.
+            auto& copy = protectedBlock.writtenPages[pageIndex];
+            if (!copy) {
+                copy.reset(new uint8_t[size_t(ramBlock.pageSize)]);
+                memcpy(copy.get(), pagePtr, size_t(ramBlock.pageSize));
+            }
+        }
+        mWriteWatch->unprotect(pagePtr, size_t(ramBlock.pageSize));
+        return;
+    }
+
+    // Not ours to save; just don't leave the writer hanging.
+    mWriteWatch->unprotect(
+            reinterpret_cast<void*>(uintptr_t(ptr) & ~uintptr_t(kDefaultPageSize - 1)),
+            kDefaultPageSize);
+}
+
+void RamSaver::continueInBackground() {
+    if (!copyOnWrite() || mHasError || mProtectedBlocks.empty()) {
+        join();
+        return;
+    }
+
+    mResumeTime = mSystem->getHighResTimeUs();
+    mBackgroundSaver.emplace([this]() {
+        saveProtectedPages();
+        finish();
+    });
+    if (!mBackgroundSaver->start()) {
+        mBackgroundSaver.clear();
+        saveProtectedPages();
+        finish();
+    }
+}
+
+void RamSaver::saveProtectedPages() {
+    for (auto& protectedBlock : mProtectedBlocks) {
+        const int blockIndex = protectedBlock.blockIndex;
+        auto& block = mIndex.blocks[size_t(blockIndex)];
+        const auto pageSize = block.ramBlock.pageSize;
+        const auto numPages = int32_t(block.pages.size());
+
+        for (int32_t start = 0; start < numPages;
+             start += kCompressBufferBatchSize) {
+            if (mCanceled.load(std::memory_order_acquire)) {
+                return;
+            }
+
+            const auto end = std::min(numPages, start + kCompressBufferBatchSize);
+            PageCopyBuffer* pageCopies =
+                    mIncStats.measure(StatTime::WaitingForDisk, [&] {
+                        return mPageCopies->allocate();
+                    });
+            const auto nonzeroStart = int32_t(block.nonzeroChangedPages.size());
+            uint8_t* copyPtr = pageCopies->data();
+            int zeroPages = 0;
+
+            {
+                // Copy the batch as it was, and let the guest write to it.
+                AutoLock lock(mProtectedBlocksLock);
+                auto& writtenPages = protectedBlock.writtenPages;
+                for (int32_t i = start; i < end; ++i) {
+                    const uint8_t* ptr =
+                            block.ramBlock.hostPtr + int64_t(i) * pageSize;
+                    const auto written = writtenPages.find(i);
+                    if (written != writtenPages.end()) {
+                        ptr = written->second.get();
+                    }
+
+                    auto& page = block.pages[size_t(i)];
+                    if (isBufferZeroed(ptr, pageSize)) {
+                        page.sizeOnDisk = 0;
+                        ++zeroPages;
+                    } else {
+                        memcpy(copyPtr, ptr, size_t(pageSize));
+                        copyPtr += pageSize;
+                        page.sizeOnDisk = pageSize;
+                        block.nonzeroChangedPages.push_back(i);
+                    }
+
+                    if (written != writtenPages.end()) {
+                        writtenPages.erase(written);
+                    }
+                }
+                protectedBlock.savedPages = end;
+                mWriteWatch->unprotect(
+                        block.ramBlock.hostPtr + int64_t(start) * pageSize,
+                        size_t(end - start) * size_t(pageSize));
+            }
+
+            const auto nonzeroEnd = int32_t(block.nonzeroChangedPages.size());
+            mIncStats.measure(StatTime::Hashing, [&] {
+                for (int32_t nzcIndex = nonzeroStart; nzcIndex < nonzeroEnd;
+                     ++nzcIndex) {
+                    auto& page = block.pages[size_t(
+                            block.nonzeroChangedPages[size_t(nzcIndex)])];
+                    calcHash(page, block,
+                             pageCopies->data() +
+                                     int64_t(nzcIndex - nonzeroStart) *
+                                             pageSize);
+                }
+            });
+            mIncStats.countMultiple(StatAction::NewZeroPage, zeroPages);
+            mIncStats.countMultiple(StatAction::ChangedPage,
+                                    nonzeroEnd - nonzeroStart);
+
+            if (nonzeroEnd > nonzeroStart) {
+                passToSaveHandler(
+                        {blockIndex, nonzeroStart, nonzeroEnd, pageCopies});
+            } else {
+                mPageCopies->release(pageCopies);
+            }
+        }
+    }
+}
+
 void RamSaver::complete() {
     mWorkers->done();
 }
@@ -424,13 +712,70 @@ void RamSaver::complete() {
 static constexpr int kStopMarkerIndex = -1;
 
 void RamSaver::join() {
+    if (mBackgroundSaver) {
+        mBackgroundSaver->wait();
+        return;
+    }
+    finish();
+}
+
+void RamSaver::finish() {
     if (mJoined) {
         return;
     }
+    if (mWriteWatch) {
+        if (!mResumeTime) {
+            // QEMU didn't get through the save, so there's nothing to write.
+            mCanceled.store(true, std::memory_order_release);
+        }
+        // Let the guest write to whatever is still protected.
+        mWriteWatch->join();
+    }
+    if (layered() && !mHasError) {
+        // Pass the last partial batches of changed pages.
+        for (size_t i = 0; i < mIndex.blocks.size(); ++i) {
+            auto& block = mIndex.blocks[i];
+            const auto end = int32_t(block.nonzeroChangedPages.size());
+            if (block.queuedPages < end) {
+                passToSaveHandler({int(i), block.queuedPages, end});
+                block.queuedPages = end;
+            }
+        }
+    }
     passToSaveHandler({kStopMarkerIndex, 0});
     mJoined = true;
 }
 
+RamCheckpointPtr RamSaver::checkpoint() const {
+    if (!mJoined || mHasError || mCanceled.load(std::memory_order_acquire)) {
+        return {};
+    }
+
+    auto checkpoint = std::make_shared<RamCheckpoint>();
+    checkpoint->files.push_back(mFileName);
+    checkpoint->indexHashes.push_back(mIndexHash);
+    if (layered()) {
+        checkpoint->files.insert(checkpoint->files.end(),
+                                 mParent->files.begin(), mParent->files.end());
+        checkpoint->indexHashes.insert(checkpoint->indexHashes.end(),
+                                       mParent->indexHashes.begin(),
+                                       mParent->indexHashes.end());
+    }
+    checkpoint->compressed = compressed();
+
+    checkpoint->blocks.reserve(mIndex.blocks.size());
+    for (const FileIndex::Block& b : mIndex.blocks) {
+        checkpoint->blocks.push_back({b.ramBlock.id, b.ramBlock.totalSize, {}});
+        auto& pages = checkpoint->blocks.back().pages;
+        pages.reserve(b.pages.size());
+        for (const FileIndex::Block::Page& page : b.pages) {
+            pages.push_back(
+                    {page.layer, page.sizeOnDisk, page.filePos, page.hash});
+        }
+    }
+    return checkpoint;
+}
+
 void RamSaver::cancel() {
     mCanceled.store(true, std::memory_order_release);
     join();
@@ -476,7 +821,19 @@ bool RamSaver::handlePageSave(QueuedPageInfo&& pi) {
 
     WriteInfo wi = {pi.blockIndex, pi.nonzeroChangedIndexStart,
                     pi.nonzeroChangedIndexEnd,
-                    nullptr };
+                    nullptr, pi.pageCopies };
+
+    // A copy-on-write save passes copies of the pages, as the guest may have
+    // written to them since.
+    const auto pagePtr = [&pi, &block](int32_t nzcIndex, int32_t pageIndex) {
+        return pi.pageCopies
+                       ? pi.pageCopies->data() +
+                                 int64_t(nzcIndex -
+                                         pi.nonzeroChangedIndexStart) *
+                                         block.ramBlock.pageSize
+                       : block.ramBlock.hostPtr +
+                                 int64_t(pageIndex) * block.ramBlock.pageSize;
+    };
 
     if (compressed()) {
         CompressBuffer* compressBuffer =
@@ -495,8 +852,7 @@ bool RamSaver::handlePageSave(QueuedPageInfo&& pi) {
 
                 int32_t pageIndex = block.nonzeroChangedPages[size_t(nzcIndex)];
                 auto& page = block.pages[size_t(pageIndex)];
-                auto ptr = block.ramBlock.hostPtr +
-                    int64_t(pageIndex) * block.ramBlock.pageSize;
+                auto ptr = pagePtr(nzcIndex, pageIndex);
 
                 auto compressedSize =
                     compress::compress(
@@ -524,8 +880,7 @@ bool RamSaver::handlePageSave(QueuedPageInfo&& pi) {
         for (int32_t nzcIndex = pi.nonzeroChangedIndexStart; nzcIndex < pi.nonzeroChangedIndexEnd; ++nzcIndex) {
             int32_t pageIndex = block.nonzeroChangedPages[size_t(nzcIndex)];
             auto& page = block.pages[size_t(pageIndex)];
-            auto ptr = block.ramBlock.hostPtr +
-                int64_t(pageIndex) * block.ramBlock.pageSize;
+            auto ptr = pagePtr(nzcIndex, pageIndex);
             page.sizeOnDisk = block.ramBlock.pageSize;
             page.writePtr = ptr;
         }
@@ -539,13 +894,30 @@ bool RamSaver::handlePageSave(QueuedPageInfo&& pi) {
 void RamSaver::writeIndex() {
     auto start = mIndex.startPosInFile;
 
-    MemStream stream(512 + 16 * mIndex.totalPages);
+    MemStream memStream(512 + 16 * mIndex.totalPages);
+    base::BufferedStream stream(&memStream);
     bool compressed = (mIndex.flags & int(IndexFlags::CompressedPages)) != 0;
     stream.putBe32(uint32_t(mIndex.version));
     stream.putBe32(uint32_t(mIndex.flags));
     stream.putBe32(uint32_t(mIndex.totalPages));
-    int64_t prevFilePos = 8;
-    int32_t prevPageSizeOnDisk = 0;
+
+    // Positions are delta-encoded within each layer.
+    const size_t layerCount = layered() ? mParent->files.size() + 1 : 1;
+    std::vector<int64_t> prevFilePos(layerCount, 8);
+    std::vector<int32_t> prevPageSizeOnDisk(layerCount, 0);
+
+    if (layered()) {
+        // The parent's layers, relative to the directory of the snapshots if
+        // they are in it, with the hashes of their indexes to tell if they
+        // were overwritten since.
+        const auto baseDir = getRamLayersBaseDir(mFileName);
+        stream.putBe32(uint32_t(mParent->files.size()));
+        for (size_t i = 0; i < mParent->files.size(); ++i) {
+            stream.putString(PathUtils::relativeTo(baseDir, mParent->files[i]));
+            stream.write(mParent->indexHashes[i].data(),
+                         mParent->indexHashes[i].size());
+        }
+    }
 
     mIncStats.measure(StatTime::DiskIndexWrite, [&] {
         for (const FileIndex::Block& b : mIndex.blocks) {
@@ -582,9 +954,12 @@ void RamSaver::writeIndex() {
                                    : (page.sizeOnDisk / b.ramBlock.pageSize)));
 
                 if (!page.zeroed()) {
-                    auto deltaPos = page.filePos - prevFilePos;
+                    if (layered()) {
+                        stream.putPackedNum(page.layer);
+                    }
+                    auto deltaPos = page.filePos - prevFilePos[page.layer];
                     if (compressed) {
-                        deltaPos -= prevPageSizeOnDisk;
+                        deltaPos -= prevPageSizeOnDisk[page.layer];
                     } else {
                         assert(deltaPos % b.ramBlock.pageSize == 0);
                         deltaPos /= b.ramBlock.pageSize;
@@ -593,8 +968,8 @@ void RamSaver::writeIndex() {
                     assert(page.hashFilled ||
                            mCanceled.load(std::memory_order_acquire));
                     stream.write(page.hash.data(), page.hash.size());
-                    prevFilePos = page.filePos;
-                    prevPageSizeOnDisk = page.sizeOnDisk;
+                    prevFilePos[page.layer] = page.filePos;
+                    prevPageSizeOnDisk[page.layer] = page.sizeOnDisk;
                 }
             }
 
@@ -606,16 +981,23 @@ void RamSaver::writeIndex() {
         }
     });
 
-    mIncStats.measure(StatTime::GapTrackingWriter, [&] {
-        incremental() ? mGaps->save(stream) : OneSizeGapTracker().save(stream);
-    });
+    // A layered file is always written anew, so it has no gaps to track.
+    if (!layered()) {
+        mIncStats.measure(StatTime::GapTrackingWriter, [&] {
+            incremental() ? mGaps->save(stream)
+                          : OneSizeGapTracker().save(stream);
+        });
+    }
 
     auto end = mIncStats.measure(StatTime::DiskIndexWrite, [&] {
-        auto end = mIndex.startPosInFile + stream.writtenSize();
+        stream.flush();
+        MurmurHash3_x64_128(memStream.buffer().data(), memStream.writtenSize(),
+                            0, mIndexHash.data());
+        auto end = mIndex.startPosInFile + memStream.writtenSize();
         mDiskSize = uint64_t(end);
 
-        base::pwrite(mStreamFd, stream.buffer().data(), stream.buffer().size(),
-                     mIndex.startPosInFile);
+        base::pwrite(mStreamFd, memStream.buffer().data(),
+                     memStream.buffer().size(), mIndex.startPosInFile);
         setFileSize(mStreamFd, int64_t(mDiskSize));
         HANDLE_EINTR(fseeko64(mStream.get(), 0, SEEK_SET));
         mStream.putBe64(uint64_t(mIndex.startPosInFile));
@@ -744,6 +1126,9 @@ void RamSaver::writePage(WriteInfo&& wi) {
         if (wi.toRelease) {
             mCompressBuffers->release(wi.toRelease);
         }
+        if (wi.copiesToRelease) {
+            mPageCopies->release(wi.copiesToRelease);
+        }
 
         base::pwrite(mStreamFd,
                      mWriteCombineBuffer.data(),
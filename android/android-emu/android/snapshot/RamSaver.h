@@ -24,6 +24,7 @@
 #include "android/snapshot/FastReleasePool.h"
 #include "android/snapshot/GapTracker.h"
 #include "android/snapshot/IncrementalStats.h"
+#include "android/snapshot/MemoryWatch.h"
 #include "android/snapshot/RamLoader.h"
 #include "android/snapshot/common.h"
 
@@ -31,6 +32,8 @@
 #include <atomic>
 #include <cstdint>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace android {
@@ -40,6 +43,32 @@ using namespace ::android::base::EnumFlags;
 
 class RamLoader;
 
+// The page table of a completed RAM save, for the next save to write only the
+// pages changed since on top of it.
+struct RamCheckpoint {
+    using Hash = std::array<char, 16>;
+
+    struct Page {
+        uint8_t layer;       // index into |files|
+        int32_t sizeOnDisk;  // 0 -> page is all zeroes
+        int64_t filePos;
+        Hash hash;
+    };
+
+    struct Block {
+        std::string id;
+        int64_t totalSize;
+        std::vector<Page> pages;  // empty if the block isn't saved
+    };
+
+    // The RAM files the pages are stored in, the saved one first, and the
+    // hashes of their indexes at the time.
+    std::vector<std::string> files;
+    std::vector<Hash> indexHashes;
+    bool compressed;
+    std::vector<Block> blocks;
+};
+
 class RamSaver {
     DISALLOW_COPY_AND_ASSIGN(RamSaver);
 
@@ -47,14 +76,22 @@ public:
     enum class Flags : uint8_t {
         None = 0,
         Async = 0x1,
-        // TODO: add "CopyOnWrite = 0x3  // implies |Async|"
+        // The guest RAM is write-protected while the VM is paused, and the
+        // pages are saved once it resumes, each of them before its first
+        // write. Not for incremental or layered saves.
+        CopyOnWrite = 0x2,
         Compress = 0x4,
     };
 
+    // With a |parent| checkpoint, only the pages passed to savePage() are
+    // checked for changes, and the rest are referred to in the parent's files.
+    // The file is then layered over those of the parent, and is compressed if
+    // the parent is.
     RamSaver(const std::string& fileName,
              Flags preferredFlags,
              RamLoader* loader,
-             bool isOnExit);
+             bool isOnExit,
+             RamCheckpointPtr parent = {});
     ~RamSaver();
 
     void registerBlock(const RamBlock& block);
@@ -68,6 +105,18 @@ public:
     }
     uint64_t diskSize() const { return mDiskSize; }
     bool incremental() const { return mLoader != nullptr; }
+    bool layered() const { return mParent != nullptr; }
+    bool copyOnWrite() const { return nonzero(mFlags & Flags::CopyOnWrite); }
+
+    // Called once QEMU has passed all pages to savePage(). A copy-on-write
+    // save goes on in the background, for join() to wait for; any other one
+    // is joined right away.
+    void continueInBackground();
+    bool savingInBackground() const { return mBackgroundSaver.hasValue(); }
+
+    // Returns the page table of the save once it has been joined, or null if
+    // it failed.
+    RamCheckpointPtr checkpoint() const;
 
     // getDuration():
     // Returns true if there was save with measurable time
@@ -84,11 +133,32 @@ public:
         return true;
     }
 
+    // The part of getDuration() the guest was paused for; all of it unless
+    // this is a copy-on-write save.
+    bool getPauseDuration(base::System::Duration* duration) {
+        if (!copyOnWrite() || !mResumeTime) {
+            return getDuration(duration);
+        }
+        if (duration) {
+            *duration = mResumeTime - mStartTime;
+        }
+        return true;
+    }
+
 private:
+    static const int kCompressBufferCount = 8;
+    static const int kCompressBufferBatchSize = 1024;
+
+    // Copies of the pages of a copy-on-write save, in the order of
+    // nonzeroChangedPages.
+    using PageCopyBuffer =
+            std::array<uint8_t, kCompressBufferBatchSize * kDefaultPageSize>;
+
     struct QueuedPageInfo {
         int blockIndex;
         int32_t nonzeroChangedIndexStart;
         int32_t nonzeroChangedIndexEnd;
+        PageCopyBuffer* pageCopies = nullptr;
     };
 
     // The file structure is as follows:
@@ -100,7 +170,7 @@ private:
     // indexOffset: struct FileIndex
     // EOF
 
-    using Hash = std::array<char, 16>;
+    using Hash = RamCheckpoint::Hash;
 
     struct FileIndex {
         struct Block {
@@ -109,6 +179,7 @@ private:
                 int32_t sizeOnDisk;  // 0 -> page is all zeroes
                 bool same;
                 bool hashFilled;
+                uint8_t layer;  // 0 -> this file, otherwise a parent's
                 int64_t filePos;
                 Hash hash;
                 const RamLoader::Page* loaderPage;
@@ -118,6 +189,9 @@ private:
             };
             std::vector<Page> pages;
             std::vector<int32_t> nonzeroChangedPages;
+            // How many of |nonzeroChangedPages| a layered save has passed to
+            // the save handler.
+            int32_t queuedPages = 0;
         };
 
         using Flags = IndexFlags;
@@ -131,8 +205,6 @@ private:
         void clear();
     };
 
-    static const int kCompressBufferCount = 8;
-    static const int kCompressBufferBatchSize = 1024;
     using CompressBuffer =
             std::array<uint8_t, kCompressBufferBatchSize * compress::maxCompressedSize(kDefaultPageSize)>;
 
@@ -141,18 +213,36 @@ private:
         int32_t nonzeroChangedIndexStart;
         int32_t nonzeroChangedIndexEnd;
         CompressBuffer* toRelease;
+        PageCopyBuffer* copiesToRelease = nullptr;
+    };
+
+    // A block of a copy-on-write save, write-protected until it's saved.
+    struct ProtectedBlock {
+        int blockIndex;
+        // The pages before this one are saved, the rest are still protected.
+        int32_t savedPages = 0;
+        // Copies of the pages the guest wrote to before they were saved.
+        std::unordered_map<int32_t, std::unique_ptr<uint8_t[]>> writtenPages;
     };
 
     void calcHash(FileIndex::Block::Page& page,
                   const FileIndex::Block& block,
                   const void* ptr);
 
+    void saveLayeredPage(int blockIndex, int32_t pageIndex);
+    bool protectBlock(int blockIndex);
+    void onGuestWrite(void* ptr);
+    void saveProtectedPages();
+    void finish();
     void passToSaveHandler(QueuedPageInfo&& pi);
     bool handlePageSave(QueuedPageInfo&& pi);
     void writeIndex();
     void writePage(WriteInfo&& wi);
 
     RamLoader* mLoader = nullptr;
+    RamCheckpointPtr mParent;
+    std::string mFileName;
+    Hash mIndexHash = {};
     base::StdioStream mStream;
     int mStreamFd;
     Flags mFlags;
@@ -177,10 +267,19 @@ private:
             mCompressBuffers;
     std::vector<char> mWriteCombineBuffer;
 
+    base::Optional<MemoryWriteWatch> mWriteWatch;
+    base::Lock mProtectedBlocksLock;
+    std::vector<ProtectedBlock> mProtectedBlocks;
+    std::unique_ptr<PageCopyBuffer[]> mPageCopyMemory;
+    base::Optional<FastReleasePool<PageCopyBuffer, kCompressBufferCount>>
+            mPageCopies;
+    base::Optional<base::FunctorThread> mBackgroundSaver;
+
     base::System* mSystem = base::System::get();
 
     base::System::Duration mStartTime = base::System::get()->getHighResTimeUs();
     base::System::Duration mEndTime = 0;
+    base::System::Duration mResumeTime = 0;
 
     IncrementalStats mIncStats;
 };
@@ -71,20 +71,67 @@ void saveRamSingleBlock(const RamSaver::Flags flags,
     s.join();
 }
 
-void loadRamSingleBlock(const RamBlock& block,
-                        android::base::StringView filename) {
+bool loadRamSingleBlock(const RamBlock& block,
+                        android::base::StringView filename,
+                        RamLoader::Flags flags,
+                        uint64_t* untouchedBytes) {
     auto ram = android_fopen(c_str(filename), "rb");
 
     RamLoader::RamBlockStructure emptyRamBlockStructure = {};
 
     // Disallow on-demand load for now.
     RamLoader ramLoader(StdioStream(ram, StdioStream::kOwner),
-                        RamLoader::Flags::None, emptyRamBlockStructure);
+                        flags & ~RamLoader::Flags::OnDemandAllowed,
+                        emptyRamBlockStructure, filename);
 
     ramLoader.registerBlock(block);
 
     ramLoader.start(false);
     ramLoader.join();
+    if (untouchedBytes) {
+        *untouchedBytes = ramLoader.untouchedBytes();
+    }
+    return !ramLoader.hasError();
+}
+
+RamCheckpointPtr checkpointSaveSingleBlock(
+        const RamSaver::Flags flags,
+        const RamBlock& block,
+        android::base::StringView filename,
+        RamCheckpointPtr parent,
+        const std::vector<int32_t>& dirtyPages) {
+    const bool layered = parent != nullptr;
+    RamSaver s(filename, flags, nullptr, true, std::move(parent));
+
+    s.registerBlock(block);
+
+    if (layered) {
+        for (int32_t page : dirtyPages) {
+            s.savePage(block.startOffset, int64_t(page) * block.pageSize,
+                       block.pageSize);
+        }
+    } else {
+        mockQemuPageSave(s, block);
+    }
+
+    s.join();
+    return s.checkpoint();
+}
+
+bool copyOnWriteSaveSingleBlock(const RamSaver::Flags flags,
+                                const RamBlock& block,
+                                android::base::StringView filename,
+                                const std::function<void()>& whileSaving) {
+    RamSaver s(filename, flags | RamSaver::Flags::CopyOnWrite, nullptr, true);
+
+    s.registerBlock(block);
+
+    mockQemuPageSave(s, block);
+
+    s.continueInBackground();
+    whileSaving();
+    s.join();
+    return s.copyOnWrite();
 }
 
 void incrementalSaveSingleBlock(const RamSaver::Flags flags,
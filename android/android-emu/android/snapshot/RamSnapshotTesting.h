@@ -16,6 +16,7 @@
 #include "android/snapshot/RamLoader.h"
 #include "android/snapshot/RamSaver.h"
 
+#include <functional>
 #include <vector>
 
 namespace android {
@@ -33,8 +34,29 @@ void saveRamSingleBlock(const RamSaver::Flags flags,
                         const RamBlock& block,
                         android::base::StringView filename);
 
-void loadRamSingleBlock(const RamBlock& block,
-                        android::base::StringView filename);
+// Returns false if the RAM failed to load. Writes the loader's
+// untouchedBytes() to |untouchedBytes| if it isn't null.
+bool loadRamSingleBlock(const RamBlock& block,
+                        android::base::StringView filename,
+                        RamLoader::Flags flags = RamLoader::Flags::None,
+                        uint64_t* untouchedBytes = nullptr);
+
+// Saves |block| on top of |parent|, passing only the pages in |dirtyPages| to
+// the saver like QEMU does with its dirty log. A null |parent| makes a full
+// save. Returns the checkpoint of the save.
+RamCheckpointPtr checkpointSaveSingleBlock(
+        const RamSaver::Flags flags,
+        const RamBlock& block,
+        android::base::StringView filename,
+        RamCheckpointPtr parent = {},
+        const std::vector<int32_t>& dirtyPages = {});
+
+// Saves |block| copy-on-write, running |whileSaving| once the saver has been
+// passed all the pages. Returns false if the saver fell back to a regular save.
+bool copyOnWriteSaveSingleBlock(const RamSaver::Flags flags,
+                                const RamBlock& block,
+                                android::base::StringView filename,
+                                const std::function<void()>& whileSaving);
 
 void incrementalSaveSingleBlock(const RamSaver::Flags flags,
                                 const RamBlock& blockToLoad,
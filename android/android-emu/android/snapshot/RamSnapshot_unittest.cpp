@@ -17,8 +17,10 @@
 
 #include <gtest/gtest.h>
 
+#include <cstring>
 #include <memory>
 #include <random>
+#include <string>
 #include <vector>
 
 using android::AlignedBuf;
@@ -70,6 +72,65 @@ TEST_F(RamSnapshotTest, SimpleRandom) {
     }
 }
 
+TEST_F(RamSnapshotTest, CopyOnWriteSaveRandom) {
+    std::string ramPath = mTempDir->makeSubPath("ram.bin");
+
+    // More than one batch of pages.
+    const int numPages = 3000;
+    const float noChangeChance = 0.5;
+    const float zeroPageChance = 0.5;
+
+    auto testRam = generateRandomRam(numPages, zeroPageChance);
+    const auto savedRam = testRam;
+
+    // The writes made while saving stay out of the snapshot, whether or not
+    // the host can write-protect the RAM.
+    copyOnWriteSaveSingleBlock(
+            RamSaver::Flags::Compress,
+            makeRam("testRam", testRam.data(), (int64_t)testRam.size()),
+            ramPath, [&testRam, noChangeChance, zeroPageChance] {
+                randomMutateRam(testRam, noChangeChance, zeroPageChance, 1);
+            });
+    EXPECT_FALSE(savedRam == testRam);
+
+    TestRamBuffer testRamOut(numPages * kTestingPageSize);
+    EXPECT_TRUE(loadRamSingleBlock(
+            makeRam("testRam", testRamOut.data(), (int64_t)testRamOut.size()),
+            ramPath));
+    EXPECT_EQ(savedRam, testRamOut);
+}
+
+TEST_F(RamSnapshotTest, TrimWorkingSetLoad) {
+    std::string ramPath = mTempDir->makeSubPath("ram.bin");
+
+    const int numPages = 100;
+    const float zeroPageChance = 0.5;
+
+    auto testRam = generateRandomRam(numPages, zeroPageChance);
+    saveRamSingleBlock(
+            RamSaver::Flags::Compress,
+            makeRam("testRam", testRam.data(), (int64_t)testRam.size()),
+            ramPath);
+
+    // Load over RAM that's in use, for the zero pages to matter.
+    TestRamBuffer testRamOut(numPages * kTestingPageSize);
+    memset(testRamOut.data(), 0xff, testRamOut.size());
+    uint64_t untouchedBytes = 0;
+    EXPECT_TRUE(loadRamSingleBlock(
+            makeRam("testRam", testRamOut.data(), (int64_t)testRamOut.size()),
+            ramPath, RamLoader::Flags::TrimWorkingSet, &untouchedBytes));
+    EXPECT_EQ(testRam, testRamOut);
+
+#ifdef __linux__
+    int zeroPages = 0;
+    for (int i = 0; i < numPages; i++) {
+        zeroPages += isBufferZeroed(testRam.data() + i * kTestingPageSize,
+                                    kTestingPageSize);
+    }
+    EXPECT_EQ(uint64_t(zeroPages) * kTestingPageSize, untouchedBytes);
+#endif
+}
+
 TEST_F(RamSnapshotTest, IncrementalSaveRandomNoChanges) {
     std::string ramPath = mTempDir->makeSubPath("ram.bin");
 
@@ -181,5 +242,150 @@ TEST_F(RamSnapshotTest, IncrementalSaveRandomMultiStep) {
     }
 }
 
+TEST_F(RamSnapshotTest, LayeredSaveRandomSeries) {
+    const int numPages = 100;
+    const int steps = kMaxRamLayers - 1;
+    const float noChangeChance = 0.75;
+    const float zeroPageChance = 0.5;
+
+    ASSERT_TRUE(mTempDir->makeSubDir("snapshots"));
+    std::vector<std::string> ramPaths;
+    std::vector<TestRamBuffer> rams;
+    for (int i = 0; i <= steps; i++) {
+        const auto dir = "snapshots/s" + std::to_string(i);
+        ASSERT_TRUE(mTempDir->makeSubDir(dir));
+        ramPaths.push_back(mTempDir->makeSubPath(dir + "/ram.bin"));
+    }
+
+    rams.push_back(generateRandomRam(numPages, zeroPageChance));
+    auto checkpoint = checkpointSaveSingleBlock(
+            RamSaver::Flags::Compress,
+            makeRam("testRam", rams[0].data(), (int64_t)rams[0].size()),
+            ramPaths[0]);
+    ASSERT_TRUE(checkpoint);
+
+    for (int i = 1; i <= steps; i++) {
+        rams.push_back(rams.back());
+        auto& ram = rams.back();
+        randomMutateRam(ram, noChangeChance, zeroPageChance, i);
+
+        // Pages written with what they had before are dirty as well.
+        std::vector<int32_t> dirtyPages;
+        for (int32_t page = 0; page < numPages; page++) {
+            const auto offset = page * kTestingPageSize;
+            if (page % 7 == 0 ||
+                memcmp(ram.data() + offset, rams[i - 1].data() + offset,
+                       kTestingPageSize)) {
+                dirtyPages.push_back(page);
+            }
+        }
+
+        checkpoint = checkpointSaveSingleBlock(
+                RamSaver::Flags::None,
+                makeRam("testRam", ram.data(), (int64_t)ram.size()),
+                ramPaths[i], checkpoint, dirtyPages);
+        ASSERT_TRUE(checkpoint);
+        EXPECT_EQ(i + 1, int(checkpoint->files.size()));
+        EXPECT_TRUE(checkpoint->compressed);
+        EXPECT_LT(System::get()->pathFileSize(ramPaths[i]).valueOr(0),
+                  System::get()->pathFileSize(ramPaths[0]).valueOr(0));
+    }
+
+    // Every step loads with the pages of all the ones before.
+    for (int i = 0; i <= steps; i++) {
+        TestRamBuffer testRamOut(numPages * kTestingPageSize);
+        EXPECT_TRUE(loadRamSingleBlock(
+                makeRam("testRam", testRamOut.data(),
+                        (int64_t)testRamOut.size()),
+                ramPaths[i]));
+        EXPECT_EQ(rams[i], testRamOut);
+    }
+
+    // A series can't grow past the maximum number of layers.
+    RamSaver tooDeep(mTempDir->makeSubPath("snapshots/ram.bin"),
+                     RamSaver::Flags::None, nullptr, false, checkpoint);
+    EXPECT_TRUE(tooDeep.hasError());
+
+    // Saving over a layer breaks the ones on top of it.
+    saveRamSingleBlock(
+            RamSaver::Flags::Compress,
+            makeRam("testRam", rams[0].data(), (int64_t)rams[0].size()),
+            ramPaths[1]);
+    TestRamBuffer testRamOut(numPages * kTestingPageSize);
+    EXPECT_FALSE(loadRamSingleBlock(
+            makeRam("testRam", testRamOut.data(), (int64_t)testRamOut.size()),
+            ramPaths[2]));
+}
+
+// Without a dirty log that tracks the guest (e.g. on HVF), QEMU visits every
+// page for a layered save; the pages the guest wrote since the parent must
+// still end up in the new layer.
+TEST_F(RamSnapshotTest, LayeredSaveAllPagesVisited) {
+    const int numPages = 64;
+    const int steps = 2;
+
+    ASSERT_TRUE(mTempDir->makeSubDir("snapshots"));
+    std::vector<std::string> ramPaths;
+    for (int i = 0; i <= steps; i++) {
+        const auto dir = "snapshots/s" + std::to_string(i);
+        ASSERT_TRUE(mTempDir->makeSubDir(dir));
+        ramPaths.push_back(mTempDir->makeSubPath(dir + "/ram.bin"));
+    }
+
+    std::vector<int32_t> allPages;
+    for (int32_t page = 0; page < numPages; page++) {
+        allPages.push_back(page);
+    }
+
+    std::vector<TestRamBuffer> rams;
+    rams.push_back(generateRandomRam(numPages, 0.25));
+    auto checkpoint = checkpointSaveSingleBlock(
+            RamSaver::Flags::None,
+            makeRam("testRam", rams[0].data(), (int64_t)rams[0].size()),
+            ramPaths[0]);
+    ASSERT_TRUE(checkpoint);
+
+    for (int i = 1; i <= steps; i++) {
+        rams.push_back(rams.back());
+        auto& ram = rams.back();
+        // The guest writes a few pages between the saves.
+        for (int32_t page = i; page < numPages; page += 9) {
+            memset(ram.data() + page * kTestingPageSize, 0x40 + i,
+                   kTestingPageSize);
+        }
+
+        checkpoint = checkpointSaveSingleBlock(
+                RamSaver::Flags::None,
+                makeRam("testRam", ram.data(), (int64_t)ram.size()),
+                ramPaths[i], checkpoint, allPages);
+        ASSERT_TRUE(checkpoint);
+        EXPECT_EQ(i + 1, int(checkpoint->files.size()));
+        // Pages that didn't change stay in the older layers.
+        EXPECT_LT(System::get()->pathFileSize(ramPaths[i]).valueOr(0),
+                  System::get()->pathFileSize(ramPaths[0]).valueOr(0));
+    }
+
+    for (int i = 0; i <= steps; i++) {
+        TestRamBuffer testRamOut(numPages * kTestingPageSize);
+        EXPECT_TRUE(loadRamSingleBlock(
+                makeRam("testRam", testRamOut.data(),
+                        (int64_t)testRamOut.size()),
+                ramPaths[i]));
+        EXPECT_EQ(rams[i], testRamOut);
+    }
+
+    // Each save lists the ones below it, nearest first and relative to the
+    // directory they share.
+    for (int i = 0; i <= steps; i++) {
+        const auto layers = RamLoader::readLayerNames(ramPaths[i]);
+        ASSERT_EQ(size_t(i), layers.size());
+        for (int j = 0; j < i; j++) {
+            EXPECT_EQ(PathUtils::join("s" + std::to_string(i - 1 - j),
+                                      "ram.bin"),
+                      layers[j]);
+        }
+    }
+}
+
 }  // namespace snapshot
 }  // namespace android
@@ -14,6 +14,7 @@
 #include "android/base/files/FileShareOpen.h"
 #include "android/base/files/PathUtils.h"
 #include "android/base/files/StdioStream.h"
+#include "android/snapshot/MemoryWatch.h"
 #include "android/snapshot/RamLoader.h"
 #include "android/snapshot/TextureSaver.h"
 #include "android/snapshot/common.h"
@@ -30,11 +31,13 @@ namespace android {
 namespace snapshot {
 
 Saver::Saver(const Snapshot& snapshot, RamLoader* loader, bool isOnExit,
-             base::StringView ramMapFile, bool ramFileShared, bool isRemapping)
+             base::StringView ramMapFile, bool ramFileShared, bool isRemapping,
+             RamCheckpointPtr ramParent)
     : mStatus(OperationStatus::Error), mSnapshot(snapshot) {
     if (path_mkdir_if_needed_no_cow(c_str(mSnapshot.dataDir()), 0777) != 0) {
         return;
     }
+    bool compressTextures = true;
     {
         const auto ramFile = PathUtils::join(mSnapshot.dataDir(), kRamFileName);
         auto flags = RamSaver::Flags::None;
@@ -96,13 +99,44 @@ Saver::Saver(const Snapshot& snapshot, RamLoader* loader, bool isOnExit,
             }
         }
 
+        // Pages of a file-backed RAM that is writing through aren't saved,
+        // so there's nothing to layer them on.
+        if (nonzero(flags & RamSaver::Flags::Async)) {
+            ramParent.reset();
+        }
+
+        // Let the guest run while its RAM is saved, unless it isn't going to
+        // run (on exit), the RAM stays mapped to a file that has it all
+        // (remapping), or only the changed pages are saved anyway (layered).
+        if (!isOnExit && !isRemapping && !ramParent &&
+            !nonzero(flags & RamSaver::Flags::Async)) {
+            const auto cowEnvVar =
+                    System::get()->envGet("ANDROID_SNAPSHOT_COPY_ON_WRITE");
+            if (cowEnvVar == "0" || cowEnvVar == "no" ||
+                cowEnvVar == "false") {
+                VERBOSE_PRINT(snapshot,
+                              "autoconfig: forced no copy-on-write snapshot "
+                              "save from environment "
+                              "[ANDROID_SNAPSHOT_COPY_ON_WRITE=%s]",
+                              cowEnvVar.c_str());
+            } else if (MemoryWriteWatch::isSupported()) {
+                flags |= RamSaver::Flags::CopyOnWrite;
+            }
+        }
+
         const bool tryIncremental =
-            loader && !loader->hasError() && loader->hasGaps();
+                !ramParent && !nonzero(flags & RamSaver::Flags::CopyOnWrite) &&
+                loader && !loader->hasError() && loader->hasGaps();
+
+        mIncrementallySaved = tryIncremental || ramParent;
 
-        mIncrementallySaved = tryIncremental;
+        // Textures get compressed when RAM does, for the same reasons (disk
+        // speed and space). Otherwise loads upload them straight from a
+        // mapping of the file.
+        compressTextures = nonzero(flags & RamSaver::Flags::Compress);
 
         mRamSaver.emplace(ramFile, flags, tryIncremental ? loader : nullptr,
-                          isOnExit);
+                          isOnExit, std::move(ramParent));
         if (mRamSaver->hasError()) {
             mRamSaver.clear();
             return;
@@ -118,13 +152,14 @@ Saver::Saver(const Snapshot& snapshot, RamLoader* loader, bool isOnExit,
             return;
         }
         mTextureSaver = std::make_shared<TextureSaver>(
-                StdioStream(textures, StdioStream::kOwner));
+                StdioStream(textures, StdioStream::kOwner), compressTextures);
     }
 
     mStatus = OperationStatus::NotStarted;
 }
 
 Saver::~Saver() {
+    join();
     const bool deleteDirectory =
             mStatus != OperationStatus::Ok && (mRamSaver || mTextureSaver);
     mRamSaver.clear();
@@ -146,35 +181,81 @@ void Saver::prepare() {
 void Saver::complete(bool succeeded) {
     mStatus = OperationStatus::Error;
     if (!succeeded) {
+        if (mRamSaver && mRamSaver->copyOnWrite()) {
+            // Stop write-protecting the guest RAM for a save that's failed.
+            mRamSaver->cancel();
+        }
         return;
     }
     if (!mRamSaver || mRamSaver->hasError()) {
         return;
     }
-    mRamSaver->join();
+    // A copy-on-write save is still writing the RAM out; join() waits for it.
+    mRamPending = mRamSaver->savingInBackground();
+    if (!mRamPending) {
+        mRamSaver->join();
+    }
     if (!mTextureSaver ||
         (static_cast<void>(mTextureSaver->done()), mTextureSaver->hasError())) {
+        if (mRamPending) {
+            mRamPending = false;
+            mRamSaver->cancel();
+        }
         return;
     }
 
+    if (mRamPending) {
+        // The metadata goes in once the RAM is all there, and a stale one of
+        // a snapshot saved over must not make it look loadable until then.
+        path_delete_file(
+                PathUtils::join(mSnapshot.dataDir(), kSnapshotProtobufName)
+                        .c_str());
+        mStatus = OperationStatus::Ok;
+        return;
+    }
+
+    if (!writeMetadata()) {
+        return;
+    }
+
+    mStatus = OperationStatus::Ok;
+}
+
+bool Saver::writeMetadata() {
     base::System::Duration ramDuration = 0;
+    base::System::Duration ramPauseDuration = 0;
     base::System::Duration texturesDuration = 0;
 
     if (mRamSaver->getDuration(&ramDuration) &&
+        mRamSaver->getPauseDuration(&ramPauseDuration) &&
         mTextureSaver->getDuration(&texturesDuration)) {
 
         mSnapshot.addSaveStats(
                 mIncrementallySaved,
                 ramDuration + texturesDuration,
+                ramPauseDuration + texturesDuration,
                 0 /* ram changed bytes; unused for now */);
 
     }
 
-    if (!mSnapshot.save()) {
+    return mSnapshot.save();
+}
+
+void Saver::join() {
+    if (!mRamPending) {
         return;
     }
-
-    mStatus = OperationStatus::Ok;
+    mRamPending = false;
+    mRamSaver->join();
+    if (mStatus != OperationStatus::Ok) {
+        return;
+    }
+    if (mRamSaver->hasError()) {
+        mStatus = OperationStatus::Error;
+        mSnapshot.saveFailure(FailureReason::RamFailed);
+    } else if (!writeMetadata()) {
+        mStatus = OperationStatus::Error;
+    }
 }
 
 void Saver::cancel() {
@@ -28,11 +28,14 @@ class Saver {
     DISALLOW_COPY_AND_ASSIGN(Saver);
 
 public:
+    // With a |ramParent|, the RAM is saved on top of it when possible; see
+    // ramLayered().
     Saver(const Snapshot& snapshot, RamLoader* loader,
           bool isOnExit,
           base::StringView ramMapFile,
           bool ramFileShared,
-          bool isRemapping);
+          bool isRemapping,
+          RamCheckpointPtr ramParent = {});
     ~Saver();
 
     RamSaver& ramSaver() { return *mRamSaver; }
@@ -44,7 +47,17 @@ public:
     void prepare();
     void complete(bool succeeded);
 
+    // A copy-on-write save completes with the RAM still being written out in
+    // the background; join() waits for it, and then writes the snapshot
+    // metadata or fails the save if the RAM didn't make it.
+    bool ramPending() const { return mRamPending; }
+    void join();
+
     bool incrementallySaved() const { return mIncrementallySaved; }
+    bool ramLayered() const { return mRamSaver && mRamSaver->layered(); }
+    RamCheckpointPtr ramCheckpoint() const {
+        return mRamSaver ? mRamSaver->checkpoint() : nullptr;
+    }
 
     void cancel();
 
@@ -55,11 +68,15 @@ public:
                                     base::System::DiskKind::Hdd; }
 
 private:
+    // Writes out the snapshot metadata, once all its files are complete.
+    bool writeMetadata();
+
     OperationStatus mStatus;
     Snapshot mSnapshot;
     base::Optional<RamSaver> mRamSaver;
     std::shared_ptr<TextureSaver> mTextureSaver;
     bool mIncrementallySaved = false;
+    bool mRamPending = false;
     base::System::MemUsage mMemUsage;
     base::Optional<base::System::DiskKind> mDiskKind = {};
 };
@@ -29,6 +29,7 @@
 #include "android/protobuf/LoadSave.h"
 #include "android/snapshot/PathUtils.h"
 #include "android/snapshot/Quickboot.h"
+#include "android/snapshot/RamLoader.h"
 #include "android/snapshot/Snapshotter.h"
 #include "android/utils/fd.h"
 #include "android/utils/file_io.h"
@@ -343,7 +344,7 @@ struct {
          avdInfo_getEncryptionKeyImagePath},
 };
 
-static constexpr int kVersion = 60;
+static constexpr int kVersion = 61;
 static constexpr int kMaxSaveStatsHistory = 10;
 
 base::StringView Snapshot::dataDir(const char* name) {
@@ -454,7 +455,12 @@ bool Snapshot::save() {
         *toSave = mSaveStats[i];
     }
 
-    auto parentSnapshot = Snapshotter::get().loadedSnapshotFile();
+    // A snapshot with its RAM layered on top of another one can't go without
+    // it; otherwise the parent is the one it was loaded from.
+    auto parentSnapshot = Snapshotter::get().layeredSaveParent();
+    if (parentSnapshot.empty()) {
+        parentSnapshot = Snapshotter::get().loadedSnapshotFile();
+    }
     // We want to maintain the default_boot snapshot as outside
     // the hierarchy. For that reason, don't set parent if default
     // boot is involved either as the current snapshot or the parent snapshot.
@@ -737,6 +743,11 @@ void Snapshot::incrementInvalidLoads() {
 bool Snapshot::isImported() {
     return !getQcow2Files(dataDir()).empty();
 }
+
+std::vector<std::string> Snapshot::ramLayers() const {
+    return RamLoader::readLayerNames(PathUtils::join(mDataDir, kRamFileName));
+}
+
 static bool replace(std::string& src,
                     const std::string& what,
                     const std::string& replacement) {
@@ -837,11 +848,13 @@ void Snapshot::incrementSuccessfulLoads() {
 
 void Snapshot::addSaveStats(bool incremental,
                             const base::System::Duration duration,
+                            const base::System::Duration pauseDuration,
                             uint64_t ramChangedBytes) {
     emulator_snapshot::SaveStats stats;
 
     stats.set_incremental(incremental ? 1 : 0);
     stats.set_duration((uint64_t)duration);
+    stats.set_pause_duration((uint64_t)pauseDuration);
     stats.set_ram_changed_bytes((uint64_t)ramChangedBytes);
 
     mSaveStats.push_back(stats);
@@ -854,8 +867,12 @@ bool Snapshot::areSavesSlow() const {
     static constexpr float kSlowSaveThresholdMs = 20000.0;
     float maxSaveTimeMs = 0.0f;
 
+    // What slows the guest down is the time it is paused for.
     for (size_t i = 0; i < mSaveStats.size(); ++i) {
-        float durationMs = mSaveStats[i].duration() / 1000.0f;
+        const auto& stats = mSaveStats[i];
+        float durationMs = (stats.has_pause_duration() ? stats.pause_duration()
+                                                       : stats.duration()) /
+                           1000.0f;
         maxSaveTimeMs = std::max(durationMs, maxSaveTimeMs);
     }
 
@@ -39,6 +39,9 @@ public:
 
     // An imported snapshot stores the qcow2's inside the snapshot directory.
     bool isImported();
+    // Returns the RAM files of other snapshots that this one's RAM is layered
+    // on (see RamLoader::readLayerNames()); empty if it stands on its own.
+    std::vector<std::string> ramLayers() const;
     // The hardware.ini & protobuf contain hardcoded paths, this will try to
     // fix them up.
     bool fixImport();
@@ -51,6 +54,7 @@ public:
     bool shouldInvalidate() const;
     void addSaveStats(bool incremental,
                       const base::System::Duration duration,
+                      const base::System::Duration pauseDuration,
                       uint64_t ramChangedBytes);
     bool areSavesSlow() const;
 
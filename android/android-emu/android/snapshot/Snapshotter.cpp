@@ -13,6 +13,7 @@
 
 #include "android/base/files/PathUtils.h"
 #include "android/base/memory/LazyInstance.h"
+#include "android/base/misc/StringUtils.h"
 #include "android/base/Stopwatch.h"
 #include "android/base/StringFormat.h"
 #include "android/crashreport/CrashReporter.h"
@@ -41,6 +42,7 @@
 #include "android/utils/path.h"
 #include "android/utils/system.h"
 
+#include <algorithm>
 #include <cassert>
 #include <utility>
 
@@ -127,6 +129,7 @@ bool isBufferZeroed(const void* ptr, int32_t size) {
 Snapshotter::Snapshotter() = default;
 
 Snapshotter::~Snapshotter() {
+    finishSaving();
     if (mVmOperations.setSnapshotCallbacks) {
         mVmOperations.setSnapshotCallbacks(nullptr, nullptr);
     }
@@ -231,7 +234,7 @@ void Snapshotter::initialize(const QAndroidVmOperations& vmOperations,
              // savingComplete
              [](void* opaque) {
                  auto snapshot = static_cast<Snapshotter*>(opaque);
-                 snapshot->mSaver->ramSaver().join();
+                 snapshot->mSaver->ramSaver().continueInBackground();
                  return snapshot->mSaver->ramSaver().hasError() ? -1 : 0;
              },
              // loadRam
@@ -289,6 +292,7 @@ static void appendFailedLoad(pb::EmulatorSnapshotLoadState state,
 #endif
 
 OperationStatus Snapshotter::prepareForLoading(const char* name) {
+    finishSaving();
     if (mSaver && mSaver->snapshot().name() == name) {
         mSaver.reset();
     }
@@ -329,6 +333,27 @@ void Snapshotter::finishLoading() {
     }
 }
 
+void Snapshotter::finishSaving() {
+    if (!mSaver || !mSaver->ramPending()) {
+        return;
+    }
+    mSaver->join();
+    const std::string name = mSaver->snapshot().name();
+    if (mSaver->status() != OperationStatus::Ok) {
+        handleGenericSave(name.c_str(), mSaver->status(), mReportPendingSave);
+    } else {
+        const auto stats = getSaveStats(name.c_str(), mPendingSavePauseMs);
+        dprint("Saved snapshot '%s' in %llu ms, with the guest paused for "
+               "%llu ms",
+               name.c_str(), (unsigned long long)stats.durationMs,
+               (unsigned long long)stats.pauseDurationMs);
+        if (mReportPendingSave) {
+            appendSuccessfulSave(name.c_str(), mPendingSavePauseMs);
+        }
+    }
+    mReportPendingSave = false;
+}
+
 void Snapshotter::prepareLoaderForSaving(const char* name) {
     if (!mLoader) {
         return;
@@ -341,6 +366,73 @@ void Snapshotter::prepareLoaderForSaving(const char* name) {
     }
 }
 
+Saver* Snapshotter::createSaver(const char* name) {
+    return new Saver(name,
+                     (mLoader && mLoader->hasRamLoader() &&
+                      mLoader->status() != OperationStatus::Error)
+                             ? &mLoader->ramLoader()
+                             : nullptr,
+                     mIsOnExit, mRamFile, mRamFileShared, mIsRemapping,
+                     ramParentFor(name));
+}
+
+RamCheckpointPtr Snapshotter::ramParentFor(const char* name) const {
+    // The exit snapshot is saved over all the time, and stays out of the
+    // hierarchy.
+    if (!mRamCheckpoint || mIsOnExit ||
+        base::StringView(name) == kDefaultBootSnapshot ||
+        mCheckpointName == name ||
+        int(mRamCheckpoint->files.size()) >= kMaxRamLayers) {
+        return {};
+    }
+    // Saving over one of the layers would pull the rug from under the new
+    // file.
+    const auto ramFile = PathUtils::join(getSnapshotDir(name), kRamFileName);
+    const auto& layers = mRamCheckpoint->files;
+    if (std::find(layers.begin(), layers.end(), ramFile) != layers.end()) {
+        return {};
+    }
+    return mRamCheckpoint;
+}
+
+std::vector<std::string> Snapshotter::ramLayerDependents(
+        const char* name) const {
+    std::vector<std::string> res;
+    const auto ramFile = PathUtils::join(getSnapshotDir(name), kRamFileName);
+    // The way RamSaver recorded it in the files layered on top.
+    const auto layerName =
+            PathUtils::relativeTo(getRamLayersBaseDir(ramFile), ramFile);
+    for (const auto& snapshot : Snapshot::getExistingSnapshots()) {
+        if (snapshot.name() == name) {
+            continue;
+        }
+        const auto layers = RamLoader::readLayerNames(PathUtils::join(
+                getSnapshotDir(c_str(snapshot.name())), kRamFileName));
+        if (std::find(layers.begin(), layers.end(), layerName) !=
+            layers.end()) {
+            res.push_back(snapshot.name());
+        }
+    }
+    return res;
+}
+
+void Snapshotter::resetRamCheckpoint() {
+    mRamCheckpoint.reset();
+    mCheckpointName.clear();
+}
+
+void Snapshotter::setCheckpointSeries(bool enable) {
+    mCheckpointSeries = enable;
+    if (mVmOperations.setRamDirtyLogKept) {
+        mVmOperations.setRamDirtyLogKept(enable);
+    }
+    resetRamCheckpoint();
+}
+
+std::string Snapshotter::layeredSaveParent() const {
+    return mSaver && mSaver->ramLayered() ? mCheckpointName : std::string();
+}
+
 void Snapshotter::callCallbacks(Operation op, Stage stage) {
     for (auto&& cb : mCallbacks) {
         cb(op, stage);
@@ -380,13 +472,21 @@ void Snapshotter::fillSnapshotMetrics(pb::AndroidStudioEvent* event,
                                      stats.texturesSize));
     snapshot->set_ram_size_bytes(int64_t(stats.ramSize));
     snapshot->set_textures_size_bytes(int64_t(stats.texturesSize));
+    if (stats.vulkanMemorySize) {
+        snapshot->set_vulkan_memory_size_bytes(stats.vulkanMemorySize);
+    }
 
     if (stats.forSave) {
         snapshot->set_save_state(
                 pb::EmulatorSnapshotSaveState::EMULATOR_SNAPSHOT_SAVE_SUCCEEDED_NORMAL);
         snapshot->set_save_duration_ms(uint64_t(stats.durationMs));
+        snapshot->set_save_pause_duration_ms(uint64_t(stats.pauseDurationMs));
         snapshot->set_ram_save_duration_ms(int64_t(stats.ramDurationMs));
         snapshot->set_textures_save_duration_ms(int64_t(stats.texturesDurationMs));
+        if (stats.vulkanMemorySize) {
+            snapshot->set_vulkan_memory_save_duration_ms(
+                    uint64_t(stats.vulkanMemoryDurationMs));
+        }
 
     } else {
         snapshot->set_load_state(
@@ -394,6 +494,10 @@ void Snapshotter::fillSnapshotMetrics(pb::AndroidStudioEvent* event,
         snapshot->set_load_duration_ms(uint64_t(stats.durationMs));
         snapshot->set_ram_load_duration_ms(int64_t(stats.ramDurationMs));
         snapshot->set_textures_load_duration_ms(int64_t(stats.texturesDurationMs));
+        if (stats.vulkanMemorySize) {
+            snapshot->set_vulkan_memory_load_duration_ms(
+                    uint64_t(stats.vulkanMemoryDurationMs));
+        }
     }
 
     // Also report some common host machine stats so we can correlate performance with
@@ -420,15 +524,20 @@ Snapshotter::SnapshotOperationStats Snapshotter::getSaveStats(const char* name,
     const auto ramSize = save.ramSaver().diskSize();
     const auto texturesSize = save.textureSaver()->diskSize();
 
+    // The guest was paused for |durationMs|; a copy-on-write save went on
+    // writing the RAM out after that.
+    save.join();
     System::Duration ramDurationMs = 0;
+    System::Duration ramPauseDurationMs = 0;
     System::Duration texturesDurationMs = 0;
     save.ramSaver().getDuration(&ramDurationMs); ramDurationMs /= 1000;
+    save.ramSaver().getPauseDuration(&ramPauseDurationMs); ramPauseDurationMs /= 1000;
     save.textureSaver()->getDuration(&texturesDurationMs); texturesDurationMs /= 1000;
 
     return {
         true /* for save */,
         std::string(name),
-        durationMs,
+        durationMs + (ramDurationMs - ramPauseDurationMs),
         false /* on-demand ram loading N/A for save */,
         save.incrementallySaved(),
         compressedRam,
@@ -440,6 +549,9 @@ Snapshotter::SnapshotOperationStats Snapshotter::getSaveStats(const char* name,
         (int64_t)texturesSize,
         ramDurationMs,
         texturesDurationMs,
+        durationMs,
+        (int64_t)save.textureSaver()->vulkanMemorySize(),
+        save.textureSaver()->vulkanMemoryDuration() / 1000,
     };
 }
 
@@ -472,6 +584,9 @@ Snapshotter::SnapshotOperationStats Snapshotter::getLoadStats(const char* name,
         (int64_t)texturesSize,
         ramDurationMs,
         0 /* TODO: texture lazy/bg load duration */,
+        durationMs,
+        (int64_t)load.textureLoader()->vulkanMemorySize(),
+        load.textureLoader()->vulkanMemoryDuration() / 1000,
     };
 }
 
@@ -500,6 +615,28 @@ void Snapshotter::appendSuccessfulLoad(const char* name,
     MetricsReporter::get().report([stats](pb::AndroidStudioEvent* event) {
         fillSnapshotMetrics(event, stats);
     });
+    reportTimeToFirstFrame(name);
+#endif
+}
+
+void Snapshotter::reportTimeToFirstFrame(const char* name) {
+#if SNAPSHOT_METRICS
+    if (!mLoader) return;
+
+    std::string nameStr = name ? name : "";
+    mLoader->setFirstFrameCallback(
+            [nameStr](System::Duration timeToFirstFrameMs) {
+                MetricsReporter::get().report(
+                        [nameStr, timeToFirstFrameMs](
+                                pb::AndroidStudioEvent* event) {
+                            auto snapshot = event->mutable_emulator_details()
+                                                    ->add_snapshot_loads();
+                            snapshot->set_name(
+                                    MetricsReporter::get().anonymize(nameStr));
+                            snapshot->set_time_to_first_frame_ms(
+                                    uint64_t(timeToFirstFrameMs));
+                        });
+            });
 #endif
 }
 
@@ -569,6 +706,21 @@ bool Snapshotter::checkSafeToSave(const char* name, bool reportMetrics) {
         return false;
     }
 
+    // Saving over a snapshot that others take RAM pages from would break
+    // them.
+    const auto dependents = ramLayerDependents(name);
+    if (!dependents.empty()) {
+        showError(StringFormat("Not saving snapshot '%s': the RAM of "
+                               "snapshot(s) %s is layered on it",
+                               name, base::join(dependents, ", ").c_str()));
+        if (reportMetrics) {
+            appendFailedSave(pb::EmulatorSnapshotSaveState::
+                                 EMULATOR_SNAPSHOT_SAVE_SKIPPED_UNSUPPORTED,
+                             FailureReason::SnapshotsNotSupported);
+        }
+        return false;
+    }
+
     // Check whether skipping snapshot saves was set.
     if (mVmOperations.isSnapshotSaveSkipped()) {
         showError("Skipping snapshot save: "
@@ -645,6 +797,9 @@ void Snapshotter::handleGenericSave(const char* name,
 
         deleteSnapshot(name);
 
+    } else if (mSaver && mSaver->ramPending()) {
+        // Reported by finishSaving() once the RAM is written out.
+        mReportPendingSave = reportMetrics;
     } else {
         if (reportMetrics) {
             appendSuccessfulSave(name,
@@ -703,17 +858,10 @@ void Snapshotter::handleGenericLoad(const char* name,
 }
 
 OperationStatus Snapshotter::prepareForSaving(const char* name) {
+    finishSaving();
     prepareLoaderForSaving(name);
     mVmOperations.vmStop();
-    mSaver.reset(new Saver(
-            name, (mLoader && mLoader->hasRamLoader() &&
-                   mLoader->status() != OperationStatus::Error)
-                          ? &mLoader->ramLoader()
-                          : nullptr,
-            mIsOnExit,
-            mRamFile,
-            mRamFileShared,
-            mIsRemapping));
+    mSaver.reset(createSaver(name));
     mVmOperations.vmStart();
     mSaver->prepare();
     return mSaver->status();
@@ -730,6 +878,9 @@ OperationStatus Snapshotter::save(bool isOnExit, const char* name) {
     }
     mVmOperations.snapshotSave(name, this, nullptr);
     mLastSaveDuration.emplace(sw.elapsedUs() / 1000);
+    // The next save resets |mLastSaveDuration| before it gets to report this
+    // one.
+    mPendingSavePauseMs = *mLastSaveDuration;
     // In unit tests, we don't have a saver, so trivially succeed.
     return mSaver ? mSaver->status() : OperationStatus::Ok;
 }
@@ -797,6 +948,23 @@ void Snapshotter::invalidateSnapshot(const char* name) {
 
     Snapshot tombstone(nameValidated);
 
+    const auto dependents = ramLayerDependents(nameValidated);
+    if (!dependents.empty()) {
+        showError(StringFormat("Deleting snapshot '%s' makes snapshot(s) %s "
+                               "fail to load: their RAM is layered on it",
+                               nameValidated.get(),
+                               base::join(dependents, ", ").c_str()));
+    }
+
+    if (mRamCheckpoint) {
+        const auto ramFile =
+                PathUtils::join(getSnapshotDir(nameValidated), kRamFileName);
+        const auto& layers = mRamCheckpoint->files;
+        if (std::find(layers.begin(), layers.end(), ramFile) != layers.end()) {
+            resetRamCheckpoint();
+        }
+    }
+
     if (name == mLoadedSnapshotFile) {
         // We're deleting the "loaded" snapshot, so first finish any pending
         // load, and then clear the snapshot file.  Do it under the VM lock to
@@ -857,22 +1025,20 @@ bool Snapshotter::onStartSaving(const char* name) {
     CrashReporter::get()->hangDetector().pause(true);
 #endif
     callCallbacks(Operation::Save, Stage::Start);
+    finishSaving();
     prepareLoaderForSaving(name);
     if (!mSaver || isComplete(*mSaver)) {
-        mSaver.reset(new Saver(
-                name, (mLoader && mLoader->hasRamLoader() &&
-                       mLoader->status() != OperationStatus::Error)
-                              ? &mLoader->ramLoader()
-                              : nullptr,
-                mIsOnExit,
-                mRamFile,
-                mRamFileShared,
-                mIsRemapping));
+        mSaver.reset(createSaver(name));
     }
     if (mSaver->status() == OperationStatus::Error) {
         onSavingComplete(name, -1);
         return false;
     }
+    if (mCheckpointSeries && mVmOperations.ramSaveDirtyPagesOnly) {
+        // A layered save only needs to check the pages written since its
+        // parent. If QEMU lost track of those, it checks all of them.
+        mVmOperations.ramSaveDirtyPagesOnly(mSaver->ramLayered());
+    }
     return true;
 }
 
@@ -886,6 +1052,22 @@ bool Snapshotter::onSavingComplete(const char* name, int res) {
     bool good = mSaver->status() != OperationStatus::Error &&
                 mSaver->status() != OperationStatus::Canceled;
 
+    if (mCheckpointSeries) {
+        // The next save in the series needs the page table of this one.
+        if (good && mSaver->ramPending()) {
+            mSaver->join();
+            good = mSaver->status() == OperationStatus::Ok;
+        }
+        // Every save takes the pages written until then off the dirty log, so
+        // only the last one can be the parent of the next.
+        if (good && base::StringView(name) != kDefaultBootSnapshot) {
+            mRamCheckpoint = mSaver->ramCheckpoint();
+            mCheckpointName = mRamCheckpoint ? name : "";
+        } else {
+            resetRamCheckpoint();
+        }
+    }
+
     // bug: 129763714
     // if (good) {
     //     Hierarchy::get()->currentInfo();
@@ -900,10 +1082,12 @@ void Snapshotter::onSavingFailed(const char* name, int res) {
 
 bool Snapshotter::onStartLoading(const char* name) {
     mLoadedSnapshotFile.clear();
+    resetRamCheckpoint();
 #ifndef AEMU_MIN
     CrashReporter::get()->hangDetector().pause(true);
 #endif
     callCallbacks(Operation::Load, Stage::Start);
+    finishSaving();
     mSaver.reset();
     if (!mLoader || isComplete(*mLoader)) {
         if (mLoader) {
@@ -974,6 +1158,7 @@ bool Snapshotter::onStartDelete(const char*) {
 #ifndef AEMU_MIN
     CrashReporter::get()->hangDetector().pause(true);
 #endif
+    finishSaving();
     return true;
 }
 
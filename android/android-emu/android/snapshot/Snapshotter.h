@@ -58,6 +58,11 @@ public:
         int64_t texturesSize;
         base::System::Duration ramDurationMs;
         base::System::Duration texturesDurationMs;
+        // The part of |durationMs| the guest was paused for; a copy-on-write
+        // save writes the RAM out after it resumes.
+        base::System::Duration pauseDurationMs;
+        int64_t vulkanMemorySize;
+        base::System::Duration vulkanMemoryDurationMs;
     };
 
     static void fillSnapshotMetrics(
@@ -65,6 +70,9 @@ public:
         const SnapshotOperationStats& stats);
     SnapshotOperationStats getLoadStats(const char* name, base::System::Duration durationMs);
     SnapshotOperationStats getSaveStats(const char* name, base::System::Duration durationMs);
+    // Reports the time to the first presented frame as a separate snapshot
+    // load event, once the renderer gets to it.
+    void reportTimeToFirstFrame(const char* name);
 
     void initialize(const QAndroidVmOperations& vmOperations,
                     const QAndroidEmulatorWindowAgent& windowAgent);
@@ -136,6 +144,20 @@ public:
     void setUsingHdd(bool usingHdd) { mUsingHdd = usingHdd; }
     bool isUsingHdd() const { return mUsingHdd; }
 
+    // In a checkpoint series, each snapshot save stores only the RAM pages
+    // written since the previous one, on top of it. Loading a snapshot starts
+    // a new series.
+    void setCheckpointSeries(bool enable);
+    bool isCheckpointSeries() const { return mCheckpointSeries; }
+
+    // Returns the snapshot that the one being saved stores its RAM on top of,
+    // or an empty string.
+    std::string layeredSaveParent() const;
+
+    // Waits for a copy-on-write save to write the RAM out, and then reports
+    // it or cleans it out. The snapshot is incomplete until then.
+    void finishSaving();
+
 private:
     bool onStartSaving(const char* name);
     bool onSavingComplete(const char* name, int res);
@@ -149,6 +171,12 @@ private:
     void finishLoading();
 
     void prepareLoaderForSaving(const char* name);
+    Saver* createSaver(const char* name);
+    RamCheckpointPtr ramParentFor(const char* name) const;
+    // Returns the other snapshots whose RAM files take pages from the one of
+    // snapshot |name|.
+    std::vector<std::string> ramLayerDependents(const char* name) const;
+    void resetRamCheckpoint();
     void callCallbacks(Operation op, Stage stage);
 
     void appendSuccessfulSave(const char* name,
@@ -172,17 +200,25 @@ private:
     base::System::Duration mLastLoadUptimeMs = 0;
     android::base::Optional<base::System::Duration> mLastSaveDuration = 0;
     android::base::Optional<base::System::Duration> mLastLoadDuration = 0;
+    // How long save() paused the guest for the save still writing its RAM.
+    base::System::Duration mPendingSavePauseMs = 0;
 
     bool mIsQuickboot = false;
     bool mIsOnExit = false;
     bool mIsInvalidating = false;
     bool mIsRemapping = false;
+    bool mReportPendingSave = false;
 
     std::string mRamFile;
     bool mRamFileShared = false;
     bool mUsingHdd = false;
 
     bool mDiskSpaceCheck = true;
+
+    bool mCheckpointSeries = false;
+    // The RAM of the last save in the checkpoint series.
+    RamCheckpointPtr mRamCheckpoint;
+    std::string mCheckpointName;
 };
 
 }  // namespace snapshot
@@ -16,6 +16,7 @@
 
 #include <assert.h>
 
+using android::base::CompressingStream;
 using android::base::DecompressingStream;
 
 namespace android {
@@ -41,14 +42,26 @@ bool TextureLoader::start() {
 void TextureLoader::loadTexture(uint32_t texId, const loader_t& loader) {
     android::base::AutoLock scopedLock(mLock);
     assert(mIndex.count(texId));
-    HANDLE_EINTR(fseeko64(mStream.get(), mIndex[texId], SEEK_SET));
+    const int64_t pos = mIndex[texId];
+    if (mVersion == 1) {
+        if (!mMapping.seek(pos)) {
+            mHasError = true;
+            return;
+        }
+        loader(&mMapping);
+        return;
+    }
+    HANDLE_EINTR(fseeko64(mStream.get(), pos, SEEK_SET));
     switch (mVersion) {
-        case 1:
-            loader(&mStream);
-            break;
         case 2: {
             DecompressingStream stream(mStream);
             loader(&stream);
+            break;
+        }
+        case 3: {
+            DecompressingStream stream(mStream, CompressingStream::kBlocks);
+            loader(&stream);
+            break;
         }
     }
     if (ferror(mStream.get())) {
@@ -56,11 +69,47 @@ void TextureLoader::loadTexture(uint32_t texId, const loader_t& loader) {
     }
 }
 
+void TextureLoader::onFirstFrame() {
+    FirstFrameCallback callback;
+    base::System::Duration delayMs;
+    {
+        android::base::AutoLock lock(mFirstFrameLock);
+        if (mFirstFrameTimeUs) {
+            return;
+        }
+        mFirstFrameTimeUs = base::System::get()->getHighResTimeUs();
+        delayMs = (mFirstFrameTimeUs - mCreateTimeUs) / 1000;
+        callback = std::move(mFirstFrameCallback);
+    }
+#if SNAPSHOT_PROFILE > 1
+    printf("Time to first frame after texture load: %d ms\n", int(delayMs));
+#endif
+    if (callback) {
+        callback(delayMs);
+    }
+}
+
+void TextureLoader::setFirstFrameCallback(FirstFrameCallback&& callback) {
+    base::System::Duration delayMs;
+    {
+        android::base::AutoLock lock(mFirstFrameLock);
+        if (!mFirstFrameTimeUs) {
+            mFirstFrameCallback = std::move(callback);
+            return;
+        }
+        delayMs = (mFirstFrameTimeUs - mCreateTimeUs) / 1000;
+    }
+    callback(delayMs);
+}
+
 bool TextureLoader::readIndex() {
 #if SNAPSHOT_PROFILE > 1
     auto start = android::base::System::get()->getHighResTimeUs();
 #endif
     assert(mIndex.size() == 0);
+    if (!mStream.get()) {
+        return false;
+    }
     base::System::FileSize size;
     if (base::System::get()->fileSize(fileno(mStream.get()), &size)) {
         mDiskSize = size;
@@ -68,7 +117,7 @@ bool TextureLoader::readIndex() {
     auto indexPos = mStream.getBe64();
     HANDLE_EINTR(fseeko64(mStream.get(), static_cast<int64_t>(indexPos), SEEK_SET));
     mVersion = mStream.getBe32();
-    if (mVersion < 1 || mVersion > 2) {
+    if (mVersion < 1 || mVersion > 3) {
         return false;
     }
     uint32_t texCount = mStream.getBe32();
@@ -78,6 +127,15 @@ bool TextureLoader::readIndex() {
         uint64_t filePos = mStream.getBe64();
         mIndex.emplace(tex, filePos);
     }
+    if (mVersion == 1) {
+        // Uncompressed levels get uploaded straight from a mapping of the
+        // file. Compressed ones are copied out by the decompression anyway,
+        // and reading them in streams better than faulting in the pages.
+        mMapping = base::MappedFileStream(fileno(mStream.get()));
+        if (!mMapping.valid()) {
+            return false;
+        }
+    }
 #if SNAPSHOT_PROFILE > 1
     printf("Texture readIndex() time: %.03f\n",
            (android::base::System::get()->getHighResTimeUs() - start) / 1000.0);
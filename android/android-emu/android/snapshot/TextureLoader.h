@@ -13,6 +13,7 @@
 
 #include "android/base/containers/SmallVector.h"
 #include "android/base/export.h"
+#include "android/base/files/MappedFileStream.h"
 #include "android/base/files/StdioStream.h"
 #include "android/base/synchronization/Lock.h"
 #include "android/base/system/System.h"
@@ -47,10 +48,23 @@ public:
     virtual bool compressed() const = 0;
     virtual void join() = 0;
     virtual void interrupt() = 0;
+    // Called by the renderer when it presents a frame; only the first call
+    // after the load is recorded.
+    virtual void onFirstFrame() = 0;
+    // Called by the renderer with the size of the host visible Vulkan
+    // memory it restored and the time that took, in microseconds.
+    virtual void setVulkanMemoryStats(uint64_t size,
+                                      base::System::Duration duration) = 0;
+    virtual uint64_t vulkanMemorySize() const = 0;
+    virtual base::System::Duration vulkanMemoryDuration() const = 0;
 };
 
 class TextureLoader final : public ITextureLoader {
 public:
+    // Receives the time from the start of the load to the first presented
+    // frame, in milliseconds.
+    using FirstFrameCallback = std::function<void(base::System::Duration)>;
+
     AEMU_EXPORT TextureLoader(android::base::StdioStream&& stream);
 
     AEMU_EXPORT bool start() override;
@@ -69,9 +83,15 @@ public:
             mLoaderThread.reset();
         }
         mStream.close();
+        mMapping.close();
         mEndTime = base::System::get()->getHighResTimeUs();
     }
 
+    AEMU_EXPORT void onFirstFrame() override;
+    // Sets the callback to run on the first frame; runs it immediately if
+    // the frame has already been presented.
+    AEMU_EXPORT void setFirstFrameCallback(FirstFrameCallback&& callback);
+
     AEMU_EXPORT void interrupt() override {
         if (mLoaderThread) {
             mLoaderThread->interrupt();
@@ -79,6 +99,7 @@ public:
             mLoaderThread.reset();
         }
         mStream.close();
+        mMapping.close();
         mEndTime = base::System::get()->getHighResTimeUs();
     }
 
@@ -97,10 +118,25 @@ public:
         return true;
     }
 
+    AEMU_EXPORT void setVulkanMemoryStats(
+            uint64_t size,
+            base::System::Duration duration) override {
+        mVulkanMemorySize = size;
+        mVulkanMemoryDuration = duration;
+    }
+    AEMU_EXPORT uint64_t vulkanMemorySize() const override {
+        return mVulkanMemorySize;
+    }
+    AEMU_EXPORT base::System::Duration vulkanMemoryDuration() const override {
+        return mVulkanMemoryDuration;
+    }
+
 private:
     bool readIndex();
 
     android::base::StdioStream mStream;
+    // Uncompressed textures are read from a mapping of the file instead.
+    android::base::MappedFileStream mMapping;
     std::unordered_map<uint32_t, int64_t> mIndex;
     android::base::Lock mLock;
     bool mStarted = false;
@@ -111,6 +147,15 @@ private:
 
     base::System::Duration mStartTime = 0;
     base::System::Duration mEndTime = 0;
+
+    android::base::Lock mFirstFrameLock;
+    base::System::Duration mCreateTimeUs =
+            base::System::get()->getHighResTimeUs();
+    base::System::Duration mFirstFrameTimeUs = 0;
+    FirstFrameCallback mFirstFrameCallback;
+
+    uint64_t mVulkanMemorySize = 0;
+    base::System::Duration mVulkanMemoryDuration = 0;
 };
 
 }  // namespace snapshot
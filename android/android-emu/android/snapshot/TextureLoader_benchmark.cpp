@@ -0,0 +1,204 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// Measures loading all the textures of a snapshot texture file through
+// TextureLoader and through plain stdio reads, the way TextureLoader read
+// them before, with the file in the page cache (warm) or not (cold).
+// TextureLoader reads compressed files through stdio as well, and maps
+// uncompressed ones to upload their pixels straight from the mapping.
+
+#include "android/snapshot/TextureLoader.h"
+
+#include "android/base/files/DecompressingStream.h"
+#include "android/base/files/MappedFileStream.h"
+#include "android/base/files/ScopedStdioFile.h"
+#include "android/base/files/StdioStream.h"
+#include "android/base/files/StreamSerializing.h"
+#include "android/snapshot/TextureSaver.h"
+
+#include "benchmark/benchmark_api.h"
+
+#include <random>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+using android::base::CompressingStream;
+using android::base::DecompressingStream;
+using android::base::MappedFileStream;
+using android::base::ScopedStdioFile;
+using android::base::StdioStream;
+using android::base::Stream;
+using android::snapshot::TextureLoader;
+using android::snapshot::TextureSaver;
+
+namespace {
+
+constexpr int kTextures = 64;
+constexpr int kTextureSize = 1024 * 1024;
+
+// Not in the temp directory: that is often a tmpfs, which can't be dropped
+// from the page cache.
+constexpr char kFileName[] = "TextureLoader_benchmark.bin";
+
+// The fields of a texture, in the way the GL snapshot saves them: a header
+// and the pixels, of which about half compress away.
+void saveTexture(Stream* stream, uint32_t seed) {
+    std::vector<uint8_t> pixels(kTextureSize);
+    std::minstd_rand random(seed);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        pixels[i] = (i & 4096) ? uint8_t(random()) : 0;
+    }
+    for (int i = 0; i < 10; ++i) {
+        stream->putBe32(seed + i);
+    }
+    android::base::saveBuffer(stream, pixels);
+}
+
+// Reads a texture the way SaveableTexture does, and copies its pixels to
+// |gpu|, which stands in for the GL upload.
+void loadTexture(Stream* stream,
+                 std::vector<uint8_t>* pixels,
+                 std::vector<uint8_t>* gpu) {
+    for (int i = 0; i < 10; ++i) {
+        stream->getBe32();
+    }
+    if (auto mapping = dynamic_cast<MappedFileStream*>(stream)) {
+        const uint32_t size = mapping->getBe32();
+        memcpy(gpu->data(), mapping->readInPlace(size), size);
+    } else {
+        android::base::loadBuffer(stream, pixels);
+        memcpy(gpu->data(), pixels->data(), pixels->size());
+    }
+}
+
+// A texture file on disk for the duration of a benchmark.
+class TextureFile {
+public:
+    explicit TextureFile(bool compressed) {
+        {
+            TextureSaver saver(StdioStream(fopen(kFileName, "wb"),
+                                           StdioStream::kOwner),
+                               compressed);
+            for (int i = 0; i < kTextures; ++i) {
+                saver.saveTexture(i, [i](Stream* stream,
+                                         TextureSaver::Buffer*) {
+                    saveTexture(stream, i);
+                });
+            }
+        }
+        mFile.reset(fopen(kFileName, "rb"));
+    }
+
+    ~TextureFile() {
+        mFile.reset();
+        remove(kFileName);
+    }
+
+    FILE* get() const { return mFile.get(); }
+
+    // Drops the file from the page cache, where the platform allows it.
+    void evict() {
+#ifdef __linux__
+        // Pages that haven't been written back yet can't be dropped.
+        fdatasync(fileno(mFile.get()));
+        posix_fadvise(fileno(mFile.get()), 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    }
+
+private:
+    ScopedStdioFile mFile;
+};
+
+// Reads the file the way TextureLoader did before it mapped uncompressed
+// files.
+void loadWithStdio(FILE* file,
+                   std::vector<uint8_t>* pixels,
+                   std::vector<uint8_t>* gpu) {
+    rewind(file);
+    StdioStream stream(file);
+    const auto indexPos = stream.getBe64();
+    fseeko64(file, indexPos, SEEK_SET);
+    const auto version = stream.getBe32();
+    std::vector<int64_t> positions(stream.getBe32());
+    for (auto& pos : positions) {
+        stream.getBe32();
+        pos = stream.getBe64();
+    }
+    for (const auto pos : positions) {
+        fseeko64(file, pos, SEEK_SET);
+        if (version == 1) {
+            loadTexture(&stream, pixels, gpu);
+        } else {
+            DecompressingStream decompressed(stream,
+                                             CompressingStream::kBlocks);
+            loadTexture(&decompressed, pixels, gpu);
+        }
+    }
+}
+
+void loadWithTextureLoader(FILE* file,
+                           std::vector<uint8_t>* pixels,
+                           std::vector<uint8_t>* gpu) {
+    rewind(file);
+    TextureLoader loader{StdioStream(file)};
+    loader.start();
+    for (int i = 0; i < kTextures; ++i) {
+        loader.loadTexture(i, [pixels, gpu](Stream* stream) {
+            loadTexture(stream, pixels, gpu);
+        });
+    }
+}
+
+template <class Func>
+void loadAll(benchmark::State& state, Func load) {
+    TextureFile file(state.range_y());
+    const bool cold = state.range_x();
+    std::vector<uint8_t> pixels;
+    std::vector<uint8_t> gpu(kTextureSize);
+    while (state.KeepRunning()) {
+        if (cold) {
+            state.PauseTiming();
+            file.evict();
+            state.ResumeTiming();
+        }
+        load(file.get(), &pixels, &gpu);
+    }
+    state.SetBytesProcessed(state.iterations() * kTextures * kTextureSize);
+}
+
+void addArgs(benchmark::internal::Benchmark* b) {
+    for (int compressed = 0; compressed < 2; ++compressed) {
+        for (int cold = 0; cold < 2; ++cold) {
+            b->ArgPair(cold, compressed);
+        }
+    }
+}
+
+}  // namespace
+
+// range_x() is 1 for a cold page cache, 0 for a warm one; range_y() is 1
+// for a compressed file, 0 for an uncompressed one.
+
+void BM_TextureLoad_Stdio(benchmark::State& state) {
+    loadAll(state, loadWithStdio);
+}
+
+void BM_TextureLoad_Loader(benchmark::State& state) {
+    loadAll(state, loadWithTextureLoader);
+}
+
+// Disk reads are not CPU time.
+BENCHMARK(BM_TextureLoad_Stdio)->Apply(addArgs)->UseRealTime();
+BENCHMARK(BM_TextureLoad_Loader)->Apply(addArgs)->UseRealTime();
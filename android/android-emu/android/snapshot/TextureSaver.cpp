@@ -25,8 +25,10 @@ using android::base::System;
 namespace android {
 namespace snapshot {
 
-TextureSaver::TextureSaver(android::base::StdioStream&& stream)
+TextureSaver::TextureSaver(android::base::StdioStream&& stream,
+                           bool compressed)
     : mStream(std::move(stream)) {
+    mIndex.version = compressed ? 3 : 1;
     // Put a placeholder for the index offset right now.
     mStream.putBe64(0);
 }
@@ -48,7 +50,11 @@ void TextureSaver::saveTexture(uint32_t texId, const saver_t& saver) {
                         }));
     mIndex.textures.push_back({texId, ftello64(mStream.get())});
 
-    CompressingStream stream(mStream);
+    if (!compressed()) {
+        saver(&mStream, &mBuffer);
+        return;
+    }
+    CompressingStream stream(mStream, CompressingStream::kBlocks);
     saver(&stream, &mBuffer);
 }
 
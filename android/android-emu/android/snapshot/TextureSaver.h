@@ -41,13 +41,22 @@ public:
     virtual uint64_t diskSize() const = 0;
     virtual bool compressed() const = 0;
     virtual bool getDuration(base::System::Duration* duration) = 0;
+    // Called by the renderer with the size of the host visible Vulkan
+    // memory it saved and the time that took, in microseconds.
+    virtual void setVulkanMemoryStats(uint64_t size,
+                                      base::System::Duration duration) = 0;
+    virtual uint64_t vulkanMemorySize() const = 0;
+    virtual base::System::Duration vulkanMemoryDuration() const = 0;
 };
 
 class TextureSaver final : public ITextureSaver {
     DISALLOW_COPY_AND_ASSIGN(TextureSaver);
 
 public:
-    AEMU_EXPORT TextureSaver(android::base::StdioStream&& stream);
+    // Uncompressed files take more space but load faster: TextureLoader
+    // maps them and uploads the textures straight from the mapping.
+    AEMU_EXPORT TextureSaver(android::base::StdioStream&& stream,
+                             bool compressed = true);
     AEMU_EXPORT ~TextureSaver();
     AEMU_EXPORT void saveTexture(uint32_t texId, const saver_t& saver) override;
     AEMU_EXPORT void done();
@@ -71,6 +80,19 @@ public:
         return true;
     }
 
+    AEMU_EXPORT void setVulkanMemoryStats(
+            uint64_t size,
+            base::System::Duration duration) override {
+        mVulkanMemorySize = size;
+        mVulkanMemoryDuration = duration;
+    }
+    AEMU_EXPORT uint64_t vulkanMemorySize() const override {
+        return mVulkanMemorySize;
+    }
+    AEMU_EXPORT base::System::Duration vulkanMemoryDuration() const override {
+        return mVulkanMemoryDuration;
+    }
+
 private:
     struct FileIndex {
         struct Texture {
@@ -79,7 +101,9 @@ private:
         };
 
         int64_t startPosInFile;
-        int32_t version = 2;
+        // 1: uncompressed, 2: CompressingStream::kStream,
+        // 3: CompressingStream::kBlocks.
+        int32_t version = 3;
         std::vector<Texture> textures;
     };
 
@@ -96,6 +120,9 @@ private:
 
     android::base::System::Duration mStartTime = 0;
     android::base::System::Duration mEndTime = 0;
+
+    uint64_t mVulkanMemorySize = 0;
+    android::base::System::Duration mVulkanMemoryDuration = 0;
 };
 
 }  // namespace snapshot
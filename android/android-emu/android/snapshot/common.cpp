@@ -10,6 +10,7 @@
 // GNU General Public License for more details.
 
 #include "android/snapshot/common.h"
+#include "android/base/files/PathUtils.h"
 #include "android/featurecontrol/FeatureControl.h"
 #include "android/globals.h"
 #include "android/metrics/AdbLivenessChecker.h"
@@ -81,6 +82,12 @@ const char* failureReasonToString(FailureReason failure,
     }
 }
 
+std::string getRamLayersBaseDir(base::StringView ramFile) {
+    auto components = base::PathUtils::decompose(ramFile);
+    components.resize(components.size() > 2 ? components.size() - 2 : 0);
+    return base::PathUtils::recompose(components);
+}
+
 // bug: 116315668
 // The current scheme of snapshot liveness checking
 // causes more problems than it solves;
@@ -41,6 +41,8 @@ class TextureLoader;
 using ITextureSaverPtr = std::shared_ptr<ITextureSaver>;
 using ITextureLoaderPtr = std::shared_ptr<ITextureLoader>;
 using ITextureLoaderWPtr = std::weak_ptr<ITextureLoader>;
+struct RamCheckpoint;
+using RamCheckpointPtr = std::shared_ptr<const RamCheckpoint>;
 
 // Taken from exec.c, these #defines
 // are for the |flags| field in SnapshotRamBlock.
@@ -54,6 +56,9 @@ enum class IndexFlags {
     Empty = 0,
     CompressedPages = 0x01,
     SeparateBackingStore = 0x02,
+    // Some of the pages are stored in the RAM files of the snapshots this
+    // one was saved on top of.
+    Layered = 0x04,
 };
 
 enum class OperationStatus {
@@ -109,8 +114,15 @@ bool isComplete(const Operation& op) {
 
 bool isBufferZeroed(const void* ptr, int32_t size);
 
+// Returns the directory that the paths of the layers of a layered RAM file
+// |ramFile| are relative to: the one holding its snapshot directory.
+std::string getRamLayersBaseDir(base::StringView ramFile);
+
 constexpr int32_t kDefaultPageSize = 4096;
 
+// Most RAM files the pages of a snapshot may be spread over, its own included.
+constexpr int kMaxRamLayers = 8;
+
 constexpr int32_t kCancelTimeoutMs = 15000;
 
 // Size in bytes of largest in-flight RAM region for decommitting.
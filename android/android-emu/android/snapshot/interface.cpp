@@ -219,6 +219,10 @@ bool androidSnapshot_isUsingHdd() {
     return Snapshotter::get().isUsingHdd();
 }
 
+void androidSnapshot_setCheckpointSeries(bool enable) {
+    Snapshotter::get().setCheckpointSeries(enable);
+}
+
 bool androidSnapshot_protoExists(const char* name) {
     auto pbPath = pj(
         android::snapshot::getSnapshotDir(name),
@@ -109,6 +109,10 @@ void androidSnapshot_quickbootSetShortRunCheck(bool enable);
 void androidSnapshot_setUsingHdd(bool usingHdd);
 bool androidSnapshot_isUsingHdd();
 
+// Starts or stops a checkpoint series, where each snapshot save stores only
+// the RAM pages written since the previous one, on top of it.
+void androidSnapshot_setCheckpointSeries(bool enable);
+
 bool androidSnapshot_protoExists(const char* name);
 
 ANDROID_END_HEADER
@@ -13,6 +13,7 @@
   X(EGLBoolean, eglSaveAllImages, (EGLDisplay display, EGLStream stream, const void* textureSaver)) \
   X(EGLBoolean, eglPreSaveContext, (EGLDisplay display, EGLContext contex, EGLStream stream)) \
   X(EGLBoolean, eglPostLoadAllImages, (EGLDisplay display, EGLStream stream)) \
+  X(void, eglOnFramePosted, (EGLDisplay display)) \
   X(EGLBoolean, eglPostSaveContext, (EGLDisplay display, EGLConfig config, EGLStream stream)) \
   X(void, eglUseOsEglApi, (EGLBoolean enable)) \
   X(void, eglSetMaxGLESVersion, (EGLint glesVersion)) \
@@ -26,6 +27,7 @@ EGLAPI EGLBoolean EGLAPIENTRY eglSaveContext(EGLDisplay display, EGLContext cont
 EGLAPI EGLBoolean EGLAPIENTRY eglSaveAllImages(EGLDisplay display, EGLStream stream, const void* textureSaver);
 EGLAPI EGLBoolean EGLAPIENTRY eglPreSaveContext(EGLDisplay display, EGLContext contex, EGLStream stream);
 EGLAPI EGLBoolean EGLAPIENTRY eglPostLoadAllImages(EGLDisplay display, EGLStream stream);
+EGLAPI void EGLAPIENTRY eglOnFramePosted(EGLDisplay display);
 EGLAPI EGLBoolean EGLAPIENTRY eglPostSaveContext(EGLDisplay display, EGLConfig config, EGLStream stream);
 EGLAPI void EGLAPIENTRY eglUseOsEglApi(EGLBoolean enable);
 EGLAPI void EGLAPIENTRY eglSetMaxGLESVersion(EGLint glesVersion);
@@ -0,0 +1,65 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <stdint.h>
+
+namespace emugl {
+
+// Histogram of frame times in microseconds. Each bin ends a bit above the
+// frame time at 240, 120, 90, 60, 50, 30, 20, 10, 4 and 2 fps, so that
+// frames at each of those rates get their own bin.
+class FrameTimeHistogram {
+public:
+    static constexpr int kNumBins = 11;
+    // Lower bound of each bin. The last bin is unbounded.
+    static constexpr std::array<uint64_t, kNumBins> kBinStartUs = {
+            0,     4200,  8400,   11200,  16800,  20200,
+            33400, 50100, 100200, 250000, 500000};
+
+    void add(uint64_t us) {
+        auto it = std::upper_bound(kBinStartUs.begin(), kBinStartUs.end(), us);
+        ++mCounts[it - kBinStartUs.begin() - 1];
+        ++mTotalCount;
+    }
+
+    uint64_t totalCount() const { return mTotalCount; }
+    uint64_t count(int bin) const { return mCounts[bin]; }
+
+private:
+    std::array<uint64_t, kNumBins> mCounts = {};
+    uint64_t mTotalCount = 0;
+};
+
+// Frames the guest posted to a display, and how they made it to the host.
+struct DisplayFrameStats {
+    uint64_t postedFrames = 0;
+    uint64_t presentedFrames = 0;
+    // Frames replaced by a newer one before they were shown.
+    uint64_t coalescedFrames = 0;
+    // Frames shown more than a refresh interval after they were posted.
+    uint64_t lateFrames = 0;
+    // Time between consecutive frames shown.
+    FrameTimeHistogram frameTimeUs;
+    // Time from a guest post to the frame being shown.
+    FrameTimeHistogram latencyUs;
+};
+
+// Stats of each display, by display id.
+using FrameStats = std::map<uint32_t, DisplayFrameStats>;
+
+}  // namespace emugl
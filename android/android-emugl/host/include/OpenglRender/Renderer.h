@@ -13,6 +13,7 @@
 // limitations under the License.
 #pragma once
 
+#include "OpenglRender/FrameStats.h"
 #include "OpenglRender/RenderChannel.h"
 #include "OpenglRender/render_api_platform_types.h"
 #include "android/base/files/Stream.h"
@@ -91,7 +92,8 @@ public:
     //   pixels         The framebuffer image.
     //
     // In the first implementation, ydir is always -1 (bottom to top), format
-    // and type are always GL_RGBA and GL_UNSIGNED_BYTE, and the width and
+    // is GL_BGRA_EXT if |useBgraReadback| is set and GL_RGBA otherwise, type
+    // is always GL_UNSIGNED_BYTE, and the width and
     // height will always be the same as the ones used to create the renderer.
     using OnPostCallback = void (*)(void* context,
                                     uint32_t displayId,
@@ -225,6 +227,8 @@ public:
                       const android::snapshot::ITextureLoaderPtr& textureLoader) = 0;
     // Fill GLES usage protobuf
     virtual void fillGLESUsages(android_studio::EmulatorGLESUsages*) = 0;
+    // Frames posted to each display and how they were shown on the host.
+    virtual FrameStats getFrameStats() = 0;
     virtual void getScreenshot(unsigned int nChannels, unsigned int* width,
         unsigned int* height, std::vector<unsigned char>& pixels, int displayId = 0,
         int desiredWidth = 0, int desiredHeight = 0,
@@ -137,6 +137,7 @@ EGLAPI EGLBoolean EGLAPIENTRY eglLoadAllImages(EGLDisplay display,
                                                EGLStream stream,
                                                const void* textureLoader);
 EGLAPI EGLBoolean EGLAPIENTRY eglPostLoadAllImages(EGLDisplay display, EGLStream stream);
+EGLAPI void EGLAPIENTRY eglOnFramePosted(EGLDisplay display);
 EGLAPI void EGLAPIENTRY eglUseOsEglApi(EGLBoolean enable);
 EGLAPI void EGLAPIENTRY eglSetMaxGLESVersion(EGLint version);
 EGLAPI void EGLAPIENTRY eglFillUsages(void* usages);
@@ -1675,6 +1676,14 @@ EGLAPI EGLBoolean EGLAPIENTRY eglPostLoadAllImages(EGLDisplay display, EGLStream
     return true;
 }
 
+EGLAPI void EGLAPIENTRY eglOnFramePosted(EGLDisplay display) {
+    EglDisplay* dpy = g_eglInfo->getDisplay(display);
+    if (!dpy) {
+        return;
+    }
+    dpy->getGlobalNameSpace()->onFrame();
+}
+
 EGLAPI void EGLAPIENTRY eglUseOsEglApi(EGLBoolean enable) {
     MEM_TRACE("EMUGL");
     EglGlobalInfo::setEgl2Egl(enable);
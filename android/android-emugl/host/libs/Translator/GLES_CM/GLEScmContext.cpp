@@ -1802,6 +1802,7 @@ void GLEScmContext::drawArrays(GLenum mode, GLint first, GLsizei count) {
     if (!isArrEnabled(GL_VERTEX_ARRAY)) return;
 
     drawValidate();
+    markBoundTexturesUsed();
 
     GLuint prev_vbo;
     GLuint prev_ibo;
@@ -1853,6 +1854,7 @@ void GLEScmContext::drawElements(GLenum mode, GLsizei count, GLenum type, const
     if (!isArrEnabled(GL_VERTEX_ARRAY)) return;
 
     drawValidate();
+    markBoundTexturesUsed();
 
     if(isBindedBuffer(GL_ELEMENT_ARRAY_BUFFER)) { // if vbo is binded take the indices from the vbo
         const unsigned char* buf = static_cast<unsigned char *>(getBindedBuffer(GL_ELEMENT_ARRAY_BUFFER));
@@ -516,6 +516,10 @@ GL_API void GL_APIENTRY  glBindTexture( GLenum target, GLuint texture) {
             texData->resetSaveableTexture();
         }
         texData->wasBound = true;
+        if (const SaveableTexturePtr& saveable =
+                    texData->getSaveableTexture()) {
+            saveable->markUsed();
+        }
     }
 
     ctx->setBindedTexture(target, texture, globalTextureName);
@@ -2860,6 +2864,7 @@ void glDrawTexOES (T x, T y, T z, T width, T height) {
     SET_ERROR_IF((width<=0 || height<=0),GL_INVALID_VALUE);
 
     ctx->drawValidate();
+    ctx->markBoundTexturesUsed();
     ctx->drawTexOES((float)x, (float)y, (float)z, (float)width, (float)height);
 }
 
@@ -10,9 +10,11 @@
 // GNU General Public License for more details.
 
 #include "ANGLEShaderParser.h"
+#include "ShaderTranslationCache.h"
 
 #include "android/base/synchronization/Lock.h"
 #include "android/base/memory/LazyInstance.h"
+#include "android/base/system/System.h"
 
 #include "emugl/common/shared_library.h"
 
@@ -121,14 +123,31 @@ ShaderLinkInfo::ShaderLinkInfo(ShaderLinkInfo&& other) {
 }
 
 ShaderLinkInfo& ShaderLinkInfo::operator=(ShaderLinkInfo&& other) {
+    if (this == &other) {
+        return *this;
+    }
+
+    // Release the translator's copies of the variables this held.
+    clear();
+
     esslVersion = other.esslVersion;
     uniforms = std::move(other.uniforms);
     varyings = std::move(other.varyings);
     attributes = std::move(other.attributes);
     outputVars = std::move(other.outputVars);
+    interfaceBlocks = std::move(other.interfaceBlocks);
     nameMap = std::move(other.nameMap);
     nameMapReverse = std::move(other.nameMapReverse);
 
+    // |other| no longer owns any variables.
+    other.uniforms.clear();
+    other.varyings.clear();
+    other.attributes.clear();
+    other.outputVars.clear();
+    other.interfaceBlocks.clear();
+    other.nameMap.clear();
+    other.nameMapReverse.clear();
+
     return *this;
 }
 
@@ -270,12 +289,9 @@ static std::vector<T> convertArrayToVecWithCopy(
 static void getShaderLinkInfo(int esslVersion,
                               const ST_ShaderCompileResult* compileResult,
                               ShaderLinkInfo* linkInfo) {
+    // Releases the variables of any previous translation.
+    *linkInfo = ShaderLinkInfo();
     linkInfo->esslVersion = esslVersion;
-    linkInfo->uniforms.clear();
-    linkInfo->varyings.clear();
-    linkInfo->attributes.clear();
-    linkInfo->outputVars.clear();
-    linkInfo->interfaceBlocks.clear();
 
     for (uint32_t i = 0; i < compileResult->nameHashingMap->entryCount; ++i) {
         linkInfo->nameMap[compileResult->nameHashingMap->ppUserNames[i]] =
@@ -391,40 +407,77 @@ bool translate(bool hostUsesCoreProfile,
         return false;
     }
 
-    // ANGLE may crash if multiple RenderThreads attempt to compile shaders
-    // at the same time.
-    android::base::AutoLock autolock(kCompilerLock);
-
-    ShaderSpecKey key;
-    key.shaderType = shaderType;
-    key.esslVersion = esslVersion;
-
-    ST_ShaderCompileInfo ci = {
-        (ST_Handle)getShaderCompiler(hostUsesCoreProfile, key),
-        shaderType,
-        sInputSpecForVersion(esslVersion),
-        sOutputSpecForVersion(hostUsesCoreProfile, esslVersion),
-        ST_OBJECT_CODE | ST_VARIABLES,
-        &kResources,
-        src,
-    };
-
-    ST_ShaderCompileResult* res = nullptr;
-
-    auto st = getSTDispatch();
-
-    st->compileAndResolve(&ci, &res);
+    // Guest system images compile the same shaders on every boot; skip
+    // the translator for ones this host has already seen. The cache does
+    // its own locking, keep its disk I/O out of kCompilerLock.
+    ShaderTranslationCache* cache =
+            sIsGles2Gles ? nullptr : ShaderTranslationCache::get();
+    std::string cacheKey;
+    if (cache) {
+        cacheKey = ShaderTranslationCache::makeKey(
+                hostUsesCoreProfile, src, shaderType, esslVersion, kResources);
+        ShaderTranslationCache::Result cached;
+        if (cache->lookup(cacheKey, &cached)) {
+            *outInfolog = std::move(cached.infoLog);
+            *outObjCode = std::move(cached.objCode);
+            if (outShaderLinkInfo) {
+                *outShaderLinkInfo = std::move(cached.linkInfo);
+            }
+            return cached.compileStatus;
+        }
+    }
 
-    sCompilerMap->emplace(key, res->outputHandle);
-    *outInfolog = std::string(res->infoLog);
-    *outObjCode = std::string(res->translatedSource);
+    ShaderTranslationCache::Result result;
+    {
+        // ANGLE may crash if multiple RenderThreads attempt to compile
+        // shaders at the same time.
+        android::base::AutoLock autolock(kCompilerLock);
+
+        ShaderSpecKey key;
+        key.shaderType = shaderType;
+        key.esslVersion = esslVersion;
+
+        ST_ShaderCompileInfo ci = {
+            (ST_Handle)getShaderCompiler(hostUsesCoreProfile, key),
+            shaderType,
+            sInputSpecForVersion(esslVersion),
+            sOutputSpecForVersion(hostUsesCoreProfile, esslVersion),
+            ST_OBJECT_CODE | ST_VARIABLES,
+            &kResources,
+            src,
+        };
+
+        ST_ShaderCompileResult* res = nullptr;
+
+        auto st = getSTDispatch();
+
+        const uint64_t startUs =
+                android::base::System::get()->getHighResTimeUs();
+        st->compileAndResolve(&ci, &res);
+        result.translateTimeUs =
+                android::base::System::get()->getHighResTimeUs() - startUs;
+
+        sCompilerMap->emplace(key, res->outputHandle);
+        result.compileStatus = res->compileStatus == 1;
+        result.infoLog = std::string(res->infoLog);
+        result.objCode = std::string(res->translatedSource);
+        if (outShaderLinkInfo || cache) {
+            getShaderLinkInfo(esslVersion, res, &result.linkInfo);
+        }
 
-    if (outShaderLinkInfo) getShaderLinkInfo(esslVersion, res, outShaderLinkInfo);
+        st->freeShaderResolveState(res);
+    }
 
-    bool ret = res->compileStatus == 1;
+    if (cache) {
+        cache->store(cacheKey, result);
+    }
 
-    st->freeShaderResolveState(res);
-    return ret;
+    *outInfolog = std::move(result.infoLog);
+    *outObjCode = std::move(result.objCode);
+    if (outShaderLinkInfo) {
+        *outShaderLinkInfo = std::move(result.linkInfo);
+    }
+    return result.compileStatus;
 }
 
 } // namespace ANGLEShaderParser
@@ -29,7 +29,7 @@ STDispatch* getSTDispatch();
 
 // For performing link-time validation of shader programs.
 struct ShaderLinkInfo {
-    int esslVersion;
+    int esslVersion = 0;
     std::vector<ST_ShaderVariable> uniforms;
     std::vector<ST_ShaderVariable> varyings;
     std::vector<ST_ShaderVariable> attributes;
@@ -0,0 +1,163 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "BlobFileCache.h"
+
+#include "android/base/StringFormat.h"
+#include "android/base/files/MemStream.h"
+#include "android/base/files/PathUtils.h"
+#include "android/base/misc/FileUtils.h"
+#include "android/base/system/System.h"
+#include "android/base/threads/Thread.h"
+#include "android/emulation/ConfigDirs.h"
+#include "android/utils/file_io.h"
+#include "android/utils/path.h"
+
+#include "emugl/common/logging.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <stdio.h>
+
+using android::base::AutoLock;
+using android::base::MemStream;
+using android::base::Optional;
+using android::base::PathUtils;
+using android::base::System;
+
+static constexpr uint32_t kMagic = 0x53544331;  // 'STC1'
+// Magic and checksum.
+static constexpr size_t kHeaderSize = 12;
+static constexpr uint64_t kTrimInterval = 256;
+
+static uint64_t sHash(const char* data, size_t size) {
+    // 64-bit FNV-1a.
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (uint8_t)data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+BlobFileCache::BlobFileCache(std::string dir, size_t maxEntries)
+    : mDir(std::move(dir)), mMaxEntries(maxEntries) {
+    trim();
+}
+
+// static
+std::string BlobFileCache::directoryFor(const char* name) {
+    if (!System::getEnvironmentVariable(
+                 "ANDROID_EMUGL_DISABLE_SHADER_CACHE").empty()) {
+        return {};
+    }
+    std::string root =
+            System::getEnvironmentVariable("ANDROID_EMUGL_SHADER_CACHE_DIR");
+    if (root.empty()) {
+        root = PathUtils::join(android::ConfigDirs::getUserDirectory(),
+                               "shader-cache");
+    }
+    std::string dir = PathUtils::join(root, name);
+    if (path_mkdir_if_needed(dir.c_str(), 0755) != 0) {
+        GL_LOG("Shader cache disabled, can't create %s", dir.c_str());
+        return {};
+    }
+    return dir;
+}
+
+std::string BlobFileCache::pathForKey(const std::string& key) const {
+    return PathUtils::join(
+            mDir, android::base::StringFormat(
+                          "%016llx.bin",
+                          (unsigned long long)sHash(key.data(), key.size())));
+}
+
+Optional<std::string> BlobFileCache::get(const std::string& key) const {
+    auto contents = android::readFileIntoString(pathForKey(key));
+    // Entries are: magic, hash of the rest, key, value.
+    if (!contents || contents->size() < kHeaderSize) {
+        return {};
+    }
+    MemStream stream(MemStream::Buffer(contents->begin(), contents->end()));
+    const uint32_t magic = stream.getBe32();
+    const uint64_t hash = stream.getBe64();
+    if (magic != kMagic ||
+        hash != sHash(contents->data() + kHeaderSize,
+                      contents->size() - kHeaderSize) ||
+        stream.getString() != key) {
+        return {};
+    }
+    return stream.getString();
+}
+
+void BlobFileCache::put(const std::string& key, const std::string& value) {
+    MemStream payload;
+    payload.putString(key);
+    payload.putString(value);
+    const auto& buffer = payload.buffer();
+
+    MemStream header;
+    header.putBe32(kMagic);
+    header.putBe64(sHash(buffer.data(), buffer.size()));
+
+    const std::string path = pathForKey(key);
+    // Unique per process and thread: shaders are built on render threads,
+    // which may store the same entry at once.
+    const std::string tmpPath = android::base::StringFormat(
+            "%s.%d.%lx.tmp", path.c_str(),
+            (int)System::get()->getCurrentProcessId(),
+            android::base::getCurrentThreadId());
+    FILE* file = android_fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        return;
+    }
+    bool ok = fwrite(header.buffer().data(), 1, header.buffer().size(),
+                     file) == header.buffer().size() &&
+              fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    ok = fclose(file) == 0 && ok;
+    if (ok) {
+        // On Windows, rename() fails if another instance stored the same
+        // entry first, which is just as good.
+        ok = rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+    if (!ok) {
+        path_delete_file(tmpPath.c_str());
+    }
+
+    AutoLock lock(mLock);
+    if (++mPutsSinceTrim >= kTrimInterval) {
+        mPutsSinceTrim = 0;
+        lock.unlock();
+        trim();
+    }
+}
+
+void BlobFileCache::trim() {
+    std::vector<std::string> entries =
+            System::get()->scanDirEntries(mDir, true /* fullPath */);
+    if (entries.size() <= mMaxEntries) {
+        return;
+    }
+
+    // Keep the most recently written three quarters.
+    std::vector<std::pair<System::Duration, std::string>> byAge;
+    for (auto& entry : entries) {
+        auto time = System::get()->pathModificationTime(entry);
+        byAge.emplace_back(time ? *time : 0, std::move(entry));
+    }
+    std::sort(byAge.begin(), byAge.end());
+    const size_t toDelete = byAge.size() - mMaxEntries * 3 / 4;
+    for (size_t i = 0; i < toDelete; ++i) {
+        path_delete_file(byAge[i].second.c_str());
+    }
+}
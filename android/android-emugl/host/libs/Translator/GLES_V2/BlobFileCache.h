@@ -0,0 +1,52 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#pragma once
+
+#include "android/base/Optional.h"
+#include "android/base/synchronization/Lock.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// BlobFileCache maps keys to values in files of a directory shared by all
+// emulator instances on the host.
+//
+// Each value is a file named after a hash of its key; the full key is
+// stored in the file as well, with a checksum, and both are checked on
+// get(). Files are written to a temporary name and renamed into place, so
+// concurrent instances only ever see complete entries, and the last writer
+// of a key wins. Once the directory holds more than |maxEntries| files, the
+// least recently written ones are deleted.
+class BlobFileCache {
+public:
+    BlobFileCache(std::string dir, size_t maxEntries);
+
+    // Returns the directory for the cache |name|: a subdirectory of
+    // ANDROID_EMUGL_SHADER_CACHE_DIR, or of the user's emulator directory if
+    // it is not set. Returns an empty string if
+    // ANDROID_EMUGL_DISABLE_SHADER_CACHE is set or the directory can't be
+    // created.
+    static std::string directoryFor(const char* name);
+
+    android::base::Optional<std::string> get(const std::string& key) const;
+    void put(const std::string& key, const std::string& value);
+
+private:
+    std::string pathForKey(const std::string& key) const;
+    void trim();
+
+    const std::string mDir;
+    const size_t mMaxEntries;
+    android::base::Lock mLock;
+    uint64_t mPutsSinceTrim = 0;
+};
@@ -503,6 +503,7 @@ void GLESv2Context::drawWithEmulations(
     if (getMajorVersion() < 3) {
         drawValidate();
     }
+    markBoundTexturesUsed();
 
     bool needClientVBOSetup = !vertexAttributesBufferBacked();
 
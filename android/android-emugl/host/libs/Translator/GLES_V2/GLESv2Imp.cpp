@@ -699,6 +699,10 @@ GL_APICALL void  GL_APIENTRY glBindTexture(GLenum target, GLuint texture){
             texData->resetSaveableTexture();
         }
         texData->wasBound = true;
+        if (const SaveableTexturePtr& saveable =
+                    texData->getSaveableTexture()) {
+            saveable->markUsed();
+        }
     }
 
     ctx->setBindedTexture(target,texture);
@@ -1075,6 +1079,8 @@ GL_APICALL GLuint GL_APIENTRY glCreateShader(GLenum type){
 
         auto& gl = ctx->dispatcher();
 
+        // The fields set here are part of the shader translation cache key,
+        // see sSaveResources() in ShaderTranslationCache.cpp.
         ANGLEShaderParser::BuiltinResourcesEditCallback editCallback = [&gl](ST_BuiltInResources& res) {
             gl.glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &res.MaxVertexAttribs);
             gl.glGetIntegerv(GL_MAX_VERTEX_UNIFORM_VECTORS, &res.MaxVertexUniformVectors);
@@ -3106,8 +3112,7 @@ GL_APICALL void  GL_APIENTRY glLinkProgram(GLuint program){
                 ShaderParser* vertSp = (ShaderParser*)vertObjData;
 
                 if(fragSp->getCompileStatus() && vertSp->getCompileStatus()) {
-                    ctx->dispatcher().glLinkProgram(globalProgramName);
-                    ctx->dispatcher().glGetProgramiv(globalProgramName,GL_LINK_STATUS,&linkStatus);
+                    linkStatus = programData->linkHostProgram(globalProgramName);
                     programData->setHostLinkStatus(linkStatus);
                     if (!programData->validateLink(fragSp, vertSp)) {
                         programData->setLinkStatus(GL_FALSE);
@@ -841,6 +841,12 @@ EXTERN_PART GL_APICALL void GL_APIENTRY glTransformFeedbackVaryings(GLuint progr
     if (ctx->shareGroup().get()) {
         const GLuint globalProgramName = ctx->shareGroup()->getGlobalName(NamedObjectType::SHADER_OR_PROGRAM, program);
         ctx->dispatcher().glTransformFeedbackVaryings(globalProgramName, count, varyings, bufferMode);
+        auto objData = ctx->shareGroup()->getObjectData(
+                NamedObjectType::SHADER_OR_PROGRAM, program);
+        if (objData && objData->getDataType() == PROGRAM_DATA) {
+            ((ProgramData*)objData)->setTransformFeedbackVaryings(
+                    count, varyings, bufferMode);
+        }
     }
 }
 
@@ -1021,6 +1027,13 @@ GL_APICALL void GL_APIENTRY glProgramParameteri(GLuint program, GLenum pname, GL
     if (ctx->shareGroup().get()) {
         const GLuint globalProgramName = ctx->shareGroup()->getGlobalName(NamedObjectType::SHADER_OR_PROGRAM, program);
         ctx->dispatcher().glProgramParameteri(globalProgramName, pname, value);
+        if (pname == GL_PROGRAM_SEPARABLE) {
+            auto objData = ctx->shareGroup()->getObjectData(
+                    NamedObjectType::SHADER_OR_PROGRAM, program);
+            if (objData && objData->getDataType() == PROGRAM_DATA) {
+                ((ProgramData*)objData)->setSeparable(value != GL_FALSE);
+            }
+        }
     }
 }
 
@@ -0,0 +1,202 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "ProgramBinaryCache.h"
+
+#include "GLcommon/GLDispatch.h"
+
+#include "android/base/files/MemStream.h"
+#include "android/base/memory/LazyInstance.h"
+#include "android/base/system/System.h"
+
+#include "emugl/common/logging.h"
+
+#include <memory>
+
+using android::base::AutoLock;
+using android::base::MemStream;
+using android::base::System;
+
+// Bump when the key or value format changes.
+static constexpr uint32_t kFormatVersion = 2;
+static constexpr size_t kMaxEntries = 4096;
+static constexpr uint64_t kStatsLogInterval = 64;
+
+static android::base::LazyInstance<std::unique_ptr<ProgramBinaryCache>>
+        sCache = LAZY_INSTANCE_INIT;
+static android::base::Lock sCacheInitLock;
+static bool sCacheInitialized = false;
+
+// static
+ProgramBinaryCache* ProgramBinaryCache::get() {
+    AutoLock lock(sCacheInitLock);
+    if (!sCacheInitialized) {
+        sCacheInitialized = true;
+        std::string dir = BlobFileCache::directoryFor("programs");
+        if (!dir.empty()) {
+            sCache->reset(new ProgramBinaryCache(std::move(dir)));
+        }
+    }
+    return sCache->get();
+}
+
+ProgramBinaryCache::ProgramBinaryCache(std::string dir)
+    : mFiles(std::move(dir), kMaxEntries) {}
+
+static std::string sGetString(GLDispatch& dispatcher, GLenum name) {
+    const GLubyte* str = dispatcher.glGetString(name);
+    return str ? (const char*)str : "";
+}
+
+bool ProgramBinaryCache::initDriverLocked(GLDispatch& dispatcher) {
+    if (mDriverChecked) {
+        return mDriverSupported;
+    }
+    mDriverChecked = true;
+    if (!dispatcher.glProgramBinary || !dispatcher.glGetProgramBinary ||
+        !dispatcher.glProgramParameteri) {
+        return false;
+    }
+    GLint numFormats = 0;
+    dispatcher.glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    // Drain the error if the query is not supported either.
+    dispatcher.glGetError();
+    if (numFormats <= 0) {
+        GL_LOG("Program binary cache disabled, the host has no binary formats");
+        return false;
+    }
+    mDriverId = sGetString(dispatcher, GL_VENDOR) + '\n' +
+                sGetString(dispatcher, GL_RENDERER) + '\n' +
+                sGetString(dispatcher, GL_VERSION);
+    mDriverSupported = true;
+    return true;
+}
+
+std::string ProgramBinaryCache::makeKey(const LinkInputs& inputs) const {
+    MemStream stream;
+    stream.putBe32(kFormatVersion);
+    stream.putString(mDriverId);
+    stream.putBe32(inputs.shaders.size());
+    for (const auto& shader : inputs.shaders) {
+        stream.putBe32(shader.first);
+        stream.putString(shader.second);
+    }
+    stream.putBe32(inputs.boundAttribLocations.size());
+    for (const auto& attrib : inputs.boundAttribLocations) {
+        stream.putString(attrib.first);
+        stream.putBe32(attrib.second);
+    }
+    stream.putBe32(inputs.transformFeedbackVaryings.size());
+    for (const auto& varying : inputs.transformFeedbackVaryings) {
+        stream.putString(varying);
+    }
+    stream.putBe32(inputs.transformFeedbackBufferMode);
+    stream.putByte(inputs.separable);
+    const auto& buffer = stream.buffer();
+    return std::string(buffer.data(), buffer.size());
+}
+
+GLint ProgramBinaryCache::link(GLDispatch& dispatcher,
+                               GLuint program,
+                               const LinkInputs& inputs) {
+    GLint linkStatus = GL_FALSE;
+    std::string key;
+    {
+        AutoLock lock(mLock);
+        if (!initDriverLocked(dispatcher)) {
+            lock.unlock();
+            dispatcher.glLinkProgram(program);
+            dispatcher.glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+            return linkStatus;
+        }
+        key = makeKey(inputs);
+    }
+
+    bool rejected = false;
+    if (auto value = mFiles.get(key)) {
+        MemStream stream(MemStream::Buffer(value->begin(), value->end()));
+        const GLenum format = stream.getBe32();
+        const uint64_t linkTimeUs = stream.getBe64();
+        const std::string binary = stream.getString();
+        dispatcher.glProgramBinary(program, format, binary.data(),
+                                   binary.size());
+        dispatcher.glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+        if (linkStatus == GL_TRUE) {
+            AutoLock lock(mLock);
+            onLinkLocked(true, false, linkTimeUs);
+            return linkStatus;
+        }
+        // The driver changed without changing its version strings, or
+        // doesn't know the format anymore; don't let the guest see the
+        // resulting error.
+        dispatcher.glGetError();
+        rejected = true;
+    }
+
+    dispatcher.glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                                   GL_TRUE);
+    const uint64_t startUs = System::get()->getHighResTimeUs();
+    dispatcher.glLinkProgram(program);
+    dispatcher.glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    const uint64_t linkTimeUs = System::get()->getHighResTimeUs() - startUs;
+
+    if (linkStatus == GL_TRUE) {
+        GLint length = 0;
+        dispatcher.glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length > 0) {
+            std::string binary(length, '\0');
+            GLsizei written = 0;
+            GLenum format = 0;
+            dispatcher.glGetProgramBinary(program, length, &written, &format,
+                                          &binary[0]);
+            if (written > 0) {
+                binary.resize(written);
+                MemStream stream;
+                stream.putBe32(format);
+                stream.putBe64(linkTimeUs);
+                stream.putString(binary);
+                const auto& buffer = stream.buffer();
+                mFiles.put(key, std::string(buffer.data(), buffer.size()));
+            }
+        }
+    }
+
+    AutoLock lock(mLock);
+    onLinkLocked(false, rejected, 0);
+    return linkStatus;
+}
+
+void ProgramBinaryCache::onLinkLocked(bool hit,
+                                      bool rejected,
+                                      uint64_t timeSavedUs) {
+    if (hit) {
+        ++mStats.hits;
+        mStats.timeSavedUs += timeSavedUs;
+    } else {
+        ++mStats.misses;
+    }
+    if (rejected) {
+        ++mStats.rejected;
+    }
+    const uint64_t links = mStats.hits + mStats.misses;
+    if (links % kStatsLogInterval == 0) {
+        GL_LOG("Program binary cache: %llu/%llu hits, %llu rejected, "
+               "%.1f ms saved",
+               (unsigned long long)mStats.hits, (unsigned long long)links,
+               (unsigned long long)mStats.rejected,
+               mStats.timeSavedUs / 1000.0);
+    }
+}
+
+ProgramBinaryCache::Stats ProgramBinaryCache::getStats() const {
+    AutoLock lock(mLock);
+    return mStats;
+}
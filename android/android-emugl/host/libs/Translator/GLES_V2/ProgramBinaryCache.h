@@ -0,0 +1,83 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#pragma once
+
+#include "BlobFileCache.h"
+
+#include "android/base/synchronization/Lock.h"
+
+#include <GLES3/gl3.h>
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+class GLDispatch;
+
+// ProgramBinaryCache keeps the host driver's program binaries of linked
+// guest programs on disk, so that linking the same program again, in this
+// or a later emulator session, loads the binary with glProgramBinary
+// instead of linking from source.
+//
+// Binaries are keyed on the host sources of the attached shaders, the
+// link-time state that affects the result, and the host GL vendor, renderer
+// and version strings, so that a driver update invalidates them. A binary
+// the driver still rejects falls back to a regular link, which replaces it.
+class ProgramBinaryCache {
+public:
+    // Everything set before glLinkProgram that the linked program depends
+    // on.
+    struct LinkInputs {
+        // Shader type and host source of each attached shader.
+        std::vector<std::pair<GLenum, std::string>> shaders;
+        std::map<std::string, GLuint> boundAttribLocations;
+        std::vector<std::string> transformFeedbackVaryings;
+        GLenum transformFeedbackBufferMode = 0;
+        // GL_PROGRAM_SEPARABLE.
+        bool separable = false;
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        // Binaries the driver did not accept.
+        uint64_t rejected = 0;
+        uint64_t timeSavedUs = 0;
+    };
+
+    // Returns nullptr if the cache is disabled, see
+    // BlobFileCache::directoryFor().
+    static ProgramBinaryCache* get();
+
+    explicit ProgramBinaryCache(std::string dir);
+
+    // Links the host |program| built from |inputs| and returns its
+    // GL_LINK_STATUS.
+    GLint link(GLDispatch& dispatcher, GLuint program, const LinkInputs& inputs);
+
+    Stats getStats() const;
+
+private:
+    // Returns false if the host can't save program binaries.
+    bool initDriverLocked(GLDispatch& dispatcher);
+    std::string makeKey(const LinkInputs& inputs) const;
+    void onLinkLocked(bool hit, bool rejected, uint64_t timeSavedUs);
+
+    BlobFileCache mFiles;
+    mutable android::base::Lock mLock;
+    bool mDriverChecked = false;
+    bool mDriverSupported = false;
+    std::string mDriverId;
+    Stats mStats;
+};
@@ -20,6 +20,7 @@
 #include "android/base/containers/Lookup.h"
 #include "android/base/files/StreamSerializing.h"
 #include "ANGLEShaderParser.h"
+#include "ProgramBinaryCache.h"
 #include "GLcommon/GLutils.h"
 #include "GLcommon/GLESmacros.h"
 #include "GLcommon/ShareGroup.h"
@@ -454,6 +455,9 @@ void ProgramData::restore(ObjectLocalName localName,
             dispatcher.glTransformFeedbackVaryings(
                     globalName, mTransformFeedbacks.size(), varyings.data(),
                     mTransformFeedbackBufferMode);
+            // The host keeps them for later links.
+            mPendingTransformFeedbacks = std::move(mTransformFeedbacks);
+            mPendingTransformFeedbackBufferMode = mTransformFeedbackBufferMode;
             mTransformFeedbacks.clear();
         }
         dispatcher.glLinkProgram(globalName);
@@ -729,6 +733,39 @@ void ProgramData::linkedAttribLocation(const std::string& var, GLuint loc) {
     linkedAttribLocs[var] = loc;
 }
 
+void ProgramData::setTransformFeedbackVaryings(GLsizei count,
+                                               const char* const* varyings,
+                                               GLenum bufferMode) {
+    mPendingTransformFeedbacks.assign(varyings, varyings + count);
+    mPendingTransformFeedbackBufferMode = bufferMode;
+}
+
+GLint ProgramData::linkHostProgram(GLuint globalName) {
+    GLDispatch& dispatcher = GLEScontext::dispatcher();
+    ProgramBinaryCache* cache = ProgramBinaryCache::get();
+    if (!cache) {
+        GLint linkStatus = GL_FALSE;
+        dispatcher.glLinkProgram(globalName);
+        dispatcher.glGetProgramiv(globalName, GL_LINK_STATUS, &linkStatus);
+        return linkStatus;
+    }
+
+    ProgramBinaryCache::LinkInputs inputs;
+    for (const auto& s : attachedShaders) {
+        if (s.localName) {
+            assert(s.shader);
+            inputs.shaders.emplace_back(s.shader->getType(),
+                                        s.shader->getCompiledSrc());
+        }
+    }
+    inputs.boundAttribLocations.insert(boundAttribLocs.begin(),
+                                       boundAttribLocs.end());
+    inputs.transformFeedbackVaryings = mPendingTransformFeedbacks;
+    inputs.transformFeedbackBufferMode = mPendingTransformFeedbackBufferMode;
+    inputs.separable = mSeparable;
+    return cache->link(dispatcher, globalName, inputs);
+}
+
 // Link-time validation
 void ProgramData::appendValidationErrMsg(std::ostringstream& ss) {
     validationInfoLog += "Error: " + ss.str() + "\n";
@@ -82,6 +82,19 @@ public:
     bool detachShader(GLuint shader);
     void bindAttribLocation(const std::string& var, GLuint loc);
     void linkedAttribLocation(const std::string& var, GLuint loc);
+    // Records the state set by glTransformFeedbackVaryings, which takes
+    // effect after glLinkProgram.
+    void setTransformFeedbackVaryings(GLsizei count,
+                                      const char* const* varyings,
+                                      GLenum bufferMode);
+
+    // Records GL_PROGRAM_SEPARABLE set with glProgramParameteri, which
+    // takes effect after glLinkProgram.
+    void setSeparable(bool separable) { mSeparable = separable; }
+
+    // Links the host program, from the program binary cache when the same
+    // program was linked before. Returns the host GL_LINK_STATUS.
+    GLint linkHostProgram(GLuint globalName);
 
     void appendValidationErrMsg(std::ostringstream& ss);
     bool validateLink(ShaderParser* frag, ShaderParser* vert);
@@ -141,6 +154,10 @@ private:
     std::unordered_map<GLuint, GLuint> mUniformBlockBinding;
     std::vector<std::string> mTransformFeedbacks;
     GLenum mTransformFeedbackBufferMode = 0;
+    // Set by the guest for the next glLinkProgram.
+    std::vector<std::string> mPendingTransformFeedbacks;
+    GLenum mPendingTransformFeedbackBufferMode = 0;
+    bool mSeparable = false;
 
     int mGlesMajorVersion = 2;
     int mGlesMinorVersion = 0;
@@ -0,0 +1,379 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "ShaderTranslationCache.h"
+
+#include "android/base/files/MemStream.h"
+#include "android/base/memory/LazyInstance.h"
+#include "android/version.h"
+
+#include "emugl/common/logging.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <string.h>
+
+using android::base::AutoLock;
+using android::base::MemStream;
+using android::base::Stream;
+
+namespace ANGLEShaderParser {
+
+// Bump when the file format or the translation inputs change.
+static constexpr uint32_t kFormatVersion = 2;
+static constexpr size_t kMaxEntries = 8192;
+static constexpr uint64_t kStatsLogInterval = 256;
+
+// Serialization of the translator's variables. Loaded variables are built
+// in memory owned here, then deep copied by the translator library, which
+// owns the copies ShaderLinkInfo holds.
+
+static void sSaveCString(Stream* stream, const char* str) {
+    stream->putByte(str != nullptr);
+    if (str) {
+        stream->putString(str);
+    }
+}
+
+struct LoadedCString {
+    bool valid = false;
+    std::string str;
+
+    void load(Stream* stream) {
+        valid = stream->getByte();
+        if (valid) {
+            str = stream->getString();
+        }
+    }
+    const char* get() const { return valid ? str.c_str() : nullptr; }
+};
+
+static void sSaveVariable(Stream* stream, const ST_ShaderVariable& var) {
+    stream->putBe32(var.type);
+    stream->putBe32(var.precision);
+    sSaveCString(stream, var.name);
+    sSaveCString(stream, var.mappedName);
+    sSaveCString(stream, var.structName);
+    stream->putByte(var.staticUse);
+    stream->putByte(var.isRowMajorLayout);
+    stream->putBe32(var.location);
+    stream->putBe32(var.binding);
+    stream->putBe32(var.arraySizeCount);
+    for (unsigned int i = 0; i < var.arraySizeCount; ++i) {
+        stream->putBe32(var.pArraySizes[i]);
+    }
+    stream->putBe32(var.fieldsCount);
+    for (unsigned int i = 0; i < var.fieldsCount; ++i) {
+        sSaveVariable(stream, var.pFields[i]);
+    }
+}
+
+struct LoadedVariable {
+    ST_ShaderVariable var;
+    LoadedCString name;
+    LoadedCString mappedName;
+    LoadedCString structName;
+    std::vector<unsigned int> arraySizes;
+    std::vector<LoadedVariable> fieldStorage;
+    std::vector<ST_ShaderVariable> fields;
+
+    // Loads in place: |var| points into the members.
+    void load(Stream* stream) {
+        memset(&var, 0, sizeof(var));
+        var.type = (decltype(var.type))stream->getBe32();
+        var.precision = (decltype(var.precision))stream->getBe32();
+        name.load(stream);
+        mappedName.load(stream);
+        structName.load(stream);
+        var.name = name.get();
+        var.mappedName = mappedName.get();
+        var.structName = structName.get();
+        var.staticUse = stream->getByte();
+        var.isRowMajorLayout = stream->getByte();
+        var.location = (int)stream->getBe32();
+        var.binding = (int)stream->getBe32();
+        arraySizes.resize(stream->getBe32());
+        for (auto& size : arraySizes) {
+            size = stream->getBe32();
+        }
+        var.arraySizeCount = arraySizes.size();
+        var.pArraySizes = (decltype(var.pArraySizes))arraySizes.data();
+        fieldStorage.resize(stream->getBe32());
+        for (auto& field : fieldStorage) {
+            field.load(stream);
+            fields.push_back(field.var);
+        }
+        var.fieldsCount = fields.size();
+        var.pFields = (decltype(var.pFields))fields.data();
+    }
+};
+
+static void sSaveInterfaceBlock(Stream* stream, const ST_InterfaceBlock& block) {
+    sSaveCString(stream, block.name);
+    sSaveCString(stream, block.mappedName);
+    sSaveCString(stream, block.instanceName);
+    stream->putBe32(block.layout);
+    stream->putByte(block.isRowMajorLayout);
+    stream->putBe32(block.fieldsCount);
+    for (unsigned int i = 0; i < block.fieldsCount; ++i) {
+        sSaveVariable(stream, block.pFields[i]);
+    }
+}
+
+struct LoadedInterfaceBlock {
+    ST_InterfaceBlock block;
+    LoadedCString name;
+    LoadedCString mappedName;
+    LoadedCString instanceName;
+    std::vector<LoadedVariable> fieldStorage;
+    std::vector<ST_ShaderVariable> fields;
+
+    void load(Stream* stream) {
+        memset(&block, 0, sizeof(block));
+        name.load(stream);
+        mappedName.load(stream);
+        instanceName.load(stream);
+        block.name = name.get();
+        block.mappedName = mappedName.get();
+        block.instanceName = instanceName.get();
+        block.layout = (decltype(block.layout))stream->getBe32();
+        block.isRowMajorLayout = stream->getByte();
+        fieldStorage.resize(stream->getBe32());
+        for (auto& field : fieldStorage) {
+            field.load(stream);
+            fields.push_back(field.var);
+        }
+        block.fieldsCount = fields.size();
+        block.pFields = (decltype(block.pFields))fields.data();
+    }
+};
+
+static void sSaveVariables(Stream* stream,
+                           const std::vector<ST_ShaderVariable>& vars) {
+    stream->putBe32(vars.size());
+    for (const auto& var : vars) {
+        sSaveVariable(stream, var);
+    }
+}
+
+static void sLoadVariables(Stream* stream,
+                           std::vector<ST_ShaderVariable>* vars) {
+    auto dispatch = getSTDispatch();
+    uint32_t count = stream->getBe32();
+    for (uint32_t i = 0; i < count; ++i) {
+        std::unique_ptr<LoadedVariable> loaded(new LoadedVariable);
+        loaded->load(stream);
+        vars->push_back(dispatch->copyVariable(&loaded->var));
+    }
+}
+
+static void sSaveStringMap(Stream* stream,
+                           const std::map<std::string, std::string>& map) {
+    stream->putBe32(map.size());
+    for (const auto& elt : map) {
+        stream->putString(elt.first);
+        stream->putString(elt.second);
+    }
+}
+
+static void sLoadStringMap(Stream* stream,
+                           std::map<std::string, std::string>* map) {
+    uint32_t count = stream->getBe32();
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string key = stream->getString();
+        (*map)[key] = stream->getString();
+    }
+}
+
+static void sSaveResult(Stream* stream,
+                        const ShaderTranslationCache::Result& result) {
+    stream->putByte(result.compileStatus);
+    stream->putString(result.infoLog);
+    stream->putString(result.objCode);
+    stream->putBe64(result.translateTimeUs);
+
+    const ShaderLinkInfo& info = result.linkInfo;
+    stream->putBe32(info.esslVersion);
+    sSaveVariables(stream, info.uniforms);
+    sSaveVariables(stream, info.varyings);
+    sSaveVariables(stream, info.attributes);
+    sSaveVariables(stream, info.outputVars);
+    stream->putBe32(info.interfaceBlocks.size());
+    for (const auto& block : info.interfaceBlocks) {
+        sSaveInterfaceBlock(stream, block);
+    }
+    sSaveStringMap(stream, info.nameMap);
+    sSaveStringMap(stream, info.nameMapReverse);
+}
+
+static void sLoadResult(Stream* stream,
+                        ShaderTranslationCache::Result* result) {
+    result->compileStatus = stream->getByte();
+    result->infoLog = stream->getString();
+    result->objCode = stream->getString();
+    result->translateTimeUs = stream->getBe64();
+
+    // Start from an empty ShaderLinkInfo, so that the translator's copies
+    // of any previous variables are released.
+    result->linkInfo = ShaderLinkInfo();
+    ShaderLinkInfo& info = result->linkInfo;
+    info.esslVersion = stream->getBe32();
+    sLoadVariables(stream, &info.uniforms);
+    sLoadVariables(stream, &info.varyings);
+    sLoadVariables(stream, &info.attributes);
+    sLoadVariables(stream, &info.outputVars);
+    auto dispatch = getSTDispatch();
+    uint32_t blockCount = stream->getBe32();
+    for (uint32_t i = 0; i < blockCount; ++i) {
+        std::unique_ptr<LoadedInterfaceBlock> loaded(new LoadedInterfaceBlock);
+        loaded->load(stream);
+        info.interfaceBlocks.push_back(
+                dispatch->copyInterfaceBlock(&loaded->block));
+    }
+    sLoadStringMap(stream, &info.nameMap);
+    sLoadStringMap(stream, &info.nameMapReverse);
+}
+
+static android::base::LazyInstance<std::unique_ptr<ShaderTranslationCache>>
+        sCache = LAZY_INSTANCE_INIT;
+static android::base::Lock sCacheInitLock;
+static bool sCacheInitialized = false;
+
+// static
+ShaderTranslationCache* ShaderTranslationCache::get() {
+    AutoLock lock(sCacheInitLock);
+    if (!sCacheInitialized) {
+        sCacheInitialized = true;
+        std::string dir = BlobFileCache::directoryFor("translations");
+        if (!dir.empty()) {
+            sCache->reset(new ShaderTranslationCache(std::move(dir)));
+        }
+    }
+    return sCache->get();
+}
+
+ShaderTranslationCache::ShaderTranslationCache(std::string dir)
+    : mFiles(std::move(dir), kMaxEntries) {}
+
+// Writes the resource limits that depend on the host GL, field by field:
+// the struct has padding and a hash function pointer, which differs between
+// runs. The other fields are translator defaults, covered by the build
+// version in the key. Keep in sync with the edit callback in GLESv2Imp.cpp.
+static void sSaveResources(Stream* stream,
+                           const ST_BuiltInResources& resources) {
+    stream->putBe32(resources.MaxVertexAttribs);
+    stream->putBe32(resources.MaxVertexUniformVectors);
+    stream->putBe32(resources.MaxVaryingVectors);
+    stream->putBe32(resources.MaxVertexTextureImageUnits);
+    stream->putBe32(resources.MaxCombinedTextureImageUnits);
+    stream->putBe32(resources.MaxTextureImageUnits);
+    stream->putBe32(resources.MaxFragmentUniformVectors);
+    stream->putBe32(resources.MaxDrawBuffers);
+    stream->putBe32(resources.FragmentPrecisionHigh);
+    stream->putBe32(resources.MaxVertexOutputVectors);
+    stream->putBe32(resources.MaxFragmentInputVectors);
+    stream->putBe32(resources.MinProgramTexelOffset);
+    stream->putBe32(resources.MaxProgramTexelOffset);
+    stream->putBe32(resources.MaxDualSourceDrawBuffers);
+    stream->putBe32(resources.OES_standard_derivatives);
+    stream->putBe32(resources.OES_EGL_image_external);
+    stream->putBe32(resources.EXT_gpu_shader5);
+    stream->putBe32(resources.EXT_shader_framebuffer_fetch);
+    stream->putBe32(resources.MaxProgramTextureGatherOffset);
+    stream->putBe32(resources.MinProgramTextureGatherOffset);
+    stream->putBe32(resources.MaxImageUnits);
+    stream->putBe32(resources.MaxComputeImageUniforms);
+    stream->putBe32(resources.MaxVertexImageUniforms);
+    stream->putBe32(resources.MaxFragmentImageUniforms);
+    stream->putBe32(resources.MaxCombinedImageUniforms);
+    stream->putBe32(resources.MaxCombinedShaderOutputResources);
+    stream->putBe32(resources.MaxUniformLocations);
+    stream->putBe32(resources.MaxComputeUniformComponents);
+    stream->putBe32(resources.MaxComputeTextureImageUnits);
+    stream->putBe32(resources.MaxComputeAtomicCounters);
+    stream->putBe32(resources.MaxComputeAtomicCounterBuffers);
+    stream->putBe32(resources.MaxVertexAtomicCounters);
+    stream->putBe32(resources.MaxFragmentAtomicCounters);
+    stream->putBe32(resources.MaxCombinedAtomicCounters);
+    stream->putBe32(resources.MaxAtomicCounterBindings);
+    stream->putBe32(resources.MaxVertexAtomicCounterBuffers);
+    stream->putBe32(resources.MaxFragmentAtomicCounterBuffers);
+    stream->putBe32(resources.MaxCombinedAtomicCounterBuffers);
+    stream->putBe32(resources.MaxAtomicCounterBufferSize);
+    stream->putBe32(resources.MaxUniformBufferBindings);
+    stream->putBe32(resources.MaxShaderStorageBufferBindings);
+    for (int i = 0; i < 3; ++i) {
+        stream->putBe32(resources.MaxComputeWorkGroupCount[i]);
+        stream->putBe32(resources.MaxComputeWorkGroupSize[i]);
+    }
+}
+
+// static
+std::string ShaderTranslationCache::makeKey(
+        bool hostUsesCoreProfile,
+        const char* src,
+        GLenum shaderType,
+        int esslVersion,
+        const ST_BuiltInResources& resources) {
+    MemStream stream;
+    stream.putBe32(kFormatVersion);
+    // The translator ships with the emulator, a new build may translate
+    // differently.
+    stream.putString(EMULATOR_FULL_VERSION_STRING "-" EMULATOR_CL_SHA1);
+    stream.putByte(hostUsesCoreProfile);
+    stream.putBe32(shaderType);
+    stream.putBe32(esslVersion);
+    sSaveResources(&stream, resources);
+    stream.putString(src);
+    const auto& buffer = stream.buffer();
+    return std::string(buffer.data(), buffer.size());
+}
+
+bool ShaderTranslationCache::lookup(const std::string& key, Result* out) {
+    bool found = false;
+    if (auto value = mFiles.get(key)) {
+        MemStream stream(MemStream::Buffer(value->begin(), value->end()));
+        sLoadResult(&stream, out);
+        found = true;
+    }
+
+    AutoLock lock(mLock);
+    if (found) {
+        ++mStats.hits;
+        mStats.timeSavedUs += out->translateTimeUs;
+    } else {
+        ++mStats.misses;
+    }
+    const uint64_t lookups = mStats.hits + mStats.misses;
+    if (lookups % kStatsLogInterval == 0) {
+        GL_LOG("Shader translation cache: %llu/%llu hits, %.1f ms saved",
+               (unsigned long long)mStats.hits, (unsigned long long)lookups,
+               mStats.timeSavedUs / 1000.0);
+    }
+    return found;
+}
+
+void ShaderTranslationCache::store(const std::string& key,
+                                   const Result& result) {
+    MemStream stream;
+    sSaveResult(&stream, result);
+    const auto& buffer = stream.buffer();
+    mFiles.put(key, std::string(buffer.data(), buffer.size()));
+}
+
+ShaderTranslationCache::Stats ShaderTranslationCache::getStats() const {
+    AutoLock lock(mLock);
+    return mStats;
+}
+
+} // namespace ANGLEShaderParser
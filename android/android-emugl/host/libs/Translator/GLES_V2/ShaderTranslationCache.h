@@ -0,0 +1,73 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#pragma once
+
+#include "ANGLEShaderParser.h"
+#include "BlobFileCache.h"
+
+#include "android/base/synchronization/Lock.h"
+
+#include <stdint.h>
+#include <string>
+
+namespace ANGLEShaderParser {
+
+// ShaderTranslationCache keeps the results of translating guest shaders on
+// disk, so that the system and app shaders every boot compiles skip the
+// shader translator after the first time any emulator instance on the host
+// saw them.
+//
+// Results are keyed on everything the translation depends on: source,
+// shader type, ESSL version, output profile, built-in resources and
+// translator build.
+class ShaderTranslationCache {
+public:
+    struct Result {
+        bool compileStatus = false;
+        std::string infoLog;
+        std::string objCode;
+        ShaderLinkInfo linkInfo;
+        // How long the translation took, reported as saved on each hit.
+        uint64_t translateTimeUs = 0;
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t timeSavedUs = 0;
+    };
+
+    // Returns nullptr if the cache is disabled, see
+    // BlobFileCache::directoryFor().
+    static ShaderTranslationCache* get();
+
+    explicit ShaderTranslationCache(std::string dir);
+
+    // Builds the key for translating |src|.
+    static std::string makeKey(bool hostUsesCoreProfile,
+                               const char* src,
+                               GLenum shaderType,
+                               int esslVersion,
+                               const ST_BuiltInResources& resources);
+
+    bool lookup(const std::string& key, Result* out);
+    void store(const std::string& key, const Result& result);
+
+    Stats getStats() const;
+
+private:
+    BlobFileCache mFiles;
+    mutable android::base::Lock mLock;
+    Stats mStats;
+};
+
+} // namespace ANGLEShaderParser
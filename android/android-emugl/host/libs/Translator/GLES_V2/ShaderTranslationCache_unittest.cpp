@@ -0,0 +1,168 @@
+// Copyright 2020 The Android Open Source Project
+//
+// This software is licensed under the terms of the GNU General Public
+// License version 2, as published by the Free Software Foundation, and
+// may be copied, distributed, and modified under those terms.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "ShaderTranslationCache.h"
+
+#include "android/base/system/System.h"
+#include "android/base/testing/TestTempDir.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+using android::base::System;
+using android::base::TestTempDir;
+
+namespace ANGLEShaderParser {
+
+static const char kUniformBlockShader[] = R"(#version 300 es
+precision mediump float;
+uniform Lights {
+    vec4 color;
+    mat4 transform;
+} lights;
+uniform sampler2D albedo;
+in vec2 texCoord;
+out vec4 fragColor;
+void main() {
+    vec4 coord = lights.transform * vec4(texCoord, 0.0, 1.0);
+    fragColor = lights.color * texture(albedo, coord.xy);
+}
+)";
+
+class ShaderTranslationCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        if (!getSTDispatch()) {
+            GTEST_SKIP() << "No shader translator library";
+        }
+        // The cache under test is a local one.
+        System::get()->envSet("ANDROID_EMUGL_DISABLE_SHADER_CACHE", "1");
+        static bool initialized =
+                globalInitialize(false, [](ST_BuiltInResources&) {});
+        ASSERT_TRUE(initialized);
+    }
+
+    ShaderTranslationCache::Result translateShader(const char* src) {
+        ShaderTranslationCache::Result result;
+        result.compileStatus =
+                translate(true, src, GL_FRAGMENT_SHADER, &result.infoLog,
+                          &result.objCode, &result.linkInfo);
+        return result;
+    }
+};
+
+static std::vector<std::string> sVariableNames(
+        const std::vector<ST_ShaderVariable>& vars) {
+    std::vector<std::string> names;
+    for (const auto& var : vars) {
+        names.push_back(var.name ? var.name : "");
+    }
+    return names;
+}
+
+static void sExpectSameBlocks(const std::vector<ST_InterfaceBlock>& expected,
+                              const std::vector<ST_InterfaceBlock>& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_STREQ(expected[i].name, actual[i].name);
+        EXPECT_STREQ(expected[i].mappedName, actual[i].mappedName);
+        EXPECT_STREQ(expected[i].instanceName, actual[i].instanceName);
+        EXPECT_EQ(expected[i].layout, actual[i].layout);
+        ASSERT_EQ(expected[i].fieldsCount, actual[i].fieldsCount);
+        for (unsigned int j = 0; j < expected[i].fieldsCount; ++j) {
+            EXPECT_STREQ(expected[i].pFields[j].name,
+                         actual[i].pFields[j].name);
+            EXPECT_EQ(expected[i].pFields[j].type, actual[i].pFields[j].type);
+        }
+    }
+}
+
+TEST_F(ShaderTranslationCacheTest, RoundTripUniformBlock) {
+    ShaderTranslationCache::Result translated =
+            translateShader(kUniformBlockShader);
+    ASSERT_TRUE(translated.compileStatus) << translated.infoLog;
+    ASSERT_EQ(1U, translated.linkInfo.interfaceBlocks.size());
+    EXPECT_STREQ("Lights", translated.linkInfo.interfaceBlocks[0].name);
+    EXPECT_EQ(2U, translated.linkInfo.interfaceBlocks[0].fieldsCount);
+
+    TestTempDir dir("shader-translation-cache");
+    ShaderTranslationCache cache(dir.path());
+    const std::string key = ShaderTranslationCache::makeKey(
+            true, kUniformBlockShader, GL_FRAGMENT_SHADER, 300, kResources);
+
+    ShaderTranslationCache::Result loaded;
+    EXPECT_FALSE(cache.lookup(key, &loaded));
+    cache.store(key, translated);
+    ASSERT_TRUE(cache.lookup(key, &loaded));
+
+    EXPECT_EQ(translated.compileStatus, loaded.compileStatus);
+    EXPECT_EQ(translated.infoLog, loaded.infoLog);
+    EXPECT_EQ(translated.objCode, loaded.objCode);
+
+    const ShaderLinkInfo& expected = translated.linkInfo;
+    const ShaderLinkInfo& actual = loaded.linkInfo;
+    EXPECT_EQ(expected.esslVersion, actual.esslVersion);
+    EXPECT_EQ(sVariableNames(expected.uniforms),
+              sVariableNames(actual.uniforms));
+    EXPECT_EQ(sVariableNames(expected.varyings),
+              sVariableNames(actual.varyings));
+    EXPECT_EQ(sVariableNames(expected.attributes),
+              sVariableNames(actual.attributes));
+    EXPECT_EQ(sVariableNames(expected.outputVars),
+              sVariableNames(actual.outputVars));
+    sExpectSameBlocks(expected.interfaceBlocks, actual.interfaceBlocks);
+    EXPECT_EQ(expected.nameMap, actual.nameMap);
+    EXPECT_EQ(expected.nameMapReverse, actual.nameMapReverse);
+
+    EXPECT_EQ(1U, cache.getStats().hits);
+    EXPECT_EQ(1U, cache.getStats().misses);
+}
+
+TEST_F(ShaderTranslationCacheTest, KeyDependsOnResourceValues) {
+    ST_BuiltInResources resources = kResources;
+    const std::string key = ShaderTranslationCache::makeKey(
+            true, kUniformBlockShader, GL_FRAGMENT_SHADER, 300, resources);
+
+    ST_BuiltInResources copy = resources;
+    EXPECT_EQ(key, ShaderTranslationCache::makeKey(true, kUniformBlockShader,
+                                                   GL_FRAGMENT_SHADER, 300,
+                                                   copy));
+
+    copy.MaxDrawBuffers = resources.MaxDrawBuffers + 1;
+    EXPECT_NE(key, ShaderTranslationCache::makeKey(true, kUniformBlockShader,
+                                                   GL_FRAGMENT_SHADER, 300,
+                                                   copy));
+}
+
+TEST_F(ShaderTranslationCacheTest, MoveLinkInfo) {
+    ShaderTranslationCache::Result translated =
+            translateShader(kUniformBlockShader);
+    ASSERT_TRUE(translated.compileStatus) << translated.infoLog;
+    const ShaderLinkInfo expected = translated.linkInfo;
+
+    // Moving over link info that holds variables releases those.
+    ShaderLinkInfo moved = translateShader(kUniformBlockShader).linkInfo;
+    moved = std::move(translated.linkInfo);
+    EXPECT_TRUE(translated.linkInfo.uniforms.empty());
+    EXPECT_TRUE(translated.linkInfo.interfaceBlocks.empty());
+    EXPECT_TRUE(translated.linkInfo.nameMap.empty());
+
+    EXPECT_EQ(expected.esslVersion, moved.esslVersion);
+    EXPECT_EQ(sVariableNames(expected.uniforms),
+              sVariableNames(moved.uniforms));
+    sExpectSameBlocks(expected.interfaceBlocks, moved.interfaceBlocks);
+    EXPECT_EQ(expected.nameMap, moved.nameMap);
+}
+
+}  // namespace ANGLEShaderParser
@@ -24,6 +24,8 @@
 #include <EGL/eglext.h>
 #include <GLES2/gl2.h>
 
+#include <algorithm>
+
 EGLContext s_context = EGL_NO_CONTEXT;
 EGLSurface s_surface = EGL_NO_SURFACE;
 
@@ -45,7 +47,14 @@ intptr_t GLBackgroundLoader::main() {
         }
     }
 
-    for (const auto& it : m_textureMap) {
+#if SNAPSHOT_PROFILE > 1
+    int restored = 0;
+#endif
+    int delayMs = 0;
+    int restoredOnDemand = 0;
+    uint64_t lastFrame = SaveableTexture::getCurrentFrame();
+
+    for (const SaveableTexturePtr& saveable : m_restoreOrder) {
         if (m_interrupted.load(std::memory_order_relaxed)) break;
 
         // Acquire the texture loader for each load; bail
@@ -55,31 +64,54 @@ intptr_t GLBackgroundLoader::main() {
             break;
         }
 
-        const SaveableTexturePtr& saveable = it.second;
-        if (saveable) {
-            m_glesIface.restoreTexture(saveable.get());
+        if (!saveable) {
+            continue;
+        }
+        if (!saveable->needRestore()) {
+            // A render thread needed it before us.
+            ++restoredOnDemand;
+            continue;
+        }
+        m_glesIface.restoreTexture(saveable.get());
+#if SNAPSHOT_PROFILE > 1
+        ++restored;
+#endif
+        ptr.reset();
+
+        // Back off while the guest renders, so the restores don't compete
+        // with it for the GPU, and catch up while it is idle.
+        const uint64_t frame = SaveableTexture::getCurrentFrame();
+        const int maxDelayMs = m_maxLoadDelayMs.load(std::memory_order_relaxed);
+        if (frame != lastFrame || restoredOnDemand) {
+            delayMs = std::min(std::max(delayMs * 2, 1), maxDelayMs);
+        } else {
+            delayMs = std::min(delayMs / 2, maxDelayMs);
+        }
+        lastFrame = frame;
+        restoredOnDemand = 0;
+        if (delayMs > 0) {
             // allow other threads to run for a while
-            ptr.reset();
-            android::base::System::get()->sleepMs(
-                m_loadDelayMs.load(std::memory_order_relaxed));
+            android::base::System::get()->sleepMs(delayMs);
         }
     }
 
+    m_restoreOrder.clear();
     m_textureMap.clear();
 
     m_eglIface.unbindAuxiliaryContext();
 
 #if SNAPSHOT_PROFILE > 1
     const auto end = get_uptime_ms();
-    printf("Finished GL background loading at %" PRIu64 " ms (%d ms total)\n",
-           end, int(end - start));
+    printf("Finished GL background loading at %" PRIu64 " ms (%d ms total), "
+           "%d textures restored in background\n",
+           end, int(end - start), restored);
 #endif
 
     return 0;
 }
 
 bool GLBackgroundLoader::wait(intptr_t* exitStatus) {
-    m_loadDelayMs.store(0, std::memory_order_relaxed);
+    m_maxLoadDelayMs.store(0, std::memory_order_relaxed);
     return Thread::wait();
 }
 
@@ -31,6 +31,8 @@ bool  GLESbuffer::setBuffer(GLuint size,GLuint usage,const GLvoid* data) {
         }
         m_conversionManager.clear();
         m_conversionManager.addRange(Range(0,m_size));
+        emugl::Mutex::AutoLock lock(m_conversionLock);
+        ++m_generation;
         return true;
     }
     return false;
@@ -41,6 +43,8 @@ bool  GLESbuffer::setSubBuffer(GLint offset,GLuint size,const GLvoid* data) {
     memcpy(m_data+offset,data,size);
     m_conversionManager.addRange(Range(offset,size));
     m_conversionManager.merge();
+    emugl::Mutex::AutoLock lock(m_conversionLock);
+    ++m_generation;
     return true;
 }
 
@@ -49,6 +53,69 @@ void  GLESbuffer::getConversions(const RangeList& rIn,RangeList& rOut) {
         rOut.merge();
 }
 
+// Arrays converted out of a buffer at once; more are rarely drawn from a
+// single buffer. A draw keeps its own references to the ones it uses, so
+// evicting them doesn't pull the data from under it.
+static constexpr size_t kMaxConversions = 4;
+
+static bool sameConversionKey(const GLESbuffer::ConversionKey& a,
+                              const GLESbuffer::ConversionKey& b) {
+    return a.type == b.type && a.size == b.size && a.stride == b.stride &&
+           a.offset == b.offset;
+}
+
+uint64_t GLESbuffer::generation() {
+    emugl::Mutex::AutoLock lock(m_conversionLock);
+    return m_generation;
+}
+
+GLESbuffer::ConversionData GLESbuffer::findConversion(
+        const ConversionKey& key,
+        GLsizei vertexCount) {
+    emugl::Mutex::AutoLock lock(m_conversionLock);
+    for (const auto& conversion : m_conversions) {
+        if (conversion.generation == m_generation &&
+            conversion.vertexCount >= vertexCount &&
+            sameConversionKey(conversion.key, key)) {
+            return conversion.data;
+        }
+    }
+    return nullptr;
+}
+
+void GLESbuffer::addConversion(const ConversionKey& key,
+                               GLsizei vertexCount,
+                               uint64_t generation,
+                               ConversionData data) {
+    emugl::Mutex::AutoLock lock(m_conversionLock);
+    if (generation != m_generation) {
+        // The buffer changed while converting.
+        return;
+    }
+    Conversion* slot = nullptr;
+    // Replace a stale or smaller conversion of the same array first.
+    for (auto& conversion : m_conversions) {
+        if (conversion.generation != m_generation ||
+            sameConversionKey(conversion.key, key)) {
+            slot = &conversion;
+            break;
+        }
+    }
+    if (!slot) {
+        if (m_conversions.size() < kMaxConversions) {
+            m_conversions.emplace_back();
+            slot = &m_conversions.back();
+        } else {
+            slot = &m_conversions[m_nextConversion];
+            m_nextConversion = (m_nextConversion + 1) % kMaxConversions;
+        }
+    }
+    slot->key = key;
+    slot->vertexCount = vertexCount;
+    slot->generation = generation;
+    slot->data = std::move(data);
+}
+
 GLESbuffer::~GLESbuffer() {
     if(m_data) {
         delete [] m_data;
@@ -0,0 +1,123 @@
+// Copyright 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <GLcommon/GLESbuffer.h>
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+GLESbuffer::ConversionKey byteKey(unsigned int offset) {
+    return {GL_BYTE, 3, 3, offset};
+}
+
+GLESbuffer::ConversionData makeData(size_t bytes, unsigned char value) {
+    return std::make_shared<std::vector<unsigned char>>(bytes, value);
+}
+
+}  // namespace
+
+TEST(GLESbuffer, ConversionRanges) {
+    GLESbuffer buffer;
+    std::vector<unsigned char> data(64);
+    ASSERT_TRUE(buffer.setBuffer(data.size(), GL_STATIC_DRAW, data.data()));
+    EXPECT_FALSE(buffer.fullyConverted());
+
+    // Only the parts not converted yet come out.
+    RangeList head;
+    head.addRange(Range(0, 16));
+    RangeList out;
+    buffer.getConversions(head, out);
+    ASSERT_EQ(1, out.size());
+    EXPECT_EQ(Range(0, 16), out[0]);
+
+    RangeList again;
+    buffer.getConversions(head, again);
+    EXPECT_EQ(0, again.size());
+
+    RangeList all;
+    all.addRange(Range(0, 64));
+    RangeList rest;
+    buffer.getConversions(all, rest);
+    ASSERT_EQ(1, rest.size());
+    EXPECT_EQ(Range(16, 48), rest[0]);
+    EXPECT_TRUE(buffer.fullyConverted());
+
+    // Updated data needs converting again.
+    EXPECT_TRUE(buffer.setSubBuffer(8, 8, data.data()));
+    EXPECT_FALSE(buffer.setSubBuffer(60, 8, data.data()));
+    RangeList updated;
+    buffer.getConversions(all, updated);
+    ASSERT_EQ(1, updated.size());
+    EXPECT_EQ(Range(8, 8), updated[0]);
+}
+
+TEST(GLESbuffer, ConversionCache) {
+    GLESbuffer buffer;
+    std::vector<unsigned char> data(300);
+    ASSERT_TRUE(buffer.setBuffer(data.size(), GL_STATIC_DRAW, data.data()));
+
+    EXPECT_EQ(nullptr, buffer.findConversion(byteKey(0), 10));
+
+    auto converted = makeData(10 * 3 * sizeof(GLshort), 1);
+    buffer.addConversion(byteKey(0), 10, buffer.generation(), converted);
+    EXPECT_EQ(converted, buffer.findConversion(byteKey(0), 10));
+    EXPECT_EQ(converted, buffer.findConversion(byteKey(0), 5));
+    // Not enough vertices, or another layout.
+    EXPECT_EQ(nullptr, buffer.findConversion(byteKey(0), 11));
+    EXPECT_EQ(nullptr, buffer.findConversion(byteKey(3), 10));
+    EXPECT_EQ(nullptr,
+              buffer.findConversion({GL_FIXED, 3, 12, 0}, 10));
+
+    // A conversion of data that changed meanwhile is dropped.
+    const uint64_t generation = buffer.generation();
+    EXPECT_TRUE(buffer.setSubBuffer(0, 3, data.data()));
+    EXPECT_NE(generation, buffer.generation());
+    EXPECT_EQ(nullptr, buffer.findConversion(byteKey(0), 10));
+    buffer.addConversion(byteKey(0), 10, generation, converted);
+    EXPECT_EQ(nullptr, buffer.findConversion(byteKey(0), 10));
+}
+
+// Test: a GLES1 draw can use more arrays converted out of one buffer than the
+// buffer keeps (vertex and texture coordinates of every unit); the ones it
+// got first must stay valid for it.
+TEST(GLESbuffer, ConversionEvictionKeepsDrawData) {
+    GLESbuffer buffer;
+    std::vector<unsigned char> data(300);
+    ASSERT_TRUE(buffer.setBuffer(data.size(), GL_STATIC_DRAW, data.data()));
+
+    const int kArrays = 5;
+    std::vector<GLESbuffer::ConversionData> draw;
+    for (int i = 0; i < kArrays; ++i) {
+        auto converted = makeData(16, (unsigned char)i);
+        buffer.addConversion(byteKey(i * 3), 4, buffer.generation(),
+                             converted);
+        draw.push_back(std::move(converted));
+    }
+
+    // The first one was evicted, the last ones are still there.
+    EXPECT_EQ(nullptr, buffer.findConversion(byteKey(0), 4));
+    for (int i = 1; i < kArrays; ++i) {
+        EXPECT_EQ(draw[i], buffer.findConversion(byteKey(i * 3), 4));
+    }
+
+    for (int i = 0; i < kArrays; ++i) {
+        EXPECT_EQ(std::vector<unsigned char>(16, (unsigned char)i),
+                  *draw[i]);
+    }
+    EXPECT_EQ(1, draw[0].use_count());
+}
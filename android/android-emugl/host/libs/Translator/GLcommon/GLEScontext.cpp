@@ -32,6 +32,7 @@
 #include <OpenglCodecCommon/ErrorLog.h>
 #include <GLcommon/GLESvalidate.h>
 #include <GLcommon/TextureUtils.h>
+#include <GLcommon/VertexConversion.h>
 #include <GLcommon/FramebufferData.h>
 #include <GLcommon/ScopedGLState.h>
 #ifndef _MSC_VER
@@ -39,13 +40,10 @@
 #endif
 #include <string.h>
 
+#include <algorithm>
 #include <numeric>
 
 //decleration
-static void convertFixedDirectLoop(const char* dataIn,unsigned int strideIn,void* dataOut,unsigned int nBytes,unsigned int strideOut,int attribSize);
-static void convertFixedIndirectLoop(const char* dataIn,unsigned int strideIn,void* dataOut,GLsizei count,GLenum indices_type,const GLvoid* indices,unsigned int strideOut,int attribSize);
-static void convertByteDirectLoop(const char* dataIn,unsigned int strideIn,void* dataOut,unsigned int nBytes,unsigned int strideOut,int attribSize);
-static void convertByteIndirectLoop(const char* dataIn,unsigned int strideIn,void* dataOut,GLsizei count,GLenum indices_type,const GLvoid* indices,unsigned int strideOut,int attribSize);
 
 void BufferBinding::onLoad(android::base::Stream* stream) {
     buffer = stream->getBe32();
@@ -151,6 +149,12 @@ void GLESConversionArrays::setArr(void* data,unsigned int stride,GLenum type){
    m_arrays[m_current].allocated = false;
 }
 
+void GLESConversionArrays::setArr(
+        std::shared_ptr<std::vector<unsigned char>> data,GLenum type){
+   setArr(data->data(),0,type);
+   m_sharedArrays.push_back(std::move(data));
+}
+
 void* GLESConversionArrays::getCurrentData(){
     return m_arrays[m_current].data;
 }
@@ -994,54 +998,6 @@ const GLESpointer* GLEScontext::getPointer(GLenum arrType) {
     return it != m_currVaoState.end() ? it->second : nullptr;
 }
 
-static void convertFixedDirectLoop(const char* dataIn,unsigned int strideIn,void* dataOut,unsigned int nBytes,unsigned int strideOut,int attribSize) {
-
-    for(unsigned int i = 0; i < nBytes;i+=strideOut) {
-        const GLfixed* fixed_data = (const GLfixed *)dataIn;
-        //filling attrib
-        for(int j=0;j<attribSize;j++) {
-            reinterpret_cast<GLfloat*>(&static_cast<unsigned char*>(dataOut)[i])[j] = X2F(fixed_data[j]);
-        }
-        dataIn += strideIn;
-    }
-}
-
-static void convertFixedIndirectLoop(const char* dataIn,unsigned int strideIn,void* dataOut,GLsizei count,GLenum indices_type,const GLvoid* indices,unsigned int strideOut,int attribSize) {
-    for(int i = 0 ;i < count ;i++) {
-        GLuint index = getIndex(indices_type, indices, i);
-
-        const GLfixed* fixed_data = (GLfixed *)(dataIn  + index*strideIn);
-        GLfloat* float_data = reinterpret_cast<GLfloat*>(static_cast<unsigned char*>(dataOut) + index*strideOut);
-
-        for(int j=0;j<attribSize;j++) {
-            float_data[j] = X2F(fixed_data[j]);
-         }
-    }
-}
-
-static void convertByteDirectLoop(const char* dataIn,unsigned int strideIn,void* dataOut,unsigned int nBytes,unsigned int strideOut,int attribSize) {
-
-    for(unsigned int i = 0; i < nBytes;i+=strideOut) {
-        const GLbyte* byte_data = (const GLbyte *)dataIn;
-        //filling attrib
-        for(int j=0;j<attribSize;j++) {
-            reinterpret_cast<GLshort*>(&static_cast<unsigned char*>(dataOut)[i])[j] = B2S(byte_data[j]);
-        }
-        dataIn += strideIn;
-    }
-}
-
-static void convertByteIndirectLoop(const char* dataIn,unsigned int strideIn,void* dataOut,GLsizei count,GLenum indices_type,const GLvoid* indices,unsigned int strideOut,int attribSize) {
-    for(int i = 0 ;i < count ;i++) {
-        GLuint index = getIndex(indices_type, indices, i);
-        const GLbyte* bytes_data = (GLbyte *)(dataIn  + index*strideIn);
-        GLshort* short_data = reinterpret_cast<GLshort*>(static_cast<unsigned char*>(dataOut) + index*strideOut);
-
-        for(int j=0;j<attribSize;j++) {
-            short_data[j] = B2S(bytes_data[j]);
-         }
-    }
-}
 static void directToBytesRanges(GLint first,GLsizei count,GLESpointer* p,RangeList& list) {
 
     int attribSize = p->getSize()*4; //4 is the sizeof GLfixed or GLfloat in bytes
@@ -1085,21 +1041,69 @@ int bytesRangesToIndices(RangeList& ranges,GLESpointer* p,GLuint* indices) {
     return n;
 }
 
+static unsigned int convertedTypeSize(GLenum type) {
+    return type == GL_FIXED ? sizeof(GLfloat) : sizeof(GLshort);
+}
+
+static void convertVertices(GLenum type, const char* in, unsigned int strideIn,
+                            char* out, int attribSize, GLsizei count) {
+    const unsigned int strideOut = attribSize * convertedTypeSize(type);
+    if (type == GL_FIXED) {
+        convertFixedToFloat(in, strideIn, out, strideOut, attribSize, count);
+    } else if (type == GL_BYTE) {
+        convertByteToShort(in, strideIn, out, strideOut, attribSize, count);
+    }
+}
+
+// Converts the first |vertexCount| vertices of an array sourced from a
+// buffer, reusing the conversion of an earlier draw when the buffer data
+// did not change since.
+static void convertBufferArray(GLESConversionArrays& cArrs, GLESpointer* p,
+                               unsigned int stride, GLsizei vertexCount) {
+    GLESbuffer* buffer = p->getBuffer();
+    const GLenum type = p->getType();
+    const int attribSize = p->getSize();
+    const GLESbuffer::ConversionKey key = {type, attribSize, (GLsizei)stride,
+                                           p->getBufferOffset()};
+    GLESbuffer::ConversionData converted =
+            buffer->findConversion(key, vertexCount);
+    if (!converted) {
+        const uint64_t generation = buffer->generation();
+        converted = std::make_shared<std::vector<unsigned char>>(
+                vertexCount * attribSize * convertedTypeSize(type));
+        convertVertices(type, (const char*)p->getArrayData(), stride,
+                        (char*)converted->data(), attribSize, vertexCount);
+        buffer->addConversion(key, vertexCount, generation, converted);
+    }
+    cArrs.setArr(std::move(converted), type == GL_FIXED ? GL_FLOAT : GL_SHORT);
+}
+
+static unsigned int findMinIndex(GLsizei count, GLenum type,
+                                 const GLvoid* indices) {
+    unsigned int min = count ? getIndex(type, indices, 0) : 0;
+    for (int i = 1; i < count; i++) {
+        min = std::min(min, getIndex(type, indices, i));
+    }
+    return min;
+}
+
 void GLEScontext::convertDirect(GLESConversionArrays& cArrs,GLint first,GLsizei count,GLenum array_id,GLESpointer* p) {
 
     GLenum type    = p->getType();
     int attribSize = p->getSize();
-    unsigned int size = attribSize*count + first;
     unsigned int bytes = type == GL_FIXED ? sizeof(GLfixed):sizeof(GLbyte);
-    cArrs.allocArr(size,type);
     int stride = p->getStride()?p->getStride():bytes*attribSize;
-    const char* data = (const char*)p->getArrayData() + (first*stride);
 
-    if(type == GL_FIXED) {
-        convertFixedDirectLoop(data,stride,cArrs.getCurrentData(),size*sizeof(GLfloat),attribSize*sizeof(GLfloat),attribSize);
-    } else if(type == GL_BYTE) {
-        convertByteDirectLoop(data,stride,cArrs.getCurrentData(),size*sizeof(GLshort),attribSize*sizeof(GLshort),attribSize);
+    // The converted array keeps the vertex indices of the draw.
+    if (p->getAttribType() == GLESpointer::BUFFER && p->getBuffer()) {
+        convertBufferArray(cArrs, p, stride, first + count);
+        return;
     }
+    cArrs.allocArr(attribSize * (first + count), type);
+    const char* data = (const char*)p->getArrayData() + (first*stride);
+    char* out = (char*)cArrs.getCurrentData() +
+                first * attribSize * convertedTypeSize(type);
+    convertVertices(type, data, stride, out, attribSize, count);
 }
 
 void GLEScontext::convertDirectVBO(GLESConversionArrays& cArrs,GLint first,GLsizei count,GLenum array_id,GLESpointer* p) {
@@ -1118,7 +1122,7 @@ void GLEScontext::convertDirectVBO(GLESConversionArrays& cArrs,GLint first,GLsiz
         if(conversions.size()) { // there are some elements to convert
            indices = new GLuint[count];
            int nIndices = bytesRangesToIndices(conversions,p,indices); //converting bytes ranges by offset to indices in this array
-           convertFixedIndirectLoop(data,stride,data,nIndices,GL_UNSIGNED_INT,indices,stride,attribSize);
+           convertFixedToFloatIndexed(data,stride,data,stride,attribSize,GL_UNSIGNED_INT,indices,nIndices);
         }
     }
     if(indices) delete[] indices;
@@ -1152,16 +1156,32 @@ void GLEScontext::convertIndirect(GLESConversionArrays& cArrs,GLsizei count,GLen
     int maxElements = findMaxIndex(count,indices_type,indices) + 1;
 
     int attribSize = p->getSize();
-    int size = attribSize * maxElements;
     unsigned int bytes = type == GL_FIXED ? sizeof(GLfixed):sizeof(GLbyte);
-    cArrs.allocArr(size,type);
     int stride = p->getStride()?p->getStride():bytes*attribSize;
 
+    if (p->getAttribType() == GLESpointer::BUFFER && p->getBuffer()) {
+        convertBufferArray(cArrs, p, stride, maxElements);
+        return;
+    }
+    int size = attribSize * maxElements;
+    cArrs.allocArr(size,type);
+
     const char* data = (const char*)p->getArrayData();
-    if(type == GL_FIXED) {
-        convertFixedIndirectLoop(data,stride,cArrs.getCurrentData(),count,indices_type,indices,attribSize*sizeof(GLfloat),attribSize);
+    char* out = (char*)cArrs.getCurrentData();
+    const unsigned int strideOut = attribSize * convertedTypeSize(type);
+    // Meshes reference most vertices several times: unless the indices are
+    // sparse, convert the range they span once, which also vectorizes.
+    const int minElement = findMinIndex(count, indices_type, indices);
+    if (maxElements - minElement <= count) {
+        convertVertices(type, data + minElement * stride, stride,
+                        out + minElement * strideOut, attribSize,
+                        maxElements - minElement);
+    } else if(type == GL_FIXED) {
+        convertFixedToFloatIndexed(data, stride, out, strideOut, attribSize,
+                                   indices_type, indices, count);
     } else if(type == GL_BYTE){
-        convertByteIndirectLoop(data,stride,cArrs.getCurrentData(),count,indices_type,indices,attribSize*sizeof(GLshort),attribSize);
+        convertByteToShortIndexed(data, stride, out, strideOut, attribSize,
+                                  indices_type, indices, count);
     }
 }
 
@@ -1178,7 +1198,7 @@ void GLEScontext::convertIndirectVBO(GLESConversionArrays& cArrs,GLsizei count,G
         if(conversions.size()) { // there are some elements to convert
             conversionIndices = new GLuint[count];
             int nIndices = bytesRangesToIndices(conversions,p,conversionIndices); //converting bytes ranges by offset to indices in this array
-            convertFixedIndirectLoop(data,stride,data,nIndices,GL_UNSIGNED_INT,conversionIndices,stride,attribSize);
+            convertFixedToFloatIndexed(data,stride,data,stride,attribSize,GL_UNSIGNED_INT,conversionIndices,nIndices);
         }
     }
     if(conversionIndices) delete[] conversionIndices;
@@ -2008,6 +2028,26 @@ ObjectLocalName GLEScontext::getTextureLocalName(GLenum target,
     return (tex!=0? tex : getDefaultTextureName(target));
 }
 
+void GLEScontext::markBoundTexturesUsed() {
+    const uint64_t frame = SaveableTexture::getCurrentFrame();
+    if (frame == m_texUsageFrame || !m_texState || !m_shareGroup) return;
+    m_texUsageFrame = frame;
+
+    for (unsigned int i = 0; i <= m_maxUsedTexUnit; i++) {
+        for (unsigned int j = 0; j < NUM_TEXTURE_TARGETS; j++) {
+            const GLuint tex = m_texState[i][j].texture;
+            if (!tex) continue;
+            TextureData* texData = (TextureData*)m_shareGroup->getObjectData(
+                    NamedObjectType::TEXTURE, tex);
+            if (!texData) continue;
+            if (const SaveableTexturePtr& saveable =
+                        texData->getSaveableTexture()) {
+                saveable->markUsed();
+            }
+        }
+    }
+}
+
 void GLEScontext::drawValidate(void)
 {
     if(m_drawFramebuffer == 0)
@@ -27,6 +27,9 @@
 #include "GLcommon/GLEScontext.h"
 #include "GLcommon/TranslatorIfaces.h"
 
+#include <algorithm>
+#include <vector>
+
 #include <assert.h>
 
 using android::snapshot::ITextureSaver;
@@ -353,16 +356,29 @@ void GlobalNameSpace::onSave(android::base::Stream* stream,
     int cleanTexs = 0;
     int dirtyTexs = 0;
 #endif // SNAPSHOT_PROFILE > 1
+    // Save the textures used most recently first, so that the background
+    // loader restores them first on load.
+    std::vector<std::pair<unsigned int, SaveableTexturePtr>> textures(
+            m_textureMap.begin(), m_textureMap.end());
+    std::stable_sort(
+            textures.begin(), textures.end(),
+            [](const std::pair<unsigned int, SaveableTexturePtr>& a,
+               const std::pair<unsigned int, SaveableTexturePtr>& b) {
+                const uint64_t aFrame =
+                        a.second ? a.second->getLastUsedFrame() : 0;
+                const uint64_t bFrame =
+                        b.second ? b.second->getLastUsedFrame() : 0;
+                return aFrame > bFrame;
+            });
     saveCollection(
-            stream, m_textureMap,
+            stream, textures,
             [saver, &textureSaver
 #if SNAPSHOT_PROFILE > 1
             , &cleanTexs, &dirtyTexs
 #endif // SNAPSHOT_PROFILE > 1
                 ](
                     android::base::Stream* stream,
-                    const std::pair<const unsigned int, SaveableTexturePtr>&
-                            tex) {
+                    const std::pair<unsigned int, SaveableTexturePtr>& tex) {
                 stream->putBe32(tex.first);
 #if SNAPSHOT_PROFILE > 1
                 if (tex.second.get() && tex.second->isDirty()) {
@@ -398,9 +414,12 @@ void GlobalNameSpace::onLoad(android::base::Stream* stream,
                 "Error: texture file unsupported version or corrupted.\n");
         return;
     }
+    // Textures are saved in the order they should be restored in.
+    std::vector<SaveableTexturePtr> restoreOrder;
     loadCollection(
             stream, &m_textureMap,
-            [this, creator, textureLoaderWPtr](android::base::Stream* stream) {
+            [this, creator, textureLoaderWPtr,
+             &restoreOrder](android::base::Stream* stream) {
                 unsigned int globalName = stream->getBe32();
                 // A lot of function wrapping happens here.
                 // When touched, saveableTexture triggers
@@ -419,14 +438,38 @@ void GlobalNameSpace::onLoad(android::base::Stream* stream,
                                         saveableTexture->loadFromStream(stream);
                                     });
                         });
-                return std::make_pair(globalName,
-                                      SaveableTexturePtr(saveableTexture));
+                restoreOrder.emplace_back(saveableTexture);
+                return std::make_pair(globalName, restoreOrder.back());
             });
 
     m_backgroundLoader =
         std::make_shared<GLBackgroundLoader>(
-            textureLoaderWPtr, *m_eglIface, *m_glesIface, m_textureMap);
+            textureLoaderWPtr, *m_eglIface, *m_glesIface, m_textureMap,
+            std::move(restoreOrder));
     textureLoader->acquireLoaderThread(m_backgroundLoader);
+
+    {
+        emugl::Mutex::AutoLock lock(m_lock);
+        m_firstFrameLoaderWPtr = textureLoaderWPtr;
+    }
+    m_firstFramePending.store(true, std::memory_order_release);
+}
+
+void GlobalNameSpace::onFrame() {
+    SaveableTexture::advanceFrame();
+    if (!m_firstFramePending.load(std::memory_order_acquire) ||
+        !m_firstFramePending.exchange(false)) {
+        return;
+    }
+    ITextureLoaderPtr textureLoader;
+    {
+        emugl::Mutex::AutoLock lock(m_lock);
+        textureLoader = m_firstFrameLoaderWPtr.lock();
+        m_firstFrameLoaderWPtr.reset();
+    }
+    if (textureLoader) {
+        textureLoader->onFirstFrame();
+    }
 }
 
 void GlobalNameSpace::clearTextureMap() {
@@ -18,6 +18,8 @@
 
 #include "android/base/ArraySize.h"
 #include "android/base/containers/SmallVector.h"
+#include "android/base/files/BufferedStream.h"
+#include "android/base/files/MappedFileStream.h"
 #include "android/base/files/StreamSerializing.h"
 #include "android/base/memory/LazyInstance.h"
 #include "android/base/Profiler.h"
@@ -527,12 +529,16 @@ void SaveableTexture::loadFromStream(android::base::Stream* stream) {
     m_border = stream->getBe32();
     m_texStorageLevels = stream->getBe32();
     m_maxMipmapLevel = stream->getBe32();
+    // Uncompressed texture files are mapped; their levels are uploaded
+    // straight from the mapping, which only stays valid during the load.
+    const auto mapping =
+            dynamic_cast<android::base::MappedFileStream*>(stream);
     // TODO: handle other texture targets
     if (m_target == GL_TEXTURE_2D || m_target == GL_TEXTURE_CUBE_MAP ||
         m_target == GL_TEXTURE_3D || m_target == GL_TEXTURE_2D_ARRAY) {
         unsigned int numLevels = m_texStorageLevels ? m_texStorageLevels :
                 m_maxMipmapLevel + 1;
-        auto loadTex = [stream, numLevels](
+        auto loadTex = [stream, mapping, numLevels](
                                std::unique_ptr<LevelImageData[]>& levelData,
                                bool isDepth) {
             levelData.reset(new LevelImageData[numLevels]);
@@ -542,7 +548,13 @@ void SaveableTexture::loadFromStream(android::base::Stream* stream) {
                 if (isDepth) {
                     levelData[level].m_depth = stream->getBe32();
                 }
-                loadBuffer(stream, &levelData[level].m_data);
+                if (mapping) {
+                    const uint32_t size = mapping->getBe32();
+                    levelData[level].m_mappedData =
+                            size ? mapping->readInPlace(size) : nullptr;
+                } else {
+                    loadBuffer(stream, &levelData[level].m_data);
+                }
             }
         };
         switch (m_target) {
@@ -574,10 +586,22 @@ void SaveableTexture::loadFromStream(android::base::Stream* stream) {
         fprintf(stderr, "Warning: texture target %d not supported\n", m_target);
     }
     m_loadedFromStream.store(true);
+    if (mapping) {
+        upload();
+        // The level data goes away with the mapping; later saves read the
+        // texture back instead.
+        for (auto& levelData : m_levelData) {
+            levelData.reset();
+        }
+        m_isDirty = true;
+    }
 }
 
 void SaveableTexture::onSave(
-        android::base::Stream* stream) {
+        android::base::Stream* output) {
+    // Most of the state is written field by field.
+    android::base::BufferedStream bufferedStream(output);
+    android::base::Stream* const stream = &bufferedStream;
     stream->putBe32(m_target);
     stream->putBe32(m_width);
     stream->putBe32(m_height);
@@ -834,10 +858,14 @@ void SaveableTexture::restore() {
     assert(m_loader);
     m_loader(this);
 
-    if (!m_loadedFromStream.load()) {
+    // Levels read in place from a file mapping are uploaded during the load.
+    if (!m_loadedFromStream.load() || m_globalTexObj) {
         return;
     }
+    upload();
+}
 
+void SaveableTexture::upload() {
     m_globalTexObj.reset(new NamedObject(
             GenNameInfo(NamedObjectType::TEXTURE), m_globalNamespace));
     if (!m_globalTexObj) {
@@ -935,10 +963,7 @@ void SaveableTexture::restore() {
                         GLenum target,
                         std::unique_ptr<LevelImageData[]>& levelData) {
                     for (unsigned int level = 0; level < numLevels; level++) {
-                        const void* pixels =
-                                levelData[level].m_data.empty()
-                                        ? nullptr
-                                        : levelData[level].m_data.data();
+                        const void* pixels = levelData[level].pixels();
                         if (!level || pixels) {
                             if (m_texStorageLevels) {
                                 dispatcher.glTexSubImage2D(
@@ -962,10 +987,7 @@ void SaveableTexture::restore() {
                         GLenum target,
                         std::unique_ptr<LevelImageData[]>& levelData) {
                     for (unsigned int level = 0; level < numLevels; level++) {
-                        const void* pixels =
-                                levelData[level].m_data.empty()
-                                        ? nullptr
-                                        : levelData[level].m_data.data();
+                        const void* pixels = levelData[level].pixels();
                         if (!level || pixels) {
                             if (m_texStorageLevels) {
                                 dispatcher.glTexSubImage3D(
@@ -1073,6 +1095,25 @@ void SaveableTexture::setMipmapLevelAtLeast(unsigned int level) {
     m_maxMipmapLevel = std::max(level, m_maxMipmapLevel);
 }
 
+static std::atomic<uint64_t> sCurrentFrame { 0 };
+
+void SaveableTexture::markUsed() {
+    m_lastUsedFrame.store(sCurrentFrame.load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+}
+
+uint64_t SaveableTexture::getLastUsedFrame() const {
+    return m_lastUsedFrame.load(std::memory_order_relaxed);
+}
+
+void SaveableTexture::advanceFrame() {
+    sCurrentFrame.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t SaveableTexture::getCurrentFrame() {
+    return sCurrentFrame.load(std::memory_order_relaxed);
+}
+
 unsigned int SaveableTexture::getGlobalName() {
     if (m_globalTexObj) {
         return m_globalTexObj->getGlobalName();
@@ -29,12 +29,20 @@ static constexpr int toIndex(NamedObjectType type) {
     return static_cast<int>(type);
 }
 
-struct ShareGroup::ObjectDataAutoLock {
-    ObjectDataAutoLock(ShareGroup* self) : self(self) {
-        self->lockObjectData();
+using android::base::AutoReadLock;
+using android::base::AutoWriteLock;
+
+// Always locks in type order, so it can't deadlock against another one.
+struct ShareGroup::AllNameSpacesAutoLock {
+    AllNameSpacesAutoLock(ShareGroup* self) : self(self) {
+        for (auto& nsLock : self->m_nameSpaceLocks) {
+            nsLock.lock.lockWrite();
+        }
     }
-    ~ObjectDataAutoLock() {
-        self->unlockObjectData();
+    ~AllNameSpacesAutoLock() {
+        for (auto& nsLock : self->m_nameSpaceLocks) {
+            nsLock.lock.unlockWrite();
+        }
     }
 
     ShareGroup* self;
@@ -45,7 +53,7 @@ ShareGroup::ShareGroup(GlobalNameSpace *globalNameSpace,
                        android::base::Stream* stream,
                        const ObjectData::loadObject_t& loadObject) :
                        m_sharedGroupID(sharedGroupID) {
-    ObjectDataAutoLock lock(this);
+    // No other thread can see the share group yet, no need to lock.
     for (int i = 0; i < toIndex(NamedObjectType::NUM_OBJECT_TYPES);
          i++) {
         m_nameSpace[i] = new NameSpace(static_cast<NamedObjectType>(i),
@@ -67,7 +75,7 @@ ShareGroup::ShareGroup(GlobalNameSpace *globalNameSpace,
 }
 
 void ShareGroup::preSave(GlobalNameSpace *globalNameSpace) {
-    ObjectDataAutoLock lock(this);
+    AllNameSpacesAutoLock lock(this);
     if (m_saveStage == PreSaved) return;
     assert(m_saveStage == Empty);
     m_saveStage = PreSaved;
@@ -76,7 +84,7 @@ void ShareGroup::preSave(GlobalNameSpace *globalNameSpace) {
 
 void ShareGroup::onSave(android::base::Stream* stream) {
     // we do not save m_nameSpace
-    ObjectDataAutoLock lock(this);
+    AllNameSpacesAutoLock lock(this);
     if (m_saveStage == Saved) return;
     assert(m_saveStage == PreSaved);
     m_saveStage = Saved;
@@ -124,21 +132,10 @@ bool ShareGroup::needRestore() {
     return m_needLoadRestore;
 }
 
-void ShareGroup::lockObjectData() {
-    while (m_objectsDataLock.test_and_set(std::memory_order_acquire)) {
-        ;
-    }
-}
-
-void ShareGroup::unlockObjectData() {
-    m_objectsDataLock.clear(std::memory_order_release);
-}
-
 ShareGroup::~ShareGroup()
 {
     {
-        emugl::Mutex::AutoLock lock(m_namespaceLock);
-        ObjectDataAutoLock objDataLock(this);
+        AllNameSpacesAutoLock lock(this);
         for (auto n : m_nameSpace) {
             delete n;
         }
@@ -156,7 +153,7 @@ ShareGroup::genName(GenNameInfo genNameInfo,
         return 0;
     }
 
-    emugl::Mutex::AutoLock lock(m_namespaceLock);
+    AutoWriteLock lock(nameSpaceLock(genNameInfo.m_type));
     ObjectLocalName localName =
             m_nameSpace[toIndex(genNameInfo.m_type)]->genName(
                                                     genNameInfo,
@@ -185,7 +182,7 @@ ShareGroup::getGlobalName(NamedObjectType p_type,
     if (toIndex(p_type) >= toIndex(NamedObjectType::NUM_OBJECT_TYPES)) {
         return 0;
     }
-    emugl::Mutex::AutoLock lock(m_namespaceLock);
+    AutoReadLock lock(nameSpaceLock(p_type));
     return m_nameSpace[toIndex(p_type)]->getGlobalName(p_localName);
 }
 
@@ -198,7 +195,7 @@ ShareGroup::getLocalName(NamedObjectType p_type,
         return 0;
     }
 
-    emugl::Mutex::AutoLock lock(m_namespaceLock);
+    AutoReadLock lock(nameSpaceLock(p_type));
     return m_nameSpace[toIndex(p_type)]->getLocalName(p_globalName);
 }
 
@@ -209,7 +206,7 @@ NamedObjectPtr ShareGroup::getNamedObject(NamedObjectType p_type,
         return 0;
     }
 
-    emugl::Mutex::AutoLock lock(m_namespaceLock);
+    AutoReadLock lock(nameSpaceLock(p_type));
     return m_nameSpace[toIndex(p_type)]->getNamedObject(p_localName);
 }
 
@@ -221,8 +218,7 @@ ShareGroup::deleteName(NamedObjectType p_type, ObjectLocalName p_localName)
         return;
     }
 
-    emugl::Mutex::AutoLock lock(m_namespaceLock);
-    ObjectDataAutoLock objDataLock(this);
+    AutoWriteLock lock(nameSpaceLock(p_type));
     m_nameSpace[toIndex(p_type)]->deleteName(p_localName);
 }
 
@@ -234,7 +230,7 @@ ShareGroup::isObject(NamedObjectType p_type, ObjectLocalName p_localName)
         return 0;
     }
 
-    emugl::Mutex::AutoLock lock(m_namespaceLock);
+    AutoReadLock lock(nameSpaceLock(p_type));
     return m_nameSpace[toIndex(p_type)]->isObject(p_localName);
 }
 
@@ -248,7 +244,7 @@ ShareGroup::replaceGlobalObject(NamedObjectType p_type,
         return;
     }
 
-    emugl::Mutex::AutoLock lock(m_namespaceLock);
+    AutoWriteLock lock(nameSpaceLock(p_type));
     m_nameSpace[toIndex(p_type)]->replaceGlobalObject(p_localName,
                                                                p_globalObject);
 }
@@ -263,7 +259,7 @@ ShareGroup::setGlobalObject(NamedObjectType p_type,
         return;
     }
 
-    emugl::Mutex::AutoLock lock(m_namespaceLock);
+    AutoWriteLock lock(nameSpaceLock(p_type));
     m_nameSpace[toIndex(p_type)]->setGlobalObject(p_localName,
                                                   p_globalObject);
 }
@@ -272,19 +268,11 @@ void
 ShareGroup::setObjectData(NamedObjectType p_type,
                           ObjectLocalName p_localName,
                           ObjectDataPtr data) {
-    ObjectDataAutoLock lock(this);
-    setObjectDataLocked(p_type, p_localName, std::move(data));
-}
-
-void
-ShareGroup::setObjectDataLocked(NamedObjectType p_type,
-                          ObjectLocalName p_localName,
-                          ObjectDataPtr&& data)
-{
     assert(p_type != NamedObjectType::FRAMEBUFFER);
     if (toIndex(p_type) >= toIndex(NamedObjectType::NUM_OBJECT_TYPES)) {
         return;
     }
+    AutoWriteLock lock(nameSpaceLock(p_type));
     m_nameSpace[toIndex(p_type)]->setObjectData(p_localName, data);
 }
 
@@ -300,7 +288,7 @@ ObjectData* ShareGroup::getObjectData(NamedObjectType p_type,
         toIndex(NamedObjectType::NUM_OBJECT_TYPES))
         return nullptr;
 
-    ObjectDataAutoLock lock(this);
+    AutoReadLock lock(nameSpaceLock(p_type));
     return getObjectDataPtrNoLock(p_type, p_localName).get();
 }
 
@@ -311,7 +299,7 @@ ObjectDataPtr ShareGroup::getObjectDataPtr(NamedObjectType p_type,
         toIndex(NamedObjectType::NUM_OBJECT_TYPES))
         return {};
 
-    ObjectDataAutoLock lock(this);
+    AutoReadLock lock(nameSpaceLock(p_type));
     return getObjectDataPtrNoLock(p_type, p_localName);
 }
 
@@ -319,12 +307,23 @@ ObjectDataPtr ShareGroup::getObjectDataPtr(NamedObjectType p_type,
 #define CC_UNLIKELY( exp )  (__builtin_expect( !!(exp), false ))
 
 unsigned int ShareGroup::ensureObjectOnBind(NamedObjectType p_type, ObjectLocalName p_localName) {
-    emugl::Mutex::AutoLock lock(m_namespaceLock);
-
     auto ns = m_nameSpace[toIndex(p_type)];
 
     bool isObj;
-    unsigned int globalName = ns->getGlobalName(p_localName, &isObj);
+    unsigned int globalName;
+    {
+        // Binding an object that was bound before is by far the most common
+        // case, and only needs to read the namespace.
+        AutoReadLock lock(nameSpaceLock(p_type));
+        globalName = ns->getGlobalName(p_localName, &isObj);
+        if (CC_LIKELY(isObj && ns->everBound(p_localName))) {
+            return globalName;
+        }
+    }
+
+    AutoWriteLock lock(nameSpaceLock(p_type));
+    // Another thread may have bound or created it since.
+    globalName = ns->getGlobalName(p_localName, &isObj);
 
     if (CC_LIKELY(isObj)) {
         bool everBound = ns->everBound(p_localName);
@@ -0,0 +1,231 @@
+// Copyright 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <GLcommon/ShareGroup.h>
+
+#include <GLcommon/GLEScontext.h>
+#include <GLcommon/GLESbuffer.h>
+#include <GLcommon/GLLibrary.h>
+#include <GLcommon/ObjectNameSpace.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Names for the objects, without a host GL.
+std::atomic<GLuint> sNextGlobalName{1};
+
+void GL_APIENTRY fakeGenNames(GLsizei n, GLuint* names) {
+    for (GLsizei i = 0; i < n; ++i) {
+        names[i] = sNextGlobalName++;
+    }
+}
+
+void GL_APIENTRY fakeDeleteNames(GLsizei, const GLuint*) {}
+
+class TestObjectData : public ObjectData {
+public:
+    void onSave(android::base::Stream*, unsigned int) const override {}
+    void restore(ObjectLocalName, const getGlobalName_t&) override {}
+};
+
+class FakeGlLibrary : public GlLibrary {
+public:
+    GlFunctionPointer findSymbol(const char* name) override {
+        if (!strcmp(name, "glGenBuffers") || !strcmp(name, "glGenTextures")) {
+            return (GlFunctionPointer)fakeGenNames;
+        }
+        if (!strcmp(name, "glDeleteBuffers") ||
+            !strcmp(name, "glDeleteTextures")) {
+            return (GlFunctionPointer)fakeDeleteNames;
+        }
+        return nullptr;
+    }
+};
+
+class ShareGroupTest : public ::testing::Test {
+protected:
+    static void SetUpTestCase() {
+        static FakeGlLibrary library;
+        GLEScontext::dispatcher().dispatchFuncs(GLES_2_0, &library);
+    }
+
+    void SetUp() override {
+        mShareGroup = mNameManager.createShareGroup(this, 0, nullptr, {});
+    }
+
+    void TearDown() override {
+        mShareGroup.reset();
+        mNameManager.deleteShareGroup(this);
+    }
+
+    // Creates |count| objects of |type| with object data.
+    std::vector<ObjectLocalName> createObjects(NamedObjectType type,
+                                               int count) {
+        std::vector<ObjectLocalName> names;
+        for (int i = 0; i < count; ++i) {
+            ObjectLocalName name = mShareGroup->genName(type, 0, true);
+            mShareGroup->setObjectData(type, name, makeObjectData(type));
+            names.push_back(name);
+        }
+        return names;
+    }
+
+    static ObjectDataPtr makeObjectData(NamedObjectType type) {
+        if (type == NamedObjectType::VERTEXBUFFER) {
+            return ObjectDataPtr(new GLESbuffer());
+        }
+        return ObjectDataPtr(new TestObjectData());
+    }
+
+    GlobalNameSpace mGlobalNameSpace;
+    ObjectNameManager mNameManager{&mGlobalNameSpace};
+    ShareGroupPtr mShareGroup;
+};
+
+}  // namespace
+
+TEST_F(ShareGroupTest, NamesAndObjectData) {
+    const NamedObjectType type = NamedObjectType::TEXTURE;
+    ObjectLocalName name = mShareGroup->genName(type, 0, true);
+    ASSERT_NE(0u, name);
+    EXPECT_TRUE(mShareGroup->isObject(type, name));
+    EXPECT_FALSE(mShareGroup->isObject(NamedObjectType::VERTEXBUFFER, name));
+
+    const unsigned int globalName = mShareGroup->getGlobalName(type, name);
+    EXPECT_NE(0u, globalName);
+    EXPECT_EQ(name, mShareGroup->getLocalName(type, globalName));
+    EXPECT_EQ(nullptr, mShareGroup->getObjectData(type, name));
+
+    ObjectDataPtr data = makeObjectData(type);
+    mShareGroup->setObjectData(type, name, data);
+    EXPECT_EQ(data.get(), mShareGroup->getObjectData(type, name));
+    EXPECT_EQ(data, mShareGroup->getObjectDataPtr(type, name));
+
+    mShareGroup->deleteName(type, name);
+    EXPECT_FALSE(mShareGroup->isObject(type, name));
+    EXPECT_EQ(0u, mShareGroup->getGlobalName(type, name));
+    EXPECT_EQ(nullptr, mShareGroup->getObjectData(type, name));
+}
+
+TEST_F(ShareGroupTest, EnsureObjectOnBind) {
+    const NamedObjectType type = NamedObjectType::VERTEXBUFFER;
+    // Binding a name that was never generated creates the object.
+    const unsigned int globalName = mShareGroup->ensureObjectOnBind(type, 42);
+    EXPECT_NE(0u, globalName);
+    EXPECT_TRUE(mShareGroup->isObject(type, 42));
+    auto buffer = (GLESbuffer*)mShareGroup->getObjectData(type, 42);
+    ASSERT_NE(nullptr, buffer);
+    EXPECT_TRUE(buffer->wasBinded());
+    // Later binds find it.
+    EXPECT_EQ(globalName, mShareGroup->ensureObjectOnBind(type, 42));
+}
+
+// Threads creating, binding, looking up and deleting objects of the same
+// and of different types at the same time.
+TEST_F(ShareGroupTest, ConcurrentAccess) {
+    constexpr int kThreads = 8;
+    constexpr int kIterations = 2000;
+    const auto shared = createObjects(NamedObjectType::TEXTURE, 1);
+    ObjectData* const sharedData =
+            mShareGroup->getObjectData(NamedObjectType::TEXTURE, shared[0]);
+
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([this, t, &shared, sharedData, &failures] {
+            const NamedObjectType type = (t % 2)
+                                                 ? NamedObjectType::VERTEXBUFFER
+                                                 : NamedObjectType::TEXTURE;
+            for (int i = 0; i < kIterations; ++i) {
+                ObjectLocalName name = mShareGroup->genName(type, 0, true);
+                ObjectDataPtr data = makeObjectData(type);
+                mShareGroup->setObjectData(type, name, data);
+                if (type == NamedObjectType::VERTEXBUFFER) {
+                    mShareGroup->ensureObjectOnBind(type, name);
+                }
+                const unsigned int globalName =
+                        mShareGroup->getGlobalName(type, name);
+                if (!globalName ||
+                    mShareGroup->getLocalName(type, globalName) != name ||
+                    mShareGroup->getObjectData(type, name) != data.get() ||
+                    mShareGroup->getObjectData(NamedObjectType::TEXTURE,
+                                               shared[0]) != sharedData) {
+                    ++failures;
+                }
+                mShareGroup->deleteName(type, name);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(0, failures);
+}
+
+// Lookups per second from threads sharing one share group, as render
+// threads of contexts sharing objects do. Half of the threads look up
+// buffers, the other half textures.
+TEST_F(ShareGroupTest, DISABLED_ContentionBenchmark) {
+    constexpr int kObjects = 256;
+    constexpr int kLookupsPerThread = 2000000;
+    const auto buffers = createObjects(NamedObjectType::VERTEXBUFFER, kObjects);
+    const auto textures = createObjects(NamedObjectType::TEXTURE, kObjects);
+    for (ObjectLocalName name : buffers) {
+        mShareGroup->ensureObjectOnBind(NamedObjectType::VERTEXBUFFER, name);
+    }
+
+    for (int numThreads : {1, 2, 4, 8}) {
+        std::vector<std::thread> threads;
+        const auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < numThreads; ++t) {
+            threads.emplace_back([this, t, &buffers, &textures] {
+                const bool useBuffers = t % 2;
+                const auto& names = useBuffers ? buffers : textures;
+                uint64_t sum = 0;
+                for (int i = 0; i < kLookupsPerThread; ++i) {
+                    const ObjectLocalName name = names[i % kObjects];
+                    if (useBuffers) {
+                        sum += mShareGroup->ensureObjectOnBind(
+                                NamedObjectType::VERTEXBUFFER, name);
+                    } else {
+                        sum += mShareGroup->getGlobalName(
+                                NamedObjectType::TEXTURE, name);
+                    }
+                    sum += (uintptr_t)mShareGroup->getObjectData(
+                            useBuffers ? NamedObjectType::VERTEXBUFFER
+                                       : NamedObjectType::TEXTURE,
+                            name);
+                }
+                EXPECT_NE(0u, sum);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const double ns = std::chrono::duration<double, std::nano>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+        printf("%d threads: %.1f ns per lookup pair, %.1f M pairs/s total\n",
+               numThreads, ns / kLookupsPerThread,
+               numThreads * kLookupsPerThread / ns * 1000.0);
+    }
+}
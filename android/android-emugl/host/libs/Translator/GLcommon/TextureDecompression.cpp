@@ -0,0 +1,332 @@
+/*
+* Copyright (C) 2020 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <GLcommon/TextureDecompression.h>
+
+#include "android/base/memory/LazyInstance.h"
+#include "android/base/synchronization/ConditionVariable.h"
+#include "android/base/system/System.h"
+#include "android/base/threads/ThreadPool.h"
+
+#include "emugl/common/logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string.h>
+
+using android::base::AutoLock;
+using android::base::ConditionVariable;
+using android::base::Lock;
+using android::base::System;
+using android::base::ThreadPool;
+
+// Images smaller than this decode on the calling thread; handing them to
+// the pool costs more than it saves.
+static constexpr size_t kMinParallelPixels = 256 * 256;
+// Each band decodes at least this many rows of blocks.
+static constexpr int kMinBandBlockRows = 16;
+static constexpr int kMaxDecodeThreads = 8;
+
+// Small images decode about as fast as they hash.
+static constexpr size_t kMinCachedPixels = 64 * 64;
+static constexpr uint64_t kStatsLogInterval = 256;
+
+namespace {
+
+using DecodeBand = std::function<void()>;
+
+// Worker threads shared by all contexts. The calling thread decodes a band
+// too, so a pool of N workers runs N + 1 bands at a time.
+class DecodePool {
+public:
+    DecodePool()
+        : mPool(std::max(1, std::min(System::get()->getCpuCoreCount() - 1,
+                                     kMaxDecodeThreads)),
+                [](DecodeBand&& band) { band(); }) {
+        mWorkers = mPool.start() ? mPool.numWorkers() : 0;
+    }
+
+    int numWorkers() const { return mWorkers; }
+
+    // Runs all |bands| and returns once they are done.
+    void run(std::vector<DecodeBand>& bands) {
+        if (bands.empty()) {
+            return;
+        }
+        Lock lock;
+        ConditionVariable cv;
+        size_t pending = bands.size() - 1;
+        for (size_t i = 1; i < bands.size(); ++i) {
+            DecodeBand* band = &bands[i];
+            mPool.enqueue([band, &lock, &cv, &pending] {
+                (*band)();
+                // Signal under the lock: the waiter owns |lock| and |cv|
+                // and may return as soon as it can take the lock.
+                AutoLock autoLock(lock);
+                if (--pending == 0) {
+                    cv.signal();
+                }
+            });
+        }
+        bands[0]();
+        AutoLock autoLock(lock);
+        cv.wait(&autoLock, [&pending] { return pending == 0; });
+    }
+
+private:
+    ThreadPool<DecodeBand> mPool;
+    int mWorkers = 0;
+};
+
+}  // namespace
+
+static android::base::LazyInstance<DecodePool> sDecodePool = LAZY_INSTANCE_INIT;
+
+// Calls |decodeBand(firstBlockRow, blockRows)| over bands covering the
+// |blockRows| rows of blocks of an image of |pixels| pixels, on the pool if
+// the image is large. Returns true if every band succeeded.
+static bool decodeInBands(int blockRows,
+                          size_t pixels,
+                          const std::function<bool(int, int)>& decodeBand) {
+    int numBands = 1;
+    if (pixels >= kMinParallelPixels) {
+        numBands = std::min(sDecodePool->numWorkers() + 1,
+                            blockRows / kMinBandBlockRows);
+    }
+    if (numBands <= 1) {
+        return decodeBand(0, blockRows);
+    }
+
+    std::atomic<bool> success(true);
+    std::vector<DecodeBand> bands;
+    bands.reserve(numBands);
+    const int rowsPerBand = (blockRows + numBands - 1) / numBands;
+    for (int firstRow = 0; firstRow < blockRows; firstRow += rowsPerBand) {
+        const int rows = std::min(rowsPerBand, blockRows - firstRow);
+        bands.push_back([&decodeBand, &success, firstRow, rows] {
+            if (!decodeBand(firstRow, rows)) {
+                success = false;
+            }
+        });
+    }
+    sDecodePool->run(bands);
+    return success;
+}
+
+bool decodeEtc2Image(const etc1_byte* in, ETC2ImageFormat format,
+                     etc1_byte* out, int width, int height, int stride) {
+    const size_t blockRowBytes = etc_get_encoded_data_size(format, width, 4);
+    return decodeInBands(
+            (height + 3) / 4, (size_t)width * height,
+            [=](int firstRow, int rows) {
+                const int y = firstRow * 4;
+                const int bandHeight = std::min(rows * 4, height - y);
+                return etc2_decode_image(in + firstRow * blockRowBytes, format,
+                                         out + (size_t)y * stride, width,
+                                         bandHeight, stride) == 0;
+            });
+}
+
+static bool getAstcBlockSize(astc_codec::FootprintType footprint,
+                             int* blockWidth,
+                             int* blockHeight) {
+    using astc_codec::FootprintType;
+    switch (footprint) {
+        case FootprintType::k4x4: *blockWidth = 4; *blockHeight = 4; break;
+        case FootprintType::k5x4: *blockWidth = 5; *blockHeight = 4; break;
+        case FootprintType::k5x5: *blockWidth = 5; *blockHeight = 5; break;
+        case FootprintType::k6x5: *blockWidth = 6; *blockHeight = 5; break;
+        case FootprintType::k6x6: *blockWidth = 6; *blockHeight = 6; break;
+        case FootprintType::k8x5: *blockWidth = 8; *blockHeight = 5; break;
+        case FootprintType::k8x6: *blockWidth = 8; *blockHeight = 6; break;
+        case FootprintType::k8x8: *blockWidth = 8; *blockHeight = 8; break;
+        case FootprintType::k10x5: *blockWidth = 10; *blockHeight = 5; break;
+        case FootprintType::k10x6: *blockWidth = 10; *blockHeight = 6; break;
+        case FootprintType::k10x8: *blockWidth = 10; *blockHeight = 8; break;
+        case FootprintType::k10x10: *blockWidth = 10; *blockHeight = 10; break;
+        case FootprintType::k12x10: *blockWidth = 12; *blockHeight = 10; break;
+        case FootprintType::k12x12: *blockWidth = 12; *blockHeight = 12; break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+bool decodeAstcImage(const uint8_t* in, size_t inSize, int width, int height,
+                     astc_codec::FootprintType footprint, uint8_t* out,
+                     size_t outSize, int stride) {
+    static constexpr size_t kAstcBlockBytes = 16;
+    int blockWidth = 0;
+    int blockHeight = 0;
+    if (width <= 0 || height <= 0 ||
+        !getAstcBlockSize(footprint, &blockWidth, &blockHeight)) {
+        return astc_codec::ASTCDecompressToRGBA(in, inSize, width, height,
+                                                footprint, out, outSize,
+                                                stride);
+    }
+    const size_t blockRowBytes =
+            (size_t)((width + blockWidth - 1) / blockWidth) * kAstcBlockBytes;
+    const int blockRows = (height + blockHeight - 1) / blockHeight;
+    if (inSize != blockRowBytes * blockRows || outSize < (size_t)stride * height) {
+        // Let the decoder report the size mismatch.
+        return astc_codec::ASTCDecompressToRGBA(in, inSize, width, height,
+                                                footprint, out, outSize,
+                                                stride);
+    }
+    return decodeInBands(
+            blockRows, (size_t)width * height, [=](int firstRow, int rows) {
+                const int y = firstRow * blockHeight;
+                const int bandHeight = std::min(rows * blockHeight, height - y);
+                return astc_codec::ASTCDecompressToRGBA(
+                        in + firstRow * blockRowBytes, rows * blockRowBytes,
+                        width, bandHeight, footprint, out + (size_t)y * stride,
+                        (size_t)stride * bandHeight, stride);
+            });
+}
+
+// A 64-bit FNV-1a variant that consumes a word at a time; the cache
+// compares the full compressed data on a hash match, so this only has to
+// spread keys.
+static uint64_t hashBytes(const uint8_t* data, size_t size) {
+    static constexpr uint64_t kPrime = 0x100000001b3ULL;
+    uint64_t hash = 0xcbf29ce484222325ULL ^ size;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * kPrime;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ data[i]) * kPrime;
+    }
+    return hash;
+}
+
+static android::base::LazyInstance<DecompressedTextureCache> sCache =
+        LAZY_INSTANCE_INIT;
+
+// static
+DecompressedTextureCache* DecompressedTextureCache::get() {
+    return sCache.ptr();
+}
+
+DecompressedTextureCache::DecompressedTextureCache(size_t maxBytes)
+    : mMaxBytes(maxBytes) {}
+
+bool DecompressedTextureCache::isCacheable(GLsizei width,
+                                           GLsizei height,
+                                           size_t dataSize) const {
+    return (size_t)width * height >= kMinCachedPixels &&
+           dataSize + (size_t)width * height * 4 <= mMaxBytes / 4;
+}
+
+DecompressedTextureCache::EntryList::iterator
+DecompressedTextureCache::findLocked(uint64_t hash,
+                                     GLenum internalformat,
+                                     GLsizei width,
+                                     GLsizei height,
+                                     GLsizei stride,
+                                     const void* data,
+                                     size_t dataSize) {
+    auto range = mIndex.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        const Entry& entry = *it->second;
+        if (entry.internalformat == internalformat && entry.width == width &&
+            entry.height == height && entry.stride == stride &&
+            entry.compressed.size() == dataSize &&
+            !memcmp(entry.compressed.data(), data, dataSize)) {
+            return it->second;
+        }
+    }
+    return mEntries.end();
+}
+
+DecompressedTextureCache::Pixels DecompressedTextureCache::lookup(
+        GLenum internalformat,
+        GLsizei width,
+        GLsizei height,
+        GLsizei stride,
+        const void* data,
+        size_t dataSize) {
+    if (!data || !isCacheable(width, height, dataSize)) {
+        return nullptr;
+    }
+    const uint64_t hash = hashBytes((const uint8_t*)data, dataSize);
+    AutoLock lock(mLock);
+    auto it = findLocked(hash, internalformat, width, height, stride, data,
+                         dataSize);
+    Pixels pixels;
+    if (it != mEntries.end()) {
+        mEntries.splice(mEntries.begin(), mEntries, it);
+        pixels = it->pixels;
+        ++mStats.hits;
+    } else {
+        ++mStats.misses;
+    }
+    const uint64_t lookups = mStats.hits + mStats.misses;
+    if (lookups % kStatsLogInterval == 0) {
+        GL_LOG("Decompressed texture cache: %llu/%llu hits, %zu KB",
+               (unsigned long long)mStats.hits, (unsigned long long)lookups,
+               mStats.bytes / 1024);
+    }
+    return pixels;
+}
+
+void DecompressedTextureCache::store(GLenum internalformat,
+                                     GLsizei width,
+                                     GLsizei height,
+                                     GLsizei stride,
+                                     const void* data,
+                                     size_t dataSize,
+                                     Pixels pixels) {
+    if (!data || !pixels || !isCacheable(width, height, dataSize)) {
+        return;
+    }
+    const uint64_t hash = hashBytes((const uint8_t*)data, dataSize);
+    const uint8_t* bytes = (const uint8_t*)data;
+    AutoLock lock(mLock);
+    if (findLocked(hash, internalformat, width, height, stride, data,
+                   dataSize) != mEntries.end()) {
+        return;
+    }
+    mStats.bytes += dataSize + pixels->size();
+    mEntries.push_front({hash, internalformat, width, height, stride,
+                         std::vector<uint8_t>(bytes, bytes + dataSize),
+                         std::move(pixels)});
+    mIndex.emplace(hash, mEntries.begin());
+    evictLocked();
+}
+
+void DecompressedTextureCache::evictLocked() {
+    while (mStats.bytes > mMaxBytes && !mEntries.empty()) {
+        auto last = std::prev(mEntries.end());
+        auto range = mIndex.equal_range(last->hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == last) {
+                mIndex.erase(it);
+                break;
+            }
+        }
+        mStats.bytes -= last->compressed.size() + last->pixels->size();
+        mEntries.erase(last);
+    }
+}
+
+DecompressedTextureCache::Stats DecompressedTextureCache::getStats() const {
+    AutoLock lock(mLock);
+    return mStats;
+}
@@ -0,0 +1,272 @@
+// Copyright 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <GLcommon/TextureDecompression.h>
+
+#include <GLES3/gl3.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+struct Size {
+    int width;
+    int height;
+};
+
+// Small images decode in one piece, the others in bands, some of them
+// ending with partial blocks.
+constexpr Size kSizes[] = {{17, 13}, {256, 256}, {513, 1030}, {1024, 1024}};
+
+constexpr ETC2ImageFormat kEtcFormats[] = {
+        EtcRGB8, EtcRGBA8, EtcR11, EtcSignedR11, EtcRG11, EtcSignedRG11,
+        EtcRGB8A1,
+};
+
+std::vector<uint8_t> randomBytes(size_t size, int seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> bytes(size);
+    for (auto& byte : bytes) {
+        byte = (uint8_t)rng();
+    }
+    return bytes;
+}
+
+// Void-extent ASTC blocks: a constant color for the whole block, valid for
+// any footprint. The color is stored as 16-bit UNORM, each channel here
+// repeats its byte so it decodes to the same 8-bit value however it gets
+// rounded.
+struct AstcBlock {
+    uint8_t encoded[16];
+    uint8_t decoded[4];
+};
+
+constexpr AstcBlock kAstcBlocks[] = {
+        {{0xfc, 0xfd, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+          0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff},
+         {0x00, 0x00, 0x00, 0xff}},
+        {{0xfc, 0xfd, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+          0xff, 0xff, 0x80, 0x80, 0x00, 0x00, 0xff, 0xff},
+         {0xff, 0x80, 0x00, 0xff}},
+        {{0xfc, 0xfd, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+          0x12, 0x12, 0x34, 0x34, 0x56, 0x56, 0x78, 0x78},
+         {0x12, 0x34, 0x56, 0x78}},
+        {{0xfc, 0xfd, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+          0xc0, 0xc0, 0xff, 0xff, 0x40, 0x40, 0x00, 0x00},
+         {0xc0, 0xff, 0x40, 0x00}},
+};
+constexpr int kAstcBlockCount = sizeof(kAstcBlocks) / sizeof(kAstcBlocks[0]);
+
+DecompressedTextureCache::Pixels makePixels(size_t size, uint8_t value) {
+    return std::make_shared<std::vector<uint8_t>>(size, value);
+}
+
+}  // namespace
+
+// Any bit pattern is a valid ETC2 block, so random data covers all modes.
+TEST(TextureDecompression, Etc2MatchesSerialDecode) {
+    for (ETC2ImageFormat format : kEtcFormats) {
+        for (const Size& size : kSizes) {
+            const int stride =
+                    (size.width * etc_get_decoded_pixel_size(format) + 3) & ~3;
+            const auto in = randomBytes(
+                    etc_get_encoded_data_size(format, size.width, size.height),
+                    format * 31 + size.width);
+            std::vector<uint8_t> expected(stride * size.height);
+            std::vector<uint8_t> decoded(stride * size.height);
+            ASSERT_EQ(0, etc2_decode_image(in.data(), format, expected.data(),
+                                           size.width, size.height, stride));
+            ASSERT_TRUE(decodeEtc2Image(in.data(), format, decoded.data(),
+                                        size.width, size.height, stride));
+            EXPECT_EQ(expected, decoded)
+                    << "format " << format << " " << size.width << "x"
+                    << size.height;
+        }
+    }
+}
+
+TEST(TextureDecompression, AstcMatchesSerialDecode) {
+    const struct {
+        astc_codec::FootprintType footprint;
+        int blockWidth;
+        int blockHeight;
+    } footprints[] = {
+            {astc_codec::FootprintType::k4x4, 4, 4},
+            {astc_codec::FootprintType::k8x6, 8, 6},
+            {astc_codec::FootprintType::k12x12, 12, 12},
+    };
+    for (const auto& footprint : footprints) {
+        for (const Size& size : kSizes) {
+            const int stride = size.width * 4;
+            const int blocksWide = (size.width + footprint.blockWidth - 1) /
+                                   footprint.blockWidth;
+            const int blocksHigh = (size.height + footprint.blockHeight - 1) /
+                                   footprint.blockHeight;
+            // Tile the blocks so that neighbouring blocks and block rows
+            // differ, which catches misplaced bands.
+            auto blockAt = [](int bx, int by) -> const AstcBlock& {
+                return kAstcBlocks[(bx + 3 * by) % kAstcBlockCount];
+            };
+            std::vector<uint8_t> in;
+            for (int by = 0; by < blocksHigh; ++by) {
+                for (int bx = 0; bx < blocksWide; ++bx) {
+                    const AstcBlock& block = blockAt(bx, by);
+                    in.insert(in.end(), block.encoded,
+                              block.encoded + sizeof(block.encoded));
+                }
+            }
+            std::vector<uint8_t> expected(stride * size.height);
+            std::vector<uint8_t> decoded(stride * size.height);
+            ASSERT_TRUE(astc_codec::ASTCDecompressToRGBA(
+                    in.data(), in.size(), size.width, size.height,
+                    footprint.footprint, expected.data(), expected.size(),
+                    stride));
+            ASSERT_TRUE(decodeAstcImage(
+                    in.data(), in.size(), size.width, size.height,
+                    footprint.footprint, decoded.data(), decoded.size(),
+                    stride));
+            EXPECT_EQ(expected, decoded)
+                    << "footprint " << footprint.blockWidth << "x"
+                    << footprint.blockHeight << " " << size.width << "x"
+                    << size.height;
+
+            for (int y = 0; y < size.height; ++y) {
+                for (int x = 0; x < size.width; ++x) {
+                    const AstcBlock& block =
+                            blockAt(x / footprint.blockWidth,
+                                    y / footprint.blockHeight);
+                    ASSERT_EQ(0, memcmp(block.decoded,
+                                        &decoded[y * stride + x * 4], 4))
+                            << "pixel " << x << "," << y;
+                }
+            }
+        }
+    }
+}
+
+TEST(TextureDecompression, AstcRejectsTruncatedData) {
+    std::vector<uint8_t> in(16 * 64 * 64 - 1);
+    std::vector<uint8_t> out(256 * 256 * 4);
+    EXPECT_FALSE(decodeAstcImage(in.data(), in.size(), 256, 256,
+                                 astc_codec::FootprintType::k4x4, out.data(),
+                                 out.size(), 256 * 4));
+}
+
+TEST(TextureDecompression, CacheHitsOnSameData) {
+    DecompressedTextureCache cache;
+    const auto data = randomBytes(128 * 128, 1);
+    const size_t pixelsSize = 128 * 128 * 4;
+
+    EXPECT_FALSE(cache.lookup(GL_COMPRESSED_RGBA8_ETC2_EAC, 128, 128, 512,
+                              data.data(), data.size()));
+    auto pixels = makePixels(pixelsSize, 7);
+    cache.store(GL_COMPRESSED_RGBA8_ETC2_EAC, 128, 128, 512, data.data(),
+                data.size(), pixels);
+    EXPECT_EQ(pixels, cache.lookup(GL_COMPRESSED_RGBA8_ETC2_EAC, 128, 128,
+                                   512, data.data(), data.size()));
+
+    // Same bytes uploaded as another format, size or stride.
+    EXPECT_FALSE(cache.lookup(GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC, 128, 128,
+                              512, data.data(), data.size()));
+    EXPECT_FALSE(cache.lookup(GL_COMPRESSED_RGBA8_ETC2_EAC, 256, 64, 1024,
+                              data.data(), data.size()));
+    EXPECT_FALSE(cache.lookup(GL_COMPRESSED_RGBA8_ETC2_EAC, 128, 128, 520,
+                              data.data(), data.size()));
+
+    // Different content.
+    auto other = data;
+    other[other.size() / 2] ^= 1;
+    EXPECT_FALSE(cache.lookup(GL_COMPRESSED_RGBA8_ETC2_EAC, 128, 128, 512,
+                              other.data(), other.size()));
+
+    const auto stats = cache.getStats();
+    EXPECT_EQ(1u, stats.hits);
+    EXPECT_EQ(5u, stats.misses);
+    EXPECT_EQ(data.size() + pixelsSize, stats.bytes);
+}
+
+TEST(TextureDecompression, CacheSkipsSmallImages) {
+    DecompressedTextureCache cache;
+    const auto data = randomBytes(16 * 16, 2);
+    cache.store(GL_COMPRESSED_RGBA8_ETC2_EAC, 16, 16, 64, data.data(),
+                data.size(), makePixels(16 * 16 * 4, 0));
+    EXPECT_FALSE(cache.lookup(GL_COMPRESSED_RGBA8_ETC2_EAC, 16, 16, 64,
+                              data.data(), data.size()));
+    EXPECT_EQ(0u, cache.getStats().bytes);
+}
+
+TEST(TextureDecompression, CacheEvictsLeastRecentlyUsed) {
+    const size_t entryBytes = 128 * 128 + 128 * 128 * 4;
+    DecompressedTextureCache cache(entryBytes * 4);
+    std::vector<std::vector<uint8_t>> datas;
+    for (int i = 0; i < 5; ++i) {
+        datas.push_back(randomBytes(128 * 128, 10 + i));
+    }
+    for (int i = 0; i < 4; ++i) {
+        cache.store(GL_COMPRESSED_RGBA8_ETC2_EAC, 128, 128, 512,
+                    datas[i].data(), datas[i].size(),
+                    makePixels(128 * 128 * 4, i));
+    }
+    // Touch the oldest entry, then push one more.
+    EXPECT_TRUE(cache.lookup(GL_COMPRESSED_RGBA8_ETC2_EAC, 128, 128, 512,
+                             datas[0].data(), datas[0].size()));
+    cache.store(GL_COMPRESSED_RGBA8_ETC2_EAC, 128, 128, 512, datas[4].data(),
+                datas[4].size(), makePixels(128 * 128 * 4, 4));
+
+    EXPECT_TRUE(cache.lookup(GL_COMPRESSED_RGBA8_ETC2_EAC, 128, 128, 512,
+                             datas[0].data(), datas[0].size()));
+    EXPECT_FALSE(cache.lookup(GL_COMPRESSED_RGBA8_ETC2_EAC, 128, 128, 512,
+                              datas[1].data(), datas[1].size()));
+    for (int i = 2; i < 5; ++i) {
+        EXPECT_TRUE(cache.lookup(GL_COMPRESSED_RGBA8_ETC2_EAC, 128, 128, 512,
+                                 datas[i].data(), datas[i].size()));
+    }
+    EXPECT_EQ(entryBytes * 4, cache.getStats().bytes);
+}
+
+// Decode time of a large texture, serially and in bands.
+TEST(TextureDecompression, DISABLED_Benchmark) {
+    constexpr int kSize = 2048;
+    constexpr int kIterations = 20;
+    for (ETC2ImageFormat format : {EtcRGB8, EtcRGBA8}) {
+        const int stride = kSize * etc_get_decoded_pixel_size(format);
+        const auto in = randomBytes(
+                etc_get_encoded_data_size(format, kSize, kSize), format);
+        std::vector<uint8_t> out(stride * kSize);
+        for (bool banded : {false, true}) {
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < kIterations; ++i) {
+                if (banded) {
+                    decodeEtc2Image(in.data(), format, out.data(), kSize,
+                                    kSize, stride);
+                } else {
+                    etc2_decode_image(in.data(), format, out.data(), kSize,
+                                      kSize, stride);
+                }
+            }
+            const double ms = std::chrono::duration<double, std::milli>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count();
+            printf("format %d %s: %.2f ms per %dx%d image\n", format,
+                   banded ? "banded" : "serial", ms / kIterations, kSize,
+                   kSize);
+        }
+    }
+}
@@ -17,16 +17,13 @@
 #include <GLcommon/GLESmacros.h>
 #include <GLcommon/GLDispatch.h>
 #include <GLcommon/GLESvalidate.h>
+#include <GLcommon/TextureDecompression.h>
 #include <stdio.h>
 #include <cmath>
 #include <memory>
 
-#include "android/base/AlignedBuf.h"
-
 #include <astc-codec/astc-codec.h>
 
-using android::AlignedBuf;
-
 #define GL_R16 0x822A
 #define GL_RG16 0x822C
 #define GL_R16_SNORM 0x8F98
@@ -428,16 +425,28 @@ void doCompressedTexImage2D(GLEScontext* ctx, GLenum target, GLint level,
         const int32_t align = ctx->getUnpackAlignment()-1;
         const int32_t bpr = ((width * pixelSize) + align) & ~align;
         const size_t size = bpr * height;
-        std::unique_ptr<etc1_byte[]> pOut(new etc1_byte[size]);
-
-        int res =
-            etc2_decode_image(
-                    (const etc1_byte*)data, etcFormat, pOut.get(),
-                    width, height, bpr);
-        SET_ERROR_IF(res!=0, GL_INVALID_VALUE);
+        // Uninitialized data is not worth caching.
+        DecompressedTextureCache* cache =
+                emulateCompressedData ? nullptr : DecompressedTextureCache::get();
+        DecompressedTextureCache::Pixels pOut;
+        if (cache) {
+            pOut = cache->lookup(internalformat, width, height, bpr, data,
+                                 compressedSize);
+        }
+        if (!pOut) {
+            auto decoded = std::make_shared<std::vector<uint8_t>>(size);
+            bool res = decodeEtc2Image((const etc1_byte*)data, etcFormat,
+                                       decoded->data(), width, height, bpr);
+            SET_ERROR_IF(!res, GL_INVALID_VALUE);
+            pOut = std::move(decoded);
+            if (cache) {
+                cache->store(internalformat, width, height, bpr, data,
+                             compressedSize, pOut);
+            }
+        }
 
         glTexImage2DPtr(target, level, convertedInternalFormat,
-                        width, height, border, format, type, pOut.get());
+                        width, height, border, format, type, pOut->data());
         if (emulateCompressedData) {
             delete [] (char*)data;
         }
@@ -451,17 +460,23 @@ void doCompressedTexImage2D(GLEScontext* ctx, GLenum target, GLint level,
         const int32_t stride = ((width * 4) + align) & ~align;
         const size_t size = stride * height;
 
-        AlignedBuf<uint8_t, 64> alignedUncompressedData(size);
-
-        const bool result = astc_codec::ASTCDecompressToRGBA(
-                reinterpret_cast<const uint8_t*>(data), imageSize, width,
-                height, footprint, alignedUncompressedData.data(), size,
-                stride);
-        SET_ERROR_IF(!result, GL_INVALID_VALUE);
+        DecompressedTextureCache* cache = DecompressedTextureCache::get();
+        DecompressedTextureCache::Pixels uncompressedData = cache->lookup(
+                internalformat, width, height, stride, data, imageSize);
+        if (!uncompressedData) {
+            auto decoded = std::make_shared<std::vector<uint8_t>>(size);
+            const bool result = decodeAstcImage(
+                    reinterpret_cast<const uint8_t*>(data), imageSize, width,
+                    height, footprint, decoded->data(), size, stride);
+            SET_ERROR_IF(!result, GL_INVALID_VALUE);
+            uncompressedData = std::move(decoded);
+            cache->store(internalformat, width, height, stride, data,
+                         imageSize, uncompressedData);
+        }
 
         glTexImage2DPtr(target, level, srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, width,
                         height, border, GL_RGBA, GL_UNSIGNED_BYTE,
-                        alignedUncompressedData.data());
+                        uncompressedData->data());
 
     } else if (isPaletteFormat(internalformat)) {
         // TODO: fix the case when GL_PIXEL_UNPACK_BUFFER is bound
@@ -0,0 +1,171 @@
+/*
+* Copyright (C) 2020 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include <GLcommon/VertexConversion.h>
+
+#include <GLcommon/GLconversion_macros.h>
+
+// SSE2 and NEON are part of the base instruction sets of the 64-bit hosts,
+// so there is nothing to detect at runtime.
+#if defined(__x86_64__) || defined(_M_X64)
+#define VERTEX_CONVERSION_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#define VERTEX_CONVERSION_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Same as X2F(): scaling by a power of two is exact.
+static constexpr float kFixedToFloat = 1.0f / 65536.0f;
+
+// Converts |n| consecutive values.
+static inline void convertFixedSpan(const GLfixed* in, GLfloat* out, size_t n) {
+    size_t i = 0;
+#if defined(VERTEX_CONVERSION_SSE2)
+    const __m128 scale = _mm_set1_ps(kFixedToFloat);
+    for (; i + 8 <= n; i += 8) {
+        // Both loads come first, for in place conversions.
+        __m128i a = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(in + i + 4));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(in + i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+    }
+#elif defined(VERTEX_CONVERSION_NEON)
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(out + i,
+                  vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(in + i)), kFixedToFloat));
+    }
+#endif
+    for (; i < n; ++i) {
+        out[i] = X2F(in[i]);
+    }
+}
+
+static inline void convertByteSpan(const GLbyte* in, GLshort* out, size_t n) {
+    size_t i = 0;
+#if defined(VERTEX_CONVERSION_SSE2)
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+        // Sign extends each byte by unpacking it to the high half of a word.
+        _mm_storeu_si128((__m128i*)(out + i),
+                         _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8));
+        _mm_storeu_si128((__m128i*)(out + i + 8),
+                         _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8));
+    }
+#elif defined(VERTEX_CONVERSION_NEON)
+    for (; i + 16 <= n; i += 16) {
+        int8x16_t v = vld1q_s8(in + i);
+        vst1q_s16(out + i, vmovl_s8(vget_low_s8(v)));
+        vst1q_s16(out + i + 8, vmovl_s8(vget_high_s8(v)));
+    }
+#endif
+    for (; i < n; ++i) {
+        out[i] = B2S(in[i]);
+    }
+}
+
+template <class In, class Out, void (*convertSpan)(const In*, Out*, size_t)>
+static void convertArray(const void* in, size_t strideIn,
+                         void* out, size_t strideOut,
+                         int attribSize, size_t count) {
+    const size_t attribBytesIn = attribSize * sizeof(In);
+    const size_t attribBytesOut = attribSize * sizeof(Out);
+    if (strideIn == attribBytesIn && strideOut == attribBytesOut) {
+        convertSpan((const In*)in, (Out*)out, count * attribSize);
+        return;
+    }
+    const char* src = (const char*)in;
+    char* dst = (char*)out;
+    for (size_t i = 0; i < count; ++i) {
+        convertSpan((const In*)src, (Out*)dst, attribSize);
+        src += strideIn;
+        dst += strideOut;
+    }
+}
+
+template <class Index,
+          class In,
+          class Out,
+          void (*convertSpan)(const In*, Out*, size_t)>
+static void convertIndexedArray(const char* in, size_t strideIn,
+                                char* out, size_t strideOut,
+                                int attribSize, const Index* indices,
+                                size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const size_t index = indices[i];
+        convertSpan((const In*)(in + index * strideIn),
+                    (Out*)(out + index * strideOut), attribSize);
+    }
+}
+
+template <class In, class Out, void (*convertSpan)(const In*, Out*, size_t)>
+static void convertIndexed(const void* in, size_t strideIn,
+                           void* out, size_t strideOut,
+                           int attribSize, GLenum indicesType,
+                           const void* indices, size_t count) {
+    switch (indicesType) {
+        case GL_UNSIGNED_BYTE:
+            convertIndexedArray<GLubyte, In, Out, convertSpan>(
+                    (const char*)in, strideIn, (char*)out, strideOut,
+                    attribSize, (const GLubyte*)indices, count);
+            break;
+        case GL_UNSIGNED_SHORT:
+            convertIndexedArray<GLushort, In, Out, convertSpan>(
+                    (const char*)in, strideIn, (char*)out, strideOut,
+                    attribSize, (const GLushort*)indices, count);
+            break;
+        default:  // GL_UNSIGNED_INT
+            convertIndexedArray<GLuint, In, Out, convertSpan>(
+                    (const char*)in, strideIn, (char*)out, strideOut,
+                    attribSize, (const GLuint*)indices, count);
+            break;
+    }
+}
+
+void convertFixedToFloat(const void* in, size_t strideIn,
+                         void* out, size_t strideOut,
+                         int attribSize, size_t count) {
+    convertArray<GLfixed, GLfloat, convertFixedSpan>(
+            in, strideIn, out, strideOut, attribSize, count);
+}
+
+void convertByteToShort(const void* in, size_t strideIn,
+                        void* out, size_t strideOut,
+                        int attribSize, size_t count) {
+    convertArray<GLbyte, GLshort, convertByteSpan>(
+            in, strideIn, out, strideOut, attribSize, count);
+}
+
+void convertFixedToFloatIndexed(const void* in, size_t strideIn,
+                                void* out, size_t strideOut,
+                                int attribSize, GLenum indicesType,
+                                const void* indices, size_t count) {
+    convertIndexed<GLfixed, GLfloat, convertFixedSpan>(
+            in, strideIn, out, strideOut, attribSize, indicesType, indices,
+            count);
+}
+
+void convertByteToShortIndexed(const void* in, size_t strideIn,
+                               void* out, size_t strideOut,
+                               int attribSize, GLenum indicesType,
+                               const void* indices, size_t count) {
+    convertIndexed<GLbyte, GLshort, convertByteSpan>(
+            in, strideIn, out, strideOut, attribSize, indicesType, indices,
+            count);
+}
@@ -0,0 +1,187 @@
+// Copyright 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <GLcommon/VertexConversion.h>
+
+#include <GLcommon/GLconversion_macros.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+// Vertex counts that exercise the vector loops and their tails.
+constexpr size_t kCounts[] = {0, 1, 3, 5, 17, 1000};
+
+template <class T>
+std::vector<char> makeArray(size_t count, size_t stride, int attribSize) {
+    std::mt19937 rng(count * 7 + stride * 3 + attribSize);
+    std::uniform_int_distribution<int64_t> dist(INT32_MIN, INT32_MAX);
+    // Random bytes everywhere, including the padding between vertices.
+    std::vector<char> data(count * stride + attribSize * sizeof(T));
+    for (auto& byte : data) {
+        byte = (char)dist(rng);
+    }
+    return data;
+}
+
+template <class In, class Out>
+void expectConverted(const char* in, size_t strideIn, const char* out,
+                     size_t strideOut, int attribSize, size_t index) {
+    const In* src = (const In*)(in + index * strideIn);
+    const Out* dst = (const Out*)(out + index * strideOut);
+    for (int j = 0; j < attribSize; ++j) {
+        Out expected;
+        if (sizeof(In) == sizeof(GLfixed)) {
+            expected = X2F(src[j]);
+        } else {
+            expected = B2S(src[j]);
+        }
+        ASSERT_EQ(expected, dst[j]) << "vertex " << index << " component " << j;
+    }
+}
+
+}  // namespace
+
+TEST(VertexConversion, FixedToFloat) {
+    for (int attribSize = 1; attribSize <= 4; ++attribSize) {
+        const size_t packed = attribSize * sizeof(GLfixed);
+        for (size_t strideIn : {packed, (size_t)32}) {
+            for (size_t count : kCounts) {
+                auto in = makeArray<GLfixed>(count, strideIn, attribSize);
+                std::vector<char> out(count * packed + 1);
+                convertFixedToFloat(in.data(), strideIn, out.data(), packed,
+                                    attribSize, count);
+                for (size_t i = 0; i < count; ++i) {
+                    expectConverted<GLfixed, GLfloat>(in.data(), strideIn,
+                                                      out.data(), packed,
+                                                      attribSize, i);
+                }
+            }
+        }
+    }
+}
+
+TEST(VertexConversion, FixedToFloatInPlace) {
+    for (int attribSize = 1; attribSize <= 4; ++attribSize) {
+        const size_t packed = attribSize * sizeof(GLfixed);
+        for (size_t stride : {packed, (size_t)20}) {
+            auto in = makeArray<GLfixed>(100, stride, attribSize);
+            auto data = in;
+            convertFixedToFloat(data.data(), stride, data.data(), stride,
+                                attribSize, 100);
+            for (size_t i = 0; i < 100; ++i) {
+                expectConverted<GLfixed, GLfloat>(in.data(), stride,
+                                                  data.data(), stride,
+                                                  attribSize, i);
+            }
+        }
+    }
+}
+
+TEST(VertexConversion, ByteToShort) {
+    for (int attribSize = 1; attribSize <= 4; ++attribSize) {
+        const size_t packedIn = attribSize * sizeof(GLbyte);
+        const size_t packedOut = attribSize * sizeof(GLshort);
+        for (size_t strideIn : {packedIn, (size_t)12}) {
+            for (size_t count : kCounts) {
+                auto in = makeArray<GLbyte>(count, strideIn, attribSize);
+                std::vector<char> out(count * packedOut + 1);
+                convertByteToShort(in.data(), strideIn, out.data(), packedOut,
+                                   attribSize, count);
+                for (size_t i = 0; i < count; ++i) {
+                    expectConverted<GLbyte, GLshort>(in.data(), strideIn,
+                                                     out.data(), packedOut,
+                                                     attribSize, i);
+                }
+            }
+        }
+    }
+}
+
+TEST(VertexConversion, Indexed) {
+    const std::vector<GLushort> indices = {7, 0, 3, 3, 9, 1};
+    const int attribSize = 3;
+    const size_t strideIn = 16;
+    auto fixedIn = makeArray<GLfixed>(10, strideIn, attribSize);
+    auto byteIn = makeArray<GLbyte>(10, strideIn, attribSize);
+    std::vector<char> floatOut(10 * attribSize * sizeof(GLfloat));
+    std::vector<char> shortOut(10 * attribSize * sizeof(GLshort));
+
+    convertFixedToFloatIndexed(fixedIn.data(), strideIn, floatOut.data(),
+                               attribSize * sizeof(GLfloat), attribSize,
+                               GL_UNSIGNED_SHORT, indices.data(),
+                               indices.size());
+    convertByteToShortIndexed(byteIn.data(), strideIn, shortOut.data(),
+                              attribSize * sizeof(GLshort), attribSize,
+                              GL_UNSIGNED_SHORT, indices.data(),
+                              indices.size());
+    for (GLushort index : indices) {
+        expectConverted<GLfixed, GLfloat>(fixedIn.data(), strideIn,
+                                          floatOut.data(),
+                                          attribSize * sizeof(GLfloat),
+                                          attribSize, index);
+        expectConverted<GLbyte, GLshort>(byteIn.data(), strideIn,
+                                         shortOut.data(),
+                                         attribSize * sizeof(GLshort),
+                                         attribSize, index);
+    }
+}
+
+// Throughput over layouts GLES1 apps use: packed positions, and positions,
+// normals and texture coordinates interleaved in one array.
+TEST(VertexConversion, DISABLED_Benchmark) {
+    struct Layout {
+        const char* name;
+        GLenum type;
+        int attribSize;
+        size_t stride;
+    };
+    const Layout layouts[] = {
+            {"fixed xyz packed", GL_FIXED, 3, 12},
+            {"fixed xyzw packed", GL_FIXED, 4, 16},
+            {"fixed xyz interleaved", GL_FIXED, 3, 32},
+            {"fixed uv interleaved", GL_FIXED, 2, 32},
+            {"byte xyz packed", GL_BYTE, 3, 3},
+            {"byte uv interleaved", GL_BYTE, 2, 8},
+    };
+    constexpr size_t kVertices = 10000;
+    constexpr int kIterations = 1000;
+    std::vector<char> in(kVertices * 32 + 16);
+    std::vector<char> out(kVertices * 4 * sizeof(GLfloat));
+    for (const auto& layout : layouts) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kIterations; ++i) {
+            if (layout.type == GL_FIXED) {
+                convertFixedToFloat(in.data(), layout.stride, out.data(),
+                                    layout.attribSize * sizeof(GLfloat),
+                                    layout.attribSize, kVertices);
+            } else {
+                convertByteToShort(in.data(), layout.stride, out.data(),
+                                   layout.attribSize * sizeof(GLshort),
+                                   layout.attribSize, kVertices);
+            }
+        }
+        const double ns = std::chrono::duration<double, std::nano>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+        printf("%-24s %.2f ns/vertex\n", layout.name,
+               ns / (kVertices * kIterations));
+    }
+}
@@ -23,19 +23,30 @@
 
 #include <atomic>
 #include <memory>
+#include <vector>
 
+// GLBackgroundLoader restores the textures of a loaded snapshot onto the GPU
+// in the background. Textures are restored in the order they were saved in
+// (most recently used first); a texture that a render thread needs earlier is
+// restored on demand by SaveableTexture::touch() and skipped here. The delay
+// between restores adapts to render thread activity: it backs off while the
+// guest is presenting frames or hitting unrestored textures, and drops to
+// zero while the guest is idle.
 class GLBackgroundLoader : public emugl::InterruptibleThread {
 public:
     GLBackgroundLoader(const android::snapshot::ITextureLoaderWPtr& textureLoaderWeak,
                        const EGLiface& eglIface,
                        const GLESiface& glesIface,
-                       SaveableTextureMap& textureMap) :
+                       SaveableTextureMap& textureMap,
+                       std::vector<SaveableTexturePtr>&& restoreOrder) :
         m_textureLoaderWPtr(textureLoaderWeak),
         m_eglIface(eglIface),
         m_glesIface(glesIface),
-        m_textureMap(textureMap) { }
+        m_textureMap(textureMap),
+        m_restoreOrder(std::move(restoreOrder)) { }
     ~GLBackgroundLoader() {
         wait(nullptr);
+        m_restoreOrder.clear();
         m_textureMap.clear();
     }
 
@@ -44,7 +55,9 @@ public:
     void interrupt() override;
 
 private:
-    std::atomic<int> m_loadDelayMs { 10 };
+    // Upper bound of the adaptive delay between two restores; wait() drops
+    // it to zero to finish loading as fast as possible.
+    std::atomic<int> m_maxLoadDelayMs { 10 };
     std::atomic<bool> m_interrupted { false };
 
     const android::snapshot::ITextureLoaderWPtr m_textureLoaderWPtr;
@@ -52,4 +65,5 @@ private:
     const GLESiface& m_glesIface;
 
     SaveableTextureMap& m_textureMap;
+    std::vector<SaveableTexturePtr> m_restoreOrder;
 };
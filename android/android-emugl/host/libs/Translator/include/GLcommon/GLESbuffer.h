@@ -21,6 +21,11 @@
 #include <GLES/gl.h>
 #include <GLcommon/ObjectData.h>
 #include <GLcommon/RangeManip.h>
+#include "emugl/common/mutex.h"
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
 
 class GLESbuffer: public ObjectData {
 public:
@@ -39,14 +44,49 @@ public:
    bool  fullyConverted(){return m_conversionManager.size() == 0;};
    void  setBinded(){m_wasBound = true;};
    bool  wasBinded(){return m_wasBound;};
+
+   // Layout of a vertex array converted out of the buffer data.
+   struct ConversionKey {
+       GLenum       type;
+       GLint        size;
+       GLsizei      stride;
+       unsigned int offset;
+   };
+   using ConversionData = std::shared_ptr<std::vector<unsigned char>>;
+   // Changes whenever the buffer data does.
+   uint64_t generation();
+   // Returns the converted data of the array |key|, which holds at least
+   // |vertexCount| vertices from its offset, or nullptr if there is none
+   // since the buffer data last changed. The caller keeps its reference
+   // until it is done drawing from the data, as later conversions may evict
+   // it from the buffer.
+   ConversionData findConversion(const ConversionKey& key,
+                                 GLsizei vertexCount);
+   // Keeps |data|, converted out of the buffer data at |generation|, to be
+   // returned by findConversion() until the buffer data changes.
+   void addConversion(const ConversionKey& key, GLsizei vertexCount,
+                      uint64_t generation, ConversionData data);
    ~GLESbuffer();
 
 private:
+    struct Conversion {
+        ConversionKey key;
+        GLsizei vertexCount;
+        uint64_t generation;
+        ConversionData data;
+    };
+
     GLuint         m_size = 0;
     GLuint         m_usage = GL_STATIC_DRAW;
     unsigned char* m_data = nullptr;
     RangeList      m_conversionManager;
     bool           m_wasBound = false;
+    // Contexts of a share group draw from the same buffers concurrently.
+    emugl::Mutex   m_conversionLock;
+    // Bumped whenever m_data changes, invalidating m_conversions.
+    uint64_t       m_generation = 0;
+    std::vector<Conversion> m_conversions;
+    size_t         m_nextConversion = 0;
 };
 
 #endif
@@ -27,6 +27,7 @@
 #include "ShareGroup.h"
 
 #include <memory>
+#include <stdint.h>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -194,6 +195,8 @@ class GLESConversionArrays
 {
 public:
     void setArr(void* data,unsigned int stride,GLenum type);
+    // Like setArr(), keeping |data| alive for as long as the arrays are.
+    void setArr(std::shared_ptr<std::vector<unsigned char>> data,GLenum type);
     void allocArr(unsigned int size,GLenum type);
     ArrayData& operator[](int i);
     void* getCurrentData();
@@ -204,6 +207,7 @@ public:
     ~GLESConversionArrays();
 private:
     std::unordered_map<GLenum,ArrayData> m_arrays;
+    std::vector<std::shared_ptr<std::vector<unsigned char>>> m_sharedArrays;
     unsigned int m_current = 0;
 };
 
@@ -228,6 +232,9 @@ public:
     void setTextureEnabled(GLenum target, GLenum enable);
     ObjectLocalName getDefaultTextureName(GLenum target);
     ObjectLocalName getTextureLocalName(GLenum target, unsigned int tex);
+    // Stamps the textures bound to the used units as used in the current
+    // frame. Called on draws; walks the units at most once per frame.
+    void markBoundTexturesUsed();
     bool isInitialized() { return m_initialized; };
     bool needRestore();
     GLint getUnpackAlignment();
@@ -632,6 +639,7 @@ private:
     int                   m_maxTexUnits;
     unsigned int          m_maxUsedTexUnit = 0;
     textureUnitState*     m_texState = nullptr;
+    uint64_t              m_texUsageFrame = UINT64_MAX;
     unsigned int          m_arrayBuffer = 0;
     unsigned int          m_elementBuffer = 0;
     GLuint                m_renderbuffer = 0;
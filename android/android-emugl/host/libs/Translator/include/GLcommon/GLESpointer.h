@@ -40,6 +40,7 @@ public:
     const GLfloat* getValues() const;
     unsigned int getValueCount() const;
     GLuint getBufferName() const;
+    GLESbuffer* getBuffer() const { return m_buffer; }
     GLboolean getNormalized() const { return m_normalize ? GL_TRUE : GL_FALSE; }
     const GLvoid* getData() const;
     const GLsizei getDataSize() const { return m_dataSize; }
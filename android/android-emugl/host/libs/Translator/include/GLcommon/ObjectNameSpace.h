@@ -26,6 +26,7 @@
 #include "GLcommon/TranslatorIfaces.h"
 
 #include <GLES/gl.h>
+#include <atomic>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -154,6 +155,10 @@ public:
 
     void clearTextureMap();
 
+    // Called once per host frame. Advances the texture usage clock and
+    // reports the first frame after a snapshot load to the texture loader.
+    void onFrame();
+
     void setIfaces(const EGLiface* eglIface,
                    const GLESiface* glesIface) {
         m_eglIface = eglIface;
@@ -169,6 +174,10 @@ private:
 
     std::shared_ptr<GLBackgroundLoader>     m_backgroundLoader;
 
+    // Texture loader of the last snapshot load, waiting for the first frame.
+    android::snapshot::ITextureLoaderWPtr m_firstFrameLoaderWPtr;
+    std::atomic<bool> m_firstFramePending { false };
+
     const EGLiface* m_eglIface = nullptr;
     const GLESiface* m_glesIface = nullptr;
 };
@@ -84,11 +84,23 @@ public:
 
     unsigned int getGlobalName();
 
+    // Usage tracking, used to restore the textures the guest draws with
+    // first after loading a snapshot.
+    // markUsed() records the current frame as the last use of the texture;
+    // advanceFrame() is called once per host frame.
+    void markUsed();
+    uint64_t getLastUsedFrame() const;
+    static void advanceFrame();
+    static uint64_t getCurrentFrame();
+
     // precondition: (1) a context must be properly bound
     //               (2) m_fileReader is set up
     void restore();
 
 private:
+    // Creates the texture on the GPU from the loaded level data.
+    void upload();
+
     unsigned int m_target = GL_TEXTURE_2D;
     unsigned int m_width = 0;
     unsigned int m_height = 0;
@@ -108,6 +120,16 @@ private:
         unsigned int m_height = 0;
         unsigned int m_depth = 0;
         android::base::SmallFixedVector<unsigned char, 16> m_data;
+        // Used instead of m_data for levels read in place from a file
+        // mapping.
+        const void* m_mappedData = nullptr;
+
+        const void* pixels() const {
+            if (m_mappedData) {
+                return m_mappedData;
+            }
+            return m_data.empty() ? nullptr : m_data.data();
+        }
     };
     std::unique_ptr<LevelImageData[]> m_levelData[6] = {};
     std::unordered_map<GLenum, GLint> m_texParam;
@@ -115,6 +137,7 @@ private:
     GlobalNameSpace* m_globalNamespace = nullptr;
     bool m_isDirty = true;
     std::atomic<bool> m_loadedFromStream { false };
+    std::atomic<uint64_t> m_lastUsedFrame { 0 };
 };
 
 typedef std::shared_ptr<SaveableTexture> SaveableTexturePtr;
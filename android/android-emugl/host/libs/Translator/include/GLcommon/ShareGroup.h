@@ -22,7 +22,6 @@
 #include "GLcommon/NamedObject.h"
 #include "GLcommon/ObjectData.h"
 
-#include <atomic>
 #include <GLES/gl.h>
 #include <unordered_map>
 #include <unordered_set>
@@ -41,7 +40,9 @@ class NameSpace;
 //   there will be one inctance of ShareGroup for each user OpenGL context
 //   unless the user context share with another user context. In that case they
 //   both will share the same ShareGroup instance.
-//   calls into that class gets serialized through a lock so it is thread safe.
+//   calls into that class are thread safe. Each object type has its own
+//   namespace lock, so that contexts binding objects of different types
+//   don't wait on each other, and lookups of the same type run concurrently.
 //
 class ShareGroup
 {
@@ -123,32 +124,32 @@ private:
                         android::base::Stream* stream,
                         const ObjectData::loadObject_t& loadObject);
 
-    void lockObjectData();
-    void unlockObjectData();
-    void setObjectDataLocked(NamedObjectType p_type,
-            ObjectLocalName p_localName, ObjectDataPtr&& data);
     //
     // sets an object to map to an existing global object.
     //
     void setGlobalObject(NamedObjectType p_type, ObjectLocalName p_localName,
             NamedObjectPtr p_namedObject);
 
-    // A RAII autolock class for the objectData spinlock.
-    struct ObjectDataAutoLock;
+    // A RAII autolock class holding all namespace locks for writing.
+    struct AllNameSpacesAutoLock;
 
 private:
     const ObjectDataPtr& getObjectDataPtrNoLock(NamedObjectType p_type,
                                                 ObjectLocalName p_localName);
 
-    emugl::Mutex m_namespaceLock;
+    // Guards the names and object data of one namespace: lookups take it
+    // for reading, anything that adds, removes or replaces an entry takes it
+    // for writing. Locks of different types sit on different cache lines.
+    struct alignas(64) NameSpaceLock {
+        emugl::ReadWriteMutex lock;
+    };
+    emugl::ReadWriteMutex& nameSpaceLock(NamedObjectType p_type) {
+        return m_nameSpaceLocks[static_cast<int>(p_type)].lock;
+    }
+
+    NameSpaceLock m_nameSpaceLocks[static_cast<int>(NamedObjectType::NUM_OBJECT_TYPES)];
     emugl::Mutex m_restoreLock;
     NameSpace* m_nameSpace[static_cast<int>(NamedObjectType::NUM_OBJECT_TYPES)];
-
-    // |m_objectsData| has no measured data races, so replace heavyweight mutex
-    // with a simple spinlock - just in case if there's some missed
-    // multi-threaded access path.
-    // TODO(zyy@): Create a common spinlock class.
-    std::atomic_flag m_objectsDataLock = ATOMIC_FLAG_INIT;
     // The ID of this shared group
     // It is unique within its ObjectNameManager
     uint64_t m_sharedGroupID;
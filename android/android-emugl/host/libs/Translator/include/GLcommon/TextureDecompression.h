@@ -0,0 +1,100 @@
+/*
+* Copyright (C) 2020 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include "GLcommon/etc.h"
+
+#include "android/base/synchronization/Lock.h"
+
+#include <GLES/gl.h>
+#include <astc-codec/astc-codec.h>
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// CPU decompression of the ETC2/EAC and ASTC images hosts can't sample.
+// Rows of blocks decode independently, so large images are split in bands
+// decoded on a shared thread pool; small ones decode on the calling thread.
+
+// Same as etc2_decode_image(), returns true on success.
+bool decodeEtc2Image(const etc1_byte* in, ETC2ImageFormat format,
+                     etc1_byte* out, int width, int height, int stride);
+
+// Same as astc_codec::ASTCDecompressToRGBA().
+bool decodeAstcImage(const uint8_t* in, size_t inSize, int width, int height,
+                     astc_codec::FootprintType footprint, uint8_t* out,
+                     size_t outSize, int stride);
+
+// DecompressedTextureCache keeps recently decoded images, keyed by their
+// compressed bytes, so that apps uploading the same assets again (or several
+// guest processes uploading the same system textures) skip the decode.
+class DecompressedTextureCache {
+public:
+    using Pixels = std::shared_ptr<const std::vector<uint8_t>>;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t bytes = 0;
+    };
+
+    // The process wide cache.
+    static DecompressedTextureCache* get();
+
+    static constexpr size_t kDefaultMaxBytes = 64 * 1024 * 1024;
+
+    explicit DecompressedTextureCache(size_t maxBytes = kDefaultMaxBytes);
+
+    // Returns the pixels stored for |data| decoded as |internalformat| at
+    // |width|x|height| with rows |stride| bytes apart, or null.
+    Pixels lookup(GLenum internalformat, GLsizei width, GLsizei height,
+                  GLsizei stride, const void* data, size_t dataSize);
+    // Keeps |pixels| for later lookups; too small and too large images are
+    // not worth the memory and are ignored.
+    void store(GLenum internalformat, GLsizei width, GLsizei height,
+               GLsizei stride, const void* data, size_t dataSize,
+               Pixels pixels);
+
+    Stats getStats() const;
+
+private:
+    struct Entry {
+        uint64_t hash;
+        GLenum internalformat;
+        GLsizei width;
+        GLsizei height;
+        GLsizei stride;
+        std::vector<uint8_t> compressed;
+        Pixels pixels;
+    };
+    using EntryList = std::list<Entry>;
+
+    bool isCacheable(GLsizei width, GLsizei height, size_t dataSize) const;
+    EntryList::iterator findLocked(uint64_t hash, GLenum internalformat,
+                                   GLsizei width, GLsizei height,
+                                   GLsizei stride, const void* data,
+                                   size_t dataSize);
+    void evictLocked();
+
+    const size_t mMaxBytes;
+    mutable android::base::Lock mLock;
+    // Most recently used first.
+    EntryList mEntries;
+    std::unordered_multimap<uint64_t, EntryList::iterator> mIndex;
+    Stats mStats;
+};
@@ -0,0 +1,48 @@
+/*
+* Copyright (C) 2020 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include <GLES/gl.h>
+
+#include <stddef.h>
+
+// Conversion of vertex attributes the host GL can't take as is: GL_FIXED to
+// GL_FLOAT, and GL_BYTE to GL_SHORT for GLES1 vertex and texture coordinate
+// arrays. Tightly packed arrays and 4-component attributes use SSE2 on
+// x86_64 and NEON on arm64.
+//
+// Each function converts |count| vertices of |attribSize| components, read
+// |strideIn| bytes apart from |in| and written |strideOut| bytes apart to
+// |out|. Fixed point arrays may be converted in place, with |in| == |out|
+// and equal strides.
+
+void convertFixedToFloat(const void* in, size_t strideIn,
+                         void* out, size_t strideOut,
+                         int attribSize, size_t count);
+void convertByteToShort(const void* in, size_t strideIn,
+                        void* out, size_t strideOut,
+                        int attribSize, size_t count);
+
+// Same, for the vertices at |count| |indices| of |indicesType|. Each vertex
+// keeps its index in |out|.
+void convertFixedToFloatIndexed(const void* in, size_t strideIn,
+                                void* out, size_t strideOut,
+                                int attribSize, GLenum indicesType,
+                                const void* indices, size_t count);
+void convertByteToShortIndexed(const void* in, size_t strideIn,
+                               void* out, size_t strideOut,
+                               int attribSize, GLenum indicesType,
+                               const void* indices, size_t count);
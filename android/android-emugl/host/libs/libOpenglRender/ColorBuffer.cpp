@@ -827,32 +827,35 @@ void ColorBuffer::readback(unsigned char* img, bool readbackBgra) {
     touch();
     waitSync();
 
-    if (bindFbo(&m_fbo, m_tex)) {
-        // Flip the readback format if RED/BLUE components are swizzled.
-        bool shouldReadbackBgra = m_BRSwizzle ? !readbackBgra : readbackBgra;
-        GLenum format = shouldReadbackBgra ? GL_BGRA_EXT : GL_RGBA;
-
-        s_gles2.glReadPixels(0, 0, m_width, m_height, format, GL_UNSIGNED_BYTE, img);
-        unbindFbo();
-    }
+    readbackPixels(img, readbackBgra, GL_UNSIGNED_BYTE);
 }
 
-void ColorBuffer::readbackAsync(GLuint buffer, bool readbackBgra) {
+bool ColorBuffer::readbackAsync(GLuint buffer, bool readbackBgra) {
     RecursiveScopedHelperContext context(m_helper);
     if (!context.isOk()) {
-        return;
+        return false;
     }
     touch();
     waitSync();
 
-    if (bindFbo(&m_fbo, m_tex)) {
-        s_gles2.glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
-        bool shouldReadbackBgra = m_BRSwizzle ? !readbackBgra : readbackBgra;
-        GLenum format = shouldReadbackBgra ? GL_BGRA_EXT : GL_RGBA;
-        s_gles2.glReadPixels(0, 0, m_width, m_height, format, m_asyncReadbackType, 0);
-        s_gles2.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
-        unbindFbo();
+    s_gles2.glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    bool res = readbackPixels(nullptr, readbackBgra, m_asyncReadbackType);
+    s_gles2.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return res;
+}
+
+bool ColorBuffer::readbackPixels(void* pixels,
+                                 bool readbackBgra,
+                                 GLenum type) {
+    if (!bindFbo(&m_fbo, m_tex)) {
+        return false;
     }
+    // Flip the readback format if RED/BLUE components are swizzled.
+    bool shouldReadbackBgra = m_BRSwizzle ? !readbackBgra : readbackBgra;
+    GLenum glFormat = shouldReadbackBgra ? GL_BGRA_EXT : GL_RGBA;
+    s_gles2.glReadPixels(0, 0, m_width, m_height, glFormat, type, pixels);
+    unbindFbo();
+    return true;
 }
 
 HandleType ColorBuffer::getHndl() const {
@@ -235,8 +235,11 @@ public:
     // Read the content of the whole ColorBuffer as 32-bit RGBA pixels.
     // |img| must be a buffer large enough (i.e. width * height * 4).
     void readback(unsigned char* img, bool readbackBgra = false);
-    // readback() but async (to the specified |buffer|)
-    void readbackAsync(GLuint buffer, bool readbackBgra = false);
+    // readback() but async (to the specified |buffer|). The caller is
+    // responsible for waiting for the read to complete before mapping
+    // |buffer|, e.g. with a fence created right after this call.
+    // Returns false if nothing was read.
+    bool readbackAsync(GLuint buffer, bool readbackBgra = false);
 
     void onSave(android::base::Stream* stream);
     static ColorBuffer* onLoad(android::base::Stream* stream,
@@ -274,6 +277,11 @@ public:
 private:
     ColorBuffer(EGLDisplay display, HandleType hndl, Helper* helper);
 
+    // Reads the whole ColorBuffer to |pixels|, or to the offset |pixels| of
+    // the bound GL_PIXEL_PACK_BUFFER. Must be called with the helper context
+    // bound.
+    bool readbackPixels(void* pixels, bool readbackBgra, GLenum type);
+
 private:
     GLuint m_tex = 0;
     GLuint m_blitTex = 0;
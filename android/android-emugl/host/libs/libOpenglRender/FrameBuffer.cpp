@@ -291,8 +291,9 @@ void FrameBuffer::finalize() {
 
     sweepColorBuffersLocked();
 
+    m_bufferRegistry.clear();
     m_buffers.clear();
-    m_colorbuffers.clear();
+    clearColorBuffersLocked();
     m_colorBufferDelayedCloseList.clear();
     if (m_useSubWindow) {
         removeSubWindow_locked();
@@ -747,9 +748,26 @@ FrameBuffer::FrameBuffer(int p_width, int p_height, bool useSubWindow)
      setDisplayPose(displayId, 0, 0, getWidth(), getHeight(), 0);
      m_perfThread->start();
 
+     m_postPacer.reset(new PostPacer(
+             [this](uint32_t displayId, uint32_t colorBuffer) {
+                 bool res = postImpl(colorBuffer, true /* needLockAndBind */,
+                                     false /* repaint */, true /* fromPacer */);
+                 if (res) {
+                     onFramePosted();
+                 }
+                 return res;
+             }));
+     const std::string pacingHz =
+             System::getEnvironmentVariable("ANDROID_EMUGL_POST_PACING_HZ");
+     if (!pacingHz.empty()) {
+         setPostPacing(atoi(pacingHz.c_str()));
+     }
 }
 
 FrameBuffer::~FrameBuffer() {
+    // Stop presenting queued frames first, the pacing thread takes m_lock.
+    m_postPacer.reset();
+
     finalize();
 
     if (m_postThread.isStarted()) {
@@ -784,7 +802,9 @@ FrameBuffer::sendReadbackWorkerCmd(const Readback& readback) {
         m_readbackWorker->getPixels(readback.displayId, readback.pixelsOut, readback.bytes);
         return WorkerProcessingResult::Continue;
     case ReadbackCmd::AddRecordDisplay:
-        m_readbackWorker->setRecordDisplay(readback.displayId, readback.width, readback.height, true);
+        m_readbackWorker->setRecordDisplay(readback.displayId, readback.width,
+                                           readback.height, true,
+                                           readback.readbackBgra);
         return WorkerProcessingResult::Continue;
     case ReadbackCmd::DelRecordDisplay:
         m_readbackWorker->setRecordDisplay(readback.displayId, 0, 0, false);
@@ -800,6 +820,7 @@ FrameBuffer::postWorkerFunc(const Post& post) {
     switch (post.cmd) {
         case PostCmd::Post:
             m_postWorker->post(post.cb);
+            m_lastPresentTimeUs = System::get()->getHighResTimeUs();
             break;
         case PostCmd::Viewport:
             m_postWorker->viewport(post.viewport.width,
@@ -882,7 +903,8 @@ void FrameBuffer::setPostCallback(
             m_readbackThread.start();
             m_readbackThread.enqueue({ ReadbackCmd::Init });
         }
-        m_readbackThread.enqueue({ ReadbackCmd::AddRecordDisplay, displayId, 0, nullptr, 0, w, h });
+        m_readbackThread.enqueue({ ReadbackCmd::AddRecordDisplay, displayId,
+                                   0, nullptr, 0, w, h, useBgraReadback });
         m_readbackThread.waitQueuedItems();
     } else {
         m_readbackThread.enqueue({ ReadbackCmd::DelRecordDisplay, displayId });
@@ -1198,6 +1220,7 @@ HandleType FrameBuffer::createColorBufferWithHandleLocked(
                 m_colorbuffers[handle] = {std::move(cb), 0, false, 0};
             }
         }
+        m_colorBufferRegistry.add(handle, m_colorbuffers[handle].cb);
     } else {
         handle = 0;
         DBG("Create color buffer failed.\n");
@@ -1237,6 +1260,7 @@ HandleType FrameBuffer::createBufferWithHandleLocked(int p_size,
     BufferPtr buffer(Buffer::create(p_size, handle));
 
     if (buffer) {
+        m_bufferRegistry.add(handle, buffer);
         m_buffers[handle] = {std::move(buffer)};
     } else {
         handle = 0;
@@ -1511,6 +1535,7 @@ void FrameBuffer::closeBuffer(HandleType p_buffer) {
             static_cast<uint32_t>(p_buffer));
     } else {
         goldfish_vk::teardownVkBuffer(p_buffer);
+        m_bufferRegistry.remove(p_buffer);
         m_buffers.erase(p_buffer);
     }
 }
@@ -1544,7 +1569,7 @@ bool FrameBuffer::closeColorBufferLocked(HandleType p_colorbuffer,
     if (--c->second.refcount == 0) {
         if (forced) {
             eraseDelayedCloseColorBufferLocked(c->first, c->second.closedTs);
-            m_colorbuffers.erase(c);
+            eraseColorBufferLocked(c);
             deleted = true;
         } else {
             c->second.closedTs = System::get()->getUnixTime();
@@ -1573,7 +1598,7 @@ void FrameBuffer::performDelayedColorBufferCloseLocked(bool forced) {
         if (it->cbHandle != 0) {
             const auto& cb = m_colorbuffers.find(it->cbHandle);
             if (cb != m_colorbuffers.end()) {
-                m_colorbuffers.erase(cb);
+                eraseColorBufferLocked(cb);
             }
         }
         ++it;
@@ -1965,32 +1990,33 @@ bool FrameBuffer::getColorBufferInfo(
 }
 
 bool FrameBuffer::getBufferInfo(HandleType p_buffer, int* size) {
-    AutoLock mutex(m_lock);
-
-    BufferMap::iterator c(m_buffers.find(p_buffer));
-    if (c == m_buffers.end()) {
-        // Bad buffer handle.
-        return false;
-    }
-
-    auto buf = (*c).second.buffer;
-    *size = buf->getSize();
-    return true;
+    // Buffer sizes never change, no need for m_lock.
+    return m_bufferRegistry.with(p_buffer, [size](Buffer& buf) {
+        *size = buf.getSize();
+    });
 }
 
-bool FrameBuffer::bindColorBufferToTexture(HandleType p_colorbuffer) {
-    AutoLock mutex(m_lock);
-
-    ColorBufferMap::iterator c(m_colorbuffers.find(p_colorbuffer));
-    if (c == m_colorbuffers.end()) {
+bool FrameBuffer::bindColorBuffer(HandleType p_colorbuffer,
+                                  bool (ColorBuffer::*bindFunc)()) {
+    // Binding only attaches the color buffer's EGLImage to the calling
+    // thread's context, so it doesn't need m_lock. The exception is a color
+    // buffer that still needs to be restored from a snapshot: restoring uses
+    // the shared helper context, which is guarded by m_lock.
+    bool res = false;
+    bool needRestore = false;
+    if (!m_colorBufferRegistry.with(p_colorbuffer, [&](ColorBuffer& cb) {
+            needRestore = cb.needRestore();
+            if (!needRestore) {
+                res = (cb.*bindFunc)();
+            }
+        })) {
         // bad colorbuffer handle
         return false;
     }
+    if (!needRestore) {
+        return res;
+    }
 
-    return (*c).second.cb->bindToTexture();
-}
-
-bool FrameBuffer::bindColorBufferToTexture2(HandleType p_colorbuffer) {
     AutoLock mutex(m_lock);
 
     ColorBufferMap::iterator c(m_colorbuffers.find(p_colorbuffer));
@@ -1999,19 +2025,19 @@ bool FrameBuffer::bindColorBufferToTexture2(HandleType p_colorbuffer) {
         return false;
     }
 
-    return (*c).second.cb->bindToTexture2();
+    return ((*c).second.cb.get()->*bindFunc)();
 }
 
-bool FrameBuffer::bindColorBufferToRenderbuffer(HandleType p_colorbuffer) {
-    AutoLock mutex(m_lock);
+bool FrameBuffer::bindColorBufferToTexture(HandleType p_colorbuffer) {
+    return bindColorBuffer(p_colorbuffer, &ColorBuffer::bindToTexture);
+}
 
-    ColorBufferMap::iterator c(m_colorbuffers.find(p_colorbuffer));
-    if (c == m_colorbuffers.end()) {
-        // bad colorbuffer handle
-        return false;
-    }
+bool FrameBuffer::bindColorBufferToTexture2(HandleType p_colorbuffer) {
+    return bindColorBuffer(p_colorbuffer, &ColorBuffer::bindToTexture2);
+}
 
-    return (*c).second.cb->bindToRenderbuffer();
+bool FrameBuffer::bindColorBufferToRenderbuffer(HandleType p_colorbuffer) {
+    return bindColorBuffer(p_colorbuffer, &ColorBuffer::bindToRenderbuffer);
 }
 
 bool FrameBuffer::bindContext(HandleType p_context,
@@ -2314,14 +2340,36 @@ void FrameBuffer::unbindAndDestroyTrivialSharedContext(EGLContext context,
 }
 
 bool FrameBuffer::post(HandleType p_colorbuffer, bool needLockAndBind) {
-    bool res = postImpl(p_colorbuffer, needLockAndBind);
-    if (res) setGuestPostedAFrame();
+    bool queued = false;
+    bool res = postImpl(p_colorbuffer, needLockAndBind, false /* repaint */,
+                        false /* fromPacer */, &queued);
+    // A paced frame is reported by the pacing thread once it is shown, and
+    // not at all if a newer post replaces it first.
+    if (res && !queued) {
+        onFramePosted();
+    }
     return res;
 }
 
+void FrameBuffer::onFramePosted() {
+    setGuestPostedAFrame();
+    // Also reached from compose(); counts frames for the snapshot
+    // texture restore order and reports the first frame after a load,
+    // with or without a window to swap into.
+    if (s_egl.eglOnFramePosted) {
+        s_egl.eglOnFramePosted(m_eglDisplay);
+    }
+}
+
 bool FrameBuffer::postImpl(HandleType p_colorbuffer,
                            bool needLockAndBind,
-                           bool repaint) {
+                           bool repaint,
+                           bool fromPacer,
+                           bool* queued) {
+    const uint64_t postTimeUs = System::get()->getHighResTimeUs();
+    uint64_t presentTimeUs = 0;
+    uint32_t displayId = 0;
+
     if (needLockAndBind) {
         m_lock.lock();
     }
@@ -2337,6 +2385,20 @@ bool FrameBuffer::postImpl(HandleType p_colorbuffer,
 
     ret = true;
 
+    if (getColorBufferDisplay(p_colorbuffer, &displayId) < 0) {
+        displayId = 0;
+    }
+    if (!repaint && !fromPacer && m_postPacer->post(displayId, p_colorbuffer)) {
+        // Paced: the pacing thread shows the latest frame at the next host
+        // refresh, unless the guest posts another one before that.
+        markOpened(&c->second);
+        c->second.cb->touch();
+        if (queued) {
+            *queued = true;
+        }
+        goto EXIT;
+    }
+
     if (m_subWin) {
         markOpened(&c->second);
         c->second.cb->touch();
@@ -2345,18 +2407,34 @@ bool FrameBuffer::postImpl(HandleType p_colorbuffer,
         postCmd.cmd = PostCmd::Post;
         postCmd.cb = c->second.cb.get();
         sendPostWorkerCmd(postCmd);
+        presentTimeUs = m_lastPresentTimeUs;
     } else {
         markOpened(&c->second);
         c->second.cb->touch();
-        c->second.cb->waitSync();
-        c->second.cb->scale();
-        s_gles2.glFlush();
+
+        // The pacing thread has no GL context of its own, it uses the one
+        // of the color buffer helper.
+        std::unique_ptr<ColorBuffer::RecursiveScopedHelperContext> context;
+        if (fromPacer) {
+            context.reset(new ColorBuffer::RecursiveScopedHelperContext(
+                    m_colorBufferHelper));
+        }
+        if (!context || context->isOk()) {
+            c->second.cb->waitSync();
+            c->second.cb->scale();
+            s_gles2.glFlush();
+        }
+        presentTimeUs = System::get()->getHighResTimeUs();
 
         // If there is no sub-window, don't display anything, the client will
         // rely on m_onPost to get the pixels instead.
         ret = true;
     }
 
+    if (!repaint && !fromPacer) {
+        m_postPacer->onPresented(displayId, postTimeUs, presentTimeUs);
+    }
+
     //
     // output FPS and performance usage statistics
     //
@@ -2399,7 +2477,7 @@ bool FrameBuffer::postImpl(HandleType p_colorbuffer,
         if (m_asyncReadbackSupported) {
             ensureReadbackWorker();
             m_readbackWorker->doNextReadback(iter.first, cb.get(), iter.second.img,
-                repaint, iter.second.readBgra);
+                repaint);
         } else {
             cb->readback(iter.second.img, iter.second.readBgra);
             doPostCallback(iter.second.img, iter.first);
@@ -2419,8 +2497,9 @@ void FrameBuffer::doPostCallback(void* pixels, uint32_t displayId) {
         ERR("Cannot find post callback function for display %d", displayId);
         return;
     }
+    const GLenum format = iter->second.readBgra ? GL_BGRA_EXT : GL_RGBA;
     iter->second.cb(iter->second.context, displayId, iter->second.width,
-                    iter->second.height, -1, GL_RGBA, GL_UNSIGNED_BYTE,
+                    iter->second.height, -1, format, GL_UNSIGNED_BYTE,
                     (unsigned char*)pixels);
 }
 
@@ -2472,6 +2551,15 @@ emugl::Renderer::FlushReadPixelPipeline FrameBuffer::getFlushReadPixelPipeline()
     return sFrameBuffer_FlushReadPixelPipeline;
 }
 
+void FrameBuffer::setPostPacing(int refreshRateHz) {
+    GL_LOG("Post pacing: %d Hz", refreshRateHz);
+    m_postPacer->setRefreshRate(refreshRateHz);
+}
+
+emugl::FrameStats FrameBuffer::getFrameStats() const {
+    return m_postPacer->getStats();
+}
+
 bool FrameBuffer::repost(bool needLockAndBind) {
     GL_LOG("Reposting framebuffer.");
     if (m_lastPostedColorBuffer &&
@@ -2590,12 +2678,24 @@ void FrameBuffer::onLastColorBufferRef(uint32_t handle) {
     }
 }
 
+void FrameBuffer::eraseColorBufferLocked(ColorBufferMap::iterator c) {
+    // Remove from the registry first: this waits for lock-free readers, so
+    // the last reference is released here, under m_lock.
+    m_colorBufferRegistry.remove(c->first);
+    m_colorbuffers.erase(c);
+}
+
+void FrameBuffer::clearColorBuffersLocked() {
+    m_colorBufferRegistry.clear();
+    m_colorbuffers.clear();
+}
+
 bool FrameBuffer::decColorBufferRefCountLocked(HandleType p_colorbuffer) {
-    const auto& it = m_colorbuffers.find(p_colorbuffer);
+    auto it = m_colorbuffers.find(p_colorbuffer);
     if (it != m_colorbuffers.end()) {
         it->second.refcount -= 1;
         if (it->second.refcount == 0) {
-            m_colorbuffers.erase(p_colorbuffer);
+            eraseColorBufferLocked(it);
             return true;
         }
     }
@@ -2714,7 +2814,11 @@ void FrameBuffer::onSave(Stream* stream,
     // Save Vulkan state
     if (emugl::emugl_feature_is_enabled(android::featurecontrol::VulkanSnapshots) &&
         goldfish_vk::VkDecoderGlobalState::get()) {
-        goldfish_vk::VkDecoderGlobalState::get()->save(stream);
+        auto vk = goldfish_vk::VkDecoderGlobalState::get();
+        vk->save(stream);
+        const auto stats = vk->memorySnapshotStats();
+        textureSaver->setVulkanMemoryStats(stats.storedBytes,
+                                           stats.processUs + stats.streamUs);
     }
 
     if (s_egl.eglPostSaveContext) {
@@ -2752,7 +2856,7 @@ bool FrameBuffer::onLoad(Stream* stream,
             // process owned objects. We need to force cleanup everything
             m_contexts.clear();
             m_windows.clear();
-            m_colorbuffers.clear();
+            clearColorBuffersLocked();
         } else {
             std::vector<HandleType> colorBuffersToCleanup;
 
@@ -2812,7 +2916,7 @@ bool FrameBuffer::onLoad(Stream* stream,
         assert(m_windows.empty());
         if (!m_colorbuffers.empty()) {
             fprintf(stderr, "%s: warning: on load, stale colorbuffers: %zu\n", __func__, m_colorbuffers.size());
-            m_colorbuffers.clear();
+            clearColorBuffersLocked();
         }
         assert(m_colorbuffers.empty());
 #ifdef SNAPSHOT_PROFILE
@@ -2861,6 +2965,9 @@ bool FrameBuffer::onLoad(Stream* stream,
         }
         return { handle, { std::move(cb), refCount, opened, closedTs } };
     });
+    for (const auto& it : m_colorbuffers) {
+        m_colorBufferRegistry.add(it.first, it.second.cb);
+    }
     m_lastPostedColorBuffer = static_cast<HandleType>(stream->getBe32());
     GL_LOG("Got lasted posted color buffer from snapshot");
 
@@ -2897,7 +3004,13 @@ bool FrameBuffer::onLoad(Stream* stream,
         goldfish_vk::VkDecoderGlobalState::get()) {
 
         lock.unlock();
-        goldfish_vk::VkDecoderGlobalState::get()->load(stream);
+        auto vk = goldfish_vk::VkDecoderGlobalState::get();
+        if (!vk->load(stream)) {
+            return false;
+        }
+        const auto stats = vk->memorySnapshotStats();
+        textureLoader->setVulkanMemoryStats(stats.storedBytes,
+                                            stats.processUs + stats.streamUs);
         lock.lock();
 
     }
@@ -2915,13 +3028,7 @@ void FrameBuffer::unlock() {
 }
 
 ColorBufferPtr FrameBuffer::findColorBuffer(HandleType p_colorbuffer) {
-    ColorBufferMap::iterator c(m_colorbuffers.find(p_colorbuffer));
-    if (c == m_colorbuffers.end()) {
-        return nullptr;
-    }
-    else {
-        return c->second.cb;
-    }
+    return m_colorBufferRegistry.get(p_colorbuffer);
 }
 
 void FrameBuffer::registerProcessCleanupCallback(void* key, std::function<void()> cb) {
@@ -26,7 +26,9 @@
 #include "emugl/common/mutex.h"
 #include "FbConfig.h"
 #include "GLESVersionDetector.h"
+#include "HandleRegistry.h"
 #include "Hwc2.h"
+#include "PostPacer.h"
 #include "PostWorker.h"
 #include "ReadbackWorker.h"
 #include "RenderContext.h"
@@ -431,6 +433,15 @@ public:
     emugl::Renderer::ReadPixelsCallback getReadPixelsCallback();
     emugl::Renderer::FlushReadPixelPipeline getFlushReadPixelPipeline();
 
+    // Paces guest posts to the host refresh rate |refreshRateHz|: only the
+    // latest frame posted to each display is shown in each refresh interval,
+    // the others are dropped. 0 shows every post right away, the default
+    // unless ANDROID_EMUGL_POST_PACING_HZ is set.
+    void setPostPacing(int refreshRateHz);
+
+    // Return the frame pacing stats of each display posted to so far.
+    emugl::FrameStats getFrameStats() const;
+
     // Re-post the last ColorBuffer that was displayed through post().
     // This is useful if you detect that the sub-window content needs to
     // be re-displayed for any reason.
@@ -615,8 +626,22 @@ private:
     void performDelayedColorBufferCloseLocked(bool forced = false);
     void eraseDelayedCloseColorBufferLocked(
             HandleType cb, android::base::System::Duration ts);
-
-    bool postImpl(HandleType p_colorbuffer, bool needLockAndBind = true, bool repaint = false);
+    // Erase color buffers from both m_colorbuffers and its registry.
+    void eraseColorBufferLocked(ColorBufferMap::iterator c);
+    void clearColorBuffersLocked();
+    // Binds the color buffer to the current context with |bindFunc|, only
+    // taking m_lock if it still needs to be restored from a snapshot.
+    bool bindColorBuffer(HandleType p_colorbuffer,
+                         bool (ColorBuffer::*bindFunc)());
+
+    // |fromPacer| is set when presenting a frame m_postPacer queued.
+    // |queued| is set if the frame was handed to m_postPacer instead of
+    // being shown.
+    bool postImpl(HandleType p_colorbuffer, bool needLockAndBind = true,
+                  bool repaint = false, bool fromPacer = false,
+                  bool* queued = nullptr);
+    // Reports a guest frame that was shown.
+    void onFramePosted();
     void setGuestPostedAFrame() { m_guestPostedAFrame = true; }
     HandleType createColorBufferLocked(int p_width,
                                        int p_height,
@@ -665,6 +690,10 @@ private:
     WindowSurfaceMap m_windows;
     ColorBufferMap m_colorbuffers;
     BufferMap m_buffers;
+    // Mirrors of the objects in m_colorbuffers and m_buffers, updated under
+    // m_lock, for hot lookups that should not take m_lock.
+    HandleRegistry<ColorBuffer> m_colorBufferRegistry;
+    HandleRegistry<Buffer> m_bufferRegistry;
     std::unordered_map<HandleType, HandleType> m_windowSurfaceToColorBuffer;
 
     // A collection of color buffers that were closed without any usages
@@ -721,6 +750,7 @@ private:
         uint32_t bytes;
         uint32_t width;
         uint32_t height;
+        bool readbackBgra;
     };
     android::base::WorkerProcessingResult sendReadbackWorkerCmd(const Readback& readback);
     bool m_asyncReadbackSupported = true;
@@ -733,7 +763,7 @@ private:
         uint32_t width;
         uint32_t height;
         unsigned char* img = nullptr;
-        bool readBgra;
+        bool readBgra = false;
         ~onPost() {
             if (img) {
                 delete[] img;
@@ -805,8 +835,12 @@ private:
         };
     };
 
+    std::unique_ptr<PostPacer> m_postPacer;
     std::unique_ptr<PostWorker> m_postWorker = {};
     android::base::WorkerThread<Post> m_postThread;
+    // When the post thread last finished presenting a frame. Read once
+    // sendPostWorkerCmd() returned.
+    uint64_t m_lastPresentTimeUs = 0;
     android::base::WorkerProcessingResult postWorkerFunc(const Post& post);
     void sendPostWorkerCmd(Post post);
 
@@ -0,0 +1,127 @@
+/*
+* Copyright (C) 2020 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include "android/base/Compiler.h"
+#include "android/base/synchronization/Lock.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+// HandleRegistry is a read-mostly index from renderer handles to the objects
+// they refer to, meant for lookups on hot paths that should not contend on
+// FrameBuffer's global lock.
+//
+// The handles are spread over a fixed number of shards, each with its own
+// read/write lock, so that concurrent lookups only share a read lock and
+// writers only block readers of the same shard.
+//
+// Writers (add/remove/clear) are expected to be serialized by the owner, which
+// also keeps the authoritative per-handle state; the registry only mirrors the
+// set of live objects. As remove() waits for the readers of the shard, an
+// object is never released from inside with(): whoever removes the last
+// reference from the registry does so on the writer's thread.
+template <class T>
+class HandleRegistry {
+    DISALLOW_COPY_ASSIGN_AND_MOVE(HandleRegistry);
+
+public:
+    using Handle = uint32_t;
+    using Ptr = std::shared_ptr<T>;
+
+    static constexpr size_t kNumShards = 16;
+
+    HandleRegistry() = default;
+
+    void add(Handle handle, Ptr ptr) {
+        Shard& shard = shardFor(handle);
+        android::base::AutoWriteLock lock(shard.lock);
+        shard.objects[handle] = std::move(ptr);
+    }
+
+    // Returns the removed reference, so the caller controls where the
+    // object gets destroyed.
+    Ptr remove(Handle handle) {
+        Shard& shard = shardFor(handle);
+        android::base::AutoWriteLock lock(shard.lock);
+        auto it = shard.objects.find(handle);
+        if (it == shard.objects.end()) {
+            return nullptr;
+        }
+        Ptr res = std::move(it->second);
+        shard.objects.erase(it);
+        return res;
+    }
+
+    void clear() {
+        for (Shard& shard : mShards) {
+            android::base::AutoWriteLock lock(shard.lock);
+            shard.objects.clear();
+        }
+    }
+
+    // Returns a new reference to the object registered for |handle|, or
+    // nullptr if there is none.
+    Ptr get(Handle handle) const {
+        const Shard& shard = shardFor(handle);
+        android::base::AutoReadLock lock(shard.lock);
+        auto it = shard.objects.find(handle);
+        return it == shard.objects.end() ? nullptr : it->second;
+    }
+
+    // Calls |func| with the object registered for |handle| while holding the
+    // shard's read lock, without taking a reference. Returns false if there
+    // is no such object. |func| must not call back into the registry's
+    // writers.
+    template <class Func>
+    bool with(Handle handle, Func&& func) const {
+        const Shard& shard = shardFor(handle);
+        android::base::AutoReadLock lock(shard.lock);
+        auto it = shard.objects.find(handle);
+        if (it == shard.objects.end()) {
+            return false;
+        }
+        func(*it->second);
+        return true;
+    }
+
+    size_t size() const {
+        size_t res = 0;
+        for (const Shard& shard : mShards) {
+            android::base::AutoReadLock lock(shard.lock);
+            res += shard.objects.size();
+        }
+        return res;
+    }
+
+private:
+    struct Shard {
+        mutable android::base::ReadWriteLock lock;
+        std::unordered_map<Handle, Ptr> objects;
+    };
+
+    Shard& shardFor(Handle handle) {
+        return mShards[handle % kNumShards];
+    }
+    const Shard& shardFor(Handle handle) const {
+        return mShards[handle % kNumShards];
+    }
+
+    std::array<Shard, kNumShards> mShards;
+};
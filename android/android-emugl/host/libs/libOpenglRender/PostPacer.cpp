@@ -0,0 +1,142 @@
+/*
+* Copyright (C) 2020 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "PostPacer.h"
+
+#include "android/base/system/System.h"
+
+using android::base::AutoLock;
+using android::base::System;
+
+PostPacer::PostPacer(PresentCallback&& present)
+    : mPresent(std::move(present)), mThread([this] { threadMain(); }) {}
+
+PostPacer::~PostPacer() {
+    {
+        AutoLock lock(mLock);
+        mExiting = true;
+        mCv.signal();
+    }
+    if (mThreadStarted) {
+        mThread.wait();
+    }
+}
+
+void PostPacer::setRefreshRate(int refreshRateHz) {
+    AutoLock lock(mLock);
+    mPaced = refreshRateHz > 0;
+    mIntervalUs = 1000000 /
+                  (mPaced ? refreshRateHz : kDefaultRefreshRateHz);
+    if (mPaced && !mThreadStarted) {
+        mThreadStarted = mThread.start();
+        mPaced = mThreadStarted;
+    }
+    mCv.signal();
+}
+
+bool PostPacer::isPaced() const {
+    AutoLock lock(mLock);
+    return mPaced;
+}
+
+bool PostPacer::post(uint32_t displayId, uint32_t colorBuffer) {
+    const uint64_t nowUs = System::get()->getHighResTimeUs();
+    AutoLock lock(mLock);
+    if (!mPaced) {
+        return false;
+    }
+    ++mStats[displayId].postedFrames;
+    auto it = mPending.find(displayId);
+    if (it != mPending.end()) {
+        // Latest frame wins: the one not shown yet is dropped.
+        ++mStats[displayId].coalescedFrames;
+        it->second = {colorBuffer, nowUs};
+    } else {
+        mPending[displayId] = {colorBuffer, nowUs};
+        mCv.signal();
+    }
+    return true;
+}
+
+void PostPacer::onPresented(uint32_t displayId,
+                            uint64_t postTimeUs,
+                            uint64_t presentTimeUs) {
+    AutoLock lock(mLock);
+    ++mStats[displayId].postedFrames;
+    onPresentedLocked(displayId, postTimeUs, presentTimeUs);
+}
+
+void PostPacer::onPresentedLocked(uint32_t displayId,
+                                  uint64_t postTimeUs,
+                                  uint64_t nowUs) {
+    emugl::DisplayFrameStats& stats = mStats[displayId];
+    ++stats.presentedFrames;
+    const uint64_t latencyUs = nowUs > postTimeUs ? nowUs - postTimeUs : 0;
+    stats.latencyUs.add(latencyUs);
+    if (latencyUs > mIntervalUs) {
+        ++stats.lateFrames;
+    }
+    uint64_t& lastUs = mLastDisplayPresentUs[displayId];
+    if (lastUs) {
+        stats.frameTimeUs.add(nowUs - lastUs);
+    }
+    lastUs = nowUs;
+}
+
+emugl::FrameStats PostPacer::getStats() const {
+    AutoLock lock(mLock);
+    return mStats;
+}
+
+void PostPacer::threadMain() {
+    AutoLock lock(mLock);
+    for (;;) {
+        while (!mExiting && mPending.empty()) {
+            mCv.wait(&lock);
+        }
+        if (mExiting) {
+            return;
+        }
+
+        // Wait for the next refresh. Posts coming meanwhile replace the
+        // pending frame of their display.
+        uint64_t nowUs = System::get()->getHighResTimeUs();
+        const uint64_t deadlineUs = mLastPresentUs + mIntervalUs;
+        if (mPaced && nowUs < deadlineUs) {
+            mCv.timedWait(&mLock,
+                          System::get()->getUnixTimeUs() + deadlineUs - nowUs);
+            continue;
+        }
+
+        std::map<uint32_t, Pending> pending;
+        pending.swap(mPending);
+        mLastPresentUs = nowUs;
+        lock.unlock();
+
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (mPresent(it->first, it->second.colorBuffer)) {
+                ++it;
+            } else {
+                it = pending.erase(it);
+            }
+        }
+
+        lock.lock();
+        nowUs = System::get()->getHighResTimeUs();
+        for (const auto& frame : pending) {
+            onPresentedLocked(frame.first, frame.second.postTimeUs, nowUs);
+        }
+    }
+}
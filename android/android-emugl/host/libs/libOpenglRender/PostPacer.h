@@ -0,0 +1,94 @@
+/*
+* Copyright (C) 2020 The Android Open Source Project
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#pragma once
+
+#include "android/base/Compiler.h"
+#include "android/base/synchronization/ConditionVariable.h"
+#include "android/base/synchronization/Lock.h"
+#include "android/base/threads/FunctorThread.h"
+
+#include "OpenglRender/FrameStats.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+
+// PostPacer tracks the frames the guest posts to each display, and can
+// coalesce them to the host refresh rate.
+//
+// Unpaced (the default), the caller presents each post right away and
+// reports it with onPresented(). Paced, post() only records the color buffer
+// as the next frame of its display, replacing a frame that was not shown
+// yet, and a pacing thread presents the latest frame of each display at
+// most once per refresh interval through the present callback. This saves
+// host GPU time on frames nobody can see, e.g. when the guest renders
+// faster than the host display or when running headless.
+class PostPacer {
+public:
+    // Returns false if the frame could not be shown, e.g. because the color
+    // buffer was closed meanwhile.
+    using PresentCallback =
+            std::function<bool(uint32_t displayId, uint32_t colorBuffer)>;
+
+    // Refresh rate used to tell late frames apart when unpaced.
+    static constexpr int kDefaultRefreshRateHz = 60;
+
+    explicit PostPacer(PresentCallback&& present);
+    ~PostPacer();
+
+    // Paces posts to |refreshRateHz|, or stops pacing if it is 0. Frames
+    // pending when pacing stops are still presented.
+    void setRefreshRate(int refreshRateHz);
+    bool isPaced() const;
+
+    // Queues |colorBuffer| as the next frame of |displayId|. Returns false
+    // if not paced, in which case the caller must present it.
+    bool post(uint32_t displayId, uint32_t colorBuffer);
+
+    // Records that the caller presented a frame of |displayId| posted at
+    // |postTimeUs|, the present completing at |presentTimeUs| (both from
+    // System::getHighResTimeUs()).
+    void onPresented(uint32_t displayId,
+                     uint64_t postTimeUs,
+                     uint64_t presentTimeUs);
+
+    emugl::FrameStats getStats() const;
+
+private:
+    struct Pending {
+        uint32_t colorBuffer;
+        uint64_t postTimeUs;
+    };
+
+    void threadMain();
+    void onPresentedLocked(uint32_t displayId, uint64_t postTimeUs,
+                           uint64_t nowUs);
+
+    PresentCallback mPresent;
+    mutable android::base::Lock mLock;
+    android::base::ConditionVariable mCv;
+    uint64_t mIntervalUs = 1000000 / kDefaultRefreshRateHz;
+    bool mPaced = false;
+    bool mExiting = false;
+    uint64_t mLastPresentUs = 0;
+    std::map<uint32_t, Pending> mPending;
+    emugl::FrameStats mStats;
+    std::map<uint32_t, uint64_t> mLastDisplayPresentUs;
+    android::base::FunctorThread mThread;
+    bool mThreadStarted = false;
+
+    DISALLOW_COPY_AND_ASSIGN(PostPacer);
+};
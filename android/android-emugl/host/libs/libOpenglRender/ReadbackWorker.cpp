@@ -3,6 +3,8 @@
 
 #include <string.h>                           // for memcpy
 
+#include <algorithm>                          // for min
+
 #include "ColorBuffer.h"                      // for ColorBuffer
 #include "DispatchTables.h"                   // for s_gles2
 #include "FbConfig.h"                         // for FbConfig, FbConfigList
@@ -11,10 +13,17 @@
 #include "OpenGLESDispatch/GLESv2Dispatch.h"  // for GLESv2Dispatch
 #include "emugl/common/misc.h"                // for getGlesVersion
 
-ReadbackWorker::recordDisplay::recordDisplay(uint32_t displayId, uint32_t w, uint32_t h)
-    : mBufferSize(4 * w * h /* RGBA8 (4 bpp) */),
-      mBuffers(4 /* mailbox */,
-               0),  // Note, last index is used for duplicating buffer on flush
+// Bounds the waits for readbacks that are needed right away. Mapping the
+// buffer afterwards waits for the readback anyway.
+static constexpr GLuint64 kReadbackWaitTimeoutNs = 1000000000ULL;
+
+ReadbackWorker::recordDisplay::recordDisplay(uint32_t displayId,
+                                             uint32_t w,
+                                             uint32_t h,
+                                             bool readbackBgra)
+    : mSlots(kRingSize),
+      mBufferSize(4 * w * h),
+      mReadbackBgra(readbackBgra),
       mDisplayId(displayId) {}
 
 void ReadbackWorker::initGL() {
@@ -23,165 +32,255 @@ void ReadbackWorker::initGL() {
     mFb->createAndBindTrivialSharedContext(&mFlushContext, &mFlushSurf);
 }
 
+static void deleteRecordDisplayBuffers(ReadbackWorker::recordDisplay& r) {
+    for (auto& slot : r.mSlots) {
+        if (slot.fence) {
+            s_gles2.glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+        s_gles2.glDeleteBuffers(1, &slot.buffer);
+        slot.buffer = 0;
+    }
+}
+
 ReadbackWorker::~ReadbackWorker() {
     s_gles2.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
     s_gles2.glBindBuffer(GL_COPY_READ_BUFFER, 0);
     for (auto& r : mRecordDisplays) {
-        s_gles2.glDeleteBuffers(r.second.mBuffers.size(), &r.second.mBuffers[0]);
+        deleteRecordDisplayBuffers(r.second);
     }
     mFb->unbindAndDestroyTrivialSharedContext(mContext, mSurf);
     mFb->unbindAndDestroyTrivialSharedContext(mFlushContext, mFlushSurf);
 }
 
-void ReadbackWorker::setRecordDisplay(uint32_t displayId, uint32_t w, uint32_t h, bool add) {
+void ReadbackWorker::setRecordDisplay(uint32_t displayId,
+                                      uint32_t w,
+                                      uint32_t h,
+                                      bool add,
+                                      bool readbackBgra) {
     android::base::AutoLock lock(mLock);
     if (add) {
-        mRecordDisplays.emplace(displayId, recordDisplay(displayId, w, h));
         recordDisplay& r = mRecordDisplays[displayId];
-        s_gles2.glGenBuffers(r.mBuffers.size(), &r.mBuffers[0]);
-        for (auto buffer : r.mBuffers) {
-            s_gles2.glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        r = recordDisplay(displayId, w, h, readbackBgra);
+        for (auto& slot : r.mSlots) {
+            s_gles2.glGenBuffers(1, &slot.buffer);
+            s_gles2.glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
             s_gles2.glBufferData(GL_PIXEL_PACK_BUFFER, r.mBufferSize,
                              0 /* init, with no data */, GL_STREAM_READ);
         }
         s_gles2.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
     } else {
-        recordDisplay& r = mRecordDisplays[displayId];
+        auto it = mRecordDisplays.find(displayId);
+        if (it == mRecordDisplays.end()) {
+            return;
+        }
         s_gles2.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
         s_gles2.glBindBuffer(GL_COPY_READ_BUFFER, 0);
-        s_gles2.glDeleteBuffers(r.mBuffers.size(), &r.mBuffers[0]);
-        mRecordDisplays.erase(displayId);
+        deleteRecordDisplayBuffers(it->second);
+        mRecordDisplays.erase(it);
+    }
+}
+
+// static
+void ReadbackWorker::markCompletedLocked(recordDisplay& r, int slot) {
+    recordDisplay::Slot& s = r.mSlots[slot];
+    if (s.fence) {
+        s_gles2.glDeleteSync(s.fence);
+        s.fence = nullptr;
+    }
+    if (r.mLatestSlot < 0 || s.frame > r.mSlots[r.mLatestSlot].frame) {
+        r.mLatestSlot = slot;
+    }
+}
+
+// static
+void ReadbackWorker::updateCompletedLocked(recordDisplay& r) {
+    for (int i = 0; i < (int)r.mSlots.size(); ++i) {
+        if (!r.mSlots[i].fence || i == r.mCopySlot) {
+            continue;
+        }
+        GLenum res = s_gles2.glClientWaitSync(r.mSlots[i].fence, 0, 0);
+        if (res == GL_ALREADY_SIGNALED || res == GL_CONDITION_SATISFIED) {
+            markCompletedLocked(r, i);
+        }
     }
 }
 
+// static
+int ReadbackWorker::pickReadbackSlotLocked(const recordDisplay& r) {
+    // The oldest slot, keeping the latest completed frame for the consumer.
+    int res = -1;
+    for (int i = 0; i < (int)r.mSlots.size(); ++i) {
+        if (i == r.mCopySlot || i == r.mLatestSlot) {
+            continue;
+        }
+        if (res < 0 || r.mSlots[i].frame < r.mSlots[res].frame) {
+            res = i;
+        }
+    }
+    return res;
+}
+
 void ReadbackWorker::doNextReadback(uint32_t displayId,
                                     ColorBuffer* cb,
                                     void* fbImage,
-                                    bool repaint,
-                                    bool readbackBgra) {
-    // if |repaint|, make sure that the current frame is immediately sent down
-    // the pipeline and made available to the consumer by priming async
-    // readback; doing 4 consecutive reads in a row, which should be enough to
-    // fill the 3 buffers in the triple buffering setup and on the 4th, trigger
-    // a post callback.
-    int numIter = repaint ? 4 : 1;
-
-    // Mailbox-style triple buffering setup:
-    // We want to avoid glReadPixels while in the middle of doing
-    // memcpy to the consumer, but also want to avoid latency while
-    // that is going on.
-    //
-    // There are 3 buffer ids, A, B, and C.
-    // If we are not in the middle of copying out a frame,
-    // set glReadPixels to write to buffer A and copy from buffer B in
-    // alternation, so the consumer always gets the latest frame
-    // +1 frame of lag in order to not cause blocking on
-    // glReadPixels / glMapBufferRange.
-    // If we are in the middle of copying out a frame, reset A and B to
-    // not be the buffer being copied out, and continue glReadPixels to
-    // buffer A and B as before.
-    //
-    // The resulting invariants are:
-    // - glReadPixels is called on a different buffer every time
-    //   so we avoid introducing sync points there.
-    // - At no time are we mapping/copying a buffer and also doing
-    //   glReadPixels on it (avoid simultaneous map + glReadPixels)
-    // - glReadPixels and then immediately map/copy the same buffer
-    //   doesn't happen either (avoid sync point in glMapBufferRange)
-    for (int i = 0; i < numIter; i++) {
-        android::base::AutoLock lock(mLock);
-        recordDisplay& r = mRecordDisplays[displayId];
-        if (r.mIsCopying) {
-            switch (r.mMapCopyIndex) {
-                // To keep double buffering effect on
-                // glReadPixels, need to keep even/oddness of
-                // mReadPixelsIndexEven and mReadPixelsIndexOdd.
-                case 0:
-                    r.mReadPixelsIndexEven = 2;
-                    r.mReadPixelsIndexOdd = 1;
-                    break;
-                case 1:
-                    r.mReadPixelsIndexEven = 0;
-                    r.mReadPixelsIndexOdd = 2;
-                    break;
-                case 2:
-                    r.mReadPixelsIndexEven = 0;
-                    r.mReadPixelsIndexOdd = 1;
-                    break;
-            }
-        } else {
-            r.mReadPixelsIndexEven = 0;
-            r.mReadPixelsIndexOdd = 1;
-            r.mMapCopyIndex = r.mPrevReadPixelsIndex;
-        }
+                                    bool repaint) {
+    // The readback and its fence go through the ColorBuffer helper context;
+    // fences are shared with the contexts getPixels() and flushPipeline() use
+    // to wait on them.
+    ColorBuffer::RecursiveScopedHelperContext context(
+            mFb->getColorBufferHelper());
+    if (!context.isOk()) {
+        return;
+    }
 
-        // Double buffering on buffer A / B part
-        uint32_t readAt;
-        if (r.m_readbackCount % 2 == 0) {
-            readAt = r.mReadPixelsIndexEven;
-        } else {
-            readAt = r.mReadPixelsIndexOdd;
-        }
-        r.m_readbackCount++;
-        r.mPrevReadPixelsIndex = readAt;
-
-        cb->readbackAsync(r.mBuffers[readAt], readbackBgra);
-
-        // It's possible to post callback before any of the async readbacks
-        // have written any data yet, which results in a black frame.  Safer
-        // option to avoid this glitch is to wait until all 3 potential
-        // buffers in our triple buffering setup have had chances to readback.
-        lock.unlock();
-        if (r.m_readbackCount > 3) {
-            mFb->doPostCallback(fbImage, r.mDisplayId);
+    android::base::AutoLock lock(mLock);
+    auto it = mRecordDisplays.find(displayId);
+    if (it == mRecordDisplays.end()) {
+        return;
+    }
+    recordDisplay& r = it->second;
+
+    // Invariants:
+    // - glReadPixels never targets the buffer getPixels() maps, nor the
+    //   latest completed frame, which getPixels() may map next.
+    // - getPixels() only maps buffers whose fence signaled, so it doesn't
+    //   introduce a sync point in glMapBufferRange either.
+    // - If the consumer falls behind, the oldest frames in flight are
+    //   overwritten instead of stalling the post thread.
+    updateCompletedLocked(r);
+
+    int slot = pickReadbackSlotLocked(r);
+    recordDisplay::Slot& s = r.mSlots[slot];
+    if (s.fence) {
+        s_gles2.glDeleteSync(s.fence);
+        s.fence = nullptr;
+    }
+    s.frame = 0;
+
+    if (!cb->readbackAsync(s.buffer, r.mReadbackBgra)) {
+        return;
+    }
+    s.frame = ++r.m_readbackCount;
+    s.fence = s_gles2.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // Other contexts wait on the fence, make sure it gets to the GPU.
+    s_gles2.glFlush();
+
+    if (repaint) {
+        GLenum res = s_gles2.glClientWaitSync(s.fence, 0,
+                                              kReadbackWaitTimeoutNs);
+        if (res == GL_ALREADY_SIGNALED || res == GL_CONDITION_SATISFIED) {
+            markCompletedLocked(r, slot);
         }
     }
+
+    bool post = r.mLatestSlot >= 0 &&
+                r.mSlots[r.mLatestSlot].frame > r.mLastPostedFrame;
+    if (post) {
+        r.mLastPostedFrame = r.mSlots[r.mLatestSlot].frame;
+    }
+    lock.unlock();
+
+    if (post) {
+        mFb->doPostCallback(fbImage, displayId);
+    }
 }
 
 void ReadbackWorker::flushPipeline(uint32_t displayId) {
     android::base::AutoLock lock(mLock);
-    recordDisplay& r = mRecordDisplays[displayId];
-    if (r.mIsCopying) {
+    auto it = mRecordDisplays.find(displayId);
+    if (it == mRecordDisplays.end()) {
+        return;
+    }
+    recordDisplay& r = it->second;
+    if (r.mCopySlot >= 0) {
         // No need to make the last frame available,
         // we are currently being read.
         return;
     }
 
-    auto src = r.mBuffers[r.mPrevReadPixelsIndex];
-    auto dst = r.mBuffers.back();
-
-    // This is not called from a renderthread, so let's activate
-    // the context.
-    s_egl.eglMakeCurrent(mFb->getDisplay(), mFlushSurf, mFlushSurf, mFlushContext);
-
-    // We now copy the last frame into slot 4, where no other thread
-    // ever writes.
-    s_gles2.glBindBuffer(GL_COPY_READ_BUFFER, src);
-    s_gles2.glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
-    s_gles2.glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
-                                r.mBufferSize);
-    s_egl.eglMakeCurrent(mFb->getDisplay(), EGL_NO_SURFACE, EGL_NO_SURFACE,
-                         EGL_NO_CONTEXT);
+    // Wait for the last readback in flight, so it becomes available even
+    // though no more posts are coming.
+    int newest = -1;
+    for (int i = 0; i < (int)r.mSlots.size(); ++i) {
+        if (r.mSlots[i].fence &&
+            (newest < 0 || r.mSlots[i].frame > r.mSlots[newest].frame)) {
+            newest = i;
+        }
+    }
+    if (newest >= 0) {
+        // This is not called from a renderthread, so let's activate
+        // the context.
+        s_egl.eglMakeCurrent(mFb->getDisplay(), mFlushSurf, mFlushSurf,
+                             mFlushContext);
+        GLenum res = s_gles2.glClientWaitSync(r.mSlots[newest].fence, 0,
+                                              kReadbackWaitTimeoutNs);
+        if (res == GL_ALREADY_SIGNALED || res == GL_CONDITION_SATISFIED) {
+            markCompletedLocked(r, newest);
+        }
+        s_egl.eglMakeCurrent(mFb->getDisplay(), EGL_NO_SURFACE,
+                             EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
 
-    r.mMapCopyIndex = r.mBuffers.size() - 1;
+    if (r.mLatestSlot < 0) {
+        return;
+    }
+    r.mLastPostedFrame = r.mSlots[r.mLatestSlot].frame;
     lock.unlock();
-    mFb->doPostCallback(nullptr, r.mDisplayId);
+    mFb->doPostCallback(nullptr, displayId);
 }
 
 void ReadbackWorker::getPixels(uint32_t displayId, void* buf, uint32_t bytes) {
     android::base::AutoLock lock(mLock);
-    recordDisplay& r = mRecordDisplays[displayId];
-    r.mIsCopying = true;
+    auto it = mRecordDisplays.find(displayId);
+    if (it == mRecordDisplays.end()) {
+        return;
+    }
+    recordDisplay& r = it->second;
+    updateCompletedLocked(r);
+
+    int slot = r.mLatestSlot;
+    GLsync fence = nullptr;
+    if (slot < 0) {
+        // Nothing completed yet, wait for the first readback in flight.
+        for (int i = 0; i < (int)r.mSlots.size(); ++i) {
+            if (r.mSlots[i].fence &&
+                (slot < 0 || r.mSlots[i].frame < r.mSlots[slot].frame)) {
+                slot = i;
+            }
+        }
+        if (slot < 0) {
+            return;
+        }
+        fence = r.mSlots[slot].fence;
+    }
+    r.mCopySlot = slot;
+    GLuint buffer = r.mSlots[slot].buffer;
+    bytes = std::min(bytes, r.mBufferSize);
     lock.unlock();
 
-    GLuint buffer = r.mBuffers[r.mMapCopyIndex];
+    if (fence) {
+        s_gles2.glClientWaitSync(fence, 0, kReadbackWaitTimeoutNs);
+    }
+
     s_gles2.glBindBuffer(GL_COPY_READ_BUFFER, buffer);
     void* pixels = s_gles2.glMapBufferRange(GL_COPY_READ_BUFFER, 0, bytes,
                                             GL_MAP_READ_BIT);
-    memcpy(buf, pixels, bytes);
+    if (pixels) {
+        memcpy(buf, pixels, bytes);
+    }
     s_gles2.glUnmapBuffer(GL_COPY_READ_BUFFER);
+    s_gles2.glBindBuffer(GL_COPY_READ_BUFFER, 0);
 
     lock.lock();
-    r.mIsCopying = false;
-    lock.unlock();
+    it = mRecordDisplays.find(displayId);
+    if (it == mRecordDisplays.end()) {
+        // Removed while copying, its buffers are gone already.
+        return;
+    }
+    if (fence) {
+        // Mapping waited for the readback if the fence wait timed out.
+        markCompletedLocked(it->second, slot);
+    }
+    it->second.mCopySlot = -1;
 }
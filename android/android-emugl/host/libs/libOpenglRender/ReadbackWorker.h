@@ -9,15 +9,27 @@
 #include "android/base/Compiler.h"              // for DISALLOW_COPY_AND_ASSIGN
 #include "android/base/synchronization/Lock.h"  // for Lock
 
-class ColorBuffer;
+#include "ColorBuffer.h"                        // for ColorBuffer
+
 class FrameBuffer;
 struct RenderThreadInfo;
 
 // This class implements async readback of emugl ColorBuffers.
 // It is meant to run on both the emugl framebuffer posting thread
 // and a separate GL thread, with two main points of interaction:
+//
+// Each recorded display has a ring of pixel buffer objects. Every post
+// starts a glReadPixels() into the oldest buffer that is neither being
+// copied out nor holding the latest completed frame, followed by a fence.
+// The post callback only fires once such a fence signaled, and getPixels()
+// copies out the latest completed buffer, so in steady state neither the
+// post thread nor the consumer waits for the GPU.
 class ReadbackWorker {
 public:
+    // One buffer being copied out, one holding the latest frame, and one to
+    // read the next frame into.
+    static constexpr uint32_t kRingSize = 3;
+
     ReadbackWorker() = default;
     ~ReadbackWorker();
 
@@ -27,15 +39,14 @@ public:
 
     // doNextReadback(): Call this from the emugl FrameBuffer::post thread
     // or similar rendering thread.
-    // This will trigger an async glReadPixels of the current framebuffer.
-    // The post callback of Framebuffer will also be triggered, but
-    // in async mode it should do minimal work that involves |fbImage|.
-    // |repaint|: flag to prime async readback with multiple iterations
-    // so that the consumer of readback doesn't lag behind.
-    // |readbackBgra|: Whether to force the readback format as GL_BGRA_EXT,
-    // so that we get (depending on driver quality, heh) a gpu conversion of the
-    // readback image that is suitable for webrtc, which expects formats like that.
-    void doNextReadback(uint32_t displayId, ColorBuffer* cb, void* fbImage, bool repaint, bool readbackBgra);
+    // This will trigger an async glReadPixels of the current framebuffer,
+    // as RGBA or BGRA as the display was configured with.
+    // The post callback of Framebuffer will also be triggered, once a
+    // readback completed, but in async mode it should do minimal work that
+    // involves |fbImage|.
+    // |repaint|: flag to make the current frame available to the consumer
+    // right away, waiting for its readback to complete.
+    void doNextReadback(uint32_t displayId, ColorBuffer* cb, void* fbImage, bool repaint);
 
     // getPixels(): Run this on a separate GL thread. This retrieves the
     // latest framebuffer that has been posted and read with doNextReadback.
@@ -44,31 +55,48 @@ public:
     // is running on.
     void getPixels(uint32_t displayId, void* out, uint32_t bytes);
 
-    // Duplicates the last frame and generates a post events if
+    // Waits for the last readback and generates a post event if
     // there are no read events active.
     // This is usually called when there was no doNextReadback activity
     // for a few ms, to guarantee that end users see the final frame.
     void flushPipeline(uint32_t displayId);
 
-    void setRecordDisplay(uint32_t displayId, uint32_t w, uint32_t h, bool add);
+    // Adds or removes the readback ring of a display.
+    void setRecordDisplay(uint32_t displayId, uint32_t w, uint32_t h, bool add,
+                          bool readbackBgra = false);
 
     class recordDisplay {
     public:
         recordDisplay() = default;
-        recordDisplay(uint32_t displayId, uint32_t w, uint32_t h);
+        recordDisplay(uint32_t displayId, uint32_t w, uint32_t h,
+                      bool readbackBgra);
     public:
-        uint32_t mReadPixelsIndexEven = 0;
-        uint32_t mReadPixelsIndexOdd = 1;
-        uint32_t mPrevReadPixelsIndex = 1;
-        uint32_t mMapCopyIndex = 0;
-        bool mIsCopying = false;
+        struct Slot {
+            GLuint buffer = 0;
+            // Signals when the readback into |buffer| is done. Reset once
+            // that was observed.
+            GLsync fence = nullptr;
+            // Sequence number of the readback in |buffer|, 0 if none.
+            uint64_t frame = 0;
+        };
+        std::vector<Slot> mSlots = {};
         uint32_t mBufferSize = 0;
-        std::vector<GLuint> mBuffers = {};
-        uint32_t m_readbackCount = 0;
+        bool mReadbackBgra = false;
+        uint64_t m_readbackCount = 0;
+        // Slot with the latest completed readback, or -1.
+        int mLatestSlot = -1;
+        // Slot getPixels() is copying out, or -1. Only getPixels() touches
+        // its fence.
+        int mCopySlot = -1;
+        uint64_t mLastPostedFrame = 0;
         uint32_t mDisplayId = 0;
     };
 
 private:
+    static void updateCompletedLocked(recordDisplay& r);
+    static void markCompletedLocked(recordDisplay& r, int slot);
+    static int pickReadbackSlotLocked(const recordDisplay& r);
+
     EGLContext mContext;
     EGLContext mFlushContext;
     EGLSurface mSurf;
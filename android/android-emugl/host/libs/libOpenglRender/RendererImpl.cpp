@@ -323,6 +323,11 @@ void RendererImpl::fillGLESUsages(android_studio::EmulatorGLESUsages* usages) {
     if (fb) fb->fillGLESUsages(usages);
 }
 
+FrameStats RendererImpl::getFrameStats() {
+    auto fb = FrameBuffer::getFB();
+    return fb ? fb->getFrameStats() : FrameStats();
+}
+
 void RendererImpl::getScreenshot(unsigned int nChannels, unsigned int* width,
         unsigned int* height, std::vector<unsigned char>& pixels, int displayId,
         int desiredWidth, int desiredHeight, SkinRotation desiredRotation) {
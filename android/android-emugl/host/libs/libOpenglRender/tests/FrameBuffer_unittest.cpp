@@ -30,7 +30,11 @@
 #include "Standalone.h"
 
 #include <gtest/gtest.h>
+
+#include <atomic>
 #include <memory>
+#include <thread>
+#include <vector>
 
 
 #ifdef _MSC_VER
@@ -729,6 +733,89 @@ TEST_F(FrameBufferTest, HostDrawCallRate) {
     mFb->DestroyWindowSurface(surface);
 }
 
+// Stress test for color buffer lookups from several render threads, while
+// the main thread keeps creating, updating and closing other color buffers.
+// Reports the rate of bindColorBufferToTexture() across all threads.
+TEST_F(FrameBufferTest, ConcurrentColorBufferBindRate) {
+    constexpr int kNumThreads = 4;
+    constexpr int kNumColorBuffers = 16;
+    constexpr int kBindsPerThread = 20000;
+    constexpr int kChurnSize = 16;
+
+    std::vector<HandleType> colorBuffers;
+    for (int i = 0; i < kNumColorBuffers; ++i) {
+        HandleType handle = mFb->createColorBuffer(
+                16, 16, GL_RGBA, FRAMEWORK_FORMAT_GL_COMPATIBLE);
+        EXPECT_EQ(0, mFb->openColorBuffer(handle));
+        colorBuffers.push_back(handle);
+    }
+
+    std::atomic<int> threadsDone { 0 };
+    std::atomic<int> failedBinds { 0 };
+    std::vector<std::thread> threads;
+
+    auto cpuTimeStart = System::cpuTime();
+
+    for (int t = 0; t < kNumThreads; ++t) {
+        threads.emplace_back([this, t, &colorBuffers, &threadsDone,
+                              &failedBinds] {
+            RenderThreadInfo threadInfo;
+            HandleType context = mFb->createRenderContext(0, 0, GLESApi_3_0);
+            HandleType surface = mFb->createWindowSurface(0, 1, 1);
+            EXPECT_TRUE(mFb->bindContext(context, surface, surface));
+
+            for (int i = 0; i < kBindsPerThread; ++i) {
+                const HandleType cb =
+                        colorBuffers[(i + t) % colorBuffers.size()];
+                if (!mFb->bindColorBufferToTexture(cb)) {
+                    ++failedBinds;
+                }
+            }
+
+            EXPECT_TRUE(mFb->bindContext(0, 0, 0));
+            mFb->DestroyWindowSurface(surface);
+            mFb->DestroyRenderContext(context);
+            ++threadsDone;
+        });
+    }
+
+    TestTexture forUpdate = createTestTextureRGBA8888SingleColor(
+            16, 16, 1.0f, 0.0f, 0.0f, 1.0f);
+    int churned = 0;
+    while (threadsDone.load() < kNumThreads) {
+        HandleType churn[kChurnSize];
+        for (int i = 0; i < kChurnSize; ++i) {
+            churn[i] = mFb->createColorBuffer(
+                    16, 16, GL_RGBA, FRAMEWORK_FORMAT_GL_COMPATIBLE);
+            EXPECT_EQ(0, mFb->openColorBuffer(churn[i]));
+            mFb->updateColorBuffer(churn[i], 0, 0, 16, 16, GL_RGBA,
+                                   GL_UNSIGNED_BYTE, forUpdate.data());
+        }
+        for (int i = 0; i < kChurnSize; ++i) {
+            mFb->closeColorBuffer(churn[i]);
+        }
+        churned += kChurnSize;
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto cpuTime = System::cpuTime() - cpuTimeStart;
+    const uint64_t duration_us = cpuTime.wall_time_us;
+    const int totalBinds = kNumThreads * kBindsPerThread;
+    printf("%d threads bound color buffers %d times in %f ms "
+           "(%d color buffers churned). Rate: %f Hz\n",
+           kNumThreads, totalBinds, duration_us / 1000.0f, churned,
+           totalBinds / (duration_us / 1000000.0f));
+
+    EXPECT_EQ(0, failedBinds.load());
+
+    for (HandleType handle : colorBuffers) {
+        mFb->closeColorBuffer(handle);
+    }
+}
+
 // Tests Vulkan interop query.
 TEST_F(FrameBufferTest, VulkanInteropQuery) {
     auto egl = LazyLoadedEGLDispatch::get();
@@ -0,0 +1,126 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "HandleRegistry.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+struct TestObject {
+    explicit TestObject(int value) : value(value) {}
+    int value;
+};
+
+TEST(HandleRegistry, Empty) {
+    HandleRegistry<TestObject> reg;
+    EXPECT_EQ(0u, reg.size());
+    EXPECT_EQ(nullptr, reg.get(1));
+    EXPECT_FALSE(reg.with(1, [](TestObject&) { FAIL(); }));
+    EXPECT_EQ(nullptr, reg.remove(1));
+}
+
+TEST(HandleRegistry, AddGetRemove) {
+    HandleRegistry<TestObject> reg;
+    reg.add(1, std::make_shared<TestObject>(10));
+    reg.add(17, std::make_shared<TestObject>(170));
+    EXPECT_EQ(2u, reg.size());
+
+    ASSERT_NE(nullptr, reg.get(1));
+    EXPECT_EQ(10, reg.get(1)->value);
+
+    int seen = 0;
+    EXPECT_TRUE(reg.with(17, [&seen](TestObject& obj) { seen = obj.value; }));
+    EXPECT_EQ(170, seen);
+
+    auto removed = reg.remove(1);
+    ASSERT_NE(nullptr, removed);
+    EXPECT_EQ(10, removed->value);
+    EXPECT_EQ(nullptr, reg.get(1));
+    EXPECT_EQ(1u, reg.size());
+
+    reg.clear();
+    EXPECT_EQ(0u, reg.size());
+    EXPECT_EQ(nullptr, reg.get(17));
+}
+
+TEST(HandleRegistry, Replace) {
+    HandleRegistry<TestObject> reg;
+    reg.add(5, std::make_shared<TestObject>(1));
+    reg.add(5, std::make_shared<TestObject>(2));
+    EXPECT_EQ(1u, reg.size());
+    EXPECT_EQ(2, reg.get(5)->value);
+}
+
+// The registry must keep the last reference while readers run: removing an
+// object never leaves a reader holding a dangling pointer, and the object is
+// released by the remover.
+TEST(HandleRegistry, RemoveReleasesOnWriter) {
+    HandleRegistry<TestObject> reg;
+    auto obj = std::make_shared<TestObject>(3);
+    std::weak_ptr<TestObject> weak = obj;
+    reg.add(3, std::move(obj));
+
+    auto removed = reg.remove(3);
+    EXPECT_FALSE(weak.expired());
+    removed.reset();
+    EXPECT_TRUE(weak.expired());
+}
+
+TEST(HandleRegistry, ConcurrentReadersAndWriter) {
+    constexpr int kNumReaders = 4;
+    constexpr uint32_t kNumHandles = 256;
+    constexpr int kIterations = 20000;
+
+    HandleRegistry<TestObject> reg;
+    for (uint32_t i = 0; i < kNumHandles; i += 2) {
+        reg.add(i, std::make_shared<TestObject>(i));
+    }
+
+    std::atomic<bool> done { false };
+    std::atomic<int> badValues { 0 };
+    std::vector<std::thread> readers;
+    for (int r = 0; r < kNumReaders; ++r) {
+        readers.emplace_back([&reg, &done, &badValues, r] {
+            uint32_t handle = r;
+            while (!done.load(std::memory_order_relaxed)) {
+                handle = (handle + 7) % kNumHandles;
+                reg.with(handle, [&badValues, handle](TestObject& obj) {
+                    if (obj.value != int(handle)) {
+                        ++badValues;
+                    }
+                });
+                auto ptr = reg.get(handle);
+                if (ptr && ptr->value != int(handle)) {
+                    ++badValues;
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < kIterations; ++i) {
+        const uint32_t handle = (i * 13) % kNumHandles;
+        if (!reg.remove(handle)) {
+            reg.add(handle, std::make_shared<TestObject>(handle));
+        }
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_EQ(0, badValues.load());
+}
@@ -0,0 +1,143 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "PostPacer.h"
+
+#include "android/base/synchronization/ConditionVariable.h"
+#include "android/base/synchronization/Lock.h"
+#include "android/base/system/System.h"
+
+#include <gtest/gtest.h>
+
+#include <utility>
+#include <vector>
+
+using android::base::AutoLock;
+using android::base::ConditionVariable;
+using android::base::Lock;
+using android::base::System;
+using emugl::FrameTimeHistogram;
+
+namespace {
+
+// Records the frames presented by a PostPacer.
+class PresentRecorder {
+public:
+    PostPacer::PresentCallback callback() {
+        return [this](uint32_t displayId, uint32_t colorBuffer) {
+            AutoLock lock(mLock);
+            mPresented.push_back({displayId, colorBuffer});
+            mCv.broadcastAndUnlock(&lock);
+            return true;
+        };
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> waitFor(size_t count) {
+        AutoLock lock(mLock);
+        mCv.wait(&lock, [this, count] { return mPresented.size() >= count; });
+        return mPresented;
+    }
+
+private:
+    Lock mLock;
+    ConditionVariable mCv;
+    std::vector<std::pair<uint32_t, uint32_t>> mPresented;
+};
+
+}  // namespace
+
+TEST(FrameTimeHistogram, Bins) {
+    FrameTimeHistogram histogram;
+    histogram.add(0);
+    histogram.add(16700);
+    histogram.add(16800);
+    histogram.add(10000000);
+    EXPECT_EQ(4, histogram.totalCount());
+    EXPECT_EQ(1, histogram.count(0));
+    EXPECT_EQ(1, histogram.count(3));
+    EXPECT_EQ(1, histogram.count(4));
+    EXPECT_EQ(1, histogram.count(FrameTimeHistogram::kNumBins - 1));
+}
+
+TEST(PostPacer, UnpacedPostsArePresentedByCaller) {
+    PresentRecorder recorder;
+    PostPacer pacer(recorder.callback());
+    EXPECT_FALSE(pacer.isPaced());
+    EXPECT_FALSE(pacer.post(0, 1));
+
+    // The second frame takes longer than a refresh interval to present.
+    pacer.onPresented(0, 1000, 2000);
+    pacer.onPresented(0, 10000, 40000);
+    auto stats = pacer.getStats();
+    ASSERT_EQ(1, stats.count(0));
+    EXPECT_EQ(2, stats[0].postedFrames);
+    EXPECT_EQ(2, stats[0].presentedFrames);
+    EXPECT_EQ(0, stats[0].coalescedFrames);
+    EXPECT_EQ(1, stats[0].lateFrames);
+    EXPECT_EQ(2, stats[0].latencyUs.totalCount());
+    EXPECT_EQ(1, stats[0].frameTimeUs.totalCount());
+}
+
+TEST(PostPacer, LatestFrameWins) {
+    PresentRecorder recorder;
+    PostPacer pacer(recorder.callback());
+    // A long interval, so that the posts below all land within one.
+    pacer.setRefreshRate(10);
+    EXPECT_TRUE(pacer.isPaced());
+
+    EXPECT_TRUE(pacer.post(0, 1));
+    recorder.waitFor(1);
+    EXPECT_TRUE(pacer.post(0, 2));
+    EXPECT_TRUE(pacer.post(0, 3));
+    EXPECT_TRUE(pacer.post(0, 4));
+    auto presented = recorder.waitFor(2);
+
+    ASSERT_EQ(2, presented.size());
+    EXPECT_EQ(1, presented[0].second);
+    EXPECT_EQ(4, presented[1].second);
+
+    auto stats = pacer.getStats();
+    EXPECT_EQ(4, stats[0].postedFrames);
+    EXPECT_EQ(2, stats[0].coalescedFrames);
+}
+
+TEST(PostPacer, DisplaysArePacedTogether) {
+    PresentRecorder recorder;
+    PostPacer pacer(recorder.callback());
+    pacer.setRefreshRate(10);
+
+    EXPECT_TRUE(pacer.post(0, 1));
+    recorder.waitFor(1);
+    EXPECT_TRUE(pacer.post(1, 10));
+    EXPECT_TRUE(pacer.post(0, 2));
+    auto presented = recorder.waitFor(3);
+
+    ASSERT_EQ(3, presented.size());
+    EXPECT_EQ(std::make_pair(0u, 2u), presented[1]);
+    EXPECT_EQ(std::make_pair(1u, 10u), presented[2]);
+}
+
+TEST(PostPacer, PendingFramesPresentedWhenUnpaced) {
+    PresentRecorder recorder;
+    PostPacer pacer(recorder.callback());
+    pacer.setRefreshRate(1);
+
+    EXPECT_TRUE(pacer.post(0, 1));
+    recorder.waitFor(1);
+    EXPECT_TRUE(pacer.post(0, 2));
+    pacer.setRefreshRate(0);
+    EXPECT_FALSE(pacer.isPaced());
+    auto presented = recorder.waitFor(2);
+    EXPECT_EQ(2, presented[1].second);
+}
@@ -0,0 +1,189 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "GLSnapshotTestStateUtils.h"
+#include "OpenGLTestContext.h"
+
+#include "android/base/StringFormat.h"
+#include "android/base/files/PathUtils.h"
+#include "android/base/system/System.h"
+#include "android/base/testing/TestTempDir.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+using android::base::StringFormat;
+using android::base::System;
+using android::base::TestTempDir;
+
+namespace emugl {
+
+// Keeps the shader caches of all tests in this binary out of the user's
+// emulator directory. Set up before any test, as the caches pick their
+// directory once.
+class ShaderCacheEnvironment : public ::testing::Environment {
+public:
+    void SetUp() override {
+        mDir.reset(new TestTempDir("shader-cache"));
+        System::get()->envSet("ANDROID_EMUGL_SHADER_CACHE_DIR", mDir->path());
+    }
+
+    void TearDown() override {
+        System::get()->envSet("ANDROID_EMUGL_SHADER_CACHE_DIR", "");
+        mDir.reset();
+    }
+
+private:
+    std::unique_ptr<TestTempDir> mDir;
+};
+
+static ::testing::Environment* const sShaderCacheEnvironment =
+        ::testing::AddGlobalTestEnvironment(new ShaderCacheEnvironment);
+
+// Program binary cache entries, as written by the cache: file path to
+// modification time. The cache stores an entry on each link it does not
+// serve, so a link that hits leaves the entries unchanged.
+using ProgramCacheEntries = std::map<std::string, System::Duration>;
+
+static ProgramCacheEntries getProgramCacheEntries() {
+    ProgramCacheEntries entries;
+    const std::string dir = android::base::PathUtils::join(
+            System::getEnvironmentVariable("ANDROID_EMUGL_SHADER_CACHE_DIR"),
+            "programs");
+    for (const std::string& path : System::get()->scanDirEntries(dir, true)) {
+        entries[path] = System::get()->pathModificationTime(path).valueOr(0);
+    }
+    return entries;
+}
+
+// Shaders in the range of what app UIs use: skinning-like math on the
+// vertex side, a few lights and texture lookups on the fragment side.
+static const char kVertexShaderTemplate[] = R"(
+// %s
+attribute vec4 position;
+attribute vec3 normal;
+attribute vec2 texCoord;
+uniform mat4 projection;
+uniform mat4 bones[8];
+uniform vec4 weights;
+varying vec3 vNormal;
+varying vec2 vTexCoord;
+void main(void) {
+    mat4 skin = weights.x * bones[0] + weights.y * bones[1] +
+                weights.z * bones[2] + weights.w * bones[3];
+    for (int i = 4; i < 8; ++i) {
+        skin += bones[i] * 0.125;
+    }
+    vNormal = normalize((skin * vec4(normal, 0.0)).xyz);
+    vTexCoord = texCoord;
+    gl_Position = projection * skin * position;
+}
+)";
+
+static const char kFragmentShaderTemplate[] = R"(
+// %s
+precision mediump float;
+uniform sampler2D albedo;
+uniform sampler2D detail;
+uniform vec3 lightDirs[4];
+uniform vec3 lightColors[4];
+varying vec3 vNormal;
+varying vec2 vTexCoord;
+void main() {
+    vec3 color = vec3(0.0);
+    for (int i = 0; i < 4; ++i) {
+        color += lightColors[i] * max(dot(vNormal, lightDirs[i]), 0.0);
+    }
+    vec4 base = texture2D(albedo, vTexCoord) *
+                texture2D(detail, vTexCoord * 4.0);
+    gl_FragColor = vec4(base.rgb * color, base.a);
+}
+)";
+
+static constexpr int kNumPrograms = 16;
+
+// Builds |kNumPrograms| programs whose sources are tagged with |salt|, and
+// returns the time it took in microseconds.
+static uint64_t setUpPrograms(const GLESv2Dispatch* gl,
+                              const std::string& salt,
+                              GLuint texCoordLocation = 3) {
+    const uint64_t startUs = System::get()->getHighResTimeUs();
+    for (int i = 0; i < kNumPrograms; ++i) {
+        const std::string tag = StringFormat("%s %d", salt.c_str(), i);
+        const std::string vertexSource =
+                StringFormat(kVertexShaderTemplate, tag.c_str());
+        const std::string fragmentSource =
+                StringFormat(kFragmentShaderTemplate, tag.c_str());
+        GLuint vertexShader = loadAndCompileShader(gl, GL_VERTEX_SHADER,
+                                                   vertexSource.c_str());
+        GLuint fragmentShader = loadAndCompileShader(gl, GL_FRAGMENT_SHADER,
+                                                     fragmentSource.c_str());
+        GLuint program = gl->glCreateProgram();
+        gl->glAttachShader(program, vertexShader);
+        gl->glAttachShader(program, fragmentShader);
+        gl->glBindAttribLocation(program, texCoordLocation, "texCoord");
+        gl->glLinkProgram(program);
+
+        GLint linkStatus = GL_FALSE;
+        gl->glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+        EXPECT_EQ(GL_TRUE, linkStatus);
+        EXPECT_EQ((GLint)texCoordLocation,
+                  gl->glGetAttribLocation(program, "texCoord"));
+        EXPECT_NE(-1, gl->glGetUniformLocation(program, "bones"));
+        EXPECT_NE(-1, gl->glGetUniformLocation(program, "lightColors"));
+
+        gl->glDeleteShader(vertexShader);
+        gl->glDeleteShader(fragmentShader);
+        gl->glDeleteProgram(program);
+    }
+    gl->glFinish();
+    return System::get()->getHighResTimeUs() - startUs;
+}
+
+// Setting up the same shaders a second time, as an app launched again
+// does, should hit the shader translation and program binary caches.
+TEST_F(GLTest, ShaderSetupTime) {
+    // New sources each run, so that the first setup is a cold one.
+    const std::string salt = StringFormat(
+            "%llu", (unsigned long long)System::get()->getUnixTimeUs());
+
+    const ProgramCacheEntries before = getProgramCacheEntries();
+    const uint64_t coldUs = setUpPrograms(gl, salt);
+    const ProgramCacheEntries cold = getProgramCacheEntries();
+    const uint64_t warmUs = setUpPrograms(gl, salt);
+    const ProgramCacheEntries warm = getProgramCacheEntries();
+    EXPECT_EQ((GLenum)GL_NO_ERROR, gl->glGetError());
+
+    printf("Shader setup for %d programs: cold %.2f ms, warm %.2f ms\n",
+           kNumPrograms, coldUs / 1000.0, warmUs / 1000.0);
+
+    if (cold.size() == before.size()) {
+        // The host driver can't save program binaries.
+        printf("Program binary cache not used on this host\n");
+        return;
+    }
+    EXPECT_EQ(before.size() + kNumPrograms, cold.size());
+    // Every warm link was served from the cache.
+    EXPECT_EQ(cold, warm);
+
+    // The same sources with another attribute binding link to other
+    // programs, which must not come from the entries above.
+    setUpPrograms(gl, salt, 2);
+    EXPECT_EQ(warm.size() + kNumPrograms, getProgramCacheEntries().size());
+}
+
+}  // namespace emugl
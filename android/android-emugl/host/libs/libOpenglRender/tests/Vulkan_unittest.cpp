@@ -16,14 +16,19 @@
 
 #include "FrameBuffer.h"
 #include "VkCommonOperations.h"
+#include "VkDecoderGlobalState.h"
+#include "VkQueueSubmitBatcher.h"
 #include "VulkanDispatch.h"
 #include "emugl/common/feature_control.h"
+#include "emugl/common/vm_operations.h"
 
 #include "android/base/ArraySize.h"
 #include "android/base/GLObjectCounter.h"
+#include "android/base/Pool.h"
 #include "android/base/files/PathUtils.h"
 #include "android/base/system/System.h"
 #include "android/base/testing/TestSystem.h"
+#include "android/base/threads/FunctorThread.h"
 #include "android/emulation/control/AndroidAgentFactory.h"
 
 #include "Standalone.h"
@@ -477,6 +482,128 @@ TEST_F(VulkanTest, StagingMemoryQuery) {
         &mVk, mDevice, &memProps, &typeIndex));
 }
 
+// Submits a chain of command buffers ordered by semaphores through the
+// submit batcher and checks that they run, merged in one host submit.
+TEST_F(VulkanTest, QueueSubmitBatcher) {
+    uint32_t queueFamilyCount;
+    mVk.vkGetPhysicalDeviceQueueFamilyProperties(
+        mPhysicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    mVk.vkGetPhysicalDeviceQueueFamilyProperties(
+        mPhysicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    // The first family testDeviceCreation() creates queues for.
+    uint32_t queueFamilyIndex = 0;
+    while (queueFamilyIndex < queueFamilyCount &&
+           !(queueFamilies[queueFamilyIndex].queueCount &&
+             (queueFamilies[queueFamilyIndex].queueFlags &
+              (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))) {
+        ++queueFamilyIndex;
+    }
+    ASSERT_LT(queueFamilyIndex, queueFamilyCount);
+
+    VkQueue queue;
+    mVk.vkGetDeviceQueue(mDevice, queueFamilyIndex, 0, &queue);
+
+    VkCommandPoolCreateInfo poolCi = {
+        VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, 0, 0,
+        queueFamilyIndex,
+    };
+    VkCommandPool pool;
+    ASSERT_EQ(VK_SUCCESS,
+              mVk.vkCreateCommandPool(mDevice, &poolCi, nullptr, &pool));
+
+    constexpr uint32_t kCount = 16;
+
+    VkCommandBufferAllocateInfo allocInfo = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, 0,
+        pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, kCount,
+    };
+    std::vector<VkCommandBuffer> commandBuffers(kCount);
+    ASSERT_EQ(VK_SUCCESS,
+              mVk.vkAllocateCommandBuffers(mDevice, &allocInfo,
+                                           commandBuffers.data()));
+
+    VkCommandBufferBeginInfo beginInfo = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, 0,
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr,
+    };
+    for (auto commandBuffer : commandBuffers) {
+        EXPECT_EQ(VK_SUCCESS,
+                  mVk.vkBeginCommandBuffer(commandBuffer, &beginInfo));
+        EXPECT_EQ(VK_SUCCESS, mVk.vkEndCommandBuffer(commandBuffer));
+    }
+
+    VkSemaphoreCreateInfo semaphoreCi = {
+        VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, 0, 0,
+    };
+    std::vector<VkSemaphore> semaphores(kCount - 1);
+    for (auto& semaphore : semaphores) {
+        EXPECT_EQ(VK_SUCCESS, mVk.vkCreateSemaphore(mDevice, &semaphoreCi,
+                                                    nullptr, &semaphore));
+    }
+
+    VkFenceCreateInfo fenceCi = {
+        VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, 0, 0,
+    };
+    VkFence fence;
+    ASSERT_EQ(VK_SUCCESS, mVk.vkCreateFence(mDevice, &fenceCi, nullptr, &fence));
+
+    {
+        // A window long enough that only the fence sends the submits.
+        goldfish_vk::VkQueueSubmitBatcher batcher(
+            [this, queue](uint32_t submitCount, const VkSubmitInfo* pSubmits,
+                          VkFence fence) {
+                return mVk.vkQueueSubmit(queue, submitCount, pSubmits, fence);
+            },
+            10000000 /* 10 s */);
+
+        const VkPipelineStageFlags waitStage =
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        for (uint32_t i = 0; i < kCount; ++i) {
+            VkSubmitInfo submitInfo = {
+                VK_STRUCTURE_TYPE_SUBMIT_INFO, 0,
+                i ? 1u : 0u, i ? &semaphores[i - 1] : nullptr, &waitStage,
+                1, &commandBuffers[i],
+                i + 1 < kCount ? 1u : 0u,
+                i + 1 < kCount ? &semaphores[i] : nullptr,
+            };
+            EXPECT_EQ(VK_SUCCESS,
+                      batcher.submit(1, &submitInfo,
+                                     i + 1 < kCount ? VK_NULL_HANDLE : fence));
+        }
+
+        EXPECT_EQ(VK_SUCCESS, mVk.vkWaitForFences(mDevice, 1, &fence, VK_TRUE,
+                                                  1000000000ULL /* 1 s */));
+
+        const auto stats = batcher.getStats();
+        EXPECT_EQ(kCount, stats.submits);
+        EXPECT_EQ(kCount, stats.batches);
+        EXPECT_EQ(1u, stats.hostSubmits);
+        EXPECT_EQ(kCount, stats.maxBatchesPerHostSubmit);
+
+        // Fenceless submits complete once flushed, and waiting for the
+        // queue through the batcher flushes them.
+        VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO, 0,
+            0, nullptr, nullptr,
+            0, nullptr,
+            0, nullptr,
+        };
+        EXPECT_EQ(VK_SUCCESS, batcher.submit(1, &submitInfo, VK_NULL_HANDLE));
+        EXPECT_EQ(VK_SUCCESS, batcher.flushAndRun([this, queue] {
+            return mVk.vkQueueWaitIdle(queue);
+        }));
+        EXPECT_EQ(2u, batcher.getStats().hostSubmits);
+    }
+
+    mVk.vkDestroyFence(mDevice, fence, nullptr);
+    for (auto semaphore : semaphores) {
+        mVk.vkDestroySemaphore(mDevice, semaphore, nullptr);
+    }
+    mVk.vkDestroyCommandPool(mDevice, pool, nullptr);
+}
+
 #ifndef _WIN32 // TODO: Get this working w/ Swiftshader vk on Windows
 class VulkanFrameBufferTest : public VulkanTest {
 protected:
@@ -496,6 +623,7 @@ protected:
         emugl::setGLObjectCounter(android::base::GLObjectCounter::get());
         emugl::set_emugl_window_operations(*getConsoleAgents()->emu);
         emugl::set_emugl_multi_display_operations(*getConsoleAgents()->multi_display);
+        emugl::set_emugl_vm_operations(*getConsoleAgents()->vm);
         const EGLDispatch* egl = LazyLoadedEGLDispatch::get();
         ASSERT_NE(nullptr, egl);
         ASSERT_NE(nullptr, LazyLoadedGLESv2Dispatch::get());
@@ -603,5 +731,129 @@ TEST_F(VulkanFrameBufferTest, VkColorBufferWithMemoryPropertyFlags) {
     EXPECT_TRUE(goldfish_vk::teardownVkColorBuffer(colorBuffer));
     mFb->closeColorBuffer(colorBuffer);
 }
+
+// Runs guest-like instances and devices on several threads at once through
+// the decoder state, the way separate guest processes do.
+TEST_F(VulkanFrameBufferTest, ConcurrentDevicesThroughDecoderState) {
+    constexpr int kThreadCount = 4;
+    constexpr int kIterations = 50;
+
+    auto* state = goldfish_vk::VkDecoderGlobalState::get();
+
+    auto run = [state] {
+        android::base::Pool pool;
+
+        VkInstanceCreateInfo instanceCi = {
+            VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO, 0, 0,
+            nullptr,
+            0, nullptr,
+            0, nullptr,
+        };
+        VkInstance instance;
+        ASSERT_EQ(VK_SUCCESS, state->on_vkCreateInstance(
+                &pool, &instanceCi, nullptr, &instance));
+
+        uint32_t physicalDeviceCount = 1;
+        VkPhysicalDevice physicalDevice;
+        VkResult res = state->on_vkEnumeratePhysicalDevices(
+                &pool, instance, &physicalDeviceCount, &physicalDevice);
+        ASSERT_TRUE(res == VK_SUCCESS || res == VK_INCOMPLETE);
+        ASSERT_EQ(1u, physicalDeviceCount);
+
+        auto vk = goldfish_vk::dispatch_VkPhysicalDevice(physicalDevice);
+        auto unboxedPhysicalDevice =
+                goldfish_vk::unbox_VkPhysicalDevice(physicalDevice);
+
+        uint32_t queueFamilyCount;
+        vk->vkGetPhysicalDeviceQueueFamilyProperties(
+                unboxedPhysicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vk->vkGetPhysicalDeviceQueueFamilyProperties(
+                unboxedPhysicalDevice, &queueFamilyCount, queueFamilies.data());
+
+        uint32_t queueFamilyIndex = 0;
+        while (queueFamilyIndex < queueFamilyCount &&
+               !(queueFamilies[queueFamilyIndex].queueFlags &
+                 VK_QUEUE_GRAPHICS_BIT)) {
+            ++queueFamilyIndex;
+        }
+        ASSERT_LT(queueFamilyIndex, queueFamilyCount);
+
+        VkPhysicalDeviceMemoryProperties memProps;
+        vk->vkGetPhysicalDeviceMemoryProperties(unboxedPhysicalDevice,
+                                                &memProps);
+        uint32_t memoryTypeIndex = 0;
+        while (memoryTypeIndex < memProps.memoryTypeCount &&
+               !(memProps.memoryTypes[memoryTypeIndex].propertyFlags &
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+            ++memoryTypeIndex;
+        }
+        ASSERT_LT(memoryTypeIndex, memProps.memoryTypeCount);
+
+        float priority = 1.0f;
+        VkDeviceQueueCreateInfo queueCi = {
+            VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, 0, 0,
+            queueFamilyIndex, 1, &priority,
+        };
+        VkDeviceCreateInfo deviceCi = {
+            VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO, 0, 0,
+            1, &queueCi,
+            0, nullptr,
+            0, nullptr,
+            nullptr,
+        };
+        VkDevice device;
+        ASSERT_EQ(VK_SUCCESS, state->on_vkCreateDevice(
+                &pool, physicalDevice, &deviceCi, nullptr, &device));
+
+        VkQueue queue;
+        state->on_vkGetDeviceQueue(&pool, device, queueFamilyIndex, 0, &queue);
+
+        for (int i = 0; i < kIterations; ++i) {
+            VkMemoryAllocateInfo allocInfo = {
+                VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, 0,
+                65536, memoryTypeIndex,
+            };
+            VkDeviceMemory boxedMemory;
+            ASSERT_EQ(VK_SUCCESS, state->on_vkAllocateMemory(
+                    &pool, device, &allocInfo, nullptr, &boxedMemory));
+            VkDeviceMemory memory =
+                    goldfish_vk::unbox_non_dispatchable_VkDeviceMemory(
+                            boxedMemory);
+
+            void* ptr = nullptr;
+            EXPECT_EQ(VK_SUCCESS, state->on_vkMapMemory(
+                    &pool, device, memory, 0, VK_WHOLE_SIZE, 0, &ptr));
+            EXPECT_NE(nullptr, ptr);
+
+            VkSubmitInfo submitInfo = {
+                VK_STRUCTURE_TYPE_SUBMIT_INFO, 0,
+                0, nullptr, nullptr,
+                0, nullptr,
+                0, nullptr,
+            };
+            EXPECT_EQ(VK_SUCCESS, state->on_vkQueueSubmit(
+                    &pool, queue, 1, &submitInfo, VK_NULL_HANDLE));
+            EXPECT_EQ(VK_SUCCESS, state->on_vkQueueWaitIdle(&pool, queue));
+
+            state->on_vkFreeMemory(&pool, device, memory, nullptr);
+            goldfish_vk::delete_boxed_non_dispatchable_VkDeviceMemory(
+                    boxedMemory);
+        }
+
+        EXPECT_EQ(VK_SUCCESS, state->on_vkDeviceWaitIdle(&pool, device));
+        state->on_vkDestroyDevice(&pool, device, nullptr);
+        state->on_vkDestroyInstance(&pool, instance, nullptr);
+    };
+
+    std::vector<std::unique_ptr<android::base::FunctorThread>> threads;
+    for (int i = 0; i < kThreadCount; ++i) {
+        threads.emplace_back(new android::base::FunctorThread(run));
+        ASSERT_TRUE(threads.back()->start());
+    }
+    for (auto& thread : threads) {
+        thread->wait();
+    }
+}
 #endif // !_WIN32
 } // namespace emugl
@@ -486,6 +486,12 @@ custom_decodes = {
     "vkCmdExecuteCommands" : emit_global_state_wrapped_decoding,
     "vkQueueSubmit" : emit_global_state_wrapped_decoding,
     "vkQueueWaitIdle" : emit_global_state_wrapped_decoding,
+    "vkQueueBindSparse" : emit_global_state_wrapped_decoding,
+    "vkDeviceWaitIdle" : emit_global_state_wrapped_decoding,
+    "vkQueuePresentKHR" : emit_global_state_wrapped_decoding,
+    "vkQueueBeginDebugUtilsLabelEXT" : emit_global_state_wrapped_decoding,
+    "vkQueueEndDebugUtilsLabelEXT" : emit_global_state_wrapped_decoding,
+    "vkQueueInsertDebugUtilsLabelEXT" : emit_global_state_wrapped_decoding,
     "vkBeginCommandBuffer" : emit_global_state_wrapped_decoding,
     "vkResetCommandBuffer" : emit_global_state_wrapped_decoding,
     "vkFreeCommandBuffers" : emit_global_state_wrapped_decoding,
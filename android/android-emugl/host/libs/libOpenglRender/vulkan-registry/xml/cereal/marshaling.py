@@ -17,7 +17,8 @@ from copy import copy
 
 from .common.codegen import CodeGen, VulkanAPIWrapper
 from .common.vulkantypes import \
-        VulkanAPI, makeVulkanTypeSimple, iterateVulkanType, VulkanTypeIterator, Atom, FuncExpr, FuncExprVal, FuncLambda
+        VulkanAPI, makeVulkanTypeSimple, iterateVulkanType, VulkanTypeIterator, Atom, FuncExpr, FuncExprVal, FuncLambda, \
+        vulkanTypeNeedsTransform, TRANSFORMED_TYPES
 
 from .wrapperdefs import VulkanWrapperGenerator
 from .wrapperdefs import VULKAN_STREAM_VAR_NAME
@@ -30,6 +31,26 @@ from .wrapperdefs import STRUCT_EXTENSION_PARAM, STRUCT_EXTENSION_PARAM_FOR_WRIT
 from .wrapperdefs import API_PREFIX_MARSHAL
 from .wrapperdefs import API_PREFIX_UNMARSHAL
 
+# Size and alignment of the types streamed as their in-memory representation.
+IN_PLACE_PRIMITIVE_TYPES = {
+    "char" : 1,
+    "int8_t" : 1,
+    "uint8_t" : 1,
+    "int16_t" : 2,
+    "uint16_t" : 2,
+    "int32_t" : 4,
+    "uint32_t" : 4,
+    "float" : 4,
+    "int64_t" : 8,
+    "uint64_t" : 8,
+    "double" : 8,
+    "VkBool32" : 4,
+    "VkFlags" : 4,
+    "VkSampleMask" : 4,
+    "VkDeviceSize" : 8,
+    "VkDeviceAddress" : 8,
+}
+
 class VulkanMarshalingCodegen(VulkanTypeIterator):
 
     def __init__(self,
@@ -83,6 +104,102 @@ class VulkanMarshalingCodegen(VulkanTypeIterator):
         return "(%s)" % (
             self.cgen.makeCTypeDecl(vulkanType, useParamName=False))
 
+    # Returns (size, alignment) of |typeName| when its stream encoding is
+    # byte for byte its host memory layout, so that const arrays of it can
+    # be referenced from the stream's buffer without being copied, or None.
+    # Structs qualify when all their members do, without any padding;
+    # handles, pointers and anything filtered or transformed never do.
+    def inPlaceLayout(self, typeName):
+        if typeName in IN_PLACE_PRIMITIVE_TYPES:
+            size = IN_PLACE_PRIMITIVE_TYPES[typeName]
+            return (size, size)
+
+        if typeName in TRANSFORMED_TYPES:
+            return None
+
+        category = self.typeInfo.typeCategories.get(typeName, None)
+
+        if category in ["enum", "bitmask"]:
+            return (4, 4)
+
+        if category != "struct":
+            return None
+
+        structInfo = self.typeInfo.structs.get(typeName, None)
+        if structInfo is None or vulkanTypeNeedsTransform(structInfo):
+            return None
+
+        for bindingInfo in structInfo.environment.values():
+            if not bindingInfo["structmember"]:
+                return None
+
+        offset = 0
+        structAlignment = 1
+
+        for member in structInfo.members:
+            if member.pointerIndirectionLevels > 0 or \
+               member.filterVar is not None or \
+               member.deviceMemoryAttrib is not None or \
+               member.binds or \
+               (member.staticArrExpr and not member.staticArrCount):
+                return None
+
+            memberLayout = self.inPlaceLayout(member.typeName)
+            if memberLayout is None:
+                return None
+
+            (memberSize, memberAlignment) = memberLayout
+            if offset % memberAlignment:
+                return None
+
+            if member.staticArrExpr:
+                memberSize *= member.staticArrCount
+
+            offset += memberSize
+            structAlignment = max(structAlignment, memberAlignment)
+
+        if offset == 0 or offset % structAlignment:
+            return None
+
+        return (offset, structAlignment)
+
+    # Whether a read of |vulkanType| can use loadArrayInPlace.
+    # Only the host decodes from a buffer that outlives the call, and only
+    # const data can be left in it: the snapshot keeps the raw bytes.
+    def canLoadInPlace(self, vulkanType):
+        if not (self.dynAlloc and self.direction == "read"):
+            return False
+
+        if not vulkanType.isConst or \
+           vulkanType.pointerIndirectionLevels != 1 or \
+           vulkanType.isHandleType() or \
+           vulkanType.binds:
+            return False
+
+        if vulkanType.typeName == "void":
+            return self.lenAccessor(vulkanType) is not None
+
+        return self.inPlaceLayout(vulkanType.typeName) is not None
+
+    def genLoadInPlaceCall(self, vulkanType):
+        access = self.exprAccessor(vulkanType)
+        lenAccess = self.lenAccessor(vulkanType)
+        sizeof = self.cgen.sizeofExpr(vulkanType.getForValueAccess())
+
+        if lenAccess:
+            bytesExpr = "%s * %s" % (lenAccess, sizeof)
+        else:
+            bytesExpr = sizeof
+
+        if vulkanType.typeName == "void":
+            alignment = 1
+        else:
+            alignment = self.inPlaceLayout(vulkanType.typeName)[1]
+
+        self.cgen.stmt( \
+            "%s->loadArrayInPlace((void**)&%s, %s, %d)" %
+                (self.streamVarName, access, bytesExpr, alignment))
+
     def genStreamCall(self, vulkanType, toStreamExpr, sizeExpr):
         varname = self.streamVarName
         func = self.processSimple
@@ -401,6 +518,11 @@ class VulkanMarshalingCodegen(VulkanTypeIterator):
 
         self.beginFilterGuard(vulkanType)
 
+        if self.canLoadInPlace(vulkanType):
+            self.genLoadInPlaceCall(vulkanType)
+            self.endFilterGuard(vulkanType, "%s = 0" % access)
+            return
+
         if vulkanType.pointerIndirectionLevels > 0:
             self.doAllocSpace(vulkanType)
 
@@ -509,11 +631,17 @@ class VulkanMarshalingCodegen(VulkanTypeIterator):
         lenAccess = self.lenAccessor(vulkanType)
 
         self.beginFilterGuard(vulkanType)
-        self.doAllocSpace(vulkanType)
 
         if vulkanType.filterVar != None:
             print("onPointer Needs filter: %s filterVar %s" % (access, vulkanType.filterVar))
 
+        if self.canLoadInPlace(vulkanType):
+            self.genLoadInPlaceCall(vulkanType)
+            self.endFilterGuard(vulkanType, "%s = 0" % access)
+            return
+
+        self.doAllocSpace(vulkanType)
+
         if vulkanType.isHandleType() and self.mapHandles:
             self.genHandleMappingCall(vulkanType, access, lenAccess)
         else:
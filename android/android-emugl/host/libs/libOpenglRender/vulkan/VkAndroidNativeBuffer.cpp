@@ -418,11 +418,26 @@ void AndroidNativeBufferInfo::QueueState::teardown(
     queueFamilyIndex = 0;
 }
 
+VkQueue getAndroidNativeImageSignalQueue(
+    const AndroidNativeBufferInfo* anbInfo,
+    VkQueue defaultQueue) {
+
+    bool firstTimeSetup =
+        !anbInfo->everSynced &&
+        !anbInfo->everAcquired;
+
+    if (firstTimeSetup ||
+        anbInfo->lastUsedQueueFamilyIndex >= anbInfo->queueStates.size()) {
+        return defaultQueue;
+    }
+
+    return anbInfo->queueStates[anbInfo->lastUsedQueueFamilyIndex].queue;
+}
+
 VkResult setAndroidNativeImageSemaphoreSignaled(
     VulkanDispatch* vk,
     VkDevice device,
-    VkQueue defaultQueue,
-    uint32_t defaultQueueFamilyIndex,
+    VkQueue queue,
     VkSemaphore semaphore,
     VkFence fence,
     AndroidNativeBufferInfo* anbInfo) {
@@ -445,7 +460,7 @@ VkResult setAndroidNativeImageSemaphoreSignaled(
             1, &semaphore,
         };
 
-        vk->vkQueueSubmit(defaultQueue, 1, &submitInfo, fence);
+        vk->vkQueueSubmit(queue, 1, &submitInfo, fence);
     } else {
 
         const AndroidNativeBufferInfo::QueueState& queueState =
@@ -497,17 +512,15 @@ VkResult setAndroidNativeImageSemaphoreSignaled(
                 &semaphore,
             };
 
-            vk->vkQueueSubmit(queueState.queue, 1, &submitInfo, fence);
+            vk->vkQueueSubmit(queue, 1, &submitInfo, fence);
         } else {
-            const AndroidNativeBufferInfo::QueueState&
-                queueState = anbInfo->queueStates[anbInfo->lastUsedQueueFamilyIndex];
             VkSubmitInfo submitInfo = {
                 VK_STRUCTURE_TYPE_SUBMIT_INFO, 0,
                 0, nullptr, nullptr,
                 0, nullptr,
                 1, &semaphore,
             };
-            vk->vkQueueSubmit(queueState.queue, 1, &submitInfo, fence);
+            vk->vkQueueSubmit(queue, 1, &submitInfo, fence);
         }
     }
 
@@ -544,6 +557,10 @@ VkResult syncImageToColorBuffer(
             vk, anbInfo->device, queue, queueFamilyIndex);
     }
 
+    // Submit on the queue of the caller, which it serializes with the guest
+    // submits; the command pool is good for any queue of the family.
+    queueState.queue = queue;
+
     // Record our synchronization commands.
     VkCommandBufferBeginInfo beginInfo = {
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, 0,
@@ -669,7 +686,7 @@ VkResult syncImageToColorBuffer(
         0, nullptr,
     };
 
-    vk->vkQueueSubmit(queueState.queue, 1, &submitInfo, queueState.fence);
+    vk->vkQueueSubmit(queue, 1, &submitInfo, queueState.fence);
 
     static constexpr uint64_t ANB_MAX_WAIT_NS =
         5ULL * 1000ULL * 1000ULL * 1000ULL;
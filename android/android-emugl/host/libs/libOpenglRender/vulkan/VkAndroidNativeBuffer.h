@@ -123,11 +123,16 @@ void getGralloc1Usage(VkFormat format, VkImageUsageFlags imageUsage,
                       uint64_t* consumerUsage_out,
                       uint64_t* producerUsage_out);
 
+// The queue that setAndroidNativeImageSemaphoreSignaled submits on: the
+// last queue the image was synced on, or |defaultQueue| before that.
+VkQueue getAndroidNativeImageSignalQueue(
+    const AndroidNativeBufferInfo* anbInfo,
+    VkQueue defaultQueue);
+
 VkResult setAndroidNativeImageSemaphoreSignaled(
     VulkanDispatch* vk,
     VkDevice device,
-    VkQueue defaultQueue,
-    uint32_t defaultQueueFamilyIndex,
+    VkQueue queue,
     VkSemaphore semaphore,
     VkFence fence,
     AndroidNativeBufferInfo* anbInfo);
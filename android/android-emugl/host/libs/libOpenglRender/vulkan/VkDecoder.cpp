@@ -1278,7 +1278,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                     fprintf(stderr, "stream %p: call vkDeviceWaitIdle 0x%llx \n", ioStream, (unsigned long long)device);
                 }
                 VkResult vkDeviceWaitIdle_VkResult_return = (VkResult)0;
-                vkDeviceWaitIdle_VkResult_return = vk->vkDeviceWaitIdle(unboxed_device);
+                vkDeviceWaitIdle_VkResult_return = m_state->on_vkDeviceWaitIdle(&m_pool, device);
                 vkStream->unsetHandleMapping();
                 vkStream->write(&vkDeviceWaitIdle_VkResult_return, sizeof(VkResult));
                 vkStream->commitWrite();
@@ -2061,7 +2061,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                     fprintf(stderr, "stream %p: call vkQueueBindSparse 0x%llx 0x%llx 0x%llx 0x%llx \n", ioStream, (unsigned long long)queue, (unsigned long long)bindInfoCount, (unsigned long long)pBindInfo, (unsigned long long)fence);
                 }
                 VkResult vkQueueBindSparse_VkResult_return = (VkResult)0;
-                vkQueueBindSparse_VkResult_return = vk->vkQueueBindSparse(unboxed_queue, bindInfoCount, pBindInfo, fence);
+                vkQueueBindSparse_VkResult_return = m_state->on_vkQueueBindSparse(&m_pool, queue, bindInfoCount, pBindInfo, fence);
                 vkStream->unsetHandleMapping();
                 vkStream->write(&vkQueueBindSparse_VkResult_return, sizeof(VkResult));
                 vkStream->commitWrite();
@@ -3178,8 +3178,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 uint64_t cgen_var_162;
                 vkReadStream->read((uint64_t*)&cgen_var_162, 1 * 8);
                 vkReadStream->handleMapping()->mapHandles_u64_VkImage(&cgen_var_162, (VkImage*)&image, 1);
-                vkReadStream->alloc((void**)&pSubresource, sizeof(const VkImageSubresource));
-                unmarshal_VkImageSubresource(vkReadStream, (VkImageSubresource*)(pSubresource));
+                vkReadStream->loadArrayInPlace((void**)&pSubresource, sizeof(const VkImageSubresource), 4);
                 // Begin manual dispatchable handle unboxing for pLayout;
                 vkReadStream->unsetHandleMapping();
                 vkReadStream->alloc((void**)&pLayout, sizeof(VkSubresourceLayout));
@@ -5275,11 +5274,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 // End manual dispatchable handle unboxing for commandBuffer;
                 vkReadStream->read((uint32_t*)&firstViewport, sizeof(uint32_t));
                 vkReadStream->read((uint32_t*)&viewportCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pViewports, ((viewportCount)) * sizeof(const VkViewport));
-                for (uint32_t i = 0; i < (uint32_t)((viewportCount)); ++i)
-                {
-                    unmarshal_VkViewport(vkReadStream, (VkViewport*)(pViewports + i));
-                }
+                vkReadStream->loadArrayInPlace((void**)&pViewports, ((viewportCount)) * sizeof(const VkViewport), 4);
                 if (pViewports)
                 {
                     for (uint32_t i = 0; i < (uint32_t)((viewportCount)); ++i)
@@ -5320,11 +5315,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 // End manual dispatchable handle unboxing for commandBuffer;
                 vkReadStream->read((uint32_t*)&firstScissor, sizeof(uint32_t));
                 vkReadStream->read((uint32_t*)&scissorCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pScissors, ((scissorCount)) * sizeof(const VkRect2D));
-                for (uint32_t i = 0; i < (uint32_t)((scissorCount)); ++i)
-                {
-                    unmarshal_VkRect2D(vkReadStream, (VkRect2D*)(pScissors + i));
-                }
+                vkReadStream->loadArrayInPlace((void**)&pScissors, ((scissorCount)) * sizeof(const VkRect2D), 4);
                 if (pScissors)
                 {
                     for (uint32_t i = 0; i < (uint32_t)((scissorCount)); ++i)
@@ -5604,8 +5595,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                     vkReadStream->handleMapping()->mapHandles_u64_VkDescriptorSet(cgen_var_294, (VkDescriptorSet*)pDescriptorSets, ((descriptorSetCount)));
                 }
                 vkReadStream->read((uint32_t*)&dynamicOffsetCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pDynamicOffsets, ((dynamicOffsetCount)) * sizeof(const uint32_t));
-                vkReadStream->read((uint32_t*)pDynamicOffsets, ((dynamicOffsetCount)) * sizeof(const uint32_t));
+                vkReadStream->loadArrayInPlace((void**)&pDynamicOffsets, ((dynamicOffsetCount)) * sizeof(const uint32_t), 4);
                 if (m_logCalls)
                 {
                     fprintf(stderr, "stream %p: call vkCmdBindDescriptorSets 0x%llx 0x%llx 0x%llx 0x%llx 0x%llx 0x%llx 0x%llx 0x%llx \n", ioStream, (unsigned long long)commandBuffer, (unsigned long long)pipelineBindPoint, (unsigned long long)layout, (unsigned long long)firstSet, (unsigned long long)descriptorSetCount, (unsigned long long)pDescriptorSets, (unsigned long long)dynamicOffsetCount, (unsigned long long)pDynamicOffsets);
@@ -5684,8 +5674,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                     vkReadStream->read((uint64_t*)cgen_var_298, ((bindingCount)) * 8);
                     vkReadStream->handleMapping()->mapHandles_u64_VkBuffer(cgen_var_298, (VkBuffer*)pBuffers, ((bindingCount)));
                 }
-                vkReadStream->alloc((void**)&pOffsets, ((bindingCount)) * sizeof(const VkDeviceSize));
-                vkReadStream->read((VkDeviceSize*)pOffsets, ((bindingCount)) * sizeof(const VkDeviceSize));
+                vkReadStream->loadArrayInPlace((void**)&pOffsets, ((bindingCount)) * sizeof(const VkDeviceSize), 8);
                 if (m_logCalls)
                 {
                     fprintf(stderr, "stream %p: call vkCmdBindVertexBuffers 0x%llx 0x%llx 0x%llx 0x%llx 0x%llx \n", ioStream, (unsigned long long)commandBuffer, (unsigned long long)firstBinding, (unsigned long long)bindingCount, (unsigned long long)pBuffers, (unsigned long long)pOffsets);
@@ -5943,11 +5932,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 vkReadStream->read((uint64_t*)&cgen_var_310, 1 * 8);
                 vkReadStream->handleMapping()->mapHandles_u64_VkBuffer(&cgen_var_310, (VkBuffer*)&dstBuffer, 1);
                 vkReadStream->read((uint32_t*)&regionCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pRegions, ((regionCount)) * sizeof(const VkBufferCopy));
-                for (uint32_t i = 0; i < (uint32_t)((regionCount)); ++i)
-                {
-                    unmarshal_VkBufferCopy(vkReadStream, (VkBufferCopy*)(pRegions + i));
-                }
+                vkReadStream->loadArrayInPlace((void**)&pRegions, ((regionCount)) * sizeof(const VkBufferCopy), 8);
                 if (pRegions)
                 {
                     for (uint32_t i = 0; i < (uint32_t)((regionCount)); ++i)
@@ -5998,11 +5983,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 vkReadStream->handleMapping()->mapHandles_u64_VkImage(&cgen_var_313, (VkImage*)&dstImage, 1);
                 vkReadStream->read((VkImageLayout*)&dstImageLayout, sizeof(VkImageLayout));
                 vkReadStream->read((uint32_t*)&regionCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pRegions, ((regionCount)) * sizeof(const VkImageCopy));
-                for (uint32_t i = 0; i < (uint32_t)((regionCount)); ++i)
-                {
-                    unmarshal_VkImageCopy(vkReadStream, (VkImageCopy*)(pRegions + i));
-                }
+                vkReadStream->loadArrayInPlace((void**)&pRegions, ((regionCount)) * sizeof(const VkImageCopy), 4);
                 if (pRegions)
                 {
                     for (uint32_t i = 0; i < (uint32_t)((regionCount)); ++i)
@@ -6054,11 +6035,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 vkReadStream->handleMapping()->mapHandles_u64_VkImage(&cgen_var_316, (VkImage*)&dstImage, 1);
                 vkReadStream->read((VkImageLayout*)&dstImageLayout, sizeof(VkImageLayout));
                 vkReadStream->read((uint32_t*)&regionCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pRegions, ((regionCount)) * sizeof(const VkImageBlit));
-                for (uint32_t i = 0; i < (uint32_t)((regionCount)); ++i)
-                {
-                    unmarshal_VkImageBlit(vkReadStream, (VkImageBlit*)(pRegions + i));
-                }
+                vkReadStream->loadArrayInPlace((void**)&pRegions, ((regionCount)) * sizeof(const VkImageBlit), 4);
                 vkReadStream->read((VkFilter*)&filter, sizeof(VkFilter));
                 if (pRegions)
                 {
@@ -6108,11 +6085,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 vkReadStream->handleMapping()->mapHandles_u64_VkImage(&cgen_var_319, (VkImage*)&dstImage, 1);
                 vkReadStream->read((VkImageLayout*)&dstImageLayout, sizeof(VkImageLayout));
                 vkReadStream->read((uint32_t*)&regionCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pRegions, ((regionCount)) * sizeof(const VkBufferImageCopy));
-                for (uint32_t i = 0; i < (uint32_t)((regionCount)); ++i)
-                {
-                    unmarshal_VkBufferImageCopy(vkReadStream, (VkBufferImageCopy*)(pRegions + i));
-                }
+                vkReadStream->loadArrayInPlace((void**)&pRegions, ((regionCount)) * sizeof(const VkBufferImageCopy), 8);
                 if (pRegions)
                 {
                     for (uint32_t i = 0; i < (uint32_t)((regionCount)); ++i)
@@ -6161,11 +6134,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 vkReadStream->read((uint64_t*)&cgen_var_322, 1 * 8);
                 vkReadStream->handleMapping()->mapHandles_u64_VkBuffer(&cgen_var_322, (VkBuffer*)&dstBuffer, 1);
                 vkReadStream->read((uint32_t*)&regionCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pRegions, ((regionCount)) * sizeof(const VkBufferImageCopy));
-                for (uint32_t i = 0; i < (uint32_t)((regionCount)); ++i)
-                {
-                    unmarshal_VkBufferImageCopy(vkReadStream, (VkBufferImageCopy*)(pRegions + i));
-                }
+                vkReadStream->loadArrayInPlace((void**)&pRegions, ((regionCount)) * sizeof(const VkBufferImageCopy), 8);
                 if (pRegions)
                 {
                     for (uint32_t i = 0; i < (uint32_t)((regionCount)); ++i)
@@ -6210,8 +6179,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 vkReadStream->handleMapping()->mapHandles_u64_VkBuffer(&cgen_var_324, (VkBuffer*)&dstBuffer, 1);
                 vkReadStream->read((VkDeviceSize*)&dstOffset, sizeof(VkDeviceSize));
                 vkReadStream->read((VkDeviceSize*)&dataSize, sizeof(VkDeviceSize));
-                vkReadStream->alloc((void**)&pData, ((dataSize)) * sizeof(const uint8_t));
-                vkReadStream->read((void*)pData, ((dataSize)) * sizeof(const uint8_t));
+                vkReadStream->loadArrayInPlace((void**)&pData, ((dataSize)) * sizeof(const uint8_t), 1);
                 if (m_logCalls)
                 {
                     fprintf(stderr, "stream %p: call vkCmdUpdateBuffer 0x%llx 0x%llx 0x%llx 0x%llx 0x%llx \n", ioStream, (unsigned long long)commandBuffer, (unsigned long long)dstBuffer, (unsigned long long)dstOffset, (unsigned long long)dataSize, (unsigned long long)pData);
@@ -6290,11 +6258,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 vkReadStream->alloc((void**)&pColor, sizeof(const VkClearColorValue));
                 unmarshal_VkClearColorValue(vkReadStream, (VkClearColorValue*)(pColor));
                 vkReadStream->read((uint32_t*)&rangeCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pRanges, ((rangeCount)) * sizeof(const VkImageSubresourceRange));
-                for (uint32_t i = 0; i < (uint32_t)((rangeCount)); ++i)
-                {
-                    unmarshal_VkImageSubresourceRange(vkReadStream, (VkImageSubresourceRange*)(pRanges + i));
-                }
+                vkReadStream->loadArrayInPlace((void**)&pRanges, ((rangeCount)) * sizeof(const VkImageSubresourceRange), 4);
                 if (pColor)
                 {
                     transform_tohost_VkClearColorValue(m_state, (VkClearColorValue*)(pColor));
@@ -6343,14 +6307,9 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 vkReadStream->read((uint64_t*)&cgen_var_330, 1 * 8);
                 vkReadStream->handleMapping()->mapHandles_u64_VkImage(&cgen_var_330, (VkImage*)&image, 1);
                 vkReadStream->read((VkImageLayout*)&imageLayout, sizeof(VkImageLayout));
-                vkReadStream->alloc((void**)&pDepthStencil, sizeof(const VkClearDepthStencilValue));
-                unmarshal_VkClearDepthStencilValue(vkReadStream, (VkClearDepthStencilValue*)(pDepthStencil));
+                vkReadStream->loadArrayInPlace((void**)&pDepthStencil, sizeof(const VkClearDepthStencilValue), 4);
                 vkReadStream->read((uint32_t*)&rangeCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pRanges, ((rangeCount)) * sizeof(const VkImageSubresourceRange));
-                for (uint32_t i = 0; i < (uint32_t)((rangeCount)); ++i)
-                {
-                    unmarshal_VkImageSubresourceRange(vkReadStream, (VkImageSubresourceRange*)(pRanges + i));
-                }
+                vkReadStream->loadArrayInPlace((void**)&pRanges, ((rangeCount)) * sizeof(const VkImageSubresourceRange), 4);
                 if (pDepthStencil)
                 {
                     transform_tohost_VkClearDepthStencilValue(m_state, (VkClearDepthStencilValue*)(pDepthStencil));
@@ -6401,11 +6360,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                     unmarshal_VkClearAttachment(vkReadStream, (VkClearAttachment*)(pAttachments + i));
                 }
                 vkReadStream->read((uint32_t*)&rectCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pRects, ((rectCount)) * sizeof(const VkClearRect));
-                for (uint32_t i = 0; i < (uint32_t)((rectCount)); ++i)
-                {
-                    unmarshal_VkClearRect(vkReadStream, (VkClearRect*)(pRects + i));
-                }
+                vkReadStream->loadArrayInPlace((void**)&pRects, ((rectCount)) * sizeof(const VkClearRect), 4);
                 if (pAttachments)
                 {
                     for (uint32_t i = 0; i < (uint32_t)((attachmentCount)); ++i)
@@ -6463,11 +6418,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 vkReadStream->handleMapping()->mapHandles_u64_VkImage(&cgen_var_334, (VkImage*)&dstImage, 1);
                 vkReadStream->read((VkImageLayout*)&dstImageLayout, sizeof(VkImageLayout));
                 vkReadStream->read((uint32_t*)&regionCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pRegions, ((regionCount)) * sizeof(const VkImageResolve));
-                for (uint32_t i = 0; i < (uint32_t)((regionCount)); ++i)
-                {
-                    unmarshal_VkImageResolve(vkReadStream, (VkImageResolve*)(pRegions + i));
-                }
+                vkReadStream->loadArrayInPlace((void**)&pRegions, ((regionCount)) * sizeof(const VkImageResolve), 4);
                 if (pRegions)
                 {
                     for (uint32_t i = 0; i < (uint32_t)((regionCount)); ++i)
@@ -6937,8 +6888,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 vkReadStream->read((VkShaderStageFlags*)&stageFlags, sizeof(VkShaderStageFlags));
                 vkReadStream->read((uint32_t*)&offset, sizeof(uint32_t));
                 vkReadStream->read((uint32_t*)&size, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pValues, ((size)) * sizeof(const uint8_t));
-                vkReadStream->read((void*)pValues, ((size)) * sizeof(const uint8_t));
+                vkReadStream->loadArrayInPlace((void**)&pValues, ((size)) * sizeof(const uint8_t), 1);
                 if (m_logCalls)
                 {
                     fprintf(stderr, "stream %p: call vkCmdPushConstants 0x%llx 0x%llx 0x%llx 0x%llx 0x%llx 0x%llx \n", ioStream, (unsigned long long)commandBuffer, (unsigned long long)layout, (unsigned long long)stageFlags, (unsigned long long)offset, (unsigned long long)size, (unsigned long long)pValues);
@@ -9166,7 +9116,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                     fprintf(stderr, "stream %p: call vkQueuePresentKHR 0x%llx 0x%llx \n", ioStream, (unsigned long long)queue, (unsigned long long)pPresentInfo);
                 }
                 VkResult vkQueuePresentKHR_VkResult_return = (VkResult)0;
-                vkQueuePresentKHR_VkResult_return = vk->vkQueuePresentKHR(unboxed_queue, pPresentInfo);
+                vkQueuePresentKHR_VkResult_return = m_state->on_vkQueuePresentKHR(&m_pool, queue, pPresentInfo);
                 vkStream->unsetHandleMapping();
                 vkStream->write(&vkQueuePresentKHR_VkResult_return, sizeof(VkResult));
                 vkStream->commitWrite();
@@ -14728,8 +14678,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 vkReadStream->read((uint64_t*)&cgen_var_712, 1 * 8);
                 vkReadStream->handleMapping()->mapHandles_u64_VkObjectTableNVX(&cgen_var_712, (VkObjectTableNVX*)&objectTable, 1);
                 vkReadStream->read((uint32_t*)&objectCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pObjectIndices, ((objectCount)) * sizeof(const uint32_t));
-                vkReadStream->read((uint32_t*)pObjectIndices, ((objectCount)) * sizeof(const uint32_t));
+                vkReadStream->loadArrayInPlace((void**)&pObjectIndices, ((objectCount)) * sizeof(const uint32_t), 4);
                 (void)ppObjectTableEntries;
                 if (m_logCalls)
                 {
@@ -14769,10 +14718,8 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 vkReadStream->read((uint64_t*)&cgen_var_714, 1 * 8);
                 vkReadStream->handleMapping()->mapHandles_u64_VkObjectTableNVX(&cgen_var_714, (VkObjectTableNVX*)&objectTable, 1);
                 vkReadStream->read((uint32_t*)&objectCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pObjectEntryTypes, ((objectCount)) * sizeof(const VkObjectEntryTypeNVX));
-                vkReadStream->read((VkObjectEntryTypeNVX*)pObjectEntryTypes, ((objectCount)) * sizeof(const VkObjectEntryTypeNVX));
-                vkReadStream->alloc((void**)&pObjectIndices, ((objectCount)) * sizeof(const uint32_t));
-                vkReadStream->read((uint32_t*)pObjectIndices, ((objectCount)) * sizeof(const uint32_t));
+                vkReadStream->loadArrayInPlace((void**)&pObjectEntryTypes, ((objectCount)) * sizeof(const VkObjectEntryTypeNVX), 4);
+                vkReadStream->loadArrayInPlace((void**)&pObjectIndices, ((objectCount)) * sizeof(const uint32_t), 4);
                 if (m_logCalls)
                 {
                     fprintf(stderr, "stream %p: call vkUnregisterObjectsNVX 0x%llx 0x%llx 0x%llx 0x%llx 0x%llx \n", ioStream, (unsigned long long)device, (unsigned long long)objectTable, (unsigned long long)objectCount, (unsigned long long)pObjectEntryTypes, (unsigned long long)pObjectIndices);
@@ -14870,11 +14817,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 // End manual dispatchable handle unboxing for commandBuffer;
                 vkReadStream->read((uint32_t*)&firstViewport, sizeof(uint32_t));
                 vkReadStream->read((uint32_t*)&viewportCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pViewportWScalings, ((viewportCount)) * sizeof(const VkViewportWScalingNV));
-                for (uint32_t i = 0; i < (uint32_t)((viewportCount)); ++i)
-                {
-                    unmarshal_VkViewportWScalingNV(vkReadStream, (VkViewportWScalingNV*)(pViewportWScalings + i));
-                }
+                vkReadStream->loadArrayInPlace((void**)&pViewportWScalings, ((viewportCount)) * sizeof(const VkViewportWScalingNV), 4);
                 if (pViewportWScalings)
                 {
                     for (uint32_t i = 0; i < (uint32_t)((viewportCount)); ++i)
@@ -15468,11 +15411,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 // End manual dispatchable handle unboxing for commandBuffer;
                 vkReadStream->read((uint32_t*)&firstDiscardRectangle, sizeof(uint32_t));
                 vkReadStream->read((uint32_t*)&discardRectangleCount, sizeof(uint32_t));
-                vkReadStream->alloc((void**)&pDiscardRectangles, ((discardRectangleCount)) * sizeof(const VkRect2D));
-                for (uint32_t i = 0; i < (uint32_t)((discardRectangleCount)); ++i)
-                {
-                    unmarshal_VkRect2D(vkReadStream, (VkRect2D*)(pDiscardRectangles + i));
-                }
+                vkReadStream->loadArrayInPlace((void**)&pDiscardRectangles, ((discardRectangleCount)) * sizeof(const VkRect2D), 4);
                 if (pDiscardRectangles)
                 {
                     for (uint32_t i = 0; i < (uint32_t)((discardRectangleCount)); ++i)
@@ -15783,7 +15722,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 {
                     fprintf(stderr, "stream %p: call vkQueueBeginDebugUtilsLabelEXT 0x%llx 0x%llx \n", ioStream, (unsigned long long)queue, (unsigned long long)pLabelInfo);
                 }
-                vk->vkQueueBeginDebugUtilsLabelEXT(unboxed_queue, pLabelInfo);
+                m_state->on_vkQueueBeginDebugUtilsLabelEXT(&m_pool, queue, pLabelInfo);
                 vkStream->unsetHandleMapping();
                 vkStream->commitWrite();
                 size_t snapshotTraceBytes = vkReadStream->endTrace();
@@ -15811,7 +15750,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 {
                     fprintf(stderr, "stream %p: call vkQueueEndDebugUtilsLabelEXT 0x%llx \n", ioStream, (unsigned long long)queue);
                 }
-                vk->vkQueueEndDebugUtilsLabelEXT(unboxed_queue);
+                m_state->on_vkQueueEndDebugUtilsLabelEXT(&m_pool, queue);
                 vkStream->unsetHandleMapping();
                 vkStream->commitWrite();
                 size_t snapshotTraceBytes = vkReadStream->endTrace();
@@ -15846,7 +15785,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 {
                     fprintf(stderr, "stream %p: call vkQueueInsertDebugUtilsLabelEXT 0x%llx 0x%llx \n", ioStream, (unsigned long long)queue, (unsigned long long)pLabelInfo);
                 }
-                vk->vkQueueInsertDebugUtilsLabelEXT(unboxed_queue, pLabelInfo);
+                m_state->on_vkQueueInsertDebugUtilsLabelEXT(&m_pool, queue, pLabelInfo);
                 vkStream->unsetHandleMapping();
                 vkStream->commitWrite();
                 size_t snapshotTraceBytes = vkReadStream->endTrace();
@@ -16947,22 +16886,19 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream)
                 pImageInfoEntryIndices = (const uint32_t*)(uintptr_t)vkReadStream->getBe64();
                 if (pImageInfoEntryIndices)
                 {
-                    vkReadStream->alloc((void**)&pImageInfoEntryIndices, ((imageInfoCount)) * sizeof(const uint32_t));
-                    vkReadStream->read((uint32_t*)pImageInfoEntryIndices, ((imageInfoCount)) * sizeof(const uint32_t));
+                    vkReadStream->loadArrayInPlace((void**)&pImageInfoEntryIndices, ((imageInfoCount)) * sizeof(const uint32_t), 4);
                 }
                 // WARNING PTR CHECK
                 pBufferInfoEntryIndices = (const uint32_t*)(uintptr_t)vkReadStream->getBe64();
                 if (pBufferInfoEntryIndices)
                 {
-                    vkReadStream->alloc((void**)&pBufferInfoEntryIndices, ((bufferInfoCount)) * sizeof(const uint32_t));
-                    vkReadStream->read((uint32_t*)pBufferInfoEntryIndices, ((bufferInfoCount)) * sizeof(const uint32_t));
+                    vkReadStream->loadArrayInPlace((void**)&pBufferInfoEntryIndices, ((bufferInfoCount)) * sizeof(const uint32_t), 4);
                 }
                 // WARNING PTR CHECK
                 pBufferViewEntryIndices = (const uint32_t*)(uintptr_t)vkReadStream->getBe64();
                 if (pBufferViewEntryIndices)
                 {
-                    vkReadStream->alloc((void**)&pBufferViewEntryIndices, ((bufferViewCount)) * sizeof(const uint32_t));
-                    vkReadStream->read((uint32_t*)pBufferViewEntryIndices, ((bufferViewCount)) * sizeof(const uint32_t));
+                    vkReadStream->loadArrayInPlace((void**)&pBufferViewEntryIndices, ((bufferViewCount)) * sizeof(const uint32_t), 4);
                 }
                 // WARNING PTR CHECK
                 pImageInfos = (const VkDescriptorImageInfo*)(uintptr_t)vkReadStream->getBe64();
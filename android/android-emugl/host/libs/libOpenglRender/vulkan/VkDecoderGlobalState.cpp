@@ -27,11 +27,14 @@
 #include "VkCommonOperations.h"
 #include "VkDecoderSnapshot.h"
 #include "VkFormatUtils.h"
+#include "VkMemorySnapshot.h"
+#include "VkQueueSubmitBatcher.h"
 #include "VulkanDispatch.h"
 #include "android/base/ArraySize.h"
 #include "android/base/Optional.h"
 #include "android/base/containers/EntityManager.h"
 #include "android/base/containers/Lookup.h"
+#include "android/base/files/BufferedStream.h"
 #include "android/base/files/PathUtils.h"
 #include "android/base/files/Stream.h"
 #include "android/base/memory/LazyInstance.h"
@@ -93,6 +96,8 @@ static constexpr uint32_t kMaxSafeVersion = VK_MAKE_VERSION(1, 1, 0);
 static constexpr uint32_t kMinVersion = VK_MAKE_VERSION(1, 0, 0);
 
 class VkDecoderGlobalState::Impl {
+    struct DeviceInfo;
+
 public:
     Impl() :
         m_vk(emugl::vkDispatch()),
@@ -103,6 +108,10 @@ public:
         mVkCleanupEnabled = System::get()->envGet("ANDROID_EMU_VK_NO_CLEANUP") != "1";
         mLogging = System::get()->envGet("ANDROID_EMU_VK_LOG_CALLS") == "1";
         mVerbosePrints = System::get()->envGet("ANDROID_EMUGL_VERBOSE") == "1";
+        mSubmitBatchWindowUs = strtoll(
+                System::get()->envGet("ANDROID_EMU_VK_SUBMIT_BATCH_US").c_str(),
+                nullptr, 10);
+        if (mSubmitBatchWindowUs < 0) mSubmitBatchWindowUs = 0;
         if (get_emugl_address_space_device_control_ops().control_get_hw_funcs &&
             get_emugl_address_space_device_control_ops().control_get_hw_funcs()) {
             mUseOldMemoryCleanupPath = 0 == get_emugl_address_space_device_control_ops().control_get_hw_funcs()->getPhysAddrStartLocked();
@@ -117,29 +126,28 @@ public:
     void clear() {
         mInstanceInfo.clear();
         mPhysdevInfo.clear();
-        mDeviceInfo.clear();
-        mImageInfo.clear();
-        mImageViewInfo.clear();
-        mSamplerInfo.clear();
-        mCmdBufferInfo.clear();
-        mCmdPoolInfo.clear();
-
-        mDeviceToPhysicalDevice.clear();
+        mDeviceInfo.clearLocked();
+        mDeviceOfQueue.clearLocked();
+
         mPhysicalDeviceToInstance.clear();
-        mQueueInfo.clear();
-        mBufferInfo.clear();
-        mMapInfo.clear();
         mSemaphoreInfo.clear();
 #ifdef _WIN32
         mSemaphoreId = 1;
         mExternalSemaphoresById.clear();
 #endif
-        mDescriptorUpdateTemplateInfo.clear();
+
+        {
+            AutoLock lock(mDeviceOfHandleLock);
+            mDeviceOfCmdBuffer.clear();
+            mDeviceOfMemory.clear();
+        }
 
         mCreatedHandlesForSnapshotLoad.clear();
         mCreatedHandlesForSnapshotLoadIndex = 0;
 
         mGlobalHandleStore.clear();
+
+        mMemorySnapshot.clear();
     }
 
     bool snapshotsEnabled() const {
@@ -151,18 +159,81 @@ public:
     }
 
     void save(android::base::Stream* stream) {
-        snapshot()->save(stream);
+        // The memory snapshot writes a word per chunk. Loads can't read
+        // ahead the same way, as more renderer state follows in |stream|.
+        android::base::BufferedStream bufferedStream(stream);
+        snapshot()->save(&bufferedStream);
+
+        AutoLock lock(mLock);
+        auto devices = mDeviceInfo.values();
+        for (const auto& deviceInfo : devices) {
+            for (const auto& it : deviceInfo->queueInfo) {
+                it.second.submitBatcher->flush();
+            }
+        }
+        DeviceLocks deviceLocks(devices);
+        mMemorySnapshot.save(&bufferedStream,
+                             getMemorySnapshotRegionsLocked(devices));
+        bufferedStream.flush();
+        printMemorySnapshotStats("save");
     }
 
-    void load(android::base::Stream* stream) {
+    bool load(android::base::Stream* stream) {
         // assume that we already destroyed all instances
         // from FrameBuffer's onLoad method.
 
         // destroy all current internal data structures
-        clear();
+        {
+            AutoLock lock(mLock);
+            clear();
+        }
 
         // this part will replay in the decoder
         snapshot()->load(stream);
+
+        // and this fills the memory it allocated again
+        AutoLock lock(mLock);
+        auto devices = mDeviceInfo.values();
+        DeviceLocks deviceLocks(devices);
+        if (!mMemorySnapshot.load(stream,
+                                  getMemorySnapshotRegionsLocked(devices))) {
+            return false;
+        }
+        printMemorySnapshotStats("load");
+        return true;
+    }
+
+    VkMemorySnapshot::Stats memorySnapshotStats() {
+        AutoLock lock(mLock);
+        return mMemorySnapshot.lastStats();
+    }
+
+    std::vector<VkMemorySnapshot::Region> getMemorySnapshotRegionsLocked(
+            const std::vector<std::shared_ptr<DeviceInfo>>& devices) {
+        std::vector<VkMemorySnapshot::Region> regions;
+        for (const auto& deviceInfo : devices) {
+            for (const auto& it : deviceInfo->memory) {
+                const auto& info = it.second;
+                if (!info.ptr || !info.boxed) continue;
+                regions.push_back({(uint64_t)(uintptr_t)info.boxed,
+                                   (uint8_t*)info.ptr, info.size});
+            }
+        }
+        return regions;
+    }
+
+    void printMemorySnapshotStats(const char* op) {
+        if (!mVerbosePrints) return;
+        const auto& stats = mMemorySnapshot.lastStats();
+        fprintf(stderr,
+                "%s: %s: memory %llu bytes (%llu unchanged, %llu referenced), "
+                "stored %llu, hash/lz4 %.03f ms, stream %.03f ms\n",
+                __func__, op,
+                (unsigned long long)stats.totalBytes,
+                (unsigned long long)stats.unchangedBytes,
+                (unsigned long long)stats.referencedBytes,
+                (unsigned long long)stats.storedBytes,
+                stats.processUs / 1000.0, stats.streamUs / 1000.0);
     }
 
     void lock() {
@@ -878,11 +949,16 @@ public:
         //
         // AutoLock lock(mLock);
 
-        mDeviceToPhysicalDevice[*pDevice] = physicalDevice;
-
         // Fill out information about the logical device here.
-        auto& deviceInfo = mDeviceInfo[*pDevice];
+        auto deviceInfoPtr = std::make_shared<DeviceInfo>();
+        auto& deviceInfo = *deviceInfoPtr;
         deviceInfo.physicalDevice = physicalDevice;
+
+        auto physdevInfo = android::base::find(mPhysdevInfo, physicalDevice);
+        if (physdevInfo) {
+            deviceInfo.memProps = physdevInfo->memoryProperties;
+            deviceInfo.apiVersion = physdevInfo->props.apiVersion;
+        }
         deviceInfo.emulateTextureEtc2 = emulateTextureEtc2;
         deviceInfo.emulateTextureAstc = emulateTextureAstc;
 
@@ -922,8 +998,6 @@ public:
             queueFamilyIndexCounts[queueFamilyIndex] = queueCount;
         }
 
-        auto it = mPhysdevInfo.find(physicalDevice);
-
         for (auto it : queueFamilyIndexCounts) {
             auto index = it.first;
             auto count = it.second;
@@ -943,14 +1017,31 @@ public:
                 }
 
                 queues.push_back(queueOut);
-                mQueueInfo[queueOut].device = *pDevice;
-                mQueueInfo[queueOut].queueFamilyIndex = index;
+                auto& queueInfo = deviceInfo.queueInfo[queueOut];
+                queueInfo.device = *pDevice;
+                queueInfo.queueFamilyIndex = index;
 
                 auto boxed = new_boxed_VkQueue(queueOut, dispatch_VkDevice(deviceInfo.boxed), false /* does not own dispatch */);
-                mQueueInfo[queueOut].boxed = boxed;
+                queueInfo.boxed = boxed;
+
+                auto dvk = dispatch_VkDevice(deviceInfo.boxed);
+                queueInfo.submitBatcher.reset(
+                    new VkQueueSubmitBatcher(
+                        [dvk, queueOut](uint32_t submitCount,
+                                        const VkSubmitInfo* pSubmits,
+                                        VkFence fence) {
+                            return dvk->vkQueueSubmit(
+                                queueOut, submitCount, pSubmits, fence);
+                        },
+                        mSubmitBatchWindowUs));
             }
         }
 
+        mDeviceInfo.setLocked(*pDevice, deviceInfoPtr);
+        for (const auto& it : deviceInfo.queueInfo) {
+            mDeviceOfQueue.setLocked(it.first, deviceInfoPtr);
+        }
+
         // Box the device.
         *pDevice = (VkDevice)deviceInfo.boxed;
 
@@ -970,11 +1061,9 @@ public:
 
         auto device = unbox_VkDevice(boxed_device);
 
-        AutoLock lock(mLock);
-
         *pQueue = VK_NULL_HANDLE;
 
-        auto deviceInfo = android::base::find(mDeviceInfo, device);
+        auto deviceInfo = mDeviceInfo.get(device);
         if (!deviceInfo) return;
 
         const auto& queues =
@@ -988,7 +1077,8 @@ public:
 
         VkQueue unboxedQueue = (*queueList)[queueIndex];
 
-        auto queueInfo = android::base::find(mQueueInfo, unboxedQueue);
+        auto queueInfo =
+            android::base::find(deviceInfo->queueInfo, unboxedQueue);
 
         if (!queueInfo) return;
 
@@ -996,23 +1086,35 @@ public:
     }
 
     void destroyDeviceLocked(VkDevice device, const VkAllocationCallbacks* pAllocator) {
-        auto it = mDeviceInfo.find(device);
-        if (it == mDeviceInfo.end()) return;
-
-        auto eraseIt = mQueueInfo.begin();
-        for(; eraseIt != mQueueInfo.end();) {
-            if (eraseIt->second.device == device) {
-                delete_boxed_VkQueue(eraseIt->second.boxed);
-                eraseIt = mQueueInfo.erase(eraseIt);
-            } else {
-                ++eraseIt;
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        mDeviceInfo.setLocked(device, nullptr);
+
+        for (auto& it : deviceInfo->queueInfo) {
+            mDeviceOfQueue.setLocked(it.first, nullptr);
+            printSubmitBatcherStats(it.first, it.second.submitBatcher.get());
+            // Calls that looked the device up before may still use the
+            // batcher, so it only goes with the DeviceInfo.
+            it.second.submitBatcher->flush();
+            delete_boxed_VkQueue(it.second.boxed);
+        }
+
+        {
+            AutoLock deviceLock(deviceInfo->lock);
+            AutoLock lock(mDeviceOfHandleLock);
+            for (const auto& it : deviceInfo->cmdBuffers) {
+                mDeviceOfCmdBuffer.erase(it.first);
+            }
+            for (const auto& it : deviceInfo->memory) {
+                mDeviceOfMemory.erase(it.first);
             }
         }
 
         // Run the underlying API call.
         m_vk->vkDestroyDevice(device, pAllocator);
 
-        delete_boxed_VkDevice(it->second.boxed);
+        delete_boxed_VkDevice(deviceInfo->boxed);
     }
 
     void on_vkDestroyDevice(
@@ -1025,9 +1127,6 @@ public:
         AutoLock lock(mLock);
 
         destroyDeviceLocked(device, pAllocator);
-
-        mDeviceInfo.erase(device);
-        mDeviceToPhysicalDevice.erase(device);
     }
 
     VkResult on_vkCreateBuffer(
@@ -1043,9 +1142,10 @@ public:
         VkResult result =
             vk->vkCreateBuffer(device, pCreateInfo, pAllocator, pBuffer);
 
-        if (result == VK_SUCCESS) {
-            AutoLock lock(mLock);
-            auto& bufInfo = mBufferInfo[*pBuffer];
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (result == VK_SUCCESS && deviceInfo) {
+            AutoLock lock(deviceInfo->lock);
+            auto& bufInfo = deviceInfo->buffers[*pBuffer];
             bufInfo.device = device;
             bufInfo.size = pCreateInfo->size;
             bufInfo.vk = vk;
@@ -1065,14 +1165,18 @@ public:
 
         vk->vkDestroyBuffer(device, buffer, pAllocator);
 
-        AutoLock lock(mLock);
-        mBufferInfo.erase(buffer);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
+        deviceInfo->buffers.erase(buffer);
     }
 
     void setBufferMemoryBindInfoLocked(
+            DeviceInfo* deviceInfo,
             VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize memoryOffset) {
-        auto it = mBufferInfo.find(buffer);
-        if (it == mBufferInfo.end()) {
+        auto it = deviceInfo->buffers.find(buffer);
+        if (it == deviceInfo->buffers.end()) {
             return;
         }
         it->second.memory = memory;
@@ -1092,9 +1196,11 @@ public:
         VkResult result =
             vk->vkBindBufferMemory(device, buffer, memory, memoryOffset);
 
-        if (result == VK_SUCCESS) {
-            AutoLock lock(mLock);
-            setBufferMemoryBindInfoLocked(buffer, memory, memoryOffset);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (result == VK_SUCCESS && deviceInfo) {
+            AutoLock lock(deviceInfo->lock);
+            setBufferMemoryBindInfoLocked(
+                    deviceInfo.get(), buffer, memory, memoryOffset);
         }
         return result;
     }
@@ -1111,10 +1217,12 @@ public:
         VkResult result =
             vk->vkBindBufferMemory2(device, bindInfoCount, pBindInfos);
 
-        if (result == VK_SUCCESS) {
-            AutoLock lock(mLock);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (result == VK_SUCCESS && deviceInfo) {
+            AutoLock lock(deviceInfo->lock);
             for (uint32_t i = 0; i < bindInfoCount; ++i) {
                 setBufferMemoryBindInfoLocked(
+                        deviceInfo.get(),
                         pBindInfos[i].buffer,
                         pBindInfos[i].memory,
                         pBindInfos[i].memoryOffset);
@@ -1136,10 +1244,12 @@ public:
         VkResult result =
             vk->vkBindBufferMemory2KHR(device, bindInfoCount, pBindInfos);
 
-        if (result == VK_SUCCESS) {
-            AutoLock lock(mLock);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (result == VK_SUCCESS && deviceInfo) {
+            AutoLock lock(deviceInfo->lock);
             for (uint32_t i = 0; i < bindInfoCount; ++i) {
                 setBufferMemoryBindInfoLocked(
+                        deviceInfo.get(),
                         pBindInfos[i].buffer,
                         pBindInfos[i].memory,
                         pBindInfos[i].memoryOffset);
@@ -1160,17 +1270,15 @@ public:
         auto device = unbox_VkDevice(boxed_device);
         auto vk = dispatch_VkDevice(boxed_device);
 
-        AutoLock lock(mLock);
-
-        auto deviceInfoIt = mDeviceInfo.find(device);
-        if (deviceInfoIt == mDeviceInfo.end()) {
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) {
             return VK_ERROR_OUT_OF_HOST_MEMORY;
         }
 
         CompressedImageInfo cmpInfo = {};
         VkImageCreateInfo& sizeCompInfo = cmpInfo.sizeCompImgCreateInfo;
         VkImageCreateInfo decompInfo;
-        if (deviceInfoIt->second.needEmulatedDecompression(
+        if (deviceInfo->needEmulatedDecompression(
                     pCreateInfo->format)) {
             cmpInfo = createCompressedImageInfo(pCreateInfo->format);
             cmpInfo.imageType = pCreateInfo->imageType;
@@ -1208,6 +1316,8 @@ public:
             pCreateInfo = &decompInfo;
         }
         cmpInfo.device = device;
+        const bool emulateDecompression =
+            deviceInfo->needEmulatedDecompression(cmpInfo);
 
         AndroidNativeBufferInfo anbInfo;
         const VkNativeBufferANDROID* nativeBufferANDROID =
@@ -1216,13 +1326,10 @@ public:
         VkResult createRes = VK_SUCCESS;
 
         if (nativeBufferANDROID) {
-
-            auto memProps = memPropsOfDeviceLocked(device);
-
             createRes =
                 prepareAndroidNativeBufferImage(
                         vk, device, pCreateInfo, nativeBufferANDROID, pAllocator,
-                        memProps, &anbInfo);
+                        &deviceInfo->memProps, &anbInfo);
             if (createRes == VK_SUCCESS) {
                 *pImage = anbInfo.image;
             }
@@ -1233,12 +1340,14 @@ public:
 
         if (createRes != VK_SUCCESS) return createRes;
 
-        if (deviceInfoIt->second.needEmulatedDecompression(cmpInfo)) {
+        if (emulateDecompression) {
             cmpInfo.decompImg = *pImage;
-            createSizeCompImages(vk, &cmpInfo);
+            createSizeCompImages(vk, deviceInfo->memProps, &cmpInfo);
         }
 
-        auto& imageInfo = mImageInfo[*pImage];
+        AutoLock lock(deviceInfo->lock);
+
+        auto& imageInfo = deviceInfo->images[*pImage];
         imageInfo.anbInfo = anbInfo;
         imageInfo.cmpInfo = cmpInfo;
 
@@ -1256,10 +1365,13 @@ public:
         auto device = unbox_VkDevice(boxed_device);
         auto vk = dispatch_VkDevice(boxed_device);
 
-        AutoLock lock(mLock);
-        auto it = mImageInfo.find(image);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
+        auto it = deviceInfo->images.find(image);
 
-        if (it == mImageInfo.end()) return;
+        if (it == deviceInfo->images.end()) return;
 
         auto info = it->second;
 
@@ -1292,7 +1404,7 @@ public:
             }
             vk->vkDestroyImage(device, image, pAllocator);
         }
-        mImageInfo.erase(image);
+        deviceInfo->images.erase(image);
     }
 
     VkResult on_vkBindImageMemory(android::base::Pool* pool,
@@ -1307,13 +1419,13 @@ public:
         if (VK_SUCCESS != result) {
             return result;
         }
-        AutoLock lock(mLock);
-        auto deviceInfoIt = mDeviceInfo.find(device);
-        if (deviceInfoIt == mDeviceInfo.end()) {
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) {
             return VK_ERROR_OUT_OF_HOST_MEMORY;
         }
-        auto mapInfoIt = mMapInfo.find(memory);
-        if (mapInfoIt == mMapInfo.end()) {
+        AutoLock lock(deviceInfo->lock);
+        auto mapInfoIt = deviceInfo->memory.find(memory);
+        if (mapInfoIt == deviceInfo->memory.end()) {
             return VK_ERROR_OUT_OF_HOST_MEMORY;
         }
         if (mapInfoIt->second.ioSurface) {
@@ -1323,16 +1435,16 @@ public:
                 return VK_ERROR_OUT_OF_HOST_MEMORY;
             }
         }
-        if (!deviceInfoIt->second.emulateTextureEtc2 &&
-            !deviceInfoIt->second.emulateTextureAstc) {
+        if (!deviceInfo->emulateTextureEtc2 &&
+            !deviceInfo->emulateTextureAstc) {
             return VK_SUCCESS;
         }
-        auto imageInfoIt = mImageInfo.find(image);
-        if (imageInfoIt == mImageInfo.end()) {
+        auto imageInfoIt = deviceInfo->images.find(image);
+        if (imageInfoIt == deviceInfo->images.end()) {
             return VK_ERROR_OUT_OF_HOST_MEMORY;
         }
         CompressedImageInfo& cmp = imageInfoIt->second.cmpInfo;
-        if (!deviceInfoIt->second.needEmulatedDecompression(cmp)) {
+        if (!deviceInfo->needEmulatedDecompression(cmp)) {
             return VK_SUCCESS;
         }
         for (size_t i = 0; i < cmp.sizeCompImgs.size(); i++) {
@@ -1357,23 +1469,23 @@ public:
             return VK_ERROR_OUT_OF_HOST_MEMORY;
         }
 
-        AutoLock lock(mLock);
-        auto deviceInfoIt = mDeviceInfo.find(device);
-        if (deviceInfoIt == mDeviceInfo.end()) {
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) {
             return VK_ERROR_OUT_OF_HOST_MEMORY;
         }
-        auto imageInfoIt = mImageInfo.find(pCreateInfo->image);
-        if (imageInfoIt == mImageInfo.end()) {
+        AutoLock lock(deviceInfo->lock);
+        auto imageInfoIt = deviceInfo->images.find(pCreateInfo->image);
+        if (imageInfoIt == deviceInfo->images.end()) {
             return VK_ERROR_OUT_OF_HOST_MEMORY;
         }
         VkImageViewCreateInfo createInfo;
         bool needEmulatedAlpha = false;
-        if (deviceInfoIt->second.emulateTextureEtc2 ||
-            deviceInfoIt->second.emulateTextureAstc) {
+        if (deviceInfo->emulateTextureEtc2 ||
+            deviceInfo->emulateTextureAstc) {
             CompressedImageInfo cmpInfo = createCompressedImageInfo(
                     pCreateInfo->format
                     );
-            if (deviceInfoIt->second.needEmulatedDecompression(cmpInfo)) {
+            if (deviceInfo->needEmulatedDecompression(cmpInfo)) {
                 if (imageInfoIt->second.cmpInfo.decompImg) {
                     createInfo = *pCreateInfo;
                     createInfo.format = cmpInfo.decompFormat;
@@ -1381,7 +1493,7 @@ public:
                     createInfo.image = imageInfoIt->second.cmpInfo.decompImg;
                     pCreateInfo = &createInfo;
                 }
-            } else if (deviceInfoIt->second.needEmulatedDecompression(
+            } else if (deviceInfo->needEmulatedDecompression(
                                imageInfoIt->second.cmpInfo)) {
                 // Size compatible image view
                 createInfo = *pCreateInfo;
@@ -1406,7 +1518,7 @@ public:
             return result;
         }
 
-        auto& imageViewInfo = mImageViewInfo[*pView];
+        auto& imageViewInfo = deviceInfo->imageViews[*pView];
         imageViewInfo.needEmulatedAlpha = needEmulatedAlpha;
 
         *pView = new_boxed_non_dispatchable_VkImageView(*pView);
@@ -1424,8 +1536,12 @@ public:
         auto vk = dispatch_VkDevice(boxed_device);
 
         vk->vkDestroyImageView(device, imageView, pAllocator);
-        AutoLock lock(mLock);
-        mImageViewInfo.erase(imageView);
+
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
+        deviceInfo->imageViews.erase(imageView);
     }
 
     VkResult on_vkCreateSampler(
@@ -1442,8 +1558,12 @@ public:
         if (result != VK_SUCCESS) {
             return result;
         }
-        AutoLock lock(mLock);
-        auto& samplerInfo = mSamplerInfo[*pSampler];
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        }
+        AutoLock lock(deviceInfo->lock);
+        auto& samplerInfo = deviceInfo->samplers[*pSampler];
         samplerInfo.createInfo = *pCreateInfo;
         // We emulate RGB with RGBA for some compressed textures, which does not
         // handle translarent border correctly.
@@ -1473,15 +1593,19 @@ public:
         auto device = unbox_VkDevice(boxed_device);
         auto vk = dispatch_VkDevice(boxed_device);
         vk->vkDestroySampler(device, sampler, pAllocator);
-        AutoLock lock(mLock);
-        const auto& samplerInfoIt = mSamplerInfo.find(sampler);
-        if (samplerInfoIt != mSamplerInfo.end()) {
+
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
+        const auto& samplerInfoIt = deviceInfo->samplers.find(sampler);
+        if (samplerInfoIt != deviceInfo->samplers.end()) {
             if (samplerInfoIt->second.emulatedborderSampler != VK_NULL_HANDLE) {
                 vk->vkDestroySampler(
                         device, samplerInfoIt->second.emulatedborderSampler,
                         nullptr);
             }
-            mSamplerInfo.erase(samplerInfoIt);
+            deviceInfo->samplers.erase(samplerInfoIt);
         }
     }
 
@@ -1570,6 +1694,14 @@ public:
 
         auto device = unbox_VkDevice(boxed_device);
         auto vk = dispatch_VkDevice(boxed_device);
+
+        // Exporting a payload needs the signal of the semaphore submitted.
+        if (mSubmitBatchWindowUs) {
+            VkResult result = flushSubmits(
+                batchingQueuesOfDevice(mDeviceInfo.get(device).get()));
+            if (result != VK_SUCCESS) return result;
+        }
+
 #ifdef _WIN32
         VkSemaphoreGetWin32HandleInfoKHR getWin32 = {
             VK_STRUCTURE_TYPE_SEMAPHORE_GET_WIN32_HANDLE_INFO_KHR, 0,
@@ -1633,9 +1765,10 @@ public:
         auto res =
             vk->vkCreateDescriptorSetLayout(device, pCreateInfo, pAllocator, pSetLayout);
 
-        if (res == VK_SUCCESS) {
-            AutoLock lock(mLock);
-            auto& info = mDescriptorSetLayoutInfo[*pSetLayout];
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (res == VK_SUCCESS && deviceInfo) {
+            AutoLock lock(deviceInfo->lock);
+            auto& info = deviceInfo->descriptorSetLayouts[*pSetLayout];
             *pSetLayout = new_boxed_non_dispatchable_VkDescriptorSetLayout(*pSetLayout);
 
             info.createInfo = *pCreateInfo;
@@ -1658,8 +1791,11 @@ public:
 
         vk->vkDestroyDescriptorSetLayout(device, descriptorSetLayout, pAllocator);
 
-        AutoLock lock(mLock);
-        mDescriptorSetLayoutInfo.erase(descriptorSetLayout);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
+        deviceInfo->descriptorSetLayouts.erase(descriptorSetLayout);
     }
 
     VkResult on_vkCreateDescriptorPool(
@@ -1675,9 +1811,10 @@ public:
         auto res =
             vk->vkCreateDescriptorPool(device, pCreateInfo, pAllocator, pDescriptorPool);
 
-        if (res == VK_SUCCESS) {
-            AutoLock lock(mLock);
-            auto& info = mDescriptorPoolInfo[*pDescriptorPool];
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (res == VK_SUCCESS && deviceInfo) {
+            AutoLock lock(deviceInfo->lock);
+            auto& info = deviceInfo->descriptorPools[*pDescriptorPool];
             *pDescriptorPool = new_boxed_non_dispatchable_VkDescriptorPool(*pDescriptorPool);
             info.createInfo = *pCreateInfo;
             info.maxSets = pCreateInfo->maxSets;
@@ -1695,15 +1832,16 @@ public:
         return res;
     }
 
-    void cleanupDescriptorPoolAllocedSetsLocked(VkDescriptorPool descriptorPool) {
-        auto info = android::base::find(mDescriptorPoolInfo, descriptorPool);
+    void cleanupDescriptorPoolAllocedSetsLocked(
+            DeviceInfo* deviceInfo, VkDescriptorPool descriptorPool) {
+        auto info = android::base::find(deviceInfo->descriptorPools, descriptorPool);
 
         if (!info) return;
 
         for (auto it : info->allocedSetsToBoxed) {
             auto unboxedSet = it.first;
             auto boxedSet = it.second;
-            mDescriptorSetInfo.erase(unboxedSet);
+            deviceInfo->descriptorSets.erase(unboxedSet);
             delete_boxed_non_dispatchable_VkDescriptorSet(boxedSet);
         }
 
@@ -1726,9 +1864,12 @@ public:
 
         vk->vkDestroyDescriptorPool(device, descriptorPool, pAllocator);
 
-        AutoLock lock(mLock);
-        cleanupDescriptorPoolAllocedSetsLocked(descriptorPool);
-        mDescriptorPoolInfo.erase(descriptorPool);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
+        cleanupDescriptorPoolAllocedSetsLocked(deviceInfo.get(), descriptorPool);
+        deviceInfo->descriptorPools.erase(descriptorPool);
     }
 
     VkResult on_vkResetDescriptorPool(
@@ -1742,9 +1883,10 @@ public:
 
         auto res = vk->vkResetDescriptorPool(device, descriptorPool, flags);
 
-        if (res == VK_SUCCESS) {
-            AutoLock lock(mLock);
-            cleanupDescriptorPoolAllocedSetsLocked(descriptorPool);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (res == VK_SUCCESS && deviceInfo) {
+            AutoLock lock(deviceInfo->lock);
+            cleanupDescriptorPoolAllocedSetsLocked(deviceInfo.get(), descriptorPool);
         }
 
         return res;
@@ -1759,24 +1901,28 @@ public:
         auto device = unbox_VkDevice(boxed_device);
         auto vk = dispatch_VkDevice(boxed_device);
 
-        AutoLock lock(mLock);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return VK_ERROR_INITIALIZATION_FAILED;
+
+        AutoLock lock(deviceInfo->lock);
 
-        auto allocValidationRes = validateDescriptorSetAllocLocked(pAllocateInfo);
+        auto allocValidationRes =
+            validateDescriptorSetAllocLocked(deviceInfo.get(), pAllocateInfo);
         if (allocValidationRes != VK_SUCCESS) return allocValidationRes;
 
         auto res = vk->vkAllocateDescriptorSets(device, pAllocateInfo, pDescriptorSets);
 
         if (res == VK_SUCCESS) {
 
-            auto poolInfo = android::base::find(mDescriptorPoolInfo, pAllocateInfo->descriptorPool);
+            auto poolInfo = android::base::find(deviceInfo->descriptorPools, pAllocateInfo->descriptorPool);
 
             if (!poolInfo) return res;
 
             for (uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; ++i) {
                 auto setLayoutInfo =
-                    android::base::find(mDescriptorSetLayoutInfo, pAllocateInfo->pSetLayouts[i]);
+                    android::base::find(deviceInfo->descriptorSetLayouts, pAllocateInfo->pSetLayouts[i]);
 
-                auto& setInfo = mDescriptorSetInfo[pDescriptorSets[i]];
+                auto& setInfo = deviceInfo->descriptorSets[pDescriptorSets[i]];
 
                 setInfo.pool = pAllocateInfo->descriptorPool;
                 setInfo.bindings = setLayoutInfo->bindings;
@@ -1805,18 +1951,19 @@ public:
             device, descriptorPool,
             descriptorSetCount, pDescriptorSets);
 
-        if (res == VK_SUCCESS) {
-            AutoLock lock(mLock);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (res == VK_SUCCESS && deviceInfo) {
+            AutoLock lock(deviceInfo->lock);
 
             for (uint32_t i = 0; i < descriptorSetCount; ++i) {
                 auto setInfo = android::base::find(
-                    mDescriptorSetInfo, pDescriptorSets[i]);
+                    deviceInfo->descriptorSets, pDescriptorSets[i]);
 
                 if (!setInfo) continue;
 
                 auto poolInfo =
                     android::base::find(
-                        mDescriptorPoolInfo, setInfo->pool);
+                        deviceInfo->descriptorPools, setInfo->pool);
 
                 if (!poolInfo) continue;
 
@@ -1830,7 +1977,7 @@ public:
 
                 poolInfo->allocedSetsToBoxed.erase(pDescriptorSets[i]);
 
-                mDescriptorSetInfo.erase(pDescriptorSets[i]);
+                deviceInfo->descriptorSets.erase(pDescriptorSets[i]);
             }
         }
 
@@ -1848,7 +1995,10 @@ public:
         auto device = unbox_VkDevice(boxed_device);
         auto vk = dispatch_VkDevice(boxed_device);
 
-        AutoLock lock(mLock);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
         bool needEmulateWriteDescriptor = false;
         // c++ seems to allow for 0-size array allocation
         std::unique_ptr<bool[]> descriptorWritesNeedDeepCopy(
@@ -1863,12 +2013,12 @@ public:
             for (uint32_t j = 0; j < descriptorWrite.descriptorCount; j++) {
                 const VkDescriptorImageInfo& imageInfo =
                     descriptorWrite.pImageInfo[j];
-                const auto& viewIt = mImageViewInfo.find(imageInfo.imageView);
-                if (viewIt == mImageViewInfo.end()) {
+                const auto& viewIt = deviceInfo->imageViews.find(imageInfo.imageView);
+                if (viewIt == deviceInfo->imageViews.end()) {
                     continue;
                 }
-                const auto& samplerIt = mSamplerInfo.find(imageInfo.sampler);
-                if (samplerIt == mSamplerInfo.end()) {
+                const auto& samplerIt = deviceInfo->samplers.find(imageInfo.sampler);
+                if (samplerIt == deviceInfo->samplers.end()) {
                     continue;
                 }
                 if (viewIt->second.needEmulatedAlpha &&
@@ -1910,12 +2060,12 @@ public:
             dstDescriptorWrite.pImageInfo = imageInfos;
             for (uint32_t j = 0; j < dstDescriptorWrite.descriptorCount; j++) {
                 VkDescriptorImageInfo& imageInfo = imageInfos[j];
-                const auto& viewIt = mImageViewInfo.find(imageInfo.imageView);
-                if (viewIt == mImageViewInfo.end()) {
+                const auto& viewIt = deviceInfo->imageViews.find(imageInfo.imageView);
+                if (viewIt == deviceInfo->imageViews.end()) {
                     continue;
                 }
-                const auto& samplerIt = mSamplerInfo.find(imageInfo.sampler);
-                if (samplerIt == mSamplerInfo.end()) {
+                const auto& samplerIt = deviceInfo->samplers.find(imageInfo.sampler);
+                if (samplerIt == deviceInfo->samplers.end()) {
                     continue;
                 }
                 if (viewIt->second.needEmulatedAlpha &&
@@ -1959,23 +2109,22 @@ public:
         auto commandBuffer = unbox_VkCommandBuffer(boxed_commandBuffer);
         auto vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
 
-        AutoLock lock(mLock);
-        auto srcIt = mImageInfo.find(srcImage);
-        if (srcIt == mImageInfo.end()) {
+        auto deviceInfo = deviceOfCommandBuffer(commandBuffer);
+        if (!deviceInfo) {
             return;
         }
-        auto dstIt = mImageInfo.find(dstImage);
-        if (dstIt == mImageInfo.end()) {
+        AutoLock lock(deviceInfo->lock);
+        auto srcIt = deviceInfo->images.find(srcImage);
+        if (srcIt == deviceInfo->images.end()) {
             return;
         }
-        VkDevice device = srcIt->second.cmpInfo.device;
-        auto deviceInfoIt = mDeviceInfo.find(device);
-        if (deviceInfoIt == mDeviceInfo.end()) {
+        auto dstIt = deviceInfo->images.find(dstImage);
+        if (dstIt == deviceInfo->images.end()) {
             return;
         }
-        bool needEmulatedSrc = deviceInfoIt->second.needEmulatedDecompression(
+        bool needEmulatedSrc = deviceInfo->needEmulatedDecompression(
                 srcIt->second.cmpInfo);
-        bool needEmulatedDst = deviceInfoIt->second.needEmulatedDecompression(
+        bool needEmulatedDst = deviceInfo->needEmulatedDecompression(
                 dstIt->second.cmpInfo);
         if (!needEmulatedSrc && !needEmulatedDst) {
             vk->vkCmdCopyImage(commandBuffer, srcImage, srcImageLayout,
@@ -2036,21 +2185,20 @@ public:
         auto commandBuffer = unbox_VkCommandBuffer(boxed_commandBuffer);
         auto vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
 
-        AutoLock lock(mLock);
-        auto it = mImageInfo.find(srcImage);
-        if (it == mImageInfo.end()) {
+        auto deviceInfo = deviceOfCommandBuffer(commandBuffer);
+        if (!deviceInfo) {
             return;
         }
-        auto bufferInfoIt = mBufferInfo.find(dstBuffer);
-        if (bufferInfoIt == mBufferInfo.end()) {
+        AutoLock lock(deviceInfo->lock);
+        auto it = deviceInfo->images.find(srcImage);
+        if (it == deviceInfo->images.end()) {
             return;
         }
-        VkDevice device = bufferInfoIt->second.device;
-        auto deviceInfoIt = mDeviceInfo.find(device);
-        if (deviceInfoIt == mDeviceInfo.end()) {
+        auto bufferInfoIt = deviceInfo->buffers.find(dstBuffer);
+        if (bufferInfoIt == deviceInfo->buffers.end()) {
             return;
         }
-        if (!deviceInfoIt->second.needEmulatedDecompression(
+        if (!deviceInfo->needEmulatedDecompression(
                     it->second.cmpInfo)) {
             vk->vkCmdCopyImageToBuffer(commandBuffer, srcImage, srcImageLayout,
                     dstBuffer, regionCount, pRegions);
@@ -2092,8 +2240,12 @@ public:
         auto device = unbox_VkDevice(boxed_device);
         auto vk = dispatch_VkDevice(boxed_device);
         vk->vkGetImageMemoryRequirements(device, image, pMemoryRequirements);
-        AutoLock lock(mLock);
-        updateImageMemorySizeLocked(device, image, pMemoryRequirements);
+
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
+        updateImageMemorySizeLocked(deviceInfo.get(), image, pMemoryRequirements);
     }
 
     void on_vkGetImageMemoryRequirements2(
@@ -2103,12 +2255,10 @@ public:
             VkMemoryRequirements2* pMemoryRequirements) {
         auto device = unbox_VkDevice(boxed_device);
         auto vk = dispatch_VkDevice(boxed_device);
-        AutoLock lock(mLock);
 
-        auto physicalDevice = mDeviceToPhysicalDevice[device];
-        auto physdevInfo = android::base::find(mPhysdevInfo, physicalDevice);
+        auto deviceInfo = mDeviceInfo.get(device);
 
-        if (!physdevInfo) {
+        if (!deviceInfo) {
             // If this fails, we crash, as we assume that the memory properties
             // map should have the info.
             emugl::emugl_crash_reporter(
@@ -2116,7 +2266,7 @@ public:
                     "VkPhysicalDevice");
         }
 
-        if ((physdevInfo->props.apiVersion >= VK_MAKE_VERSION(1, 1, 0)) &&
+        if ((deviceInfo->apiVersion >= VK_MAKE_VERSION(1, 1, 0)) &&
             vk->vkGetImageMemoryRequirements2) {
             vk->vkGetImageMemoryRequirements2(device, pInfo,
                     pMemoryRequirements);
@@ -2137,7 +2287,8 @@ public:
                     device, pInfo->image,
                     &pMemoryRequirements->memoryRequirements);
         }
-        updateImageMemorySizeLocked(device, pInfo->image,
+        AutoLock lock(deviceInfo->lock);
+        updateImageMemorySizeLocked(deviceInfo.get(), pInfo->image,
                 &pMemoryRequirements->memoryRequirements);
     }
 
@@ -2153,26 +2304,25 @@ public:
         auto commandBuffer = unbox_VkCommandBuffer(boxed_commandBuffer);
         auto vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
 
-        AutoLock lock(mLock);
-        auto it = mImageInfo.find(dstImage);
-        if (it == mImageInfo.end()) return;
-        auto bufferInfoIt = mBufferInfo.find(srcBuffer);
-        if (bufferInfoIt == mBufferInfo.end()) {
+        auto deviceInfo = deviceOfCommandBuffer(commandBuffer);
+        if (!deviceInfo) {
             return;
         }
-        VkDevice device = bufferInfoIt->second.device;
-        auto deviceInfoIt = mDeviceInfo.find(device);
-        if (deviceInfoIt == mDeviceInfo.end()) {
+        AutoLock lock(deviceInfo->lock);
+        auto it = deviceInfo->images.find(dstImage);
+        if (it == deviceInfo->images.end()) return;
+        auto bufferInfoIt = deviceInfo->buffers.find(srcBuffer);
+        if (bufferInfoIt == deviceInfo->buffers.end()) {
             return;
         }
-        if (!deviceInfoIt->second.needEmulatedDecompression(
+        if (!deviceInfo->needEmulatedDecompression(
                     it->second.cmpInfo)) {
             vk->vkCmdCopyBufferToImage(commandBuffer, srcBuffer, dstImage,
                     dstImageLayout, regionCount, pRegions);
             return;
         }
-        auto cmdBufferInfoIt = mCmdBufferInfo.find(commandBuffer);
-        if (cmdBufferInfoIt == mCmdBufferInfo.end()) {
+        auto cmdBufferInfoIt = deviceInfo->cmdBuffers.find(commandBuffer);
+        if (cmdBufferInfoIt == deviceInfo->cmdBuffers.end()) {
             return;
         }
         CompressedImageInfo& cmp = it->second.cmpInfo;
@@ -2253,17 +2403,17 @@ public:
                     imageMemoryBarrierCount, pImageMemoryBarriers);
             return;
         }
-        AutoLock lock(mLock);
-        auto cmdBufferInfoIt = mCmdBufferInfo.find(commandBuffer);
-        if (cmdBufferInfoIt == mCmdBufferInfo.end()) {
+        auto deviceInfo = deviceOfCommandBuffer(commandBuffer);
+        if (!deviceInfo) {
             return;
         }
-        auto deviceInfoIt = mDeviceInfo.find(cmdBufferInfoIt->second.device);
-        if (deviceInfoIt == mDeviceInfo.end()) {
+        AutoLock lock(deviceInfo->lock);
+        auto cmdBufferInfoIt = deviceInfo->cmdBuffers.find(commandBuffer);
+        if (cmdBufferInfoIt == deviceInfo->cmdBuffers.end()) {
             return;
         }
-        if (!deviceInfoIt->second.emulateTextureEtc2 &&
-            !deviceInfoIt->second.emulateTextureAstc) {
+        if (!deviceInfo->emulateTextureEtc2 &&
+            !deviceInfo->emulateTextureAstc) {
             vk->vkCmdPipelineBarrier(
                     commandBuffer, srcStageMask, dstStageMask, dependencyFlags,
                     memoryBarrierCount, pMemoryBarriers,
@@ -2277,9 +2427,9 @@ public:
         for (uint32_t i = 0; i < imageMemoryBarrierCount; i++) {
             const VkImageMemoryBarrier& srcBarrier = pImageMemoryBarriers[i];
             auto image = srcBarrier.image;
-            auto it = mImageInfo.find(image);
-            if (it == mImageInfo.end() ||
-                !deviceInfoIt->second.needEmulatedDecompression(
+            auto it = deviceInfo->images.find(image);
+            if (it == deviceInfo->images.end() ||
+                !deviceInfo->needEmulatedDecompression(
                         it->second.cmpInfo)) {
                 persistentImageBarriers.push_back(srcBarrier);
                 continue;
@@ -2412,6 +2562,7 @@ public:
 
     bool mapHostVisibleMemoryToGuestPhysicalAddressLocked(
             VulkanDispatch* vk,
+            DeviceInfo* deviceInfo,
             VkDevice device,
             VkDeviceMemory memory,
             uint64_t physAddr) {
@@ -2425,7 +2576,7 @@ public:
                     "while GLDirectMem is not enabled!");
         }
 
-        auto info = android::base::find(mMapInfo, memory);
+        auto info = android::base::find(deviceInfo->memory, memory);
 
         if (!info) return false;
 
@@ -2596,45 +2747,31 @@ public:
         };
 #endif
 
-        AutoLock lock(mLock);
-
-        auto physdev = android::base::find(mDeviceToPhysicalDevice, device);
+        auto deviceInfo = mDeviceInfo.get(device);
 
-        if (!physdev) {
+        if (!deviceInfo) {
             // User app gave an invalid VkDevice,
             // but we don't really want to crash here.
             // We should allow invalid apps.
             return VK_ERROR_DEVICE_LOST;
         }
 
-        auto physdevInfo = android::base::find(mPhysdevInfo, *physdev);
-
-        if (!physdevInfo) {
-            // If this fails, we crash, as we assume that the memory properties
-            // map should have the info.
-            emugl::emugl_crash_reporter(
-                    "FATAL: Could not get memory properties for "
-                    "VkPhysicalDevice");
-        }
+        const VkPhysicalDeviceMemoryProperties* memProps = &deviceInfo->memProps;
 
         // If the memory was allocated with a type index that corresponds
         // to a memory type that is host visible, let's also map the entire
         // thing.
 
         // First, check validity of the user's type index.
-        if (localAllocInfo.memoryTypeIndex >=
-            physdevInfo->memoryProperties.memoryTypeCount) {
+        if (localAllocInfo.memoryTypeIndex >= memProps->memoryTypeCount) {
             // Continue allowing invalid behavior.
             return VK_ERROR_INCOMPATIBLE_DRIVER;
         }
 
         VkMemoryPropertyFlags memoryPropertyFlags =
-                physdevInfo->memoryProperties
-                        .memoryTypes[localAllocInfo.memoryTypeIndex]
+                memProps->memoryTypes[localAllocInfo.memoryTypeIndex]
                         .propertyFlags;
 
-        lock.unlock();
-
         if (importCbInfoPtr) {
             // Ensure color buffer has Vulkan backing.
             setupVkColorBuffer(importCbInfoPtr->colorBuffer,
@@ -2709,10 +2846,7 @@ public:
             return result;
         }
 
-        lock.lock();
-
-        mMapInfo[*pMemory] = MappedMemoryInfo();
-        auto& mapInfo = mMapInfo[*pMemory];
+        MappedMemoryInfo mapInfo;
         mapInfo.size = localAllocInfo.allocationSize;
         mapInfo.device = device;
         if (importCbInfoPtr && m_emu->instanceSupportsMoltenVK) {
@@ -2722,77 +2856,110 @@ public:
         bool hostVisible =
                 memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
 
-        if (!hostVisible) {
-            *pMemory = new_boxed_non_dispatchable_VkDeviceMemory(*pMemory);
-            return result;
-        }
+        VkDeviceMemory memory = *pMemory;
+        VkResult mapResult = VK_SUCCESS;
 
-        VkResult mapResult =
-            vk->vkMapMemory(device, *pMemory, 0,
+        if (hostVisible) {
+            mapResult = vk->vkMapMemory(device, memory, 0,
                     mapInfo.size, 0, &mapInfo.ptr);
+        }
+
+        AutoLock lock(deviceInfo->lock);
+
+        {
+            AutoLock indexLock(mDeviceOfHandleLock);
+            mDeviceOfMemory[memory] = deviceInfo;
+        }
 
         if (mapResult != VK_SUCCESS) {
+            deviceInfo->memory[memory] = mapInfo;
             return VK_ERROR_OUT_OF_HOST_MEMORY;
         }
 
-        *pMemory = new_boxed_non_dispatchable_VkDeviceMemory(*pMemory);
+        *pMemory = new_boxed_non_dispatchable_VkDeviceMemory(memory);
+        if (hostVisible) {
+            mapInfo.boxed = *pMemory;
+        }
+        deviceInfo->memory[memory] = mapInfo;
 
         return result;
     }
 
-    void freeMemoryLocked(
+    // Takes |memory| out of |deviceInfo| and returns what frees it, which
+    // doesn't need the device lock.
+    std::function<void()> takeMemoryLocked(
             VulkanDispatch* vk,
+            DeviceInfo* deviceInfo,
             VkDevice device,
             VkDeviceMemory memory,
             const VkAllocationCallbacks* pAllocator) {
 
-        auto info = android::base::find(mMapInfo, memory);
+        auto it = deviceInfo->memory.find(memory);
 
-        if (!info) {
+        if (it == deviceInfo->memory.end()) {
             // Invalid usage.
-            return;
+            return {};
         }
 
-#ifdef __APPLE__
-        if (info->ioSurface) {
-            CFRelease(info->ioSurface);
-            info->ioSurface = nullptr;
+        MappedMemoryInfo info = it->second;
+        deviceInfo->memory.erase(it);
+
+        {
+            AutoLock indexLock(mDeviceOfHandleLock);
+            mDeviceOfMemory.erase(memory);
         }
-#endif
 
-        if (info->directMapped) {
-
-            // if direct mapped, we leave it up to the guest address space driver
-            // to control the unmapping of kvm slot on the host side
-            // in order to avoid situations where
-            //
-            // 1. we try to unmap here and deadlock
-            //
-            // 2. unmapping at the wrong time (possibility of a parallel call
-            // to unmap vs. address space allocate and mapMemory leading to
-            // mapping the same gpa twice)
-            if (mUseOldMemoryCleanupPath) {
-                unmapMemoryAtGpaIfExists(info->guestPhysAddr);
+        return [this, vk, device, memory, info, pAllocator]() mutable {
+#ifdef __APPLE__
+            if (info.ioSurface) {
+                CFRelease(info.ioSurface);
+                info.ioSurface = nullptr;
             }
-        }
+#endif
 
-        if (info->virtioGpuMapped) {
-            if (mLogging) {
-                fprintf(stderr, "%s: unmap hostmem %p id 0x%llx\n", __func__,
-                        info->ptr,
-                        (unsigned long long)info->hostmemId);
+            if (info.directMapped) {
+
+                // if direct mapped, we leave it up to the guest address space driver
+                // to control the unmapping of kvm slot on the host side
+                // in order to avoid situations where
+                //
+                // 1. we try to unmap here and deadlock
+                //
+                // 2. unmapping at the wrong time (possibility of a parallel call
+                // to unmap vs. address space allocate and mapMemory leading to
+                // mapping the same gpa twice)
+                if (mUseOldMemoryCleanupPath) {
+                    unmapMemoryAtGpaIfExists(info.guestPhysAddr);
+                }
             }
 
-            get_emugl_vm_operations().hostmemUnregister(info->hostmemId);
-        }
+            if (info.virtioGpuMapped) {
+                if (mLogging) {
+                    fprintf(stderr, "%s: unmap hostmem %p id 0x%llx\n", __func__,
+                            info.ptr,
+                            (unsigned long long)info.hostmemId);
+                }
 
-        if (info->ptr) {
-            vk->vkUnmapMemory(device, memory);
-        }
+                get_emugl_vm_operations().hostmemUnregister(info.hostmemId);
+            }
+
+            if (info.ptr) {
+                vk->vkUnmapMemory(device, memory);
+            }
 
-        vk->vkFreeMemory(device, memory, pAllocator);
+            vk->vkFreeMemory(device, memory, pAllocator);
+        };
+    }
 
-        mMapInfo.erase(memory);
+    void freeMemoryLocked(
+            VulkanDispatch* vk,
+            DeviceInfo* deviceInfo,
+            VkDevice device,
+            VkDeviceMemory memory,
+            const VkAllocationCallbacks* pAllocator) {
+        auto freeMemory =
+            takeMemoryLocked(vk, deviceInfo, device, memory, pAllocator);
+        if (freeMemory) freeMemory();
     }
 
     void on_vkFreeMemory(
@@ -2804,9 +2971,17 @@ public:
         auto device = unbox_VkDevice(boxed_device);
         auto vk = dispatch_VkDevice(boxed_device);
 
-        AutoLock lock(mLock);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        std::function<void()> freeMemory;
+        {
+            AutoLock lock(deviceInfo->lock);
+            freeMemory = takeMemoryLocked(
+                    vk, deviceInfo.get(), device, memory, pAllocator);
+        }
 
-        freeMemoryLocked(vk, device, memory, pAllocator);
+        if (freeMemory) freeMemory();
     }
 
     VkResult on_vkMapMemory(
@@ -2818,16 +2993,23 @@ public:
             VkMemoryMapFlags flags,
             void** ppData) {
 
-        AutoLock lock(mLock);
-        return on_vkMapMemoryLocked(0, memory, offset, size, flags, ppData);
+        auto deviceInfo = deviceOfMemory(memory);
+        if (!deviceInfo) {
+            // Invalid usage.
+            return VK_ERROR_MEMORY_MAP_FAILED;
+        }
+
+        AutoLock lock(deviceInfo->lock);
+        return on_vkMapMemoryLocked(
+                deviceInfo.get(), memory, offset, size, flags, ppData);
     }
-    VkResult on_vkMapMemoryLocked(VkDevice,
+    VkResult on_vkMapMemoryLocked(DeviceInfo* deviceInfo,
             VkDeviceMemory memory,
             VkDeviceSize offset,
             VkDeviceSize size,
             VkMemoryMapFlags flags,
             void** ppData) {
-        auto info = android::base::find(mMapInfo, memory);
+        auto info = android::base::find(deviceInfo->memory, memory);
 
         if (!info) {
             // Invalid usage.
@@ -2851,9 +3033,12 @@ public:
     }
 
     uint8_t* getMappedHostPointer(VkDeviceMemory memory) {
-        AutoLock lock(mLock);
+        auto deviceInfo = deviceOfMemory(memory);
+        if (!deviceInfo) return nullptr;
+
+        AutoLock lock(deviceInfo->lock);
 
-        auto info = android::base::find(mMapInfo, memory);
+        auto info = android::base::find(deviceInfo->memory, memory);
 
         if (!info) {
             // Invalid usage.
@@ -2864,9 +3049,12 @@ public:
     }
 
     VkDeviceSize getDeviceMemorySize(VkDeviceMemory memory) {
-        AutoLock lock(mLock);
+        auto deviceInfo = deviceOfMemory(memory);
+        if (!deviceInfo) return 0;
+
+        AutoLock lock(deviceInfo->lock);
 
-        auto info = android::base::find(mMapInfo, memory);
+        auto info = android::base::find(deviceInfo->memory, memory);
 
         if (!info) {
             // Invalid usage.
@@ -2924,7 +3112,7 @@ public:
     }
 
     bool hasDeviceExtension(VkDevice device, const std::string& name) {
-        auto info = android::base::find(mDeviceInfo, device);
+        auto info = mDeviceInfo.get(device);
         if (!info) return false;
 
         for (const auto& enabledName : info->enabledExtensionNames) {
@@ -2970,28 +3158,44 @@ public:
         auto device = unbox_VkDevice(boxed_device);
         auto vk = dispatch_VkDevice(boxed_device);
 
-        AutoLock lock(mLock);
-
-        auto imageInfo = android::base::find(mImageInfo, image);
-        if (!imageInfo) {
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) {
             return VK_ERROR_INITIALIZATION_FAILED;
         }
 
+        AndroidNativeBufferInfo* anbInfo = nullptr;
+        {
+            AutoLock lock(deviceInfo->lock);
+            auto imageInfo = android::base::find(deviceInfo->images, image);
+            if (!imageInfo) {
+                return VK_ERROR_INITIALIZATION_FAILED;
+            }
+            anbInfo = &imageInfo->anbInfo;
+        }
+
         VkQueue defaultQueue;
         uint32_t defaultQueueFamilyIndex;
-        if (!getDefaultQueueForDeviceLocked(
-                    device, &defaultQueue, &defaultQueueFamilyIndex)) {
+        if (!getDefaultQueueForDevice(
+                    *deviceInfo, &defaultQueue, &defaultQueueFamilyIndex)) {
             fprintf(stderr, "%s: cant get the default q\n", __func__);
             return VK_ERROR_INITIALIZATION_FAILED;
         }
 
-        AndroidNativeBufferInfo* anbInfo = &imageInfo->anbInfo;
+        AutoLock anbLock(deviceInfo->nativeBufferLock);
 
-        return
-            setAndroidNativeImageSemaphoreSignaled(
-                    vk, device,
-                    defaultQueue, defaultQueueFamilyIndex,
-                    semaphore, fence, anbInfo);
+        // The signal goes on a queue the guest also submits on, so it goes
+        // through the batcher of that queue.
+        VkQueue queue =
+            getAndroidNativeImageSignalQueue(anbInfo, defaultQueue);
+        auto queueInfo = android::base::find(deviceInfo->queueInfo, queue);
+        if (!queueInfo) {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+
+        return queueInfo->submitBatcher->flushAndRun([&] {
+            return setAndroidNativeImageSemaphoreSignaled(
+                    vk, device, queue, semaphore, fence, anbInfo);
+        });
     }
 
     VkResult on_vkQueueSignalReleaseImageANDROID(
@@ -3005,24 +3209,43 @@ public:
         auto queue = unbox_VkQueue(boxed_queue);
         auto vk = dispatch_VkQueue(boxed_queue);
 
-        AutoLock lock(mLock);
-
-        auto queueFamilyIndex = queueFamilyIndexOfQueueLocked(queue);
+        auto deviceInfo = mDeviceOfQueue.get(queue);
+        if (!deviceInfo) {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
 
-        if (!queueFamilyIndex) {
+        auto queueInfo = android::base::find(deviceInfo->queueInfo, queue);
+        if (!queueInfo) {
             return VK_ERROR_INITIALIZATION_FAILED;
         }
 
-        auto imageInfo = android::base::find(mImageInfo, image);
-        AndroidNativeBufferInfo* anbInfo = &imageInfo->anbInfo;
+        AndroidNativeBufferInfo* anbInfo = nullptr;
+        {
+            AutoLock lock(deviceInfo->lock);
+            auto imageInfo = android::base::find(deviceInfo->images, image);
+            if (!imageInfo) {
+                return VK_ERROR_INITIALIZATION_FAILED;
+            }
+            anbInfo = &imageInfo->anbInfo;
+        }
+
+        // The semaphores waited on may be signaled by pending submits.
+        if (waitSemaphoreCount) {
+            VkResult result =
+                flushSubmits(batchingQueuesOfDevice(deviceInfo.get()));
+            if (result != VK_SUCCESS) return result;
+        }
+
+        AutoLock anbLock(deviceInfo->nativeBufferLock);
 
-        return
-            syncImageToColorBuffer(
+        return queueInfo->submitBatcher->flushAndRun([&] {
+            return syncImageToColorBuffer(
                     vk,
-                    *queueFamilyIndex,
+                    queueInfo->queueFamilyIndex,
                     queue,
                     waitSemaphoreCount, pWaitSemaphores,
                     pNativeFenceFd, anbInfo);
+        });
     }
 
     VkResult on_vkMapMemoryIntoAddressSpaceGOOGLE(
@@ -3039,9 +3262,12 @@ public:
                     "while GLDirectMem is not enabled!");
         }
 
-        AutoLock lock(mLock);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return VK_ERROR_INITIALIZATION_FAILED;
 
-        auto info = android::base::find(mMapInfo, memory);
+        AutoLock lock(deviceInfo->lock);
+
+        auto info = android::base::find(deviceInfo->memory, memory);
 
         if (mLogging) {
             fprintf(stderr, "%s: deviceMemory: 0x%llx pAddress: 0x%llx\n", __func__,
@@ -3050,7 +3276,7 @@ public:
         }
 
         if (!mapHostVisibleMemoryToGuestPhysicalAddressLocked(
-                    vk, device, memory, *pAddress)) {
+                    vk, deviceInfo.get(), device, memory, *pAddress)) {
             return VK_ERROR_OUT_OF_HOST_MEMORY;
         }
 
@@ -3069,9 +3295,12 @@ public:
         auto device = unbox_VkDevice(boxed_device);
         auto vk = dispatch_VkDevice(boxed_device);
 
-        AutoLock lock(mLock);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return VK_ERROR_OUT_OF_HOST_MEMORY;
 
-        auto info = android::base::find(mMapInfo, memory);
+        AutoLock lock(deviceInfo->lock);
+
+        auto info = android::base::find(deviceInfo->memory, memory);
 
         if (!info) return VK_ERROR_OUT_OF_HOST_MEMORY;
 
@@ -3145,14 +3374,19 @@ public:
             return result;
         }
 
-        AutoLock lock(mLock);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return VK_ERROR_INITIALIZATION_FAILED;
+
+        AutoLock lock(deviceInfo->lock);
+        AutoLock indexLock(mDeviceOfHandleLock);
         for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++) {
-            mCmdBufferInfo[pCommandBuffers[i]] = CommandBufferInfo();
-            mCmdBufferInfo[pCommandBuffers[i]].device = device;
-            mCmdBufferInfo[pCommandBuffers[i]].cmdPool =
-                pAllocateInfo->commandPool;
+            auto& cmdBufferInfo = deviceInfo->cmdBuffers[pCommandBuffers[i]];
+            cmdBufferInfo = CommandBufferInfo();
+            cmdBufferInfo.device = device;
+            cmdBufferInfo.cmdPool = pAllocateInfo->commandPool;
             auto boxed = new_boxed_VkCommandBuffer(pCommandBuffers[i], vk, false /* does not own dispatch */);
-            mCmdBufferInfo[pCommandBuffers[i]].boxed = boxed;
+            cmdBufferInfo.boxed = boxed;
+            mDeviceOfCmdBuffer[pCommandBuffers[i]] = deviceInfo;
             pCommandBuffers[i] = (VkCommandBuffer)boxed;
         }
         return result;
@@ -3173,8 +3407,11 @@ public:
         if (result != VK_SUCCESS) {
             return result;
         }
-        AutoLock lock(mLock);
-        mCmdPoolInfo[*pCommandPool] = CommandPoolInfo();
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (deviceInfo) {
+            AutoLock lock(deviceInfo->lock);
+            deviceInfo->cmdPools[*pCommandPool] = CommandPoolInfo();
+        }
 
         *pCommandPool = new_boxed_non_dispatchable_VkCommandPool(*pCommandPool);
 
@@ -3191,11 +3428,15 @@ public:
         auto vk = dispatch_VkDevice(boxed_device);
 
         vk->vkDestroyCommandPool(device, commandPool, pAllocator);
-        AutoLock lock(mLock);
-        const auto ite = mCmdPoolInfo.find(commandPool);
-        if (ite != mCmdPoolInfo.end()) {
-            removeCommandBufferInfo(ite->second.cmdBuffers);
-            mCmdPoolInfo.erase(ite);
+
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
+        const auto ite = deviceInfo->cmdPools.find(commandPool);
+        if (ite != deviceInfo->cmdPools.end()) {
+            removeCommandBufferInfoLocked(deviceInfo.get(), ite->second.cmdBuffers);
+            deviceInfo->cmdPools.erase(ite);
         }
     }
 
@@ -3213,10 +3454,13 @@ public:
         if (result != VK_SUCCESS) {
             return result;
         }
-        AutoLock lock(mLock);
-        const auto ite = mCmdPoolInfo.find(commandPool);
-        if (ite != mCmdPoolInfo.end()) {
-            removeCommandBufferInfo(ite->second.cmdBuffers);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return result;
+
+        AutoLock lock(deviceInfo->lock);
+        const auto ite = deviceInfo->cmdPools.find(commandPool);
+        if (ite != deviceInfo->cmdPools.end()) {
+            removeCommandBufferInfoLocked(deviceInfo.get(), ite->second.cmdBuffers);
         }
         return result;
     }
@@ -3232,8 +3476,11 @@ public:
 
         vk->vkCmdExecuteCommands(commandBuffer, commandBufferCount,
                 pCommandBuffers);
-        AutoLock lock(mLock);
-        CommandBufferInfo& cmdBuffer = mCmdBufferInfo[commandBuffer];
+        auto deviceInfo = deviceOfCommandBuffer(commandBuffer);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
+        CommandBufferInfo& cmdBuffer = deviceInfo->cmdBuffers[commandBuffer];
         cmdBuffer.subCmds.insert(cmdBuffer.subCmds.end(),
                 pCommandBuffers, pCommandBuffers + commandBufferCount);
     }
@@ -3248,15 +3495,38 @@ public:
         auto queue = unbox_VkQueue(boxed_queue);
         auto vk = dispatch_VkQueue(boxed_queue);
 
-        AutoLock lock(mLock);
+        auto deviceInfo = mDeviceOfQueue.get(queue);
+        if (!deviceInfo) {
+            return vk->vkQueueSubmit(queue, submitCount, pSubmits, fence);
+        }
 
+        {
+            AutoLock lock(deviceInfo->lock);
+            for (uint32_t i = 0; i < submitCount; i++) {
+                const VkSubmitInfo& submit = pSubmits[i];
+                for (uint32_t c = 0; c < submit.commandBufferCount; c++) {
+                    executePreprocessRecursiveLocked(
+                            deviceInfo.get(), 0, submit.pCommandBuffers[c]);
+                }
+            }
+        }
+
+        auto batcher = deviceInfo->queueInfo.at(queue).submitBatcher;
+
+        // The semaphores waited on here must have their signals submitted,
+        // which may still be pending on other queues.
+        std::vector<std::shared_ptr<VkQueueSubmitBatcher>> batchers;
         for (uint32_t i = 0; i < submitCount; i++) {
-            const VkSubmitInfo& submit = pSubmits[i];
-            for (uint32_t c = 0; c < submit.commandBufferCount; c++) {
-                executePreprocessRecursive(0, submit.pCommandBuffers[c]);
+            if (pSubmits[i].waitSemaphoreCount) {
+                batchers = batchingQueuesOfDevice(deviceInfo.get());
+                break;
             }
         }
-        return vk->vkQueueSubmit(queue, submitCount, pSubmits, fence);
+
+        VkResult result = flushSubmits(batchers);
+        if (result != VK_SUCCESS) return result;
+
+        return batcher->submit(submitCount, pSubmits, fence);
     }
 
     VkResult on_vkQueueWaitIdle(
@@ -3267,7 +3537,195 @@ public:
         auto vk = dispatch_VkQueue(boxed_queue);
         if (!queue) return VK_SUCCESS;
 
-        return vk->vkQueueWaitIdle(queue);
+        auto batcher = submitBatcherOfQueue(queue);
+        if (!batcher) return vk->vkQueueWaitIdle(queue);
+
+        return batcher->flushAndRun(
+            [vk, queue] { return vk->vkQueueWaitIdle(queue); });
+    }
+
+    VkResult on_vkQueueBindSparse(
+            android::base::Pool* pool,
+            VkQueue boxed_queue,
+            uint32_t bindInfoCount,
+            const VkBindSparseInfo* pBindInfo,
+            VkFence fence) {
+
+        auto queue = unbox_VkQueue(boxed_queue);
+        auto vk = dispatch_VkQueue(boxed_queue);
+
+        auto deviceInfo = mDeviceOfQueue.get(queue);
+        auto batcher = submitBatcherOfQueue(queue);
+
+        VkResult result = flushSubmits(batchingQueuesOfDevice(deviceInfo.get()));
+        if (result != VK_SUCCESS) return result;
+
+        if (!batcher) {
+            return vk->vkQueueBindSparse(queue, bindInfoCount, pBindInfo, fence);
+        }
+
+        return batcher->flushAndRun([vk, queue, bindInfoCount, pBindInfo, fence] {
+            return vk->vkQueueBindSparse(queue, bindInfoCount, pBindInfo, fence);
+        });
+    }
+
+    VkResult on_vkDeviceWaitIdle(
+            android::base::Pool* pool,
+            VkDevice boxed_device) {
+
+        auto device = unbox_VkDevice(boxed_device);
+        auto vk = dispatch_VkDevice(boxed_device);
+
+        VkResult result = flushSubmits(
+            batchingQueuesOfDevice(mDeviceInfo.get(device).get()));
+        if (result != VK_SUCCESS) return result;
+
+        return vk->vkDeviceWaitIdle(device);
+    }
+
+    VkResult on_vkQueuePresentKHR(
+            android::base::Pool* pool,
+            VkQueue boxed_queue,
+            const VkPresentInfoKHR* pPresentInfo) {
+
+        auto queue = unbox_VkQueue(boxed_queue);
+        auto vk = dispatch_VkQueue(boxed_queue);
+
+        auto batcher = submitBatcherOfQueue(queue);
+
+        // As for submits, the semaphores waited on may be signaled by
+        // submits pending on other queues.
+        std::vector<std::shared_ptr<VkQueueSubmitBatcher>> batchers;
+        if (pPresentInfo->waitSemaphoreCount) {
+            batchers = batchingQueuesOfDevice(mDeviceOfQueue.get(queue).get());
+        }
+
+        VkResult result = flushSubmits(batchers);
+        if (result != VK_SUCCESS) return result;
+
+        if (!batcher) return vk->vkQueuePresentKHR(queue, pPresentInfo);
+
+        return batcher->flushAndRun([vk, queue, pPresentInfo] {
+            return vk->vkQueuePresentKHR(queue, pPresentInfo);
+        });
+    }
+
+    void on_vkQueueBeginDebugUtilsLabelEXT(
+            android::base::Pool* pool,
+            VkQueue boxed_queue,
+            const VkDebugUtilsLabelEXT* pLabelInfo) {
+
+        auto queue = unbox_VkQueue(boxed_queue);
+        auto vk = dispatch_VkQueue(boxed_queue);
+
+        runAfterPendingSubmits(queue, [vk, queue, pLabelInfo] {
+            vk->vkQueueBeginDebugUtilsLabelEXT(queue, pLabelInfo);
+        });
+    }
+
+    void on_vkQueueEndDebugUtilsLabelEXT(
+            android::base::Pool* pool,
+            VkQueue boxed_queue) {
+
+        auto queue = unbox_VkQueue(boxed_queue);
+        auto vk = dispatch_VkQueue(boxed_queue);
+
+        runAfterPendingSubmits(queue, [vk, queue] {
+            vk->vkQueueEndDebugUtilsLabelEXT(queue);
+        });
+    }
+
+    void on_vkQueueInsertDebugUtilsLabelEXT(
+            android::base::Pool* pool,
+            VkQueue boxed_queue,
+            const VkDebugUtilsLabelEXT* pLabelInfo) {
+
+        auto queue = unbox_VkQueue(boxed_queue);
+        auto vk = dispatch_VkQueue(boxed_queue);
+
+        runAfterPendingSubmits(queue, [vk, queue, pLabelInfo] {
+            vk->vkQueueInsertDebugUtilsLabelEXT(queue, pLabelInfo);
+        });
+    }
+
+    // Runs |func| once the submits pending on |queue| are sent, so that it
+    // applies to the queue in guest order. Debug labels delimit the submits
+    // around them.
+    void runAfterPendingSubmits(VkQueue queue,
+                                const std::function<void()>& func) {
+        auto batcher = submitBatcherOfQueue(queue);
+        if (!batcher) {
+            func();
+            return;
+        }
+
+        batcher->flushAndRun([&func] {
+            func();
+            return VK_SUCCESS;
+        });
+    }
+
+    std::shared_ptr<DeviceInfo> deviceOfCommandBuffer(
+            VkCommandBuffer commandBuffer) {
+        AutoLock lock(mDeviceOfHandleLock);
+        auto it = mDeviceOfCmdBuffer.find(commandBuffer);
+        if (it == mDeviceOfCmdBuffer.end()) return nullptr;
+        return it->second;
+    }
+
+    std::shared_ptr<DeviceInfo> deviceOfMemory(VkDeviceMemory memory) {
+        AutoLock lock(mDeviceOfHandleLock);
+        auto it = mDeviceOfMemory.find(memory);
+        if (it == mDeviceOfMemory.end()) return nullptr;
+        return it->second;
+    }
+
+    // Doesn't need mLock.
+    std::shared_ptr<VkQueueSubmitBatcher> submitBatcherOfQueue(VkQueue queue) {
+        auto deviceInfo = mDeviceOfQueue.get(queue);
+        if (!deviceInfo) return nullptr;
+
+        auto queueInfo = android::base::find(deviceInfo->queueInfo, queue);
+        if (!queueInfo) return nullptr;
+
+        return queueInfo->submitBatcher;
+    }
+
+    // The submit batchers of the queues of |deviceInfo|, if submits are
+    // batched. The queues of a device don't change, so this needs no lock.
+    std::vector<std::shared_ptr<VkQueueSubmitBatcher>>
+    batchingQueuesOfDevice(const DeviceInfo* deviceInfo) {
+        std::vector<std::shared_ptr<VkQueueSubmitBatcher>> batchers;
+        if (!mSubmitBatchWindowUs || !deviceInfo) return batchers;
+        for (const auto& it : deviceInfo->queueInfo) {
+            batchers.push_back(it.second.submitBatcher);
+        }
+        return batchers;
+    }
+
+    // Sends the submits pending on |batchers|; call without locks.
+    static VkResult flushSubmits(
+            const std::vector<std::shared_ptr<VkQueueSubmitBatcher>>& batchers) {
+        VkResult result = VK_SUCCESS;
+        for (const auto& batcher : batchers) {
+            VkResult flushResult = batcher->flush();
+            if (result == VK_SUCCESS) result = flushResult;
+        }
+        return result;
+    }
+
+    void printSubmitBatcherStats(VkQueue queue,
+                                 const VkQueueSubmitBatcher* batcher) {
+        if (!mVerbosePrints || !batcher) return;
+        const auto stats = batcher->getStats();
+        fprintf(stderr,
+                "%s: queue %p: %llu submits with %llu batches sent in %llu "
+                "host submits, at most %u batches per submit\n",
+                __func__, queue,
+                (unsigned long long)stats.submits,
+                (unsigned long long)stats.batches,
+                (unsigned long long)stats.hostSubmits,
+                stats.maxBatchesPerHostSubmit);
     }
 
     VkResult on_vkResetCommandBuffer(
@@ -3279,14 +3737,16 @@ public:
         auto vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
 
         VkResult result = vk->vkResetCommandBuffer(commandBuffer, flags);
-        if (VK_SUCCESS == result) {
-            AutoLock lock(mLock);
-            mCmdBufferInfo[commandBuffer].preprocessFuncs.clear();
-            mCmdBufferInfo[commandBuffer].subCmds.clear();
-            mCmdBufferInfo[commandBuffer].computePipeline = 0;
-            mCmdBufferInfo[commandBuffer].firstSet = 0;
-            mCmdBufferInfo[commandBuffer].descriptorLayout = 0;
-            mCmdBufferInfo[commandBuffer].descriptorSets.clear();
+        auto deviceInfo = deviceOfCommandBuffer(commandBuffer);
+        if (VK_SUCCESS == result && deviceInfo) {
+            AutoLock lock(deviceInfo->lock);
+            auto& cmdBufferInfo = deviceInfo->cmdBuffers[commandBuffer];
+            cmdBufferInfo.preprocessFuncs.clear();
+            cmdBufferInfo.subCmds.clear();
+            cmdBufferInfo.computePipeline = 0;
+            cmdBufferInfo.firstSet = 0;
+            cmdBufferInfo.descriptorLayout = 0;
+            cmdBufferInfo.descriptorSets.clear();
         }
         return result;
     }
@@ -3304,19 +3764,25 @@ public:
         if (!device) return;
         vk->vkFreeCommandBuffers(device, commandPool, commandBufferCount,
                 pCommandBuffers);
-        AutoLock lock(mLock);
+
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
+        AutoLock indexLock(mDeviceOfHandleLock);
         for (uint32_t i = 0; i < commandBufferCount; i++) {
             const auto& cmdBufferInfoIt =
-                mCmdBufferInfo.find(pCommandBuffers[i]);
-            if (cmdBufferInfoIt != mCmdBufferInfo.end()) {
+                deviceInfo->cmdBuffers.find(pCommandBuffers[i]);
+            if (cmdBufferInfoIt != deviceInfo->cmdBuffers.end()) {
                 const auto& cmdPoolInfoIt =
-                    mCmdPoolInfo.find(cmdBufferInfoIt->second.cmdPool);
-                if (cmdPoolInfoIt != mCmdPoolInfo.end()) {
+                    deviceInfo->cmdPools.find(cmdBufferInfoIt->second.cmdPool);
+                if (cmdPoolInfoIt != deviceInfo->cmdPools.end()) {
                     cmdPoolInfoIt->second.cmdBuffers.erase(pCommandBuffers[i]);
                 }
                 // Done in decoder
                 // delete_boxed_VkCommandBuffer(cmdBufferInfoIt->second.boxed);
-                mCmdBufferInfo.erase(cmdBufferInfoIt);
+                deviceInfo->cmdBuffers.erase(cmdBufferInfoIt);
+                mDeviceOfCmdBuffer.erase(pCommandBuffers[i]);
             }
         }
     }
@@ -3381,7 +3847,7 @@ public:
 
         if (res == VK_SUCCESS) {
             registerDescriptorUpdateTemplate(
-                    *pDescriptorUpdateTemplate,
+                    device, *pDescriptorUpdateTemplate,
                     descriptorUpdateTemplateInfo);
             *pDescriptorUpdateTemplate = new_boxed_non_dispatchable_VkDescriptorUpdateTemplate(*pDescriptorUpdateTemplate);
         }
@@ -3408,7 +3874,7 @@ public:
 
         if (res == VK_SUCCESS) {
             registerDescriptorUpdateTemplate(
-                    *pDescriptorUpdateTemplate,
+                    device, *pDescriptorUpdateTemplate,
                     descriptorUpdateTemplateInfo);
             *pDescriptorUpdateTemplate = new_boxed_non_dispatchable_VkDescriptorUpdateTemplate(*pDescriptorUpdateTemplate);
         }
@@ -3427,7 +3893,7 @@ public:
         vk->vkDestroyDescriptorUpdateTemplate(
                 device, descriptorUpdateTemplate, pAllocator);
 
-        unregisterDescriptorUpdateTemplate(descriptorUpdateTemplate);
+        unregisterDescriptorUpdateTemplate(device, descriptorUpdateTemplate);
     }
 
     void on_vkDestroyDescriptorUpdateTemplateKHR(
@@ -3441,7 +3907,7 @@ public:
         vk->vkDestroyDescriptorUpdateTemplateKHR(
                 device, descriptorUpdateTemplate, pAllocator);
 
-        unregisterDescriptorUpdateTemplate(descriptorUpdateTemplate);
+        unregisterDescriptorUpdateTemplate(device, descriptorUpdateTemplate);
     }
 
     void on_vkUpdateDescriptorSetWithTemplateSizedGOOGLE(
@@ -3462,9 +3928,12 @@ public:
         auto device = unbox_VkDevice(boxed_device);
         auto vk = dispatch_VkDevice(boxed_device);
 
-        AutoLock lock(mLock);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
         auto info = android::base::find(
-                mDescriptorUpdateTemplateInfo,
+                deviceInfo->descriptorUpdateTemplates,
                 descriptorUpdateTemplate);
 
         if (!info) return;
@@ -3498,16 +3967,19 @@ public:
 
         auto commandBuffer = unbox_VkCommandBuffer(boxed_commandBuffer);
 
-        AutoLock lock(mLock);
-        auto& info = mCmdBufferInfo[commandBuffer];
+        auto deviceInfo = deviceOfCommandBuffer(commandBuffer);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
+        auto& info = deviceInfo->cmdBuffers[commandBuffer];
 
         bool doWait = false;
 
         if (needHostSync) {
             while ((sequenceNumber - info.sequenceNumber) != 1) {
                 auto waitUntilUs = nextDeadline();
-                mCvWaitSequenceNumber.timedWait(
-                    &mLock, waitUntilUs);
+                deviceInfo->cvWaitSequenceNumber.timedWait(
+                    &deviceInfo->lock, waitUntilUs);
                 doWait = true;
 
                 if (timeoutDeadline < System::get()->getUnixTimeUs()) {
@@ -3518,7 +3990,7 @@ public:
         }
 
         info.sequenceNumber = sequenceNumber;
-        mCvWaitSequenceNumber.signal();
+        deviceInfo->cvWaitSequenceNumber.signal();
     }
 
     void hostSyncQueue(
@@ -3535,16 +4007,19 @@ public:
 
         auto queue = unbox_VkQueue(boxed_queue);
 
-        AutoLock lock(mLock);
-        auto& info = mQueueInfo[queue];
+        auto deviceInfo = mDeviceOfQueue.get(queue);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
+        auto& info = deviceInfo->queueInfo.at(queue);
 
         bool doWait = false;
 
         if (needHostSync) {
             while ((sequenceNumber - info.sequenceNumber) != 1) {
                 auto waitUntilUs = nextDeadline();
-                mCvWaitSequenceNumber.timedWait(
-                    &mLock, waitUntilUs);
+                deviceInfo->cvWaitSequenceNumber.timedWait(
+                    &deviceInfo->lock, waitUntilUs);
                 doWait = true;
 
                 if (timeoutDeadline < System::get()->getUnixTimeUs()) {
@@ -3555,7 +4030,7 @@ public:
         }
 
         info.sequenceNumber = sequenceNumber;
-        mCvWaitSequenceNumber.signal();
+        deviceInfo->cvWaitSequenceNumber.signal();
     }
 
     VkResult on_vkCreateImageWithRequirementsGOOGLE(
@@ -3625,9 +4100,13 @@ public:
             return result;
         }
         // TODO: Check VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT?
-        AutoLock lock(mLock);
-        mCmdBufferInfo[commandBuffer].preprocessFuncs.clear();
-        mCmdBufferInfo[commandBuffer].subCmds.clear();
+        auto deviceInfo = deviceOfCommandBuffer(commandBuffer);
+        if (!deviceInfo) return VK_SUCCESS;
+
+        AutoLock lock(deviceInfo->lock);
+        auto& cmdBufferInfo = deviceInfo->cmdBuffers[commandBuffer];
+        cmdBufferInfo.preprocessFuncs.clear();
+        cmdBufferInfo.subCmds.clear();
         return VK_SUCCESS;
     }
 
@@ -3655,10 +4134,11 @@ public:
         auto commandBuffer = unbox_VkCommandBuffer(boxed_commandBuffer);
         auto vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
         vk->vkCmdBindPipeline(commandBuffer, pipelineBindPoint, pipeline);
-        if (pipelineBindPoint == VK_PIPELINE_BIND_POINT_COMPUTE) {
-            AutoLock lock(mLock);
-            auto cmdBufferInfoIt = mCmdBufferInfo.find(commandBuffer);
-            if (cmdBufferInfoIt != mCmdBufferInfo.end()) {
+        auto deviceInfo = deviceOfCommandBuffer(commandBuffer);
+        if (pipelineBindPoint == VK_PIPELINE_BIND_POINT_COMPUTE && deviceInfo) {
+            AutoLock lock(deviceInfo->lock);
+            auto cmdBufferInfoIt = deviceInfo->cmdBuffers.find(commandBuffer);
+            if (cmdBufferInfoIt != deviceInfo->cmdBuffers.end()) {
                 if (pipelineBindPoint == VK_PIPELINE_BIND_POINT_COMPUTE) {
                     cmdBufferInfoIt->second.computePipeline = pipeline;
                 }
@@ -3681,10 +4161,11 @@ public:
                 firstSet, descriptorSetCount,
                 pDescriptorSets, dynamicOffsetCount,
                 pDynamicOffsets);
-        if (pipelineBindPoint == VK_PIPELINE_BIND_POINT_COMPUTE) {
-            AutoLock lock(mLock);
-            auto cmdBufferInfoIt = mCmdBufferInfo.find(commandBuffer);
-            if (cmdBufferInfoIt != mCmdBufferInfo.end()) {
+        auto deviceInfo = deviceOfCommandBuffer(commandBuffer);
+        if (pipelineBindPoint == VK_PIPELINE_BIND_POINT_COMPUTE && deviceInfo) {
+            AutoLock lock(deviceInfo->lock);
+            auto cmdBufferInfoIt = deviceInfo->cmdBuffers.find(commandBuffer);
+            if (cmdBufferInfoIt != deviceInfo->cmdBuffers.end()) {
                 cmdBufferInfoIt->second.descriptorLayout = layout;
                 if (descriptorSetCount) {
                     cmdBufferInfoIt->second.firstSet = firstSet;
@@ -3705,16 +4186,15 @@ public:
         auto vk = dispatch_VkDevice(boxed_device);
         VkRenderPassCreateInfo createInfo;
         bool needReformat = false;
-        AutoLock lock(mLock);
 
-        auto deviceInfoIt = mDeviceInfo.find(device);
-        if (deviceInfoIt == mDeviceInfo.end()) {
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) {
             return VK_ERROR_OUT_OF_HOST_MEMORY;
         }
-        if (deviceInfoIt->second.emulateTextureEtc2 ||
-            deviceInfoIt->second.emulateTextureAstc) {
+        if (deviceInfo->emulateTextureEtc2 ||
+            deviceInfo->emulateTextureAstc) {
             for (uint32_t i = 0; i < pCreateInfo->attachmentCount; i++) {
-                if (deviceInfoIt->second.needEmulatedDecompression(
+                if (deviceInfo->needEmulatedDecompression(
                             pCreateInfo->pAttachments[i].format)) {
                     needReformat = true;
                     break;
@@ -3749,10 +4229,7 @@ public:
         VkQueue boxed_queue,
         uint32_t bindInfoCount,
         const VkBindSparseInfo* pBindInfo, VkFence fence) {
-        auto queue = unbox_VkQueue(boxed_queue);
-        auto vk = dispatch_VkQueue(boxed_queue);
-        (void)pool;
-        vk->vkQueueBindSparse(queue, bindInfoCount, pBindInfo, fence);
+        on_vkQueueBindSparse(pool, boxed_queue, bindInfoCount, pBindInfo, fence);
     }
 
 #define GUEST_EXTERNAL_MEMORY_HANDLE_TYPES (VK_EXTERNAL_MEMORY_HANDLE_TYPE_ANDROID_HARDWARE_BUFFER_BIT_ANDROID | VK_EXTERNAL_MEMORY_HANDLE_TYPE_TEMP_ZIRCON_VMO_BIT_FUCHSIA)
@@ -3974,35 +4451,16 @@ private:
             return res;
         }
 
-    VkPhysicalDeviceMemoryProperties* memPropsOfDeviceLocked(VkDevice device) {
-        auto physdev = android::base::find(mDeviceToPhysicalDevice, device);
-        if (!physdev) return nullptr;
-
-        auto physdevInfo = android::base::find(mPhysdevInfo, *physdev);
-        if (!physdevInfo) return nullptr;
+    static bool getDefaultQueueForDevice(
+            const DeviceInfo& deviceInfo, VkQueue* queue,
+            uint32_t* queueFamilyIndex) {
 
-        return &physdevInfo->memoryProperties;
-    }
-
-    Optional<uint32_t> queueFamilyIndexOfQueueLocked(VkQueue queue) {
-        auto info = android::base::find(mQueueInfo, queue);
-        if (!info) return {};
-
-        return info->queueFamilyIndex;
-    }
-
-    bool getDefaultQueueForDeviceLocked(
-            VkDevice device, VkQueue* queue, uint32_t* queueFamilyIndex) {
-
-        auto deviceInfo = android::base::find(mDeviceInfo, device);
-        if (!deviceInfo) return false;
-
-        auto zeroIt = deviceInfo->queues.find(0);
-        if (zeroIt == deviceInfo->queues.end() ||
+        auto zeroIt = deviceInfo.queues.find(0);
+        if (zeroIt == deviceInfo.queues.end() ||
                 zeroIt->second.size() == 0) {
             // Get the first queue / queueFamilyIndex
             // that does show up.
-            for (auto it : deviceInfo->queues) {
+            for (auto it : deviceInfo.queues) {
                 auto index = it.first;
                 for (auto deviceQueue : it.second) {
                     *queue = deviceQueue;
@@ -4538,6 +4996,7 @@ private:
     };
 
     void createSizeCompImages(goldfish_vk::VulkanDispatch* vk,
+            const VkPhysicalDeviceMemoryProperties& memProps,
             CompressedImageInfo* cmpInfo) {
         if (cmpInfo->sizeCompImgs.size() > 0) {
             return;
@@ -4556,7 +5015,6 @@ private:
                     cmpInfo->sizeCompImgs.data() + i);
         }
 
-        VkPhysicalDevice physicalDevice = mDeviceInfo[device].physicalDevice;
         int32_t memIdx = -1;
         VkDeviceSize& alignment = cmpInfo->alignment;
         std::vector<VkDeviceSize> memSizes(mipLevels);
@@ -4565,7 +5023,7 @@ private:
             VkMemoryRequirements memRequirements;
             vk->vkGetImageMemoryRequirements(device, cmpInfo->decompImg,
                     &memRequirements);
-            memIdx = findProperties(physicalDevice,
+            memIdx = findProperties(memProps,
                     memRequirements.memoryTypeBits,
                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
             if (memIdx < 0) {
@@ -4603,20 +5061,19 @@ private:
     }
 
     void updateImageMemorySizeLocked(
-            VkDevice device,
+            DeviceInfo* deviceInfo,
             VkImage image,
             VkMemoryRequirements* pMemoryRequirements) {
-        auto deviceInfoIt = mDeviceInfo.find(device);
-        if (!deviceInfoIt->second.emulateTextureEtc2 &&
-            !deviceInfoIt->second.emulateTextureAstc) {
+        if (!deviceInfo->emulateTextureEtc2 &&
+            !deviceInfo->emulateTextureAstc) {
             return;
         }
-        auto it = mImageInfo.find(image);
-        if (it == mImageInfo.end()) {
+        auto it = deviceInfo->images.find(image);
+        if (it == deviceInfo->images.end()) {
             return;
         }
         CompressedImageInfo& cmpInfo = it->second.cmpInfo;
-        if (!deviceInfoIt->second.needEmulatedDecompression(cmpInfo)) {
+        if (!deviceInfo->needEmulatedDecompression(cmpInfo)) {
             return;
         }
         pMemoryRequirements->alignment =
@@ -5010,9 +5467,10 @@ private:
         }
 
 
-    void executePreprocessRecursive(int level, VkCommandBuffer cmdBuffer) {
-        auto cmdBufferIt = mCmdBufferInfo.find(cmdBuffer);
-        if (cmdBufferIt == mCmdBufferInfo.end()) {
+    void executePreprocessRecursiveLocked(
+            DeviceInfo* deviceInfo, int level, VkCommandBuffer cmdBuffer) {
+        auto cmdBufferIt = deviceInfo->cmdBuffers.find(cmdBuffer);
+        if (cmdBufferIt == deviceInfo->cmdBuffers.end()) {
             return;
         }
         for (const auto& func : cmdBufferIt->second.preprocessFuncs) {
@@ -5020,52 +5478,45 @@ private:
         }
         // TODO: fix
         // for (const auto& subCmd : cmdBufferIt->second.subCmds) {
-        // executePreprocessRecursive(level + 1, subCmd);
+        // executePreprocessRecursiveLocked(deviceInfo, level + 1, subCmd);
         // }
     }
 
     void teardownInstanceLocked(VkInstance instance) {
 
-        std::vector<VkDevice> devicesToDestroy;
-        std::vector<VulkanDispatch*> devicesToDestroyDispatches;
+        std::vector<std::shared_ptr<DeviceInfo>> devicesToDestroy;
 
-        for (auto it : mDeviceToPhysicalDevice) {
-            auto otherInstance = android::base::find(mPhysicalDeviceToInstance, it.second);
+        for (const auto& deviceInfo : mDeviceInfo.values()) {
+            auto otherInstance = android::base::find(
+                    mPhysicalDeviceToInstance, deviceInfo->physicalDevice);
             if (!otherInstance) continue;
 
             if (instance == *otherInstance) {
-                devicesToDestroy.push_back(it.first);
-                devicesToDestroyDispatches.push_back(
-                        dispatch_VkDevice(
-                            mDeviceInfo[it.first].boxed));
+                devicesToDestroy.push_back(deviceInfo);
             }
         }
 
-        for (uint32_t i = 0; i < devicesToDestroy.size(); ++i) {
+        for (const auto& deviceInfo : devicesToDestroy) {
+            auto device = unbox_VkDevice(deviceInfo->boxed);
+            auto vk = dispatch_VkDevice(deviceInfo->boxed);
+
             // https://bugs.chromium.org/p/chromium/issues/detail?id=1074600
             // it's important to idle the device before destroying it!
-            devicesToDestroyDispatches[i]->vkDeviceWaitIdle(devicesToDestroy[i]);
-            std::vector<VkDeviceMemory> toDestroy;
+            vk->vkDeviceWaitIdle(device);
 
-            auto it = mMapInfo.begin();
-            while (it != mMapInfo.end()) {
-                if (it->second.device == devicesToDestroy[i]) {
-                    toDestroy.push_back(it->first);
-                }
-                ++it;
+            AutoLock lock(deviceInfo->lock);
+            std::vector<VkDeviceMemory> toDestroy;
+            for (const auto& it : deviceInfo->memory) {
+                toDestroy.push_back(it.first);
             }
 
             for (auto mem: toDestroy) {
-                freeMemoryLocked(devicesToDestroyDispatches[i],
-                        devicesToDestroy[i],
-                        mem, nullptr);
+                freeMemoryLocked(vk, deviceInfo.get(), device, mem, nullptr);
             }
         }
 
-        for (uint32_t i = 0; i < devicesToDestroy.size(); ++i) {
-            destroyDeviceLocked(devicesToDestroy[i], nullptr);
-            mDeviceInfo.erase(devicesToDestroy[i]);
-            mDeviceToPhysicalDevice.erase(devicesToDestroy[i]);
+        for (const auto& deviceInfo : devicesToDestroy) {
+            destroyDeviceLocked(unbox_VkDevice(deviceInfo->boxed), nullptr);
         }
     }
 
@@ -5087,10 +5538,13 @@ private:
         std::unordered_set<VkCommandBuffer> cmdBuffers = {};
     };
 
-    void removeCommandBufferInfo(
+    void removeCommandBufferInfoLocked(
+            DeviceInfo* deviceInfo,
             const std::unordered_set<VkCommandBuffer>& cmdBuffers) {
+        AutoLock indexLock(mDeviceOfHandleLock);
         for (const auto& cmdBuffer : cmdBuffers) {
-            mCmdBufferInfo.erase(cmdBuffer);
+            deviceInfo->cmdBuffers.erase(cmdBuffer);
+            mDeviceOfCmdBuffer.erase(cmdBuffer);
         }
     }
 
@@ -5205,29 +5659,30 @@ private:
     }
 
     void registerDescriptorUpdateTemplate(
+            VkDevice device,
             VkDescriptorUpdateTemplate descriptorUpdateTemplate,
             const DescriptorUpdateTemplateInfo& info) {
-        AutoLock lock(mLock);
-        mDescriptorUpdateTemplateInfo[descriptorUpdateTemplate] = info;
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
+        deviceInfo->descriptorUpdateTemplates[descriptorUpdateTemplate] = info;
     }
 
     void unregisterDescriptorUpdateTemplate(
+            VkDevice device,
             VkDescriptorUpdateTemplate descriptorUpdateTemplate) {
-        AutoLock lock(mLock);
-        mDescriptorUpdateTemplateInfo.erase(descriptorUpdateTemplate);
+        auto deviceInfo = mDeviceInfo.get(device);
+        if (!deviceInfo) return;
+
+        AutoLock lock(deviceInfo->lock);
+        deviceInfo->descriptorUpdateTemplates.erase(descriptorUpdateTemplate);
     }
 
     // Returns the momory property index when succeeds; returns -1 when fails.
-    int32_t findProperties(VkPhysicalDevice physicalDevice,
+    int32_t findProperties(const VkPhysicalDeviceMemoryProperties& memProperties,
             uint32_t memoryTypeBitsRequirement,
             VkMemoryPropertyFlags requiredProperties) {
-        VkPhysicalDeviceMemoryProperties memProperties;
-        auto ivk = dispatch_VkInstance(
-                mInstanceInfo[mPhysicalDeviceToInstance[physicalDevice]].boxed);
-
-        ivk->vkGetPhysicalDeviceMemoryProperties(physicalDevice,
-                &memProperties);
-
         const uint32_t memoryCount = memProperties.memoryTypeCount;
         for (uint32_t memoryIndex = 0; memoryIndex < memoryCount;
                 ++memoryIndex) {
@@ -5254,11 +5709,16 @@ private:
     bool mVkCleanupEnabled = true;
     bool mLogging = false;
     bool mVerbosePrints = false;
+    // Window to merge fenceless queue submits in, 0 if they aren't.
+    System::Duration mSubmitBatchWindowUs = 0;
     bool mUseOldMemoryCleanupPath = false;
     PFN_vkUseIOSurfaceMVK m_useIOSurfaceFunc = nullptr;
 
+    // Guards the registry of instances, physical devices and devices, and
+    // the semaphores, which are shared across devices. The objects of a
+    // device are guarded by the lock of its DeviceInfo instead; take mLock
+    // before that if both are needed.
     Lock mLock;
-    ConditionVariable mCvWaitSequenceNumber;
 
     // We always map the whole size on host.
     // This makes it much easier to implement
@@ -5277,6 +5737,8 @@ private:
         uint64_t hostmemId = 0;
         VkDevice device = VK_NULL_HANDLE;
         IOSurfaceRef ioSurface = nullptr;
+        // Identifies the memory in snapshots.
+        VkDeviceMemory boxed = VK_NULL_HANDLE;
     };
 
     struct InstanceInfo {
@@ -5291,13 +5753,106 @@ private:
         VkPhysicalDevice boxed = nullptr;
     };
 
+    struct QueueInfo {
+        VkDevice device;
+        uint32_t queueFamilyIndex;
+        VkQueue boxed = nullptr;
+        // Guarded by the lock of the device.
+        uint32_t sequenceNumber = 0;
+        // Serializes the use of the queue, which happens without locks,
+        // and batches submits if ANDROID_EMU_VK_SUBMIT_BATCH_US is set.
+        std::shared_ptr<VkQueueSubmitBatcher> submitBatcher;
+    };
+
+    struct BufferInfo {
+        VkDevice device;
+        VkDeviceMemory memory = 0;
+        VkDeviceSize memoryOffset = 0;
+        VkDeviceSize size;
+        // For compressed texture emulation
+        VulkanDispatch* vk = nullptr;
+    };
+
+    struct ImageInfo {
+        AndroidNativeBufferInfo anbInfo;
+        CompressedImageInfo cmpInfo;
+    };
+
+    struct ImageViewInfo {
+        bool needEmulatedAlpha = false;
+    };
+
+    struct SamplerInfo {
+        bool needEmulatedAlpha = false;
+        VkSamplerCreateInfo createInfo = {};
+        VkSampler emulatedborderSampler = VK_NULL_HANDLE;
+    };
+
+    struct SemaphoreInfo {
+        int externalHandleId = 0;
+        VK_EXT_MEMORY_HANDLE externalHandle =
+            VK_EXT_MEMORY_HANDLE_INVALID;
+    };
+
+    struct DescriptorSetLayoutInfo  {
+        VkDescriptorSetLayoutCreateInfo createInfo;
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+    };
+
+    struct DescriptorPoolInfo {
+        struct PoolState {
+            VkDescriptorType type;
+            uint32_t descriptorCount;
+            uint32_t used;
+        };
+
+        VkDescriptorPoolCreateInfo createInfo;
+        uint32_t maxSets;
+        uint32_t usedSets;
+        std::vector<PoolState> pools;
+
+        std::unordered_map<VkDescriptorSet, VkDescriptorSet> allocedSetsToBoxed;
+    };
+
+    struct DescriptorSetInfo {
+        VkDescriptorPool pool;
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+    };
+
+    // What is set up in vkCreateDevice doesn't change until the device is
+    // destroyed and can be read without locks; the objects created on the
+    // device are guarded by |lock|.
     struct DeviceInfo {
         std::unordered_map<uint32_t, std::vector<VkQueue>> queues;
+        std::unordered_map<VkQueue, QueueInfo> queueInfo;
         std::vector<std::string> enabledExtensionNames;
         bool emulateTextureEtc2 = false;
         bool emulateTextureAstc = false;
         VkPhysicalDevice physicalDevice;
         VkDevice boxed = nullptr;
+        VkPhysicalDeviceMemoryProperties memProps = {};
+        uint32_t apiVersion = 0;
+        // Serializes native buffer image syncs, which happen without |lock|.
+        Lock nativeBufferLock;
+
+        Lock lock;
+        ConditionVariable cvWaitSequenceNumber;
+        std::unordered_map<VkImage, ImageInfo> images;
+        std::unordered_map<VkImageView, ImageViewInfo> imageViews;
+        std::unordered_map<VkSampler, SamplerInfo> samplers;
+        std::unordered_map<VkBuffer, BufferInfo> buffers;
+        std::unordered_map<VkDeviceMemory, MappedMemoryInfo> memory;
+        std::unordered_map<VkCommandBuffer, CommandBufferInfo> cmdBuffers;
+        std::unordered_map<VkCommandPool, CommandPoolInfo> cmdPools;
+        std::unordered_map<VkDescriptorSetLayout, DescriptorSetLayoutInfo>
+            descriptorSetLayouts;
+        std::unordered_map<VkDescriptorPool, DescriptorPoolInfo>
+            descriptorPools;
+        std::unordered_map<VkDescriptorSet, DescriptorSetInfo> descriptorSets;
+        std::unordered_map<VkDescriptorUpdateTemplate,
+                           DescriptorUpdateTemplateInfo>
+            descriptorUpdateTemplates;
+
         bool needEmulatedDecompression(const CompressedImageInfo& imageInfo) {
             return imageInfo.isCompressed &&
                    ((imageInfo.isEtc2 && emulateTextureEtc2) ||
@@ -5351,66 +5906,25 @@ private:
         }
     };
 
-    struct QueueInfo {
-        VkDevice device;
-        uint32_t queueFamilyIndex;
-        VkQueue boxed = nullptr;
-        uint32_t sequenceNumber = 0;
-    };
-
-    struct BufferInfo {
-        VkDevice device;
-        VkDeviceMemory memory = 0;
-        VkDeviceSize memoryOffset = 0;
-        VkDeviceSize size;
-        // For compressed texture emulation
-        VulkanDispatch* vk = nullptr;
-    };
-
-    struct ImageInfo {
-        AndroidNativeBufferInfo anbInfo;
-        CompressedImageInfo cmpInfo;
-    };
-
-    struct ImageViewInfo {
-        bool needEmulatedAlpha = false;
-    };
-
-    struct SamplerInfo {
-        bool needEmulatedAlpha = false;
-        VkSamplerCreateInfo createInfo = {};
-        VkSampler emulatedborderSampler = VK_NULL_HANDLE;
-    };
-
-    struct SemaphoreInfo {
-        int externalHandleId = 0;
-        VK_EXT_MEMORY_HANDLE externalHandle =
-            VK_EXT_MEMORY_HANDLE_INVALID;
-    };
-
-    struct DescriptorSetLayoutInfo  {
-        VkDescriptorSetLayoutCreateInfo createInfo;
-        std::vector<VkDescriptorSetLayoutBinding> bindings;
-    };
-
-    struct DescriptorPoolInfo {
-        struct PoolState {
-            VkDescriptorType type;
-            uint32_t descriptorCount;
-            uint32_t used;
-        };
-
-        VkDescriptorPoolCreateInfo createInfo;
-        uint32_t maxSets;
-        uint32_t usedSets;
-        std::vector<PoolState> pools;
+    // Holds the locks of |devices|, which only save and load take together,
+    // under mLock.
+    class DeviceLocks {
+    public:
+        DeviceLocks(const std::vector<std::shared_ptr<DeviceInfo>>& devices)
+            : mDevices(devices) {
+            for (const auto& deviceInfo : mDevices) {
+                deviceInfo->lock.lock();
+            }
+        }
 
-        std::unordered_map<VkDescriptorSet, VkDescriptorSet> allocedSetsToBoxed;
-    };
+        ~DeviceLocks() {
+            for (const auto& deviceInfo : mDevices) {
+                deviceInfo->lock.unlock();
+            }
+        }
 
-    struct DescriptorSetInfo {
-        VkDescriptorPool pool;
-        std::vector<VkDescriptorSetLayoutBinding> bindings;
+    private:
+        std::vector<std::shared_ptr<DeviceInfo>> mDevices;
     };
 
     bool isBindingFeasibleForAlloc(const DescriptorPoolInfo::PoolState& poolState, const VkDescriptorSetLayoutBinding& binding) {
@@ -5446,8 +5960,9 @@ private:
         poolState.used -= binding.descriptorCount;
     }
 
-    VkResult validateDescriptorSetAllocLocked(const VkDescriptorSetAllocateInfo* pAllocateInfo) {
-        auto poolInfo = android::base::find(mDescriptorPoolInfo, pAllocateInfo->descriptorPool);
+    VkResult validateDescriptorSetAllocLocked(
+            DeviceInfo* deviceInfo, const VkDescriptorSetAllocateInfo* pAllocateInfo) {
+        auto poolInfo = android::base::find(deviceInfo->descriptorPools, pAllocateInfo->descriptorPool);
         if (!poolInfo) return VK_ERROR_INITIALIZATION_FAILED;
 
         // Check the number of sets available.
@@ -5463,7 +5978,7 @@ private:
             poolInfo->pools;
 
         for (uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; ++i) {
-            auto setLayoutInfo = android::base::find(mDescriptorSetLayoutInfo, pAllocateInfo->pSetLayouts[i]);
+            auto setLayoutInfo = android::base::find(deviceInfo->descriptorSetLayouts, pAllocateInfo->pSetLayouts[i]);
             if (!setLayoutInfo) return VK_ERROR_INITIALIZATION_FAILED;
 
             for (const auto& binding : setLayoutInfo->bindings) {
@@ -5506,6 +6021,55 @@ private:
         }
     }
 
+    // A map that is copied on write, under mLock, so that it can be read
+    // without locks. Values stay alive for readers holding them.
+    template <class K, class V>
+    class CopyOnWriteMap {
+    public:
+        using Map = std::unordered_map<K, std::shared_ptr<V>>;
+
+        std::shared_ptr<V> get(K key) const {
+            auto map = std::atomic_load(&mMap);
+            if (!map) return nullptr;
+
+            auto it = map->find(key);
+            if (it == map->end()) return nullptr;
+
+            return it->second;
+        }
+
+        std::vector<std::shared_ptr<V>> values() const {
+            std::vector<std::shared_ptr<V>> res;
+            auto map = std::atomic_load(&mMap);
+            if (!map) return res;
+
+            for (const auto& it : *map) {
+                res.push_back(it.second);
+            }
+            return res;
+        }
+
+        // Erases |key| with null |value|.
+        void setLocked(K key, std::shared_ptr<V> value) {
+            auto current = std::atomic_load(&mMap);
+            auto next = current ? std::make_shared<Map>(*current)
+                                : std::make_shared<Map>();
+            if (value) {
+                (*next)[key] = std::move(value);
+            } else {
+                next->erase(key);
+            }
+            std::atomic_store(&mMap, std::shared_ptr<const Map>(std::move(next)));
+        }
+
+        void clearLocked() {
+            std::atomic_store(&mMap, std::shared_ptr<const Map>());
+        }
+
+    private:
+        std::shared_ptr<const Map> mMap;
+    };
+
     template <class T>
     class BoxedHandleManager {
     public:
@@ -5564,31 +6128,24 @@ private:
         mInstanceInfo;
     std::unordered_map<VkPhysicalDevice, PhysicalDeviceInfo>
         mPhysdevInfo;
-    std::unordered_map<VkDevice, DeviceInfo>
-        mDeviceInfo;
-    std::unordered_map<VkImage, ImageInfo>
-        mImageInfo;
-    std::unordered_map<VkImageView, ImageViewInfo> mImageViewInfo;
-    std::unordered_map<VkSampler, SamplerInfo> mSamplerInfo;
-    std::unordered_map<VkCommandBuffer, CommandBufferInfo> mCmdBufferInfo;
-    std::unordered_map<VkCommandPool, CommandPoolInfo> mCmdPoolInfo;
-    // TODO: release CommandBufferInfo when a command pool is reset/released
-
-    // Back-reference to the physical device associated with a particular
-    // VkDevice, and the VkDevice corresponding to a VkQueue.
-    std::unordered_map<VkDevice, VkPhysicalDevice> mDeviceToPhysicalDevice;
+    CopyOnWriteMap<VkDevice, DeviceInfo> mDeviceInfo;
+    CopyOnWriteMap<VkQueue, DeviceInfo> mDeviceOfQueue;
     std::unordered_map<VkPhysicalDevice, VkInstance> mPhysicalDeviceToInstance;
 
-    std::unordered_map<VkQueue, QueueInfo> mQueueInfo;
-    std::unordered_map<VkBuffer, BufferInfo> mBufferInfo;
+    // The devices of command buffers and memory, which calls only name by
+    // those. Taken after the device lock.
+    Lock mDeviceOfHandleLock;
+    std::unordered_map<VkCommandBuffer, std::shared_ptr<DeviceInfo>>
+        mDeviceOfCmdBuffer;
+    std::unordered_map<VkDeviceMemory, std::shared_ptr<DeviceInfo>>
+        mDeviceOfMemory;
 
-    std::unordered_map<VkDeviceMemory, MappedMemoryInfo> mMapInfo;
+    // Contents of the host visible memory of the devices as of the last
+    // snapshot.
+    VkMemorySnapshot mMemorySnapshot;
 
     std::unordered_map<VkSemaphore, SemaphoreInfo> mSemaphoreInfo;
 
-    std::unordered_map<VkDescriptorSetLayout, DescriptorSetLayoutInfo> mDescriptorSetLayoutInfo;
-    std::unordered_map<VkDescriptorPool, DescriptorPoolInfo> mDescriptorPoolInfo;
-    std::unordered_map<VkDescriptorSet, DescriptorSetInfo> mDescriptorSetInfo;
 
 #ifdef _WIN32
     int mSemaphoreId = 1;
@@ -5602,7 +6159,6 @@ private:
     }
     std::unordered_map<int, VkSemaphore> mExternalSemaphoresById;
 #endif
-    std::unordered_map<VkDescriptorUpdateTemplate, DescriptorUpdateTemplateInfo> mDescriptorUpdateTemplateInfo;
 
     BoxedHandleManager<DispatchableHandleInfo<uint64_t>> mGlobalHandleStore;
 
@@ -5650,8 +6206,12 @@ void VkDecoderGlobalState::save(android::base::Stream* stream) {
     mImpl->save(stream);
 }
 
-void VkDecoderGlobalState::load(android::base::Stream* stream) {
-    mImpl->load(stream);
+bool VkDecoderGlobalState::load(android::base::Stream* stream) {
+    return mImpl->load(stream);
+}
+
+VkMemorySnapshot::Stats VkDecoderGlobalState::memorySnapshotStats() {
+    return mImpl->memorySnapshotStats();
 }
 
 void VkDecoderGlobalState::lock() {
@@ -6338,6 +6898,48 @@ VkResult VkDecoderGlobalState::on_vkQueueWaitIdle(
     return mImpl->on_vkQueueWaitIdle(pool, queue);
 }
 
+VkResult VkDecoderGlobalState::on_vkQueueBindSparse(
+        android::base::Pool* pool,
+        VkQueue queue,
+        uint32_t bindInfoCount,
+        const VkBindSparseInfo* pBindInfo,
+        VkFence fence) {
+    return mImpl->on_vkQueueBindSparse(pool, queue, bindInfoCount, pBindInfo, fence);
+}
+
+VkResult VkDecoderGlobalState::on_vkDeviceWaitIdle(
+        android::base::Pool* pool,
+        VkDevice device) {
+    return mImpl->on_vkDeviceWaitIdle(pool, device);
+}
+
+VkResult VkDecoderGlobalState::on_vkQueuePresentKHR(
+        android::base::Pool* pool,
+        VkQueue queue,
+        const VkPresentInfoKHR* pPresentInfo) {
+    return mImpl->on_vkQueuePresentKHR(pool, queue, pPresentInfo);
+}
+
+void VkDecoderGlobalState::on_vkQueueBeginDebugUtilsLabelEXT(
+        android::base::Pool* pool,
+        VkQueue queue,
+        const VkDebugUtilsLabelEXT* pLabelInfo) {
+    mImpl->on_vkQueueBeginDebugUtilsLabelEXT(pool, queue, pLabelInfo);
+}
+
+void VkDecoderGlobalState::on_vkQueueEndDebugUtilsLabelEXT(
+        android::base::Pool* pool,
+        VkQueue queue) {
+    mImpl->on_vkQueueEndDebugUtilsLabelEXT(pool, queue);
+}
+
+void VkDecoderGlobalState::on_vkQueueInsertDebugUtilsLabelEXT(
+        android::base::Pool* pool,
+        VkQueue queue,
+        const VkDebugUtilsLabelEXT* pLabelInfo) {
+    mImpl->on_vkQueueInsertDebugUtilsLabelEXT(pool, queue, pLabelInfo);
+}
+
 VkResult VkDecoderGlobalState::on_vkResetCommandBuffer(
     android::base::Pool* pool,
     VkCommandBuffer commandBuffer,
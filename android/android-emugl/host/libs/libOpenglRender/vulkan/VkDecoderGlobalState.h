@@ -13,6 +13,7 @@
 // limitations under the License.
 #pragma once
 
+#include "VkMemorySnapshot.h"
 #include "VulkanHandleMapping.h"
 #include "VulkanDispatch.h"
 
@@ -61,7 +62,10 @@ public:
     bool vkCleanupEnabled() const;
 
     void save(android::base::Stream* stream);
-    void load(android::base::Stream* stream);
+    // Returns false if the stream doesn't have a state this can restore.
+    bool load(android::base::Stream* stream);
+    // Host visible memory in the last save() or load().
+    VkMemorySnapshot::Stats memorySnapshotStats();
 
     // Lock/unlock of global state to serve as a global lock
     void lock();
@@ -523,6 +527,36 @@ public:
         android::base::Pool* pool,
         VkQueue queue);
 
+    VkResult on_vkQueueBindSparse(
+        android::base::Pool* pool,
+        VkQueue queue,
+        uint32_t bindInfoCount,
+        const VkBindSparseInfo* pBindInfo,
+        VkFence fence);
+
+    VkResult on_vkDeviceWaitIdle(
+        android::base::Pool* pool,
+        VkDevice device);
+
+    VkResult on_vkQueuePresentKHR(
+        android::base::Pool* pool,
+        VkQueue queue,
+        const VkPresentInfoKHR* pPresentInfo);
+
+    void on_vkQueueBeginDebugUtilsLabelEXT(
+        android::base::Pool* pool,
+        VkQueue queue,
+        const VkDebugUtilsLabelEXT* pLabelInfo);
+
+    void on_vkQueueEndDebugUtilsLabelEXT(
+        android::base::Pool* pool,
+        VkQueue queue);
+
+    void on_vkQueueInsertDebugUtilsLabelEXT(
+        android::base::Pool* pool,
+        VkQueue queue,
+        const VkDebugUtilsLabelEXT* pLabelInfo);
+
     VkResult on_vkResetCommandBuffer(
         android::base::Pool* pool,
         VkCommandBuffer commandBuffer,
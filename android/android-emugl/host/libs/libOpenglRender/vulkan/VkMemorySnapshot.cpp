@@ -0,0 +1,324 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "VkMemorySnapshot.h"
+
+#include "android/base/Stopwatch.h"
+#include "android/snapshot/Compressor.h"
+#include "android/snapshot/Decompressor.h"
+
+#include "MurmurHash3.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <unordered_set>
+
+using android::base::Stopwatch;
+using android::base::Stream;
+
+namespace compress = android::snapshot::compress;
+
+namespace goldfish_vk {
+
+static size_t chunkCount(uint64_t size) {
+    return (size + VkMemorySnapshot::kChunkBytes - 1) /
+           VkMemorySnapshot::kChunkBytes;
+}
+
+static size_t chunkSize(uint64_t size, size_t index) {
+    const uint64_t remaining = size - index * VkMemorySnapshot::kChunkBytes;
+    return remaining < VkMemorySnapshot::kChunkBytes
+                   ? remaining
+                   : VkMemorySnapshot::kChunkBytes;
+}
+
+static std::array<uint64_t, 2> hashChunk(const uint8_t* data, size_t bytes) {
+    std::array<uint64_t, 2> hash;
+    MurmurHash3_x64_128(data, (int)bytes, 0, hash.data());
+    return hash;
+}
+
+// A chunk word in the stream with this bit set refers to the chunk stored
+// at the index in its other bits; otherwise it's the size of the bytes that
+// follow.
+static constexpr uint32_t kReferenceBit = 0x80000000u;
+
+void VkMemorySnapshot::save(Stream* stream, const std::vector<Region>& regions) {
+    mStats = Stats();
+    Stopwatch sw;
+
+    struct Job {
+        const Region* region;
+        size_t index;
+        Chunk* chunk;
+        const Chunk* previous;
+        // Index of the stored chunk this one refers to, or -1 if it's stored.
+        int64_t reference;
+    };
+
+    ChunkMap chunks;
+    std::vector<Job> jobs;
+
+    for (const auto& region : regions) {
+        auto& regionChunks = chunks[region.handle];
+        regionChunks.resize(chunkCount(region.size));
+        mStats.totalBytes += region.size;
+    }
+
+    // The chunk vectors stay where they are from here on, and the jobs are
+    // in stream order.
+    for (const auto& region : regions) {
+        auto& regionChunks = chunks[region.handle];
+        auto previous = mChunks.find(region.handle);
+        for (size_t i = 0; i < regionChunks.size(); ++i) {
+            const Chunk* previousChunk = nullptr;
+            if (previous != mChunks.end() && i < previous->second.size()) {
+                previousChunk = &previous->second[i];
+            }
+            jobs.push_back({&region, i, &regionChunks[i], previousChunk, -1});
+        }
+    }
+
+    std::atomic<uint64_t> unchangedBytes{0};
+
+    compress::runOnWorkers(jobs.size(), [&jobs, &unchangedBytes](size_t i) {
+        const Job& job = jobs[i];
+        const size_t bytes = chunkSize(job.region->size, job.index);
+        job.chunk->hash =
+                hashChunk(job.region->ptr + job.index * kChunkBytes, bytes);
+
+        if (job.previous && job.previous->stored &&
+            job.previous->hash == job.chunk->hash) {
+            job.chunk->stored = job.previous->stored;
+            unchangedBytes += bytes;
+        }
+    });
+
+    // Only the first chunk with given contents is stored.
+    struct HashOf {
+        size_t operator()(const std::array<uint64_t, 2>& hash) const {
+            return (size_t)hash[0];
+        }
+    };
+    std::unordered_map<std::array<uint64_t, 2>, int64_t, HashOf> storedIndex;
+    std::vector<size_t> toCompress;
+    int64_t storedCount = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        Job& job = jobs[i];
+        auto inserted = storedIndex.emplace(job.chunk->hash, storedCount);
+        if (!inserted.second) {
+            job.reference = inserted.first->second;
+            mStats.referencedBytes += chunkSize(job.region->size, job.index);
+            continue;
+        }
+        ++storedCount;
+        if (!job.chunk->stored) {
+            toCompress.push_back(i);
+        }
+    }
+
+    compress::runOnWorkers(toCompress.size(), [&jobs, &toCompress](size_t i) {
+        const Job& job = jobs[toCompress[i]];
+        const size_t bytes = chunkSize(job.region->size, job.index);
+        const uint8_t* data = job.region->ptr + job.index * kChunkBytes;
+
+        auto stored = std::make_shared<std::vector<uint8_t>>(
+                compress::maxCompressedSize((int32_t)bytes));
+        const int32_t compressedBytes = compress::compress(
+                data, (int32_t)bytes, stored->data(), (int32_t)stored->size());
+
+        if (compressedBytes <= 0 || (size_t)compressedBytes >= bytes) {
+            stored->assign(data, data + bytes);
+        } else {
+            stored->resize(compressedBytes);
+            stored->shrink_to_fit();
+        }
+
+        job.chunk->stored = std::move(stored);
+    });
+
+    mStats.unchangedBytes = unchangedBytes;
+    mStats.processUs = sw.restartUs();
+
+    std::vector<const Chunk*> storedChunks;
+    storedChunks.reserve(storedCount);
+
+    stream->putBe32(kVersion);
+    stream->putBe32((uint32_t)regions.size());
+    size_t jobIndex = 0;
+    for (const auto& region : regions) {
+        stream->putBe64(region.handle);
+        stream->putBe64(region.size);
+        for (auto& chunk : chunks[region.handle]) {
+            const Job& job = jobs[jobIndex++];
+            if (job.reference >= 0) {
+                // Same contents, so the same bytes for the next save.
+                chunk.stored = storedChunks[job.reference]->stored;
+                stream->putBe32(kReferenceBit | (uint32_t)job.reference);
+                mStats.storedBytes += 4;
+                continue;
+            }
+            storedChunks.push_back(&chunk);
+            stream->putBe32((uint32_t)chunk.stored->size());
+            stream->write(chunk.stored->data(), chunk.stored->size());
+            mStats.storedBytes += 4 + chunk.stored->size();
+        }
+    }
+
+    mStats.streamUs = sw.elapsedUs();
+
+    keepChunks(std::move(chunks));
+}
+
+bool VkMemorySnapshot::load(Stream* stream, const std::vector<Region>& regions) {
+    mStats = Stats();
+    mChunks.clear();
+    Stopwatch sw;
+
+    const uint32_t version = stream->getBe32();
+    if (version != kVersion) {
+        fprintf(stderr,
+                "VkMemorySnapshot::%s: stream version %u, expected %u\n",
+                __func__, version, kVersion);
+        return false;
+    }
+
+    std::unordered_map<uint64_t, const Region*> regionsByHandle;
+    for (const auto& region : regions) {
+        regionsByHandle[region.handle] = &region;
+    }
+
+    struct Job {
+        uint8_t* dst;
+        size_t bytes;
+        Chunk* chunk;
+    };
+
+    ChunkMap chunks;
+    std::vector<Job> jobs;
+    std::vector<std::shared_ptr<const std::vector<uint8_t>>> storedChunks;
+
+    // Read everything first; the chunk vectors are final once created.
+    const uint32_t count = stream->getBe32();
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint64_t handle = stream->getBe64();
+        const uint64_t size = stream->getBe64();
+
+        auto it = regionsByHandle.find(handle);
+        const Region* region = it == regionsByHandle.end() ? nullptr : it->second;
+        if (region && region->size != size) {
+            fprintf(stderr,
+                    "VkMemorySnapshot::%s: memory 0x%llx is %llu bytes, saved with %llu, "
+                    "not restoring it\n", __func__,
+                    (unsigned long long)handle,
+                    (unsigned long long)region->size,
+                    (unsigned long long)size);
+            region = nullptr;
+        }
+
+        std::vector<Chunk> dropped;
+        auto& regionChunks = region ? chunks[handle] : dropped;
+        regionChunks.resize(chunkCount(size));
+
+        for (size_t j = 0; j < regionChunks.size(); ++j) {
+            const uint32_t word = stream->getBe32();
+            mStats.storedBytes += 4;
+            if (word & kReferenceBit) {
+                const uint32_t index = word & ~kReferenceBit;
+                if (index >= storedChunks.size()) {
+                    fprintf(stderr,
+                            "VkMemorySnapshot::%s: memory 0x%llx refers to "
+                            "chunk %u of %zu\n", __func__,
+                            (unsigned long long)handle, index,
+                            storedChunks.size());
+                    return false;
+                }
+                regionChunks[j].stored = storedChunks[index];
+                mStats.referencedBytes += chunkSize(size, j);
+            } else {
+                auto stored = std::make_shared<std::vector<uint8_t>>(word);
+                stream->read(stored->data(), word);
+                mStats.storedBytes += word;
+                storedChunks.push_back(stored);
+                regionChunks[j].stored = std::move(stored);
+            }
+
+            if (region) {
+                jobs.push_back({region->ptr + j * kChunkBytes,
+                                chunkSize(size, j), &regionChunks[j]});
+            }
+        }
+
+        mStats.totalBytes += size;
+    }
+
+    mStats.streamUs = sw.restartUs();
+
+    std::atomic<bool> failed{false};
+    compress::runOnWorkers(jobs.size(), [&jobs, &failed](size_t i) {
+        const Job& job = jobs[i];
+        const auto& stored = *job.chunk->stored;
+
+        if (stored.size() == job.bytes) {
+            memcpy(job.dst, stored.data(), job.bytes);
+        } else if (!android::snapshot::Decompressor::decompress(
+                           stored.data(), (int32_t)stored.size(), job.dst,
+                           (int32_t)job.bytes)) {
+            failed = true;
+            return;
+        }
+
+        job.chunk->hash = hashChunk(job.dst, job.bytes);
+    });
+
+    mStats.processUs = sw.elapsedUs();
+
+    if (failed) {
+        fprintf(stderr, "VkMemorySnapshot::%s: failed to decompress memory\n",
+                __func__);
+        return false;
+    }
+
+    keepChunks(std::move(chunks));
+    return true;
+}
+
+void VkMemorySnapshot::clear() {
+    mChunks.clear();
+}
+
+// Keeps the hashes of |chunks| and as many of their stored bytes as fit in
+// mMaxCachedBytes. Chunks without them are compressed again by the next
+// save, changed or not.
+void VkMemorySnapshot::keepChunks(ChunkMap&& chunks) {
+    std::unordered_set<const std::vector<uint8_t>*> kept;
+    uint64_t cachedBytes = 0;
+    for (auto& region : chunks) {
+        for (auto& chunk : region.second) {
+            if (!chunk.stored || kept.count(chunk.stored.get())) {
+                continue;
+            }
+            if (cachedBytes + chunk.stored->size() > mMaxCachedBytes) {
+                chunk.stored.reset();
+                continue;
+            }
+            cachedBytes += chunk.stored->size();
+            kept.insert(chunk.stored.get());
+        }
+    }
+    mStats.cachedBytes = cachedBytes;
+    mChunks = std::move(chunks);
+}
+
+}  // namespace goldfish_vk
@@ -0,0 +1,93 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include "android/base/files/Stream.h"
+#include "android/base/system/System.h"
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace goldfish_vk {
+
+// Saves and restores the contents of host visible device memory with the
+// Vulkan snapshot. Memory is split in chunks that are hashed and compressed
+// in parallel on the snapshot compression workers. Chunks that did not
+// change since the previous save or load reuse their compressed bytes, as
+// far as those fit in the cache, and a chunk with the same contents as one
+// already in the stream is stored as a reference to it.
+class VkMemorySnapshot {
+public:
+    struct Region {
+        // The boxed VkDeviceMemory, which stays the same across snapshot
+        // save and load.
+        uint64_t handle;
+        uint8_t* ptr;
+        uint64_t size;
+    };
+
+    struct Stats {
+        uint64_t totalBytes = 0;
+        // Bytes of the chunks unchanged since the previous snapshot.
+        uint64_t unchangedBytes = 0;
+        // Bytes of the chunks stored as a reference to an earlier one.
+        uint64_t referencedBytes = 0;
+        // Bytes in the snapshot stream.
+        uint64_t storedBytes = 0;
+        // Bytes kept for the next save.
+        uint64_t cachedBytes = 0;
+        // Hashing and (de)compression, and stream access.
+        android::base::System::WallDuration processUs = 0;
+        android::base::System::WallDuration streamUs = 0;
+    };
+
+    static constexpr size_t kChunkBytes = 1024 * 1024;
+    // Default bound of the stored chunk bytes kept after a save or load.
+    static constexpr uint64_t kMaxCachedBytes = 64 * 1024 * 1024;
+    // Update when changing the stream format; load() rejects any other.
+    static constexpr uint32_t kVersion = 2;
+
+    explicit VkMemorySnapshot(uint64_t maxCachedBytes = kMaxCachedBytes)
+        : mMaxCachedBytes(maxCachedBytes) {}
+
+    void save(android::base::Stream* stream, const std::vector<Region>& regions);
+    // Fills |regions| with what was saved for their handles; saved memory
+    // without a region of the same size is skipped. Returns false if the
+    // stream has another version or a chunk doesn't decompress.
+    bool load(android::base::Stream* stream, const std::vector<Region>& regions);
+
+    // Drops the chunks kept from the previous snapshot.
+    void clear();
+
+    const Stats& lastStats() const { return mStats; }
+
+private:
+    struct Chunk {
+        std::array<uint64_t, 2> hash = {};
+        // Compressed contents, or the raw ones if they don't compress.
+        std::shared_ptr<const std::vector<uint8_t>> stored;
+    };
+
+    using ChunkMap = std::unordered_map<uint64_t, std::vector<Chunk>>;
+
+    void keepChunks(ChunkMap&& chunks);
+
+    const uint64_t mMaxCachedBytes;
+    ChunkMap mChunks;
+    Stats mStats;
+};
+
+}  // namespace goldfish_vk
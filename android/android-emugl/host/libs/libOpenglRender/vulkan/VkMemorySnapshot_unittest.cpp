@@ -0,0 +1,240 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "VkMemorySnapshot.h"
+
+#include "android/base/files/MemStream.h"
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+namespace goldfish_vk {
+namespace {
+
+using Region = VkMemorySnapshot::Region;
+constexpr size_t kChunkBytes = VkMemorySnapshot::kChunkBytes;
+
+// Memory with compressible and random parts, like vertex and texture data.
+std::vector<uint8_t> makeMemory(size_t size, int seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> memory(size);
+    for (size_t i = 0; i < size; ++i) {
+        memory[i] = ((i / 4096) % 2) ? (uint8_t)rng() : (uint8_t)(i / 64);
+    }
+    return memory;
+}
+
+std::vector<Region> regionsFor(std::vector<std::vector<uint8_t>>& memories) {
+    std::vector<Region> regions;
+    for (size_t i = 0; i < memories.size(); ++i) {
+        regions.push_back(
+                {0x1000 + i, memories[i].data(), memories[i].size()});
+    }
+    return regions;
+}
+
+// Sizes below, at and above the chunk size, some with partial chunks.
+const size_t kSizes[] = {1, 4096, kChunkBytes, 3 * kChunkBytes + 12345,
+                         8 * kChunkBytes};
+
+}  // namespace
+
+TEST(VkMemorySnapshot, SaveLoad) {
+    std::vector<std::vector<uint8_t>> memories;
+    for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); ++i) {
+        memories.push_back(makeMemory(kSizes[i], i));
+    }
+
+    android::base::MemStream stream;
+    VkMemorySnapshot saver;
+    saver.save(&stream, regionsFor(memories));
+
+    const auto& saveStats = saver.lastStats();
+    size_t totalBytes = 0;
+    for (size_t size : kSizes) totalBytes += size;
+    EXPECT_EQ(totalBytes, saveStats.totalBytes);
+    EXPECT_EQ(0u, saveStats.unchangedBytes);
+    EXPECT_EQ(0u, saveStats.referencedBytes);
+    EXPECT_LT(saveStats.storedBytes, totalBytes);
+
+    std::vector<std::vector<uint8_t>> loaded;
+    for (size_t size : kSizes) {
+        loaded.emplace_back(size, 0xee);
+    }
+    VkMemorySnapshot loader;
+    EXPECT_TRUE(loader.load(&stream, regionsFor(loaded)));
+    EXPECT_EQ(memories, loaded);
+    EXPECT_EQ(totalBytes, loader.lastStats().totalBytes);
+    EXPECT_EQ(saveStats.storedBytes, loader.lastStats().storedBytes);
+}
+
+TEST(VkMemorySnapshot, UnchangedChunksReused) {
+    std::vector<std::vector<uint8_t>> memories = {
+            makeMemory(4 * kChunkBytes, 1), makeMemory(kChunkBytes / 2, 2)};
+    VkMemorySnapshot snapshot;
+
+    android::base::MemStream first;
+    snapshot.save(&first, regionsFor(memories));
+
+    // Touch a byte of the second chunk.
+    memories[0][kChunkBytes + 100] ^= 0xff;
+    android::base::MemStream second;
+    snapshot.save(&second, regionsFor(memories));
+    EXPECT_EQ(3 * kChunkBytes + kChunkBytes / 2,
+              snapshot.lastStats().unchangedBytes);
+
+    std::vector<std::vector<uint8_t>> loaded = {
+            std::vector<uint8_t>(4 * kChunkBytes),
+            std::vector<uint8_t>(kChunkBytes / 2)};
+    VkMemorySnapshot loader;
+    EXPECT_TRUE(loader.load(&second, regionsFor(loaded)));
+    EXPECT_EQ(memories, loaded);
+
+    // A save following a load reuses what was loaded.
+    android::base::MemStream third;
+    loader.save(&third, regionsFor(loaded));
+    EXPECT_EQ(loader.lastStats().totalBytes, loader.lastStats().unchangedBytes);
+
+    // Unless told to forget it.
+    loader.clear();
+    android::base::MemStream fourth;
+    loader.save(&fourth, regionsFor(loaded));
+    EXPECT_EQ(0u, loader.lastStats().unchangedBytes);
+}
+
+TEST(VkMemorySnapshot, CacheIsBounded) {
+    // Random, so every chunk is stored as is.
+    std::mt19937 rng(3);
+    std::vector<std::vector<uint8_t>> memories(
+            1, std::vector<uint8_t>(4 * kChunkBytes));
+    for (auto& byte : memories[0]) {
+        byte = (uint8_t)rng();
+    }
+    VkMemorySnapshot snapshot(2 * kChunkBytes);
+
+    android::base::MemStream first;
+    snapshot.save(&first, regionsFor(memories));
+    EXPECT_EQ(2 * kChunkBytes, snapshot.lastStats().cachedBytes);
+
+    // Only the cached chunks are reused.
+    android::base::MemStream second;
+    snapshot.save(&second, regionsFor(memories));
+    EXPECT_EQ(2 * kChunkBytes, snapshot.lastStats().unchangedBytes);
+    EXPECT_EQ(first.buffer(), second.buffer());
+    EXPECT_EQ(2 * kChunkBytes, snapshot.lastStats().cachedBytes);
+
+    VkMemorySnapshot loader(0);
+    std::vector<std::vector<uint8_t>> loaded(
+            1, std::vector<uint8_t>(4 * kChunkBytes));
+    EXPECT_TRUE(loader.load(&second, regionsFor(loaded)));
+    EXPECT_EQ(memories, loaded);
+    EXPECT_EQ(0u, loader.lastStats().cachedBytes);
+}
+
+TEST(VkMemorySnapshot, SkipsMissingAndResizedMemory) {
+    std::vector<std::vector<uint8_t>> memories = {
+            makeMemory(2 * kChunkBytes, 1), makeMemory(1000, 2),
+            makeMemory(kChunkBytes + 1, 3)};
+    android::base::MemStream stream;
+    VkMemorySnapshot saver;
+    saver.save(&stream, regionsFor(memories));
+
+    // The first memory is gone, the second has another size.
+    std::vector<uint8_t> resized(999, 0xee);
+    std::vector<uint8_t> last(kChunkBytes + 1, 0xee);
+    const std::vector<Region> regions = {
+            {0x1001, resized.data(), resized.size()},
+            {0x1002, last.data(), last.size()},
+    };
+    VkMemorySnapshot loader;
+    EXPECT_TRUE(loader.load(&stream, regions));
+
+    EXPECT_EQ(std::vector<uint8_t>(999, 0xee), resized);
+    EXPECT_EQ(memories[2], last);
+    // The whole section was consumed.
+    EXPECT_EQ(0, stream.readSize());
+}
+
+TEST(VkMemorySnapshot, DuplicateChunksReferenced) {
+    // Zeroed memory, as freshly allocated, and a copy of a memory that isn't
+    // restored.
+    std::vector<std::vector<uint8_t>> memories = {
+            makeMemory(2 * kChunkBytes, 1),
+            std::vector<uint8_t>(3 * kChunkBytes),
+            makeMemory(2 * kChunkBytes, 1)};
+    android::base::MemStream stream;
+    VkMemorySnapshot saver;
+    saver.save(&stream, regionsFor(memories));
+    EXPECT_EQ(4 * kChunkBytes, saver.lastStats().referencedBytes);
+
+    std::vector<uint8_t> zeroes(3 * kChunkBytes, 0xee);
+    std::vector<uint8_t> copy(2 * kChunkBytes, 0xee);
+    const std::vector<Region> regions = {
+            {0x1001, zeroes.data(), zeroes.size()},
+            {0x1002, copy.data(), copy.size()},
+    };
+    VkMemorySnapshot loader;
+    EXPECT_TRUE(loader.load(&stream, regions));
+    EXPECT_EQ(memories[1], zeroes);
+    EXPECT_EQ(memories[2], copy);
+    EXPECT_EQ(saver.lastStats().storedBytes, loader.lastStats().storedBytes);
+    EXPECT_EQ(0, stream.readSize());
+}
+
+TEST(VkMemorySnapshot, RejectsOtherVersion) {
+    std::vector<uint8_t> memory(4096, 0xee);
+    android::base::MemStream stream;
+    stream.putBe32(VkMemorySnapshot::kVersion - 1);
+    stream.putBe32(1);
+    stream.putBe64(0x1000);
+    stream.putBe64(memory.size());
+    stream.putBe32(4096);
+    stream.write(std::vector<uint8_t>(4096).data(), 4096);
+
+    VkMemorySnapshot loader;
+    EXPECT_FALSE(loader.load(&stream, {{0x1000, memory.data(), memory.size()}}));
+    EXPECT_EQ(std::vector<uint8_t>(4096, 0xee), memory);
+}
+
+// Save and load times of 256MB of device memory, from scratch and when
+// unchanged.
+TEST(VkMemorySnapshot, DISABLED_Benchmark) {
+    std::vector<std::vector<uint8_t>> memories;
+    for (int i = 0; i < 16; ++i) {
+        memories.push_back(makeMemory(16 * 1024 * 1024, i));
+    }
+    VkMemorySnapshot snapshot;
+    for (const char* name : {"first save", "unchanged save"}) {
+        android::base::MemStream stream;
+        snapshot.save(&stream, regionsFor(memories));
+        const auto& stats = snapshot.lastStats();
+        printf("%s: %.1f ms processing, %.1f ms writing, %llu of %llu bytes "
+               "stored\n",
+               name, stats.processUs / 1000.0, stats.streamUs / 1000.0,
+               (unsigned long long)stats.storedBytes,
+               (unsigned long long)stats.totalBytes);
+    }
+
+    android::base::MemStream stream;
+    snapshot.save(&stream, regionsFor(memories));
+    VkMemorySnapshot loader;
+    EXPECT_TRUE(loader.load(&stream, regionsFor(memories)));
+    printf("load: %.1f ms processing, %.1f ms reading\n",
+           loader.lastStats().processUs / 1000.0,
+           loader.lastStats().streamUs / 1000.0);
+}
+
+}  // namespace goldfish_vk
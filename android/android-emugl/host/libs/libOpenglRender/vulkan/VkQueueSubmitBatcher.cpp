@@ -0,0 +1,195 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "VkQueueSubmitBatcher.h"
+
+#include <algorithm>
+
+#include <stdio.h>
+
+using android::base::AutoLock;
+using android::base::System;
+
+namespace goldfish_vk {
+
+VkQueueSubmitBatcher::VkQueueSubmitBatcher(SubmitFunc submitFunc,
+                                           System::Duration windowUs)
+    : mSubmitFunc(std::move(submitFunc)),
+      mWindowUs(windowUs),
+      mThread([this] { threadLoop(); }) {
+    if (!mWindowUs) return;
+
+    mBatches.resize(kMaxBatches);
+    mSubmitInfos.reserve(kMaxBatches);
+    mThread.start();
+}
+
+VkQueueSubmitBatcher::~VkQueueSubmitBatcher() {
+    if (!mWindowUs) return;
+
+    {
+        AutoLock lock(mLock);
+        mExiting = true;
+        mCv.signal();
+    }
+    mThread.wait();
+
+    AutoLock lock(mLock);
+    sendPendingLocked(VK_NULL_HANDLE);
+}
+
+VkResult VkQueueSubmitBatcher::submit(uint32_t submitCount,
+                                      const VkSubmitInfo* pSubmits,
+                                      VkFence fence) {
+    AutoLock lock(mLock);
+
+    ++mStats.submits;
+    mStats.batches += submitCount;
+
+    if (!mWindowUs) {
+        return hostSubmitLocked(submitCount, pSubmits, fence);
+    }
+
+    if (mLost) {
+        if (fence != VK_NULL_HANDLE) {
+            hostSubmitLocked(0, nullptr, fence);
+        }
+        return VK_ERROR_DEVICE_LOST;
+    }
+
+    for (uint32_t i = 0; i < submitCount; ++i) {
+        // Extension structs aren't copied, send those as they are.
+        if (pSubmits[i].pNext) {
+            VkResult result = sendPendingLocked(VK_NULL_HANDLE);
+            if (result != VK_SUCCESS) return result;
+            return hostSubmitLocked(submitCount, pSubmits, fence);
+        }
+    }
+
+    for (uint32_t i = 0; i < submitCount; ++i) {
+        if (mPendingCount == kMaxBatches) {
+            VkResult result = sendPendingLocked(VK_NULL_HANDLE);
+            if (result != VK_SUCCESS) return result;
+        }
+
+        const VkSubmitInfo& submitInfo = pSubmits[i];
+        Batch& batch = mBatches[mPendingCount++];
+        batch.waitSemaphores.assign(
+                submitInfo.pWaitSemaphores,
+                submitInfo.pWaitSemaphores + submitInfo.waitSemaphoreCount);
+        batch.waitDstStageMasks.assign(
+                submitInfo.pWaitDstStageMask,
+                submitInfo.pWaitDstStageMask + submitInfo.waitSemaphoreCount);
+        batch.commandBuffers.assign(
+                submitInfo.pCommandBuffers,
+                submitInfo.pCommandBuffers + submitInfo.commandBufferCount);
+        batch.signalSemaphores.assign(
+                submitInfo.pSignalSemaphores,
+                submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+
+        if (mPendingCount == 1) {
+            mFirstPendingUs = System::get()->getUnixTimeUs();
+            mCv.signal();
+        }
+    }
+
+    if (fence != VK_NULL_HANDLE) {
+        return sendPendingLocked(fence);
+    }
+
+    mAcknowledgedCount = mPendingCount;
+    return VK_SUCCESS;
+}
+
+VkResult VkQueueSubmitBatcher::flush() {
+    AutoLock lock(mLock);
+    return sendPendingLocked(VK_NULL_HANDLE);
+}
+
+VkResult VkQueueSubmitBatcher::flushAndRun(const std::function<VkResult()>& func) {
+    AutoLock lock(mLock);
+    VkResult result = sendPendingLocked(VK_NULL_HANDLE);
+    if (result != VK_SUCCESS) return result;
+    return func();
+}
+
+VkQueueSubmitBatcher::Stats VkQueueSubmitBatcher::getStats() const {
+    AutoLock lock(mLock);
+    return mStats;
+}
+
+VkResult VkQueueSubmitBatcher::hostSubmitLocked(uint32_t submitCount,
+                                                const VkSubmitInfo* pSubmits,
+                                                VkFence fence) {
+    ++mStats.hostSubmits;
+    mStats.maxBatchesPerHostSubmit =
+            std::max(mStats.maxBatchesPerHostSubmit, submitCount);
+    return mSubmitFunc(submitCount, pSubmits, fence);
+}
+
+VkResult VkQueueSubmitBatcher::sendPendingLocked(VkFence fence) {
+    if (mLost) return VK_ERROR_DEVICE_LOST;
+    if (!mPendingCount && fence == VK_NULL_HANDLE) return VK_SUCCESS;
+
+    mSubmitInfos.clear();
+    for (uint32_t i = 0; i < mPendingCount; ++i) {
+        const Batch& batch = mBatches[i];
+        VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
+            (uint32_t)batch.waitSemaphores.size(),
+            batch.waitSemaphores.data(),
+            batch.waitDstStageMasks.data(),
+            (uint32_t)batch.commandBuffers.size(),
+            batch.commandBuffers.data(),
+            (uint32_t)batch.signalSemaphores.size(),
+            batch.signalSemaphores.data(),
+        };
+        mSubmitInfos.push_back(submitInfo);
+    }
+
+    const bool acknowledged = mAcknowledgedCount > 0;
+    mPendingCount = 0;
+    mAcknowledgedCount = 0;
+
+    VkResult result = hostSubmitLocked((uint32_t)mSubmitInfos.size(),
+                                       mSubmitInfos.data(), fence);
+    if (result != VK_SUCCESS && acknowledged) {
+        fprintf(stderr,
+                "%s: host submit failed with %d after the guest was told it "
+                "succeeded, the queue is lost\n", __func__, result);
+        mLost = true;
+        return VK_ERROR_DEVICE_LOST;
+    }
+    return result;
+}
+
+void VkQueueSubmitBatcher::threadLoop() {
+    AutoLock lock(mLock);
+    while (!mExiting) {
+        if (!mPendingCount) {
+            mCv.wait(&mLock);
+            continue;
+        }
+
+        const System::Duration deadlineUs = mFirstPendingUs + mWindowUs;
+        if (System::get()->getUnixTimeUs() < deadlineUs) {
+            mCv.timedWait(&mLock, deadlineUs);
+            continue;
+        }
+
+        // A failure is kept in |mLost| for the next calls.
+        sendPendingLocked(VK_NULL_HANDLE);
+    }
+}
+
+}  // namespace goldfish_vk
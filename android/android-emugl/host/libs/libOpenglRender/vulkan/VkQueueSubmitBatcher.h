@@ -0,0 +1,117 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "android/base/synchronization/ConditionVariable.h"
+#include "android/base/synchronization/Lock.h"
+#include "android/base/system/System.h"
+#include "android/base/threads/FunctorThread.h"
+
+#include <functional>
+#include <vector>
+
+namespace goldfish_vk {
+
+// Merges the vkQueueSubmit calls guests make to one host queue within a
+// short window into a single host call, for guests that submit many small
+// command buffers.
+//
+// Each guest VkSubmitInfo is kept as a batch of its own and in order, so
+// semaphore waits and signals are unchanged. A call can take one fence
+// only, and a fence also covers everything submitted earlier to the queue,
+// so submits with a fence are sent right away along with what is pending.
+// Fenceless submits are sent once the window after the first of them
+// passes, or earlier through flush().
+//
+// With a window of 0, submits are sent as they come; the batcher then only
+// serializes the use of the queue.
+//
+// If a host call fails after the guest was told its submits succeeded, the
+// guest can't know what did not run. The queue is then lost to it: every
+// later call returns VK_ERROR_DEVICE_LOST, and a fence is still sent alone
+// so that waits on it end.
+class VkQueueSubmitBatcher {
+public:
+    using SubmitFunc = std::function<VkResult(
+            uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence)>;
+
+    struct Stats {
+        // vkQueueSubmit calls received, and the batches in them.
+        uint64_t submits = 0;
+        uint64_t batches = 0;
+        // Calls made to |submitFunc|.
+        uint64_t hostSubmits = 0;
+        // Most batches sent in one host call.
+        uint32_t maxBatchesPerHostSubmit = 0;
+    };
+
+    // Sends at most this many batches in one host call.
+    static constexpr uint32_t kMaxBatches = 64;
+
+    VkQueueSubmitBatcher(SubmitFunc submitFunc,
+                         android::base::System::Duration windowUs);
+    // Sends what is pending.
+    ~VkQueueSubmitBatcher();
+
+    VkResult submit(uint32_t submitCount, const VkSubmitInfo* pSubmits,
+                    VkFence fence);
+
+    // Sends what is pending; call before waiting for the queue or depending
+    // on the submits otherwise.
+    VkResult flush();
+    // Sends what is pending, then runs |func| while nothing else can be
+    // submitted to the queue.
+    VkResult flushAndRun(const std::function<VkResult()>& func);
+
+    Stats getStats() const;
+
+private:
+    struct Batch {
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitDstStageMasks;
+        std::vector<VkCommandBuffer> commandBuffers;
+        std::vector<VkSemaphore> signalSemaphores;
+    };
+
+    VkResult hostSubmitLocked(uint32_t submitCount,
+                              const VkSubmitInfo* pSubmits,
+                              VkFence fence);
+    VkResult sendPendingLocked(VkFence fence);
+    void threadLoop();
+
+    const SubmitFunc mSubmitFunc;
+    const android::base::System::Duration mWindowUs;
+
+    mutable android::base::Lock mLock;
+    android::base::ConditionVariable mCv;
+
+    // The first |mPendingCount| are pending; the others keep their
+    // capacity for later submits.
+    std::vector<Batch> mBatches;
+    uint32_t mPendingCount = 0;
+    // Pending batches of submit() calls that have returned.
+    uint32_t mAcknowledgedCount = 0;
+    std::vector<VkSubmitInfo> mSubmitInfos;
+    android::base::System::Duration mFirstPendingUs = 0;
+    bool mLost = false;
+    bool mExiting = false;
+    Stats mStats;
+
+    // Only started with a window.
+    android::base::FunctorThread mThread;
+};
+
+}  // namespace goldfish_vk
@@ -0,0 +1,352 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "VkQueueSubmitBatcher.h"
+
+#include "android/base/synchronization/Lock.h"
+#include "android/base/system/System.h"
+
+#include <gtest/gtest.h>
+#include <vector>
+
+using android::base::AutoLock;
+using android::base::Lock;
+using android::base::System;
+
+namespace goldfish_vk {
+namespace {
+
+template <class T>
+T fakeHandle(uint64_t value) {
+    return (T)(uintptr_t)value;
+}
+
+// What a submit info referred to, and the fence of its host submit.
+struct RecordedBatch {
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<VkPipelineStageFlags> waitDstStageMasks;
+    std::vector<VkCommandBuffer> commandBuffers;
+    std::vector<VkSemaphore> signalSemaphores;
+    const void* pNext;
+
+    bool operator==(const RecordedBatch& other) const {
+        return waitSemaphores == other.waitSemaphores &&
+               waitDstStageMasks == other.waitDstStageMasks &&
+               commandBuffers == other.commandBuffers &&
+               signalSemaphores == other.signalSemaphores &&
+               pNext == other.pNext;
+    }
+};
+
+struct HostSubmit {
+    std::vector<RecordedBatch> batches;
+    VkFence fence;
+};
+
+class FakeQueue {
+public:
+    VkQueueSubmitBatcher::SubmitFunc submitFunc() {
+        return [this](uint32_t submitCount, const VkSubmitInfo* pSubmits,
+                      VkFence fence) {
+            AutoLock lock(mLock);
+            HostSubmit submit = {{}, fence};
+            for (uint32_t i = 0; i < submitCount; ++i) {
+                submit.batches.push_back(record(pSubmits[i]));
+            }
+            mSubmits.push_back(submit);
+            return mResult;
+        };
+    }
+
+    static RecordedBatch record(const VkSubmitInfo& info) {
+        return {
+            {info.pWaitSemaphores,
+             info.pWaitSemaphores + info.waitSemaphoreCount},
+            {info.pWaitDstStageMask,
+             info.pWaitDstStageMask + info.waitSemaphoreCount},
+            {info.pCommandBuffers,
+             info.pCommandBuffers + info.commandBufferCount},
+            {info.pSignalSemaphores,
+             info.pSignalSemaphores + info.signalSemaphoreCount},
+            info.pNext,
+        };
+    }
+
+    std::vector<HostSubmit> submits() {
+        AutoLock lock(mLock);
+        return mSubmits;
+    }
+
+    void setResult(VkResult result) {
+        AutoLock lock(mLock);
+        mResult = result;
+    }
+
+private:
+    Lock mLock;
+    std::vector<HostSubmit> mSubmits;
+    VkResult mResult = VK_SUCCESS;
+};
+
+// Long enough that only flushes and fences send submits.
+constexpr System::Duration kLongWindowUs = 60 * 1000 * 1000;
+
+// A submit info waiting on semaphore |i|, running command buffer |i| and
+// signaling semaphore |i + 1|.
+struct TestSubmit {
+    explicit TestSubmit(uint64_t i)
+        : wait(fakeHandle<VkSemaphore>(0x100 + i)),
+          commandBuffer(fakeHandle<VkCommandBuffer>(0x200 + i)),
+          signal(fakeHandle<VkSemaphore>(0x100 + i + 1)),
+          info{VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr, 1, &wait, &stage,
+               1, &commandBuffer, 1, &signal} {}
+
+    VkSemaphore wait;
+    VkPipelineStageFlags stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkCommandBuffer commandBuffer;
+    VkSemaphore signal;
+    VkSubmitInfo info;
+};
+
+}  // namespace
+
+TEST(VkQueueSubmitBatcher, FlushSendsPendingInOrder) {
+    FakeQueue queue;
+    VkQueueSubmitBatcher batcher(queue.submitFunc(), kLongWindowUs);
+
+    std::vector<RecordedBatch> expected;
+    for (uint64_t i = 0; i < 3; ++i) {
+        // Sent data is copied; the guest's is gone after the call.
+        TestSubmit submit(i);
+        expected.push_back(FakeQueue::record(submit.info));
+        EXPECT_EQ(VK_SUCCESS,
+                  batcher.submit(1, &submit.info, VK_NULL_HANDLE));
+    }
+    EXPECT_TRUE(queue.submits().empty());
+
+    EXPECT_EQ(VK_SUCCESS, batcher.flush());
+    auto submits = queue.submits();
+    ASSERT_EQ(1u, submits.size());
+    EXPECT_EQ(expected, submits[0].batches);
+    EXPECT_EQ(VK_NULL_HANDLE, submits[0].fence);
+
+    // Nothing to send.
+    EXPECT_EQ(VK_SUCCESS, batcher.flush());
+    EXPECT_EQ(1u, queue.submits().size());
+
+    const auto stats = batcher.getStats();
+    EXPECT_EQ(3u, stats.submits);
+    EXPECT_EQ(3u, stats.batches);
+    EXPECT_EQ(1u, stats.hostSubmits);
+    EXPECT_EQ(3u, stats.maxBatchesPerHostSubmit);
+}
+
+TEST(VkQueueSubmitBatcher, FenceSendsPending) {
+    FakeQueue queue;
+    VkQueueSubmitBatcher batcher(queue.submitFunc(), kLongWindowUs);
+    const VkFence fence = fakeHandle<VkFence>(0x300);
+
+    TestSubmit first(0);
+    TestSubmit second(1);
+    EXPECT_EQ(VK_SUCCESS, batcher.submit(1, &first.info, VK_NULL_HANDLE));
+    EXPECT_EQ(VK_SUCCESS, batcher.submit(1, &second.info, fence));
+
+    auto submits = queue.submits();
+    ASSERT_EQ(1u, submits.size());
+    EXPECT_EQ(2u, submits[0].batches.size());
+    EXPECT_EQ(fence, submits[0].fence);
+
+    // A fence alone still signals after what came before.
+    EXPECT_EQ(VK_SUCCESS, batcher.submit(1, &first.info, VK_NULL_HANDLE));
+    EXPECT_EQ(VK_SUCCESS, batcher.submit(0, nullptr, fence));
+    submits = queue.submits();
+    ASSERT_EQ(2u, submits.size());
+    EXPECT_EQ(1u, submits[1].batches.size());
+    EXPECT_EQ(fence, submits[1].fence);
+}
+
+TEST(VkQueueSubmitBatcher, WindowSendsPending) {
+    FakeQueue queue;
+    VkQueueSubmitBatcher batcher(queue.submitFunc(), 1000 /* 1 ms */);
+
+    TestSubmit submit(0);
+    EXPECT_EQ(VK_SUCCESS, batcher.submit(1, &submit.info, VK_NULL_HANDLE));
+    EXPECT_EQ(VK_SUCCESS, batcher.submit(1, &submit.info, VK_NULL_HANDLE));
+
+    const auto deadlineUs = System::get()->getUnixTimeUs() + 5000000;
+    while (queue.submits().empty() &&
+           System::get()->getUnixTimeUs() < deadlineUs) {
+        System::get()->sleepMs(1);
+    }
+
+    auto submits = queue.submits();
+    ASSERT_EQ(1u, submits.size());
+    EXPECT_EQ(2u, submits[0].batches.size());
+}
+
+TEST(VkQueueSubmitBatcher, ExtensionStructsSentAsIs) {
+    FakeQueue queue;
+    VkQueueSubmitBatcher batcher(queue.submitFunc(), kLongWindowUs);
+
+    TestSubmit plain(0);
+    TestSubmit extended(1);
+    VkProtectedSubmitInfo protectedInfo = {
+        VK_STRUCTURE_TYPE_PROTECTED_SUBMIT_INFO, nullptr, VK_FALSE,
+    };
+    extended.info.pNext = &protectedInfo;
+
+    EXPECT_EQ(VK_SUCCESS, batcher.submit(1, &plain.info, VK_NULL_HANDLE));
+    EXPECT_EQ(VK_SUCCESS, batcher.submit(1, &extended.info, VK_NULL_HANDLE));
+
+    auto submits = queue.submits();
+    ASSERT_EQ(2u, submits.size());
+    EXPECT_EQ(FakeQueue::record(plain.info), submits[0].batches[0]);
+    EXPECT_EQ(FakeQueue::record(extended.info), submits[1].batches[0]);
+}
+
+TEST(VkQueueSubmitBatcher, BoundedBatchesPerSubmit) {
+    FakeQueue queue;
+    VkQueueSubmitBatcher batcher(queue.submitFunc(), kLongWindowUs);
+
+    const uint32_t maxBatches = VkQueueSubmitBatcher::kMaxBatches;
+    std::vector<VkSubmitInfo> infos;
+    std::vector<TestSubmit> submits;
+    submits.reserve(maxBatches + 1);
+    for (uint32_t i = 0; i < maxBatches + 1; ++i) {
+        submits.emplace_back(i);
+        infos.push_back(submits.back().info);
+    }
+
+    EXPECT_EQ(VK_SUCCESS,
+              batcher.submit(infos.size(), infos.data(), VK_NULL_HANDLE));
+    ASSERT_EQ(1u, queue.submits().size());
+    EXPECT_EQ(maxBatches, queue.submits()[0].batches.size());
+
+    EXPECT_EQ(VK_SUCCESS, batcher.flush());
+    ASSERT_EQ(2u, queue.submits().size());
+    EXPECT_EQ(FakeQueue::record(infos.back()),
+              queue.submits()[1].batches[0]);
+}
+
+TEST(VkQueueSubmitBatcher, ErrorsReachTheGuest) {
+    FakeQueue queue;
+    VkQueueSubmitBatcher batcher(queue.submitFunc(), kLongWindowUs);
+    const VkFence fence = fakeHandle<VkFence>(0x300);
+    TestSubmit submit(0);
+
+    // Nothing sent was acknowledged, so the error is the guest's to handle.
+    queue.setResult(VK_ERROR_OUT_OF_HOST_MEMORY);
+    EXPECT_EQ(VK_ERROR_OUT_OF_HOST_MEMORY,
+              batcher.submit(1, &submit.info, fence));
+    queue.setResult(VK_SUCCESS);
+    EXPECT_EQ(VK_SUCCESS, batcher.submit(1, &submit.info, fence));
+    EXPECT_EQ(VK_SUCCESS, batcher.flush());
+}
+
+TEST(VkQueueSubmitBatcher, AcknowledgedSubmitFailureLosesQueue) {
+    FakeQueue queue;
+    VkQueueSubmitBatcher batcher(queue.submitFunc(), kLongWindowUs);
+    const VkFence fence = fakeHandle<VkFence>(0x300);
+    TestSubmit submit(0);
+
+    queue.setResult(VK_ERROR_OUT_OF_DEVICE_MEMORY);
+    EXPECT_EQ(VK_SUCCESS, batcher.submit(1, &submit.info, VK_NULL_HANDLE));
+    EXPECT_EQ(VK_ERROR_DEVICE_LOST, batcher.flush());
+    queue.setResult(VK_SUCCESS);
+
+    // Every later call says so, and nothing more is sent but fences.
+    EXPECT_EQ(VK_ERROR_DEVICE_LOST, batcher.flush());
+    EXPECT_EQ(VK_ERROR_DEVICE_LOST,
+              batcher.submit(1, &submit.info, VK_NULL_HANDLE));
+    EXPECT_EQ(VK_ERROR_DEVICE_LOST, batcher.submit(1, &submit.info, fence));
+    bool ran = false;
+    EXPECT_EQ(VK_ERROR_DEVICE_LOST, batcher.flushAndRun([&ran] {
+        ran = true;
+        return VK_SUCCESS;
+    }));
+    EXPECT_FALSE(ran);
+
+    auto submits = queue.submits();
+    ASSERT_EQ(2u, submits.size());
+    EXPECT_TRUE(submits[1].batches.empty());
+    EXPECT_EQ(fence, submits[1].fence);
+}
+
+TEST(VkQueueSubmitBatcher, WindowSendFailureReachesSyncPoints) {
+    FakeQueue queue;
+    VkQueueSubmitBatcher batcher(queue.submitFunc(), 1000 /* 1 ms */);
+    TestSubmit submit(0);
+
+    queue.setResult(VK_ERROR_DEVICE_LOST);
+    EXPECT_EQ(VK_SUCCESS, batcher.submit(1, &submit.info, VK_NULL_HANDLE));
+
+    const auto deadlineUs = System::get()->getUnixTimeUs() + 5000000;
+    while (queue.submits().empty() &&
+           System::get()->getUnixTimeUs() < deadlineUs) {
+        System::get()->sleepMs(1);
+    }
+    ASSERT_EQ(1u, queue.submits().size());
+    queue.setResult(VK_SUCCESS);
+
+    // Not only the next call: a queue wait after any number of them.
+    EXPECT_EQ(VK_ERROR_DEVICE_LOST, batcher.flush());
+    EXPECT_EQ(VK_ERROR_DEVICE_LOST,
+              batcher.flushAndRun([] { return VK_SUCCESS; }));
+}
+
+TEST(VkQueueSubmitBatcher, FlushAndRun) {
+    FakeQueue queue;
+    VkQueueSubmitBatcher batcher(queue.submitFunc(), kLongWindowUs);
+
+    TestSubmit submit(0);
+    EXPECT_EQ(VK_SUCCESS, batcher.submit(1, &submit.info, VK_NULL_HANDLE));
+
+    size_t sentBeforeRun = 0;
+    EXPECT_EQ(VK_TIMEOUT, batcher.flushAndRun([&queue, &sentBeforeRun] {
+        sentBeforeRun = queue.submits().size();
+        return VK_TIMEOUT;
+    }));
+    EXPECT_EQ(1u, sentBeforeRun);
+}
+
+TEST(VkQueueSubmitBatcher, NoWindowSendsRightAway) {
+    FakeQueue queue;
+    VkQueueSubmitBatcher batcher(queue.submitFunc(), 0);
+
+    TestSubmit first(0);
+    TestSubmit second(1);
+    const VkSubmitInfo infos[] = {first.info, second.info};
+    EXPECT_EQ(VK_SUCCESS, batcher.submit(2, infos, VK_NULL_HANDLE));
+    EXPECT_EQ(VK_SUCCESS, batcher.submit(1, &first.info, VK_NULL_HANDLE));
+
+    auto submits = queue.submits();
+    ASSERT_EQ(2u, submits.size());
+    EXPECT_EQ(2u, submits[0].batches.size());
+    EXPECT_EQ(1u, submits[1].batches.size());
+
+    queue.setResult(VK_ERROR_DEVICE_LOST);
+    EXPECT_EQ(VK_ERROR_DEVICE_LOST,
+              batcher.submit(1, &first.info, VK_NULL_HANDLE));
+}
+
+TEST(VkQueueSubmitBatcher, DestructorSendsPending) {
+    FakeQueue queue;
+    TestSubmit submit(0);
+    {
+        VkQueueSubmitBatcher batcher(queue.submitFunc(), kLongWindowUs);
+        EXPECT_EQ(VK_SUCCESS, batcher.submit(1, &submit.info, VK_NULL_HANDLE));
+    }
+    EXPECT_EQ(1u, queue.submits().size());
+}
+
+}  // namespace goldfish_vk
@@ -18,6 +18,7 @@
 #include "VkDecoder.h"
 #include "IOStream.h"
 
+#include <string.h>
 #include <unordered_map>
 
 #define DEBUG_RECONSTRUCTION 0
@@ -34,6 +35,116 @@
 
 static inline uint64_t ptrToU64(void* ptr) { return (uint64_t)(uintptr_t)ptr; }
 
+// Compact the trace arena once released traces take more than this, and
+// more than the live ones.
+static constexpr size_t kMinTraceCompactionBytes = 1024 * 1024;
+
+static uint64_t hashTrace(const uint8_t* data, size_t bytes) {
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < bytes; ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+VkReconstruction::TraceStore::Id VkReconstruction::TraceStore::add(const uint8_t* data, size_t bytes) {
+    const uint64_t hash = hashTrace(data, bytes);
+
+    auto range = mIdsByHash.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        Trace& trace = mTraces[it->second];
+        if (trace.bytes == bytes &&
+            !memcmp(mArena.data() + trace.offset, data, bytes)) {
+            ++trace.refCount;
+            return it->second;
+        }
+    }
+
+    Id id;
+    if (mFreeIds.empty()) {
+        id = (Id)mTraces.size();
+        mTraces.emplace_back();
+    } else {
+        id = mFreeIds.back();
+        mFreeIds.pop_back();
+    }
+
+    Trace& trace = mTraces[id];
+    trace.hash = hash;
+    trace.offset = mArena.size();
+    trace.bytes = bytes;
+    trace.refCount = 1;
+
+    mArena.insert(mArena.end(), data, data + bytes);
+    mIdsByHash.emplace(hash, id);
+    mLiveBytes += bytes;
+
+    return id;
+}
+
+void VkReconstruction::TraceStore::release(Id id) {
+    if (id == kInvalidId || id >= mTraces.size()) return;
+
+    Trace& trace = mTraces[id];
+    if (!trace.refCount || --trace.refCount) return;
+
+    auto range = mIdsByHash.equal_range(trace.hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == id) {
+            mIdsByHash.erase(it);
+            break;
+        }
+    }
+
+    mLiveBytes -= trace.bytes;
+    trace = Trace();
+    mFreeIds.push_back(id);
+
+    const size_t releasedBytes = mArena.size() - mLiveBytes;
+    if (releasedBytes > kMinTraceCompactionBytes && releasedBytes > mLiveBytes) {
+        compact();
+    }
+}
+
+const uint8_t* VkReconstruction::TraceStore::data(Id id) const {
+    if (id == kInvalidId || id >= mTraces.size()) return nullptr;
+    return mArena.data() + mTraces[id].offset;
+}
+
+size_t VkReconstruction::TraceStore::size(Id id) const {
+    if (id == kInvalidId || id >= mTraces.size()) return 0;
+    return mTraces[id].bytes;
+}
+
+void VkReconstruction::TraceStore::clear() {
+    std::vector<uint8_t>().swap(mArena);
+    std::vector<Trace>().swap(mTraces);
+    std::vector<Id>().swap(mFreeIds);
+    mIdsByHash.clear();
+    mLiveBytes = 0;
+}
+
+void VkReconstruction::TraceStore::compact() {
+    DEBUG_RECON("compact %zu bytes to %zu", mArena.size(), mLiveBytes);
+
+    // Ids stay the same, only the offsets of the live traces change.
+    std::vector<uint8_t> arena;
+    arena.reserve(mLiveBytes);
+
+    for (auto& trace : mTraces) {
+        if (!trace.refCount) continue;
+        const size_t offset = arena.size();
+        arena.insert(arena.end(),
+                     mArena.begin() + trace.offset,
+                     mArena.begin() + trace.offset + trace.bytes);
+        trace.offset = offset;
+    }
+
+    mArena = std::move(arena);
+}
+
 VkReconstruction::VkReconstruction() = default;
 
 std::vector<uint64_t> typeTagSortedHandles(const std::vector<uint64_t>& handles) {
@@ -94,6 +205,8 @@ void VkReconstruction::save(android::base::Stream* stream) {
         for (auto handle : topoOrder) {
             auto item = mHandleReconstructions.get(handle);
 
+            if (!item) continue;
+
             for (auto apiHandle : item->apiRefs) {
 
                 if (uniqApiRefsToTopoOrder.find(apiHandle) == uniqApiRefsToTopoOrder.end()) {
@@ -163,7 +276,7 @@ void VkReconstruction::save(android::base::Stream* stream) {
             uint32_t traceBytesForSnapshot = item->traceBytes + 8;
             memcpy(apiTracePtr, &traceBytesForSnapshot, sizeof(uint32_t)); // and 8 bytes for 'self' struct of { opcode, packetlen } as that is what decoder expects
             apiTracePtr += 4;
-            memcpy(apiTracePtr, item->trace.data(), item->traceBytes);
+            memcpy(apiTracePtr, mTraces.data(item->traceId), item->traceBytes);
             apiTracePtr += item->traceBytes;
         }
     }
@@ -228,7 +341,9 @@ protected:
 void VkReconstruction::load(android::base::Stream* stream) {
     DEBUG_RECON("start. assuming VkDecoderGlobalState has been cleared for loading already");
     mApiTrace.clear();
+    mTraces.clear();
     mHandleReconstructions.clear();
+    mHandleModifications.clear();
 
     std::vector<uint8_t> createdHandleBuffer;
     std::vector<uint8_t> apiTraceBuffer;
@@ -274,8 +389,9 @@ void VkReconstruction::destroyApiInfo(VkReconstruction::ApiHandle h) {
 
     if (!item) return;
 
-    item->traceBytes = 0;
-    item->createdHandles.clear();
+    mTraces.release(item->traceId);
+    // Also frees the created handle list; removal keeps the item around.
+    *item = ApiInfo();
 
     mApiTrace.remove(h);
 }
@@ -285,9 +401,10 @@ VkReconstruction::ApiInfo* VkReconstruction::getApiInfo(VkReconstruction::ApiHan
 }
 
 void VkReconstruction::setApiTrace(VkReconstruction::ApiInfo* apiInfo, uint32_t opCode, const uint8_t* traceBegin, size_t traceBytes) {
-    if (apiInfo->trace.size() < traceBytes) apiInfo->trace.resize(traceBytes);
+    TraceStore::Id traceId = mTraces.add(traceBegin, traceBytes);
+    mTraces.release(apiInfo->traceId);
     apiInfo->opCode = opCode;
-    memcpy(apiInfo->trace.data(), traceBegin, traceBytes);
+    apiInfo->traceId = traceId;
     apiInfo->traceBytes = traceBytes;
 }
 
@@ -307,6 +424,7 @@ void VkReconstruction::dump() {
             auto apiInfo = mApiTrace.get(apiHandle);
             const char* apiName = apiInfo ? goldfish_vk::api_opcode_to_string(apiInfo->opCode) : "unalloced";
             fprintf(stderr, "VkReconstruction::%s:     0x%llx: %s\n", __func__, (unsigned long long)apiHandle, apiName);
+            if (!apiInfo) continue;
             for (auto createdHandle : apiInfo->createdHandles) {
                 fprintf(stderr, "VkReconstruction::%s:         created 0x%llx\n", __func__, (unsigned long long)createdHandle);
             }
@@ -323,6 +441,16 @@ void VkReconstruction::dump() {
     });
 
     fprintf(stderr, "%s: total trace bytes: %zu\n", __func__, traceBytesTotal);
+
+    const MemoryStats stats = getMemoryStats();
+    fprintf(stderr, "%s: %zu handles %zu apis, stored trace bytes: %zu (arena %zu)\n", __func__,
+            stats.total.handles, stats.total.apis,
+            stats.storedTraceBytes, stats.traceArenaBytes);
+    for (const auto& it : stats.perDevice) {
+        fprintf(stderr, "%s: device 0x%llx: %zu handles %zu apis %zu trace bytes\n", __func__,
+                (unsigned long long)it.first, it.second.handles, it.second.apis,
+                it.second.traceBytes);
+    }
 }
 
 void VkReconstruction::addHandles(const uint64_t* toAdd, uint32_t count) {
@@ -345,11 +473,19 @@ void VkReconstruction::removeHandles(const uint64_t* toRemove, uint32_t count) {
 
         if (!item) continue;
 
-        mHandleReconstructions.remove(toRemove[i]);
+        if (item->parentHandle) {
+            auto parent = mHandleReconstructions.get(item->parentHandle);
+            if (parent) parent->childHandles.erase(toRemove[i]);
+        }
 
-        removeHandles(item->childHandles.data(), item->childHandles.size());
+        std::vector<uint64_t> children(
+            item->childHandles.begin(), item->childHandles.end());
 
-        item->childHandles.clear();
+        // Removal keeps the item around, so free what it holds.
+        *item = HandleReconstruction();
+        mHandleReconstructions.remove(toRemove[i]);
+
+        removeHandles(children.data(), children.size());
     }
 }
 
@@ -362,6 +498,9 @@ void VkReconstruction::forEachHandleAddApi(const uint64_t* toProcess, uint32_t c
         if (!item) continue;
 
         item->apiRefs.push_back(apiHandle);
+
+        auto apiInfo = mApiTrace.get(apiHandle);
+        if (apiInfo) ++apiInfo->refCount;
     }
 }
 
@@ -374,20 +513,33 @@ void VkReconstruction::forEachHandleDeleteApi(const uint64_t* toProcess, uint32_
 
         if (!item) continue;
 
-        for (auto handle : item->apiRefs) {
-            destroyApiInfo(handle);
-        }
-
-        item->apiRefs.clear();
+        // APIs creating several handles, such as vkAllocateCommandBuffers,
+        // stay until the last of them is destroyed.
+        releaseApiRefs(&item->apiRefs);
 
         auto modifyItem = mHandleModifications.get(toProcess[i]);
 
         if (!modifyItem) continue;
 
-        modifyItem->apiRefs.clear();
+        releaseApiRefs(&modifyItem->apiRefs);
+        mHandleModifications.remove(toProcess[i]);
     }
 }
 
+void VkReconstruction::releaseApiRefs(std::vector<ApiHandle>* apiRefs) {
+    for (auto apiHandle : *apiRefs) {
+        auto apiInfo = mApiTrace.get(apiHandle);
+
+        if (!apiInfo) continue;
+
+        if (!apiInfo->refCount || !--apiInfo->refCount) {
+            destroyApiInfo(apiHandle);
+        }
+    }
+
+    std::vector<ApiHandle>().swap(*apiRefs);
+}
+
 void VkReconstruction::addHandleDependency(const uint64_t* handles, uint32_t count, uint64_t parentHandle) {
     if (!handles) return;
 
@@ -396,7 +548,10 @@ void VkReconstruction::addHandleDependency(const uint64_t* handles, uint32_t cou
     if (!item) return;
 
     for (uint32_t i = 0; i < count; ++i) {
-        item->childHandles.push_back(handles[i]);
+        item->childHandles.insert(handles[i]);
+
+        auto child = mHandleReconstructions.get(handles[i]);
+        if (child) child->parentHandle = parentHandle;
     }
 }
 
@@ -416,16 +571,78 @@ void VkReconstruction::forEachHandleAddModifyApi(const uint64_t* toProcess, uint
     if (!toProcess) return;
 
     for (uint32_t i = 0; i < count; ++i) {
-        mHandleModifications.add(toProcess[i], HandleModification());
+        HandleModification modification;
+        modification.apiRefs.push_back(apiHandle);
 
-        auto item = mHandleModifications.get(toProcess[i]);
+        auto apiInfo = mApiTrace.get(apiHandle);
+        if (apiInfo) ++apiInfo->refCount;
 
-        if (!item) continue;
+        // The latest modification replaces the previous one.
+        auto item = mHandleModifications.get(toProcess[i]);
+        if (item) releaseApiRefs(&item->apiRefs);
 
-        item->apiRefs.push_back(apiHandle);
+        mHandleModifications.add(toProcess[i], modification);
     }
 }
 
+VkReconstruction::MemoryStats VkReconstruction::getMemoryStats() {
+    MemoryStats stats;
+
+    std::unordered_map<uint64_t, std::unordered_set<ApiHandle>> apisPerDevice;
+    std::unordered_set<ApiHandle> apis;
+
+    auto countApis = [this](const std::vector<ApiHandle>& apiRefs,
+                            std::unordered_set<ApiHandle>* counted,
+                            MemoryUsage* usage) {
+        for (auto apiHandle : apiRefs) {
+            if (!counted->insert(apiHandle).second) continue;
+            auto apiInfo = mApiTrace.get(apiHandle);
+            if (!apiInfo) continue;
+            ++usage->apis;
+            usage->traceBytes += apiInfo->traceBytes;
+        }
+    };
+
+    auto isDevice = [this](const HandleReconstruction& item) {
+        if (item.apiRefs.empty()) return false;
+        auto apiInfo = mApiTrace.get(item.apiRefs[0]);
+        return apiInfo && apiInfo->opCode == OP_vkCreateDevice;
+    };
+
+    mHandleReconstructions.forEachLiveComponent_const(
+        [&](bool live, uint64_t componentHandle, uint64_t entityHandle, const HandleReconstruction& item) {
+        uint64_t device = 0;
+        uint64_t handle = entityHandle;
+        const HandleReconstruction* current = &item;
+        // Devices are at most a few levels up; the bound only guards
+        // against stale parents whose slots were reused.
+        for (int depth = 0; current && depth < 8; ++depth) {
+            if (isDevice(*current)) {
+                device = handle;
+                break;
+            }
+            handle = current->parentHandle;
+            current = handle ? mHandleReconstructions.get_const(handle) : nullptr;
+        }
+
+        MemoryUsage& usage = stats.perDevice[device];
+        ++usage.handles;
+        ++stats.total.handles;
+        countApis(item.apiRefs, &apisPerDevice[device], &usage);
+        countApis(item.apiRefs, &apis, &stats.total);
+    });
+
+    mHandleModifications.forEachLiveComponent_const(
+        [&](bool live, uint64_t componentHandle, uint64_t entityHandle, const HandleModification& mod) {
+        countApis(mod.apiRefs, &apis, &stats.total);
+    });
+
+    stats.storedTraceBytes = mTraces.liveBytes();
+    stats.traceArenaBytes = mTraces.arenaBytes();
+
+    return stats;
+}
+
 std::vector<uint64_t> VkReconstruction::getOrderedUniqueModifyApis() const {
     std::vector<HandleModification> orderedModifies;
 
@@ -21,6 +21,10 @@
 
 #include "common/goldfish_vk_marshaling.h"
 
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 // A class that captures all important data structures for
 // reconstructing a Vulkan system state via trimmed API record and replay.
 class VkReconstruction {
@@ -30,11 +34,55 @@ public:
     void save(android::base::Stream* stream);
     void load(android::base::Stream* stream);
 
+    // Stores the traces of the recorded APIs. Identical traces share one
+    // copy, and all of them are packed in one arena that is compacted once
+    // released traces take most of it.
+    class TraceStore {
+    public:
+        using Id = uint32_t;
+        static constexpr Id kInvalidId = ~0u;
+
+        // Returns the id of a trace with the contents of |data|,
+        // holding a reference to it.
+        Id add(const uint8_t* data, size_t bytes);
+        void release(Id id);
+
+        const uint8_t* data(Id id) const;
+        size_t size(Id id) const;
+
+        void clear();
+
+        // Bytes of the distinct live traces.
+        size_t liveBytes() const { return mLiveBytes; }
+        // Bytes allocated for traces, including released ones not yet
+        // compacted away.
+        size_t arenaBytes() const { return mArena.capacity(); }
+
+    private:
+        struct Trace {
+            uint64_t hash = 0;
+            size_t offset = 0;
+            size_t bytes = 0;
+            uint32_t refCount = 0;
+        };
+
+        void compact();
+
+        std::vector<uint8_t> mArena;
+        std::vector<Trace> mTraces;
+        std::vector<Id> mFreeIds;
+        std::unordered_multimap<uint64_t, Id> mIdsByHash;
+        size_t mLiveBytes = 0;
+    };
+
     struct ApiInfo {
         // Fast
         uint32_t opCode;
-        std::vector<uint8_t> trace;
+        TraceStore::Id traceId = TraceStore::kInvalidId;
         size_t traceBytes = 0;
+        // Handles whose creation or modification refers to this API.
+        // The API is dropped once all of them are destroyed.
+        uint32_t refCount = 0;
         // Book-keeping for which handles were created by this API
         std::vector<uint64_t> createdHandles;
     };
@@ -45,7 +93,8 @@ public:
 
     struct HandleReconstruction {
         std::vector<ApiHandle> apiRefs;
-        std::vector<uint64_t> childHandles;
+        std::unordered_set<uint64_t> childHandles;
+        uint64_t parentHandle = 0;
     };
 
     using HandleReconstructions =
@@ -81,11 +130,35 @@ public:
     void forEachHandleAddModifyApi(const uint64_t* toProcess, uint32_t count, uint64_t apiHandle);
 
     void setModifiedHandlesForApi(uint64_t apiHandle, const uint64_t* modified, uint32_t count);
+
+    // Memory used to reconstruct some of the handles.
+    struct MemoryUsage {
+        size_t handles = 0;
+        size_t apis = 0;
+        // Bytes of the traces of |apis|, as saved in snapshots.
+        size_t traceBytes = 0;
+    };
+
+    struct MemoryStats {
+        MemoryUsage total;
+        // Handles under each VkDevice, keyed by the device handle;
+        // instances and physical devices are under 0.
+        std::unordered_map<uint64_t, MemoryUsage> perDevice;
+        // Bytes of the distinct traces, and allocated for them.
+        size_t storedTraceBytes = 0;
+        size_t traceArenaBytes = 0;
+    };
+
+    MemoryStats getMemoryStats();
+
 private:
 
     std::vector<uint64_t> getOrderedUniqueModifyApis() const;
 
+    void releaseApiRefs(std::vector<ApiHandle>* apiRefs);
+
     ApiTrace mApiTrace;
+    TraceStore mTraces;
 
     HandleReconstructions mHandleReconstructions;
     HandleModifications mHandleModifications;
@@ -0,0 +1,274 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "VkReconstruction.h"
+
+#include "android/base/files/MemStream.h"
+#include "android/base/files/StreamSerializing.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+using ApiHandle = VkReconstruction::ApiHandle;
+using Handles = std::vector<uint64_t>;
+
+// Hands out handles the way the decoder's boxed handle manager does,
+// reusing the indices of destroyed ones.
+using HandleManager = android::base::EntityManager<32, 16, 16, int>;
+
+std::vector<uint8_t> makeTrace(size_t bytes, uint8_t seed) {
+    std::vector<uint8_t> trace(bytes);
+    for (size_t i = 0; i < bytes; ++i) {
+        trace[i] = (uint8_t)(seed + i * 7);
+    }
+    return trace;
+}
+
+class VkReconstructionTest : public ::testing::Test {
+protected:
+    Handles newHandles(uint32_t count) {
+        Handles handles;
+        for (uint32_t i = 0; i < count; ++i) {
+            handles.push_back(mHandleManager.add(0, 1));
+        }
+        return handles;
+    }
+
+    // Records a call creating |count| handles under |parent| the way
+    // VkDecoderSnapshot does.
+    Handles create(uint32_t opCode, const std::vector<uint8_t>& trace,
+                   uint64_t parent = 0, uint32_t count = 1) {
+        Handles created = newHandles(count);
+        mReconstruction.addHandles(created.data(), count);
+        if (parent) {
+            mReconstruction.addHandleDependency(created.data(), count, parent);
+        }
+        auto apiHandle = mReconstruction.createApiInfo();
+        auto apiInfo = mReconstruction.getApiInfo(apiHandle);
+        mReconstruction.setApiTrace(apiInfo, opCode, trace.data(), trace.size());
+        mReconstruction.forEachHandleAddApi(created.data(), count, apiHandle);
+        mReconstruction.setCreatedHandlesForApi(apiHandle, created.data(), count);
+        mLastApi = apiHandle;
+        return created;
+    }
+
+    void modify(uint64_t handle, uint32_t opCode,
+                const std::vector<uint8_t>& trace) {
+        auto apiHandle = mReconstruction.createApiInfo();
+        auto apiInfo = mReconstruction.getApiInfo(apiHandle);
+        mReconstruction.setApiTrace(apiInfo, opCode, trace.data(), trace.size());
+        mReconstruction.forEachHandleAddModifyApi(&handle, 1, apiHandle);
+        mLastApi = apiHandle;
+    }
+
+    void destroy(const Handles& handles) {
+        mReconstruction.removeHandles(handles.data(), handles.size());
+        for (auto handle : handles) {
+            mHandleManager.remove(handle);
+        }
+    }
+
+    // Returns the opcodes of the calls a snapshot would replay.
+    std::vector<uint32_t> savedOpCodes() {
+        android::base::MemStream stream;
+        mReconstruction.save(&stream);
+
+        std::vector<uint8_t> createdHandles;
+        std::vector<uint8_t> apiTrace;
+        android::base::loadBuffer(&stream, &createdHandles);
+        android::base::loadBuffer(&stream, &apiTrace);
+
+        std::vector<uint32_t> opCodes;
+        size_t pos = 0;
+        while (pos + 8 <= apiTrace.size()) {
+            uint32_t opCode;
+            uint32_t packetBytes;
+            memcpy(&opCode, apiTrace.data() + pos, 4);
+            memcpy(&packetBytes, apiTrace.data() + pos + 4, 4);
+            opCodes.push_back(opCode);
+            pos += packetBytes;
+        }
+        EXPECT_EQ(apiTrace.size(), pos);
+        return opCodes;
+    }
+
+    HandleManager mHandleManager;
+    VkReconstruction mReconstruction;
+    ApiHandle mLastApi = 0;
+};
+
+}  // namespace
+
+// vkAllocateCommandBuffers records one call for all the command buffers;
+// it has to be replayed as long as any of them is alive.
+TEST_F(VkReconstructionTest, SharedApiKeptUntilLastHandle) {
+    auto device = create(OP_vkCreateDevice, makeTrace(64, 1));
+    auto pool = create(OP_vkCreateCommandPool, makeTrace(32, 2), device[0]);
+    auto commandBuffers = create(OP_vkAllocateCommandBuffers, makeTrace(48, 3),
+                                 pool[0], 3);
+    const ApiHandle allocateApi = mLastApi;
+
+    destroy({commandBuffers[0], commandBuffers[1]});
+    ASSERT_NE(nullptr, mReconstruction.getApiInfo(allocateApi));
+    EXPECT_EQ((std::vector<uint32_t>{OP_vkCreateDevice, OP_vkCreateCommandPool,
+                                     OP_vkAllocateCommandBuffers}),
+              savedOpCodes());
+
+    destroy({commandBuffers[2]});
+    EXPECT_EQ(nullptr, mReconstruction.getApiInfo(allocateApi));
+    EXPECT_EQ((std::vector<uint32_t>{OP_vkCreateDevice, OP_vkCreateCommandPool}),
+              savedOpCodes());
+}
+
+TEST_F(VkReconstructionTest, DestroyingParentPrunesChildren) {
+    auto device = create(OP_vkCreateDevice, makeTrace(64, 1));
+    auto pool = create(OP_vkCreateCommandPool, makeTrace(32, 2), device[0]);
+    create(OP_vkAllocateCommandBuffers, makeTrace(48, 3), pool[0], 4);
+    auto buffer = create(OP_vkCreateBuffer, makeTrace(40, 4), device[0]);
+
+    destroy(pool);
+    EXPECT_EQ((std::vector<uint32_t>{OP_vkCreateDevice, OP_vkCreateBuffer}),
+              savedOpCodes());
+    auto stats = mReconstruction.getMemoryStats();
+    EXPECT_EQ(2u, stats.total.handles);
+    EXPECT_EQ(2u, stats.total.apis);
+
+    // A child destroyed first is no longer reachable from its parent.
+    destroy(buffer);
+    destroy(device);
+    EXPECT_TRUE(savedOpCodes().empty());
+    stats = mReconstruction.getMemoryStats();
+    EXPECT_EQ(0u, stats.total.handles);
+    EXPECT_EQ(0u, stats.total.apis);
+    EXPECT_EQ(0u, stats.storedTraceBytes);
+}
+
+TEST_F(VkReconstructionTest, ModificationsReplacedAndReleased) {
+    auto device = create(OP_vkCreateDevice, makeTrace(64, 1));
+    auto memory = create(OP_vkAllocateMemory, makeTrace(32, 2), device[0]);
+
+    modify(memory[0], OP_vkMapMemoryIntoAddressSpaceGOOGLE, makeTrace(16, 3));
+    const ApiHandle firstMap = mLastApi;
+    modify(memory[0], OP_vkMapMemoryIntoAddressSpaceGOOGLE, makeTrace(16, 4));
+    const ApiHandle secondMap = mLastApi;
+
+    EXPECT_EQ(nullptr, mReconstruction.getApiInfo(firstMap));
+    ASSERT_NE(nullptr, mReconstruction.getApiInfo(secondMap));
+    EXPECT_EQ((std::vector<uint32_t>{OP_vkCreateDevice, OP_vkAllocateMemory,
+                                     OP_vkMapMemoryIntoAddressSpaceGOOGLE}),
+              savedOpCodes());
+
+    destroy(memory);
+    EXPECT_EQ(nullptr, mReconstruction.getApiInfo(secondMap));
+    EXPECT_EQ((std::vector<uint32_t>{OP_vkCreateDevice}), savedOpCodes());
+}
+
+TEST_F(VkReconstructionTest, IdenticalTracesStoredOnce) {
+    auto device = create(OP_vkCreateDevice, makeTrace(64, 1));
+    const auto samplerTrace = makeTrace(80, 2);
+    Handles samplers;
+    for (int i = 0; i < 100; ++i) {
+        samplers.push_back(create(OP_vkCreateSampler, samplerTrace, device[0])[0]);
+    }
+
+    auto stats = mReconstruction.getMemoryStats();
+    EXPECT_EQ(101u, stats.total.apis);
+    EXPECT_EQ(64u + 100 * 80, stats.total.traceBytes);
+    EXPECT_EQ(64u + 80, stats.storedTraceBytes);
+
+    // The shared copy stays until the last sampler is gone.
+    destroy(Handles(samplers.begin(), samplers.end() - 1));
+    EXPECT_EQ(64u + 80, mReconstruction.getMemoryStats().storedTraceBytes);
+    destroy({samplers.back()});
+    EXPECT_EQ(64u, mReconstruction.getMemoryStats().storedTraceBytes);
+}
+
+TEST_F(VkReconstructionTest, MemoryStatsPerDevice) {
+    auto instance = create(OP_vkCreateInstance, makeTrace(24, 1));
+    auto physicalDevice =
+            create(OP_vkEnumeratePhysicalDevices, makeTrace(16, 2), instance[0]);
+    auto device0 = create(OP_vkCreateDevice, makeTrace(64, 3), physicalDevice[0]);
+    auto device1 = create(OP_vkCreateDevice, makeTrace(64, 4), physicalDevice[0]);
+    auto pool = create(OP_vkCreateCommandPool, makeTrace(32, 5), device0[0]);
+    create(OP_vkAllocateCommandBuffers, makeTrace(48, 6), pool[0], 5);
+    create(OP_vkCreateBuffer, makeTrace(40, 7), device1[0]);
+
+    const auto stats = mReconstruction.getMemoryStats();
+    ASSERT_EQ(3u, stats.perDevice.size());
+
+    const auto& none = stats.perDevice.at(0);
+    EXPECT_EQ(2u, none.handles);
+    EXPECT_EQ(2u, none.apis);
+    EXPECT_EQ(24u + 16, none.traceBytes);
+
+    const auto& usage0 = stats.perDevice.at(device0[0]);
+    EXPECT_EQ(7u, usage0.handles);
+    EXPECT_EQ(3u, usage0.apis);
+    EXPECT_EQ(64u + 32 + 48, usage0.traceBytes);
+
+    const auto& usage1 = stats.perDevice.at(device1[0]);
+    EXPECT_EQ(2u, usage1.handles);
+    EXPECT_EQ(2u, usage1.apis);
+    EXPECT_EQ(64u + 40, usage1.traceBytes);
+
+    EXPECT_EQ(11u, stats.total.handles);
+    EXPECT_EQ(7u, stats.total.apis);
+}
+
+// Games creating and destroying resources every frame for a long session:
+// what is recorded for them has to go away with them.
+TEST_F(VkReconstructionTest, CreateDestroyChurn) {
+    auto instance = create(OP_vkCreateInstance, makeTrace(24, 1));
+    auto device = create(OP_vkCreateDevice, makeTrace(64, 2), instance[0]);
+    auto pool = create(OP_vkCreateCommandPool, makeTrace(32, 3), device[0]);
+    const auto baseline = mReconstruction.getMemoryStats();
+
+    constexpr int kFrames = 250000;
+    size_t maxArenaBytes = 0;
+    for (int frame = 0; frame < kFrames; ++frame) {
+        // Distinct traces for the transient objects, some repeated.
+        const uint8_t seed = (uint8_t)frame;
+        auto commandBuffers = create(OP_vkAllocateCommandBuffers,
+                                     makeTrace(48, seed), pool[0], 4);
+        auto memory = create(OP_vkAllocateMemory,
+                             makeTrace(32 + frame % 64, seed), device[0]);
+        modify(memory[0], OP_vkMapMemoryIntoAddressSpaceGOOGLE,
+               makeTrace(16, seed));
+        auto buffer = create(OP_vkCreateBuffer, makeTrace(40, seed), device[0]);
+        auto view = create(OP_vkCreateBufferView, makeTrace(200, seed), buffer[0]);
+
+        destroy(commandBuffers);
+        destroy(memory);
+        // Destroys the view with it.
+        destroy(buffer);
+        mHandleManager.remove(view[0]);
+
+        maxArenaBytes = std::max(maxArenaBytes,
+                                 mReconstruction.getMemoryStats().traceArenaBytes);
+    }
+
+    const auto stats = mReconstruction.getMemoryStats();
+    EXPECT_EQ(baseline.total.handles, stats.total.handles);
+    EXPECT_EQ(baseline.total.apis, stats.total.apis);
+    EXPECT_EQ(baseline.total.traceBytes, stats.total.traceBytes);
+    EXPECT_EQ(baseline.storedTraceBytes, stats.storedTraceBytes);
+    // Released traces are compacted away rather than piling up.
+    EXPECT_LT(maxArenaBytes, 4u * 1024 * 1024);
+    EXPECT_EQ((std::vector<uint32_t>{OP_vkCreateInstance, OP_vkCreateDevice,
+                                     OP_vkCreateCommandPool}),
+              savedOpCodes());
+}
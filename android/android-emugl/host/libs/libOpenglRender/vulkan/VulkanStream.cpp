@@ -195,6 +195,18 @@ void VulkanStream::loadStringArrayInPlace(char*** forOutput) {
     }
 }
 
+void VulkanStream::loadArrayInPlace(void** forOutput, size_t bytes,
+                                    size_t alignment) {
+    (void)alignment;
+
+    if (bytes == 0) {
+        return;
+    }
+
+    alloc(forOutput, bytes);
+    read(*forOutput, bytes);
+}
+
 ssize_t VulkanStream::read(void *buffer, size_t size) {
     return mImpl->read(buffer, size);
 }
@@ -244,6 +256,24 @@ ssize_t VulkanMemReadingStream::read(void* buffer, size_t size) {
     return size;
 }
 
+void VulkanMemReadingStream::loadArrayInPlace(void** forOutput, size_t bytes,
+                                              size_t alignment) {
+    if (bytes == 0) {
+        return;
+    }
+
+    uint8_t* current = mStart + mReadPos;
+
+    // Copy arrays of 8 byte values following an odd number of 4 byte ones.
+    if ((uintptr_t)current % alignment) {
+        VulkanStream::loadArrayInPlace(forOutput, bytes, alignment);
+        return;
+    }
+
+    *forOutput = current;
+    mReadPos += bytes;
+}
+
 ssize_t VulkanMemReadingStream::write(const void* buffer, size_t size) {
     fprintf(stderr,
             "%s: FATAL: VulkanMemReadingStream does not support writing\n",
@@ -44,6 +44,14 @@ public:
     void loadStringInPlace(char** forOutput);
     void loadStringArrayInPlace(char*** forOutput);
 
+    // Loads an array of |bytes| bytes whose encoding is its in-memory
+    // layout. Streams that decode from memory point |*forOutput| to the
+    // bytes themselves when they are |alignment| aligned, which keeps them
+    // valid only until the next setBuf() or clearPool(); other streams
+    // allocate and read. The array must not be modified.
+    virtual void loadArrayInPlace(void** forOutput, size_t bytes,
+                                  size_t alignment);
+
     virtual ssize_t read(void *buffer, size_t size);
     virtual ssize_t write(const void *buffer, size_t size);
 
@@ -73,6 +81,9 @@ public:
     ssize_t read(void *buffer, size_t size) override;
     ssize_t write(const void *buffer, size_t size) override;
 
+    void loadArrayInPlace(void** forOutput, size_t bytes,
+                          size_t alignment) override;
+
     uint8_t* beginTrace();
     size_t endTrace();
 
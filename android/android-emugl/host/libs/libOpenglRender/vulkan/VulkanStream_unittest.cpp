@@ -23,6 +23,9 @@
 #include "android/base/Pool.h"
 
 #include <gtest/gtest.h>
+#include <chrono>
+#include <functional>
+#include <stdio.h>
 #include <string.h>
 #include <vulkan.h>
 
@@ -34,6 +37,9 @@ class TestStream : public IOStream {
 public:
     static constexpr size_t kBufSize = 1024;
     TestStream() : IOStream(kBufSize) { }
+
+    size_t pendingBytes() const { return mWriteCursor - mReadCursor; }
+
 protected:
 
     void* getDmaForReading(uint64_t guest_paddr) override { return nullptr; }
@@ -648,4 +654,252 @@ TEST(VulkanStream, testStructExtension) {
     });
 }
 
+// Returns what |marshal| encodes, as the decoder finds it in memory.
+static std::vector<uint8_t> marshalToMemory(
+        std::function<void(VulkanStream*)> marshal) {
+    TestStream testStream;
+    VulkanStream stream(&testStream);
+    marshal(&stream);
+    stream.commitWrite();
+    std::vector<uint8_t> bytes(testStream.pendingBytes());
+    stream.read(bytes.data(), bytes.size());
+    return bytes;
+}
+
+static bool pointsInto(const void* ptr, const std::vector<uint8_t>& bytes) {
+    return ptr >= bytes.data() && ptr < bytes.data() + bytes.size();
+}
+
+// Decodes like VulkanMemReadingStream, but copies every array.
+class CopyingMemReadingStream : public VulkanMemReadingStream {
+public:
+    CopyingMemReadingStream() : VulkanMemReadingStream(nullptr) { }
+
+    void loadArrayInPlace(void** forOutput, size_t bytes,
+                          size_t alignment) override {
+        VulkanStream::loadArrayInPlace(forOutput, bytes, alignment);
+    }
+};
+
+TEST(VulkanStream, loadArrayInPlace) {
+    alignas(8) uint8_t buf[4 + 2 * sizeof(uint64_t) + 4 + 2 * sizeof(uint64_t)] = {};
+    const uint64_t values[] = { 0x0123456789abcdefULL, 42 };
+    memcpy(buf + 4, values, sizeof(values));
+    memcpy(buf + 4 + sizeof(values) + 4, values, sizeof(values));
+
+    VulkanMemReadingStream stream(buf);
+
+    // Misaligned for uint64_t: copied.
+    stream.getBe32();
+    uint64_t* copied = nullptr;
+    stream.loadArrayInPlace((void**)&copied, sizeof(values), alignof(uint64_t));
+    ASSERT_NE(nullptr, copied);
+    EXPECT_FALSE(copied >= (uint64_t*)buf && copied < (uint64_t*)(buf + sizeof(buf)));
+    EXPECT_EQ(0, memcmp(values, copied, sizeof(values)));
+
+    // Aligned: referenced in place.
+    stream.getBe32();
+    uint64_t* inPlace = nullptr;
+    stream.loadArrayInPlace((void**)&inPlace, sizeof(values), alignof(uint64_t));
+    EXPECT_EQ((uint64_t*)(buf + 4 + sizeof(values) + 4), inPlace);
+    EXPECT_EQ(0, memcmp(values, inPlace, sizeof(values)));
+
+    // Empty arrays leave the output alone, like alloc() does.
+    uint64_t* empty = inPlace;
+    stream.loadArrayInPlace((void**)&empty, 0, alignof(uint64_t));
+    EXPECT_EQ(inPlace, empty);
+
+    stream.clearPool();
+}
+
+// Arrays of plain data, including structs without pointers, handles or
+// padding, are decoded without copies; the rest still gets allocated.
+TEST(VulkanStream, testUnmarshalArraysInPlace) {
+    std::vector<uint32_t> code(256);
+    for (size_t i = 0; i < code.size(); ++i) {
+        code[i] = 0x07230203 + i;
+    }
+
+    const VkShaderModuleCreateInfo shaderInfo = {
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, 0, 0,
+        code.size() * sizeof(uint32_t), code.data(),
+    };
+
+    const VkViewport viewports[] = {
+        { 0.0f, 0.0f, 1920.0f, 1080.0f, 0.0f, 1.0f },
+        { 16.0f, 16.0f, 64.0f, 64.0f, 0.5f, 1.0f },
+    };
+    const VkRect2D scissors[] = {
+        { { 0, 0 }, { 1920, 1080 } },
+        { { 16, 16 }, { 64, 64 } },
+    };
+    const VkPipelineViewportStateCreateInfo viewportInfo = {
+        VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO, 0, 0,
+        arraySize(viewports), viewports, arraySize(scissors), scissors,
+    };
+
+    const VkPipelineStageFlags waitStages[] = {
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+    };
+    const VkSemaphore waitSemaphores[] = {
+        (VkSemaphore)(uintptr_t)3, (VkSemaphore)(uintptr_t)4,
+    };
+    const VkSubmitInfo submitInfo = {
+        VK_STRUCTURE_TYPE_SUBMIT_INFO, 0,
+        arraySize(waitSemaphores), waitSemaphores, waitStages,
+        0, nullptr, 0, nullptr,
+    };
+
+    auto bytes = marshalToMemory([&](VulkanStream* stream) {
+        marshal_VkShaderModuleCreateInfo(stream, &shaderInfo);
+        marshal_VkPipelineViewportStateCreateInfo(stream, &viewportInfo);
+        marshal_VkSubmitInfo(stream, &submitInfo);
+    });
+
+    VulkanMemReadingStream stream(bytes.data());
+
+    VkShaderModuleCreateInfo shaderInfoOut;
+    unmarshal_VkShaderModuleCreateInfo(&stream, &shaderInfoOut);
+    EXPECT_TRUE(pointsInto(shaderInfoOut.pCode, bytes));
+    checkEqual_VkShaderModuleCreateInfo(
+        &shaderInfo, &shaderInfoOut, [](const char* errMsg) {
+        EXPECT_TRUE(false) << errMsg;
+    });
+
+    VkPipelineViewportStateCreateInfo viewportInfoOut;
+    unmarshal_VkPipelineViewportStateCreateInfo(&stream, &viewportInfoOut);
+    EXPECT_TRUE(pointsInto(viewportInfoOut.pViewports, bytes));
+    EXPECT_TRUE(pointsInto(viewportInfoOut.pScissors, bytes));
+    checkEqual_VkPipelineViewportStateCreateInfo(
+        &viewportInfo, &viewportInfoOut, [](const char* errMsg) {
+        EXPECT_TRUE(false) << errMsg;
+    });
+
+    VkSubmitInfo submitInfoOut;
+    unmarshal_VkSubmitInfo(&stream, &submitInfoOut);
+    EXPECT_TRUE(pointsInto(submitInfoOut.pWaitDstStageMask, bytes));
+    // Handles are mapped into separate storage.
+    EXPECT_FALSE(pointsInto(submitInfoOut.pWaitSemaphores, bytes));
+    checkEqual_VkSubmitInfo(
+        &submitInfo, &submitInfoOut, [](const char* errMsg) {
+        EXPECT_TRUE(false) << errMsg;
+    });
+
+    stream.clearPool();
+}
+
+// Decode throughput of a recorded stream of the structs guests send while
+// creating pipelines and submitting frames, with and without copies.
+// Runs on the CPU only: nothing is dispatched to a Vulkan driver.
+TEST(VulkanStream, DISABLED_DecodeThroughput) {
+    std::vector<uint32_t> code(16 * 1024);
+    const VkShaderModuleCreateInfo shaderInfo = {
+        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, 0, 0,
+        code.size() * sizeof(uint32_t), code.data(),
+    };
+
+    const VkVertexInputBindingDescription bindings[] = {
+        { 0, 32, VK_VERTEX_INPUT_RATE_VERTEX },
+        { 1, 16, VK_VERTEX_INPUT_RATE_INSTANCE },
+    };
+    const VkVertexInputAttributeDescription attributes[] = {
+        { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 },
+        { 1, 0, VK_FORMAT_R32G32B32_SFLOAT, 12 },
+        { 2, 0, VK_FORMAT_R32G32_SFLOAT, 24 },
+        { 3, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 0 },
+    };
+    const VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO, 0, 0,
+        arraySize(bindings), bindings, arraySize(attributes), attributes,
+    };
+
+    const VkViewport viewport = { 0.0f, 0.0f, 1920.0f, 1080.0f, 0.0f, 1.0f };
+    const VkRect2D scissor = { { 0, 0 }, { 1920, 1080 } };
+    const VkPipelineViewportStateCreateInfo viewportInfo = {
+        VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO, 0, 0,
+        1, &viewport, 1, &scissor,
+    };
+
+    std::vector<VkBufferImageCopy> regions(13);
+    for (uint32_t i = 0; i < regions.size(); ++i) {
+        regions[i] = {
+            i * 4096, 0, 0,
+            { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 },
+            { 0, 0, 0 },
+            { 4096u >> i, 4096u >> i, 1 },
+        };
+    }
+
+    const VkPipelineStageFlags waitStage =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    const VkSemaphore semaphore = (VkSemaphore)(uintptr_t)1;
+    const VkCommandBuffer commandBuffer = (VkCommandBuffer)(uintptr_t)2;
+    const VkSubmitInfo submitInfo = {
+        VK_STRUCTURE_TYPE_SUBMIT_INFO, 0,
+        1, &semaphore, &waitStage, 1, &commandBuffer, 1, &semaphore,
+    };
+
+    constexpr int kPipelines = 4;
+    constexpr int kDraws = 200;
+
+    auto bytes = marshalToMemory([&](VulkanStream* stream) {
+        for (int i = 0; i < kPipelines; ++i) {
+            marshal_VkShaderModuleCreateInfo(stream, &shaderInfo);
+            marshal_VkPipelineVertexInputStateCreateInfo(stream, &vertexInputInfo);
+        }
+        for (const auto& region : regions) {
+            marshal_VkBufferImageCopy(stream, &region);
+        }
+        for (int i = 0; i < kDraws; ++i) {
+            marshal_VkPipelineViewportStateCreateInfo(stream, &viewportInfo);
+        }
+        marshal_VkSubmitInfo(stream, &submitInfo);
+    });
+
+    // One "frame" of unmarshaling, freeing after each struct like the
+    // decoder frees after each command.
+    auto decodeFrame = [&](VulkanMemReadingStream* stream) {
+        stream->setBuf(bytes.data());
+        for (int i = 0; i < kPipelines; ++i) {
+            VkShaderModuleCreateInfo shaderInfoOut;
+            unmarshal_VkShaderModuleCreateInfo(stream, &shaderInfoOut);
+            stream->clearPool();
+            VkPipelineVertexInputStateCreateInfo vertexInputInfoOut;
+            unmarshal_VkPipelineVertexInputStateCreateInfo(stream, &vertexInputInfoOut);
+            stream->clearPool();
+        }
+        for (size_t i = 0; i < regions.size(); ++i) {
+            VkBufferImageCopy regionOut;
+            unmarshal_VkBufferImageCopy(stream, &regionOut);
+        }
+        for (int i = 0; i < kDraws; ++i) {
+            VkPipelineViewportStateCreateInfo viewportInfoOut;
+            unmarshal_VkPipelineViewportStateCreateInfo(stream, &viewportInfoOut);
+            stream->clearPool();
+        }
+        VkSubmitInfo submitInfoOut;
+        unmarshal_VkSubmitInfo(stream, &submitInfoOut);
+        stream->clearPool();
+    };
+
+    constexpr int kFrames = 2000;
+    VulkanMemReadingStream inPlaceStream(nullptr);
+    CopyingMemReadingStream copyingStream;
+
+    for (VulkanMemReadingStream* stream :
+         { (VulkanMemReadingStream*)&copyingStream, &inPlaceStream }) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kFrames; ++i) {
+            decodeFrame(stream);
+        }
+        const double us = std::chrono::duration<double, std::micro>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+        printf("%s: %.2f us per frame, %.1f MB/s\n",
+               stream == &inPlaceStream ? "in place" : "copying",
+               us / kFrames, bytes.size() * kFrames / us);
+    }
+}
+
 } // namespace goldfish_vk
@@ -43,6 +43,7 @@
 #include "android/base/synchronization/MessageChannel.h"
 #include "android/base/system/System.h"
 #include "android/console.h"
+#include "android/emulation/AndroidPipe.h"
 #include "android/emulation/LogcatPipe.h"
 #include "android/emulation/control/RtcBridge.h"
 #include "android/emulation/control/ScreenCapturer.h"
@@ -677,6 +678,40 @@ public:
         return Status::OK;
     }
 
+    Status getPipeStats(ServerContext* context,
+                        const ::google::protobuf::Empty* request,
+                        PipeStats* reply) override {
+        using Transfers = AndroidPipe::IoStats::Transfers;
+        const auto setTransfers = [](const Transfers& from,
+                                     PipeTransferStats* to) {
+            to->set_calls(from.calls);
+            to->set_again(from.again);
+            to->set_bytes(from.bytes);
+            to->set_timens(from.timeNs);
+            to->set_maxtimens(from.maxTimeNs);
+        };
+        const auto setStats = [&setTransfers](
+                const AndroidPipe::NamedIoStats& from, PipeIoStats* to) {
+            to->set_service(from.service);
+            to->set_pipeid(from.pipeId);
+            setTransfers(from.stats.send, to->mutable_send());
+            setTransfers(from.stats.recv, to->mutable_recv());
+            to->set_wakes(from.stats.wakes);
+        };
+
+        for (const auto& service : AndroidPipe::serviceIoStats()) {
+            setStats(service, reply->add_services());
+        }
+        for (const auto& pipe : AndroidPipe::pipeIoStats()) {
+            setStats(pipe, reply->add_pipes());
+        }
+        const auto wakes = AndroidPipe::wakeStats();
+        reply->set_wakesrequested(wakes.requested);
+        reply->set_wakesdelivered(wakes.delivered);
+        reply->set_timing(AndroidPipe::ioTiming());
+        return Status::OK;
+    }
+
     Status setVmState(ServerContext* context,
                       const VmRunState* request,
                       ::google::protobuf::Empty* reply) override {
@@ -93,6 +93,12 @@ public:
                         const SnapshotPackage* request,
                         ServerWriter<SnapshotPackage>* writer) override {
         SnapshotPackage result;
+
+        // A snapshot saved copy-on-write isn't complete until its RAM is
+        // written out.
+        android::base::ThreadLooper::runOnMainLooperAndWaitForCompletion(
+                [] { snapshot::Snapshotter::get().finishSaving(); });
+
         auto snapshot =
                 snapshot::Snapshot::getSnapshotById(request->snapshot_id());
 
@@ -104,6 +110,19 @@ public:
             return Status::OK;
         }
 
+        // A layered ram.bin takes pages from the ram.bin of other snapshots,
+        // which the package would not carry.
+        if (!snapshot->ramLayers().empty()) {
+            result.set_success(false);
+            result.set_err("Snapshot " + request->snapshot_id() +
+                           " was saved in a checkpoint series and needs "
+                           "the RAM of earlier snapshots to load. Save it "
+                           "again with 'avd snapshot checkpoints 0' to "
+                           "export it.");
+            writer->Write(result);
+            return Status::OK;
+        }
+
         Stopwatch sw;
         auto tmpdir = pj(System::get()->getTempDir(), snapshot->name());
         const auto tmpdir_deleter =
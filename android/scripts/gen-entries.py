@@ -161,6 +161,7 @@ def gen_functions_header(entries, prefix_name, verbatim, filename, with_args):
         "eglSaveAllImages",
         "eglPreSaveContext",
         "eglPostLoadAllImages",
+        "eglOnFramePosted",
         "eglPostSaveContext",
         "eglUseOsEglApi",
         "eglFillUsages",
@@ -368,6 +368,18 @@ static void address_space_allocator_reset(
     block->available = 1;
 }
 
+/* The blocks are always ordered by offset and there is nothing else to
+ * rebuild. */
+static void address_space_allocator_compact(
+    struct address_space_allocator *allocator)
+{
+}
+
+static void address_space_allocator_restore(
+    struct address_space_allocator *allocator)
+{
+}
+
 #endif
 
 struct goldfish_address_space_ping {
@@ -891,11 +903,33 @@ static int vmstate_address_space_allocator_pre_load(void *opaque) {
     return 0;
 }
 
+static int vmstate_address_space_allocator_pre_save(void *opaque) {
+    struct address_space_allocator *allocator = opaque;
+
+    /* Only blocks[0..size) in offset order are meaningful in the snapshot */
+    address_space_allocator_compact(allocator);
+    return 0;
+}
+
+static int vmstate_address_space_allocator_post_load(void *opaque,
+                                                     int version_id) {
+    struct address_space_allocator *allocator = opaque;
+
+    if (allocator->size < 1 || allocator->size > allocator->capacity) {
+        return -EINVAL;
+    }
+
+    address_space_allocator_restore(allocator);
+    return 0;
+}
+
 static const VMStateDescription vmstate_address_space_allocator = {
     .name = "address_space_allocator",
     .version_id = 0,
     .minimum_version_id = 0,
     .pre_load = &vmstate_address_space_allocator_pre_load,
+    .post_load = &vmstate_address_space_allocator_post_load,
+    .pre_save = &vmstate_address_space_allocator_pre_save,
     .fields = (VMStateField[]) {
         VMSTATE_INT32(size,         struct address_space_allocator),
         VMSTATE_INT32(capacity,     struct address_space_allocator),
@@ -168,6 +168,15 @@ int qemu_delvm(const char* name, const QEMUMessageCallback* messages);
 // Callback for lazy loading of RAM for snapshots.
 void qemu_ram_load(void* hostRam, uint64_t size);
 
+// Keeps the dirty memory log running once a snapshot save completes, so that
+// the next save can visit only the pages written in between. Does nothing
+// with accelerators whose dirty log doesn't track guest writes.
+void qemu_ram_set_dirty_log_kept(bool keep);
+// Makes the next snapshot save visit only the pages written since the last
+// one. Returns false if the dirty log didn't run for all that time, in which
+// case the next save visits all pages.
+bool qemu_ram_save_dirty_only(bool dirty_only);
+
 // Disable or enable real audio input.
 // TODO: Also a potential way to pipe fake audio input
 void qemu_allow_real_audio(bool allow);
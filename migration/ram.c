@@ -51,6 +51,9 @@
 #include "qemu/rcu_queue.h"
 #include "migration/colo.h"
 #include "migration/block.h"
+#include "sysemu/sysemu.h"
+#include "sysemu/kvm.h"
+#include "sysemu/gvm.h"
 
 /***********************************************************/
 /* ram save/restore */
@@ -1679,6 +1682,45 @@ static void xbzrle_cleanup(void)
     XBZRLE_cache_unlock();
 }
 
+/* Android snapshots: with ram_dirty_log_kept, the dirty log keeps running
+ * after a save completes, and ram_dirty_log_since_save tells that it has been
+ * running since.  ram_save_dirty_only then makes the next save start from an
+ * empty bitmap instead of a full one, so that migration_bitmap_sync() fills in
+ * only the pages written since the previous save.
+ */
+static bool ram_dirty_log_kept;
+static bool ram_dirty_log_since_save;
+static bool ram_save_dirty_only;
+
+/* Whether the dirty log gets the pages the guest writes.  HAXM and WHPX
+ * report all RAM as dirty on every sync, and HVF doesn't sync the log at all,
+ * so a save visiting only dirty pages there would miss guest writes.
+ */
+static bool ram_dirty_log_tracks_guest(void)
+{
+    return kvm_enabled() || gvm_enabled() || tcg_enabled();
+}
+
+void qemu_ram_set_dirty_log_kept(bool keep)
+{
+    if (keep && !ram_dirty_log_tracks_guest()) {
+        return;
+    }
+    ram_dirty_log_kept = keep;
+    if (!keep && ram_dirty_log_since_save) {
+        ram_dirty_log_since_save = false;
+        memory_global_dirty_log_stop();
+    }
+    ram_save_dirty_only &= keep;
+}
+
+bool qemu_ram_save_dirty_only(bool dirty_only)
+{
+    ram_save_dirty_only = dirty_only && ram_dirty_log_since_save &&
+                          ram_dirty_log_tracks_guest();
+    return ram_save_dirty_only == dirty_only;
+}
+
 static void ram_save_cleanup(void *opaque)
 {
     RAMState **rsp = opaque;
@@ -1687,7 +1729,12 @@ static void ram_save_cleanup(void *opaque)
     /* caller have hold iothread lock or is in a bh, so there is
      * no writing race against this migration_bitmap
      */
-    memory_global_dirty_log_stop();
+    if (ram_dirty_log_kept) {
+        ram_dirty_log_since_save = true;
+    } else {
+        memory_global_dirty_log_stop();
+    }
+    ram_save_dirty_only = false;
 
     QLIST_FOREACH_RCU(block, &ram_list.blocks, next) {
         g_free(block->bmap);
@@ -1707,7 +1754,8 @@ static void ram_state_reset(RAMState *rs)
     rs->last_sent_block = NULL;
     rs->last_page = 0;
     rs->last_version = ram_list.version;
-    rs->ram_bulk_stage = true;
+    /* The bulk stage takes every page as dirty. */
+    rs->ram_bulk_stage = !ram_save_dirty_only;
 }
 
 #ifdef CONFIG_MIGRATION_RAM_SINGLE_ITERATION
@@ -2204,7 +2252,9 @@ static void ram_list_init_bitmaps(void)
         QLIST_FOREACH_RCU(block, &ram_list.blocks, next) {
             pages = block->max_length >> TARGET_PAGE_BITS;
             block->bmap = bitmap_new(pages);
-            bitmap_set(block->bmap, 0, pages);
+            if (!ram_save_dirty_only) {
+                bitmap_set(block->bmap, 0, pages);
+            }
             if (migrate_postcopy_ram()) {
                 block->unsentmap = bitmap_new(pages);
                 bitmap_set(block->unsentmap, 0, pages);
@@ -2221,7 +2271,13 @@ static void ram_init_bitmaps(RAMState *rs)
     rcu_read_lock();
 
     ram_list_init_bitmaps();
-    memory_global_dirty_log_start();
+    if (ram_save_dirty_only) {
+        /* Only what the sync below finds in the log is left to save. */
+        rs->migration_dirty_pages = 0;
+    }
+    if (!ram_dirty_log_since_save) {
+        memory_global_dirty_log_start();
+    }
     migration_bitmap_sync(rs);
 
     rcu_read_unlock();
@@ -2700,6 +2756,11 @@ static void decompress_data_with_multi_threads(QEMUFile *f,
  */
 static int ram_load_setup(QEMUFile *f, void *opaque)
 {
+    /* The loaded RAM has nothing in common with the last save. */
+    if (ram_dirty_log_since_save) {
+        ram_dirty_log_since_save = false;
+        memory_global_dirty_log_stop();
+    }
     xbzrle_load_setup();
     compress_threads_load_setup();
     ramblock_recv_map_init();